@@ -0,0 +1,121 @@
+#pragma once
+
+// Shared fixtures for the google-benchmark suite: deterministic synthetic corpora and a
+// throwaway database behind the DatabaseManager singleton.
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "magic_core/db/database_manager.hpp"
+
+namespace magic_benchmarks {
+
+constexpr int DIMENSION = 1024;
+
+// Markdown shaped like notes: a heading every few paragraphs, paragraphs of a few sentences
+// separated by blank lines. Always the same text for the same size.
+inline std::string synthetic_markdown(size_t bytes) {
+  static const char *const words[] = {"vector", "index", "folder", "search", "chunk",
+                                      "embedding", "query", "recall", "latency", "note",
+                                      "the", "of", "and", "a", "to", "with"};
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<size_t> word(0, std::size(words) - 1);
+  std::string text;
+  text.reserve(bytes + 256);
+  for (int section = 0; text.size() < bytes; ++section) {
+    text += std::string(1 + section % 3, '#') + " Section " + std::to_string(section) + "\n\n";
+    for (int paragraph = 0; paragraph < 4 && text.size() < bytes; ++paragraph) {
+      for (int sentence = 0; sentence < 5; ++sentence) {
+        for (int i = 0; i < 12; ++i) {
+          text += words[word(rng)];
+          text += ' ';
+        }
+        text.back() = '.';
+        text += sentence % 2 ? '\n' : ' ';
+      }
+      text += "\n\n";
+    }
+  }
+  text.resize(bytes);
+  return text;
+}
+
+// The markdown corpus without headings, for the plain text extractor
+inline std::string synthetic_text(size_t bytes) {
+  std::string text = synthetic_markdown(bytes);
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '#' && (i == 0 || text[i - 1] == '\n' || text[i - 1] == '#')) {
+      text[i] = '=';
+    }
+  }
+  return text;
+}
+
+inline std::vector<float> random_vectors(size_t count, uint32_t seed = 7) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> value(0.0f, 1.0f);
+  std::vector<float> vectors(count * DIMENSION);
+  for (float &x : vectors) {
+    x = value(rng);
+  }
+  return vectors;
+}
+
+// A file under the temp directory that is removed again on destruction
+class TempFile {
+ public:
+  TempFile(const std::string &name, const std::string &content)
+      : path_(std::filesystem::temp_directory_path() / name) {
+    std::ofstream(path_, std::ios::binary) << content;
+  }
+  ~TempFile() {
+    std::filesystem::remove(path_);
+  }
+
+  TempFile(const TempFile &) = delete;
+  TempFile &operator=(const TempFile &) = delete;
+
+  const std::filesystem::path &path() const {
+    return path_;
+  }
+
+ private:
+  std::filesystem::path path_;
+};
+
+// Initializes the DatabaseManager singleton on a fresh database for the lifetime of the object
+class ScopedDatabase {
+ public:
+  explicit ScopedDatabase(int pool_size = 4) {
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    path_ = std::filesystem::temp_directory_path() /
+            ("magic_benchmark_" + std::to_string(stamp) + ".db");
+    auto &manager = magic_core::DatabaseManager::get_instance();
+    manager.shutdown();
+    manager.initialize(path_, "magic_folder_benchmark_key", pool_size);
+  }
+  ~ScopedDatabase() {
+    manager().shutdown();
+    std::filesystem::remove(path_);
+    for (const char *name : {"files", "chunks"}) {
+      std::filesystem::remove(magic_core::DatabaseManager::vector_store_path(path_, name));
+    }
+  }
+
+  ScopedDatabase(const ScopedDatabase &) = delete;
+  ScopedDatabase &operator=(const ScopedDatabase &) = delete;
+
+  magic_core::DatabaseManager &manager() const {
+    return magic_core::DatabaseManager::get_instance();
+  }
+
+ private:
+  std::filesystem::path path_;
+};
+
+}  // namespace magic_benchmarks
@@ -0,0 +1,89 @@
+// zstd round trips through CompressionService and SHA-256 content hashing
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "benchmark_support.hpp"
+#include "magic_core/extractors/plaintext_extractor.hpp"
+#include "magic_core/services/compression_service.hpp"
+
+namespace magic_benchmarks {
+namespace {
+
+using magic_core::CompressionService;
+
+// Allocating API, a fresh frame and string per call
+void BM_CompressionRoundTrip(benchmark::State &state) {
+  const std::string chunk = synthetic_text(static_cast<size_t>(state.range(0)));
+  const int level = static_cast<int>(state.range(1));
+  size_t compressed_size = 0;
+  for (auto _ : state) {
+    const std::vector<char> compressed = CompressionService::compress(chunk, level);
+    compressed_size = compressed.size();
+    benchmark::DoNotOptimize(CompressionService::decompress(compressed));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * chunk.size()));
+  state.counters["ratio"] = static_cast<double>(chunk.size()) / compressed_size;
+}
+
+// Reused buffers, the steady state of a caller that keeps its scratch space
+void BM_CompressionRoundTrip_Reused(benchmark::State &state) {
+  const std::string chunk = synthetic_text(static_cast<size_t>(state.range(0)));
+  const int level = static_cast<int>(state.range(1));
+  std::vector<char> compressed;
+  std::string arena;
+  for (auto _ : state) {
+    CompressionService::compress_into(chunk, compressed, level);
+    benchmark::DoNotOptimize(CompressionService::decompress_into(compressed, arena));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * chunk.size()));
+}
+
+void BM_Decompress(benchmark::State &state) {
+  const std::string chunk = synthetic_text(static_cast<size_t>(state.range(0)));
+  const std::vector<char> compressed = CompressionService::compress(chunk);
+  std::string arena;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CompressionService::decompress_into(compressed, arena));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * chunk.size()));
+}
+
+// Exposes the in-memory digest the extractors hash loaded content with
+class HashingExtractor : public magic_core::PlainTextExtractor {
+ public:
+  using ContentExtractor::compute_hash_from_content;
+};
+
+void BM_Sha256_Content(benchmark::State &state) {
+  const std::string content = synthetic_text(static_cast<size_t>(state.range(0)) << 10);
+  const HashingExtractor extractor;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(extractor.compute_hash_from_content(content));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+}
+
+// Streamed from disk in HASH_BLOCK_SIZE blocks, as dedupe hashes files
+void BM_Sha256_File(benchmark::State &state) {
+  const std::string content = synthetic_text(static_cast<size_t>(state.range(0)) << 10);
+  const TempFile file("magic_benchmark_hash.txt", content);
+  const HashingExtractor extractor;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(extractor.get_content_hash(file.path()));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+}
+
+// Chunk-sized (bytes) and file-sized inputs at the default and a high level
+BENCHMARK(BM_CompressionRoundTrip)->ArgsProduct({{1792, 65536}, {3, 19}});
+BENCHMARK(BM_CompressionRoundTrip_Reused)->ArgsProduct({{1792, 65536}, {3, 19}});
+BENCHMARK(BM_Decompress)->Arg(1792)->Arg(65536);
+// KiB
+BENCHMARK(BM_Sha256_Content)->Arg(4)->Arg(1024)->Arg(65536);
+BENCHMARK(BM_Sha256_File)->Arg(4)->Arg(1024)->Arg(65536);
+
+}  // namespace
+}  // namespace magic_benchmarks
@@ -0,0 +1,107 @@
+// Section scanning and chunking on synthetic corpora. The regex cases time the std::regex
+// boundaries the linear scanners replaced, on the same text.
+
+#include <benchmark/benchmark.h>
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "benchmark_support.hpp"
+#include "magic_core/extractors/markdown_extractor.hpp"
+#include "magic_core/extractors/plaintext_extractor.hpp"
+#include "magic_core/extractors/text_scanner.hpp"
+
+namespace magic_benchmarks {
+namespace {
+
+std::vector<size_t> regex_match_starts(const std::string &text, const std::regex &pattern) {
+  std::vector<size_t> starts;
+  for (auto it = std::sregex_iterator(text.begin(), text.end(), pattern);
+       it != std::sregex_iterator(); ++it) {
+    starts.push_back(static_cast<size_t>(it->position()));
+  }
+  return starts;
+}
+
+std::vector<size_t> regex_match_ends(const std::string &text, const std::regex &pattern) {
+  std::vector<size_t> ends;
+  for (auto it = std::sregex_iterator(text.begin(), text.end(), pattern);
+       it != std::sregex_iterator(); ++it) {
+    ends.push_back(static_cast<size_t>(it->position() + it->length()));
+  }
+  return ends;
+}
+
+void BM_HeadingStarts_Regex(benchmark::State &state) {
+  const std::string text = synthetic_markdown(static_cast<size_t>(state.range(0)) << 10);
+  const std::regex heading(R"(^#+\s.*)", std::regex::ECMAScript | std::regex::multiline);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(regex_match_starts(text, heading));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+void BM_HeadingStarts_Scanner(benchmark::State &state) {
+  const std::string text = synthetic_markdown(static_cast<size_t>(state.range(0)) << 10);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(magic_core::find_heading_starts(text));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+void BM_ParagraphBreaks_Regex(benchmark::State &state) {
+  const std::string text = synthetic_text(static_cast<size_t>(state.range(0)) << 10);
+  const std::regex paragraph_break(R"(\n\s*\n)");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(regex_match_ends(text, paragraph_break));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+void BM_ParagraphBreaks_Scanner(benchmark::State &state) {
+  const std::string text = synthetic_text(static_cast<size_t>(state.range(0)) << 10);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(magic_core::find_paragraph_breaks(text));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+// Whole extraction through the public entry point, so file mapping and chunk copies count
+template <typename Extractor>
+void chunk_file(benchmark::State &state, const std::string &content, const char *name) {
+  const TempFile file(name, content);
+  const Extractor extractor;
+  size_t chunks = 0;
+  for (auto _ : state) {
+    auto result = extractor.get_chunks(file.path());
+    chunks = result.size();
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+  state.counters["chunks"] = static_cast<double>(chunks);
+}
+
+void BM_MarkdownChunks(benchmark::State &state) {
+  chunk_file<magic_core::MarkdownExtractor>(
+      state, synthetic_markdown(static_cast<size_t>(state.range(0)) << 10),
+      "magic_benchmark_corpus.md");
+}
+
+void BM_PlainTextChunks(benchmark::State &state) {
+  chunk_file<magic_core::PlainTextExtractor>(
+      state, synthetic_text(static_cast<size_t>(state.range(0)) << 10),
+      "magic_benchmark_corpus.txt");
+}
+
+// Sizes in KiB. std::regex is too slow to be worth timing past a megabyte.
+BENCHMARK(BM_HeadingStarts_Regex)->Arg(64)->Arg(1024);
+BENCHMARK(BM_HeadingStarts_Scanner)->Arg(64)->Arg(1024);
+BENCHMARK(BM_ParagraphBreaks_Regex)->Arg(64)->Arg(1024);
+BENCHMARK(BM_ParagraphBreaks_Scanner)->Arg(64)->Arg(1024);
+// 16 MiB is past twice PARALLEL_REGION_SIZE, so it takes the parallel region path
+BENCHMARK(BM_MarkdownChunks)->Arg(64)->Arg(1024)->Arg(16384)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_PlainTextChunks)->Arg(64)->Arg(1024)->Arg(16384)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace magic_benchmarks
@@ -0,0 +1,441 @@
+// Offline recall/latency evaluation of the vector index configurations.
+//
+//   index_eval dump <metadata.db> <files|chunks> <out.vecs>
+//       Writes every stored summary or chunk vector, with its row id, to a plain dump. The
+//       dump is NOT encrypted; keep it somewhere as private as the database.
+//
+//   index_eval run <base.vecs> [--queries <q.vecs> | --holdout 1000] [--k 10]
+//                  [--metric l2|cosine] [--types flat,hnsw,hnsw_sq8,ivf_pq]
+//                  [--ef 16,32,64,128,256] [--nprobe 1,4,16,64] [--hnsw-m 32]
+//                  [--ef-construction 100] [--ivf-lists 1024] [--pq 128] [--seed 1]
+//                  [--label name] [--json results.jsonl]
+//       Computes the exact top k of every query by brute force, then builds each index type
+//       and reports, for each efSearch (HNSW types) or nprobe (IVF-PQ) setting, recall@k,
+//       single-query QPS and p50/p99 latency, build time and the serialized index size.
+//       --holdout takes that many base vectors out of the index to use as queries, picked by
+//       --seed, so runs over the same dump and seed are directly comparable. --json appends one
+//       JSON object per setting.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "magic_core/db/database_manager.hpp"
+#include "magic_core/db/metadata_store.hpp"
+#include "magic_core/db/vector_index.hpp"
+#include "magic_core/services/encryption_key_service.hpp"
+#include "magic_core/types/vector_math.hpp"
+
+namespace {
+
+namespace vector_math = magic_core::vector_math;
+using clock_type = std::chrono::steady_clock;
+
+// "MFVD", version, dimension, reserved, count; then count int64 ids and count * dimension
+// float32 components, all in host byte order
+constexpr char DUMP_MAGIC[4] = {'M', 'F', 'V', 'D'};
+constexpr uint32_t DUMP_VERSION = 1;
+
+struct VectorSet {
+  int dimension = 0;
+  std::vector<int64_t> ids;
+  std::vector<float> vectors;
+
+  size_t size() const {
+    return ids.size();
+  }
+  const float *row(size_t i) const {
+    return vectors.data() + i * static_cast<size_t>(dimension);
+  }
+};
+
+void write_dump(const std::string &path, const VectorSet &set) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Could not open " + path + " for writing");
+  }
+  const uint32_t header[3] = {DUMP_VERSION, static_cast<uint32_t>(set.dimension), 0};
+  const uint64_t count = set.size();
+  out.write(DUMP_MAGIC, sizeof(DUMP_MAGIC));
+  out.write(reinterpret_cast<const char *>(header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  out.write(reinterpret_cast<const char *>(set.ids.data()),
+            static_cast<std::streamsize>(count * sizeof(int64_t)));
+  out.write(reinterpret_cast<const char *>(set.vectors.data()),
+            static_cast<std::streamsize>(set.vectors.size() * sizeof(float)));
+  if (!out) {
+    throw std::runtime_error("Failed to write " + path);
+  }
+}
+
+VectorSet read_dump(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Could not open " + path);
+  }
+  char magic[4];
+  uint32_t header[3];
+  uint64_t count = 0;
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char *>(header), sizeof(header));
+  in.read(reinterpret_cast<char *>(&count), sizeof(count));
+  if (!in || !std::equal(magic, magic + 4, DUMP_MAGIC) || header[0] != DUMP_VERSION ||
+      header[1] == 0) {
+    throw std::runtime_error(path + " is not a vector dump");
+  }
+  VectorSet set;
+  set.dimension = static_cast<int>(header[1]);
+  set.ids.resize(count);
+  set.vectors.resize(count * set.dimension);
+  in.read(reinterpret_cast<char *>(set.ids.data()),
+          static_cast<std::streamsize>(count * sizeof(int64_t)));
+  in.read(reinterpret_cast<char *>(set.vectors.data()),
+          static_cast<std::streamsize>(set.vectors.size() * sizeof(float)));
+  if (!in) {
+    throw std::runtime_error(path + " is truncated");
+  }
+  return set;
+}
+
+int dump(const std::string &db_path, const std::string &table, const std::string &out_path) {
+  auto &db_manager = magic_core::DatabaseManager::get_instance();
+  db_manager.initialize(db_path, magic_core::EncryptionKeyService::get_database_key(),
+                        /*pool_size*/ 1);
+  VectorSet set;
+  {
+    magic_core::MetadataStore store(db_manager);
+    set.dimension = store.dimension();
+    std::vector<faiss::idx_t> ids;
+    store.read_all_vectors(table, ids, set.vectors);
+    set.ids.assign(ids.begin(), ids.end());
+  }
+  db_manager.shutdown();
+  write_dump(out_path, set);
+  std::cerr << "Wrote " << set.size() << " " << table << " vectors to " << out_path
+            << " (unencrypted)" << std::endl;
+  return 0;
+}
+
+struct RunOptions {
+  std::string base_path;
+  std::string queries_path;
+  size_t holdout = 1000;
+  int k = 10;
+  magic_core::VectorMetric metric = magic_core::VectorMetric::L2;
+  std::vector<magic_core::VectorIndexType> types = {
+      magic_core::VectorIndexType::Flat, magic_core::VectorIndexType::Hnsw,
+      magic_core::VectorIndexType::HnswSq8, magic_core::VectorIndexType::IvfPq};
+  std::vector<int> ef = {16, 32, 64, 128, 256};
+  std::vector<int> nprobe = {1, 4, 16, 64};
+  magic_core::VectorIndexOptions index;
+  uint32_t seed = 1;
+  std::string label;
+  std::string json_path;
+};
+
+std::vector<std::string> split_list(const std::string &list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  for (std::string item; std::getline(stream, item, ',');) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+std::vector<int> int_list(const std::string &list) {
+  std::vector<int> values;
+  for (const auto &item : split_list(list)) {
+    values.push_back(std::stoi(item));
+  }
+  return values;
+}
+
+RunOptions parse_run_options(int argc, char **argv) {
+  RunOptions options;
+  options.base_path = argv[2];
+  for (int i = 3; i < argc; i += 2) {
+    const std::string flag = argv[i];
+    if (i + 1 >= argc) {
+      throw std::invalid_argument("Missing value for " + flag);
+    }
+    const std::string value = argv[i + 1];
+    if (flag == "--queries") {
+      options.queries_path = value;
+    } else if (flag == "--holdout") {
+      options.holdout = std::stoul(value);
+    } else if (flag == "--k") {
+      options.k = std::stoi(value);
+    } else if (flag == "--metric") {
+      options.metric = magic_core::parse_vector_metric(value);
+    } else if (flag == "--types") {
+      options.types.clear();
+      for (const auto &type : split_list(value)) {
+        options.types.push_back(magic_core::parse_vector_index_type(type));
+      }
+    } else if (flag == "--ef") {
+      options.ef = int_list(value);
+    } else if (flag == "--nprobe") {
+      options.nprobe = int_list(value);
+    } else if (flag == "--hnsw-m") {
+      options.index.hnsw_m = std::stoi(value);
+    } else if (flag == "--ef-construction") {
+      options.index.ef_construction = std::stoi(value);
+    } else if (flag == "--ivf-lists") {
+      options.index.ivf_lists = std::stoi(value);
+    } else if (flag == "--pq") {
+      options.index.pq_subquantizers = std::stoi(value);
+    } else if (flag == "--seed") {
+      options.seed = static_cast<uint32_t>(std::stoul(value));
+    } else if (flag == "--label") {
+      options.label = value;
+    } else if (flag == "--json") {
+      options.json_path = value;
+    } else {
+      throw std::invalid_argument("Unknown option " + flag);
+    }
+  }
+  if (options.k <= 0) {
+    throw std::invalid_argument("--k must be positive");
+  }
+  options.index.metric = options.metric;
+  return options;
+}
+
+// Moves holdout rows, picked by seed, out of base and returns them
+VectorSet take_holdout(VectorSet &base, size_t holdout, uint32_t seed) {
+  if (holdout == 0 || holdout >= base.size()) {
+    throw std::invalid_argument("--holdout must be between 1 and the base size - 1");
+  }
+  std::vector<size_t> order(base.size());
+  std::iota(order.begin(), order.end(), size_t{0});
+  std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+  std::vector<bool> is_query(base.size(), false);
+  for (size_t i = 0; i < holdout; ++i) {
+    is_query[order[i]] = true;
+  }
+  const size_t dimension = static_cast<size_t>(base.dimension);
+  VectorSet queries;
+  VectorSet kept;
+  queries.dimension = kept.dimension = base.dimension;
+  for (size_t i = 0; i < base.size(); ++i) {
+    VectorSet &target = is_query[i] ? queries : kept;
+    target.ids.push_back(base.ids[i]);
+    target.vectors.insert(target.vectors.end(), base.row(i), base.row(i) + dimension);
+  }
+  base = std::move(kept);
+  return queries;
+}
+
+// Exact top k ids of every query under metric, by scoring the whole base
+std::vector<std::vector<int64_t>> ground_truth(const VectorSet &base, const VectorSet &queries,
+                                               int k, magic_core::VectorMetric metric) {
+  const size_t dimension = static_cast<size_t>(base.dimension);
+  const bool cosine = metric == magic_core::VectorMetric::Cosine;
+  std::vector<float> rows = base.vectors;
+  std::vector<float> norms(base.size(), 0.0f);
+  for (size_t i = 0; i < base.size(); ++i) {
+    float *row = rows.data() + i * dimension;
+    if (cosine) {
+      vector_math::normalize(row, dimension);
+    } else {
+      norms[i] = vector_math::dot(row, row, dimension);
+    }
+  }
+  const size_t top = std::min(static_cast<size_t>(k), base.size());
+  std::vector<std::vector<int64_t>> truth(queries.size());
+  std::vector<float> scores(base.size());
+  std::vector<size_t> order(base.size());
+  std::vector<float> query(dimension);
+  for (size_t q = 0; q < queries.size(); ++q) {
+    std::copy_n(queries.row(q), dimension, query.begin());
+    if (cosine) {
+      vector_math::normalize(query);
+    }
+    vector_math::dot_rows(query.data(), rows.data(), base.size(), dimension, scores.data());
+    // Smaller is nearer: 1 - cosine, or |x|^2 - 2 q.x (|q|^2 is the same for every row)
+    for (size_t i = 0; i < base.size(); ++i) {
+      scores[i] = cosine ? 1.0f - scores[i] : norms[i] - 2.0f * scores[i];
+    }
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::partial_sort(order.begin(), order.begin() + top, order.end(),
+                      [&](size_t a, size_t b) { return scores[a] < scores[b]; });
+    for (size_t i = 0; i < top; ++i) {
+      truth[q].push_back(base.ids[order[i]]);
+    }
+  }
+  return truth;
+}
+
+struct Measurement {
+  double recall = 0.0;
+  double qps = 0.0;
+  double p50_us = 0.0;
+  double p99_us = 0.0;
+};
+
+Measurement measure(const magic_core::VectorIndex &index, const VectorSet &queries,
+                    const std::vector<std::vector<int64_t>> &truth, int k,
+                    const magic_core::VectorSearchOptions &tuning) {
+  const size_t dimension = static_cast<size_t>(queries.dimension);
+  std::vector<double> micros;
+  micros.reserve(queries.size());
+  double recall_sum = 0.0;
+  std::vector<float> query(dimension);
+  const auto started = clock_type::now();
+  for (size_t q = 0; q < queries.size(); ++q) {
+    std::copy_n(queries.row(q), dimension, query.begin());
+    const auto sent = clock_type::now();
+    const auto hits = index.search(query, k, nullptr, tuning);
+    micros.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - sent).count());
+    const std::unordered_set<int64_t> expected(truth[q].begin(), truth[q].end());
+    size_t found = 0;
+    for (const auto &hit : hits) {
+      found += expected.count(hit.id);
+    }
+    recall_sum += expected.empty() ? 1.0 : static_cast<double>(found) / expected.size();
+  }
+  const double seconds = std::chrono::duration<double>(clock_type::now() - started).count();
+  std::sort(micros.begin(), micros.end());
+  Measurement result;
+  result.recall = recall_sum / queries.size();
+  result.qps = queries.size() / seconds;
+  result.p50_us = micros[micros.size() / 2];
+  result.p99_us = micros[std::min(micros.size() - 1, micros.size() * 99 / 100)];
+  return result;
+}
+
+int run(const RunOptions &options) {
+  VectorSet base = read_dump(options.base_path);
+  VectorSet queries = options.queries_path.empty()
+                          ? take_holdout(base, options.holdout, options.seed)
+                          : read_dump(options.queries_path);
+  if (queries.dimension != base.dimension) {
+    throw std::invalid_argument("Queries have dimension " + std::to_string(queries.dimension) +
+                                ", the base " + std::to_string(base.dimension));
+  }
+  std::cerr << "Base " << base.size() << " x " << base.dimension << ", " << queries.size()
+            << " queries, k " << options.k << ", " << magic_core::to_string(options.metric)
+            << std::endl;
+
+  const auto truth_started = clock_type::now();
+  const auto truth = ground_truth(base, queries, options.k, options.metric);
+  std::cerr << "Ground truth in "
+            << std::chrono::duration<double>(clock_type::now() - truth_started).count() << " s"
+            << std::endl;
+
+  std::ofstream json;
+  if (!options.json_path.empty()) {
+    json.open(options.json_path, std::ios::app);
+    if (!json) {
+      throw std::runtime_error("Could not open " + options.json_path);
+    }
+  }
+  std::printf("%-9s %9s %7s %10s %12s %8s %10s %10s %10s\n", "type", "ef/nprobe", "trained",
+              "build ms", "index MB", "recall", "qps", "p50 us", "p99 us");
+
+  for (const auto type : options.types) {
+    magic_core::VectorIndexOptions index_options = options.index;
+    index_options.type = type;
+    magic_core::VectorIndex index(base.dimension, index_options);
+    const auto build_started = clock_type::now();
+    index.rebuild([&](std::vector<faiss::idx_t> &ids, std::vector<float> &vectors) {
+      ids.assign(base.ids.begin(), base.ids.end());
+      vectors = base.vectors;
+    });
+    const double build_ms =
+        std::chrono::duration<double, std::milli>(clock_type::now() - build_started).count();
+    const size_t index_bytes = index.serialize().size();
+
+    // One row per search setting the type has; flat has none
+    std::vector<magic_core::VectorSearchOptions> settings;
+    if (type == magic_core::VectorIndexType::Hnsw ||
+        type == magic_core::VectorIndexType::HnswSq8) {
+      for (int ef : options.ef) {
+        settings.push_back({ef, 0});
+      }
+    } else if (type == magic_core::VectorIndexType::IvfPq) {
+      for (int nprobe : options.nprobe) {
+        settings.push_back({0, nprobe});
+      }
+    } else {
+      settings.push_back({});
+    }
+
+    for (const auto &tuning : settings) {
+      const Measurement result = measure(index, queries, truth, options.k, tuning);
+      const int knob = tuning.ef_search ? tuning.ef_search : tuning.nprobe;
+      std::printf("%-9s %9d %7s %10.1f %12.1f %8.4f %10.1f %10.1f %10.1f\n",
+                  magic_core::to_string(type).c_str(), knob,
+                  index.uses_configured_type() ? "yes" : "no", build_ms,
+                  index_bytes / (1024.0 * 1024.0), result.recall, result.qps, result.p50_us,
+                  result.p99_us);
+      if (json) {
+        json << nlohmann::json{{"label", options.label},
+                               {"base", options.base_path},
+                               {"base_size", base.size()},
+                               {"dimension", base.dimension},
+                               {"queries", queries.size()},
+                               {"holdout_seed", options.queries_path.empty() ? options.seed : 0},
+                               {"k", options.k},
+                               {"metric", magic_core::to_string(options.metric)},
+                               {"type", magic_core::to_string(type)},
+                               {"configured_type", index.uses_configured_type()},
+                               {"hnsw_m", index_options.hnsw_m},
+                               {"ef_construction", index_options.ef_construction},
+                               {"ivf_lists", index_options.ivf_lists},
+                               {"pq_subquantizers", index_options.pq_subquantizers},
+                               {"ef_search", tuning.ef_search},
+                               {"nprobe", tuning.nprobe},
+                               {"build_ms", build_ms},
+                               {"index_bytes", index_bytes},
+                               {"recall", result.recall},
+                               {"qps", result.qps},
+                               {"p50_us", result.p50_us},
+                               {"p99_us", result.p99_us}}
+                    .dump()
+             << '\n';
+      }
+    }
+  }
+  return 0;
+}
+
+int usage() {
+  std::cerr << "Usage: index_eval dump <metadata.db> <files|chunks> <out.vecs>\n"
+               "       index_eval run <base.vecs> [options]   (see the top of index_eval.cpp)"
+            << std::endl;
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  try {
+    const std::string command = argc > 1 ? argv[1] : "";
+    if (command == "dump" && argc == 5) {
+      return dump(argv[2], argv[3], argv[4]);
+    }
+    if (command == "run" && argc >= 3) {
+      return run(parse_run_options(argc, argv));
+    }
+    return usage();
+  } catch (const std::exception &e) {
+    std::cerr << "index_eval: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,175 @@
+// MetadataStore bulk writes and the queries that enrich search hits, on a fresh database per
+// case
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark_support.hpp"
+#include "magic_core/db/metadata_store.hpp"
+#include "magic_core/services/compression_service.hpp"
+
+namespace magic_benchmarks {
+namespace {
+
+using magic_core::BasicFileMetadata;
+using magic_core::ChunkSearchResult;
+using magic_core::MetadataStore;
+using magic_core::ProcessedChunk;
+
+constexpr int CORPUS_FILES = 1000;
+constexpr int CHUNKS_PER_FILE = 8;
+
+BasicFileMetadata make_stub(const std::string &path) {
+  BasicFileMetadata stub;
+  stub.path = path;
+  stub.original_path = path;
+  stub.content_hash = "hash:" + path;
+  stub.file_type = magic_core::FileType::Text;
+  stub.file_size = 4096;
+  stub.processing_status = magic_core::ProcessingStatus::PROCESSING;
+  stub.last_modified = std::chrono::system_clock::now();
+  stub.created_at = stub.last_modified;
+  return stub;
+}
+
+std::vector<ProcessedChunk> make_chunks(int count, uint32_t seed) {
+  const std::vector<float> vectors = random_vectors(static_cast<size_t>(count), seed);
+  const std::string text = synthetic_text(1792);
+  std::vector<ProcessedChunk> chunks;
+  chunks.reserve(static_cast<size_t>(count));
+  for (int i = 0; i < count; ++i) {
+    ProcessedChunk chunk;
+    chunk.chunk.content = text;
+    chunk.chunk.chunk_index = i;
+    chunk.chunk.vector_embedding.assign(vectors.begin() + i * DIMENSION,
+                                        vectors.begin() + (i + 1) * DIMENSION);
+    chunk.compressed_content = magic_core::CompressionService::compress(text);
+    chunk.content_hash = "chunk:" + std::to_string(seed) + ":" + std::to_string(i);
+    chunks.push_back(std::move(chunk));
+  }
+  return chunks;
+}
+
+// CORPUS_FILES processed files with CHUNKS_PER_FILE chunks each; returns every chunk id
+std::vector<int64_t> populate(MetadataStore &store) {
+  std::vector<BasicFileMetadata> stubs;
+  for (int i = 0; i < CORPUS_FILES; ++i) {
+    stubs.push_back(make_stub("/corpus/file_" + std::to_string(i) + ".txt"));
+  }
+  const std::vector<int> file_ids = store.upsert_file_stubs(stubs);
+  const std::vector<float> summaries = random_vectors(CORPUS_FILES, 3);
+  std::vector<int64_t> chunk_ids;
+  for (int i = 0; i < CORPUS_FILES; ++i) {
+    store.upsert_chunk_metadata(file_ids[i], make_chunks(CHUNKS_PER_FILE, 100 + i));
+    store.update_file_ai_analysis(
+        file_ids[i], std::vector<float>(summaries.begin() + i * DIMENSION,
+                                        summaries.begin() + (i + 1) * DIMENSION));
+    for (const auto &chunk : store.get_stored_chunks(file_ids[i])) {
+      chunk_ids.push_back(chunk.id);
+    }
+  }
+  return chunk_ids;
+}
+
+void BM_UpsertFileStubs(benchmark::State &state) {
+  const ScopedDatabase database;
+  MetadataStore store(database.manager());
+  const auto batch = static_cast<int>(state.range(0));
+  int next = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<BasicFileMetadata> stubs;
+    for (int i = 0; i < batch; ++i) {
+      stubs.push_back(make_stub("/bulk/file_" + std::to_string(next++) + ".txt"));
+    }
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(store.upsert_file_stubs(stubs));
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * batch));
+}
+
+void BM_UpsertChunkMetadata(benchmark::State &state) {
+  const ScopedDatabase database;
+  MetadataStore store(database.manager());
+  const auto count = static_cast<int>(state.range(0));
+  const std::vector<ProcessedChunk> chunks = make_chunks(count, 1);
+  int next = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    const int file_id = store.upsert_file_stub(
+        make_stub("/chunks/file_" + std::to_string(next++) + ".txt"));
+    state.ResumeTiming();
+    store.upsert_chunk_metadata(file_id, chunks);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+}
+
+// The per-hit enrichment a chunk search does after the ANN step; range(1) reads the blobs too
+void BM_FillChunkMetadata(benchmark::State &state) {
+  const ScopedDatabase database;
+  MetadataStore store(database.manager());
+  const std::vector<int64_t> chunk_ids = populate(store);
+  const auto hits = static_cast<size_t>(state.range(0));
+  const bool with_content = state.range(1) != 0;
+  std::mt19937 rng(5);
+  std::uniform_int_distribution<size_t> pick(0, chunk_ids.size() - 1);
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<ChunkSearchResult> results(hits);
+    for (auto &result : results) {
+      result.id = static_cast<int>(chunk_ids[pick(rng)]);
+      result.distance = 0.0f;
+    }
+    state.ResumeTiming();
+    store.fill_chunk_metadata(results, with_content);
+    benchmark::DoNotOptimize(results);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * hits));
+}
+
+void BM_FileProcessingStatuses(benchmark::State &state) {
+  const ScopedDatabase database;
+  MetadataStore store(database.manager());
+  populate(store);
+  std::vector<std::string> hashes;
+  for (int i = 0; i < state.range(0); ++i) {
+    hashes.push_back("hash:/corpus/file_" + std::to_string(i % CORPUS_FILES) + ".txt");
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(store.file_processing_statuses(hashes));
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * hashes.size()));
+}
+
+// ANN over file summaries plus the metadata join that turns ids into results
+void BM_SearchSimilarFiles(benchmark::State &state) {
+  const ScopedDatabase database;
+  MetadataStore store(database.manager());
+  populate(store);
+  store.initialize();
+  const auto queries = random_vectors(16, 11);
+  const auto k = static_cast<int>(state.range(0));
+  size_t next = 0;
+  for (auto _ : state) {
+    const std::vector<float> query(queries.begin() + next * DIMENSION,
+                                   queries.begin() + (next + 1) * DIMENSION);
+    benchmark::DoNotOptimize(store.search_similar_files(query, k));
+    next = (next + 1) % 16;
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_UpsertFileStubs)->Arg(1)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_UpsertChunkMetadata)->Arg(8)->Arg(64)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FillChunkMetadata)
+    ->ArgsProduct({{10, 100}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_FileProcessingStatuses)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SearchSimilarFiles)->Arg(10)->Arg(100)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace magic_benchmarks
@@ -0,0 +1,71 @@
+// Task claim throughput with N workers draining one queue, each claiming under its own lease
+// owner as separate worker processes would
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_support.hpp"
+#include "magic_core/db/pooled_connection.hpp"
+#include "magic_core/db/task_queue_repo.hpp"
+
+namespace magic_benchmarks {
+namespace {
+
+constexpr int QUEUED_TASKS = 2000;
+
+// range(0) workers, each claiming range(1) tasks per call
+void BM_TaskClaim(benchmark::State &state) {
+  const auto workers = static_cast<int>(state.range(0));
+  const auto claim_size = static_cast<int>(state.range(1));
+  const ScopedDatabase database(workers);
+  magic_core::TaskQueueRepo repo(database.manager());
+
+  std::vector<std::string> paths;
+  for (int i = 0; i < QUEUED_TASKS; ++i) {
+    paths.push_back("/queue/file_" + std::to_string(i) + ".txt");
+  }
+
+  int64_t claimed_total = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    {
+      magic_core::PooledConnection conn(database.manager());
+      *conn << "DELETE FROM task_queue;";
+    }
+    repo.create_file_process_tasks("PROCESS_FILE", paths);
+    std::atomic<int64_t> claimed{0};
+    state.ResumeTiming();
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; ++w) {
+      threads.emplace_back([&, owner = "benchmark-worker-" + std::to_string(w)] {
+        while (true) {
+          const auto tasks =
+              repo.fetch_and_claim_tasks(claim_size, magic_core::TaskLane::Any, owner);
+          if (tasks.empty()) {
+            return;
+          }
+          claimed += static_cast<int64_t>(tasks.size());
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    claimed_total += claimed;
+  }
+  // With UseRealTime, items_per_second is claims per wall-clock second across all workers
+  state.SetItemsProcessed(claimed_total);
+}
+
+BENCHMARK(BM_TaskClaim)
+    ->ArgsProduct({{1, 2, 4, 8}, {1, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace magic_benchmarks
@@ -0,0 +1,121 @@
+// VectorIndex build and search at 10k, 100k and (with MAGIC_BENCHMARK_LARGE=1) 1M
+// embedding-sized vectors, for each index type. A 1M float index needs about 4 GB for its
+// vectors alone, and building an HNSW graph of that size takes tens of minutes.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark_support.hpp"
+#include "magic_core/db/vector_index.hpp"
+
+namespace magic_benchmarks {
+namespace {
+
+using magic_core::VectorIndex;
+using magic_core::VectorIndexOptions;
+using magic_core::VectorIndexType;
+
+constexpr int K = 10;
+constexpr size_t QUERIES = 64;
+
+VectorIndexOptions options_for(int64_t type) {
+  VectorIndexOptions options;
+  options.type = static_cast<VectorIndexType>(type);
+  options.ivf_lists = 256;
+  return options;
+}
+
+std::unique_ptr<VectorIndex> build_index(size_t count, int64_t type) {
+  auto index = std::make_unique<VectorIndex>(DIMENSION, options_for(type));
+  index->rebuild([count](std::vector<faiss::idx_t> &ids, std::vector<float> &vectors) {
+    ids.resize(count);
+    std::iota(ids.begin(), ids.end(), faiss::idx_t{1});
+    vectors = random_vectors(count);
+  });
+  return index;
+}
+
+// Indexes are built once per (size, type) and shared by the search cases
+const VectorIndex &shared_index(size_t count, int64_t type) {
+  static std::map<std::pair<size_t, int64_t>, std::unique_ptr<VectorIndex>> indexes;
+  auto &index = indexes[{count, type}];
+  if (!index) {
+    index = build_index(count, type);
+  }
+  return *index;
+}
+
+void BM_VectorIndexBuild(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  for (auto _ : state) {
+    auto index = build_index(count, state.range(1));
+    benchmark::DoNotOptimize(index->size());
+    // Teardown of a large graph is not part of the build
+    state.PauseTiming();
+    index.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+  state.SetLabel(magic_core::to_string(static_cast<VectorIndexType>(state.range(1))));
+}
+
+void BM_VectorIndexSearch(benchmark::State &state) {
+  const VectorIndex &index = shared_index(static_cast<size_t>(state.range(0)), state.range(1));
+  const std::vector<float> queries = random_vectors(QUERIES, 99);
+  size_t next = 0;
+  for (auto _ : state) {
+    const std::vector<float> query(queries.begin() + next * DIMENSION,
+                                   queries.begin() + (next + 1) * DIMENSION);
+    benchmark::DoNotOptimize(index.search(query, K));
+    next = (next + 1) % QUERIES;
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+  // 0 when too few vectors to train the quantizer, so the index is still flat
+  state.counters["configured_type"] = index.uses_configured_type();
+  state.SetLabel(magic_core::to_string(static_cast<VectorIndexType>(state.range(1))));
+}
+
+void BM_VectorIndexSearchBatch(benchmark::State &state) {
+  const VectorIndex &index = shared_index(static_cast<size_t>(state.range(0)), state.range(1));
+  const std::vector<float> queries = random_vectors(QUERIES, 99);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index.search_batch(queries, K));
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * QUERIES));
+  state.SetLabel(magic_core::to_string(static_cast<VectorIndexType>(state.range(1))));
+}
+
+void register_cases() {
+  std::vector<int64_t> sizes = {10000, 100000};
+  const char *large = std::getenv("MAGIC_BENCHMARK_LARGE");
+  if (large && std::string(large) == "1") {
+    sizes.push_back(1000000);
+  }
+  const std::vector<int64_t> types = {static_cast<int64_t>(VectorIndexType::Flat),
+                                      static_cast<int64_t>(VectorIndexType::Hnsw),
+                                      static_cast<int64_t>(VectorIndexType::HnswSq8),
+                                      static_cast<int64_t>(VectorIndexType::IvfPq)};
+  benchmark::RegisterBenchmark("BM_VectorIndexBuild", BM_VectorIndexBuild)
+      ->ArgsProduct({sizes, types})
+      ->Iterations(1)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_VectorIndexSearch", BM_VectorIndexSearch)
+      ->ArgsProduct({sizes, types})
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("BM_VectorIndexSearchBatch", BM_VectorIndexSearchBatch)
+      ->ArgsProduct({sizes, types})
+      ->Unit(benchmark::kMillisecond);
+}
+
+// Registered at load time like BENCHMARK(), but with sizes that depend on the environment
+[[maybe_unused]] const bool registered = (register_cases(), true);
+
+}  // namespace
+}  // namespace magic_benchmarks
@@ -0,0 +1,134 @@
+// Times the vector_math kernels against the scalar loops they replaced, on embedding-sized
+// vectors. Usage: vector_math_benchmark [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "magic_core/types/vector_math.hpp"
+
+namespace {
+
+namespace vector_math = magic_core::vector_math;
+
+constexpr size_t DIMENSION = 1024;
+constexpr size_t CHUNKS_PER_DOCUMENT = 32;
+
+// Keeps results alive so the timed loops are not optimized away
+volatile float sink = 0.0f;
+
+template <typename F>
+double nanoseconds_per_call(int iterations, F &&body) {
+  for (int i = 0; i < iterations / 10 + 1; ++i) {
+    body();
+  }
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    body();
+  }
+  const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+void report(const std::string &name, double scalar_ns, double kernel_ns) {
+  std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(12) << scalar_ns << " ns" << std::setw(12)
+            << kernel_ns << " ns" << std::setw(9) << std::setprecision(2)
+            << scalar_ns / kernel_ns << "x" << std::endl;
+}
+
+float scalar_dot(const float *a, const float *b, size_t n) {
+  float total = 0.0f;
+  for (size_t i = 0; i < n; ++i) {
+    total += a[i] * b[i];
+  }
+  return total;
+}
+
+void scalar_normalize(std::vector<float> &v) {
+  float norm = 0.0f;
+  for (float x : v) {
+    norm += x * x;
+  }
+  norm = std::sqrt(norm);
+  if (norm > 0.0f) {
+    for (float &x : v) {
+      x /= norm;
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+  if (iterations <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [iterations]" << std::endl;
+    return 1;
+  }
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+  std::vector<std::vector<float>> chunks(CHUNKS_PER_DOCUMENT, std::vector<float>(DIMENSION));
+  std::vector<const float *> chunk_pointers;
+  for (auto &chunk : chunks) {
+    for (float &x : chunk) {
+      x = uniform(rng);
+    }
+    chunk_pointers.push_back(chunk.data());
+  }
+  std::vector<float> out(DIMENSION);
+
+  std::cout << "kernel: " << vector_math::kernel_name() << ", dimension " << DIMENSION
+            << ", " << iterations << " iterations" << std::endl;
+  std::cout << std::left << std::setw(28) << "case" << std::right << std::setw(15) << "scalar"
+            << std::setw(15) << "kernel" << std::setw(10) << "speedup" << std::endl;
+
+  report("dot",
+         nanoseconds_per_call(iterations, [&] {
+           sink = scalar_dot(chunks[0].data(), chunks[1].data(), DIMENSION);
+         }),
+         nanoseconds_per_call(iterations, [&] {
+           sink = vector_math::dot(chunks[0].data(), chunks[1].data(), DIMENSION);
+         }));
+
+  report("normalize",
+         nanoseconds_per_call(iterations,
+                              [&] {
+                                out = chunks[0];
+                                scalar_normalize(out);
+                                sink = out[0];
+                              }),
+         nanoseconds_per_call(iterations, [&] {
+           out = chunks[0];
+           vector_math::normalize(out);
+           sink = out[0];
+         }));
+
+  // What ProcessFileTask::finalize_document_embedding does per file
+  const int document_iterations = std::max(1, iterations / static_cast<int>(CHUNKS_PER_DOCUMENT));
+  report("document embedding (" + std::to_string(CHUNKS_PER_DOCUMENT) + ")",
+         nanoseconds_per_call(document_iterations,
+                              [&] {
+                                std::fill(out.begin(), out.end(), 0.0f);
+                                for (const auto &chunk : chunks) {
+                                  for (size_t i = 0; i < DIMENSION; ++i) {
+                                    out[i] += chunk[i];
+                                  }
+                                }
+                                scalar_normalize(out);
+                                sink = out[0];
+                              }),
+         nanoseconds_per_call(document_iterations, [&] {
+           vector_math::sum(chunk_pointers.data(), chunk_pointers.size(), DIMENSION, out.data());
+           vector_math::normalize(out);
+           sink = out[0];
+         }));
+  return 0;
+}
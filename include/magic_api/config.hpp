@@ -3,6 +3,8 @@
 #include <fstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <nlohmann/json.hpp>
 
@@ -12,7 +14,122 @@ class Config {
   std::string metadata_db_path;
   std::string ollama_url;
   std::string embedding_model;
+  // Length of embedding_model's vectors. Registered with the model the first time the database
+  // sees it; a database whose vectors came from another model keeps using that one.
+  int embedding_dimension = 1024;
+  // Ollama servers embedding requests are balanced over; defaults to just ollama_url
+  std::vector<std::string> embedding_endpoints;
   int num_workers;
+  // Upper bound the worker pool grows to while tasks back up; defaults to num_workers (fixed)
+  int max_workers = 0;
+  // Workers reserved for API requests and for directory crawls, both out of num_workers
+  int interactive_workers = 0;
+  int bulk_workers = 0;
+  // Memory every worker's file processing may hold at once, 0 for no limit. Files wait for room
+  // and those too large to chunk whole within it are streamed.
+  int worker_memory_budget_mb = 0;
+  // Threads serving HTTP requests; each gets a read connection of its own
+  int http_threads = 4;
+  // "tokenizer" section: vocab used to size chunks in model tokens, empty to estimate
+  std::string tokenizer_vocab_path;
+  bool tokenizer_lowercase = true;
+  // "search" section: LRU sizes, 0 disables a cache
+  int search_query_cache_entries = 256;
+  int search_result_cache_entries = 0;
+  // Threads answering search requests, and how many requests may wait for one before the
+  // server answers 503
+  int search_threads = 4;
+  int search_queue_depth = 64;
+  // Files the file index shortlists for the chunk stage, 0 for k, and whether their chunks are
+  // scored exactly (true) or searched in the chunk index
+  int search_file_shortlist = 0;
+  bool search_exact_chunk_scan = true;
+  // Chunk vectors of recently searched files kept in memory for the exact scan, 0 to disable
+  int search_chunk_slab_cache_mb = 128;
+  // "rerank" section: cross-encoder (a /v1/rerank server) that re-orders the first-stage hits
+  // of vector and hybrid searches, candidates chunks of them, empty url to skip. They go out
+  // batch_size at a time cut to max_chars; what is not scored in budget_ms keeps its order.
+  std::string rerank_url;
+  std::string rerank_model;
+  int rerank_candidates = 50;
+  int rerank_batch_size = 16;
+  int rerank_budget_ms = 150;
+  int rerank_max_chars = 2048;
+  // "ingest" section: the same for /process_file and /process_directory, which only queue
+  // tasks but crawl the tree first for a directory
+  int ingest_threads = 2;
+  int ingest_queue_depth = 32;
+  // "embedding_cache" section: fingerprints of recently embedded chunks kept to reuse their
+  // vectors for near-identical chunks (0 disables), and how many of 64 SimHash bits may differ
+  int embedding_cache_near_duplicate_entries = 0;
+  int embedding_cache_near_duplicate_distance = 7;
+  // "generation" section: the model files are summarized and categorized with once embedded,
+  // empty to only embed them. Its workers are on top of num_workers..max_workers; a request
+  // waits at most request_timeout_s and sends the first max_input_chars of the file's text.
+  std::string generation_model;
+  std::vector<std::string> generation_endpoints;
+  int generation_workers = 1;
+  int generation_request_timeout_s = 600;
+  int generation_max_input_chars = 12000;
+  // "remote_workers" section: magic_worker requests handled at once before answering 429,
+  // 0 for no limit
+  int remote_worker_max_in_flight = 16;
+  // "vector_index" section: ANN structure for the file and chunk indexes. Changing the type
+  // discards the saved snapshots, which are then rebuilt from the database on the next start.
+  std::string vector_index_type = "hnsw";
+  // "l2", or "cosine" for inner product over normalized vectors (file and chunk vectors alike).
+  // Changing it rebuilds the indexes the same way.
+  std::string vector_index_metric = "l2";
+  int vector_index_hnsw_m = 32;
+  int vector_index_ef_construction = 100;
+  // Default HNSW search beam; a /search request can override it (and nprobe) per call
+  int vector_index_ef_search = 64;
+  int vector_index_ivf_lists = 1024;
+  int vector_index_pq_subquantizers = 128;
+  int vector_index_nprobe = 16;
+  // CUDA device IVF-PQ rebuilds and batched searches run on, -1 for none. Needs a build with
+  // MAGIC_FAISS_GPU; anything the GPU cannot take falls back to the CPU.
+  int vector_index_gpu_device = -1;
+  int vector_index_gpu_min_batch = 16;
+  // "vector_store" section: how segment files keep vectors on disk (float32, float16 or int8).
+  // Existing segments are rewritten in the new encoding by the compaction on the next start.
+  std::string vector_store_encoding = "float32";
+  // "database" section: SQLCipher settings, which have to match the ones the database was
+  // created with, and how many connections each pool opens before it is first used
+  bool database_raw_key = true;
+  int database_kdf_iter = 256000;
+  int database_cipher_page_size = 4096;
+  int database_min_connections = 1;
+  // Metadata databases files are spread over, each with its own writer, and how a path picks
+  // one: "hash" of the path, or "folder", the shard_roots entry it is under (root i goes to
+  // shard i % shards). Fixed once files are stored.
+  int database_shards = 1;
+  std::string database_shard_by = "hash";
+  std::vector<std::string> database_shard_roots;
+  // "collections" section: (name, root) of folders with a database and indexes of their own,
+  // searched alone when a /search names them. Files under no root go to "default". Takes the
+  // place of database.shards; fixed once files are stored.
+  std::vector<std::pair<std::string, std::string>> collections;
+  // "watch" section: the inbox the file watcher keeps indexed
+  bool watch_enabled = false;
+  std::string watch_inbox_root;
+  bool watch_recursive = true;
+  int watch_settle_ms = 1500;
+  std::vector<std::string> watch_ignore;
+  // "log" section: the least severe level written (debug, info, warning, error or off)
+  std::string log_level = "info";
+  // "tracing" section: file every request and task trace is appended to as OTLP/JSON, empty to
+  // trace only requests that ask for their timing
+  std::string tracing_export_path;
+  // "startup" section: the server answers while the indexes load, then warms up before it
+  // reports ready. prefault_vectors reads the vector segments into the page cache, warm_up_model
+  // has every embedding endpoint load the model with a throwaway embedding.
+  bool startup_prefault_vectors = false;
+  bool startup_warm_up_model = false;
+  // "snapshot" section: how POST /snapshot copies the databases, vectors and indexes; a
+  // max_mb_per_s of 0 copies as fast as the disks allow
+  int snapshot_pages_per_step = 256;
+  int snapshot_max_mb_per_s = 64;
 
   // Load configuration from a JSON file at the given path
   static Config from_file(const std::string& filename) {
@@ -40,6 +157,9 @@ class Config {
     config.metadata_db_path = json_config.value("metadata_db_path", std::string("./data/metadata.db"));
     config.ollama_url = json_config.value("ollama_url", std::string("http://localhost:11434"));
     config.embedding_model = json_config.value("embedding_model", std::string("mxbai-embed-large"));
+    config.embedding_endpoints =
+        json_config.value("embedding_endpoints", std::vector<std::string>{config.ollama_url});
+    config.embedding_dimension = json_config.value("embedding_dimension", 1024);
 
     // Handle integer with default and basic type safety
     try {
@@ -53,6 +173,146 @@ class Config {
       config.num_workers = 1;
     }
 
+    config.max_workers = json_config.value("max_workers", config.num_workers);
+    config.interactive_workers = json_config.value("interactive_workers", 0);
+    config.bulk_workers = json_config.value("bulk_workers", 0);
+    config.worker_memory_budget_mb = json_config.value("worker_memory_budget_mb", 0);
+    config.http_threads = json_config.value("http_threads", 4);
+
+    nlohmann::json tokenizer = json_config.value("tokenizer", nlohmann::json::object());
+    if (tokenizer.is_object()) {
+      config.tokenizer_vocab_path = tokenizer.value("vocab_path", std::string());
+      config.tokenizer_lowercase = tokenizer.value("lowercase", true);
+    }
+
+    nlohmann::json search = json_config.value("search", nlohmann::json::object());
+    if (search.is_object()) {
+      config.search_query_cache_entries = search.value("query_cache_entries", 256);
+      config.search_result_cache_entries = search.value("result_cache_entries", 0);
+      config.search_threads = search.value("threads", 4);
+      config.search_queue_depth = search.value("queue_depth", 64);
+      config.search_file_shortlist = search.value("file_shortlist", 0);
+      config.search_exact_chunk_scan = search.value("exact_chunk_scan", true);
+      config.search_chunk_slab_cache_mb = search.value("chunk_slab_cache_mb", 128);
+    }
+
+    nlohmann::json rerank = json_config.value("rerank", nlohmann::json::object());
+    if (rerank.is_object()) {
+      config.rerank_url = rerank.value("url", std::string());
+      config.rerank_model = rerank.value("model", std::string());
+      config.rerank_candidates = rerank.value("candidates", 50);
+      config.rerank_batch_size = rerank.value("batch_size", 16);
+      config.rerank_budget_ms = rerank.value("budget_ms", 150);
+      config.rerank_max_chars = rerank.value("max_chars", 2048);
+    }
+
+    nlohmann::json ingest = json_config.value("ingest", nlohmann::json::object());
+    if (ingest.is_object()) {
+      config.ingest_threads = ingest.value("threads", 2);
+      config.ingest_queue_depth = ingest.value("queue_depth", 32);
+    }
+
+    nlohmann::json embedding_cache =
+        json_config.value("embedding_cache", nlohmann::json::object());
+    if (embedding_cache.is_object()) {
+      config.embedding_cache_near_duplicate_entries =
+          embedding_cache.value("near_duplicate_entries", 0);
+      config.embedding_cache_near_duplicate_distance =
+          embedding_cache.value("near_duplicate_distance", 7);
+    }
+
+    config.generation_endpoints = config.embedding_endpoints;
+    nlohmann::json generation = json_config.value("generation", nlohmann::json::object());
+    if (generation.is_object()) {
+      config.generation_model = generation.value("model", std::string());
+      config.generation_endpoints = generation.value("endpoints", config.embedding_endpoints);
+      config.generation_workers = generation.value("workers", 1);
+      config.generation_request_timeout_s = generation.value("request_timeout_s", 600);
+      config.generation_max_input_chars = generation.value("max_input_chars", 12000);
+    }
+
+    nlohmann::json remote_workers =
+        json_config.value("remote_workers", nlohmann::json::object());
+    if (remote_workers.is_object()) {
+      config.remote_worker_max_in_flight = remote_workers.value("max_in_flight", 16);
+    }
+
+    nlohmann::json vector_index = json_config.value("vector_index", nlohmann::json::object());
+    if (vector_index.is_object()) {
+      config.vector_index_type = vector_index.value("type", std::string("hnsw"));
+      config.vector_index_metric = vector_index.value("metric", std::string("l2"));
+      config.vector_index_hnsw_m = vector_index.value("hnsw_m", 32);
+      config.vector_index_ef_construction = vector_index.value("ef_construction", 100);
+      config.vector_index_ef_search = vector_index.value("ef_search", 64);
+      config.vector_index_ivf_lists = vector_index.value("ivf_lists", 1024);
+      config.vector_index_pq_subquantizers = vector_index.value("pq_subquantizers", 128);
+      config.vector_index_nprobe = vector_index.value("nprobe", 16);
+      config.vector_index_gpu_device = vector_index.value("gpu_device", -1);
+      config.vector_index_gpu_min_batch = vector_index.value("gpu_min_batch", 16);
+    }
+
+    nlohmann::json vector_store = json_config.value("vector_store", nlohmann::json::object());
+    if (vector_store.is_object()) {
+      config.vector_store_encoding = vector_store.value("encoding", std::string("float32"));
+    }
+
+    nlohmann::json database = json_config.value("database", nlohmann::json::object());
+    if (database.is_object()) {
+      config.database_raw_key = database.value("raw_key", true);
+      config.database_kdf_iter = database.value("kdf_iter", 256000);
+      config.database_cipher_page_size = database.value("cipher_page_size", 4096);
+      config.database_min_connections = database.value("min_connections", 1);
+      config.database_shards = database.value("shards", 1);
+      config.database_shard_by = database.value("shard_by", std::string("hash"));
+      config.database_shard_roots =
+          database.value("shard_roots", std::vector<std::string>{});
+    }
+
+    nlohmann::json collections = json_config.value("collections", nlohmann::json::array());
+    if (!collections.is_array()) {
+      throw std::runtime_error("collections must be an array of {\"name\", \"root\"} objects");
+    }
+    for (const auto &collection : collections) {
+      if (!collection.is_object() || !collection.value("name", nlohmann::json()).is_string() ||
+          !collection.value("root", nlohmann::json()).is_string()) {
+        throw std::runtime_error("collections must be an array of {\"name\", \"root\"} objects");
+      }
+      config.collections.emplace_back(collection["name"].get<std::string>(),
+                                      collection["root"].get<std::string>());
+    }
+
+    nlohmann::json watch = json_config.value("watch", nlohmann::json::object());
+    if (watch.is_object()) {
+      config.watch_enabled = watch.value("enabled", false);
+      config.watch_inbox_root = watch.value("inbox_root", std::string("./MagicFolder/Drop"));
+      config.watch_recursive = watch.value("recursive", true);
+      config.watch_settle_ms = watch.value("settle_ms", 1500);
+      config.watch_ignore = watch.value(
+          "ignore", std::vector<std::string>{"*.tmp", ".DS_Store", "*.part", "*.crdownload", "~*"});
+    }
+
+    nlohmann::json log = json_config.value("log", nlohmann::json::object());
+    if (log.is_object()) {
+      config.log_level = log.value("level", std::string("info"));
+    }
+
+    nlohmann::json tracing = json_config.value("tracing", nlohmann::json::object());
+    if (tracing.is_object()) {
+      config.tracing_export_path = tracing.value("export_path", std::string());
+    }
+
+    nlohmann::json startup = json_config.value("startup", nlohmann::json::object());
+    if (startup.is_object()) {
+      config.startup_prefault_vectors = startup.value("prefault_vectors", false);
+      config.startup_warm_up_model = startup.value("warm_up_model", false);
+    }
+
+    nlohmann::json snapshot = json_config.value("snapshot", nlohmann::json::object());
+    if (snapshot.is_object()) {
+      config.snapshot_pages_per_step = snapshot.value("pages_per_step", 256);
+      config.snapshot_max_mb_per_s = snapshot.value("max_mb_per_s", 64);
+    }
+
     config.validate();
     return config;
   }
@@ -68,11 +328,125 @@ class Config {
     if (ollama_url.empty()) {
       throw std::runtime_error("ollama_url cannot be empty");
     }
+    if (embedding_endpoints.empty()) {
+      throw std::runtime_error("embedding_endpoints cannot be empty");
+    }
     if (embedding_model.empty()) {
       throw std::runtime_error("embedding_model cannot be empty");
     }
+    if (embedding_dimension <= 0) {
+      throw std::runtime_error("embedding_dimension must be greater than 0");
+    }
     if (num_workers <= 0) {
       throw std::runtime_error("num_workers must be greater than 0");
     }
+    if (max_workers < num_workers) {
+      throw std::runtime_error("max_workers cannot be less than num_workers");
+    }
+    if (interactive_workers < 0 || bulk_workers < 0 ||
+        interactive_workers + bulk_workers > num_workers) {
+      throw std::runtime_error("interactive_workers and bulk_workers must fit in num_workers");
+    }
+    if (worker_memory_budget_mb < 0) {
+      throw std::runtime_error("worker_memory_budget_mb cannot be negative");
+    }
+    if (http_threads <= 0) {
+      throw std::runtime_error("http_threads must be greater than 0");
+    }
+    if (search_query_cache_entries < 0 || search_result_cache_entries < 0 ||
+        search_chunk_slab_cache_mb < 0) {
+      throw std::runtime_error("search cache sizes cannot be negative");
+    }
+    if (snapshot_pages_per_step <= 0) {
+      throw std::runtime_error("snapshot.pages_per_step must be greater than 0");
+    }
+    if (snapshot_max_mb_per_s < 0) {
+      throw std::runtime_error("snapshot.max_mb_per_s cannot be negative");
+    }
+    if (search_threads <= 0 || search_queue_depth <= 0) {
+      throw std::runtime_error("search.threads and search.queue_depth must be greater than 0");
+    }
+    if (search_file_shortlist < 0) {
+      throw std::runtime_error("search.file_shortlist cannot be negative");
+    }
+    if (!rerank_url.empty() && (rerank_candidates <= 0 || rerank_batch_size <= 0 ||
+                                rerank_budget_ms <= 0 || rerank_max_chars <= 0)) {
+      throw std::runtime_error("rerank candidates, batch_size, budget_ms and max_chars must be "
+                               "greater than 0");
+    }
+    if (ingest_threads <= 0 || ingest_queue_depth <= 0) {
+      throw std::runtime_error("ingest.threads and ingest.queue_depth must be greater than 0");
+    }
+    if (embedding_cache_near_duplicate_entries < 0 ||
+        embedding_cache_near_duplicate_distance < 0 ||
+        embedding_cache_near_duplicate_distance > 8) {
+      throw std::runtime_error("embedding_cache.near_duplicate_entries cannot be negative, "
+                               "near_duplicate_distance must be 0 to 8");
+    }
+    if (!generation_model.empty() &&
+        (generation_endpoints.empty() || generation_workers <= 0 ||
+         generation_request_timeout_s <= 0 || generation_max_input_chars <= 0)) {
+      throw std::runtime_error("generation needs endpoints, and its workers, request_timeout_s "
+                               "and max_input_chars must be greater than 0");
+    }
+    if (remote_worker_max_in_flight < 0) {
+      throw std::runtime_error("remote_workers.max_in_flight cannot be negative");
+    }
+    if (vector_index_type != "flat" && vector_index_type != "hnsw" &&
+        vector_index_type != "hnsw_sq8" && vector_index_type != "ivf_pq") {
+      throw std::runtime_error("vector_index.type must be one of flat, hnsw, hnsw_sq8, ivf_pq");
+    }
+    if (vector_index_metric != "l2" && vector_index_metric != "cosine") {
+      throw std::runtime_error("vector_index.metric must be l2 or cosine");
+    }
+    if (vector_index_hnsw_m <= 0 || vector_index_ef_construction <= 0 ||
+        vector_index_ef_search <= 0 ||
+        vector_index_ivf_lists <= 0 || vector_index_pq_subquantizers <= 0 ||
+        vector_index_nprobe <= 0) {
+      throw std::runtime_error("vector_index parameters must be greater than 0");
+    }
+    if (vector_index_gpu_device < -1 || vector_index_gpu_min_batch < 1) {
+      throw std::runtime_error("vector_index.gpu_device must be -1 or a device number, "
+                               "gpu_min_batch at least 1");
+    }
+    if (vector_store_encoding != "float32" && vector_store_encoding != "float16" &&
+        vector_store_encoding != "int8") {
+      throw std::runtime_error("vector_store.encoding must be one of float32, float16, int8");
+    }
+    if (database_kdf_iter <= 0 || database_min_connections < 0) {
+      throw std::runtime_error("database.kdf_iter must be positive, min_connections not negative");
+    }
+    if (database_shards < 1 || database_shards > 16) {
+      throw std::runtime_error("database.shards must be 1 to 16");
+    }
+    if (database_shard_by != "hash" && database_shard_by != "folder") {
+      throw std::runtime_error("database.shard_by must be hash or folder");
+    }
+    // SQLCipher accepts powers of two from 512 to 65536
+    if (database_cipher_page_size < 512 || database_cipher_page_size > 65536 ||
+        (database_cipher_page_size & (database_cipher_page_size - 1)) != 0) {
+      throw std::runtime_error("database.cipher_page_size must be a power of two, 512 to 65536");
+    }
+    if (!collections.empty() && database_shards != 1) {
+      throw std::runtime_error("collections and database.shards cannot both be set");
+    }
+    if (collections.size() > 15) {
+      throw std::runtime_error("At most 15 collections can be configured");
+    }
+    for (const auto &[name, root] : collections) {
+      if (name.empty() || root.empty()) {
+        throw std::runtime_error("Every collection needs a name and a root");
+      }
+    }
+    if (watch_enabled && watch_inbox_root.empty()) {
+      throw std::runtime_error("watch.inbox_root cannot be empty when watching is enabled");
+    }
+    if (watch_settle_ms < 0) {
+      throw std::runtime_error("watch.settle_ms cannot be negative");
+    }
+    if (log_level != "debug" && log_level != "info" && log_level != "warning" &&
+        log_level != "error" && log_level != "off") {
+      throw std::runtime_error("log.level must be one of debug, info, warning, error, off");
+    }
   }
 };
\ No newline at end of file
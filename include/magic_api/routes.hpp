@@ -1,6 +1,10 @@
 #pragma once
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "server.hpp"
 
@@ -11,7 +15,19 @@ class FileDeleteService;
 class FileInfoService;
 class SearchService;
 class TaskQueueRepo;
+class RemoteTaskService;
+struct TaskUpdate;
+struct VectorSearchOptions;
+struct ChunkContentOptions;
+struct SearchFilter;
+enum class SearchMode;
+enum class ResponseFormat;
 }  // namespace magic_core
+namespace magic_core::async {
+class BoundedExecutor;
+class InFlightLimiter;
+class Readiness;
+}  // namespace magic_core::async
 
 namespace magic_api {
 
@@ -21,7 +37,12 @@ class Routes {
          std::shared_ptr<magic_core::FileDeleteService> file_delete_service,
          std::shared_ptr<magic_core::FileInfoService> file_info_service,
          std::shared_ptr<magic_core::SearchService> search_service,
-         std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo);
+         std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo,
+         std::shared_ptr<magic_core::RemoteTaskService> remote_task_service,
+         std::shared_ptr<magic_core::async::BoundedExecutor> search_executor = nullptr,
+         std::shared_ptr<magic_core::async::BoundedExecutor> ingest_executor = nullptr,
+         std::shared_ptr<magic_core::async::InFlightLimiter> worker_limiter = nullptr,
+         std::shared_ptr<const magic_core::async::Readiness> readiness = nullptr);
   ~Routes() = default;
 
   // Disable copy constructor and assignment
@@ -35,19 +56,103 @@ class Routes {
   // Register all routes with the server
   void register_routes(Server &server);
 
+  // Upper bound on the queries of one /search/batch request
+  static constexpr size_t MAX_BATCH_QUERIES = 256;
+  // Upper bounds on the per-request ef_search and nprobe overrides; each costs search time
+  // roughly in proportion, so one request must not be able to ask for the whole index
+  static constexpr int MAX_EF_SEARCH = 4096;
+  static constexpr int MAX_NPROBE = 1024;
+  // Upper bound on the tasks one /tasks/claim request takes
+  static constexpr int MAX_CLAIMED_TASKS = 16;
+  // Page sizes of the /files and /tasks listings
+  static constexpr int DEFAULT_PAGE_SIZE = 100;
+  static constexpr int MAX_PAGE_SIZE = 1000;
+  // Files read per query while exporting NDJSON
+  static constexpr int EXPORT_PAGE_SIZE = 1000;
+  // Upper bound on the tasks one /tasks/stream connection follows at once
+  static constexpr size_t MAX_TASK_SUBSCRIPTIONS = 1000;
+  // A request sending this header as "1" gets its stage timings back in Server-Timing
+  static constexpr const char *TIMING_HEADER = "X-Magic-Timing";
+
  private:
   std::shared_ptr<magic_core::FileProcessingService> file_processing_service_;
   std::shared_ptr<magic_core::FileDeleteService> file_delete_service_;
   std::shared_ptr<magic_core::FileInfoService> file_info_service_;
   std::shared_ptr<magic_core::SearchService> search_service_;
   std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo_;
+  std::shared_ptr<magic_core::RemoteTaskService> remote_task_service_;
+  // Run the search and ingest handlers off Crow's threads; null runs them inline
+  std::shared_ptr<magic_core::async::BoundedExecutor> search_executor_;
+  std::shared_ptr<magic_core::async::BoundedExecutor> ingest_executor_;
+  // Caps the remote worker requests handled at once; null leaves them unlimited
+  std::shared_ptr<magic_core::async::InFlightLimiter> worker_limiter_;
+  // Until it is ready, searches, ingestion and remote workers get 503; null is always ready
+  std::shared_ptr<const magic_core::async::Readiness> readiness_;
+
+  // The /search/stream connections still open, each with the serial it opened under. Crow
+  // frees a connection once it closes, so a search that outlives its client checks here, under
+  // the mutex, before each send; the serial tells a later connection at the same address apart.
+  struct OpenConnections {
+    std::mutex mutex;
+    std::unordered_map<crow::websocket::connection *, uint64_t> connections;
+    uint64_t next_serial = 0;
+  };
+  std::shared_ptr<OpenConnections> search_streams_ = std::make_shared<OpenConnections>();
+
+  // Which /tasks/stream connections follow which tasks. The task queue's update listener holds
+  // it too and pushes every update to the task's subscribers; closing removes a connection.
+  struct TaskSubscriptions {
+    std::mutex mutex;
+    std::unordered_map<crow::websocket::connection *, std::unordered_set<long long>>
+        by_connection;
+    std::unordered_map<long long, std::unordered_set<crow::websocket::connection *>> by_task;
+
+    // Sends update to its task's subscribers; a finished task drops them all
+    void publish(const magic_core::TaskUpdate &update);
+    void unsubscribe(crow::websocket::connection *conn, long long task_id);
+    void remove(crow::websocket::connection *conn);
+  };
+  std::shared_ptr<TaskSubscriptions> task_streams_ = std::make_shared<TaskSubscriptions>();
+
+  using RequestHandler = crow::response (Routes::*)(const crow::request &);
+  // Answers req from handler on executor, or 503 right away when its queue is full or the
+  // server is still warming up
+  void dispatch(magic_core::async::BoundedExecutor *executor,
+                const crow::request &req,
+                crow::response &res,
+                RequestHandler handler);
+  // Runs handler under a permit from limiter, or answers 429 when none is left (503 while
+  // warming up)
+  crow::response limited(magic_core::async::InFlightLimiter *limiter,
+                         const std::function<crow::response()> &handler);
+  // Runs handler, or answers 503 while warming up; for the write routes that need neither an
+  // executor nor a limiter, since a write during the index load could be undone by it
+  crow::response when_ready(const std::function<crow::response()> &handler);
+  crow::response create_overload_response(const std::string &error, int status_code);
+  bool warming() const;
 
   // Route handlers
   crow::response handle_health_check(const crow::request &req);
+  // Every registered metric in the Prometheus text format
+  crow::response handle_metrics(const crow::request &req);
   crow::response handle_process_file(const crow::request &req);
+  crow::response handle_process_directory(const crow::request &req);
   crow::response handle_search(const crow::request &req);
+  crow::response handle_search_batch(const crow::request &req);
+  // One /search/stream message: a /search body, answered with a files event, one chunk event
+  // per chunk and a done event (or a single error event), each its own text message
+  void handle_search_stream(crow::websocket::connection &conn, const std::string &message);
+  // Sends text over conn unless the connection opened as serial has closed
+  void send_search_event(crow::websocket::connection *conn,
+                         uint64_t serial,
+                         const std::string &text);
   crow::response handle_file_search(const crow::request &req);
-  crow::response handle_list_files(const crow::request &req);
+  crow::response handle_get_chunk(const crow::request &req, int chunk_id);
+  void handle_list_files(const crow::request &req, crow::response &res);
+  // Writes every file into res as NDJSON; the caller ends it
+  void stream_files_ndjson(crow::response &res);
+  crow::response handle_get_compression_dictionary(const crow::request &req, unsigned int id);
+  crow::response handle_list_collections(const crow::request &req);
   crow::response handle_get_file_info(const crow::request &req, const std::string &path);
   crow::response handle_delete_file(const crow::request &req, const std::string &path);
   
@@ -56,16 +161,48 @@ class Routes {
   crow::response handle_get_task_status(const crow::request &req, const std::string &task_id);
   crow::response handle_get_task_progress(const crow::request &req, const std::string &task_id);
   crow::response handle_clear_completed_tasks(const crow::request &req);
+  // {"path": dir}: queues a SNAPSHOT of the databases, vectors and indexes into dir
+  crow::response handle_snapshot(const crow::request &req);
+  // One /tasks/stream message: {"subscribe": [ids], "unsubscribe": [ids]}. Each newly followed
+  // task gets its current state right away, then every update as the queue sees it.
+  void handle_task_stream(crow::websocket::connection &conn, const std::string &message);
+
+  // Remote worker endpoints; a lost lease answers 409
+  crow::response handle_claim_tasks(const crow::request &req);
+  crow::response handle_renew_task_lease(const crow::request &req, const std::string &task_id);
+  crow::response handle_complete_task(const crow::request &req, const std::string &task_id);
+  crow::response handle_fail_task(const crow::request &req, const std::string &task_id);
 
   // Helper methods
   nlohmann::json parse_json_body(const std::string &body);
   std::string extract_file_path_from_request(const crow::request &req);
   std::string extract_search_query_from_request(const crow::request &req);
   int extract_top_k_from_request(const crow::request &req);
+  // Optional "after_id" / "limit" query parameters; throws std::invalid_argument when invalid
+  std::pair<int64_t, int> extract_page_from_request(const crow::request &req);
+  // Optional "ef_search" / "nprobe" body fields; throws std::invalid_argument unless positive
+  magic_core::VectorSearchOptions extract_search_tuning_from_request(const crow::request &req);
+  // Optional "chunk_content" (full / snippet / none) and "snippet_chars" body fields; throws
+  // std::invalid_argument when invalid
+  magic_core::ChunkContentOptions extract_chunk_content_from_request(const crow::request &req);
+  // Optional "mode" (vector / hybrid / lexical) body field; throws std::invalid_argument when
+  // invalid
+  magic_core::SearchMode extract_search_mode_from_request(const crow::request &req);
+  // Optional "file_types" (array of Text / PDF / Markdown / Code / Unknown), "path_prefix",
+  // "collections" (array of names) and "modified_after" / "modified_before" (epoch
+  // milliseconds) body fields; throws std::invalid_argument when invalid
+  magic_core::SearchFilter extract_search_filter_from_request(const crow::request &req);
   nlohmann::json create_success_response(const std::string &message,
                                          const nlohmann::json &data = nlohmann::json{});
   nlohmann::json create_error_response(const std::string &error);
   crow::response create_json_response(const nlohmann::json &json_data, int status_code = 200);
+  // Compresses res's body with the best encoding the "Accept-Encoding" header allows, when it is
+  // big enough to be worth it and not encoded already
+  void compress_response(const crow::request &req, crow::response &res);
+  // A 200 with a body SearchResponseEncoder wrote in format
+  crow::response create_search_response(std::string body, magic_core::ResponseFormat format);
+  // The response format the "Accept" header asks for; JSON unless it lists MessagePack
+  magic_core::ResponseFormat extract_response_format_from_request(const crow::request &req);
 };
 
 }  // namespace magic_api
\ No newline at end of file
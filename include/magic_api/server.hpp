@@ -6,7 +6,7 @@
 namespace magic_api {
 class Server {
  public:
-  Server(const std::string &host, int port);
+  Server(const std::string &host, int port, int threads = 4);
   ~Server() = default;
 
   // Disable move and copy operations since crow::SimpleApp doesn't support them
@@ -31,6 +31,7 @@ class Server {
   crow::SimpleApp app_;
   std::string host_;
   int port_;
+  int threads_;
   std::future<void> server_thread_future_;  // Manages the server thread
   bool running_ = false;
 };
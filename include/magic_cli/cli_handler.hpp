@@ -20,13 +20,19 @@ namespace magic_cli
     ListTasks,
     TaskStatus,
     TaskProgress,
-    ClearTasks
+    ClearTasks,
+    // Online backup of the server's databases, vectors and indexes into a directory
+    Snapshot,
+    // process/search/filesearch for every line of stdin or a file
+    Batch
   };
 
   struct CliOptions
   {
     Command command;
     std::string file_path;
+    std::string dir_path;  // process --dir: files to queue; snapshot --dir: where to write
+    bool bulk_load;        // process --dir --bulk: import it as a bulk load
     std::string query;
     int top_k;
     std::string api_base_url;
@@ -37,6 +43,11 @@ namespace magic_cli
     std::string task_id;
     std::string status_filter;
     int older_than_days;
+    // Batch options: the command run per line, where the lines come from (empty for stdin) and
+    // how many requests are kept in flight
+    Command batch_command;
+    std::string input_path;
+    int parallel;
   };
 
   class CliError : public std::exception
@@ -97,6 +108,10 @@ namespace magic_cli
     void handle_task_status_command(const CliOptions &options);
     void handle_task_progress_command(const CliOptions &options);
     void handle_clear_tasks_command(const CliOptions &options);
+    void handle_snapshot_command(const CliOptions &options);
+    // One request per input line over keep-alive connections, up to options.parallel at once,
+    // each result written to stdout as an NDJSON line as soon as it arrives
+    void handle_batch_command(const CliOptions &options);
 
     // HTTP methods
     nlohmann::json make_get_request(const std::string &endpoint);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <memory>
 #include <string>
@@ -12,6 +13,20 @@ class ServiceProvider;
 using ProgressUpdater = std::function<void(float, const std::string&)>;
 
 namespace magic_core {
+// Thrown by a task that gave up on a long wait because its worker is stopping; the worker
+// hands the task back to the queue instead of recording an outcome
+class TaskInterruptedError : public std::exception {
+ public:
+  explicit TaskInterruptedError(const std::string& message) : message_(message) {}
+
+  const char* what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
 class ITask {
  public:
   ITask(long long id,
@@ -37,13 +52,26 @@ class ITask {
   TaskStatus get_status() const {
     return status_;
   }
+  // The flag of the worker running the task, set once it is asked to stop
+  void set_stop_flag(const std::atomic<bool>* stop_flag) {
+    stop_flag_ = stop_flag;
+  }
 
  protected:
+  // For tasks that wait on something slow; always false for a task run without a worker
+  bool stop_requested() const {
+    return stop_flag_ && stop_flag_->load();
+  }
+
+
   long long id_;
   TaskStatus status_;
   std::chrono::system_clock::time_point created_at_;
   std::chrono::system_clock::time_point updated_at_;
   std::optional<std::string> error_message_;
+
+ private:
+  const std::atomic<bool>* stop_flag_ = nullptr;
 };
 
 using ITaskPtr = std::unique_ptr<ITask>;
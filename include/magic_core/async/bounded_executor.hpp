@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "magic_core/async/bounded_queue.hpp"
+
+namespace magic_core::async {
+
+/**
+ * @class BoundedExecutor
+ * @brief A fixed set of threads running jobs from a queue of fixed depth, shedding the rest.
+ *
+ * Takes blocking work (an embedding call behind a search, a directory crawl) off the threads
+ * that accept it. At most `threads` jobs run at once and at most `queue_depth` wait; try_submit
+ * refuses anything beyond that instead of queueing without bound, so the caller can answer
+ * "busy" right away rather than letting latency grow.
+ */
+class BoundedExecutor {
+ public:
+  using Job = std::function<void()>;
+
+  // name only labels log lines
+  BoundedExecutor(std::string name, size_t threads, size_t queue_depth);
+  // Runs the jobs already queued, then joins the threads
+  ~BoundedExecutor();
+
+  BoundedExecutor(const BoundedExecutor &) = delete;
+  BoundedExecutor &operator=(const BoundedExecutor &) = delete;
+
+  // Queues job unless the queue is full or shut down. Jobs should not throw; if one does, the
+  // error is logged and dropped.
+  bool try_submit(Job job);
+  // Refuses new jobs, runs the queued ones and joins the threads. Idempotent.
+  void shutdown();
+
+  // Jobs waiting for a thread
+  size_t queued() const {
+    return queue_.size();
+  }
+  // Jobs running right now
+  size_t active() const {
+    return active_.load(std::memory_order_relaxed);
+  }
+  size_t rejected() const {
+    return rejected_.load(std::memory_order_relaxed);
+  }
+  size_t threads() const {
+    return threads_.size();
+  }
+  size_t queue_depth() const {
+    return queue_.capacity();
+  }
+
+ private:
+  void thread_loop();
+
+  const std::string name_;
+  BoundedQueue<Job> queue_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> active_{0};
+  std::atomic<size_t> rejected_{0};
+  std::atomic<bool> shut_down_{false};
+};
+
+}  // namespace magic_core::async
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "magic_core/db/metadata_store.hpp"
+#include "magic_core/types/chunk.hpp"
+
+namespace magic_core {
+
+struct ChunkDiff {
+  // (stored row id, new chunk_index) of rows whose content is unchanged
+  std::vector<std::pair<int64_t, int>> kept;
+  // Stored rows with no counterpart in the new content
+  std::vector<int64_t> removed_ids;
+  // Positions in the new chunk list that need embedding
+  std::vector<size_t> fresh;
+};
+
+// Matches chunks to stored rows by content hash one at a time, for documents whose chunks arrive
+// as they are extracted. Repeated content takes the rows in stored order, like diff_chunks.
+class ChunkMatcher {
+ public:
+  explicit ChunkMatcher(std::vector<StoredChunk> stored);
+
+  // The stored row chunk keeps, whose vector is moved into chunk, or nullopt if chunk needs
+  // embedding
+  std::optional<int64_t> match(Chunk& chunk, const std::string& content_hash);
+  // Rows no chunk has matched so far, including the ones without a hash or vector
+  std::vector<int64_t> unmatched() const;
+
+ private:
+  std::vector<StoredChunk> stored_;
+  std::unordered_map<std::string, std::deque<size_t>> by_hash_;
+  // Rows that can never match
+  std::vector<int64_t> unusable_;
+};
+
+// Matches new chunks to stored rows by content hash, in chunk order when content repeats. A
+// matched chunk takes its row's stored vector. Rows without a hash or a usable vector are never
+// matched, so they are replaced. content_hashes[i] is the content hash of chunks[i].
+ChunkDiff diff_chunks(std::vector<Chunk>& chunks,
+                      const std::vector<std::string>& content_hashes,
+                      std::vector<StoredChunk> stored);
+
+}  // namespace magic_core
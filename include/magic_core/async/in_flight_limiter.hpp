@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace magic_core::async {
+
+/**
+ * @class InFlightLimiter
+ * @brief Caps how many callers are inside a section at once, turning the rest away.
+ *
+ * Nothing waits: try_acquire either grants a permit, released when it goes out of scope, or
+ * fails right away so the caller can refuse the request. A limit of 0 grants every permit.
+ */
+class InFlightLimiter {
+ public:
+  class Permit {
+   public:
+    Permit() = default;
+    Permit(Permit &&other) noexcept : limiter_(other.limiter_) {
+      other.limiter_ = nullptr;
+    }
+    Permit &operator=(Permit &&other) noexcept {
+      if (this != &other) {
+        release();
+        limiter_ = other.limiter_;
+        other.limiter_ = nullptr;
+      }
+      return *this;
+    }
+    Permit(const Permit &) = delete;
+    Permit &operator=(const Permit &) = delete;
+    ~Permit() {
+      release();
+    }
+
+    explicit operator bool() const {
+      return limiter_ != nullptr;
+    }
+
+   private:
+    friend class InFlightLimiter;
+    explicit Permit(InFlightLimiter *limiter) : limiter_(limiter) {}
+
+    void release() {
+      if (limiter_) {
+        limiter_->in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+        limiter_ = nullptr;
+      }
+    }
+
+    InFlightLimiter *limiter_ = nullptr;
+  };
+
+  explicit InFlightLimiter(size_t limit) : limit_(limit) {}
+
+  InFlightLimiter(const InFlightLimiter &) = delete;
+  InFlightLimiter &operator=(const InFlightLimiter &) = delete;
+
+  // An empty permit means the limit was reached
+  Permit try_acquire() {
+    const size_t now = in_flight_.fetch_add(1, std::memory_order_acq_rel);
+    if (limit_ != 0 && now >= limit_) {
+      in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+      return Permit();
+    }
+    return Permit(this);
+  }
+
+  size_t limit() const {
+    return limit_;
+  }
+  size_t in_flight() const {
+    return in_flight_.load(std::memory_order_acquire);
+  }
+  size_t rejected() const {
+    return rejected_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  const size_t limit_;
+  std::atomic<size_t> in_flight_{0};
+  std::atomic<size_t> rejected_{0};
+};
+
+}  // namespace magic_core::async
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+
+namespace magic_core::async {
+
+/**
+ * @class MemoryBudget
+ * @brief Admission control for memory: callers reserve an estimated footprint before they
+ * allocate it, and wait while the process-wide budget is spent.
+ *
+ * Waiters are served first come, first served, so a large reservation is not starved by a
+ * stream of small ones; a reservation larger than the whole budget is cut down to it and so
+ * runs alone. The bytes come back when the reservation goes out of scope. Thread-safe.
+ */
+class MemoryBudget {
+ public:
+  class Reservation {
+   public:
+    Reservation() = default;
+    Reservation(Reservation &&other) noexcept : budget_(other.budget_), bytes_(other.bytes_) {
+      other.budget_ = nullptr;
+      other.bytes_ = 0;
+    }
+    Reservation &operator=(Reservation &&other) noexcept {
+      if (this != &other) {
+        release();
+        budget_ = other.budget_;
+        bytes_ = other.bytes_;
+        other.budget_ = nullptr;
+        other.bytes_ = 0;
+      }
+      return *this;
+    }
+    Reservation(const Reservation &) = delete;
+    Reservation &operator=(const Reservation &) = delete;
+    ~Reservation() {
+      release();
+    }
+
+    explicit operator bool() const {
+      return budget_ != nullptr;
+    }
+    // What was granted, at most the budget's capacity
+    size_t bytes() const {
+      return bytes_;
+    }
+
+   private:
+    friend class MemoryBudget;
+    Reservation(MemoryBudget *budget, size_t bytes) : budget_(budget), bytes_(bytes) {}
+
+    void release() noexcept;
+
+    MemoryBudget *budget_ = nullptr;
+    size_t bytes_ = 0;
+  };
+
+  // Throws std::invalid_argument when capacity_bytes is 0
+  explicit MemoryBudget(size_t capacity_bytes);
+
+  MemoryBudget(const MemoryBudget &) = delete;
+  MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+  // Blocks until bytes fit. While it waits, still_waiting is called every interval, e.g. to
+  // report progress; if it throws, the caller leaves the queue and the exception propagates.
+  Reservation reserve(size_t bytes,
+                      const std::function<void()> &still_waiting = {},
+                      std::chrono::steady_clock::duration interval = std::chrono::seconds(5));
+
+  size_t capacity() const {
+    return capacity_;
+  }
+  size_t reserved() const;
+  // Callers waiting for room right now
+  size_t waiting() const;
+
+ private:
+  void release(size_t bytes) noexcept;
+  bool admits(std::list<size_t>::iterator waiter) const;
+
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  size_t reserved_ = 0;
+  // Bytes each waiting caller asks for, in arrival order; only the first may be granted
+  std::list<size_t> waiters_;
+};
+
+}  // namespace magic_core::async
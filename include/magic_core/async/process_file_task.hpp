@@ -6,7 +6,9 @@
 #include <optional>
 #include "magic_core/types/chunk.hpp"
 namespace magic_core {
+    class ContentExtractor;
     class MetadataStore;
+    struct BasicFileMetadata;
 }
 namespace magic_core {
 class ProcessFileTask : public ITask {
@@ -24,9 +26,55 @@ public:
     // Public getter for its specific argument
     const std::string& get_file_path() const { return file_path_; }
 
+    // Stores the normalized mean of the chunk vectors, which come from embedding_model, as the
+    // file's embedding and marks the file processed. Remote workers' results finish the same way.
+    static void finalize_document_embedding(long long file_id, const std::vector<Chunk>& chunks,
+                                            MetadataStore& store,
+                                            const std::string& embedding_model);
+
+    // Bytes reserved from the memory budget for a file of file_size bytes, chunked whole in
+    // memory or streamed a region (or page) at a time
+    static size_t memory_footprint(size_t file_size, bool streamed);
+
 private:
-    void process_chunks_in_batches(long long file_id, std::vector<Chunk>& chunks, ServiceProvider& services, const ProgressUpdater& on_progress);
-    void finalize_document_embedding(long long file_id, const std::vector<Chunk>& chunks, MetadataStore& store);
+    // Helper threads of a file processed outside a WorkerPool, which has no shared executor
+    static constexpr size_t EMBED_REQUESTS_IN_FLIGHT = 2;
+    // Batches being embedded or waiting to be written at any time, per file
+    static constexpr size_t BATCHES_IN_FLIGHT = 4;
+
+    // Kept chunks renumbered per reconcile_chunks() write while streaming
+    static constexpr size_t KEPT_PER_WRITE = 256;
+
+    // Held per byte of a file chunked whole: the chunk copies with their overlap, their content
+    // hashes and the Chunk objects around them
+    static constexpr size_t IN_MEMORY_BYTES_PER_FILE_BYTE = 3;
+    // Held while streaming whatever the file's size: one region's chunks and the batches in
+    // flight with their vectors and compressed copies
+    static constexpr size_t STREAMED_FOOTPRINT = size_t{48} << 20;
+    // Files whose in-memory footprint is above this fraction of the budget are streamed instead,
+    // so one large file never shuts out the other workers
+    static constexpr size_t STREAM_ABOVE_BUDGET_DIVISOR = 4;
+    // How often a task waiting for memory reports that it is still waiting
+    static constexpr std::chrono::seconds MEMORY_WAIT_REPORT_INTERVAL{5};
+
+    // Embeds, compresses and writes one file's chunks in batches as they are added
+    class BatchPipeline;
+
+    // The task queued for the file after this one, once reported, if there is one: it
+    // processes the file again anyway, so this one can stop before embedding an outdated version
+    std::optional<long long> superseded(ServiceProvider& services,
+                                        const ProgressUpdater& on_progress) const;
+
+    // execute() for a store whose active model was embedding_model when the task started; a task
+    // that fails after a re-embed switched models queues the file again
+    void process(ServiceProvider& services, const ProgressUpdater& on_progress,
+                 const std::string& embedding_model);
+
+    // Diffs, embeds and writes the chunks of an extractor that streams them while it is still
+    // reading the file
+    void process_streamed(const BasicFileMetadata& metadata, const ContentExtractor& extractor,
+                          ServiceProvider& services, const ProgressUpdater& on_progress,
+                          const std::string& embedding_model);
 
     std::string file_path_;
 };
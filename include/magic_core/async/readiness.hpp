@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace magic_core::async {
+
+/**
+ * @class Readiness
+ * @brief Whether a starting server has finished warming up, and what it is busy with until then.
+ *
+ * The server answers as soon as it listens, but while its indexes load, searches would find
+ * nothing and writes would race the load; handlers check ready() and turn those away. Starts
+ * out warming; mark_ready() is final. Thread-safe.
+ */
+class Readiness {
+ public:
+  Readiness() : started_(std::chrono::steady_clock::now()) {}
+
+  Readiness(const Readiness &) = delete;
+  Readiness &operator=(const Readiness &) = delete;
+
+  // What the start is doing right now, e.g. "loading indexes", for the health check
+  void set_stage(std::string stage) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stage_ = std::move(stage);
+  }
+  void mark_ready() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stage_.clear();
+    warm_up_ = std::chrono::steady_clock::now() - started_;
+    ready_.store(true, std::memory_order_release);
+  }
+
+  bool ready() const {
+    return ready_.load(std::memory_order_acquire);
+  }
+  // Empty once ready
+  std::string stage() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stage_;
+  }
+  // How long the warm-up has been going, or how long it took once ready
+  std::chrono::steady_clock::duration warming_for() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ready_.load(std::memory_order_relaxed) ? warm_up_
+                                                  : std::chrono::steady_clock::now() - started_;
+  }
+
+ private:
+  const std::chrono::steady_clock::time_point started_;
+  mutable std::mutex mutex_;
+  std::string stage_ = "starting";
+  std::chrono::steady_clock::duration warm_up_{};
+  std::atomic<bool> ready_{false};
+};
+
+}  // namespace magic_core::async
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "magic_core/async/ITask.hpp"
+
+namespace magic_core {
+class EmbeddingCache;
+class MetadataStore;
+class OllamaClient;
+struct ReplacementWork;
+struct VectorReplacement;
+}  // namespace magic_core
+
+namespace magic_core {
+
+/**
+ * @class ReembedTask
+ * @brief Moves every stored vector over to another embedding model (REEMBED).
+ *
+ * Files are not read or extracted again: the stored chunk content is decompressed and embedded
+ * with the target model in large batches, into replacement segments and indexes beside the
+ * live ones (see MetadataStore::begin_replacement). Searches keep using the old vectors
+ * meanwhile. Writes that land during the run are caught up in further passes, and the last few
+ * with writers held off, right before the swap installs the new vectors and switches query
+ * embedding to the model. The target model has to be registered with its dimension first.
+ * With sharded metadata every shard is re-embedded in turn, and the swaps are nested so that
+ * query embedding only switches once all of them are installed; a shard already on the model
+ * (from a run that stopped between swaps) is skipped.
+ */
+class ReembedTask : public ITask {
+ public:
+  ReembedTask(long long id,
+              TaskStatus status,
+              std::chrono::system_clock::time_point created_at,
+              std::chrono::system_clock::time_point updated_at,
+              std::optional<std::string> error_message,
+              std::string model);
+
+  void execute(ServiceProvider& services, const ProgressUpdater& on_progress) override;
+  const char* get_type() const override {
+    return "REEMBED";
+  }
+
+  const std::string& get_model() const {
+    return model_;
+  }
+
+ private:
+  // Chunks per embedding request
+  static constexpr size_t BATCH_SIZE = 256;
+  // Requests sent ahead while earlier batches are stored
+  static constexpr size_t BATCHES_IN_FLIGHT = 2;
+  // Summaries computed per read of their chunks
+  static constexpr size_t SUMMARY_BATCH_SIZE = 1024;
+  // Catch-up passes stop once this little is left; the rest is embedded while writers wait
+  static constexpr size_t INSTALL_THRESHOLD = BATCH_SIZE;
+  static constexpr int MAX_CATCH_UP_PASSES = 8;
+
+  // Embeds work into replacement, reporting progress between from and to
+  void embed_work(const ReplacementWork& work,
+                  VectorReplacement& replacement,
+                  MetadataStore& store,
+                  OllamaClient& client,
+                  EmbeddingCache* cache,
+                  const ProgressUpdater& on_progress,
+                  float from,
+                  float to);
+
+  std::string model_;
+};
+
+}  // namespace magic_core
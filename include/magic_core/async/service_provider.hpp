@@ -1,28 +1,79 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <string>
+#include <utility>
+
+#include "magic_core/db/sharded_metadata_store.hpp"
 
 namespace magic_core {
-class MetadataStore;
 class TaskQueueRepo;
 class OllamaClient;
 class ContentExtractorFactory;
+class EmbeddingCache;
+namespace async {
+class MemoryBudget;
+class WorkStealingExecutor;
+}
 }
 
 namespace magic_core {
 
+// How a re-embed reaches an embedding model other than the active one, and moves the process
+// over to it once its vectors are installed
+struct EmbeddingModelHooks {
+  // A client for the named model
+  std::function<std::shared_ptr<OllamaClient>(const std::string&)> client_for;
+  // An embedding cache for the named model; may be empty, or return null, to embed uncached
+  std::function<std::shared_ptr<EmbeddingCache>(const std::string&)> cache_for;
+  // Called with the new model and its client right before searches see the new vectors
+  std::function<void(const std::string&, std::shared_ptr<OllamaClient>)> activate;
+};
+
+// The generation lane's model, which SUMMARIZE_FILE tasks summarize and categorize files with
+struct GenerationSettings {
+  // Null when no generation model is configured; files are then only embedded
+  std::shared_ptr<OllamaClient> client;
+  // Leading characters of a file's text that go into the prompt
+  size_t max_input_chars = 12000;
+};
+
 class ServiceProvider {
  public:
   ServiceProvider(std::shared_ptr<MetadataStore> store,
                   std::shared_ptr<TaskQueueRepo> repo,
                   std::shared_ptr<OllamaClient> ollama,
-                  std::shared_ptr<ContentExtractorFactory> factory)
-      : store_(store), task_repo_(repo), ollama_client_(ollama), content_extractor_fac_(factory) {}
+                  std::shared_ptr<ContentExtractorFactory> factory,
+                  std::shared_ptr<EmbeddingCache> embedding_cache = nullptr)
+      : store_(store),
+        task_repo_(repo),
+        ollama_client_(ollama),
+        content_extractor_fac_(factory),
+        embedding_cache_(embedding_cache) {}
+  // Tasks work on the shard holding their file
+  ServiceProvider(std::shared_ptr<ShardedMetadataStore> shards,
+                  std::shared_ptr<TaskQueueRepo> repo,
+                  std::shared_ptr<OllamaClient> ollama,
+                  std::shared_ptr<ContentExtractorFactory> factory,
+                  std::shared_ptr<EmbeddingCache> embedding_cache = nullptr)
+      : ServiceProvider(shards->shard_ptr(0), repo, ollama, factory, embedding_cache) {
+    shards_ = std::move(shards);
+  }
 
-  // Public getters for each service
+  // Public getters for each service. The first shard's store, the only one when unsharded.
   MetadataStore& get_metadata_store() {
     return *store_;
   }
+  // The store of the shard holding path
+  MetadataStore& get_metadata_store(const std::string& path) {
+    return shards_ ? shards_->for_path(path) : *store_;
+  }
+  // Every shard's store, for tasks that have to visit all of them; null when unsharded
+  ShardedMetadataStore* get_sharded_metadata_store() {
+    return shards_.get();
+  }
   TaskQueueRepo& get_task_queue_repo() {
     return *task_repo_;
   }
@@ -32,12 +83,58 @@ class ServiceProvider {
   ContentExtractorFactory& get_extractor_factory() {
     return *content_extractor_fac_;
   }
+  // Null when embeddings are not cached
+  EmbeddingCache* get_embedding_cache() {
+    return embedding_cache_.get();
+  }
+  // Where tasks split off subtasks for idle workers to steal; null outside a WorkerPool
+  async::WorkStealingExecutor* get_executor() {
+    return executor_.get();
+  }
+  void set_executor(std::shared_ptr<async::WorkStealingExecutor> executor) {
+    executor_ = std::move(executor);
+  }
+  // What the tasks of every worker may hold in memory at once; null when unbounded
+  async::MemoryBudget* get_memory_budget() {
+    return memory_budget_.get();
+  }
+  void set_memory_budget(std::shared_ptr<async::MemoryBudget> budget) {
+    memory_budget_ = std::move(budget);
+  }
+  // Without client_for, REEMBED tasks fail
+  const EmbeddingModelHooks& get_embedding_model_hooks() const {
+    return embedding_model_hooks_;
+  }
+  void set_embedding_model_hooks(EmbeddingModelHooks hooks) {
+    embedding_model_hooks_ = std::move(hooks);
+  }
+  // Without a client, processed files are not queued for summarization
+  const GenerationSettings& get_generation_settings() const {
+    return generation_settings_;
+  }
+  void set_generation_settings(GenerationSettings settings) {
+    generation_settings_ = std::move(settings);
+  }
+  // How fast SNAPSHOT tasks copy
+  const SnapshotOptions& get_snapshot_options() const {
+    return snapshot_options_;
+  }
+  void set_snapshot_options(SnapshotOptions options) {
+    snapshot_options_ = options;
+  }
 
  private:
   std::shared_ptr<MetadataStore> store_;
+  std::shared_ptr<ShardedMetadataStore> shards_;
   std::shared_ptr<TaskQueueRepo> task_repo_;
   std::shared_ptr<OllamaClient> ollama_client_;
   std::shared_ptr<ContentExtractorFactory> content_extractor_fac_;
+  std::shared_ptr<EmbeddingCache> embedding_cache_;
+  std::shared_ptr<async::WorkStealingExecutor> executor_;
+  std::shared_ptr<async::MemoryBudget> memory_budget_;
+  EmbeddingModelHooks embedding_model_hooks_;
+  GenerationSettings generation_settings_;
+  SnapshotOptions snapshot_options_;
 };
 
 }  // namespace magic_core
\ No newline at end of file
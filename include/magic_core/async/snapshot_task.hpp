@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+#include "magic_core/async/ITask.hpp"
+
+namespace magic_core {
+
+/**
+ * @class SnapshotTask
+ * @brief Writes an online snapshot of every metadata shard into a directory (SNAPSHOT).
+ *
+ * Each shard's database, vector segments and index snapshots are copied as of one moment, at
+ * the pace of the configured SnapshotOptions, while writers keep going (see
+ * MetadataStore::write_snapshot). The files keep the names they have beside the live
+ * database, so a node pointed at the directory with the same database path name and key
+ * serves right away. The copy is written to "<destination>.partial" and renamed into place
+ * with a manifest.json once every shard is in; a destination that exists already fails the
+ * task. A marker file names the task that owns "<destination>.partial", so a rerun clears
+ * only its own leftovers and any other directory there fails the task. In the copy of the
+ * first database, which holds the task queue, this task is completed.
+ */
+class SnapshotTask : public ITask {
+ public:
+  SnapshotTask(long long id,
+               TaskStatus status,
+               std::chrono::system_clock::time_point created_at,
+               std::chrono::system_clock::time_point updated_at,
+               std::optional<std::string> error_message,
+               std::string destination);
+
+  void execute(ServiceProvider& services, const ProgressUpdater& on_progress) override;
+  const char* get_type() const override {
+    return "SNAPSHOT";
+  }
+
+  const std::string& get_destination() const {
+    return destination_;
+  }
+
+ private:
+  std::string destination_;
+};
+
+}  // namespace magic_core
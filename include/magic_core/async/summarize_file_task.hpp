@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+#include "magic_core/async/ITask.hpp"
+
+namespace magic_core {
+class TaskQueueRepo;
+}  // namespace magic_core
+
+namespace magic_core {
+
+// What the generation model made of a file
+struct FileSuggestions {
+  std::string summary;
+  std::string category;
+  std::string filename;
+};
+
+/**
+ * @class SummarizeFileTask
+ * @brief Summarizes and categorizes an embedded file on the generation lane (SUMMARIZE_FILE).
+ *
+ * ProcessFileTask queues one once a file's vectors are stored, so the file is searchable
+ * before this runs, however far behind the generation lane is. The stored chunk text, up to
+ * GenerationSettings::max_input_chars, goes to the generation model in a single prompt asking
+ * for a summary, a category and a better filename as a JSON object, and the answer is stored
+ * with MetadataStore::update_file_suggestions. The task carries the content hash the file had
+ * when it was queued: a file changed since then is skipped, its newer run queues another.
+ * A worker stopped during the wait for the model hands the task back to the queue.
+ */
+class SummarizeFileTask : public ITask {
+ public:
+  SummarizeFileTask(long long id,
+                    TaskStatus status,
+                    std::chrono::system_clock::time_point created_at,
+                    std::chrono::system_clock::time_point updated_at,
+                    std::optional<std::string> error_message,
+                    std::string file_path,
+                    std::string content_hash);
+
+  void execute(ServiceProvider& services, const ProgressUpdater& on_progress) override;
+  const char* get_type() const override {
+    return "SUMMARIZE_FILE";
+  }
+
+  const std::string& get_file_path() const {
+    return file_path_;
+  }
+  const std::string& get_content_hash() const {
+    return content_hash_;
+  }
+
+  // Queues the task for a file with content_hash
+  static long long queue(TaskQueueRepo& repo,
+                         const std::string& file_path,
+                         const std::string& content_hash);
+
+  // The prompt for a file named filename whose text starts with excerpt
+  static std::string build_prompt(const std::string& filename, const std::string& excerpt);
+  // Reads the model's JSON reply. Fields it left out stay empty; the filename loses any
+  // directory part, and every field is trimmed and cut to a sane length. Throws
+  // std::runtime_error on a reply that is not a JSON object.
+  static FileSuggestions parse_reply(const std::string& reply);
+
+ private:
+  // How often the wait for the model reports progress, which also renews the task's lease
+  static constexpr std::chrono::seconds PROGRESS_INTERVAL{10};
+  // How soon the wait notices its worker stopping
+  static constexpr std::chrono::milliseconds STOP_POLL_INTERVAL{200};
+  static constexpr size_t MAX_SUMMARY_CHARS = 2000;
+  static constexpr size_t MAX_CATEGORY_CHARS = 64;
+  static constexpr size_t MAX_FILENAME_CHARS = 128;
+
+  std::string file_path_;
+  std::string content_hash_;
+};
+
+}  // namespace magic_core
@@ -1,5 +1,8 @@
 #include "magic_core/async/ITask.hpp"
 #include "magic_core/async/process_file_task.hpp"
+#include "magic_core/async/reembed_task.hpp"
+#include "magic_core/async/snapshot_task.hpp"
+#include "magic_core/async/summarize_file_task.hpp"
 
 namespace magic_core {
 class TaskFactory {
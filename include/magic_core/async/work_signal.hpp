@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace magic_core::async {
+
+/**
+ * @class WorkSignal
+ * @brief Wakes idle workers when new work is queued in this process.
+ *
+ * Every notification bumps a generation counter. A worker reads the generation before it
+ * looks for work and passes it to wait_for(), which returns immediately if anything was
+ * queued in between, so a wakeup is never lost to that race.
+ */
+class WorkSignal {
+ public:
+  WorkSignal() = default;
+
+  WorkSignal(const WorkSignal &) = delete;
+  WorkSignal &operator=(const WorkSignal &) = delete;
+
+  uint64_t generation() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return generation_;
+  }
+
+  // One new unit of work: one idle worker is enough
+  void notify_one() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++generation_;
+    }
+    cv_.notify_one();
+  }
+
+  // Wakes every waiter, e.g. for shutdown
+  void notify_all() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++generation_;
+    }
+    cv_.notify_all();
+  }
+
+  // Blocks until the generation moves past seen, stop_requested() returns true, or the timeout
+  // elapses (the polling fallback for work queued by other processes).
+  template <typename Rep, typename Period, typename Predicate>
+  void wait_for(uint64_t seen,
+                const std::chrono::duration<Rep, Period> &timeout,
+                Predicate stop_requested) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, timeout, [&] { return generation_ != seen || stop_requested(); });
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  uint64_t generation_ = 0;
+};
+
+}  // namespace magic_core::async
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "magic_core/async/work_signal.hpp"
+
+namespace magic_core::async {
+
+/**
+ * @class WorkStealingExecutor
+ * @brief Runs the subtasks a task splits into on whichever thread is free.
+ *
+ * Every thread that submits or runs jobs gets its own deque. It pushes and pops its own jobs
+ * at the back, newest first, so a task keeps working on the batch it just produced; a thread
+ * with nothing of its own steals the oldest job from another thread's front. Workers take part
+ * by calling run_one() when the task queue is empty, and the executor wakes them through
+ * idle_signal whenever a job is submitted. Threads the executor starts itself do the same.
+ *
+ * Jobs must not block on other jobs; a thread waiting for its jobs should keep calling
+ * run_one() (TaskGroup::wait does), so every queued job always has a thread that can run it.
+ */
+class WorkStealingExecutor {
+ public:
+  using Job = std::function<void()>;
+
+  // threads are started by the executor; 0 leaves all the work to participants
+  explicit WorkStealingExecutor(size_t threads = 0,
+                                std::shared_ptr<WorkSignal> idle_signal = nullptr);
+  // Stops the executor's own threads; jobs still queued are dropped
+  ~WorkStealingExecutor();
+
+  WorkStealingExecutor(const WorkStealingExecutor &) = delete;
+  WorkStealingExecutor &operator=(const WorkStealingExecutor &) = delete;
+
+  // Queues job on the calling thread's deque. Jobs should not throw; if one does, the error is
+  // logged and dropped.
+  void submit(Job job);
+  // Runs one queued job on the calling thread: its own newest, else another thread's oldest.
+  // Returns false if nothing was queued.
+  bool run_one();
+
+  // Jobs queued and not yet started
+  size_t pending() const {
+    return pending_.load(std::memory_order_acquire);
+  }
+  size_t steals() const {
+    return steals_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Slot {
+    std::thread::id owner;
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  Slot &own_slot();
+  void thread_loop();
+
+  // Distinguishes executors in the per-thread slot cache, since addresses get reused
+  const uint64_t id_;
+  std::shared_ptr<WorkSignal> idle_signal_;
+
+  // Slots are only added, so references to them stay valid while the executor lives
+  mutable std::shared_mutex slots_mutex_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+  std::atomic<size_t> next_victim_{0};
+  std::atomic<size_t> pending_{0};
+  std::atomic<size_t> steals_{0};
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  std::atomic<bool> stopping_{false};
+  std::vector<std::thread> threads_;
+};
+
+/**
+ * @class TaskGroup
+ * @brief Tracks a set of jobs submitted to a WorkStealingExecutor and collects their errors.
+ *
+ * The first job to throw cancels every job of the group that has not started yet; wait()
+ * rethrows its exception once the rest have finished.
+ */
+class TaskGroup {
+ public:
+  explicit TaskGroup(WorkStealingExecutor &executor) : executor_(executor) {}
+  // Waits for outstanding jobs, discarding their errors
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  void run(std::function<void()> job);
+
+  // Number of jobs finished so far. Read it before checking for their output and pass it to
+  // help_or_wait(), so a job finishing in between is never missed.
+  uint64_t completions() const;
+  // Runs one queued job of any group, or blocks until a job of this group finishes after seen
+  // or timeout elapses
+  void help_or_wait(uint64_t seen, std::chrono::milliseconds timeout);
+  // Helps until every job has finished, then rethrows the first error
+  void wait();
+  bool failed() const {
+    return failed_.load(std::memory_order_acquire);
+  }
+
+ private:
+  WorkStealingExecutor &executor_;
+  mutable std::mutex mutex_;
+  std::condition_variable done_cv_;
+  size_t outstanding_ = 0;
+  uint64_t completions_ = 0;
+  std::exception_ptr error_;
+  std::atomic<bool> failed_{false};
+};
+
+}  // namespace magic_core::async
@@ -1,13 +1,17 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <string>
 #include <thread>
 
+#include "magic_core/async/work_signal.hpp"
+#include "magic_core/db/models/task_dto.hpp"
+
 namespace magic_core {
 class MetadataStore;
 class OllamaClient;
-struct TaskDTO;
 class ContentExtractorFactory;
 class TaskQueueRepo;
 class ServiceProvider;
@@ -20,9 +24,16 @@ namespace async {
  * @class Worker
  * @brief Represents a single background thread that processes tasks from the queue.
  *
- * A Worker is a long-lived object that continuously polls the TaskQueue for
- * pending jobs. When a job is found, the Worker executes the necessary
- * file processing logic (chunking, embedding, etc.).
+ * A Worker is a long-lived object that pulls pending jobs from the TaskQueue.
+ * When a job is found, the Worker executes the necessary file processing logic
+ * (chunking, embedding, etc.). When the queue is empty it sleeps on a
+ * WorkSignal until a task is queued in this process, and only falls back to
+ * polling for tasks queued by other processes. Between tasks it runs subtasks
+ * that other workers' tasks queued on the shared executor.
+ *
+ * Claimed tasks are leased to the worker. Progress reports renew the lease, and a
+ * task whose lease was lost is dropped without recording an outcome, since it
+ * has been handed to someone else.
  *
  * This class is designed to be managed by a WorkerPool. It is non-copyable
  * and non-movable to ensure clear ownership of the underlying thread.
@@ -33,8 +44,15 @@ namespace async {
        * @brief Constructs a Worker instance.
        * @param worker_id A unique identifier for this worker, used for logging.
        * @param services A shared pointer to the service provider.
+       * @param work_signal Signal notified when tasks are queued. Workers of one pool share it;
+       *        a private one is created if none is given.
+       * @param lane The tasks this worker claims; a reserved lane keeps it free for them.
+       *        Generation workers also leave the executor's embedding subtasks alone.
        */
-      Worker(int worker_id, std::shared_ptr<ServiceProvider> services);
+      Worker(int worker_id,
+             std::shared_ptr<ServiceProvider> services,
+             std::shared_ptr<WorkSignal> work_signal = nullptr,
+             TaskLane lane = TaskLane::Any);
   
       /**
        * @brief Destructor. Ensures the worker thread is stopped and joined cleanly.
@@ -66,18 +84,38 @@ namespace async {
       Worker(Worker&&) = delete;
       Worker& operator=(Worker&&) = delete;
       bool run_one_task();
+      // True while the worker sleeps for lack of tasks and subtasks
+      bool is_idle() const { return idle_.load(); }
+      TaskLane lane() const { return lane_; }
   
   private:
       /**
        * @brief The main loop for the worker thread.
        *
-       * This function continuously polls the task queue, executes tasks, and
-       * sleeps when no work is available. It runs until stop() is called.
+       * This function continuously claims and executes tasks, and waits on the
+       * work signal when no work is available. It runs until stop() is called.
        */
       void run_loop();  
+      // Runs one claimed task to completion, recording its outcome in the queue. The run is
+      // traced when a trace exporter is installed.
+      void process_task(const TaskDTO& task_dto);
+      void run_task(const TaskDTO& task_dto);
+      // Tasks claimed per queue query; kept small so one worker cannot hoard a backlog
+      static constexpr int CLAIM_BATCH_SIZE = 4;
+      // A generation task waits out the LLM calls claimed before it, so that lane claims one
+      // at a time rather than sit on leases other generation workers could be using
+      static constexpr int GENERATION_CLAIM_BATCH_SIZE = 1;
+      // How long an idle worker waits for a signal before checking the queue anyway
+      static constexpr std::chrono::seconds IDLE_POLL_INTERVAL{30};
+
       int worker_id_;
       std::shared_ptr<ServiceProvider> services_;
+      std::shared_ptr<WorkSignal> work_signal_;
+      TaskLane lane_;
+      // Names this worker's claims in the task queue: the repo's instance id plus worker_id
+      std::string lease_owner_;
       std::atomic<bool> should_stop{false};
+      std::atomic<bool> idle_{false};
       std::thread thread;
   };
 }
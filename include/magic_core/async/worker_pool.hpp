@@ -1,12 +1,38 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <vector>
 
+#include "magic_core/async/work_stealing_executor.hpp"
 #include "magic_core/async/worker.hpp"
 
 namespace magic_core::async {
 
+struct WorkerPoolOptions {
+  size_t min_workers = 1;
+  size_t max_workers = 1;
+  // Workers reserved for one lane; the rest take any task in aged priority order. Together they
+  // may not exceed min_workers. Workers added by scaling always take any task.
+  size_t interactive_workers = 0;
+  size_t bulk_workers = 0;
+  // Workers that only run the generation lane's SUMMARIZE_FILE tasks, in addition to
+  // min_workers..max_workers and never scaled or retired. With none those tasks stay queued.
+  size_t generation_workers = 0;
+  // How often the pool reconsiders its size
+  std::chrono::milliseconds scale_interval{2000};
+  // Workers above min_workers are retired one at a time once some have been idle this long
+  std::chrono::milliseconds idle_before_shrink{30000};
+  // Requests in flight per healthy embedding endpoint at which the server counts as
+  // saturated; more workers would only queue behind it
+  int saturated_outstanding_per_endpoint = 8;
+};
+
 /**
  * @class WorkerPool
  * @brief Manages a collection of Worker threads for concurrent task processing.
@@ -14,6 +40,19 @@ namespace magic_core::async {
  * This class is responsible for the entire lifecycle of the worker threads:
  * creating them, starting them, and ensuring they are safely shut down
  * when the pool is destroyed. It follows the RAII principle.
+ *
+ * The workers share a WorkStealingExecutor, installed in the ServiceProvider, that tasks split
+ * their subtasks onto. When max_workers is above min_workers a scaling thread adds a worker
+ * while tasks or subtasks are waiting and the embedding server has capacity to spare, and
+ * retires idle ones down to min_workers once the backlog is gone.
+ *
+ * Reserved lane workers only claim tasks of their lane, so an interactive request always finds
+ * a worker even while a crawl keeps the others busy, and a flood of interactive requests cannot
+ * stall a crawl completely. Aging covers the unreserved workers.
+ *
+ * Generation workers summarize and categorize files that are already embedded and searchable.
+ * LLM calls take far longer than embedding, so they have a fixed number of workers of their
+ * own: their backlog never grows the pool, and the embedding workers never wait on them.
  */
 class WorkerPool {
  public:
@@ -24,6 +63,9 @@ class WorkerPool {
    * @param services A shared pointer to the service provider.
    */
   WorkerPool(size_t num_threads, std::shared_ptr<ServiceProvider> services);
+  // Throws std::invalid_argument unless 0 < min_workers <= max_workers and the lane
+  // reservations fit in min_workers
+  WorkerPool(WorkerPoolOptions options, std::shared_ptr<ServiceProvider> services);
 
   /**
    * @brief Destructor. Automatically stops and joins all worker threads.
@@ -45,6 +87,17 @@ class WorkerPool {
    */
   void stop();
 
+  // Generation workers included
+  size_t size() const;
+  const WorkStealingExecutor& executor() const {
+    return *m_executor;
+  }
+
+  // Adds or retires at most one worker from the current backlog and embedding server load.
+  // Generation workers and tasks are left out. Called by the scaling thread every
+  // scale_interval.
+  void rebalance(std::chrono::steady_clock::time_point now);
+
   // --- Rule of Five: Make the class non-copyable and non-movable ---
   WorkerPool(const WorkerPool&) = delete;
   WorkerPool& operator=(const WorkerPool&) = delete;
@@ -52,8 +105,29 @@ class WorkerPool {
   WorkerPool& operator=(WorkerPool&&) = delete;
 
  private:
+  // The lane a new worker takes: the first unfilled reservation, else Any
+  TaskLane next_worker_lane() const;
+  void add_worker(TaskLane lane);
+  bool embedding_server_saturated() const;
+  void scale_loop();
+
+  WorkerPoolOptions m_options;
+  std::shared_ptr<ServiceProvider> m_services;
+  // Shared by all workers and notified by the task queue whenever a task is created
+  std::shared_ptr<WorkSignal> m_work_signal;
+  // Outlives the workers, which may be running its jobs until they are joined
+  std::shared_ptr<WorkStealingExecutor> m_executor;
+  mutable std::mutex m_workers_mutex;
   std::vector<std::unique_ptr<Worker>> m_workers;
+  int m_next_worker_id = 0;
   bool m_is_running = false;
+  // When the pool was first seen with idle workers and no backlog
+  std::optional<std::chrono::steady_clock::time_point> m_idle_since;
+
+  std::unique_ptr<std::thread> m_scaler;
+  std::mutex m_scaler_mutex;
+  std::condition_variable m_scaler_cv;
+  std::atomic<bool> m_scaling{false};
 };
 
 }  // namespace magic_core::async
\ No newline at end of file
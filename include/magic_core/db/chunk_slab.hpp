@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "magic_core/db/vector_index.hpp"
+
+namespace magic_core {
+
+/**
+ * @struct ChunkSlab
+ * @brief Chunk vectors laid out contiguously for an exact scan.
+ *
+ * Rows are kept in the form the metric scores fastest: unit length under cosine, and next to
+ * their squared norm under L2, so scoring a row is one dot product with the query either way.
+ */
+struct ChunkSlab {
+  ChunkSlab(int dimension, VectorMetric metric) : dimension(dimension), metric(metric) {}
+
+  // Adds the vector (dimension floats) of chunk id as the next row
+  void append(int64_t id, const float *vector);
+  void reserve(size_t rows);
+  size_t size() const {
+    return ids.size();
+  }
+  // Heap bytes held by the rows
+  size_t bytes() const;
+
+  int dimension;
+  VectorMetric metric;
+  std::vector<int64_t> ids;
+  // size() rows of dimension floats
+  std::vector<float> vectors;
+  // One per row under L2, empty under cosine
+  std::vector<float> squared_norms;
+};
+
+// The k rows across slabs closest to query, by ascending distance and then id, with the
+// distances VectorIndex reports for the slabs' metric. Every slab must share one dimension and
+// metric.
+std::vector<VectorIndexHit> scan_slabs(const std::vector<const ChunkSlab *> &slabs,
+                                       const std::vector<float> &query,
+                                       int k);
+
+/**
+ * @class ChunkSlabCache
+ * @brief Per-file chunk slabs kept between searches, so repeat searches over the same files skip
+ *        the database and the vector store.
+ *
+ * Holds at most capacity_bytes of slabs and evicts the least recently used file past that.
+ * Cached slabs are immutable and shared, so a search keeps using one an eviction dropped.
+ * Writers invalidate a file after committing a change to its chunks. A load takes a ticket
+ * before reading, and put() discards its slabs if any invalidation happened since, so a slab
+ * read before a commit is never cached after it. A capacity of 0 disables the cache.
+ */
+class ChunkSlabCache {
+ public:
+  struct Stats {
+    size_t hits;
+    size_t misses;
+    size_t files;
+    size_t bytes;
+  };
+
+  explicit ChunkSlabCache(size_t capacity_bytes) : capacity_bytes_(capacity_bytes) {}
+
+  ChunkSlabCache(const ChunkSlabCache &) = delete;
+  ChunkSlabCache &operator=(const ChunkSlabCache &) = delete;
+
+  // The file's slab, or null if it is not cached. Counts as a use.
+  std::shared_ptr<const ChunkSlab> get(int file_id);
+  // Take before reading what will be put()
+  uint64_t ticket() const {
+    return epoch_.load(std::memory_order_acquire);
+  }
+  // Caches slab for file_id unless something was invalidated after ticket was taken. A slab
+  // larger than the whole capacity is not cached.
+  void put(int file_id, std::shared_ptr<const ChunkSlab> slab, uint64_t ticket);
+  void invalidate(int file_id);
+  void invalidate(const std::vector<int> &file_ids);
+  void clear();
+
+  Stats stats() const;
+  size_t capacity_bytes() const {
+    return capacity_bytes_;
+  }
+
+ private:
+  struct Entry {
+    int file_id;
+    std::shared_ptr<const ChunkSlab> slab;
+    size_t bytes;
+  };
+  using Entries = std::list<Entry>;
+
+  void erase_locked(int file_id);
+
+  const size_t capacity_bytes_;
+  mutable std::mutex mutex_;
+  // Most recently used first
+  Entries entries_;
+  std::unordered_map<int, Entries::iterator> index_;
+  size_t bytes_ = 0;
+  std::atomic<uint64_t> epoch_{0};
+  std::atomic<size_t> hits_{0};
+  std::atomic<size_t> misses_{0};
+};
+
+}  // namespace magic_core
@@ -1,5 +1,7 @@
 #pragma once
 #include <sqlite_modern_cpp.h>
+#include "magic_core/db/statement_cache.hpp"
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -8,23 +10,103 @@
 
 namespace magic_core {
 
+// A pooled connection and the statements prepared on it, which live as long as it does
+struct PooledDatabase {
+    explicit PooledDatabase(const std::string& db_path) : db(db_path) {}
+
+    sqlite::database_binder& prepare(const std::string& sql) { return statements.get(db, sql); }
+
+    sqlite::database db;
+    StatementCache statements;
+};
+
+// ReadOnly connections are opened query_only, with a large page cache, memory-mapped I/O and
+// in-memory temp tables, for the many concurrent readers of search and listing queries
+enum class ConnectionAccess { ReadWrite, ReadOnly };
+
+// How SQLCipher turns the database key into the page key. kdf_iter and cipher_page_size have to
+// match the ones the database was created with (SQLCipher 4's defaults unless configured).
+struct CipherOptions {
+    // Derive the page key from the passphrase once and key every connection with it as a raw
+    // x'...' key, instead of running the whole key derivation again for each one
+    bool raw_key = true;
+    int kdf_iter = 256000;
+    int cipher_page_size = 4096;
+};
+
+// How long get_connection() callers waited for a free connection
+struct ConnectionPoolStats {
+    size_t acquisitions = 0;
+    // Connections opened, up front and on demand
+    size_t opened = 0;
+    // Acquisitions that found the pool empty and had to block
+    size_t waits = 0;
+    std::chrono::microseconds total_wait{0};
+    std::chrono::microseconds max_wait{0};
+};
+
+// Opens min_size connections up front and more, up to max_size, when get_connection() finds
+// none free; callers only wait once max_size are out
 class ConnectionPool {
 public:
-    ConnectionPool(const std::string& db_path, const std::string& db_key, int pool_size);
+    ConnectionPool(const std::string& db_path,
+                   const std::string& db_key,
+                   int min_size,
+                   int max_size,
+                   ConnectionAccess access = ConnectionAccess::ReadWrite,
+                   const CipherOptions& cipher = {});
+
+    // A keyed connection configured like the pooled ones, owned by the caller. db_key is a
+    // passphrase or a raw key from derive_raw_key().
+    static std::unique_ptr<PooledDatabase> open_connection(
+        const std::string& db_path,
+        const std::string& db_key,
+        ConnectionAccess access = ConnectionAccess::ReadWrite,
+        const CipherOptions& cipher = {});
+
+    // Keys db and applies the non-default cipher settings, then reads from it to check the key
+    static void key_database(sqlite::database& db,
+                             const std::string& db_key,
+                             const CipherOptions& cipher);
 
-    std::unique_ptr<sqlite::database> get_connection();
+    // The x'<key><salt>' raw key SQLCipher derives from passphrase for the existing database at
+    // db_path (PBKDF2-HMAC-SHA512 over the salt in its first 16 bytes), or "" if the file has
+    // no salt to read
+    static std::string derive_raw_key(const std::string& db_path,
+                                      const std::string& passphrase,
+                                      const CipherOptions& cipher);
+
+    std::unique_ptr<PooledDatabase> get_connection();
+    // A connection keyed and configured like the pooled ones but owned by the caller and not
+    // counted against max_size, to this database or, given db_path, to a new one there
+    std::unique_ptr<PooledDatabase> open_unpooled(const std::string& db_path = {}) const;
 
     // Returns a connection to the pool.
-    void return_connection(std::unique_ptr<sqlite::database> conn);
+    void return_connection(std::unique_ptr<PooledDatabase> conn);
     void shutdown();
 
+    ConnectionPoolStats stats() const;
+
 private:
+    // Page cache per read-only connection and how much of the file each maps. SQLCipher reads
+    // encrypted pages through its codec and ignores mmap_size, so the cache does the work there.
+    static constexpr int READ_CACHE_SIZE_KIB = 65536;
+    static constexpr long long READ_MMAP_SIZE = 1LL << 30;
+    static constexpr int SALT_BYTES = 16;
+    static constexpr int KEY_BYTES = 32;
+
     bool shutting_down_ = false;
     std::string db_path_;
     std::string db_key_;
-    std::queue<std::unique_ptr<sqlite::database>> pool_;
-    std::mutex mtx_;
+    ConnectionAccess access_;
+    CipherOptions cipher_;
+    int max_size_;
+    // Connections opened so far, pooled or handed out
+    int open_count_ = 0;
+    std::queue<std::unique_ptr<PooledDatabase>> pool_;
+    mutable std::mutex mtx_;
     std::condition_variable cv_;
+    ConnectionPoolStats stats_;
 };
 
 } // namespace magic_core
\ No newline at end of file
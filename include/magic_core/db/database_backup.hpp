@@ -0,0 +1,77 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "magic_core/db/connection_pool.hpp"
+
+struct sqlite3_backup;
+
+namespace magic_core {
+
+class DatabaseManager;
+
+class DatabaseBackupError : public std::exception {
+ public:
+  explicit DatabaseBackupError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+/**
+ * @class DatabaseBackup
+ * @brief An online copy of a database through SQLite's backup API, a few pages per step.
+ *
+ * The constructor opens a read transaction on a connection of its own and copies from that, so
+ * under WAL the copy is the database as of that moment however long the steps take, and writers
+ * are never held up: a step only reads pages of the pinned snapshot. The copy is a new database
+ * keyed like the source. Until finish() it is incomplete, and it is deleted if the backup is
+ * dropped before that.
+ */
+class DatabaseBackup {
+ public:
+  // Throws DatabaseBackupError if destination already exists
+  DatabaseBackup(DatabaseManager &source, std::filesystem::path destination);
+  ~DatabaseBackup();
+
+  DatabaseBackup(const DatabaseBackup &) = delete;
+  DatabaseBackup &operator=(const DatabaseBackup &) = delete;
+
+  // The pinned source: what it reads is what the copy holds (e.g. its index generations)
+  sqlite::database &source() {
+    return source_->db;
+  }
+
+  // Copies up to pages more pages. True once every page is copied.
+  bool step(int pages);
+  // Pages of the source and those not copied yet, both 0 before the first step
+  int page_count() const;
+  int remaining() const;
+  int page_size() const {
+    return page_size_;
+  }
+
+  // After the last step: runs finalize on the copy, then closes it and ends the read
+  // transaction. The copy is complete once this returns.
+  void finish(const std::function<void(sqlite::database &)> &finalize = {});
+
+ private:
+  void remove_destination() noexcept;
+
+  std::filesystem::path destination_path_;
+  std::unique_ptr<PooledDatabase> source_;
+  std::unique_ptr<PooledDatabase> destination_;
+  sqlite3_backup *backup_ = nullptr;
+  int page_size_ = 0;
+  bool done_ = false;
+  bool finished_ = false;
+};
+
+}  // namespace magic_core
@@ -1,35 +1,125 @@
 #pragma once
 
 #include "magic_core/db/connection_pool.hpp"
+#include "magic_core/db/database_writer.hpp"
+#include "magic_core/db/vector_store.hpp"
 #include <filesystem>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 
 namespace magic_core {
 
+// How DatabaseManager opens its connections
+struct ConnectionOptions {
+    CipherOptions cipher;
+    // Connections each pool opens at startup; the rest, up to its size, open when first needed
+    int min_pool_size = 1;
+};
+
 class DatabaseManager {
 public:
     // Singleton access
     static DatabaseManager& get_instance();
+    // A manager of its own, for a database beside the singleton's (e.g. a metadata shard)
+    static std::unique_ptr<DatabaseManager> create();
+
+    static constexpr int DEFAULT_READ_POOL_SIZE = 4;
 
-    // Must be called once at application startup
-    void initialize(const std::filesystem::path& db_path, const std::string& db_key, int pool_size);
+    // Must be called once at application startup. pool_size read-write connections serve
+    // maintenance and ad-hoc writes; read_pool_size read-only ones serve queries. Vector
+    // segments are written in vector_encoding; one in another encoding is converted on startup.
+    // db_key is the passphrase; with connections.cipher.raw_key it is derived into the page key
+    // once here, and the connections are keyed with that.
+    void initialize(const std::filesystem::path& db_path,
+                    const std::string& db_key,
+                    int pool_size,
+                    int read_pool_size = DEFAULT_READ_POOL_SIZE,
+                    VectorEncoding vector_encoding = VectorEncoding::Float32,
+                    const ConnectionOptions& connections = {});
 
     // These methods are used by the PooledConnection guard
-    std::unique_ptr<sqlite::database> get_connection();
-    void return_connection(std::unique_ptr<sqlite::database> conn);
+    std::unique_ptr<PooledDatabase> get_connection(
+        ConnectionAccess access = ConnectionAccess::ReadWrite);
+    void return_connection(std::unique_ptr<PooledDatabase> conn,
+                           ConnectionAccess access = ConnectionAccess::ReadWrite);
+
+    ConnectionPoolStats pool_stats(ConnectionAccess access) const;
+
+    // A connection outside the pools, for work that would hold a pooled one for minutes (e.g.
+    // a backup's read). With db_path it opens a new database there, keyed like this one.
+    std::unique_ptr<PooledDatabase> open_unpooled_connection(
+        ConnectionAccess access, const std::filesystem::path& db_path = {}) const;
+
+    // Makes new files and chunks rows get ids of first_id to last_id, so that they cannot
+    // collide with those of another database. Ids already handed out past first_id are left as
+    // they are; inserting past last_id fails, and this throws ShardMapError once the range is
+    // used up.
+    void reserve_row_ids(int64_t first_id, int64_t last_id);
 
     void shutdown();
 
+    const std::filesystem::path& get_db_path() const { return db_path_; }
+    // Key material for artifacts stored next to the database (e.g. index snapshots)
+    const std::string& get_db_key() const { return db_key_; }
+
+    // The single thread that group-commits writes; workers write through it instead of taking
+    // the write lock on pooled connections
+    DatabaseWriter& writer();
+
+    // The vector segment of a vector-bearing table ("files" or "chunks"), opened on first use
+    // next to the database. Shared by everything using this database.
+    std::shared_ptr<VectorStore> vector_store(const std::string& name, int dimension);
+    static std::filesystem::path vector_store_path(const std::filesystem::path& db_path,
+                                                   const std::string& name);
+    // An empty segment beside the named one, at the epoch after the live one's, for a full set
+    // of replacement vectors (e.g. of another embedding model). The caller commits offsets into
+    // it together with that epoch; a restart before the commit discards the file, one after it
+    // installs the file in place of the live segment.
+    std::shared_ptr<VectorStore> create_replacement_vector_store(const std::string& name,
+                                                                 int dimension);
+    // Once that commit is done: renames replacement over the live segment and returns it opened
+    // in its place, which vector_store() hands out from then on. replacement must be the only
+    // reference left to it.
+    std::shared_ptr<VectorStore> install_replacement_vector_store(
+        const std::string& name, std::shared_ptr<VectorStore> replacement);
+
     DatabaseManager(const DatabaseManager&) = delete;
     DatabaseManager& operator=(const DatabaseManager&) = delete;
 
 private:
     DatabaseManager() = default;
-    void setup_schema(const std::filesystem::path& db_path, const std::string& db_key);
+    void setup_schema(const std::filesystem::path& db_path,
+                      const std::string& db_key,
+                      const CipherOptions& cipher);
+    // A read-write connection keyed with the raw key derived from db_key, or with db_key itself
+    // if there is none or the database rejects it; connection_key is set to the key used
+    static std::unique_ptr<PooledDatabase> open_keyed_connection(
+        const std::filesystem::path& db_path,
+        const std::string& db_key,
+        const CipherOptions& cipher,
+        std::string& connection_key);
+    // Moves vectors still held in BLOB columns into the segments and compacts segments that
+    // are mostly dead records or in another encoding than the configured one. Runs before
+    // anything else can use the database.
+    void maintain_vector_stores();
+    int64_t vector_store_epoch(const std::string& name);
+
+    // Compact once dead records outnumber live ones and there are at least this many
+    static constexpr size_t COMPACTION_MIN_DEAD_RECORDS = 1024;
+
+    ConnectionPool& pool(ConnectionAccess access) const;
 
     std::unique_ptr<ConnectionPool> pool_;
+    std::unique_ptr<ConnectionPool> read_pool_;
+    std::unique_ptr<DatabaseWriter> writer_;
+    std::filesystem::path db_path_;
+    std::string db_key_;
+    VectorEncoding vector_encoding_ = VectorEncoding::Float32;
     bool is_initialized_ = false;
+    std::mutex vector_stores_mutex_;
+    std::map<std::string, std::shared_ptr<VectorStore>> vector_stores_;
 };
 
 } // namespace magic_core
\ No newline at end of file
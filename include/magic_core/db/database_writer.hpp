@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "magic_core/db/connection_pool.hpp"
+
+namespace magic_core {
+
+class DatabaseWriterError : public std::exception {
+ public:
+  explicit DatabaseWriterError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+struct DatabaseWriterOptions {
+  // How long the first queued write waits for others to share its transaction. Writes arriving
+  // while a commit is in flight are batched regardless.
+  std::chrono::microseconds commit_delay{2000};
+  size_t max_batch = 256;
+};
+
+/**
+ * @class DatabaseWriter
+ * @brief The one thread that writes to the database, group-committing queued writes.
+ *
+ * SQLite allows a single writer at a time, so workers that each open their own write
+ * transaction only queue up on the WAL lock, and every one of them pays for its own commit.
+ * Here writers hand over a function instead; the writer thread runs whatever has queued up in
+ * one transaction on its own dedicated connection and commits once. Each write runs inside a
+ * savepoint, so one that throws is rolled back alone and the rest of the batch still commits.
+ * Reads keep using the connection pool.
+ *
+ * A write runs on the writer thread with the writer's connection. It must not open a
+ * Transaction, borrow a pooled connection to write, or wait on the writer itself.
+ */
+class DatabaseWriter {
+ public:
+  using Write = std::function<void(PooledDatabase &)>;
+
+  explicit DatabaseWriter(std::unique_ptr<PooledDatabase> connection,
+                          DatabaseWriterOptions options = {});
+  // Commits whatever is still queued, then stops
+  ~DatabaseWriter();
+
+  DatabaseWriter(const DatabaseWriter &) = delete;
+  DatabaseWriter &operator=(const DatabaseWriter &) = delete;
+
+  // Queues write. The future is ready once the transaction holding it has committed, or holds
+  // what the write (or the commit) threw.
+  std::future<void> submit(Write write);
+  // Queues write and waits for its commit, rethrowing its error
+  void run(Write write);
+
+  // Takes effect from the next batch; a bulk load widens the window for the duration
+  void set_options(DatabaseWriterOptions options);
+  DatabaseWriterOptions options();
+
+  // Commits the queue and stops the thread; later submissions throw DatabaseWriterError
+  void stop();
+
+  size_t commits() const {
+    return commits_.load();
+  }
+  size_t writes_committed() const {
+    return writes_committed_.load();
+  }
+
+ private:
+  struct Pending {
+    Write write;
+    std::promise<void> done;
+  };
+
+  void run_loop();
+  void commit_batch(std::deque<Pending> &batch);
+
+  std::unique_ptr<PooledDatabase> connection_;
+  DatabaseWriterOptions options_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Pending> queue_;
+  bool stopping_ = false;
+  std::atomic<size_t> commits_{0};
+  std::atomic<size_t> writes_committed_{0};
+  std::thread thread_;
+};
+
+}  // namespace magic_core
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "magic_core/db/database_manager.hpp"
+#include "magic_core/db/near_duplicate_index.hpp"
+#include "magic_core/types/lru_cache.hpp"
+
+namespace magic_core {
+
+class EmbeddingCacheError : public std::exception {
+ public:
+  explicit EmbeddingCacheError(const std::string& message) : message_(message) {}
+  const char* what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+struct EmbeddingCacheStats {
+  size_t memory_hits = 0;
+  size_t disk_hits = 0;
+  size_t misses = 0;
+  // Misses answered with the vector of a near-identical chunk
+  size_t near_hits = 0;
+};
+
+/**
+ * @class EmbeddingCache
+ * @brief Content-addressed embeddings: (SHA-256 of the text, model) -> vector.
+ *
+ * Entries persist in the embedding_cache table so re-processing an edited document only embeds
+ * the chunks that changed, and boilerplate repeated across files is embedded once. A bounded
+ * in-memory LRU sits in front of SQLite for chunks repeated within and across recent files.
+ * Thread-safe; one instance is shared by every worker.
+ *
+ * With near_duplicate_entries, the cache also remembers a SimHash fingerprint of the last that
+ * many embedded chunks (NearDuplicateIndex), so a chunk whose text differs from one of them in
+ * a word or two reuses that chunk's vector instead of being embedded. Exact lookups are
+ * unaffected, and reused vectors are never stored under the new chunk's key.
+ */
+class EmbeddingCache {
+ public:
+  static constexpr size_t DEFAULT_MEMORY_ENTRIES = 4096;
+
+  EmbeddingCache(DatabaseManager& db_manager,
+                 std::string model,
+                 size_t memory_entries = DEFAULT_MEMORY_ENTRIES,
+                 size_t near_duplicate_entries = 0,
+                 int near_duplicate_distance = NearDuplicateIndex::DEFAULT_DISTANCE);
+
+  // Cache key of a text: the hex SHA-256 of its bytes
+  static std::string content_key(std::string_view text);
+
+  // Returns the cached vector for each key, or an empty vector on a miss. Keys missing from
+  // memory are looked up in SQLite together.
+  std::vector<std::vector<float>> lookup(const std::vector<std::string>& keys);
+  // Caches vectors[i] under keys[i], in memory and in SQLite (one transaction)
+  void store(const std::vector<std::string>& keys, const std::vector<std::vector<float>>& vectors);
+
+  // Whether lookup_near() can answer anything; fingerprints are not worth computing otherwise
+  bool detects_near_duplicates() const {
+    return near_ != nullptr;
+  }
+  // Vector of a remembered chunk near-identical to each fingerprint, or an empty vector when
+  // there is none (or no fingerprint)
+  std::vector<std::vector<float>> lookup_near(
+      const std::vector<std::optional<uint64_t>>& fingerprints);
+  // Remembers that the text fingerprinted fingerprints[i] was stored under keys[i]
+  void remember(const std::vector<std::optional<uint64_t>>& fingerprints,
+                const std::vector<std::string>& keys);
+
+  EmbeddingCacheStats stats() const;
+  std::string model() const;
+  // Looks up and stores vectors of model from now on, e.g. once a re-embed has switched the
+  // database over to it. Calls already running finish with the old one. Forgets the
+  // fingerprints, whose keys name vectors of the old model.
+  void set_model(std::string model);
+
+ private:
+  // lookup() without the hit and miss counters when counted is false
+  std::vector<std::vector<float>> fetch(const std::vector<std::string>& keys, bool counted);
+
+  DatabaseManager& db_manager_;
+  mutable std::mutex model_mutex_;
+  std::string model_;
+  // Keyed by model and content key, so entries of a previous model are never returned
+  LruCache<std::string, std::vector<float>> memory_;
+  // Null unless near-duplicates are detected
+  std::unique_ptr<NearDuplicateIndex> near_;
+
+  std::atomic<size_t> memory_hits_{0};
+  std::atomic<size_t> disk_hits_{0};
+  std::atomic<size_t> misses_{0};
+  std::atomic<size_t> near_hits_{0};
+};
+
+}  // namespace magic_core
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "magic_core/db/database_manager.hpp"
+
+namespace magic_core {
+
+class EmbeddingModelRegistryError : public std::exception {
+ public:
+  explicit EmbeddingModelRegistryError(const std::string& message) : message_(message) {}
+  const char* what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+struct EmbeddingModel {
+  int64_t id = 0;
+  std::string name;
+  int dimension = 0;
+  std::chrono::system_clock::time_point created_at;
+  bool active = false;
+};
+
+/**
+ * @class EmbeddingModelRegistry
+ * @brief The embedding models known to the database, and which one its vectors belong to.
+ *
+ * The active model's dimension sizes the vector segments and indexes MetadataStore opens, and
+ * its name is the model queries have to be embedded with for the distances to mean anything.
+ * A model's dimension is fixed once it is active; activating another one only makes sense
+ * together with the vectors it produced, so callers switching models do it in the same write.
+ * Stateless apart from the database (the table holds a handful of rows, so every query reads
+ * it whole); any number of instances can share it.
+ */
+class EmbeddingModelRegistry {
+ public:
+  explicit EmbeddingModelRegistry(DatabaseManager& db_manager);
+
+  std::optional<EmbeddingModel> active();
+  std::optional<EmbeddingModel> find(const std::string& name);
+  // Every registered model, oldest first
+  std::vector<EmbeddingModel> list();
+
+  // Registers name with dimension, or returns the existing entry. An inactive entry with
+  // another dimension holds no vectors and is resized; throws if name is the active model with
+  // another dimension, whose vectors would no longer fit.
+  EmbeddingModel register_model(const std::string& name, int dimension);
+  // Makes the registered model name the active one, on its own
+  void activate(const std::string& name);
+  // The write activate() performs, for callers that swap vectors in the same transaction
+  static void activate_in(PooledDatabase& conn, const std::string& name);
+
+  // The active model, registering and activating name first if the database has none yet (a
+  // new database, or one from before the registry)
+  EmbeddingModel ensure_active(const std::string& name, int dimension);
+
+ private:
+  DatabaseManager& db_manager_;
+};
+
+}  // namespace magic_core
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace magic_core {
+
+// Timestamp columns hold INTEGER milliseconds since the Unix epoch, so reading or writing one is
+// integer arithmetic and range filters on them can use an index
+
+inline int64_t to_epoch_millis(const std::chrono::system_clock::time_point& tp) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+inline std::chrono::system_clock::time_point from_epoch_millis(int64_t millis) {
+  return std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::milliseconds(millis)));
+}
+
+}  // namespace magic_core
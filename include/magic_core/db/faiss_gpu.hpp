@@ -0,0 +1,34 @@
+#pragma once
+
+#include <faiss/Index.h>
+
+#include <memory>
+#include <mutex>
+
+namespace magic_core::faiss_gpu {
+
+// faiss::gpu's k-selection limit on every supported build; larger k are searched on the CPU
+constexpr int MAX_K = 1024;
+
+// Whether this build links a faiss with GPU support (the MAGIC_FAISS_GPU CMake option)
+bool compiled_in();
+// CUDA devices faiss can use; 0 without GPU support
+int device_count();
+// Whether index has a GPU counterpart. faiss::gpu has flat and IVF indexes but no HNSW.
+bool supports(const faiss::Index &index);
+
+// A copy of index on device, trained or not, sharing one resource pool per device. Null when
+// there is no GPU support or device, the type has no GPU version or the copy fails (out of
+// device memory, most likely), so callers carry on with the CPU index. Takes the device lock.
+std::unique_ptr<faiss::Index> to_gpu(const faiss::Index &index, int device);
+// A CPU copy of a to_gpu() index, for serialization and the calls faiss::gpu lacks. Throws
+// faiss::FaissException on failure. Takes the device lock.
+std::unique_ptr<faiss::Index> to_cpu(const faiss::Index &index, int device);
+
+// A device's resources are not safe to use from two threads at once: every train, add or
+// search on one of its indexes holds this. Searches take try_lock so a long build on the
+// device sends them to the CPU instead of making them wait.
+std::unique_lock<std::mutex> lock(int device);
+std::unique_lock<std::mutex> try_lock(int device);
+
+}  // namespace magic_core::faiss_gpu
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace magic_core {
+
+class IndexSnapshotError : public std::exception {
+ public:
+  explicit IndexSnapshotError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+/**
+ * @class IndexSnapshot
+ * @brief Reads and writes encrypted on-disk snapshots of the in-memory vector indexes.
+ *
+ * The database itself is encrypted with SQLCipher, so snapshots are sealed with AES-256-GCM
+ * under a key derived from the database key; they would otherwise leak the embeddings in
+ * plaintext. Each snapshot records the index generation it was taken at (authenticated
+ * alongside the payload), and is only handed back when that generation is still current.
+ */
+class IndexSnapshot {
+ public:
+  // Atomically replaces the snapshot at path (write to a temporary file, then rename).
+  static void write(const std::filesystem::path &path,
+                    const std::string &db_key,
+                    long long generation,
+                    const std::vector<uint8_t> &payload);
+
+  // Returns the payload, or nullopt if the file is missing, stale, or fails to authenticate.
+  static std::optional<std::vector<uint8_t>> read(const std::filesystem::path &path,
+                                                  const std::string &db_key,
+                                                  long long expected_generation);
+
+ private:
+  static constexpr uint32_t FORMAT_VERSION = 1;
+};
+
+}  // namespace magic_core
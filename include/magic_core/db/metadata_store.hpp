@@ -2,19 +2,30 @@
 #include <faiss/Index.h>
 #include <faiss/IndexFlat.h>
 #include <faiss/IndexHNSW.h>
-#include <faiss/IndexIDMap.h>
 // Why is this file named with a different convention
 #include <faiss/index_io.h>
 #include <sqlite_modern_cpp.h>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <shared_mutex>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "magic_core/types/chunk.hpp"
 #include "magic_core/types/file.hpp"
+#include "magic_core/db/chunk_slab.hpp"
 #include "magic_core/db/database_manager.hpp"
+#include "magic_core/db/vector_index.hpp"
+#include "magic_core/db/vector_store.hpp"
 
 namespace magic_core {
 
@@ -59,6 +70,21 @@ class MetadataStoreError : public std::exception {
  private:
   std::string message_;
 };
+
+// A write carried vectors of another embedding model than the store's active one, e.g. from a
+// task that was embedding while a re-embed installed its replacement
+class EmbeddingModelMismatchError : public std::exception {
+ public:
+  explicit EmbeddingModelMismatchError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
 struct BasicFileMetadata {
   int id = 0;
   std::string path;
@@ -70,11 +96,16 @@ struct BasicFileMetadata {
   size_t file_size = 0;
   ProcessingStatus processing_status = ProcessingStatus::PROCESSED;
   std::string tags;
+  // Another path of a stored file's content: the id of the file whose chunks and summary this
+  // row shares. 0 for a file with content of its own. Ignored when writing stubs.
+  int content_source_id = 0;
 };
 struct FileMetadata : public BasicFileMetadata {
   std::vector<float> summary_vector_embedding;
   std::string suggested_category;
   std::string suggested_filename;
+  // What the generation lane made of the content; empty until its SUMMARIZE_FILE task ran
+  std::string summary;
 };
 
 struct ChunkMetadata {
@@ -84,13 +115,26 @@ struct ChunkMetadata {
   int chunk_index;
   std::vector<char> content;
 };
+// A zstd dictionary trained on stored chunks; id is the one zstd writes into its frames
+struct CompressionDictionary {
+  uint32_t id;
+  std::vector<char> dictionary;
+  int64_t sample_count;
+  // Chunks stored when it was trained, so maintenance can tell when the corpus has outgrown it
+  int64_t chunk_count;
+  std::chrono::system_clock::time_point created_at;
+};
+
 struct SearchResult {
   int id;
   float distance;
 };
 
 struct FileSearchResult : public SearchResult {
+  // Without summary_vector_embedding; get_file_summary_vector reads it if a caller needs it
   FileMetadata file;
+  // The other paths holding the same content, which share this file's chunks, sorted
+  std::vector<std::string> duplicate_paths;
 };
 
 struct ChunkSearchResult : public SearchResult {
@@ -99,15 +143,114 @@ struct ChunkSearchResult : public SearchResult {
   std::vector<char> compressed_content;
 };
 
+// Restricts a search to the files matching every field that is set. It is resolved to file ids
+// through the files table's indexes before the vector index is searched, so the ANN search only
+// ever visits matching files instead of over-fetching and dropping the rest.
+struct SearchFilter {
+  // Any of these types; empty allows every type
+  std::vector<FileType> file_types;
+  // Paths starting with this string; empty allows every path
+  std::string path_prefix;
+  // last_modified in [modified_after, modified_before)
+  std::optional<std::chrono::system_clock::time_point> modified_after;
+  std::optional<std::chrono::system_clock::time_point> modified_before;
+  // Collections to search, by name; empty searches all. ShardedMetadataStore picks its shards
+  // by it and MetadataStore, a single collection, ignores it.
+  std::vector<std::string> collections;
+
+  bool empty() const {
+    return file_types.empty() && path_prefix.empty() && !modified_after && !modified_before;
+  }
+};
+
 struct ProcessedChunk {
   Chunk chunk;
   std::vector<char> compressed_content;
+  // Hash of chunk.content that later runs diff against; empty stores none
+  std::string content_hash;
+};
+
+// A chunk row written by an earlier run over the same file
+struct StoredChunk {
+  int64_t id;
+  int chunk_index;
+  // Empty for rows written before chunk hashes were kept
+  std::string content_hash;
+  // Empty if the row has no readable vector
+  std::vector<float> vector_embedding;
+};
+
+// Another embedding model's vectors for every file and chunk, written beside the live ones by
+// a re-embed and swapped in by MetadataStore::install_replacement(). Nothing in it is visible
+// to searches before then.
+struct VectorReplacement {
+  std::string model;
+  int dimension = 0;
+  std::shared_ptr<VectorStore> file_vectors;
+  std::shared_ptr<VectorStore> chunk_vectors;
+  // chunk id -> offset in chunk_vectors. A chunk row's content never changes under its id (an
+  // edited chunk is written as a new row), so the vector stays valid while the row exists.
+  std::unordered_map<int64_t, VectorStore::Offset> chunks;
+  struct Summary {
+    // In file_vectors; nullopt if the file's chunks had no vectors to sum
+    std::optional<VectorStore::Offset> offset;
+    // The chunks it was summed from, sorted
+    std::vector<int64_t> chunk_ids;
+  };
+  std::unordered_map<int, Summary> files;
+  // Built by install_replacement() before it stops the writers; later additions go straight in
+  std::shared_ptr<VectorIndex> file_index;
+  std::shared_ptr<VectorIndex> chunk_index;
+};
+
+// What a replacement still lacks compared to the live vectors
+struct ReplacementWork {
+  // Chunks with a live vector and none in the replacement yet
+  std::vector<int64_t> chunk_ids;
+  // Files with a live summary whose replacement one is missing or was summed from other chunks
+  std::vector<int> file_ids;
+
+  bool empty() const {
+    return chunk_ids.empty() && file_ids.empty();
+  }
+};
+
+// How write_snapshot() paces its copy
+struct SnapshotOptions {
+  // Database pages copied per backup step
+  int pages_per_step = 256;
+  // Across the database, vector and index files; 0 copies as fast as the disks allow
+  size_t max_bytes_per_second = 64 * 1024 * 1024;
+};
+
+struct SnapshotInfo {
+  // The index generations the copy was taken at
+  long long files_generation = 0;
+  long long chunks_generation = 0;
+  size_t bytes = 0;
 };
 
 class MetadataStore {
  public:
-  static constexpr int VECTOR_DIMENSION = 1024;
-  explicit MetadataStore(DatabaseManager& db_manager);
+  // Dimension of the default model (mxbai-embed-large); the store's own is dimension()
+  static constexpr int DEFAULT_VECTOR_DIMENSION = 1024;
+  // Most chunks scan_similar_chunks() scores exactly for one query (16 MB of float32 vectors)
+  static constexpr size_t EXACT_SCAN_MAX_CHUNKS = 4096;
+  static constexpr size_t DEFAULT_CHUNK_SLAB_CACHE_BYTES = 128 * 1024 * 1024;
+  // index_path is where the file-level index snapshot is kept between runs; an empty path keeps
+  // the index purely in memory (it is then rebuilt from the database on every start).
+  // index_options picks the ANN structure for both the file and the chunk index. Vectors and
+  // indexes are sized for the registry's active embedding model.
+  // chunk_slab_cache_bytes caps the chunk vectors scan_similar_chunks() keeps between
+  // searches; 0 reads them from the vector store every time.
+  // IndexLoading::Deferred leaves both indexes empty until load_indexes(), so a server can
+  // start answering (and report that it is warming up) while they load.
+  enum class IndexLoading { Eager, Deferred };
+  explicit MetadataStore(DatabaseManager& db_manager,
+                         std::filesystem::path index_path = {},
+                         VectorIndexOptions index_options = {},
+                         size_t chunk_slab_cache_bytes = DEFAULT_CHUNK_SLAB_CACHE_BYTES,
+                         IndexLoading loading = IndexLoading::Eager);
   ~MetadataStore();
 
   // Disable copy constructor and assignment
@@ -121,60 +264,415 @@ class MetadataStore {
   // Initialize the database and build the Faiss index
   void initialize();
 
+  // Length of every file and chunk vector, the active embedding model's dimension
+  int dimension() const {
+    return vector_space()->dimension;
+  }
+  // The active embedding model, empty if the database has none registered. install_replacement()
+  // switches the embedding client over before this names the new model, so a writer that reads
+  // it before embedding can tag its writes with it.
+  std::string embedding_model() const {
+    return vector_space()->model;
+  }
+
   int upsert_file_stub(const BasicFileMetadata &basic_metadata);
+  // Upserts a batch of stubs in one transaction and returns their ids in order
+  std::vector<int> upsert_file_stubs(const std::vector<BasicFileMetadata> &stubs);
 
+  // embedding_model names the model the vectors of a write came from. A write whose model is
+  // no longer the active one throws EmbeddingModelMismatchError and stores nothing; an empty
+  // name skips the check, for callers that did not embed what they write.
   void update_file_ai_analysis(int file_id,
                                const std::vector<float> &summary_vector,
                                const std::string &suggested_category = "",
                                const std::string &suggested_filename = "",
-                               ProcessingStatus processing_status = ProcessingStatus::PROCESSED);
+                               ProcessingStatus processing_status = ProcessingStatus::PROCESSED,
+                               const std::string &embedding_model = {});
   void update_file_processing_status(int file_id, ProcessingStatus processing_status);
+  // Stores what the generation lane made of the file, leaving its vectors and status alone.
+  // Only written while the file still has content_hash, so a summary of content replaced while
+  // it was generated is dropped; returns whether it was stored.
+  bool update_file_suggestions(int file_id,
+                               const std::string &content_hash,
+                               const std::string &summary,
+                               const std::string &suggested_category,
+                               const std::string &suggested_filename);
 
-  void upsert_chunk_metadata(int file_id, const std::vector<ProcessedChunk> &chunks);
+  // Takes any contiguous run of chunks, so a caller can write the filled part of a buffer it reuses
+  // Checks embedding_model like update_file_ai_analysis()
+  void upsert_chunk_metadata(int file_id,
+                             std::span<const ProcessedChunk> chunks,
+                             const std::string &embedding_model = {});
+  // The file's chunk rows with their stored vectors, in chunk order
+  std::vector<StoredChunk> get_stored_chunks(int file_id);
+  // Applies a chunk diff in one write: kept rows (id, new chunk_index) stay with their vector and
+  // index entry and are renumbered; removed rows leave the database and the chunk index
+  void reconcile_chunks(int file_id,
+                        const std::vector<std::pair<int64_t, int>> &kept,
+                        const std::vector<int64_t> &removed_ids);
 
   std::vector<ChunkMetadata> get_chunk_metadata(std::vector<int> file_ids);
 
-  void fill_chunk_metadata(std::vector<ChunkSearchResult>& chunks);
+  // with_content = false leaves compressed_content empty and never reads the blobs
+  void fill_chunk_metadata(std::vector<ChunkSearchResult>& chunks, bool with_content = true);
+  // One chunk row without its vector, for fetching a search hit's content later
+  std::optional<ChunkMetadata> get_chunk(int chunk_id);
+  // Compressed content of up to limit chunks picked at random, for dictionary training
+  std::vector<std::vector<char>> sample_chunk_contents(int limit);
+  int64_t count_chunks();
+  // Every stored vector of table ("files" for summaries, "chunks") with its row id, row-major,
+  // read the way an index rebuild reads them; for offline tools. Throws MetadataStoreError for
+  // any other table.
+  void read_all_vectors(const std::string &table,
+                        std::vector<faiss::idx_t> &ids,
+                        std::vector<float> &vectors);
+
+  // Chunks the full-text index does not cover yet (stored before it existed, or during a bulk
+  // load), lowest id first starting after after_id, with their compressed content
+  std::vector<std::pair<int64_t, std::vector<char>>> chunks_missing_text(int limit,
+                                                                         int64_t after_id = 0);
+  // Adds (chunk id, plain text) pairs to the full-text index, skipping chunks deleted since
+  // they were read and ones already indexed
+  void index_chunk_text(const std::vector<std::pair<int64_t, std::string>> &texts);
+
+  void save_compression_dictionary(const CompressionDictionary &dictionary);
+  // Every stored dictionary, oldest first
+  std::vector<CompressionDictionary> get_compression_dictionaries();
 
   std::optional<FileMetadata> get_file_metadata(const std::string &path);
 
   std::optional<FileMetadata> get_file_metadata(int id);
+  // The same rows without the vector and AI columns, for callers that need id, path or status
+  std::optional<BasicFileMetadata> get_basic_file_metadata(const std::string &path);
+  std::optional<BasicFileMetadata> get_basic_file_metadata(int id);
+  // The file's summary vector, read on demand; empty if it has none
+  std::vector<float> get_file_summary_vector(int file_id);
 
-  // Delete file metadata
+  // Records each stub as another path of a stored file with the same content hash: its row
+  // points at that file and shares its chunks and summary, so nothing is extracted or embedded
+  // for it. A stub whose path is already stored with this content, or whose content only a
+  // failed file has, is left alone; its entry in the result is false. A path stored with other
+  // content becomes a duplicate, handing its own content on first (see delete_file_metadata).
+  std::vector<bool> add_duplicate_files(const std::vector<BasicFileMetadata> &stubs);
+
+  // Delete file metadata. A file other paths share content with hands its chunks and summary
+  // to the oldest of them first, so the content stays searchable under the remaining paths.
   void delete_file_metadata(const std::string &path);
+  // Deletes every file below directory and its chunks in one write, purging their vectors from
+  // both indexes. Returns the number of files deleted.
+  size_t delete_files_under(const std::string &directory);
 
   // List all files
   std::vector<FileMetadata> list_all_files();
+  // Up to limit files with id > after_id in id order, without their vectors; the last id is the
+  // cursor for the next page
+  std::vector<BasicFileMetadata> list_files_page(int64_t after_id, int limit);
+  std::vector<std::string> get_file_paths_under(const std::string &directory);
 
   // Check if file exists
   bool file_exists(const std::string &path);
   std::optional<ProcessingStatus> file_processing_status(std::string content_hash);
+  std::unordered_map<std::string, ProcessingStatus> file_processing_statuses(
+      const std::vector<std::string> &content_hashes);
 
-  std::vector<FileSearchResult> search_similar_files(const std::vector<float> &query_vector, int k);
+  // tuning overrides the index's efSearch / nprobe for this search only, and filter limits the
+  // candidate files. Chunk searches skip reading the compressed content when with_content is
+  // false.
+  std::vector<FileSearchResult> search_similar_files(const std::vector<float> &query_vector,
+                                                     int k,
+                                                     const VectorSearchOptions &tuning = {},
+                                                     const SearchFilter &filter = {});
   std::vector<ChunkSearchResult> search_similar_chunks(const std::vector<int> &file_ids,
                                                        const std::vector<float> &query_vector,
-                                                       int k);
+                                                       int k,
+                                                       const VectorSearchOptions &tuning = {},
+                                                       bool with_content = true);
+  // Batched forms of the two searches above: one index search for all queries and one
+  // metadata query for all of their hits. Element i answers query_vectors[i]; for chunks,
+  // file_ids[i] holds that query's candidate files.
+  std::vector<std::vector<FileSearchResult>> search_similar_files_batch(
+      const std::vector<std::vector<float>> &query_vectors,
+      int k,
+      const VectorSearchOptions &tuning = {},
+      const SearchFilter &filter = {});
+  std::vector<std::vector<ChunkSearchResult>> search_similar_chunks_batch(
+      const std::vector<std::vector<int>> &file_ids,
+      const std::vector<std::vector<float>> &query_vectors,
+      int k,
+      const VectorSearchOptions &tuning = {},
+      bool with_content = true);
+  // search_similar_chunks() answered by an exact scan instead of the chunk index: the
+  // candidate files' vectors are read into contiguous slabs and every one is scored, so the
+  // result is the true top k. Slabs stay cached per file until its chunks change, so repeat
+  // searches over the same files never touch the database. Candidate sets above
+  // EXACT_SCAN_MAX_CHUNKS chunks go to the index.
+  std::vector<ChunkSearchResult> scan_similar_chunks(const std::vector<int> &file_ids,
+                                                     const std::vector<float> &query_vector,
+                                                     int k,
+                                                     bool with_content = true);
+  std::vector<std::vector<ChunkSearchResult>> scan_similar_chunks_batch(
+      const std::vector<std::vector<int>> &file_ids,
+      const std::vector<std::vector<float>> &query_vectors,
+      int k,
+      bool with_content = true);
+
+  // Full-text search over chunk content: chunks holding any of the query's words, best BM25
+  // match first. distance is FTS5's bm25() score, negative and lower for better matches.
+  std::vector<ChunkSearchResult> search_chunks_lexical(const std::string &query,
+                                                       int k,
+                                                       bool with_content = true,
+                                                       const SearchFilter &filter = {});
+  // Ids of the files matching filter, answered from the files indexes. A matching duplicate
+  // contributes the file whose content it shares.
+  VectorIndex::IdFilter resolve_search_filter(const SearchFilter &filter);
+  // The FTS5 MATCH expression search_chunks_lexical uses: every word of the query quoted and
+  // OR'd together, so operators in the query are taken literally. Empty if it has no words.
+  static std::string text_match_expression(const std::string &query);
+  // Metadata of each hit's file, in hit order and carrying its distance; ids with no file row
+  // are dropped
+  std::vector<FileSearchResult> get_file_search_results(const std::vector<SearchResult> &hits);
 
+  // Incrementally add/replace or remove a single file's summary vector in the live index
+  void update_faiss_index(int file_id, const std::vector<float> &summary_vector);
+  void remove_from_faiss_index(int file_id);
+
+  // Full rebuild from the database; only needed when the index is cold or corrupted
   void rebuild_faiss_index();
+  // Same for the chunk-level index shared by all chunk searches
+  void rebuild_chunk_index();
+
+  // Loads the file and chunk index snapshots if they are still current. Returns false if either
+  // had to be ignored.
+  bool load_faiss_index();
+  // What an eager constructor does: loads both snapshots side by side, rebuilds whichever was
+  // unusable from the database and persists the rebuilt ones
+  void load_indexes();
+  // Reads the file and chunk vector segments into the page cache (VectorStore::prefault), for
+  // the exact scans and rebuilds that read them. Returns the bytes touched.
+  size_t prefault_vectors() const;
+  // Writes both index snapshots tagged with their current generations. Failures are logged, not
+  // thrown. Skipped during a bulk load, when the indexes lag the database on purpose.
+  void persist_faiss_index();
+  // Copies the database, both vector segments and both index snapshots into dir under their
+  // file names here, all as of one moment: writers are only held off while the indexes are
+  // serialized and a read of the database is pinned (DatabaseBackup), as for
+  // persist_faiss_index(); the copy then runs from the pinned state at options' pace. A node
+  // opened on the copy, with the same key, finds current snapshots and does not rebuild.
+  // finalize runs on the copied database before it is closed; on_progress gets the bytes
+  // copied and the total. Throws MetadataStoreError during a bulk load, DatabaseBackupError or
+  // VectorStoreError if the copy fails; nothing is left behind of the database copy then.
+  SnapshotInfo write_snapshot(
+      const std::filesystem::path &dir,
+      const SnapshotOptions &options = {},
+      const std::function<void(size_t copied, size_t total)> &on_progress = {},
+      const std::function<void(sqlite::database &)> &finalize = {});
+
+  // Bulk loading, for initial imports. While a load is open, stored chunks and summaries are
+  // written to the database and vector segments only: the file and chunk indexes and the
+  // full-text index are left behind, the writer commits in larger batches, and the WAL is
+  // checkpointed every BULK_CHECKPOINT_CHUNKS chunks. Searches meanwhile miss what the load has
+  // added. end_bulk_load() rebuilds both indexes once; the full-text rows are backfilled
+  // through chunks_missing_text(). A load left open by a restart needs nothing special: the
+  // snapshots it skipped are stale, so the indexes are rebuilt on startup.
+  // Returns false if a load is already open.
+  bool begin_bulk_load();
+  // Returns false if no load was open, or a BulkLoadPin holds it open
+  bool end_bulk_load();
+  // Holds the bulk load open while its owner is still queueing the load's files, so a queue
+  // that drained before the rest was queued does not end it; released on destruction
+  class BulkLoadPin {
+   public:
+    BulkLoadPin() = default;
+    BulkLoadPin(BulkLoadPin &&other) noexcept : pins_(other.pins_) {
+      other.pins_ = nullptr;
+    }
+    BulkLoadPin &operator=(BulkLoadPin &&other) noexcept {
+      if (this != &other) {
+        release();
+        pins_ = other.pins_;
+        other.pins_ = nullptr;
+      }
+      return *this;
+    }
+    BulkLoadPin(const BulkLoadPin &) = delete;
+    BulkLoadPin &operator=(const BulkLoadPin &) = delete;
+    ~BulkLoadPin() {
+      release();
+    }
+
+   private:
+    friend class MetadataStore;
+    explicit BulkLoadPin(std::atomic<int> *pins) : pins_(pins) {}
+    void release() {
+      if (pins_) {
+        pins_->fetch_sub(1, std::memory_order_acq_rel);
+        pins_ = nullptr;
+      }
+    }
+
+    std::atomic<int> *pins_ = nullptr;
+  };
+  // Taken before begin_bulk_load(), so no end_bulk_load() can come in between
+  BulkLoadPin pin_bulk_load();
+  bool bulk_loading() const {
+    return bulk_loading_.load(std::memory_order_acquire);
+  }
+  static constexpr int64_t BULK_CHECKPOINT_CHUNKS = 10000;
+  static constexpr std::chrono::milliseconds BULK_COMMIT_DELAY{20};
+  static constexpr size_t BULK_MAX_BATCH = 1024;
+
+  VectorIndexStats file_index_stats() const {
+    return vector_space()->file_index->stats();
+  }
+  VectorIndexStats chunk_index_stats() const {
+    return vector_space()->chunk_index->stats();
+  }
+  ChunkSlabCache::Stats chunk_slab_cache_stats() const {
+    return chunk_slabs_.stats();
+  }
+
+  // Replacing every vector with another embedding model's, without blocking searches or writes
+  // until the final swap. begin_replacement() opens empty segments for model; the caller embeds
+  // pending_replacement() into them with add_replacement_chunks() and then
+  // add_replacement_summaries(), repeating while writers keep changing files, and finally calls
+  // install_replacement(). model must be registered; its dimension sizes the new vectors. One
+  // replacement at a time.
+  std::unique_ptr<VectorReplacement> begin_replacement(const std::string &model);
+  ReplacementWork pending_replacement(const VectorReplacement &replacement);
+  // Compressed content of each listed chunk that still exists, in no particular order
+  std::vector<std::pair<int64_t, std::vector<char>>> get_chunk_contents(
+      const std::vector<int64_t> &chunk_ids);
+  // vectors[i] is the new model's vector for chunk_ids[i]
+  void add_replacement_chunks(VectorReplacement &replacement,
+                              const std::vector<int64_t> &chunk_ids,
+                              const std::vector<std::vector<float>> &vectors);
+  // Sums each file's replacement chunk vectors into its summary, the way a processed file's is
+  // formed. Files with chunks still missing a replacement vector are skipped.
+  void add_replacement_summaries(VectorReplacement &replacement, const std::vector<int> &file_ids);
+  // Builds the replacement's indexes, then blocks writers and runs finish with whatever changed
+  // meanwhile, which has to leave nothing pending. In one transaction the rows are pointed at
+  // the replacement vectors and model becomes the active one; the new vectors and indexes are
+  // then published together, after on_installed has run (to switch query embedding over).
+  // Searches already running finish on the old ones. replacement is consumed either way.
+  void install_replacement(VectorReplacement &replacement,
+                           const std::function<void(const ReplacementWork &)> &finish,
+                           const std::function<void()> &on_installed = {});
+
+  // Current value of the change counter for the named vector index ("files" or "chunks")
+  long long get_index_generation(const std::string &name);
+
+  // In-process counter bumped after every change that can alter a search result (vectors, file
+  // or chunk rows). A result computed while it held one value is stale once it moves on.
+  uint64_t search_generation() const {
+    return search_generation_.load(std::memory_order_acquire);
+  }
 
  private:
+  // The vectors of one embedding model and the indexes over them, replaced as a whole when a
+  // re-embed installs another model. Whoever took one keeps using it until done; writers take
+  // it under index_commit_mutex_, which the replacement holds exclusively.
+  struct VectorSpace {
+    // Empty for a database without a registered model
+    std::string model;
+    int dimension = 0;
+    // Where the summary and chunk vectors are kept; rows only hold their offsets
+    std::shared_ptr<VectorStore> file_vectors;
+    std::shared_ptr<VectorStore> chunk_vectors;
+    std::shared_ptr<VectorIndex> file_index;
+    // Keyed by chunk id; searches are restricted to the candidate files' chunks
+    std::shared_ptr<VectorIndex> chunk_index;
+  };
+
   DatabaseManager& db_manager_;
-  faiss::IndexIDMap *faiss_index_;
+  VectorIndexOptions index_options_;
+  mutable std::mutex space_mutex_;
+  std::shared_ptr<const VectorSpace> space_;
+  // Per-file chunk vectors for exact scans; a file is dropped whenever its chunks change
+  ChunkSlabCache chunk_slabs_;
+  std::filesystem::path index_path_;
+  // Held shared by writers from their DB commit until the index reflects it, and exclusively
+  // while snapshotting, so a snapshot never pairs a generation with an index that lags it.
+  // Always acquire before a pooled connection.
+  std::shared_mutex index_commit_mutex_;
+  std::atomic<uint64_t> search_generation_{0};
+  // Flipped under index_commit_mutex_ held exclusively and read by writers holding it shared,
+  // so every write either updates the indexes itself or lands before end_bulk_load()'s rebuild
+  std::atomic<bool> bulk_loading_{false};
+  std::atomic<int> bulk_load_pins_{0};
+  // Whether the open load has skipped an index update, and chunks since its last checkpoint
+  std::atomic<bool> bulk_deferred_{false};
+  std::atomic<int64_t> bulk_unchecked_chunks_{0};
+  DatabaseWriterOptions writer_options_before_bulk_;
+
+  // Content moved from a file to the duplicate that inherits it, for the index updates made
+  // once the write has committed
+  struct ContentHandover {
+    int from;
+    int heir;
+    std::vector<float> summary;
+  };
 
-  // Faiss Index Parameters - since we will support multiple embedding models, these will have to be
-  // able to change
-  const int HNSW_M_PARAM = 32;
-  const int HNSW_EF_CONSTRUCTION_PARAM = 100;
   // Helper methods
-  
-  faiss::IndexIDMap *create_base_index();
-  void search_faiss_index(faiss::IndexIDMap *index, const std::vector<float> &query_vector, int k, std::vector<float> &results, std::vector<faiss::idx_t> &labels);
+
+  // If other rows share file_id's content, makes the oldest one not listed in excluded_ids (a
+  // JSON array) its owner: the chunks move to it, it gets a copy of the summary, and the other
+  // duplicates point at it. Runs inside a writer transaction.
+  static std::optional<ContentHandover> hand_over_content(PooledDatabase &conn,
+                                                          const VectorSpace &space,
+                                                          int file_id,
+                                                          const std::string &excluded_ids);
+  void apply_handovers(const VectorSpace &space, const std::vector<ContentHandover> &handovers);
+  // Sorted duplicate paths of each listed file that has any
+  std::unordered_map<int, std::vector<std::string>> fetch_duplicate_paths(
+      const std::vector<int> &file_ids);
+
+  static std::shared_ptr<const VectorSpace> open_vector_space(
+      DatabaseManager &db_manager, const VectorIndexOptions &index_options);
+  std::shared_ptr<const VectorSpace> vector_space() const;
+  // Called once a mutation is fully visible to searches, never before
+  void bump_search_generation() {
+    search_generation_.fetch_add(1, std::memory_order_acq_rel);
+  }
+  std::filesystem::path chunk_index_path() const;
+  // PASSIVE WAL checkpoint between bulk-load batches; failures are logged
+  void checkpoint_wal();
+  // Each file's chunk vectors as one slab, from the cache where it has them, or nullopt if the
+  // files hold more than EXACT_SCAN_MAX_CHUNKS chunks between them, which is too many to scan
+  // per query. Files without chunks get an empty slab.
+  std::optional<std::unordered_map<int, std::shared_ptr<const ChunkSlab>>> load_chunk_slabs(
+      const std::vector<int> &file_ids);
+  // (offset, id) of every stored vector of table, read through offset_column, in file order
+  std::vector<std::pair<VectorStore::Offset, int64_t>> stored_vector_records(
+      const std::string &table, const std::string &offset_column);
+  // Rebuilds index from table's stored vectors, streamed in bounded batches
+  void rebuild_from_store(VectorIndex &index,
+                          const VectorStore &store,
+                          const std::string &table,
+                          const std::string &offset_column);
+  // Every stored vector of table, read through offset_column, at once
+  void read_stored_vectors(const VectorStore &store,
+                           const std::string &table,
+                           const std::string &offset_column,
+                           std::vector<faiss::idx_t> &ids,
+                           std::vector<float> &vectors_flat);
+  void load_summary_vector(FileMetadata &metadata, const std::optional<int64_t> &offset) const;
+  bool load_index_snapshot(VectorIndex &index,
+                           const std::filesystem::path &path,
+                           const std::string &generation_name);
+
+  // [lower, upper) bounds on path that select exactly the paths below directory
+  static std::pair<std::string, std::string> path_range_under(const std::string &directory);
 
   std::chrono::system_clock::time_point get_file_last_modified(
       const std::filesystem::path &file_path);
-  // Time point conversions
-  std::string time_point_to_string(const std::chrono::system_clock::time_point &tp);
-  std::chrono::system_clock::time_point string_to_time_point(const std::string &time_str);
-  std::string int_vector_to_comma_string(const std::vector<int> &vector);
+  // "[1,2,3]", bound as one parameter and expanded with json_each() so the SQL text stays fixed
+  static std::string int_vector_to_json_array(const std::vector<int> &vector);
+  // Metadata of every listed file that still exists, in one query
+  // Search hit enrichment; summary vectors are left unread
+  std::unordered_map<int, FileMetadata> fetch_file_metadata(const std::vector<int> &file_ids);
+  // column is "path" or "id"
+  template <typename Key>
+  std::optional<BasicFileMetadata> query_basic_file_metadata(const std::string &column,
+                                                             const Key &key);
 };
 }  // namespace magic_core
\ No newline at end of file
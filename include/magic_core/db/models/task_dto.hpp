@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <optional>
 #include <stdexcept>
 #include <string>
 
@@ -34,17 +35,45 @@ inline TaskStatus task_status_from_string(const std::string &str) {
   throw std::invalid_argument("Invalid TaskStatus string: " + str);
 }
 
+// Lower values are claimed first. The HTTP API queues single files as INTERACTIVE and directory
+// crawls as BULK; the file watcher and tasks created without a priority get NORMAL.
+struct TaskPriority {
+  static constexpr int INTERACTIVE = 0;
+  static constexpr int NORMAL = 10;
+  static constexpr int BULK = 20;
+};
+
+// The tasks a worker claims. Priorities up to NORMAL are in the interactive lane, the rest in
+// the bulk lane; Any takes both, in aged priority order. SUMMARIZE_FILE tasks are in none of
+// them but in the generation lane, so slow LLM calls never hold up embedding.
+enum class TaskLane { Any, Interactive, Bulk, Generation };
+
+inline TaskLane task_lane_from_string(const std::string &str) {
+  if (str == "any")
+    return TaskLane::Any;
+  if (str == "interactive")
+    return TaskLane::Interactive;
+  if (str == "bulk")
+    return TaskLane::Bulk;
+  if (str == "generation")
+    return TaskLane::Generation;
+  throw std::invalid_argument("Invalid TaskLane string: " + str);
+}
+
 struct TaskDTO {
   long long id = 0;
   std::string task_type;
   TaskStatus status = TaskStatus::PENDING;
-  int priority = 10;
+  int priority = TaskPriority::NORMAL;
   std::chrono::system_clock::time_point created_at;
   std::chrono::system_clock::time_point updated_at;
   std::optional<std::string> target_path;
   std::optional<std::string> target_tag;
   std::optional<std::string> payload;
   std::optional<std::string> error_message;
+  // Who holds the claim on a PROCESSING task, and how many times it has been claimed
+  std::optional<std::string> lease_owner;
+  int attempts = 0;
 };
 
 }  // namespace magic_core
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace magic_core {
+
+/**
+ * @class NearDuplicateIndex
+ * @brief SimHash fingerprints of embedded chunks -> their embedding cache keys.
+ *
+ * Templated documents repeat chunks that differ only in a date or a name, which the exact
+ * content key of EmbeddingCache never matches. A fingerprint is a 64-bit SimHash over the
+ * chunk's word pairs, with every number counted as the same word, so texts that share most
+ * pairs land a few bits apart: a date and a name changed in a 200-word chunk moves 5 or 6 bits
+ * on average and rarely more than 8, where unrelated text differs in 20 or more. The index
+ * finds a remembered fingerprint within max_distance bits through max_distance + 1 bands: two
+ * fingerprints that far apart agree on at least one band, so only the entries sharing a band
+ * are compared. Entries live in memory only, the oldest evicted first once capacity is
+ * reached. Thread-safe.
+ */
+class NearDuplicateIndex {
+ public:
+  // 9 bands of 7 bits; beyond that the bands get too narrow to leave few entries to compare
+  static constexpr int MAX_DISTANCE = 8;
+  static constexpr int DEFAULT_DISTANCE = 7;
+  // Words per shingle, and the fewest shingles a text needs for a fingerprint: below that one
+  // changed word moves too many bits to tell edits from different text
+  static constexpr size_t SHINGLE_WORDS = 2;
+  static constexpr size_t MIN_SHINGLES = 16;
+
+  // max_distance must be 0 to MAX_DISTANCE; throws std::invalid_argument otherwise
+  explicit NearDuplicateIndex(size_t capacity, int max_distance = DEFAULT_DISTANCE);
+
+  NearDuplicateIndex(const NearDuplicateIndex&) = delete;
+  NearDuplicateIndex& operator=(const NearDuplicateIndex&) = delete;
+
+  // SimHash of text's lower-cased word shingles; nullopt for texts under MIN_SHINGLES
+  static std::optional<uint64_t> fingerprint(std::string_view text);
+
+  // Key of the remembered fingerprint nearest to fingerprint, if one is within max_distance
+  std::optional<std::string> find(uint64_t fingerprint) const;
+  // Remembers key under fingerprint, evicting the oldest entry when full
+  void insert(uint64_t fingerprint, std::string key);
+  void clear();
+  size_t size() const;
+
+ private:
+  static constexpr size_t MAX_BANDS = MAX_DISTANCE + 1;
+
+  struct Entry {
+    uint64_t fingerprint = 0;
+    std::string key;
+  };
+
+  uint64_t band(uint64_t fingerprint, size_t b) const {
+    return (fingerprint >> (band_bits_ * b)) & band_mask_;
+  }
+
+  const size_t capacity_;
+  const int max_distance_;
+  const size_t bands_used_;
+  const size_t band_bits_;
+  const uint64_t band_mask_;
+  mutable std::mutex mutex_;
+  // Ring of capacity_ entries; next_ is the slot written next, and evicted once the ring is full
+  std::vector<Entry> entries_;
+  size_t next_ = 0;
+  // Band value -> slots whose fingerprint has it, one map per band in use
+  std::array<std::unordered_multimap<uint64_t, size_t>, MAX_BANDS> bands_;
+};
+
+}  // namespace magic_core
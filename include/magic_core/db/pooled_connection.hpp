@@ -1,14 +1,20 @@
 #pragma once
 #include "magic_core/db/database_manager.hpp"
+#include "magic_core/types/metrics.hpp"
 #include <sqlite_modern_cpp.h>
+#include <chrono>
 #include <memory>
+#include <string>
 
 namespace magic_core {
 class PooledConnection {
 public:
-    // Constructor gets a connection from the manager's pool
-    explicit PooledConnection(DatabaseManager& manager)
-    : manager_(manager), conn_(manager.get_connection()) {
+    // Constructor gets a connection from the manager's pool for that access; queries that never
+    // write should ask for ReadOnly
+    explicit PooledConnection(DatabaseManager& manager,
+                              ConnectionAccess access = ConnectionAccess::ReadWrite)
+    : manager_(manager), access_(access), conn_(manager.get_connection(access)),
+      acquired_(std::chrono::steady_clock::now()) {
     if (!conn_) {
         throw std::runtime_error("Failed to acquire database connection: system is shutting down.");
     }
@@ -16,13 +22,25 @@ public:
     // Destructor automatically returns the connection
     ~PooledConnection() {
         if (conn_) {
-            manager_.return_connection(std::move(conn_));
+            if (access_ == ConnectionAccess::ReadOnly) {
+                // Read connections are scoped to their queries, so this is the queries' time
+                static metrics::Histogram& read_seconds = metrics::histogram(
+                    "magic_sqlite_read_seconds", "Time read-only connections were held");
+                read_seconds.observe(std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - acquired_).count());
+            }
+            manager_.return_connection(std::move(conn_), access_);
         }
     }
 
     // Allow access to the underlying database object
-    sqlite::database* operator->() const { return conn_.get(); }
-    sqlite::database& operator*() const { return *conn_; }
+    sqlite::database* operator->() const { return &conn_->db; }
+    sqlite::database& operator*() const { return conn_->db; }
+
+    // This connection's prepared statement for sql, for queries whose text never changes
+    sqlite::database_binder& prepare(const std::string& sql) const {
+        return conn_->prepare(sql);
+    }
 
     // Delete copy/move to prevent ownership issues
     PooledConnection(const PooledConnection&) = delete;
@@ -30,6 +48,8 @@ public:
 
 private:
     magic_core::DatabaseManager& manager_;
-    std::unique_ptr<sqlite::database> conn_;
+    ConnectionAccess access_;
+    std::unique_ptr<PooledDatabase> conn_;
+    std::chrono::steady_clock::time_point acquired_;
 };
 }  // namespace magic_core
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <sqlite_modern_cpp.h>
+
+#include <string>
+
+namespace magic_core {
+
+class SchemaMigrationError : public std::exception {
+ public:
+  explicit SchemaMigrationError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+// The schema is versioned by PRAGMA user_version. Each numbered migration takes it one version
+// further and commits together with the version it reaches, so an interrupted upgrade resumes
+// at the first step that did not commit. A new database is created by running them all.
+
+// The version this build creates and expects
+int latest_schema_version();
+// The version recorded in db; 0 for a new database or one created before versioning
+int schema_version(sqlite::database &db);
+// Runs the migrations db has not had yet. Throws SchemaMigrationError if db is at a version
+// newer than this build knows or a migration fails; the failed step is rolled back.
+void migrate_schema(sqlite::database &db);
+
+}  // namespace magic_core
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace magic_core {
+
+class ShardMapError : public std::exception {
+ public:
+  explicit ShardMapError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+// How a file's path picks its shard
+enum class ShardingStrategy {
+  // The shard of the longest configured root the path is under; a hash of the path otherwise
+  FolderRoot,
+  // A stable hash of the whole path
+  PathHash,
+};
+
+// "folder" or "hash"; throws ShardMapError otherwise
+ShardingStrategy parse_sharding_strategy(const std::string &name);
+
+// A named folder with indexes of its own: every file under root
+struct Collection {
+  std::string name;
+  std::string root;
+};
+
+/**
+ * @class ShardMap
+ * @brief Which of N metadata databases a file belongs to.
+ *
+ * Every shard is a database of its own, with its own pools, writer, vector segments and
+ * indexes, so writes to different shards never wait on one WAL lock. A shard hands out file and
+ * chunk ids from its own range of SHARD_ID_STRIDE ids, which makes ids unique across shards
+ * and lets an id name its shard without a lookup. The ranges are bounded: a shard that used up
+ * its ids refuses new rows rather than hand out ids of the next shard's range. The layout is
+ * fixed once files are stored: changing the shard count, strategy or roots moves paths to
+ * shards that do not hold them.
+ *
+ * A map of collections gives every collection a shard of its own, named and picked by the
+ * collection's root; DEFAULT_COLLECTION, shard 0, holds the paths under none of them.
+ */
+class ShardMap {
+ public:
+  static constexpr size_t MAX_SHARDS = 16;
+  // Ids are ints; 16 ranges of 2^27 fill the positive ones, the last one id short
+  static constexpr int64_t SHARD_ID_STRIDE = int64_t{1} << 27;
+  static constexpr const char *DEFAULT_COLLECTION = "default";
+
+  // One shard holding everything
+  ShardMap() : ShardMap(1) {}
+  // With FolderRoot, a path under roots[i] goes to shard i % shard_count
+  explicit ShardMap(size_t shard_count,
+                    ShardingStrategy strategy = ShardingStrategy::PathHash,
+                    std::vector<std::string> roots = {});
+  // Shard 0 is DEFAULT_COLLECTION and shard i + 1 collections[i]. Throws ShardMapError for a
+  // missing or repeated name or root, or more collections than shards.
+  static ShardMap for_collections(const std::vector<Collection> &collections);
+
+  size_t shard_count() const {
+    return shard_count_;
+  }
+  size_t shard_for_path(const std::string &path) const;
+  // The shard whose id range holds id
+  size_t shard_for_id(int64_t id) const;
+
+  // Whether shards are collections, with names
+  bool has_collections() const {
+    return !names_.empty();
+  }
+  // The shard of the named collection; nullopt if there is none by that name
+  std::optional<size_t> collection_shard(const std::string &name) const;
+  // Name and root of the collection in shard; empty without collections, and the root of
+  // DEFAULT_COLLECTION is empty too
+  std::string collection_name(size_t shard) const;
+  std::string collection_root(size_t shard) const;
+
+  // The first file and chunk id shard hands out
+  static int64_t first_id(size_t shard) {
+    return static_cast<int64_t>(shard) * SHARD_ID_STRIDE + 1;
+  }
+  // The last one, kept within int
+  static int64_t last_id(size_t shard) {
+    return std::min<int64_t>(first_id(shard + 1) - 1, std::numeric_limits<int32_t>::max());
+  }
+  // Shard 0 is the database at db_path itself; metadata.db -> metadata.shard1.db for the rest
+  static std::filesystem::path shard_db_path(const std::filesystem::path &db_path, size_t shard);
+
+ private:
+  size_t shard_count_;
+  ShardingStrategy strategy_;
+  std::vector<std::string> roots_;
+  // Collection names by shard, when the shards are collections
+  std::vector<std::string> names_;
+};
+
+}  // namespace magic_core
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "magic_core/db/metadata_store.hpp"
+#include "magic_core/db/shard_map.hpp"
+#include "magic_core/db/vector_index.hpp"
+
+namespace magic_core {
+
+namespace async {
+class WorkStealingExecutor;
+}
+
+// A collection's shard, as FileInfoService::list_collections reports it
+struct CollectionInfo {
+  std::string name;
+  std::string root;
+  VectorIndexStats file_index;
+  VectorIndexStats chunk_index;
+  bool bulk_loading = false;
+};
+
+/**
+ * @class ShardedMetadataStore
+ * @brief The metadata stores of every shard, behind the calls that have to reach all of them.
+ *
+ * Writes and lookups of one file go to the shard that holds it: for_path() for a path, for_id()
+ * for a file or chunk id. Searches fan out over a pool of shard_count() - 1 threads, the calling
+ * thread taking the first shard, and the per-shard top-k lists are k-way merged by ascending
+ * distance. Candidate files of a chunk search only go to the shards that hold them, and a
+ * SearchFilter naming collections only to theirs. A single store is a ShardedMetadataStore of
+ * one shard, which calls straight through.
+ */
+class ShardedMetadataStore {
+ public:
+  explicit ShardedMetadataStore(std::shared_ptr<MetadataStore> store);
+  // shards[i] is shard i of map
+  ShardedMetadataStore(ShardMap map, std::vector<std::shared_ptr<MetadataStore>> shards);
+  ~ShardedMetadataStore();
+
+  ShardedMetadataStore(const ShardedMetadataStore &) = delete;
+  ShardedMetadataStore &operator=(const ShardedMetadataStore &) = delete;
+
+  size_t shard_count() const {
+    return shards_.size();
+  }
+  const ShardMap &shard_map() const {
+    return map_;
+  }
+  MetadataStore &shard(size_t index) const {
+    return *shards_.at(index);
+  }
+  const std::shared_ptr<MetadataStore> &shard_ptr(size_t index) const {
+    return shards_.at(index);
+  }
+  MetadataStore &for_path(const std::string &path) const {
+    return *shards_[map_.shard_for_path(path)];
+  }
+  MetadataStore &for_id(int64_t id) const {
+    return *shards_[map_.shard_for_id(id)];
+  }
+
+  // Every shard embeds with the same model; these are shard 0's
+  int dimension() const {
+    return shards_.front()->dimension();
+  }
+  std::string embedding_model() const {
+    return shards_.front()->embedding_model();
+  }
+  // Moves on whenever any shard's does
+  uint64_t search_generation() const;
+  // One entry per shard when the shards are collections; empty otherwise
+  std::vector<CollectionInfo> collections() const;
+
+  std::vector<FileSearchResult> search_similar_files(const std::vector<float> &query_vector,
+                                                     int k,
+                                                     const VectorSearchOptions &tuning = {},
+                                                     const SearchFilter &filter = {});
+  std::vector<std::vector<FileSearchResult>> search_similar_files_batch(
+      const std::vector<std::vector<float>> &query_vectors,
+      int k,
+      const VectorSearchOptions &tuning = {},
+      const SearchFilter &filter = {});
+  std::vector<ChunkSearchResult> search_similar_chunks(const std::vector<int> &file_ids,
+                                                       const std::vector<float> &query_vector,
+                                                       int k,
+                                                       const VectorSearchOptions &tuning = {},
+                                                       bool with_content = true);
+  std::vector<std::vector<ChunkSearchResult>> search_similar_chunks_batch(
+      const std::vector<std::vector<int>> &file_ids,
+      const std::vector<std::vector<float>> &query_vectors,
+      int k,
+      const VectorSearchOptions &tuning = {},
+      bool with_content = true);
+  std::vector<ChunkSearchResult> scan_similar_chunks(const std::vector<int> &file_ids,
+                                                     const std::vector<float> &query_vector,
+                                                     int k,
+                                                     bool with_content = true);
+  std::vector<std::vector<ChunkSearchResult>> scan_similar_chunks_batch(
+      const std::vector<std::vector<int>> &file_ids,
+      const std::vector<std::vector<float>> &query_vectors,
+      int k,
+      bool with_content = true);
+  std::vector<ChunkSearchResult> search_chunks_lexical(const std::string &query,
+                                                       int k,
+                                                       bool with_content = true,
+                                                       const SearchFilter &filter = {});
+  // In hit order, as MetadataStore::get_file_search_results
+  std::vector<FileSearchResult> get_file_search_results(const std::vector<SearchResult> &hits);
+  std::optional<ChunkMetadata> get_chunk(int chunk_id);
+  // Every shard's dictionaries; each shard trains its own
+  std::vector<CompressionDictionary> get_compression_dictionaries();
+
+  std::optional<FileMetadata> get_file_metadata(const std::string &path);
+  void delete_file_metadata(const std::string &path);
+  size_t delete_files_under(const std::string &directory);
+  std::vector<FileMetadata> list_all_files();
+  // Shards are walked in the order of their id ranges, so the last id stays a valid cursor
+  std::vector<BasicFileMetadata> list_files_page(int64_t after_id, int limit);
+
+  // Returns true if any shard opened a load
+  bool begin_bulk_load();
+  void persist_faiss_index();
+
+ private:
+  // The shards filter.collections names, all of them if it names none. Throws
+  // std::invalid_argument for a name that is no collection.
+  std::vector<bool> shards_for(const SearchFilter &filter) const;
+  // The shards given at least one candidate file
+  std::vector<bool> shards_with_work(const std::vector<std::vector<int>> &split) const;
+  std::vector<bool> shards_with_work(const std::vector<std::vector<std::vector<int>>> &split) const;
+  // file_ids split by the shard holding each one
+  std::vector<std::vector<int>> split_by_shard(const std::vector<int> &file_ids) const;
+  std::vector<std::vector<std::vector<int>>> split_by_shard(
+      const std::vector<std::vector<int>> &file_ids) const;
+
+  ShardMap map_;
+  std::vector<std::shared_ptr<MetadataStore>> shards_;
+  std::vector<bool> all_shards_;
+  // Runs the shards after the first one; null with a single shard
+  std::unique_ptr<async::WorkStealingExecutor> executor_;
+};
+
+}  // namespace magic_core
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <sqlite_modern_cpp.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace magic_core {
+
+/**
+ * @class StatementCache
+ * @brief Statements prepared once on a connection and reused for every later call with the
+ * same SQL text.
+ *
+ * Belongs to a single pooled connection and is only touched by whoever holds that connection,
+ * so it needs no locking. Only SQL with a fixed text belongs here: variable id lists are bound
+ * as one JSON array parameter and expanded with json_each() instead of being spliced into the
+ * text. A cached statement must not be re-entered from its own row callback.
+ */
+class StatementCache {
+ public:
+  // The cached statement for sql with its bindings cleared, prepared on first use. Bind its
+  // parameters and run it with >> or execute().
+  sqlite::database_binder& get(sqlite::database& db, const std::string& sql);
+
+  size_t size() const {
+    return statements_.size();
+  }
+
+  // Far above the number of distinct hot statements; reaching it means SQL text is being built
+  // at runtime, so the cache starts over rather than growing without bound
+  static constexpr size_t MAX_STATEMENTS = 128;
+
+ private:
+  std::unordered_map<std::string, std::unique_ptr<sqlite::database_binder>> statements_;
+};
+
+}  // namespace magic_core
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <vector>
@@ -22,29 +26,180 @@ class TaskQueueRepoError : public std::exception {
   std::string message_;
 };
 
+// Thrown when a task's lease ran out and it was reclaimed, so its current owner must drop it
+class TaskLeaseLostError : public std::exception {
+ public:
+  explicit TaskLeaseLostError(const std::string& message) : message_(message) {}
+  const char* what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+// A change to a task made through a TaskQueueRepo: a progress report, or the task's completion
+// or failure
+struct TaskUpdate {
+  long long task_id;
+  TaskStatus status;
+  float progress_percent;
+  // The progress message, or the error of a failed task
+  std::string message;
+};
+
 class TaskQueueRepo {
  public:
-  explicit TaskQueueRepo(DatabaseManager& db_manager);
+  static constexpr std::chrono::milliseconds DEFAULT_PROGRESS_FLUSH_INTERVAL{500};
+  static constexpr std::chrono::milliseconds DEFAULT_LEASE_DURATION{120000};
+  // Claims a task may go through before it is failed instead of reclaimed again, so a file that
+  // crashes the process every time cannot keep taking it down
+  static constexpr int MAX_TASK_ATTEMPTS = 3;
 
+  // progress_flush_interval bounds how often report_task_progress() writes a task's progress.
+  // Claims hold a lease of lease_duration that their owner renews while it works.
+  explicit TaskQueueRepo(
+      DatabaseManager& db_manager,
+      std::chrono::milliseconds progress_flush_interval = DEFAULT_PROGRESS_FLUSH_INTERVAL,
+      std::chrono::milliseconds lease_duration = DEFAULT_LEASE_DURATION);
+
+  // A path has at most one pending task of each type. Queueing it again returns that task
+  // instead of a new one; the task keeps its place in the queue and takes the more urgent of
+  // the two priorities. A task already claimed is not affected, but find_superseding_task()
+  // tells its worker about the newer one.
   long long create_file_process_task(const std::string& task_type,
                         const std::string& file_path,
-                        int priority = 10);
+                        int priority = TaskPriority::NORMAL);
+  // Queues a task for every path in one transaction and returns the ids in order, coalesced
+  // like create_file_process_task
+  std::vector<long long> create_file_process_tasks(const std::string& task_type,
+                                                   const std::vector<std::string>& file_paths,
+                                                   int priority = TaskPriority::NORMAL);
+  // Queues a task that targets a tag or name instead of a path (e.g. REEMBED's model)
+  long long create_tagged_task(const std::string& task_type,
+                               const std::string& target_tag,
+                               int priority = TaskPriority::NORMAL);
+
+  // Queues a task on a path that also carries a tag (e.g. SUMMARIZE_FILE's content hash),
+  // coalesced like create_file_process_task; the pending task takes the newer tag
+  long long create_tagged_file_task(const std::string& task_type,
+                                    const std::string& file_path,
+                                    const std::string& target_tag,
+                                    int priority = TaskPriority::NORMAL);
+
+  std::optional<TaskDTO> fetch_and_claim_next_task(TaskLane lane = TaskLane::Any,
+                                                   const std::string& lease_owner = {});
+  // Claims up to max_tasks pending tasks of lane at once, highest priority first. A pending task
+  // gains a priority level per minute it waits, so low priorities are delayed, never starved.
+  // The claims are leased to lease_owner, instance_id() if empty. Expired leases are reclaimed
+  // first, at most once per half lease.
+  std::vector<TaskDTO> fetch_and_claim_tasks(int max_tasks,
+                                             TaskLane lane = TaskLane::Any,
+                                             const std::string& lease_owner = {});
+  // Returns claimed tasks that were never started to the queue. One whose path was queued again
+  // since is completed instead, as that pending task supersedes it.
+  void release_claimed_tasks(const std::vector<long long>& task_ids);
+
+  // Extends the lease on a claimed task. False if lease_owner no longer holds it.
+  bool renew_lease(long long task_id, const std::string& lease_owner);
+  // Returns PROCESSING tasks whose lease ran out to the queue, or fails them once they used up
+  // MAX_TASK_ATTEMPTS; those whose path has a pending task already are completed instead.
+  // Returns how many tasks were reclaimed, failed or completed.
+  size_t reclaim_expired_leases();
+  // Identifies this repo's claims; a process restarted with the same database gets a new one
+  const std::string& instance_id() const {
+    return instance_id_;
+  }
+  std::chrono::milliseconds lease_duration() const {
+    return lease_duration_;
+  }
 
-  std::optional<TaskDTO> fetch_and_claim_next_task();
+  // Called after every task this repo creates, so in-process workers can pick it up without
+  // polling. Pass nullptr to clear it.
+  void set_task_created_listener(std::function<void()> listener);
+  // Called with every progress report and every completion or failure, on the thread that made
+  // it: progress before its deferred write, status changes once written. Subscribers can follow
+  // running tasks without reading the database. It must not block or call back into the repo.
+  // Pass nullptr to clear it.
+  void set_task_update_listener(std::function<void(const TaskUpdate&)> listener);
 
-  void update_task_status(long long task_id, TaskStatus new_status);
-  void mark_task_as_failed(long long task_id, const std::string& error_message);
+  // Both also persist and drop the task's in-memory progress. Given a lease_owner, they only
+  // write while it still holds the task's claim, so a worker whose lease expired cannot
+  // overwrite the outcome of whoever reclaimed it. False if nothing was written.
+  bool update_task_status(long long task_id,
+                          TaskStatus new_status,
+                          const std::string& lease_owner = {});
+  bool mark_task_as_failed(long long task_id,
+                           const std::string& error_message,
+                           const std::string& lease_owner = {});
+  // Completes task_id in a copy of the queue's database (e.g. a snapshot's), so that a node
+  // started on the copy does not run it again
+  static void complete_task_in_copy(sqlite::database& copy, long long task_id);
   std::vector<TaskDTO> get_tasks_by_status(TaskStatus status);
+  // Up to limit tasks with id > after_id in id order, optionally of one status only
+  std::vector<TaskDTO> list_tasks_page(std::optional<TaskStatus> status,
+                                       long long after_id,
+                                       int limit);
+  std::optional<TaskDTO> get_task(long long task_id);
+  // A COUNT over the status index, cheap enough to poll
+  size_t count_tasks_by_status(TaskStatus status);
+  // Pending tasks a worker of lane could claim, over the same index as the claims
+  size_t count_pending_tasks(TaskLane lane);
+  // Claimed tasks of lane's kind, by the same lane condition
+  size_t count_claimed_tasks(TaskLane lane);
+  // The newest task of the same type on task_id's path queued after it, whatever its status, if
+  // any: it redoes or has already redone task_id's work, so task_id's worker can stop early
+  std::optional<long long> find_superseding_task(long long task_id);
   void clear_completed_tasks(int older_than_days = 7);
+  // Writes progress now and waits for the commit
   void upsert_task_progress(long long task_id, float percent, const std::string& message);
+  // For the progress callbacks of running tasks: records progress in memory, where
+  // get_task_progress() sees it at once, and writes it to task_progress in the background at
+  // most once per flush interval. Updates in between are coalesced into the latest one.
+  void report_task_progress(long long task_id, float percent, const std::string& message);
+  // The in-memory progress of a running task in this process, else what task_progress holds
   std::optional<TaskProgressDTO> get_task_progress(long long task_id);
 
-  // Utility functions for time conversion
+  // "YYYY-MM-DD HH:MM:SS" in UTC, as the API shows timestamps. The database stores epoch
+  // millis and never goes through this.
   static std::string time_point_to_string(const std::chrono::system_clock::time_point& tp);
-  static std::chrono::system_clock::time_point string_to_time_point(const std::string& time_str);
+
+  // A task_progress row as stored
+  struct ProgressRecord {
+    long long task_id;
+    float percent;
+    std::string message;
+    int64_t updated_at;  // Epoch millis
+  };
 
  private:
+  struct ProgressTable;
+
+  static TaskProgressDTO to_dto(const ProgressRecord& progress);
+
+  size_t count_lane_tasks(TaskStatus status, TaskLane lane, const std::string& operation);
+  void notify_task_created();
+  void notify_task_updated(const TaskUpdate& update);
+  // Publishes the move of claimed tasks to status, which their worker did not report
+  void notify_released(const std::vector<long long>& task_ids,
+                       TaskStatus status,
+                       const std::string& message);
+  // Removes the task's in-memory progress, returning it if it was never written. last_percent,
+  // when given, gets the latest reported percent, written or not (0 without a report).
+  std::optional<ProgressRecord> take_unflushed_progress(long long task_id,
+                                                        float* last_percent = nullptr);
+
   DatabaseManager& db_manager_;
+  // Shared with queued flushes, which can outlive the repo
+  std::shared_ptr<ProgressTable> progress_;
+  std::chrono::milliseconds progress_flush_interval_;
+  std::chrono::milliseconds lease_duration_;
+  const std::string instance_id_;
+  std::mutex reclaim_mutex_;
+  std::chrono::steady_clock::time_point last_reclaim_{};
+  std::mutex listener_mutex_;
+  std::function<void()> task_created_listener_;
+  std::function<void(const TaskUpdate&)> task_update_listener_;
 };
 
 }  // namespace magic_core
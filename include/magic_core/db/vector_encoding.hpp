@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace magic_core {
+
+// How a vector segment keeps each vector on disk. Readers always get float32 back.
+enum class VectorEncoding : uint32_t {
+  // 4 bytes per dimension, exact
+  Float32 = 0,
+  // IEEE half precision, 2 bytes per dimension, about 3 significant digits
+  Float16 = 1,
+  // A float32 scale (max |x| / 127) followed by one signed byte per dimension
+  Int8 = 2,
+};
+
+// Accepts "float32", "float16" and "int8"; throws std::invalid_argument otherwise
+VectorEncoding parse_vector_encoding(const std::string &name);
+std::string to_string(VectorEncoding encoding);
+
+// Bytes one dimension-sized vector takes in encoding
+size_t encoded_vector_size(VectorEncoding encoding, int dimension);
+
+// Writes encoded_vector_size(encoding, dimension) bytes to out. Float16 rounds to nearest even;
+// Int8 rounds each value to the nearest step of its vector's scale.
+void encode_vector(VectorEncoding encoding, const float *in, int dimension, unsigned char *out);
+// The inverse, writing dimension floats to out. Float16 is converted with F16C (x86) or NEON
+// (aarch64) when the CPU has it, picked at runtime.
+void decode_vector(VectorEncoding encoding, const unsigned char *in, int dimension, float *out);
+
+}  // namespace magic_core
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <faiss/Index.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace magic_core {
+
+class VectorIndexError : public std::exception {
+ public:
+  explicit VectorIndexError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+struct VectorIndexHit {
+  faiss::idx_t id;
+  float distance;
+};
+
+enum class VectorIndexType {
+  // Exact brute force; no graph, float32 vectors. Fine for small folders.
+  Flat,
+  // HNSW graph over float32 vectors (4 KB per 1024-d vector plus links)
+  Hnsw,
+  // HNSW graph over 8-bit scalar quantized vectors, 4x smaller storage
+  HnswSq8,
+  // Inverted lists over product quantized codes, dimension / pq_subquantizers times smaller
+  IvfPq,
+};
+
+// Accepts "flat", "hnsw", "hnsw_sq8" and "ivf_pq"; throws VectorIndexError otherwise
+VectorIndexType parse_vector_index_type(const std::string &name);
+std::string to_string(VectorIndexType type);
+
+enum class VectorMetric {
+  // Squared euclidean distance between the vectors as given
+  L2,
+  // Inner product between L2-normalized vectors. The index normalizes what it is given, on
+  // insert and at query time alike, and reports 1 - cosine similarity as the distance (0 is
+  // identical, 2 opposite), so hit ordering stays ascending.
+  Cosine,
+};
+
+// Accepts "l2" and "cosine"; throws VectorIndexError otherwise
+VectorMetric parse_vector_metric(const std::string &name);
+std::string to_string(VectorMetric metric);
+
+struct VectorIndexOptions {
+  VectorIndexType type = VectorIndexType::Hnsw;
+  VectorMetric metric = VectorMetric::L2;
+  // HNSW graph degree and build-time beam width
+  int hnsw_m = 32;
+  int ef_construction = 100;
+  // HNSW search-time beam width used when a search does not ask for one
+  int ef_search = 64;
+  // IVF-PQ: coarse lists, bytes per code (must divide the dimension) and lists probed per search
+  int ivf_lists = 1024;
+  int pq_subquantizers = 128;
+  int nprobe = 16;
+  // Vectors sampled from a rebuild to train quantizers
+  size_t training_sample = 100000;
+  // CUDA device to build IVF-PQ indexes on and to search batches on, when the build has faiss
+  // GPU support (see faiss_gpu.hpp); -1 keeps everything on the CPU. HNSW types have no GPU
+  // version and stay on the CPU regardless.
+  int gpu_device = -1;
+  // Smaller batches are searched on the CPU, where they do not wait on transfers
+  size_t gpu_min_batch = 16;
+};
+
+// Per-search recall/latency knobs; 0 falls back to the index's configured value. Larger values
+// visit more of the index, raising recall at the cost of latency.
+struct VectorSearchOptions {
+  // HNSW beam width; never below k
+  int ef_search = 0;
+  // IVF lists scanned
+  int nprobe = 0;
+};
+
+// Point-in-time counters of one index snapshot, for deciding when it needs a rebuild
+struct VectorIndexStats {
+  // Live and tombstoned vectors
+  size_t size = 0;
+  size_t tombstones = 0;
+  // Live vectors the snapshot was built (and, for quantized types, trained) from
+  size_t built_size = 0;
+  // False while the index is still the flat stand-in for an untrained quantized type
+  bool uses_configured_type = true;
+  size_t min_training_vectors = 0;
+  // Whether batched searches run on a GPU copy of the snapshot
+  bool gpu = false;
+};
+
+/**
+ * @class VectorIndex
+ * @brief A thread-safe ANN index keyed by external ids that can be updated in place.
+ *
+ * The faiss index behind it is picked by VectorIndexOptions::type. None of them delete
+ * cheaply, so every vector lives in an internal "slot" and the index keeps a slot <-> external
+ * id mapping. Replacing or removing an id tombstones its old slot, and tombstoned slots are
+ * filtered out at query time through a faiss IDSelector. A rebuild drops all tombstones.
+ *
+ * Quantized types need training. A rebuild trains them on a sample of its vectors; until a
+ * rebuild has seen enough vectors to train on (min_training_vectors()), the index stays exact
+ * and flat, which is also the right choice at that size.
+ *
+ * Searches can be restricted to a set of external ids. Small candidate sets are scored exactly
+ * against their (decoded) stored vectors, since a heavily filtered graph or list walk loses
+ * recall; larger ones go through the index with the allowed slots as a bitmap selector, so the
+ * filter is applied during the traversal rather than to its results.
+ *
+ * The graph and its slot mapping form a snapshot that is published through a shared_ptr,
+ * RCU style. rebuild() and load() build a new snapshot off to the side and swap the pointer;
+ * searches that already hold the old snapshot finish on it, so a search never waits on a
+ * rebuild. In-place upserts and removes briefly lock the current snapshot exclusively, and all
+ * writers are serialized against each other (and against rebuilds) so that a rebuild never
+ * loses an update that raced with it.
+ *
+ * With a gpu_device, a rebuild of a trained type trains and fills the index on the GPU, then
+ * clones it to the CPU: the CPU copy is what is serialized and what serves single and filtered
+ * searches, and the GPU copy, kept in step by upserts, serves unfiltered batches. Whatever the
+ * GPU cannot do (no device, an unsupported type or parameter, too little device memory, a
+ * device busy with a build) falls back to the CPU path without failing the call.
+ */
+class VectorIndex {
+ public:
+  // Fills the ids and the flattened (row-major) vectors used to rebuild the index.
+  using Loader = std::function<void(std::vector<faiss::idx_t> &ids, std::vector<float> &vectors)>;
+  // Reads the given rows (ascending) of a streamed rebuild: pushes each row's id and appends its
+  // dimension() floats to vectors, both of which arrive empty. A row without a vector may be
+  // left out. Called from a helper thread, one call at a time.
+  using RowReader = std::function<void(const std::vector<size_t> &rows,
+                                       std::vector<faiss::idx_t> &ids,
+                                       std::vector<float> &vectors)>;
+  // Lists what a streamed rebuild will read and returns the row count. Called under the write
+  // lock, so no upsert lands between the listing and the rebuild.
+  using RowLister = std::function<size_t()>;
+  // External ids a search is restricted to
+  using IdFilter = std::unordered_set<faiss::idx_t>;
+
+  explicit VectorIndex(int dimension, VectorIndexOptions options = {});
+  VectorIndex(int dimension, int hnsw_m, int ef_construction);
+
+  VectorIndex(const VectorIndex &) = delete;
+  VectorIndex &operator=(const VectorIndex &) = delete;
+
+  // Adds the vector for id, replacing any vector previously stored under the same id.
+  void upsert(faiss::idx_t id, const std::vector<float> &vector);
+
+  // Removes id from the index. Returns false if the id was not indexed.
+  bool remove(faiss::idx_t id);
+  // Removes every listed id under one lock. Returns how many of them were indexed.
+  size_t remove_ids(const std::vector<faiss::idx_t> &ids);
+
+  // Replaces the whole index with the vectors produced by loader.
+  void rebuild(const Loader &loader);
+  // Replaces the whole index with rows 0..list_rows()-1 of read, streamed REBUILD_BATCH rows at a
+  // time: each batch is added before the one after it is held, so a rebuild needs two batches
+  // on top of the index itself rather than a copy of every vector. Quantized types are
+  // trained on a sample of the rows read first. The next batch is read while one is added.
+  void rebuild(const RowLister &list_rows, const RowReader &read);
+
+  // Serializes the graph together with the slot mapping (tombstones included).
+  std::vector<uint8_t> serialize() const;
+  // Replaces the index with one produced by serialize(). Throws VectorIndexError if the
+  // bytes are malformed or were built with a different dimension.
+  void load(const std::vector<uint8_t> &bytes);
+
+  // Returns up to k live hits ordered by ascending distance (see VectorMetric), only considering
+  // ids in allowed when it is given. tuning is ignored by index types it does not apply to.
+  std::vector<VectorIndexHit> search(const std::vector<float> &query,
+                                     int k,
+                                     const IdFilter *allowed = nullptr,
+                                     const VectorSearchOptions &tuning = {}) const;
+  // Searches n queries, flattened row-major into n * dimension() floats, in a single faiss
+  // call against one snapshot. Result i holds the hits of query i; allowed restricts all of them.
+  std::vector<std::vector<VectorIndexHit>> search_batch(const std::vector<float> &queries,
+                                                        int k,
+                                                        const VectorSearchOptions &tuning = {},
+                                                        const IdFilter *allowed = nullptr) const;
+
+  bool contains(faiss::idx_t id) const;
+  // Number of live (non-tombstoned) vectors.
+  size_t size() const;
+  size_t tombstone_count() const;
+  int dimension() const {
+    return dimension_;
+  }
+  const VectorIndexOptions &options() const {
+    return options_;
+  }
+  // Vectors a rebuild needs before the configured type is trained and used
+  size_t min_training_vectors() const;
+  // Rows a streamed rebuild reads and adds at once
+  static constexpr size_t REBUILD_BATCH = 16384;
+  // False while the index is still the flat stand-in for an untrained quantized type
+  bool uses_configured_type() const;
+  // All of the above, read from one snapshot
+  VectorIndexStats stats() const;
+
+ private:
+  static constexpr faiss::idx_t DEAD_SLOT = -1;
+  // Filtered searches over at most this many candidates skip the graph and scan exactly
+  static constexpr size_t EXACT_SEARCH_MAX_CANDIDATES = 4096;
+
+  struct Snapshot {
+    std::unique_ptr<faiss::Index> index;
+    // slot -> external id, DEAD_SLOT once tombstoned
+    std::vector<faiss::idx_t> slot_ids;
+    // external id -> live slot
+    std::unordered_map<faiss::idx_t, faiss::idx_t> id_slots;
+    // id_slots.size() when the snapshot was built or loaded
+    size_t built_size = 0;
+    // Copy of index on options.gpu_device for batched searches, null when there is none.
+    // Upserts add to both.
+    std::unique_ptr<faiss::Index> gpu_index;
+    // Shared for searches, exclusive for in-place upserts and removes
+    mutable std::shared_mutex mutex;
+  };
+
+  // k-means wants this many training points per centroid before it stops warning
+  static constexpr size_t MIN_POINTS_PER_CENTROID = 39;
+  // Scalar quantizer ranges come from the training data, so a handful of vectors is not enough
+  static constexpr size_t SQ_MIN_TRAINING_VECTORS = 1000;
+
+  // An index of the configured type, trained on vectors when it needs training, or an exact
+  // flat index when there are too few of them to train on
+  std::unique_ptr<faiss::Index> create_index(const std::vector<float> &vectors) const;
+  // create_index() before training: the type count vectors call for
+  std::unique_ptr<faiss::Index> create_untrained_index(size_t count) const;
+  // Trains index on a sample of vectors
+  void train_index(faiss::Index &index, const std::vector<float> &vectors) const;
+  // The rows, ascending, a quantizer is trained on out of count: a fixed-seed sample of
+  // training_sample of them, or all
+  std::vector<size_t> training_rows(size_t count) const;
+  // Builds fresh's index, slot mapping and GPU copy from row_count rows of read. On the GPU
+  // when the configured type and device allow it, starting over on the CPU if that fails.
+  void build(Snapshot &fresh, size_t row_count, const RowReader &read) const;
+  // Trains target if it needs it and adds every row to it batch by batch, recording the
+  // slots in fresh. GPU calls hold the device lock, one batch at a time, so searches and
+  // upserts on the device are never held up for a whole build.
+  void fill(faiss::Index &target,
+            bool on_gpu,
+            Snapshot &fresh,
+            size_t row_count,
+            const RowReader &read) const;
+  // Callers hold write_mutex_
+  void rebuild_locked(size_t row_count, const RowReader &read);
+  // A GPU copy of index, or null without a usable device
+  std::unique_ptr<faiss::Index> gpu_replica(const faiss::Index &index) const;
+  // count prepared queries on snapshot's GPU copy; nullopt when the device is busy or the
+  // search cannot run there, for the caller to search on the CPU
+  std::optional<std::vector<std::vector<VectorIndexHit>>> gpu_search_batch(
+      const Snapshot &snapshot,
+      const float *queries,
+      size_t count,
+      int k,
+      const VectorSearchOptions &tuning) const;
+  bool is_configured_type(const faiss::Index &index) const;
+  std::vector<VectorIndexHit> exact_search(const Snapshot &snapshot,
+                                           const std::vector<float> &query,
+                                           int k,
+                                           const IdFilter &allowed) const;
+  // Maps the first count slots of a faiss result row to live hits, turning cosine
+  // similarities into distances
+  std::vector<VectorIndexHit> to_hits(const std::vector<faiss::idx_t> &slot_ids,
+                                      const faiss::idx_t *slots,
+                                      const float *distances,
+                                      int count) const;
+  // One bit per slot of snapshot, set for the live slots of allowed ids; what a filtered
+  // graph or list walk checks through faiss::IDSelectorBitmap
+  std::vector<uint8_t> slot_bitmap(const Snapshot &snapshot, const IdFilter &allowed) const;
+  faiss::MetricType faiss_metric() const;
+  std::unique_ptr<faiss::Index> create_flat_index() const;
+  // Normalizes count consecutive vectors in place under the cosine metric; a no-op for L2
+  void prepare_vectors(float *vectors, size_t count) const;
+  int resolved_ef_search(const VectorSearchOptions &tuning) const;
+  int resolved_nprobe(const VectorSearchOptions &tuning) const;
+  void check_dimension(size_t size, const char *what) const;
+  // The snapshot new operations should use; holding the result keeps it alive
+  std::shared_ptr<const Snapshot> current() const;
+  // Callers hold write_mutex_, so no in-place write can still be aimed at the old snapshot
+  void publish(std::shared_ptr<Snapshot> snapshot);
+
+  const int dimension_;
+  const VectorIndexOptions options_;
+
+  // Serializes writers (upsert/remove/rebuild/load) without blocking readers.
+  std::mutex write_mutex_;
+  // Only held to copy or swap snapshot_, never while searching or building
+  mutable std::mutex publish_mutex_;
+  std::shared_ptr<Snapshot> snapshot_;
+};
+
+}  // namespace magic_core
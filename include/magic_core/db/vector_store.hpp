@@ -0,0 +1,173 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "magic_core/db/vector_encoding.hpp"
+
+namespace magic_core {
+
+class VectorStoreError : public std::exception {
+ public:
+  explicit VectorStoreError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+/**
+ * @class VectorStore
+ * @brief Append-only, memory-mapped segment file of fixed-stride vector records.
+ *
+ * Each record holds the key it was appended under (a row id) followed by the vector in the
+ * segment's encoding(), and is addressed by its offset, the record's position in the file.
+ * float16 and int8 segments are 2x and nearly 4x smaller than float32 ones, and so are the
+ * bytes decrypted per read; reads decode back to float32 either way. SQLite keeps only that
+ * offset, so rebuilding an index decrypts vectors straight out of the mapping into the
+ * caller's buffer instead of materializing a BLOB per row.
+ *
+ * Records are encrypted with AES-256-CTR under a key derived from the database key, with a
+ * per-file nonce and the offset as counter. Offsets are never written twice, so no keystream
+ * is reused. Unlike the database pages and the index snapshots (AES-256-GCM), records are
+ * confidential but not authenticated: a flipped ciphertext bit flips the same bit of the
+ * decrypted vector. Only the key check in read() catches a record that was moved or whose key
+ * bytes were changed. Replaced vectors stay behind as dead records until write_compacted() /
+ * install_compacted() rewrite the file with just the live ones. The epoch in the header is bumped by every compaction so that the database can tell
+ * which layout its offsets refer to.
+ *
+ * Reads run concurrently with each other. An append holds the lock exclusively, since growing
+ * the file remaps it, so reads wait for it, including its sync to disk.
+ */
+class VectorStore {
+ public:
+  using Offset = int64_t;
+
+  // Opens the segment at path, creating it for dimension-sized vectors if it does not exist.
+  // A leftover compacted file whose epoch is expected_epoch is installed first (the process
+  // stopped between committing a compaction and renaming it into place). Throws
+  // VectorStoreError if the file is malformed, has another dimension, or is at a different epoch.
+  // encoding applies to a new file and to compacted rewrites; an existing file keeps the one in
+  // its header until write_compacted() converts it.
+  VectorStore(std::filesystem::path path,
+              const std::string &db_key,
+              int dimension,
+              int64_t expected_epoch = 0,
+              VectorEncoding encoding = VectorEncoding::Float32);
+  ~VectorStore();
+
+  VectorStore(const VectorStore &) = delete;
+  VectorStore &operator=(const VectorStore &) = delete;
+
+  // Reads the dimension stored in an existing segment's header, or 0 if there is no file.
+  static int stored_dimension(const std::filesystem::path &path);
+  // The dimension the segment will have once opened at expected_epoch: a leftover compacted
+  // file at that epoch is about to replace it, and may hold vectors of another model.
+  static int stored_dimension(const std::filesystem::path &path, int64_t expected_epoch);
+  // Where write_compacted() puts the rewrite of the segment at path
+  static std::filesystem::path compacted_path(const std::filesystem::path &path);
+
+  // Appends keys.size() records; vectors holds them row-major. Returns their offsets in order.
+  // The records are on disk when this returns.
+  std::vector<Offset> append(const std::vector<int64_t> &keys, const float *vectors);
+  Offset append(int64_t key, const std::vector<float> &vector);
+
+  // Decrypts the record at offset into out (dimension() floats). Returns false, leaving out
+  // unspecified, when there is no such record or it was not appended under key.
+  bool read(Offset offset, int64_t key, float *out) const;
+  // Batched read into out + i * dimension(); found[i] reports whether row i was read.
+  std::vector<bool> read_many(const std::vector<Offset> &offsets,
+                              const std::vector<int64_t> &keys,
+                              float *out) const;
+
+  // Writes the listed records, in order, to compacted_path() at epoch() + 1 in the configured
+  // encoding. Their new offsets are 0..n-1. The live file is untouched until install_compacted().
+  void write_compacted(const std::vector<Offset> &offsets, const std::vector<int64_t> &keys);
+  // Renames the compacted file over the segment and maps it.
+  void install_compacted();
+
+  // Reads every page holding a record into the page cache, so the first searches after a start
+  // do not fault them in one at a time. Returns the bytes touched.
+  size_t prefault() const;
+  // Writes the first records records, as they are encrypted here, with the header, to a new
+  // segment file at destination, COPY_STEP_BYTES at a time; after_step is called with the bytes
+  // of each step, outside the lock, e.g. to pace the copy. Appends only wait for the step in
+  // progress. Throws VectorStoreError if the store holds fewer records or is compacted meanwhile.
+  // Returns the bytes written.
+  size_t copy_to(const std::filesystem::path &destination,
+                 size_t records,
+                 const std::function<void(size_t)> &after_step = {}) const;
+  // What copy_to() writes for the first records records
+  size_t copy_size(size_t records) const;
+
+  size_t record_count() const;
+  int dimension() const {
+    return dimension_;
+  }
+  // The encoding of the file as it is now
+  VectorEncoding encoding() const;
+  // The one new files and compactions use
+  VectorEncoding configured_encoding() const {
+    return configured_encoding_;
+  }
+  int64_t epoch() const;
+  const std::filesystem::path &path() const {
+    return path_;
+  }
+  std::filesystem::path compacted_path() const;
+
+ private:
+  static constexpr uint32_t FORMAT_VERSION = 1;
+  static constexpr size_t HEADER_SIZE = 64;
+  static constexpr size_t NONCE_SIZE = 8;
+  static constexpr size_t INITIAL_CAPACITY = 1024;
+  static constexpr size_t COPY_STEP_BYTES = 1 << 20;
+
+  struct Header;
+  using Key = std::array<unsigned char, 32>;
+
+  VectorStore(std::filesystem::path path,
+              const Key &key,
+              int dimension,
+              int64_t epoch,
+              VectorEncoding encoding);
+  static Key derive_key(const std::string &db_key);
+  // Reads the header of the segment at path; false if there is none or it is not a segment
+  static bool read_header(const std::filesystem::path &path, Header &header);
+  // Opens (or, if empty, initializes at epoch) and maps the segment. Returns true if created.
+  bool open_file(int64_t epoch);
+  void unmap() noexcept;
+  void map(size_t size);
+  void grow_to(size_t records);
+  void write_header(uint64_t record_count);
+  size_t stride() const {
+    return sizeof(int64_t) + encoded_vector_size(encoding_, dimension_);
+  }
+  size_t capacity() const;
+  // Callers hold mutex_
+  size_t count_unlocked() const;
+  int64_t epoch_unlocked() const;
+
+  std::filesystem::path path_;
+  int dimension_;
+  VectorEncoding configured_encoding_;
+  Key key_;
+
+  // Guards the mapping: exclusive for appends (which may remap), shared for reads
+  mutable std::shared_mutex mutex_;
+  int fd_ = -1;
+  // Read from the header whenever the file is (re)opened
+  VectorEncoding encoding_ = VectorEncoding::Float32;
+  unsigned char *data_ = nullptr;
+  size_t mapped_size_ = 0;
+};
+
+}  // namespace magic_core
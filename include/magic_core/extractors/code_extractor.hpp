@@ -0,0 +1,48 @@
+#pragma once
+
+#include <optional>
+
+#include "content_extractor.hpp"
+#include "magic_core/extractors/code_scanner.hpp"
+
+namespace magic_core {
+
+/**
+ * @class CodeExtractor
+ * @brief Chunks source files at function and class boundaries.
+ *
+ * Sections start where code_scanner finds a declaration, so a chunk holds whole functions (or
+ * several small ones) and only a function larger than TARGET_MAX_TOKENS is cut by the
+ * fixed-size fallback. The boundaries depend only on the code around them: editing one
+ * function changes the chunks covering it and leaves the others byte-identical, so the
+ * processing task's chunk diff keeps their rows and vectors and re-embeds only what changed.
+ */
+class CodeExtractor : public ContentExtractor {
+public:
+    using ContentExtractor::ContentExtractor;
+
+    bool can_handle(const fs::path& file_path) const override;
+    FileType get_file_type() const override;
+    std::vector<Chunk> get_chunks(const fs::path& file_path) const override;
+
+    ExtractionResult extract_with_hash(const fs::path& file_path) const override;
+    // A region of the mapping at a time
+    void stream_chunks(const fs::path& file_path, const ChunkSink& sink) const override;
+
+private:
+    enum class Language { Brace, Python };
+    struct Syntax {
+        Language language;
+        BraceSyntax brace;
+    };
+    // The syntax of a supported file extension
+    static std::optional<Syntax> syntax_for(const fs::path& file_path);
+
+    // Where the declarations, the sections of a chunk, start
+    static std::vector<size_t> section_starts(std::string_view content, const Syntax& syntax);
+
+    std::vector<Chunk> extract_chunks_from_content(std::string_view content,
+                                                   const Syntax& syntax) const;
+};
+
+}  // namespace magic_core
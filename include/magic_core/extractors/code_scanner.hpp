@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace magic_core {
+
+// Single-pass scanners that find where declarations begin in source code, so code is chunked at
+// function and class boundaries instead of mid-body. Neither builds a syntax tree: they track
+// just enough (comments, string literals, bracket nesting, and which scopes are classes or
+// namespaces) to tell a declaration's first line from a statement inside a function. Offsets
+// are ascending line starts; 0 is implied and never reported.
+
+struct BraceSyntax {
+  // ` quotes a string that may span lines (JavaScript template literals, Go raw strings)
+  bool backtick_strings = false;
+  // # at a line start is a preprocessor directive (C, C++, Objective-C)
+  bool preprocessor = false;
+};
+
+// For brace-delimited languages (C, C++, Java, C#, Go, Rust, JavaScript, TypeScript, Swift...).
+// A declaration starts on a line at file, namespace or class scope after a completed statement
+// or block, or after a blank line. Comment lines right above a declaration stay with it. A
+// brace opens a class-like scope when a keyword such as class, struct, namespace, enum, impl
+// or interface comes before any parenthesis in the declaration it closes.
+std::vector<size_t> find_brace_declaration_starts(std::string_view text, BraceSyntax syntax);
+
+// For Python: def, async def and class lines at module or class scope, together with their
+// decorators and the comment lines right above them, and the first statement after a body.
+std::vector<size_t> find_python_declaration_starts(std::string_view text);
+
+}  // namespace magic_core
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "magic_core/extractors/tokenizer.hpp"
 #include "magic_core/types/chunk.hpp"
 #include "magic_core/types/file.hpp"
 
@@ -28,8 +32,14 @@ struct ExtractionResult {
   std::vector<Chunk> chunks;
 };
 
+// Receives a document's chunks in order, a few at a time, as they are extracted. extracted is the
+// fraction of the document read so far; the last call passes 1.
+using ChunkSink = std::function<void(std::vector<Chunk>& chunks, float extracted)>;
+
 class ContentExtractor {
  public:
+  // Chunks are sized in tokenizer's tokens; without one, tokens are estimated from bytes
+  explicit ContentExtractor(std::shared_ptr<const Tokenizer> tokenizer = nullptr);
   virtual ~ContentExtractor() = default;
 
   // Checks if this extractor can handle the given file extension
@@ -41,23 +51,41 @@ class ContentExtractor {
   // Combined operation - gets both hash and chunks in single file read
   virtual ExtractionResult extract_with_hash(const fs::path& file_path) const = 0;
 
+  // Whether stream_chunks() hands chunks out before the whole file is read, so callers can
+  // start embedding while the rest is still being extracted. Text extractors stream too, a
+  // region at a time, but only pay for it on files too large to hold chunked in memory.
+  virtual bool streams_chunks() const {
+    return false;
+  }
+  // Calls sink with the file's chunks in order, the same chunks extract_with_hash() returns.
+  // The default extracts the whole file first and hands everything over in one call.
+  virtual void stream_chunks(const fs::path& file_path, const ChunkSink& sink) const;
+
+  // SHA-256 of the file, read in HASH_BLOCK_SIZE blocks rather than loaded whole
   std::string get_content_hash(const fs::path& file_path) const;
 
   virtual FileType get_file_type() const;
   protected:
-  // Helper method for derived classes to compute hash from loaded content
-  std::string get_string_content(const fs::path& file_path) const;
-  std::string compute_hash_from_content(const std::string& content) const;
+  // Helper method for derived classes to compute hash from loaded (or mapped) content
+  std::string compute_hash_from_content(std::string_view content) const;
   
+  static constexpr size_t HASH_BLOCK_SIZE = 1 << 20;
+
+  // Documents of at least twice this size are chunked as independent regions in parallel
+  static constexpr size_t PARALLEL_REGION_SIZE = 8 << 20;
+  static constexpr size_t MAX_EXTRACTION_THREADS = 8;
+
   // --- Token-based goals ---
   static constexpr size_t TARGET_MAX_TOKENS = 512; 
   static constexpr size_t TARGET_MIN_TOKENS = 32;
   static constexpr size_t TARGET_FIXED_TOKENS = 384;
   static constexpr size_t TARGET_OVERLAP_TOKENS = 50;
 
-  // --- Heuristic for conversion ---
+  // --- Heuristic for conversion, used by the default ApproximateTokenizer ---
   static constexpr float CHAR_PER_TOKEN_ESTIMATE = 3.5f;
 
+  // Byte equivalents of the token goals under the heuristic
+
   static constexpr size_t MAX_CHUNK_SIZE =
       static_cast<size_t>(TARGET_MAX_TOKENS * CHAR_PER_TOKEN_ESTIMATE);
   static constexpr size_t MIN_CHUNK_SIZE =
@@ -67,7 +95,41 @@ class ContentExtractor {
   static constexpr size_t OVERLAP_SIZE =
       static_cast<size_t>(TARGET_OVERLAP_TOKENS * CHAR_PER_TOKEN_ESTIMATE);
 
+  // Merges consecutive sections of content into chunks of at least TARGET_MIN_TOKENS (the tail
+  // may be shorter) and splits any merged chunk above TARGET_MAX_TOKENS with the fixed-size
+  // fallback. section_starts are ascending offsets where a new section begins; 0 and
+  // content.size() are implied. Merging only moves an offset, so each chunk's bytes are copied
+  // exactly once. Large documents are split at section starts into regions of about
+  // PARALLEL_REGION_SIZE that are chunked concurrently, then renumbered in order.
+  std::vector<Chunk> build_chunks(std::string_view content,
+                                  const std::vector<size_t>& section_starts) const;
+
+  // build_chunks() one region at a time on this thread, handing each region's chunks to sink
+  // before the next is built, so only one region's worth is held at once
+  void stream_built_chunks(std::string_view content, const std::vector<size_t>& section_starts,
+                           const ChunkSink& sink) const;
+
   std::vector<std::string> split_into_fixed_chunks(const std::string& text) const;
+  // Same boundaries as split_into_fixed_chunks, as views into text
+  std::vector<std::string_view> split_into_fixed_views(std::string_view text) const;
+
+  std::shared_ptr<const Tokenizer> tokenizer_;
+
+ private:
+  // [begin, end) of the document, holding section_starts [first_start, last_start)
+  struct Region {
+    size_t begin;
+    size_t end;
+    size_t first_start;
+    size_t last_start;
+  };
+  static std::vector<Region> split_regions(std::string_view content,
+                                           const std::vector<size_t>& section_starts);
+
+  // Chunks one region. [starts_begin, starts_end) are the section starts inside it, as offsets
+  // into the whole document, which begins offset bytes before region.
+  void build_region(std::string_view region, size_t offset, const size_t* starts_begin,
+                    const size_t* starts_end, std::vector<Chunk>& chunks) const;
 };
 
 // Define a type for our smart pointers
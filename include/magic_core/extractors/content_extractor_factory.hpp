@@ -18,8 +18,11 @@ class ContentExtractorFactory {
  public:
   /**
    * @brief Constructs the factory and initializes all available extractors.
+   *
+   * @param tokenizer Shared by every extractor to size chunks in the embedding model's tokens.
+   * When null, tokens are estimated from byte counts.
    */
-  ContentExtractorFactory();
+  explicit ContentExtractorFactory(std::shared_ptr<const Tokenizer> tokenizer = nullptr);
 
   /**
    * @brief Finds and returns the most suitable extractor for the given file.
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace magic_core {
+
+/**
+ * @class MappedFile
+ * @brief Read-only view of a whole file, memory-mapped where the platform allows it.
+ *
+ * Extractors scan and chunk the view in place, so the file's bytes are not copied until a
+ * chunk is materialized. Empty files are not mapped, and platforms without mmap fall back to
+ * reading the file into an owned buffer. The view is valid for the lifetime of the object.
+ */
+class MappedFile {
+ public:
+  // Throws ContentExtractorError if the file cannot be opened or mapped.
+  explicit MappedFile(const std::filesystem::path &file_path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  std::string_view view() const {
+    return {data_, size_};
+  }
+  size_t size() const {
+    return size_;
+  }
+  bool is_mapped() const {
+    return mapped_;
+  }
+
+ private:
+  void release() noexcept;
+
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  bool mapped_ = false;
+  // Backing storage when the file could not be mapped
+  std::string buffer_;
+};
+
+}  // namespace magic_core
@@ -6,15 +6,19 @@ namespace magic_core {
 
 class MarkdownExtractor : public ContentExtractor {
 public:
+    using ContentExtractor::ContentExtractor;
+
     bool can_handle(const fs::path& file_path) const override;
     FileType get_file_type() const override;
     std::vector<Chunk> get_chunks(const fs::path& file_path) const override;
     
     ExtractionResult extract_with_hash(const fs::path& file_path) const override;
+    // A region of the mapping at a time
+    void stream_chunks(const fs::path& file_path, const ChunkSink& sink) const override;
 
 private:
-    // Helper method to extract chunks from already-loaded content
-    std::vector<Chunk> extract_chunks_from_content(const std::string& content) const;
+    // Helper method to extract chunks from already-loaded (or mapped) content
+    std::vector<Chunk> extract_chunks_from_content(std::string_view content) const;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "content_extractor.hpp"
+
+namespace magic_core {
+
+/**
+ * @class PdfExtractor
+ * @brief Extracts a PDF's text page by page with poppler and chunks it as it goes.
+ *
+ * Pages are read on up to MAX_EXTRACTION_THREADS threads, each with its own poppler document
+ * (one is not safe to share between threads), at most PAGES_AHEAD_PER_THREAD pages per thread
+ * ahead of the page being chunked. Chunks are handed to stream_chunks()' sink in order as each
+ * page is done, so only that window of pages is ever held in memory. Page breaks count as
+ * paragraph breaks; a page's short tail is chunked together with the next page.
+ */
+class PdfExtractor : public ContentExtractor {
+public:
+    using ContentExtractor::ContentExtractor;
+
+    bool can_handle(const fs::path& file_path) const override;
+    FileType get_file_type() const override;
+    std::vector<Chunk> get_chunks(const fs::path& file_path) const override;
+
+    ExtractionResult extract_with_hash(const fs::path& file_path) const override;
+
+    bool streams_chunks() const override {
+        return true;
+    }
+    // Throws ContentExtractorError if the file is not a readable PDF or is password protected
+    void stream_chunks(const fs::path& file_path, const ChunkSink& sink) const override;
+
+private:
+    static constexpr size_t PAGES_AHEAD_PER_THREAD = 4;
+};
+
+}  // namespace magic_core
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace magic_core {
+
+// Single-pass boundary scanners used to split documents into sections. Both walk the text once,
+// finding line ends with memchr, and report the same boundaries as the regular expressions they
+// replaced so chunking is unchanged:
+//   find_heading_starts    ~ ^#+\s.*   (ECMAScript, multiline)
+//   find_paragraph_breaks  ~ \n\s*\n   (offset just past each match)
+
+// Offsets of ATX headings: a line starting with one or more '#' followed by whitespace.
+std::vector<size_t> find_heading_starts(std::string_view text);
+
+// Offsets just past each run of blank lines, i.e. where the next paragraph begins.
+std::vector<size_t> find_paragraph_breaks(std::string_view text);
+
+}  // namespace magic_core
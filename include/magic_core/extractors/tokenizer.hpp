@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace magic_core {
+
+class TokenizerError : public std::exception {
+ public:
+  explicit TokenizerError(const std::string& message) : message_(message) {}
+  const char* what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+/**
+ * @class Tokenizer
+ * @brief Measures text in the embedding model's tokens so chunks can be sized to its context.
+ *
+ * Tokenizers are immutable once built and are shared by every extractor and worker thread.
+ */
+class Tokenizer {
+ public:
+  virtual ~Tokenizer() = default;
+
+  // Number of tokens the model sees for text, not counting special tokens such as [CLS]
+  virtual size_t count_tokens(std::string_view text) const = 0;
+
+  // Byte length of the longest prefix of text holding at most max_tokens tokens. Never cuts a
+  // UTF-8 sequence, and returns at least one token's worth of a non-empty text so callers
+  // always make progress. Throws utf8::invalid_utf8 on malformed input.
+  virtual size_t prefix_length(std::string_view text, size_t max_tokens) const = 0;
+
+  virtual std::string name() const = 0;
+};
+
+/**
+ * @class ApproximateTokenizer
+ * @brief Estimates tokens from byte counts; used when no vocabulary is configured.
+ *
+ * Counts round up, so a chunk the estimate accepts is not knowingly over the model's limit.
+ */
+class ApproximateTokenizer : public Tokenizer {
+ public:
+  explicit ApproximateTokenizer(float bytes_per_token) : bytes_per_token_(bytes_per_token) {}
+
+  size_t count_tokens(std::string_view text) const override;
+  size_t prefix_length(std::string_view text, size_t max_tokens) const override;
+  std::string name() const override {
+    return "approximate";
+  }
+
+ private:
+  float bytes_per_token_;
+};
+
+/**
+ * @class WordPieceTokenizer
+ * @brief Greedy longest-match WordPiece over a BERT-style vocab.txt (one token per line).
+ *
+ * Pre-tokenization follows BERT's basic tokenizer: whitespace separates words, and ASCII
+ * punctuation and CJK ideographs are words of their own. Lowercasing and accent handling are
+ * ASCII-only, so accented words may count a token or two high, never low enough to overflow.
+ */
+class WordPieceTokenizer : public Tokenizer {
+ public:
+  // Words longer than this many code points become a single unknown token, as in BERT
+  static constexpr size_t MAX_WORD_CHARS = 100;
+
+  // Loads vocab_path once per process and hands every caller the same instance.
+  // Throws TokenizerError if the file is missing or empty.
+  static std::shared_ptr<const WordPieceTokenizer> load(const std::filesystem::path& vocab_path,
+                                                        bool lowercase = true);
+
+  WordPieceTokenizer(std::unordered_set<std::string> vocab, bool lowercase);
+
+  size_t count_tokens(std::string_view text) const override;
+  size_t prefix_length(std::string_view text, size_t max_tokens) const override;
+  std::string name() const override {
+    return "wordpiece";
+  }
+
+  size_t vocab_size() const {
+    return vocab_.size();
+  }
+
+ private:
+  // Calls on_token with the starting byte offset of each token in order, stopping early when
+  // it returns false. Pieces after the first start inside their word.
+  template <typename OnToken>
+  void for_each_token(std::string_view text, OnToken&& on_token) const;
+  // Fills pieces with the start offsets of word's WordPiece pieces, or just {0} when the vocab
+  // cannot cover the word and it becomes a single unknown token.
+  void split_word(std::string_view word, size_t chars, std::string& lowered,
+                  std::string& candidate, std::vector<size_t>& pieces) const;
+
+  std::unordered_set<std::string> vocab_;
+  bool lowercase_;
+  size_t max_piece_bytes_ = 0;
+};
+
+}  // namespace magic_core
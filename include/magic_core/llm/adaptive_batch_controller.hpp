@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+namespace magic_core {
+
+struct AdaptiveBatchOptions {
+  size_t min_batch = 8;
+  size_t max_batch = 256;
+  size_t initial_batch = 64;
+  size_t max_in_flight = 16;
+  size_t initial_in_flight = 4;
+  // Texts added to the batch size per request that finished in time
+  size_t batch_step = 8;
+  // How much slower per character than the fastest request seen a reply may be and still
+  // count as in time; beyond it the endpoint is queueing work rather than doing more of it
+  double tolerance = 1.5;
+};
+
+/**
+ * @class AdaptiveBatchController
+ * @brief Tunes the batch size and requests in flight of one embedding endpoint by AIMD.
+ *
+ * Embedding latency grows with the characters sent, not the texts, so every reply is measured
+ * in seconds per character and compared with the fastest rate seen so far. Until the endpoint
+ * saturates that rate holds or improves as batches grow, since the fixed cost of a request is
+ * shared by more text; past the knee replies slow down without more getting done. A reply in
+ * time grows the batch additively when the request was full, and the in-flight limit by one
+ * for every limit's worth of such replies, about once per round trip. A slow reply shrinks
+ * both by a quarter, and a failed one (an error or a timeout) halves them. The baseline rises
+ * by BASELINE_DRIFT per full reply, so it follows the endpoint when a model change or other
+ * load makes it slower for good. A reply to fewer texts than the batch size is dominated by
+ * the request's fixed cost and is only counted when it was in time anyway; it never shrinks
+ * anything. Thread-safe.
+ */
+class AdaptiveBatchController {
+ public:
+  static constexpr double BASELINE_DRIFT = 0.01;
+
+  // Throws std::invalid_argument unless 1 <= min_batch <= initial_batch <= max_batch,
+  // 1 <= initial_in_flight <= max_in_flight and tolerance >= 1
+  explicit AdaptiveBatchController(AdaptiveBatchOptions options = {});
+
+  AdaptiveBatchController(const AdaptiveBatchController &) = delete;
+  AdaptiveBatchController &operator=(const AdaptiveBatchController &) = delete;
+
+  // A reply to a request of texts totalling chars characters, latency after it was sent
+  void record_success(size_t texts, size_t chars, std::chrono::steady_clock::duration latency);
+  void record_failure();
+
+  size_t batch_size() const;
+  size_t in_flight_limit() const;
+  size_t min_batch() const {
+    return options_.min_batch;
+  }
+
+ private:
+  const AdaptiveBatchOptions options_;
+  mutable std::mutex mutex_;
+  size_t batch_size_;
+  size_t in_flight_limit_;
+  // Replies in time since the in-flight limit last changed
+  size_t in_time_ = 0;
+  // Fastest seconds per character seen, drifting upwards; 0 before the first reply
+  double baseline_ = 0.0;
+};
+
+}  // namespace magic_core
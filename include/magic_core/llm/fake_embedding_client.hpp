@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "magic_core/llm/ollama_client.hpp"
+
+namespace magic_core {
+
+struct FakeEmbeddingOptions {
+  int dimension = 1024;
+  // Slept once per request, standing in for the round trip and model overhead
+  std::chrono::microseconds request_latency{0};
+  // Slept once per text in the request, standing in for inference
+  std::chrono::microseconds per_text_latency{0};
+};
+
+/**
+ * @class FakeEmbeddingClient
+ * @brief A deterministic embedding backend that needs no server, for load tests.
+ *
+ * A text embeds to the normalized sum of one pseudo-random vector per word, each seeded from a
+ * hash of the lowercased word. Equal texts always get equal vectors, on every platform and
+ * run, and texts sharing words point in similar directions, so searches over a synthetic
+ * corpus return meaningful neighbours. Latency is simulated by sleeping, which keeps the
+ * request concurrency of a real server without using its CPU.
+ */
+class FakeEmbeddingClient : public OllamaClient {
+ public:
+  explicit FakeEmbeddingClient(FakeEmbeddingOptions options = {});
+
+  std::vector<float> get_embedding(const std::string &text) override;
+  std::vector<std::vector<float>> get_embeddings(
+      const std::vector<std::string> &texts_to_embed) override;
+  // Runs the batch on its own thread, so batches overlap as they would on a server
+  std::future<std::vector<std::vector<float>>> get_embeddings_async(
+      const std::vector<std::string> &texts_to_embed) override;
+  // The first words of prompt, after request_latency. For json_output, an object with that
+  // summary, category "uncategorized" and a filename made from a hash of prompt.
+  std::string generate(const std::string &prompt, bool json_output = false) override;
+  std::string summarize_text(const std::string &text) override;
+  bool is_server_available() override;
+  // One always-healthy endpoint, "fake://", with the requests currently sleeping on it
+  std::vector<OllamaEndpointStatus> endpoint_status() const override;
+
+  // The vector for text without any simulated latency
+  std::vector<float> embed(const std::string &text) const;
+
+  // Requests and texts served since construction
+  size_t requests() const noexcept {
+    return requests_.load(std::memory_order_relaxed);
+  }
+  size_t texts() const noexcept {
+    return texts_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  const FakeEmbeddingOptions options_;
+  std::atomic<int> outstanding_{0};
+  std::atomic<size_t> requests_{0};
+  std::atomic<size_t> texts_{0};
+};
+
+}  // namespace magic_core
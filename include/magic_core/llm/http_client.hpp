@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace magic_core {
+
+class HttpError : public std::exception {
+ public:
+  explicit HttpError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+struct HttpResponse {
+  long status = 0;
+  std::string body;
+  // From request_async to the whole reply, including any wait for a free connection
+  std::chrono::steady_clock::duration elapsed{};
+};
+
+struct HttpClientOptions {
+  std::chrono::milliseconds connect_timeout{5000};
+  // Whole-request limit; embedding a large batch on a cold model can take a while
+  std::chrono::milliseconds request_timeout{120000};
+  // Open connections kept to the host. Requests beyond this queue inside curl.
+  long max_connections = 8;
+};
+
+/**
+ * @class HttpClient
+ * @brief Asynchronous HTTP/1.1 client for one server, built on a curl multi handle.
+ *
+ * A single event-loop thread drives every transfer. The multi handle keeps connections alive
+ * between requests, so steady traffic pays for TCP setup (and DNS) once per connection instead
+ * of once per request, and any number of callers can have requests in flight at the same time.
+ * Finished easy handles are reset and reused for later requests.
+ */
+class HttpClient {
+ public:
+  explicit HttpClient(std::string base_url, HttpClientOptions options = {});
+  ~HttpClient();
+
+  HttpClient(const HttpClient &) = delete;
+  HttpClient &operator=(const HttpClient &) = delete;
+
+  // path is appended to the base URL. A non-empty body is sent as JSON. The future holds the
+  // response for any HTTP status, or an HttpError if the transfer itself failed. on_done, when
+  // set, runs on the event-loop thread just before the future is ready, whether or not anyone
+  // ever waits on it; it must not block. It is not called for requests the destructor fails.
+  std::future<HttpResponse> request_async(const std::string &method,
+                                          const std::string &path,
+                                          std::string body = {},
+                                          std::function<void()> on_done = {});
+  HttpResponse request(const std::string &method, const std::string &path, std::string body = {});
+
+  const std::string &base_url() const {
+    return base_url_;
+  }
+
+ private:
+  struct State;
+
+  void run_loop();
+
+  std::string base_url_;
+  HttpClientOptions options_;
+  std::unique_ptr<State> state_;
+};
+
+}  // namespace magic_core
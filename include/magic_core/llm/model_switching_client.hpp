@@ -0,0 +1,49 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "magic_core/llm/ollama_client.hpp"
+
+namespace magic_core {
+
+/**
+ * @class ModelSwitchingClient
+ * @brief An OllamaClient that forwards every request to a client it can be re-pointed at.
+ *
+ * Everything holding the embedding client (searches, file tasks) holds this one, so when a
+ * re-embed switches the database to another model, switch_to() moves all of them over at
+ * once. Requests already sent finish on the client they started with, which stays alive
+ * until they let go of it.
+ */
+class ModelSwitchingClient : public OllamaClient {
+ public:
+  ModelSwitchingClient(std::shared_ptr<OllamaClient> client, std::string model);
+
+  std::vector<float> get_embedding(const std::string &text) override;
+  std::vector<std::vector<float>> get_embeddings(
+      const std::vector<std::string> &texts_to_embed) override;
+  std::future<std::vector<std::vector<float>>> get_embeddings_async(
+      const std::vector<std::string> &texts_to_embed) override;
+  std::string generate(const std::string &prompt, bool json_output = false) override;
+  std::string summarize_text(const std::string &text) override;
+  bool is_server_available() override;
+  std::vector<OllamaEndpointStatus> endpoint_status() const override;
+  size_t embedding_batch_size() const override;
+
+  void switch_to(std::shared_ptr<OllamaClient> client, std::string model);
+  // The model requests go to now
+  std::string model() const;
+
+ private:
+  std::shared_ptr<OllamaClient> current() const;
+
+  mutable std::mutex mutex_;
+  std::shared_ptr<OllamaClient> client_;
+  std::string model_;
+};
+
+}  // namespace magic_core
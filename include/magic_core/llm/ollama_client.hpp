@@ -1,10 +1,26 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <mutex>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "magic_core/llm/adaptive_batch_controller.hpp"
+#include "magic_core/llm/http_client.hpp"
+
 namespace magic_core {
 
+namespace metrics {
+class Counter;
+class Gauge;
+}
+
 class OllamaError : public std::exception {
  public:
   explicit OllamaError(const std::string &message) : message_(message) {}
@@ -17,10 +33,51 @@ class OllamaError : public std::exception {
   std::string message_;
 };
 
+struct OllamaEndpointStatus {
+  std::string url;
+  bool healthy;
+  int outstanding;
+  // What the endpoint's AdaptiveBatchController settled on; 0 for clients without endpoints
+  size_t batch_size = 0;
+  size_t in_flight_limit = 0;
+};
+
+/**
+ * @class OllamaClient
+ * @brief Embedding client for one or more Ollama servers serving the same model.
+ *
+ * Constructed with a generative model instead, it serves the generation lane through
+ * generate(); embedding and generation share the endpoint handling below.
+ *
+ * Each endpoint has its own keep-alive connection pool (see HttpClient), so clients never share
+ * global state. Every request goes to the healthy endpoint with the fewest requests in flight.
+ * A transfer failure or 5xx marks the endpoint down and the request fails over to the next one;
+ * a down endpoint is re-checked with the is_server_available probe once ENDPOINT_RETRY_AFTER
+ * has passed, or right away when no endpoint is left. All calls are thread-safe; the
+ * synchronous ones wait on get_embeddings_async.
+ *
+ * Each endpoint also has an AdaptiveBatchController fed by its embedding replies. Callers that
+ * batch ask embedding_batch_size() how many texts to send, and routing weighs every endpoint's
+ * requests in flight against its tuned limit. get_embeddings waits for an endpoint below its
+ * limit, for up to CAPACITY_WAIT; single texts, like search queries, and the async calls, which
+ * pipeline on purpose, never wait but still count. The tuned values are the
+ * magic_embed_tuned_batch_size and magic_embed_tuned_in_flight gauges, per endpoint.
+ */
 class OllamaClient {
  public:
-  OllamaClient(const std::string &ollama_url, const std::string &embedding_model);
-  ~OllamaClient() = default;
+  static constexpr std::chrono::seconds ENDPOINT_RETRY_AFTER{5};
+  // A waiting get_embeddings sends anyway after this, so a limit never stalls work for long
+  static constexpr std::chrono::seconds CAPACITY_WAIT{10};
+
+  OllamaClient(const std::string &ollama_url,
+               const std::string &embedding_model,
+               HttpClientOptions http_options = {});
+  // Throws unless at least one endpoint is up; the others start out marked down
+  OllamaClient(const std::vector<std::string> &endpoint_urls,
+               const std::string &embedding_model,
+               HttpClientOptions http_options = {});
+  // Stops the endpoints' HTTP clients first: their transfers release slots of this client
+  virtual ~OllamaClient();
 
   // Disable copy constructor and assignment
   OllamaClient(const OllamaClient &) = delete;
@@ -28,21 +85,88 @@ class OllamaClient {
 
   // Get embedding for text
   virtual std::vector<float> get_embedding(const std::string &text);
+  // Embeds all texts in a single request; the result is in the same order as the input
+  // Waits while every healthy endpoint is at its in-flight limit, see above
   virtual std::vector<std::vector<float>> get_embeddings(
-      const std::vector<std::string> &texts_to_embed) {
-    throw std::runtime_error("Not Implemented!");
-  }
+      const std::vector<std::string> &texts_to_embed);
+  // Sends the batch right away and returns without waiting; any number of batches may be in
+  // flight. Failures surface as OllamaError from get().
+  virtual std::future<std::vector<std::vector<float>>> get_embeddings_async(
+      const std::vector<std::string> &texts_to_embed);
+  // Completes prompt with the model through /api/generate, which can take minutes for a long
+  // answer. json_output constrains the reply to a JSON object, for prompts that ask for one.
+  virtual std::string generate(const std::string &prompt, bool json_output = false);
+  // A few sentences on text, through generate()
   virtual std::string summarize_text(const std::string &text);
 
+  // True if any endpoint answers right now
   virtual bool is_server_available();
+  // Embeds a throwaway text on every healthy endpoint at once, so each has the model loaded
+  // before real requests arrive. Returns how many answered; failures are logged, not thrown.
+  size_t warm_up();
+
+  virtual std::vector<OllamaEndpointStatus> endpoint_status() const;
+  // Texts per get_embeddings call that the healthy endpoints keep up with: the smallest of
+  // their tuned batch sizes, or the controller's initial size without any
+  virtual size_t embedding_batch_size() const;
+
+ protected:
+  // For backends that embed without a server: no endpoints are configured or probed, so a
+  // subclass must override every request method above
+  explicit OllamaClient(std::string embedding_model);
 
  private:
-  std::string generate_text();
-  std::string ollama_url_;
+  struct Endpoint {
+    std::string url;
+    std::unique_ptr<HttpClient> http;
+    std::atomic<int> outstanding{0};
+    std::atomic<bool> healthy{true};
+    // Guards the recovery probe of a down endpoint
+    std::mutex probe_mutex;
+    std::chrono::steady_clock::time_point retry_at;
+    std::future<HttpResponse> probe;
+    AdaptiveBatchController tuning;
+    metrics::Gauge *batch_size_gauge = nullptr;
+    metrics::Gauge *in_flight_gauge = nullptr;
+  };
+
+  // An embedding request's texts, for the controller of the endpoint that answers it
+  struct BatchShape {
+    size_t texts;
+    size_t chars;
+  };
+
   std::string embedding_model_;
+  std::vector<std::unique_ptr<Endpoint>> endpoints_;
+  std::atomic<size_t> next_endpoint_{0};
+  // Notified whenever a request finishes, for get_embeddings waiting on a limit
+  std::mutex capacity_mutex_;
+  std::condition_variable capacity_freed_;
 
   // Helper methods
-  void setup_server_connection();
+  static bool is_endpoint_available(Endpoint &endpoint);
+  // Least loaded healthy endpoint not in tried, or nullptr when every one is down or tried
+  Endpoint *pick_endpoint(const std::vector<Endpoint *> &tried);
+  // Starts or collects the async recovery probe of a down endpoint; true once it is back
+  bool poll_recovery(Endpoint &endpoint);
+  void mark_down(Endpoint &endpoint, const std::string &reason);
+  // One request on endpoint finished, successfully or not; called from the transfer's
+  // completion, on the endpoint's HTTP event-loop thread
+  void release(Endpoint &endpoint);
+  // True when a healthy endpoint is under its in-flight limit, or no endpoint is healthy
+  bool has_capacity() const;
+  static void publish_tuning(Endpoint &endpoint);
+  std::future<HttpResponse> submit(Endpoint &endpoint, const char *path, const std::string &body);
+  // POSTs body to path, starting on first. The deferred result is the first reply below 500;
+  // transfer failures and 5xx fail over to the other endpoints, counted in failovers, and
+  // throw OllamaError(failure_prefix + the last failure) once none is left. With a shape, every
+  // attempt's outcome also goes to its endpoint's controller.
+  std::future<HttpResponse> send(Endpoint &first,
+                                 const char *path,
+                                 std::string body,
+                                 std::string failure_prefix,
+                                 metrics::Counter &failovers,
+                                 std::optional<BatchShape> shape = std::nullopt);
 };
 
 }  // namespace magic_core
\ No newline at end of file
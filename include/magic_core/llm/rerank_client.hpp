@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "magic_core/llm/http_client.hpp"
+
+namespace magic_core {
+
+class RerankError : public std::exception {
+ public:
+  explicit RerankError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+/**
+ * @class RerankClient
+ * @brief Cross-encoder client: scores how well each of a batch of documents answers a query.
+ *
+ * Speaks the /v1/rerank shape served by llama.cpp's server, TEI, Jina and Cohere: the query and
+ * the documents go out in one request, each document comes back with its index and a relevance
+ * score, higher being better. Batches are sent asynchronously over the keep-alive connections
+ * of one HttpClient, so a caller can prepare the next batch while earlier ones are scored and
+ * stop waiting at a deadline. Thread-safe.
+ */
+class RerankClient {
+ public:
+  static constexpr const char *RERANK_PATH = "/v1/rerank";
+
+  // A batch on its way to the endpoint
+  class Pending {
+   public:
+    Pending() = default;
+    Pending(Pending &&) = default;
+    Pending &operator=(Pending &&) = default;
+
+    // The documents' scores in the order they were sent, or nullopt if the reply is not in by
+    // deadline; the request is then left to finish on its own. Throws RerankError when the
+    // request failed or the reply does not score every document.
+    std::optional<std::vector<float>> get(std::chrono::steady_clock::time_point deadline);
+
+   private:
+    friend class RerankClient;
+    Pending(std::future<HttpResponse> reply, size_t documents)
+        : reply_(std::move(reply)), documents_(documents) {}
+
+    std::future<HttpResponse> reply_;
+    size_t documents_ = 0;
+  };
+
+  RerankClient(const std::string &url, std::string model, HttpClientOptions http_options = {});
+
+  Pending score_async(const std::string &query, const std::vector<std::string> &documents);
+  // Waits for the scores as long as the HTTP request timeout allows
+  std::vector<float> score(const std::string &query, const std::vector<std::string> &documents);
+
+  const std::string &model() const {
+    return model_;
+  }
+
+ private:
+  std::string model_;
+  HttpClient http_;
+};
+
+}  // namespace magic_core
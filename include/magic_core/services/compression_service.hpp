@@ -1,25 +1,85 @@
 #pragma once
 
-#include <vector>
+#include <cstdint>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace magic_core {
 
+/**
+ * Zstandard compression for chunk content.
+ *
+ * Chunks are a couple of KB each, too small for zstd to learn much from one alone, so a
+ * dictionary trained on a sample of stored chunks can be registered and made active. Frames
+ * record the id of the dictionary they were written with (0 for none), and decompress() picks
+ * the matching one, so chunks written before or under an older dictionary keep decoding as long
+ * as it stays registered. Each thread reuses one compression and one decompression context.
+ */
 class CompressionService {
     public:
         /**
          * @brief Compresses a block of data using Zstandard.
          * @param data The data to compress.
-         * @param compression_level The zstd compression level (default is 3).
+         * @param compression_level The zstd compression level (default is 3). Ignored while a
+         *        dictionary is active; its level was fixed when it was registered.
          * @return A vector of chars containing the compressed binary data.
          */
         static std::vector<char> compress(std::string_view data, int compression_level = 3);
-    
+
+        /**
+         * @brief compress() into a caller-owned buffer, which is resized to the frame. A buffer
+         *        reused across calls stops allocating once it has held the largest frame bound.
+         */
+        static void compress_into(std::string_view data,
+                                  std::vector<char>& out,
+                                  int compression_level = 3);
+
         /**
          * @brief Decompresses a block of Zstandard-compressed data.
          * @param compressed_data The binary data to decompress.
          * @return A string containing the original, decompressed data.
+         * @throws std::runtime_error if the data is not zstd, is corrupt, or was written with a
+         *         dictionary that is not registered.
          */
         static std::string decompress(const std::vector<char>& compressed_data);
+
+        /**
+         * @brief decompress() into a reusable arena, which is resized to the content; its
+         *        capacity is kept, so only growth allocates. Same errors as decompress().
+         * @return A view of the content in arena, valid until arena next changes.
+         */
+        static std::string_view decompress_into(const std::vector<char>& compressed_data,
+                                                std::string& arena);
+
+        /**
+         * @brief Trains a dictionary on sample chunks with ZDICT_trainFromBuffer.
+         * @param samples Representative uncompressed chunks; a few hundred at least.
+         * @param capacity Upper bound on the dictionary size in bytes.
+         * @return The dictionary, which carries its own id.
+         * @throws std::runtime_error if zstd cannot train on the samples (too few or too small).
+         */
+        static std::vector<char> train_dictionary(const std::vector<std::string>& samples,
+                                                  size_t capacity = DEFAULT_DICTIONARY_CAPACITY);
+
+        /**
+         * @brief Registers a trained dictionary for decompression, and for compression too when
+         *        activate is set.
+         * @param compression_level Level baked into the dictionary's compression tables.
+         * @return The dictionary's id, as recorded in the frames it writes.
+         * @throws std::invalid_argument if the bytes are not a zstd dictionary.
+         */
+        static uint32_t register_dictionary(const std::vector<char>& dictionary,
+                                            bool activate = true,
+                                            int compression_level = 3);
+
+        // Id of the dictionary compress() uses; 0 when it compresses without one
+        static uint32_t active_dictionary_id();
+        // Id recorded in a frame's header; 0 if it was written without a dictionary
+        static uint32_t dictionary_id(const std::vector<char>& compressed_data);
+        // Drops every registered dictionary. Only safe while nothing else compresses.
+        static void clear_dictionaries();
+
+        static constexpr size_t DEFAULT_DICTIONARY_CAPACITY = 64 * 1024;
 };
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 
 #include <filesystem>
 #include <magic_core/db/metadata_store.hpp>
+#include <magic_core/db/sharded_metadata_store.hpp>
 #include <memory>
 
 namespace magic_core {
@@ -9,12 +10,17 @@ namespace magic_core {
 class FileDeleteService {
  public:
   explicit FileDeleteService(std::shared_ptr<magic_core::MetadataStore> metadata_store);
+  // Each file goes to the shard holding it
+  explicit FileDeleteService(std::shared_ptr<magic_core::ShardedMetadataStore> metadata_store);
 
   // Delete a file and its associated metadata/embeddings.
   void delete_file(const std::filesystem::path &file_path);
+  // Delete every indexed file below directory, e.g. after the directory was removed.
+  // Returns the number of files deleted.
+  size_t delete_directory(const std::filesystem::path &directory);
 
  private:
-  std::shared_ptr<magic_core::MetadataStore> metadata_store_;
+  std::shared_ptr<magic_core::ShardedMetadataStore> metadata_store_;
 };
 
 } 
\ No newline at end of file
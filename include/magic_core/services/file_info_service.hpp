@@ -2,6 +2,7 @@
 
 #include <filesystem>
 #include <magic_core/db/metadata_store.hpp>
+#include <magic_core/db/sharded_metadata_store.hpp>
 #include <memory>
 #include <optional>
 #include <vector>
@@ -11,13 +12,19 @@ namespace magic_core {
 class FileInfoService {
  public:
   explicit FileInfoService(std::shared_ptr<magic_core::MetadataStore> metadata_store);
+  // Each file goes to the shard holding it
+  explicit FileInfoService(std::shared_ptr<magic_core::ShardedMetadataStore> metadata_store);
 
   // Convenience wrappers over MetadataStore.
   std::vector<magic_core::FileMetadata> list_files();
+  // One page of a listing without vectors, see MetadataStore::list_files_page
+  std::vector<magic_core::BasicFileMetadata> list_files_page(int64_t after_id, int limit);
   std::optional<magic_core::FileMetadata> get_file_info(const std::filesystem::path &file_path);
+  // Every configured collection with its index sizes; empty when none are configured
+  std::vector<magic_core::CollectionInfo> list_collections();
 
  private:
-  std::shared_ptr<magic_core::MetadataStore> metadata_store_;
+  std::shared_ptr<magic_core::ShardedMetadataStore> metadata_store_;
 };
 
 }
\ No newline at end of file
@@ -2,10 +2,13 @@
 
 #include <filesystem>
 #include <magic_core/db/metadata_store.hpp>
+#include <magic_core/db/sharded_metadata_store.hpp>
 #include <magic_core/db/task_queue_repo.hpp>
 #include <magic_core/extractors/content_extractor_factory.hpp>
 #include <magic_core/llm/ollama_client.hpp>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace magic_core {
 
@@ -32,6 +35,23 @@ struct ProcessFileResult {
   }
 };
 
+struct DirectoryProcessingResult {
+  // Regular files found under the directory
+  size_t files_found = 0;
+  std::vector<long long> task_ids;
+  // Already stored with the same content
+  size_t skipped = 0;
+  // New paths of content already stored or queued, including another file in the same walk.
+  // Each is recorded as a duplicate sharing that file's chunks, without a task.
+  size_t duplicates = 0;
+  // Files no extractor can handle
+  size_t unsupported = 0;
+  // "path: reason" for every file that could not be read or hashed
+  std::vector<std::string> errors;
+  // Whether the tasks belong to a bulk load, one this request opened or one already open
+  bool bulk_load = false;
+};
+
 class FileProcessingService {
  public:
   FileProcessingService(
@@ -39,12 +59,34 @@ class FileProcessingService {
       std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo,
       std::shared_ptr<magic_core::ContentExtractorFactory> content_extractor_factory,
       std::shared_ptr<magic_core::OllamaClient> ollama_client);
-  // Request a file to be processed, if it's not already in the queue
-  std::optional<long long> request_processing(const std::filesystem::path& file_path);
-  
+  // Stubs go to the shard of their path, and duplicates are only found within a shard
+  FileProcessingService(
+      std::shared_ptr<magic_core::ShardedMetadataStore> metadata_store,
+      std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo,
+      std::shared_ptr<magic_core::ContentExtractorFactory> content_extractor_factory,
+      std::shared_ptr<magic_core::OllamaClient> ollama_client);
+  // Request a file to be processed, if it's not already in the queue. A new path of content
+  // that is already stored or queued is recorded as a duplicate instead (see
+  // MetadataStore::add_duplicate_files); no task is queued for it.
+  std::optional<long long> request_processing(const std::filesystem::path& file_path,
+                                              int priority = TaskPriority::INTERACTIVE);
+  // Queues every supported file under directory that is not already queued or processed. The
+  // tree is walked and hashed in parallel; stubs and tasks are written once per batch.
+  // bulk_load opens a bulk load (see MetadataStore::begin_bulk_load) on each shard the tree
+  // writes to before its first task, for an initial import; index maintenance ends it once the
+  // walk is over and the queue has drained.
+  DirectoryProcessingResult request_directory_processing(const std::filesystem::path& directory,
+                                                         int priority = TaskPriority::BULK,
+                                                         bool bulk_load = false);
+
+  // Files whose stubs and tasks are written together
+  static constexpr size_t DIRECTORY_BATCH_SIZE = 128;
+  static constexpr size_t MAX_WALK_THREADS = 4;
+  static constexpr size_t MAX_HASH_THREADS = 8;
+
  private:
   static BasicFileMetadata create_file_stub(const std::filesystem::path& file_path, FileType file_type, std::string content_hash);
-  std::shared_ptr<magic_core::MetadataStore> metadata_store_;
+  std::shared_ptr<magic_core::ShardedMetadataStore> metadata_store_;
   std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo_;
   std::shared_ptr<magic_core::ContentExtractorFactory> content_extractor_factory_;
   std::shared_ptr<magic_core::OllamaClient> ollama_client_;
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace magic_core {
+
+enum class FileChangeKind {
+  // Created, written or moved into a watched tree
+  Modified,
+  // A file was deleted or moved out of a watched tree
+  Removed,
+  // A whole directory was deleted or moved away, its files are not reported one by one
+  RemovedTree,
+};
+
+/**
+ * @class FileWatchBackend
+ * @brief Delivers raw change notifications for a set of directory trees.
+ *
+ * Backends report every event they see and leave debouncing to FileWatcherService, which
+ * re-checks the file system before acting, so a spurious or out-of-order event is harmless.
+ */
+class FileWatchBackend {
+ public:
+  using ChangeCallback = std::function<void(const std::filesystem::path &, FileChangeKind)>;
+
+  virtual ~FileWatchBackend() = default;
+
+  // Blocks, delivering events to on_change, until stop() is called from another thread.
+  virtual void run(const ChangeCallback &on_change) = 0;
+  virtual void stop() = 0;
+  virtual std::string name() const = 0;
+};
+
+/**
+ * @class PollingWatchBackend
+ * @brief Portable fallback that diffs (mtime, size) snapshots of the trees on an interval.
+ *
+ * Detection is O(tree) per interval instead of O(changes), so it is only used where no
+ * native backend exists or the native one cannot be set up (e.g. the inotify watch limit).
+ */
+class PollingWatchBackend : public FileWatchBackend {
+ public:
+  static constexpr std::chrono::milliseconds DEFAULT_INTERVAL{2000};
+
+  explicit PollingWatchBackend(std::vector<std::filesystem::path> roots,
+                               std::chrono::milliseconds interval = DEFAULT_INTERVAL);
+
+  void run(const ChangeCallback &on_change) override;
+  void stop() override;
+  std::string name() const override {
+    return "polling";
+  }
+
+ private:
+  struct FileStamp {
+    std::filesystem::file_time_type last_write;
+    uintmax_t size;
+  };
+  using Snapshot = std::unordered_map<std::string, FileStamp>;
+
+  Snapshot take_snapshot() const;
+
+  std::vector<std::filesystem::path> roots_;
+  std::chrono::milliseconds interval_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopped_ = false;
+};
+
+// Picks inotify on Linux and FSEvents on macOS, falling back to polling when the native
+// backend is unavailable or fails to initialize.
+std::unique_ptr<FileWatchBackend> create_file_watch_backend(
+    const std::vector<std::filesystem::path> &roots);
+
+}  // namespace magic_core
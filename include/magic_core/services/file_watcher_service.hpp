@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "magic_core/services/file_delete_service.hpp"
+#include "magic_core/services/file_processing_service.hpp"
+#include "magic_core/services/file_watch_backend.hpp"
+
+namespace magic_core {
+
+struct FileWatcherOptions {
+  // How long a path must be quiet before its change is acted on
+  std::chrono::milliseconds settle{1500};
+  bool recursive = true;
+  // Queue everything already in the roots on start, catching changes made while stopped
+  bool initial_scan = true;
+  // Glob patterns ('*' and '?') matched against file names
+  std::vector<std::string> ignore = {"*.tmp", ".DS_Store", "*.part", "*.crdownload", "~*",
+                                     "*~",    ".*.swp"};
+};
+
+/**
+ * @class FileWatcherService
+ * @brief Keeps the index in step with watched directories as files change.
+ *
+ * A backend thread receives raw events (inotify, FSEvents or polling) and records them per
+ * path. Bursts on the same path, such as an editor's truncate + write + rename, collapse into
+ * one pending change that is dispatched once the path has been quiet for the settle window.
+ * Dispatching re-checks the file system: files that exist are queued for processing (which
+ * skips unchanged content) and files that are gone are deleted from the index.
+ */
+class FileWatcherService {
+ public:
+  // A path that never goes quiet is still dispatched after this many settle windows
+  static constexpr int MAX_SETTLE_WINDOWS = 10;
+
+  // backend defaults to the platform's native backend for roots
+  FileWatcherService(std::shared_ptr<FileProcessingService> file_processing_service,
+                     std::shared_ptr<FileDeleteService> file_delete_service,
+                     std::vector<std::filesystem::path> roots,
+                     FileWatcherOptions options = {},
+                     std::unique_ptr<FileWatchBackend> backend = nullptr);
+  ~FileWatcherService();
+
+  FileWatcherService(const FileWatcherService &) = delete;
+  FileWatcherService &operator=(const FileWatcherService &) = delete;
+
+  void start();
+  // Stops watching and dispatches whatever is still pending
+  void stop();
+  bool is_running() const;
+
+  // Records a change, unless the path matches an ignore pattern (or sits below a root when not
+  // recursive).
+  void record_change(const std::filesystem::path &path,
+                     FileChangeKind kind,
+                     std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+  // Dispatches every pending change that has settled by now. Returns how many were dispatched.
+  size_t dispatch_settled(std::chrono::steady_clock::time_point now);
+  size_t pending_count() const;
+
+ private:
+  struct PendingChange {
+    FileChangeKind kind;
+    std::chrono::steady_clock::time_point first_seen;
+    std::chrono::steady_clock::time_point last_seen;
+  };
+
+  bool is_ignored(const std::filesystem::path &path) const;
+  void scan_roots();
+  void backend_loop();
+  void dispatch_loop();
+  void dispatch(const std::filesystem::path &path, FileChangeKind kind);
+
+  std::shared_ptr<FileProcessingService> file_processing_service_;
+  std::shared_ptr<FileDeleteService> file_delete_service_;
+  std::vector<std::filesystem::path> roots_;
+  FileWatcherOptions options_;
+  // Guards swapping backend_ for the polling fallback against stop()
+  std::mutex backend_mutex_;
+  std::unique_ptr<FileWatchBackend> backend_;
+
+  std::unique_ptr<std::thread> backend_thread_;
+  std::unique_ptr<std::thread> dispatch_thread_;
+  std::atomic<bool> running_{false};
+
+  mutable std::mutex pending_mutex_;
+  std::condition_variable stop_cv_;
+  std::unordered_map<std::string, PendingChange> pending_;
+};
+
+}  // namespace magic_core
@@ -2,30 +2,145 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <magic_core/db/database_manager.hpp>
 #include <magic_core/db/metadata_store.hpp>
+#include <magic_core/db/task_queue_repo.hpp>
+#include <magic_core/services/compression_service.hpp>
 #include <memory>
+#include <mutex>
 #include <thread>
 
 namespace magic_core {
 namespace background {
 
+struct IndexMaintenanceOptions {
+  // How often the loop wakes up to look for due jobs
+  std::chrono::seconds interval = std::chrono::minutes(1);
+
+  // Each job runs at most once per its interval, however often the loop wakes up
+  std::chrono::seconds index_check_interval = std::chrono::minutes(10);
+  std::chrono::seconds checkpoint_interval = std::chrono::minutes(5);
+  std::chrono::seconds optimize_interval = std::chrono::hours(1);
+  std::chrono::seconds task_cleanup_interval = std::chrono::hours(24);
+  std::chrono::seconds dictionary_interval = std::chrono::hours(6);
+  std::chrono::seconds text_index_interval = std::chrono::minutes(1);
+
+  // An index is rebuilt to drop its tombstones once there are at least min_tombstones of them
+  // and they make up max_tombstone_ratio of its live vectors
+  size_t min_tombstones = 1024;
+  double max_tombstone_ratio = 0.25;
+  // A quantized index is retrained once it holds this fraction more vectors than it was
+  // trained on, since its codebooks no longer reflect the data
+  double max_growth_ratio = 0.5;
+
+  // Free pages handed back per optimize run
+  int incremental_vacuum_pages = 2048;
+  int completed_task_retention_days = 7;
+
+  // A chunk compression dictionary is first trained once this many chunks are stored, and
+  // trained again once the store holds this fraction more chunks than the last one saw
+  int64_t min_dictionary_chunks = 1000;
+  double dictionary_growth_ratio = 1.0;
+  // Chunks sampled per training, and the dictionary's size limit
+  int dictionary_samples = 2000;
+  size_t dictionary_capacity = CompressionService::DEFAULT_DICTIONARY_CAPACITY;
+
+  // Chunks stored before the full-text index existed are added this many at a time, for at
+  // most this many batches per run
+  int text_index_batch = 500;
+  int text_index_batches_per_run = 20;
+};
+
+/**
+ * @class IndexMaintenanceService
+ * @brief Runs the periodic upkeep that would otherwise slow down ingestion and search.
+ *
+ * One background thread wakes every interval and runs whichever jobs are due:
+ *   - index check: rebuilds the file or chunk index when tombstones pile up, when a flat
+ *     stand-in has enough vectors to train its configured type, or when a quantized index has
+ *     outgrown the sample it was trained on. At most one index is rebuilt per pass, and the
+ *     rebuilt indexes are snapshotted so a restart does not have to repeat the work.
+ *   - WAL checkpoint (PASSIVE, so it never waits on the writer)
+ *   - PRAGMA optimize and an incremental vacuum, through the writer thread
+ *   - clearing completed tasks past their retention
+ *   - training a zstd dictionary for chunk content on a sample of stored chunks, once there
+ *     are enough of them and again as they grow. Each one is saved before it is activated, so
+ *     no chunk is written with a dictionary the database does not have.
+  *   - adding chunks stored before the full-text index existed to it, a bounded batch per run
+ * While a bulk load is open the index check and full-text backfill stand aside; every pass
+ * checks whether the load's tasks have drained and, if so, finishes it.
+ * A job that fails is logged and retried at its next interval.
+ */
 class IndexMaintenanceService {
  public:
-  explicit IndexMaintenanceService(std::shared_ptr<magic_core::MetadataStore> metadata_store,
-                                   std::chrono::seconds interval = std::chrono::hours(1));
+  IndexMaintenanceService(std::shared_ptr<magic_core::MetadataStore> metadata_store,
+                          std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo,
+                          DatabaseManager &db_manager,
+                          IndexMaintenanceOptions options = {});
+  ~IndexMaintenanceService();
+
+  IndexMaintenanceService(const IndexMaintenanceService &) = delete;
+  IndexMaintenanceService &operator=(const IndexMaintenanceService &) = delete;
 
   void start();
   void stop();
   bool is_running() const;
 
+  // Runs every job that is due at now. Returns how many ran.
+  size_t run_due_jobs(std::chrono::steady_clock::time_point now);
+
+  // Ends the open bulk load once no task is pending or processing: rebuilds the indexes, adds
+  // the import to the full-text index, truncates the WAL and snapshots. Returns false if there
+  // was no load to end or it is still running. Also tried on every pass of the loop.
+  bool finish_bulk_load();
+
+  // Whether an index in this state should be rebuilt
+  static bool needs_rebuild(const VectorIndexStats &stats, const IndexMaintenanceOptions &options);
+  // Whether to train a dictionary with chunk_count chunks stored; trained_chunk_count is what
+  // the newest dictionary was trained at, 0 if there is none
+  static bool needs_dictionary(int64_t chunk_count,
+                               int64_t trained_chunk_count,
+                               const IndexMaintenanceOptions &options);
+
  private:
+  struct Job {
+    std::chrono::seconds interval;
+    // Never ran while at the epoch, so every job runs on the first pass
+    std::chrono::steady_clock::time_point last_run{};
+
+    bool due(std::chrono::steady_clock::time_point now) const {
+      return last_run == std::chrono::steady_clock::time_point{} || now - last_run >= interval;
+    }
+  };
+
   void maintenance_loop();
+  void check_indexes();
+  void checkpoint_wal();
+  void optimize_database();
+  void clear_completed_tasks();
+  void train_compression_dictionary();
+  void index_chunk_text();
+  // Adds chunks missing from the full-text index, at most max_batches batches. Returns how many.
+  size_t backfill_chunk_text(int max_batches);
 
   std::shared_ptr<magic_core::MetadataStore> metadata_store_;
-  std::chrono::seconds interval_;
+  std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo_;
+  DatabaseManager &db_manager_;
+  IndexMaintenanceOptions options_;
+
+  Job index_check_;
+  Job checkpoint_;
+  Job optimize_;
+  Job task_cleanup_;
+  Job dictionary_;
+  Job text_index_;
+
   std::unique_ptr<std::thread> worker_;
   std::atomic<bool> running_{false};
+  std::mutex stop_mutex_;
+  std::condition_variable stop_cv_;
 };
 
 }  // namespace background
-}  // namespace magic_core
\ No newline at end of file
+}  // namespace magic_core
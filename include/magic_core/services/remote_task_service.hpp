@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "magic_core/db/metadata_store.hpp"
+#include "magic_core/db/sharded_metadata_store.hpp"
+#include "magic_core/db/models/task_dto.hpp"
+#include "magic_core/db/task_queue_repo.hpp"
+
+namespace magic_core {
+
+// A claimed task handed to a worker in another process
+struct RemoteTask {
+  TaskDTO task;
+  // Content hashes of the chunks already stored with a vector. The worker need not embed
+  // chunks with these hashes; the stored vectors are reused.
+  std::vector<std::string> stored_chunk_hashes;
+};
+
+// One chunk of a remote worker's result
+struct RemoteChunk {
+  int chunk_index = 0;
+  std::string content;
+  // Empty when the chunk's hash was in stored_chunk_hashes
+  std::vector<float> vector_embedding;
+};
+
+/**
+ * Lets ingestion workers in other processes, possibly on other machines, drain the task queue.
+ * They claim tasks and extract and embed on their side, then send the chunks here, where this
+ * process, the only writer of the database and the vector indexes, diffs, compresses and stores
+ * them the way ProcessFileTask does locally.
+ *
+ * Remote claims are leased to "remote/<worker>". Every call after the claim checks the lease
+ * and throws TaskLeaseLostError once the task has been reclaimed.
+ */
+class RemoteTaskService {
+ public:
+  RemoteTaskService(std::shared_ptr<MetadataStore> metadata_store,
+                    std::shared_ptr<TaskQueueRepo> task_queue_repo);
+  // Each result is stored in the shard holding its file
+  RemoteTaskService(std::shared_ptr<ShardedMetadataStore> metadata_store,
+                    std::shared_ptr<TaskQueueRepo> task_queue_repo);
+
+  // Claimed tasks other than PROCESS_FILE go straight back to the queue for in-process workers
+  std::vector<RemoteTask> claim_tasks(const std::string& worker, int max_tasks, TaskLane lane);
+  // Records progress and renews the lease
+  void report_progress(long long task_id,
+                       const std::string& worker,
+                       float percent,
+                       const std::string& message);
+  // Stores a PROCESS_FILE result and completes the task. Throws std::invalid_argument if a chunk
+  // that needs a vector came without one. embedding_model names the model the worker embedded
+  // with; when it is not the active one, the task fails and EmbeddingModelMismatchError is
+  // thrown without storing anything.
+  void complete_file_task(long long task_id,
+                          const std::string& worker,
+                          std::vector<RemoteChunk> chunks,
+                          const std::string& embedding_model);
+  void fail_task(long long task_id, const std::string& worker, const std::string& error_message);
+
+  static std::string lease_owner(const std::string& worker) {
+    return "remote/" + worker;
+  }
+
+  // Chunks per write, as in ProcessFileTask
+  static constexpr size_t WRITE_BATCH_SIZE = 64;
+
+ private:
+  // The task, which must still be leased to worker
+  TaskDTO leased_task(long long task_id, const std::string& worker);
+
+  std::shared_ptr<ShardedMetadataStore> metadata_store_;
+  std::shared_ptr<TaskQueueRepo> task_queue_repo_;
+};
+
+}  // namespace magic_core
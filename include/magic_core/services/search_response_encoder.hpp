@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "magic_core/services/search_service.hpp"
+
+namespace magic_core {
+
+// Body encodings of a search response. MessagePack carries the same maps as the JSON, with
+// scores as float32 and ids as integers.
+enum class ResponseFormat { Json, MessagePack };
+
+/**
+ * @class SearchResponseEncoder
+ * @brief Writes search results straight into a response body, without building a json tree.
+ *
+ * A response holds "chunks" and "files" arrays. A file is {"duplicate_paths", "id", "path",
+ * "score"}; a chunk is {"chunk_index", "file_id", "id", "score"} plus "content", "snippet" and
+ * "snippet_offset", or "content_zstd" and "dictionary_id", as its ChunkContentMode asks, and
+ * "rerank_score" when the re-ranker scored it. The stored frame in "content_zstd" is base64 in
+ * JSON and bin in MessagePack. Keys are written in sorted order, the order nlohmann::json
+ * serialized them in. Strings that are not valid UTF-8 have the offending bytes replaced with
+ * U+FFFD, and non-finite scores are written as null.
+ */
+class SearchResponseEncoder {
+ public:
+  // MessagePack when accept lists application/msgpack or application/x-msgpack (with a q
+  // above 0), JSON otherwise
+  static ResponseFormat negotiate(const std::string &accept);
+  static const char *content_type(ResponseFormat format);
+
+  static std::string encode(const SearchService::MagicSearchResult &result,
+                            ChunkContentMode mode,
+                            ResponseFormat format);
+  // {"results": [...]}, each result carrying its "query" too
+  static std::string encode_batch(const std::vector<SearchService::MagicSearchResult> &results,
+                                  const std::vector<std::string> &queries,
+                                  ChunkContentMode mode,
+                                  ResponseFormat format);
+  // A plain array of files, as /files/search answers
+  static std::string encode_files(const std::vector<FileSearchResult> &results,
+                                  ResponseFormat format);
+
+  // Events of a streamed search: {"event": "files", "files": [...]} once, then
+  // {"chunk": {...}, "event": "chunk"} per chunk
+  static std::string encode_stream_files(const std::vector<FileSearchResult> &results,
+                                         ResponseFormat format);
+  static std::string encode_stream_chunk(const SearchService::ChunkResultDTO &chunk,
+                                         ChunkContentMode mode,
+                                         ResponseFormat format);
+};
+
+}  // namespace magic_core
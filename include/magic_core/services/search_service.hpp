@@ -1,15 +1,66 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 #include <functional>
+#include <optional>
 
 #include "magic_core/db/metadata_store.hpp"
+#include "magic_core/db/sharded_metadata_store.hpp"
 #include "magic_core/llm/ollama_client.hpp"
+#include "magic_core/llm/rerank_client.hpp"
+#include "magic_core/types/lru_cache.hpp"
 
 namespace magic_core {
 
+// How much of each chunk hit a search returns. Only Full and Snippet decompress anything; None
+// does not even read the stored blobs, and the client fetches the chunks it wants by id.
+// Compressed hands out the stored zstd frames as they are, for clients that decode them
+// themselves (with the dictionary the frame names, if any).
+enum class ChunkContentMode { Full, Snippet, None, Compressed };
+
+struct ChunkContentOptions {
+  ChunkContentMode mode = ChunkContentMode::Full;
+  // Snippet length in bytes, cut around the part of the chunk that best matches the query
+  size_t snippet_chars = 200;
+};
+
+// What ranks a search's hits. Vector embeds the query and searches the ANN indexes; Lexical
+// matches the query's words against the full-text index over chunk content and never calls
+// the embedder; Hybrid runs both and merges them with reciprocal-rank fusion.
+enum class SearchMode { Vector, Hybrid, Lexical };
+
+// How a vector search finds its chunks: the file index picks a shortlist of files, and their
+// chunks are ranked against the query
+struct SearchPlan {
+  // Files whose chunks compete for the chunk hits; 0 means k. Only the first k are returned as
+  // file results, so a longer shortlist widens the chunk candidates without changing them.
+  int file_shortlist = 0;
+  // Score every shortlisted chunk exactly rather than searching the chunk index
+  bool exact_chunk_scan = true;
+};
+
+// Second stage of Vector and Hybrid searches: the first stage's best chunks are scored against
+// the query by a cross-encoder (see RerankClient) and re-ordered by that score. Candidates are
+// decompressed in order and sent batch_size at a time, so later batches are decompressed while
+// earlier ones are scored. Whatever is not scored within budget keeps its first-stage order
+// after the scored ones. A search_batch() sends every query's batches before waiting on any,
+// and they all share one budget.
+struct RerankOptions {
+  // Chunks the first stage hands on, of which the best k are returned; 0 disables re-ranking
+  int candidates = 0;
+  size_t batch_size = 16;
+  // From the start of re-ranking until the last batch is given up on
+  std::chrono::milliseconds budget{150};
+  // Each chunk is cut to this many bytes, on a UTF-8 boundary, before it is sent
+  size_t max_chars = 2048;
+};
+
 class SearchService {
  public:
   struct ChunkResultDTO {
@@ -17,26 +68,227 @@ class SearchService {
     float distance;
     int file_id;
     int chunk_index;
+    // The whole chunk, the snippet, or empty, depending on the search's ChunkContentMode
     std::string content;
+    // Where the snippet starts in the chunk; 0 otherwise
+    size_t content_offset = 0;
+    // Under Compressed, content is the stored zstd frame and this the id of the dictionary it
+    // was written with (0 for none)
+    uint32_t dictionary_id = 0;
+    // The re-ranker's relevance, higher being better, on its own scale; unset when the chunk
+    // was not scored. distance stays the first stage's.
+    std::optional<float> rerank_score;
   };
   struct MagicSearchResult {
     std::vector<FileSearchResult> file_results;
     std::vector<ChunkResultDTO> chunk_results;
+    // Every chunk candidate was scored by the re-ranker in time, so the chunks are ordered by
+    // rerank_score. A search that ran out of budget leaves the chunks it could not score
+    // unscored, after the others in first-stage order.
+    bool reranked = false;
+  };
+  // Receives a streamed search's hits as they become ready
+  struct SearchObserver {
+    // The file hits, once and before any chunk
+    std::function<void(const std::vector<FileSearchResult> &)> on_files;
+    // Each chunk hit in rank order, as soon as its content is read
+    std::function<void(const ChunkResultDTO &)> on_chunk;
+  };
+  struct CacheStats {
+    size_t hits;
+    size_t misses;
+    size_t size;
   };
+
+  // Distinct query strings whose embeddings are kept; 0 disables the cache
+  static constexpr size_t DEFAULT_QUERY_CACHE_CAPACITY = 256;
+  // The usual reciprocal-rank-fusion constant: an item at rank r (from 1) of a list scores
+  // 1 / (RRF_K + r), which keeps one list's top hit from drowning out the other list
+  static constexpr int RRF_K = 60;
+
   SearchService(std::shared_ptr<MetadataStore> metadata_store,
                 std::shared_ptr<OllamaClient> ollama_client,
-                std::function<std::string(const std::vector<char>&)> decompress_fn = {});
+                std::function<std::string(const std::vector<char>&)> decompress_fn = {},
+                size_t query_cache_capacity = DEFAULT_QUERY_CACHE_CAPACITY,
+                size_t result_cache_capacity = 0,
+                SearchPlan plan = {},
+                std::shared_ptr<RerankClient> reranker = nullptr,
+                RerankOptions rerank = {});
+  // Searches every shard and merges their hits
+  SearchService(std::shared_ptr<ShardedMetadataStore> metadata_store,
+                std::shared_ptr<OllamaClient> ollama_client,
+                std::function<std::string(const std::vector<char>&)> decompress_fn = {},
+                size_t query_cache_capacity = DEFAULT_QUERY_CACHE_CAPACITY,
+                size_t result_cache_capacity = 0,
+                SearchPlan plan = {},
+                std::shared_ptr<RerankClient> reranker = nullptr,
+                RerankOptions rerank = {});
+
+  // Natural-language semantic search. Returns top-k nearest neighbours. tuning trades recall
+  // for latency per call; left at its defaults the index's configured values are used. Only
+  // files matching filter are searched, so k results come back whenever that many match.
+  std::vector<FileSearchResult> search_files(const std::string &query,
+                                             int k = 10,
+                                             const VectorSearchOptions &tuning = {},
+                                             const SearchFilter &filter = {});
+  // Files and chunks for the query. Under Vector, distances are the index metric's; under
+  // Lexical they are BM25 scores and files rank by their best chunk; under Hybrid they are the
+  // negated fused scores. Lower is better in every mode.
+  MagicSearchResult search(const std::string &query,
+                           int k = 10,
+                           const VectorSearchOptions &tuning = {},
+                           const ChunkContentOptions &content = {},
+                           SearchMode mode = SearchMode::Vector,
+                           const SearchFilter &filter = {});
+  // search() that hands the file hits to observer as soon as the file index answers, before
+  // the chunks are searched, and then each chunk as its content is read. Under Hybrid and
+  // Lexical the files are only known once the rankings are fused. Returns the whole result too.
+  MagicSearchResult search_streaming(const std::string &query,
+                                     int k,
+                                     const VectorSearchOptions &tuning,
+                                     const ChunkContentOptions &content,
+                                     SearchMode mode,
+                                     const SearchFilter &filter,
+                                     const SearchObserver &observer);
+  // search() for many queries at once: uncached queries are embedded in one request and
+  // searched in one index pass. Element i answers queries[i].
+  std::vector<MagicSearchResult> search_batch(const std::vector<std::string> &queries,
+                                              int k = 10,
+                                              const VectorSearchOptions &tuning = {},
+                                              const ChunkContentOptions &content = {},
+                                              SearchMode mode = SearchMode::Vector,
+                                              const SearchFilter &filter = {});
+  // One chunk with its full content, for clients that searched with ChunkContentMode::None.
+  // distance is 0.
+  std::optional<ChunkResultDTO> get_chunk(int chunk_id);
+  // The stored compression dictionary with this id, for clients decoding Compressed content
+  std::optional<std::vector<char>> get_compression_dictionary(uint32_t id);
+
+  // Offset of the window of up to window bytes of content holding the most occurrences of the
+  // query's words (case-insensitive), centred on them; 0 if none occur. The window never starts
+  // inside a UTF-8 sequence.
+  static size_t best_snippet_offset(const std::string &content,
+                                    const std::string &query,
+                                    size_t window);
 
-  // Natural-language semantic search. Returns top-k nearest neighbours.
-  std::vector<FileSearchResult> search_files(const std::string &query, int k = 10);
-  MagicSearchResult search(const std::string &query, int k = 10);
+  // Reciprocal-rank fusion of several rankings of ids, best first. Returns up to k (id, score)
+  // pairs by descending score; ties keep the order in which the ids were first seen.
+  static std::vector<std::pair<int, float>> fuse_rankings(
+      const std::vector<std::vector<int>> &rankings, size_t k);
+
+  CacheStats query_cache_stats() const;
+  // Results are keyed by (query, k, tuning, content, search mode and filter) and only served
+  // while the store's search generation is the one they were computed at
+  CacheStats result_cache_stats() const;
 
  private:
+  // Embeds the query, or returns the embedding of an identical recent query
   std::vector<float> embed_query(const std::string &query);
+  // Same for several queries, embedding all the uncached ones in a single request
+  std::vector<std::vector<float>> embed_queries(const std::vector<std::string> &queries);
+  // Query embeddings are cached per embedding model
+  std::string query_embedding_key(const std::string &query) const;
+  // on_chunk, when set, gets each DTO as soon as it is filled in. decompressed, when given,
+  // holds each hit's content already decompressed, and rerank_scores the re-ranker's scores
+  // of the leading hits.
+  std::vector<ChunkResultDTO> to_chunk_dtos(
+      const std::vector<ChunkSearchResult> &chunk_hits,
+      const std::string &query,
+      const ChunkContentOptions &content,
+      const std::function<void(const ChunkResultDTO &)> &on_chunk = {},
+      std::vector<std::string> *decompressed = nullptr,
+      const std::vector<float> *rerank_scores = nullptr);
   std::vector<int> get_file_ids(const std::vector<FileSearchResult> &file_results);
-  std::shared_ptr<MetadataStore> metadata_store_;
+  // Files the chunk stage draws from for a search of k results
+  int shortlist_size(int k) const {
+    return std::max(k, plan_.file_shortlist);
+  }
+  bool reranks(SearchMode mode) const {
+    return reranker_ && rerank_.candidates > 0 && mode != SearchMode::Lexical;
+  }
+  // Chunks the first stage of a search of k results under mode ranks
+  int chunk_candidates(int k, SearchMode mode) const {
+    return reranks(mode) ? std::max(k, rerank_.candidates) : k;
+  }
+  // One query's re-ranking: its hits' decompressed texts and the batches scoring them
+  struct RerankRun {
+    std::vector<std::string> texts;
+    std::vector<RerankClient::Pending> batches;
+    std::string failure;
+    // Filled in by finish_rerank, in the order of the re-ordered hits
+    std::vector<float> scores;
+  };
+  // Decompresses hits and sends them to the re-ranker batch by batch, without waiting
+  RerankRun start_rerank(const std::string &query, const std::vector<ChunkSearchResult> &hits);
+  // Waits for run's scores until deadline, re-orders hits by them and cuts hits and run.texts
+  // to k. Returns whether every hit was scored.
+  bool finish_rerank(RerankRun &run,
+                     int k,
+                     std::chrono::steady_clock::time_point deadline,
+                     std::vector<ChunkSearchResult> &hits);
+  // Fills in result's chunks from the hits of a search under mode, re-ranking them first when
+  // the mode reranks
+  void finish_chunks(SearchMode mode,
+                     const std::string &query,
+                     int k,
+                     const ChunkContentOptions &content,
+                     std::vector<ChunkSearchResult> hits,
+                     const std::function<void(const ChunkResultDTO &)> &on_chunk,
+                     MagicSearchResult &result);
+  // finish_chunks() for the queries of a search_batch(): results[i] gets the chunks of
+  // queries[i] from hits[i]. Every query's re-ranking batches go out before any is waited on.
+  void finish_chunks_batch(SearchMode mode,
+                           const std::vector<std::string> &queries,
+                           int k,
+                           const ChunkContentOptions &content,
+                           std::vector<std::vector<ChunkSearchResult>> &hits,
+                           const std::vector<MagicSearchResult *> &results);
+  // Turns one query's vector hits (empty for Lexical) into its result under mode, running the
+  // full-text search when the mode needs it. observer, when given, gets the chunks, and the
+  // files too unless mode is Vector (whose files it was handed already). unfinished, when
+  // given, gets the chunk hits of a Vector or Hybrid search instead of the result, for the
+  // caller to finish.
+  MagicSearchResult assemble_result(SearchMode mode,
+                                    const std::string &query,
+                                    int k,
+                                    const ChunkContentOptions &content,
+                                    const SearchFilter &filter,
+                                    std::vector<FileSearchResult> file_hits,
+                                    std::vector<ChunkSearchResult> chunk_hits,
+                                    const SearchObserver *observer = nullptr,
+                                    std::vector<ChunkSearchResult> *unfinished = nullptr);
+  // search() and search_streaming(); observer may be null
+  MagicSearchResult run_search(const std::string &query,
+                               int k,
+                               const VectorSearchOptions &tuning,
+                               const ChunkContentOptions &content,
+                               SearchMode mode,
+                               const SearchFilter &filter,
+                               const SearchObserver *observer);
+
+  struct CachedResult {
+    uint64_t generation;
+    MagicSearchResult result;
+  };
+  static std::string result_cache_key(char mode,
+                                      const std::string &query,
+                                      int k,
+                                      const VectorSearchOptions &tuning,
+                                      const ChunkContentOptions &content = {},
+                                      const SearchFilter &filter = {});
+  std::optional<MagicSearchResult> cached_result(const std::string &key, uint64_t generation);
+  void cache_result(const std::string &key, uint64_t generation, const MagicSearchResult &result);
+
+  std::shared_ptr<ShardedMetadataStore> metadata_store_;
   std::shared_ptr<OllamaClient> ollama_client_;
   std::function<std::string(const std::vector<char>&)> decompress_fn_;
+  SearchPlan plan_;
+  std::shared_ptr<RerankClient> reranker_;
+  RerankOptions rerank_;
+  LruCache<std::string, std::vector<float>> query_embeddings_;
+  LruCache<std::string, CachedResult> results_;
+  std::atomic<size_t> result_hits_{0};
+  std::atomic<size_t> result_misses_{0};
 };
 
 }  // namespace magic_core
\ No newline at end of file
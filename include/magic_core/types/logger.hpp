@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace magic_core::log {
+
+// Leveled logging that never blocks the caller on I/O. A line is formatted on the calling
+// thread, copied into a fixed-size ring and written out by one background thread, which
+// flushes the stream once per batch instead of once per line. When the ring is full the line is
+// dropped and counted rather than making a search wait on stderr.
+
+enum class Level { Debug = 0, Info = 1, Warning = 2, Error = 3, Off = 4 };
+
+// Accepts "debug", "info", "warning", "error" and "off"; throws std::invalid_argument otherwise
+Level parse_level(const std::string &name);
+std::string to_string(Level level);
+
+struct Record {
+  Level level;
+  std::chrono::system_clock::time_point time;
+  std::string message;
+};
+
+class Logger {
+ public:
+  // Receives each batch in order, from the flusher thread only
+  using Sink = std::function<void(const std::vector<Record> &)>;
+
+  static constexpr size_t DEFAULT_CAPACITY = 8192;
+
+  // The default sink writes Debug and Info to stdout and the rest to stderr
+  explicit Logger(size_t capacity = DEFAULT_CAPACITY, Sink sink = {});
+  // Writes whatever is still queued
+  ~Logger();
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  // The logger the log::debug() ... log::error() shorthands write to
+  static Logger &global();
+
+  void set_level(Level level) noexcept {
+    level_.store(level, std::memory_order_relaxed);
+  }
+  Level level() const noexcept {
+    return level_.load(std::memory_order_relaxed);
+  }
+  bool enabled(Level level) const noexcept {
+    return level != Level::Off && level >= this->level();
+  }
+
+  // Queues message unless level is disabled; never waits for the sink
+  void write(Level level, std::string message);
+  // Blocks until every line queued before the call has reached the sink
+  void flush();
+
+  // Lines lost to a full ring since construction
+  uint64_t dropped() const;
+  size_t capacity() const noexcept {
+    return ring_.size();
+  }
+
+  // "2026-01-02T03:04:05.678Z WARNING message", as the default sink writes it
+  static std::string format(const Record &record);
+
+ private:
+  void run();
+
+  std::atomic<Level> level_{Level::Info};
+  Sink sink_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable ready_;
+  std::condition_variable written_;
+  std::vector<Record> ring_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+  // Sequence numbers of the lines queued and of those handed to the sink
+  uint64_t queued_ = 0;
+  uint64_t delivered_ = 0;
+  uint64_t dropped_ = 0;
+  bool stopping_ = false;
+
+  std::thread flusher_;
+};
+
+// Collects one line with operator<< and queues it when destroyed. The formatting is skipped
+// entirely when the level is disabled.
+class Line {
+ public:
+  Line(Logger &logger, Level level) : logger_(logger), level_(level) {
+    if (logger_.enabled(level_)) {
+      stream_ = std::make_unique<std::ostringstream>();
+    }
+  }
+  ~Line() {
+    if (stream_) {
+      logger_.write(level_, stream_->str());
+    }
+  }
+
+  Line(const Line &) = delete;
+  Line &operator=(const Line &) = delete;
+
+  template <typename T>
+  Line &operator<<(const T &value) {
+    if (stream_) {
+      *stream_ << value;
+    }
+    return *this;
+  }
+
+ private:
+  Logger &logger_;
+  Level level_;
+  std::unique_ptr<std::ostringstream> stream_;
+};
+
+inline Line debug() {
+  return Line(Logger::global(), Level::Debug);
+}
+inline Line info() {
+  return Line(Logger::global(), Level::Info);
+}
+inline Line warning() {
+  return Line(Logger::global(), Level::Warning);
+}
+inline Line error() {
+  return Line(Logger::global(), Level::Error);
+}
+
+}  // namespace magic_core::log
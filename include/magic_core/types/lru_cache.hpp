@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace magic_core {
+
+/**
+ * @class LruCache
+ * @brief A bounded, thread-safe map that evicts the least recently used entry when full.
+ *
+ * get() and put() are O(1) and both count as a use. Values are copied out, so the cache never
+ * hands out references into storage another thread may evict. A capacity of 0 disables it.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+ public:
+  explicit LruCache(size_t capacity) : capacity_(capacity) {}
+
+  LruCache(const LruCache &) = delete;
+  LruCache &operator=(const LruCache &) = delete;
+
+  std::optional<Value> get(const Key &key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      ++misses_;
+      return std::nullopt;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    ++hits_;
+    return it->second->second;
+  }
+
+  void put(const Key &key, Value value) {
+    if (capacity_ == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      it->second->second = std::move(value);
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return;
+    }
+    entries_.emplace_front(key, std::move(value));
+    index_.emplace(key, entries_.begin());
+    if (entries_.size() > capacity_) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+
+  void erase(const Key &key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      entries_.erase(it->second);
+      index_.erase(it);
+    }
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+  size_t capacity() const {
+    return capacity_;
+  }
+  size_t hits() const {
+    return hits_;
+  }
+  size_t misses() const {
+    return misses_;
+  }
+
+ private:
+  using Entries = std::list<std::pair<Key, Value>>;
+
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  // Most recently used first
+  Entries entries_;
+  std::unordered_map<Key, typename Entries::iterator, Hash> index_;
+  std::atomic<size_t> hits_{0};
+  std::atomic<size_t> misses_{0};
+};
+
+}  // namespace magic_core
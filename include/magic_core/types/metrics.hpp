@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace magic_core::metrics {
+
+// Process-wide counters, gauges and histograms, rendered in the Prometheus text format by
+// /metrics. Registering a metric takes a lock, so call sites keep the reference in a
+// function-local static; updating one afterwards is a few relaxed atomic operations.
+
+class Counter {
+ public:
+  void add(uint64_t n = 1) noexcept {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+  uint64_t value() const noexcept {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> value_{0};
+};
+
+class Gauge {
+ public:
+  void set(double value) noexcept {
+    value_.store(value, std::memory_order_relaxed);
+  }
+  void add(double delta) noexcept {
+    value_.fetch_add(delta, std::memory_order_relaxed);
+  }
+  double value() const noexcept {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<double> value_{0.0};
+};
+
+// Counts observations into fixed buckets. A value falls in the first bucket whose upper bound
+// is >= it; larger ones only count towards +Inf.
+class Histogram {
+ public:
+  struct Snapshot {
+    std::vector<double> bounds;
+    // Cumulative, one per bound
+    std::vector<uint64_t> counts;
+    uint64_t count;
+    double sum;
+  };
+
+  // bounds must be ascending
+  explicit Histogram(std::vector<double> bounds);
+
+  void observe(double value) noexcept;
+  // A scrape racing observe() may see a sum and count one observation apart
+  Snapshot snapshot() const;
+
+ private:
+  const std::vector<double> bounds_;
+  // One per bound, plus one for values above the last
+  std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+  std::atomic<double> sum_{0.0};
+};
+
+// Observes the seconds between its construction and destruction into a histogram
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Histogram &histogram)
+      : histogram_(histogram), started_(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    histogram_.observe(
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count());
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+ private:
+  Histogram &histogram_;
+  std::chrono::steady_clock::time_point started_;
+};
+
+// 100us to 10s, for request and query latencies in seconds
+const std::vector<double> &latency_buckets();
+// Powers of two from 1 to 1024, for batch sizes
+const std::vector<double> &size_buckets();
+
+class Registry {
+ public:
+  // The registry /metrics renders
+  static Registry &global();
+
+  // The metric of that name and label set, created on first use. labels is the inside of the
+  // braces, e.g. status="pending", and empty for none. Asking for an existing name as another
+  // type throws std::invalid_argument.
+  Counter &counter(const std::string &name, const std::string &help,
+                   const std::string &labels = "");
+  Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+  // bounds only apply when the metric is created
+  Histogram &histogram(const std::string &name,
+                       const std::string &help,
+                       const std::vector<double> &bounds = latency_buckets(),
+                       const std::string &labels = "");
+
+  // Every metric, by name and then labels, in the Prometheus text exposition format 0.0.4
+  std::string render() const;
+
+ private:
+  enum class Type { Counter, Gauge, Histogram };
+  struct Family {
+    Type type;
+    std::string help;
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+  };
+
+  Family &family(const std::string &name, const std::string &help, Type type);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Family> families_;
+};
+
+// Shorthands for the global registry
+inline Counter &counter(const std::string &name, const std::string &help,
+                        const std::string &labels = "") {
+  return Registry::global().counter(name, help, labels);
+}
+inline Gauge &gauge(const std::string &name, const std::string &help,
+                    const std::string &labels = "") {
+  return Registry::global().gauge(name, help, labels);
+}
+inline Histogram &histogram(const std::string &name,
+                            const std::string &help,
+                            const std::vector<double> &bounds = latency_buckets(),
+                            const std::string &labels = "") {
+  return Registry::global().histogram(name, help, bounds, labels);
+}
+
+}  // namespace magic_core::metrics
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "magic_core/async/bounded_queue.hpp"
+
+namespace magic_core::trace {
+
+// Request-scoped timing spans. A Trace collects the spans of one request or task; Scope makes it
+// current on a thread and Span times a stage of whatever trace is current. Without one, a Span
+// costs a thread-local load, so stages are instrumented unconditionally and only traced
+// requests pay for the records.
+
+struct SpanRecord {
+  std::string name;
+  uint64_t span_id = 0;
+  // 0 for a root span
+  uint64_t parent_span_id = 0;
+  std::chrono::system_clock::time_point start;
+  std::chrono::nanoseconds duration{0};
+  std::vector<std::pair<std::string, std::string>> attributes;
+};
+
+// 32 lowercase hex digits, random
+std::string new_trace_id();
+// Random and never 0
+uint64_t new_span_id();
+// 16 lowercase hex digits
+std::string format_span_id(uint64_t span_id);
+
+// The trace and parent span of a W3C traceparent header ("00-<trace id>-<span id>-<flags>")
+struct TraceParent {
+  std::string trace_id;
+  uint64_t span_id;
+};
+// nullopt for anything malformed, including the all-zero ids the spec rules out
+std::optional<TraceParent> parse_traceparent(const std::string &header);
+
+class Trace {
+ public:
+  // remote_parent is the caller's span from a traceparent header, 0 for none
+  explicit Trace(std::string trace_id = new_trace_id(), uint64_t remote_parent = 0);
+
+  const std::string &trace_id() const noexcept {
+    return trace_id_;
+  }
+  uint64_t remote_parent() const noexcept {
+    return remote_parent_;
+  }
+
+  // Thread-safe; stages of one trace may run on several threads
+  void record(SpanRecord span);
+  // In the order they ended
+  std::vector<SpanRecord> spans() const;
+
+  // Total milliseconds by span name, first-ended first, in the Server-Timing header syntax:
+  // "search.embed;dur=12.345, ann.files;dur=0.812"
+  std::string server_timing() const;
+  // One OTLP/JSON ExportTraceServiceRequest holding every span, on a single line
+  std::string to_otlp_json(const std::string &service_name) const;
+
+ private:
+  const std::string trace_id_;
+  const uint64_t remote_parent_;
+  mutable std::mutex mutex_;
+  std::vector<SpanRecord> spans_;
+};
+
+// What a Span started on this thread attaches to
+struct Context {
+  Trace *trace = nullptr;
+  uint64_t span_id = 0;
+};
+
+Context current() noexcept;
+
+// Makes a trace, or a context captured on another thread, current until destroyed. The trace
+// must outlive the scope and every span started under it.
+class Scope {
+ public:
+  explicit Scope(Trace &trace) noexcept;
+  explicit Scope(Context context) noexcept;
+  ~Scope();
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+ private:
+  Context previous_;
+};
+
+// Times its lifetime as a child of the current span, when there is a current trace
+class Span {
+ public:
+  explicit Span(const char *name);
+  ~Span();
+
+  Span(const Span &) = delete;
+  Span &operator=(const Span &) = delete;
+
+  void set_attribute(const char *key, std::string value);
+  void set_attribute(const char *key, int64_t value);
+
+ private:
+  Trace *trace_;
+  Context previous_;
+  SpanRecord record_;
+  std::chrono::steady_clock::time_point started_;
+};
+
+// Appends each exported trace to a file as one OTLP/JSON line, the format the OpenTelemetry
+// Collector's otlpjsonfile receiver reads. Writing happens on a background thread; a trace that
+// finds the queue full is dropped.
+class FileExporter {
+ public:
+  static constexpr size_t DEFAULT_QUEUE_DEPTH = 1024;
+
+  // Throws std::runtime_error when path cannot be opened for appending
+  FileExporter(const std::string &path,
+               std::string service_name,
+               size_t queue_depth = DEFAULT_QUEUE_DEPTH);
+  // Writes whatever is still queued
+  ~FileExporter();
+
+  FileExporter(const FileExporter &) = delete;
+  FileExporter &operator=(const FileExporter &) = delete;
+
+  // Never blocks; false when the trace was dropped
+  bool export_trace(const Trace &trace);
+
+ private:
+  void run();
+
+  std::ofstream out_;
+  const std::string service_name_;
+  async::BoundedQueue<std::string> queue_;
+  std::thread writer_;
+};
+
+// The process-wide exporter finished traces go to; null (the default) turns tracing off except
+// for requests that ask for their timing
+void set_exporter(std::shared_ptr<FileExporter> exporter);
+std::shared_ptr<FileExporter> exporter();
+
+}  // namespace magic_core::trace
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace magic_core::vector_math {
+
+// Float32 kernels for embedding-sized vectors. Each call goes to the widest implementation
+// the CPU supports, picked once at first use: AVX2+FMA on x86-64, NEON on aarch64, and a
+// scalar loop otherwise. Results can differ from the scalar loop in the last bits, because the
+// vector kernels sum in a different order.
+
+// "avx2", "neon" or "scalar"
+const char *kernel_name();
+
+// acc[i] += x[i]
+void add(float *acc, const float *x, size_t n);
+// x[i] *= factor
+void scale(float *x, size_t n, float factor);
+float dot(const float *a, const float *b, size_t n);
+// out[r] = dot(query, rows + r * n) for count contiguous rows, as in an exact scan
+void dot_rows(const float *query, const float *rows, size_t count, size_t n, float *out);
+
+// out = the element-wise sum / mean of count vectors of n floats. out may not alias an input.
+void sum(const float *const *vectors, size_t count, size_t n, float *out);
+void mean(const float *const *vectors, size_t count, size_t n, float *out);
+
+// Scales x to unit L2 length; a zero vector is left alone. Returns the length it had.
+float normalize(float *x, size_t n);
+inline float normalize(std::vector<float> &x) {
+  return normalize(x.data(), x.size());
+}
+
+}  // namespace magic_core::vector_math
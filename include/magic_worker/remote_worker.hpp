@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+
+#include "magic_core/db/models/task_dto.hpp"
+#include "magic_core/extractors/content_extractor_factory.hpp"
+#include "magic_core/llm/ollama_client.hpp"
+
+namespace magic_worker {
+
+class RemoteWorkerError : public std::exception {
+ public:
+  explicit RemoteWorkerError(const std::string &message) : message_(message) {}
+
+  const char *what() const noexcept override {
+    return message_.c_str();
+  }
+
+ private:
+  std::string message_;
+};
+
+struct RemoteWorkerOptions {
+  // Where magic_api listens, e.g. "http://127.0.0.1:3030"
+  std::string api_base_url;
+  // Prefix of the lease owners; each thread claims as "<name>-<thread>"
+  std::string name;
+  size_t threads = 1;
+  magic_core::TaskLane lane = magic_core::TaskLane::Any;
+  // The model the client embeds with, sent with every result; the server refuses vectors of
+  // any other model than its active one
+  std::string embedding_model;
+  // Wait between claims while the queue is empty
+  std::chrono::milliseconds idle_poll{2000};
+};
+
+/**
+ * Drains the API server's task queue from another process or machine. Each thread claims one
+ * task at a time over HTTP, extracts and embeds the file here, and uploads the chunks once the
+ * whole file is embedded; the server stores them. Files are read from the same path the server
+ * queued them under, so both must see the same filesystem (a shared mount).
+ *
+ * Progress posts renew the task's lease. A 409 means the server reclaimed the task, and the
+ * thread drops it. A 429 or 503 means the server is overloaded or warming up: the request is
+ * retried with exponential backoff, waiting at least as long as Retry-After asks, for up to
+ * MAX_OVERLOAD_WAIT before it counts as failed.
+ */
+class RemoteWorker {
+ public:
+  RemoteWorker(RemoteWorkerOptions options,
+               std::shared_ptr<magic_core::OllamaClient> ollama_client,
+               std::shared_ptr<magic_core::ContentExtractorFactory> extractor_factory);
+
+  // Blocks until stop_requested is set and every thread has finished its task
+  void run(const std::atomic<bool> &stop_requested);
+
+ private:
+  struct Response {
+    long status = 0;
+    nlohmann::json body;
+  };
+
+  void run_thread(size_t thread_index, const std::atomic<bool> &stop_requested);
+  // Returns false when there was nothing to claim
+  bool process_next_task(CURL *curl, const std::string &worker);
+  // Builds the /result payload for a PROCESS_FILE task; throws RemoteWorkerError on a lost lease
+  nlohmann::json embed_file(CURL *curl,
+                            const std::string &worker,
+                            long long task_id,
+                            const std::string &file_path,
+                            const nlohmann::json &stored_chunk_hashes);
+  void post_progress(CURL *curl,
+                     const std::string &worker,
+                     long long task_id,
+                     float percent,
+                     const std::string &message);
+  // Retries through 429 and 503 answers, see above
+  Response post(CURL *curl, const std::string &endpoint, const nlohmann::json &body);
+  // One attempt; retry_after gets the Retry-After the server sent, if any
+  Response send(CURL *curl,
+                const std::string &endpoint,
+                const std::string &payload,
+                std::chrono::seconds &retry_after);
+
+  static size_t write_callback(void *contents, size_t size, size_t nmemb, std::string *userp);
+
+  // First wait after an overloaded answer; each one after doubles, up to the maximum
+  static constexpr std::chrono::milliseconds OVERLOAD_BACKOFF{250};
+  static constexpr std::chrono::milliseconds MAX_OVERLOAD_BACKOFF{8000};
+  // Well within the server's lease, so a retried renewal still lands in time
+  static constexpr std::chrono::seconds MAX_OVERLOAD_WAIT{30};
+
+  RemoteWorkerOptions options_;
+  std::shared_ptr<magic_core::OllamaClient> ollama_client_;
+  std::shared_ptr<magic_core::ContentExtractorFactory> extractor_factory_;
+  // run()'s flag; a stopping worker gives up on a retry wait
+  const std::atomic<bool> *stop_requested_ = nullptr;
+};
+
+}  // namespace magic_worker
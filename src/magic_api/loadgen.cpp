@@ -0,0 +1,359 @@
+// End-to-end load generator. Builds the API server in process on a throwaway database, with a
+// FakeEmbeddingClient standing in for Ollama, ingests a synthetic corpus through
+// FileProcessingService and the worker pool, then drives concurrent POST /search traffic over
+// loopback HTTP and reports throughput and latency percentiles for both phases.
+//
+// Usage: magic_loadgen [--config magicrc.json] [--files 500] [--workers N] [--clients 8]
+//                      [--requests 200] [--queries 1000] [--top-k 10] [--port 18080]
+//                      [--embed-latency-ms 20] [--per-text-latency-ms 2]
+//
+// Pool sizes, index type and search settings come from --config (defaults without one), so a
+// production config can be sized before rollout; --workers overrides its num_workers.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "magic_api/config.hpp"
+#include "magic_api/routes.hpp"
+#include "magic_api/server.hpp"
+#include "magic_core/async/bounded_executor.hpp"
+#include "magic_core/async/in_flight_limiter.hpp"
+#include "magic_core/async/service_provider.hpp"
+#include "magic_core/async/worker_pool.hpp"
+#include "magic_core/db/database_manager.hpp"
+#include "magic_core/db/embedding_cache.hpp"
+#include "magic_core/db/metadata_store.hpp"
+#include "magic_core/db/task_queue_repo.hpp"
+#include "magic_core/extractors/content_extractor_factory.hpp"
+#include "magic_core/llm/fake_embedding_client.hpp"
+#include "magic_core/llm/http_client.hpp"
+#include "magic_core/services/file_delete_service.hpp"
+#include "magic_core/services/file_info_service.hpp"
+#include "magic_core/services/file_processing_service.hpp"
+#include "magic_core/services/remote_task_service.hpp"
+#include "magic_core/services/search_service.hpp"
+#include "magic_core/types/logger.hpp"
+
+namespace {
+
+struct Options {
+  std::string config_path;
+  int files = 500;
+  int workers = 0;
+  int clients = 8;
+  int requests = 200;
+  int queries = 1000;
+  int top_k = 10;
+  int port = 18080;
+  int embed_latency_ms = 20;
+  int per_text_latency_ms = 2;
+};
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string flag = argv[i];
+    if (i + 1 >= argc) {
+      throw std::invalid_argument("Missing value for " + flag);
+    }
+    const std::string value = argv[++i];
+    if (flag == "--config") {
+      options.config_path = value;
+      continue;
+    }
+    const int number = std::stoi(value);
+    if (flag == "--files") {
+      options.files = number;
+    } else if (flag == "--workers") {
+      options.workers = number;
+    } else if (flag == "--clients") {
+      options.clients = number;
+    } else if (flag == "--requests") {
+      options.requests = number;
+    } else if (flag == "--queries") {
+      options.queries = number;
+    } else if (flag == "--top-k") {
+      options.top_k = number;
+    } else if (flag == "--port") {
+      options.port = number;
+    } else if (flag == "--embed-latency-ms") {
+      options.embed_latency_ms = number;
+    } else if (flag == "--per-text-latency-ms") {
+      options.per_text_latency_ms = number;
+    } else {
+      throw std::invalid_argument("Unknown option " + flag);
+    }
+  }
+  if (options.files <= 0 || options.clients <= 0 || options.requests <= 0 ||
+      options.queries <= 0) {
+    throw std::invalid_argument("--files, --clients, --requests and --queries must be positive");
+  }
+  return options;
+}
+
+// Pronounceable synthetic words, so chunks and queries tokenize like prose
+std::vector<std::string> make_vocabulary(size_t size) {
+  static const char* const syllables[] = {"ka", "lo", "mi", "ten", "sar", "vo",  "ri", "dun",
+                                          "pe", "zu", "hal", "for", "ne", "qui", "bo", "strel"};
+  std::vector<std::string> words;
+  for (size_t i = 0; words.size() < size; ++i) {
+    std::string word;
+    for (size_t n = i + 16; n > 0; n /= 16) {
+      word += syllables[n % 16];
+    }
+    words.push_back(word);
+  }
+  return words;
+}
+
+// Each file draws most of its words from one of 64 topics, so a query built from a topic has a
+// known set of relevant files
+std::vector<std::string> topic_words(const std::vector<std::string>& vocabulary, int topic) {
+  std::vector<std::string> words;
+  for (size_t i = 0; i < 24; ++i) {
+    words.push_back(vocabulary[(static_cast<size_t>(topic) * 24 + i) % vocabulary.size()]);
+  }
+  return words;
+}
+
+void write_corpus(const std::filesystem::path& root, int files,
+                  const std::vector<std::string>& vocabulary) {
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<size_t> any_word(0, vocabulary.size() - 1);
+  std::uniform_int_distribution<int> paragraphs(4, 24);
+  for (int f = 0; f < files; ++f) {
+    const auto topic = topic_words(vocabulary, f % 64);
+    std::uniform_int_distribution<size_t> topic_word(0, topic.size() - 1);
+    const bool markdown = f % 2 == 0;
+    std::ofstream out(root / ("doc_" + std::to_string(f) + (markdown ? ".md" : ".txt")));
+    const int count = paragraphs(rng);
+    for (int p = 0; p < count; ++p) {
+      if (markdown && p % 4 == 0) {
+        out << "## " << topic[topic_word(rng)] << " " << topic[topic_word(rng)] << "\n\n";
+      }
+      for (int w = 0; w < 80; ++w) {
+        out << (rng() % 4 == 0 ? vocabulary[any_word(rng)] : topic[topic_word(rng)])
+            << (w % 12 == 11 ? ". " : " ");
+      }
+      out << "\n\n";
+    }
+  }
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size() - 1) + 0.5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+void report_latency(const std::string& name, std::vector<double> millis, size_t errors,
+                    double seconds) {
+  std::sort(millis.begin(), millis.end());
+  std::printf("%-8s %8zu ok %6zu errors %10.1f req/s   "
+              "p50 %8.2f  p90 %8.2f  p99 %8.2f  max %8.2f ms\n",
+              name.c_str(), millis.size(), errors, millis.size() / seconds,
+              percentile(millis, 50), percentile(millis, 90), percentile(millis, 99),
+              millis.empty() ? 0.0 : millis.back());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  namespace fs = std::filesystem;
+  using clock = std::chrono::steady_clock;
+  try {
+    const Options options = parse_options(argc, argv);
+    Config config = options.config_path.empty() ? Config::from_json(nlohmann::json::object())
+                                                : Config::from_file(options.config_path);
+    if (options.workers > 0) {
+      config.num_workers = options.workers;
+      config.max_workers = std::max(config.max_workers, options.workers);
+    }
+    // Per-request info lines would dominate the run
+    magic_core::log::Logger::global().set_level(magic_core::log::Level::Warning);
+
+    const fs::path root =
+        fs::temp_directory_path() /
+        ("magic_loadgen_" + std::to_string(clock::now().time_since_epoch().count()));
+    const fs::path corpus = root / "corpus";
+    fs::create_directories(corpus);
+    const auto vocabulary = make_vocabulary(2048);
+    write_corpus(corpus, options.files, vocabulary);
+
+    magic_core::FakeEmbeddingOptions embed_options;
+    embed_options.request_latency = std::chrono::milliseconds(options.embed_latency_ms);
+    embed_options.per_text_latency = std::chrono::milliseconds(options.per_text_latency_ms);
+    auto embedder = std::make_shared<magic_core::FakeEmbeddingClient>(embed_options);
+
+    auto& db_manager = magic_core::DatabaseManager::get_instance();
+    db_manager.initialize(root / "metadata.db", "magic_loadgen_key", /*pool_size*/ 1,
+                          config.http_threads + config.search_threads + config.ingest_threads +
+                              std::max(config.max_workers, config.num_workers),
+                          magic_core::parse_vector_encoding(config.vector_store_encoding));
+    magic_core::VectorIndexOptions index_options;
+    index_options.type = magic_core::parse_vector_index_type(config.vector_index_type);
+    index_options.metric = magic_core::parse_vector_metric(config.vector_index_metric);
+    index_options.hnsw_m = config.vector_index_hnsw_m;
+    index_options.ef_construction = config.vector_index_ef_construction;
+    index_options.ef_search = config.vector_index_ef_search;
+    index_options.ivf_lists = config.vector_index_ivf_lists;
+    index_options.pq_subquantizers = config.vector_index_pq_subquantizers;
+    index_options.nprobe = config.vector_index_nprobe;
+    auto metadata_store = std::make_shared<magic_core::MetadataStore>(
+        db_manager, fs::path{}, index_options,
+        static_cast<size_t>(config.search_chunk_slab_cache_mb) * 1024 * 1024);
+    auto task_queue_repo = std::make_shared<magic_core::TaskQueueRepo>(db_manager);
+    auto extractor_factory = std::make_shared<magic_core::ContentExtractorFactory>();
+    auto file_processing_service = std::make_shared<magic_core::FileProcessingService>(
+        metadata_store, task_queue_repo, extractor_factory, embedder);
+    magic_core::SearchPlan search_plan;
+    search_plan.file_shortlist = config.search_file_shortlist;
+    search_plan.exact_chunk_scan = config.search_exact_chunk_scan;
+    auto search_service = std::make_shared<magic_core::SearchService>(
+        metadata_store, embedder, nullptr, static_cast<size_t>(config.search_query_cache_entries),
+        static_cast<size_t>(config.search_result_cache_entries), search_plan);
+    auto embedding_cache = std::make_shared<magic_core::EmbeddingCache>(
+        db_manager, config.embedding_model, magic_core::EmbeddingCache::DEFAULT_MEMORY_ENTRIES,
+        static_cast<size_t>(config.embedding_cache_near_duplicate_entries),
+        config.embedding_cache_near_duplicate_distance);
+    auto services = std::make_shared<magic_core::ServiceProvider>(
+        metadata_store, task_queue_repo, embedder, extractor_factory, embedding_cache);
+    magic_core::async::WorkerPoolOptions pool_options;
+    pool_options.min_workers = static_cast<size_t>(config.num_workers);
+    pool_options.max_workers = static_cast<size_t>(config.max_workers);
+    pool_options.interactive_workers = static_cast<size_t>(config.interactive_workers);
+    pool_options.bulk_workers = static_cast<size_t>(config.bulk_workers);
+    auto worker_pool = std::make_shared<magic_core::async::WorkerPool>(pool_options, services);
+
+    // Ingest: walk, hash and queue the corpus, then let the pool drain the queue
+    std::printf("Ingesting %d files with %d workers (embed %d ms + %d ms/text)...\n",
+                options.files, config.num_workers, options.embed_latency_ms,
+                options.per_text_latency_ms);
+    const auto ingest_started = clock::now();
+    const auto queued = file_processing_service->request_directory_processing(corpus);
+    worker_pool->start();
+    while (task_queue_repo->count_tasks_by_status(magic_core::TaskStatus::PENDING) +
+               task_queue_repo->count_tasks_by_status(magic_core::TaskStatus::PROCESSING) >
+           0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    const double ingest_seconds =
+        std::chrono::duration<double>(clock::now() - ingest_started).count();
+    const size_t failed = task_queue_repo->count_tasks_by_status(magic_core::TaskStatus::FAILED);
+    const int64_t chunks = metadata_store->count_chunks();
+    std::printf("ingest   %8zu files %6zu failed %10.1f files/s %10.1f chunks/s   %zu embed "
+                "requests, %.1f s\n",
+                queued.task_ids.size(), failed, queued.task_ids.size() / ingest_seconds,
+                chunks / ingest_seconds, embedder->requests(), ingest_seconds);
+
+    // Search: the real routes behind Crow, hit over keep-alive loopback connections
+    magic_api::Server server("127.0.0.1", options.port, config.http_threads);
+    auto search_executor = std::make_shared<magic_core::async::BoundedExecutor>(
+        "search", static_cast<size_t>(config.search_threads),
+        static_cast<size_t>(config.search_queue_depth));
+    auto ingest_executor = std::make_shared<magic_core::async::BoundedExecutor>(
+        "ingest", static_cast<size_t>(config.ingest_threads),
+        static_cast<size_t>(config.ingest_queue_depth));
+    magic_api::Routes routes(file_processing_service,
+                             std::make_shared<magic_core::FileDeleteService>(metadata_store),
+                             std::make_shared<magic_core::FileInfoService>(metadata_store),
+                             search_service, task_queue_repo,
+                             std::make_shared<magic_core::RemoteTaskService>(metadata_store,
+                                                                             task_queue_repo),
+                             search_executor, ingest_executor,
+                             std::make_shared<magic_core::async::InFlightLimiter>(
+                                 static_cast<size_t>(config.remote_worker_max_in_flight)));
+    routes.register_routes(server);
+    server.get_app().signal_clear();
+    server.start();
+
+    magic_core::HttpClientOptions http_options;
+    http_options.max_connections = options.clients;
+    magic_core::HttpClient http("http://127.0.0.1:" + std::to_string(options.port),
+                                http_options);
+    for (int attempt = 0;; ++attempt) {
+      try {
+        if (http.request("GET", "/").status == 200) {
+          break;
+        }
+      } catch (const magic_core::HttpError&) {
+        if (attempt == 100) {
+          throw;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    std::vector<std::string> queries;
+    std::mt19937 rng(99);
+    for (int q = 0; q < options.queries; ++q) {
+      const auto topic = topic_words(vocabulary, static_cast<int>(rng() % 64));
+      queries.push_back(topic[rng() % topic.size()] + " " + topic[rng() % topic.size()] + " " +
+                        topic[rng() % topic.size()]);
+    }
+
+    std::printf("Searching with %d clients, %d requests each, %d distinct queries...\n",
+                options.clients, options.requests, options.queries);
+    std::vector<std::vector<double>> latencies(static_cast<size_t>(options.clients));
+    std::vector<size_t> errors(static_cast<size_t>(options.clients), 0);
+    std::vector<std::thread> clients;
+    const auto search_started = clock::now();
+    for (int c = 0; c < options.clients; ++c) {
+      clients.emplace_back([&, c] {
+        std::mt19937 pick(static_cast<uint32_t>(c));
+        for (int r = 0; r < options.requests; ++r) {
+          const nlohmann::json body = {{"query", queries[pick() % queries.size()]},
+                                       {"top_k", options.top_k}};
+          const auto sent = clock::now();
+          try {
+            if (http.request("POST", "/search", body.dump()).status == 200) {
+              latencies[c].push_back(
+                  std::chrono::duration<double, std::milli>(clock::now() - sent).count());
+              continue;
+            }
+          } catch (const magic_core::HttpError&) {
+          }
+          ++errors[c];
+        }
+      });
+    }
+    for (auto& client : clients) {
+      client.join();
+    }
+    const double search_seconds =
+        std::chrono::duration<double>(clock::now() - search_started).count();
+    std::vector<double> all_latencies;
+    size_t all_errors = 0;
+    for (int c = 0; c < options.clients; ++c) {
+      all_latencies.insert(all_latencies.end(), latencies[c].begin(), latencies[c].end());
+      all_errors += errors[c];
+    }
+    report_latency("search", std::move(all_latencies), all_errors, search_seconds);
+
+    search_executor->shutdown();
+    ingest_executor->shutdown();
+    server.stop();
+    worker_pool->stop();
+    db_manager.shutdown();
+    magic_core::log::Logger::global().flush();
+    fs::remove_all(root);
+  } catch (const std::exception& e) {
+    std::cerr << "magic_loadgen: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -1,22 +1,47 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <filesystem>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <vector>
 
 #include "magic_api/config.hpp"
 #include "magic_api/routes.hpp"
 #include "magic_api/server.hpp"
+#include "magic_core/async/bounded_executor.hpp"
+#include "magic_core/async/in_flight_limiter.hpp"
+#include "magic_core/async/memory_budget.hpp"
+#include "magic_core/async/readiness.hpp"
 #include "magic_core/async/service_provider.hpp"
 #include "magic_core/async/worker_pool.hpp"
 #include "magic_core/db/database_manager.hpp"
+#include "magic_core/db/embedding_cache.hpp"
+#include "magic_core/db/embedding_model_registry.hpp"
+#include "magic_core/db/faiss_gpu.hpp"
 #include "magic_core/db/metadata_store.hpp"
+#include "magic_core/db/shard_map.hpp"
+#include "magic_core/db/sharded_metadata_store.hpp"
 #include "magic_core/db/task_queue_repo.hpp"
 #include "magic_core/extractors/content_extractor_factory.hpp"
+#include "magic_core/extractors/tokenizer.hpp"
+#include "magic_core/llm/model_switching_client.hpp"
 #include "magic_core/llm/ollama_client.hpp"
+#include "magic_core/llm/rerank_client.hpp"
+#include "magic_core/services/compression_service.hpp"
 #include "magic_core/services/encryption_key_service.hpp"
 #include "magic_core/services/file_delete_service.hpp"
 #include "magic_core/services/file_info_service.hpp"
 #include "magic_core/services/file_processing_service.hpp"
+#include "magic_core/services/file_watcher_service.hpp"
+#include "magic_core/services/index_maintenance_service.hpp"
+#include "magic_core/services/remote_task_service.hpp"
 #include "magic_core/services/search_service.hpp"
+#include "magic_core/types/logger.hpp"
+#include "magic_core/types/trace.hpp"
 
 std::atomic<bool> shutdown_requested = false;
 std::mutex shutdown_mutex;
@@ -24,6 +49,7 @@ std::condition_variable shutdown_cv;
 
 // The signal handler function
 void signal_handler(int signal) {
+  // Not through the logger: its lock is not safe to take in a signal handler
   std::cout << "\nShutdown signal (" << signal << ") received. Initiating graceful shutdown..."
             << std::endl;
   shutdown_requested = true;
@@ -32,73 +58,472 @@ void signal_handler(int signal) {
 int main() {
   try {
     Config config = Config::from_file("magicrc.json");
+    magic_core::log::Logger::global().set_level(magic_core::log::parse_level(config.log_level));
+    if (!config.tracing_export_path.empty()) {
+      magic_core::trace::set_exporter(std::make_shared<magic_core::trace::FileExporter>(
+          config.tracing_export_path, "magic_api"));
+    }
 
     std::string server_url = config.api_base_url;
     std::string metadata_path = config.metadata_db_path;
     std::string ollama_server_url = config.ollama_url;
     std::string model = config.embedding_model;
     std::string db_key = magic_core::EncryptionKeyService::get_database_key();
-    std::cout << "Starting Magic Folder API Server..." << std::endl;
-    std::cout << "Server URL: " << server_url << std::endl;
-    std::cout << "Metadata DB Path: " << metadata_path << std::endl;
-    std::cout << "Ollama URL: " << ollama_server_url << std::endl;
-    std::cout << "Embedding Model: " << model << std::endl;
+    magic_core::log::info() << "Starting Magic Folder API Server...";
+    magic_core::log::info() << "Server URL: " << server_url;
+    magic_core::log::info() << "Metadata DB Path: " << metadata_path;
+    magic_core::log::info() << "Ollama URL: " << ollama_server_url;
+    if (config.embedding_endpoints.size() > 1) {
+      magic_core::log::info() << "Embedding endpoints: " << config.embedding_endpoints.size();
+    }
 
     // Initialize core components
-    auto ollama_client = std::make_shared<magic_core::OllamaClient>(ollama_server_url, model);
     auto& db_manager = magic_core::DatabaseManager::get_instance();
-    db_manager.initialize(metadata_path, db_key, /*pool_size*/ config.num_workers);
-    auto metadata_store = std::make_shared<magic_core::MetadataStore>(db_manager);
+    // Every write goes through the writer thread, so the read-write pool only serves startup
+    // maintenance. Workers read too (embedding cache, file lookups), so the read pool has a
+    // connection for every HTTP, search and ingest thread and every worker the pool can grow
+    // to, and nobody waits for one. Only database.min_connections of them open at startup; the
+    // rest open as the load first needs them.
+    magic_core::ConnectionOptions connections;
+    connections.cipher.raw_key = config.database_raw_key;
+    connections.cipher.kdf_iter = config.database_kdf_iter;
+    connections.cipher.cipher_page_size = config.database_cipher_page_size;
+    connections.min_pool_size = config.database_min_connections;
+    const int read_pool_size = config.http_threads + config.search_threads +
+                               config.ingest_threads + config.max_workers;
+    const magic_core::VectorEncoding vector_encoding =
+        magic_core::parse_vector_encoding(config.vector_store_encoding);
+    // Every other shard is a database of its own beside the first, handing out ids from its
+    // own range. The task queue and embedding cache stay in the first.
+    // Collections are shards of their own, picked by root, with everything else in "default"
+    magic_core::ShardMap shard_map(static_cast<size_t>(config.database_shards),
+                                   magic_core::parse_sharding_strategy(config.database_shard_by),
+                                   config.database_shard_roots);
+    if (!config.collections.empty()) {
+      std::vector<magic_core::Collection> collections;
+      for (const auto& [name, root] : config.collections) {
+        collections.push_back({name, root});
+      }
+      shard_map = magic_core::ShardMap::for_collections(collections);
+    }
+    const size_t shard_count = shard_map.shard_count();
+    std::vector<std::unique_ptr<magic_core::DatabaseManager>> shard_managers;
+    std::vector<magic_core::DatabaseManager*> shard_dbs{&db_manager};
+    // Each database derives its key and migrates on its own, so the shards open alongside the
+    // first
+    std::vector<std::future<void>> shards_opening;
+    for (size_t i = 1; i < shard_count; ++i) {
+      auto shard = magic_core::DatabaseManager::create();
+      shards_opening.push_back(std::async(std::launch::async, [&, i, db = shard.get()] {
+        db->initialize(magic_core::ShardMap::shard_db_path(metadata_path, i), db_key,
+                       /*pool_size*/ 1, read_pool_size, vector_encoding, connections);
+        db->reserve_row_ids(magic_core::ShardMap::first_id(i),
+                            magic_core::ShardMap::last_id(i));
+      }));
+      shard_dbs.push_back(shard.get());
+      shard_managers.push_back(std::move(shard));
+    }
+    db_manager.initialize(metadata_path, db_key, /*pool_size*/ 1, read_pool_size,
+                          vector_encoding, connections);
+    // Alone, the first database has every id to itself
+    db_manager.reserve_row_ids(magic_core::ShardMap::first_id(0),
+                               shard_count > 1 ? magic_core::ShardMap::last_id(0)
+                                               : std::numeric_limits<int32_t>::max());
+    for (auto& opening : shards_opening) {
+      opening.get();
+    }
+    if (shard_map.has_collections()) {
+      for (size_t i = 0; i < shard_count; ++i) {
+        const std::string root = shard_map.collection_root(i);
+        magic_core::log::info() << "Collection " << shard_map.collection_name(i) << ": "
+                                << (root.empty() ? "files under no other root" : root);
+      }
+    } else if (shard_count > 1) {
+      magic_core::log::info() << "Metadata shards: " << shard_count << " (by "
+                              << config.database_shard_by << ")";
+    }
+    // Queries have to be embedded with the model the stored vectors came from. A database from
+    // before the registry holds vectors of the dimension its segment files record.
+    magic_core::EmbeddingModelRegistry model_registry(db_manager);
+    const int stored_dimension = magic_core::VectorStore::stored_dimension(
+        magic_core::DatabaseManager::vector_store_path(metadata_path, "chunks"));
+    // A model the database has no vectors of yet is registered with the length of what the
+    // endpoints return for it; embedding_dimension is only the fallback when they cannot say
+    std::optional<int> probed_dimension;
+    auto dimension_of_configured_model = [&]() {
+      if (!probed_dimension) {
+        probed_dimension = config.embedding_dimension;
+        try {
+          magic_core::OllamaClient probe(config.embedding_endpoints, model);
+          const size_t length = probe.get_embedding("dimension probe").size();
+          if (length > 0) {
+            probed_dimension = static_cast<int>(length);
+          }
+        } catch (const std::exception& e) {
+          magic_core::log::warning() << "Could not ask the embedding endpoints for the dimension "
+                                     << "of " << model << " (" << e.what()
+                                     << "); using embedding_dimension "
+                                     << config.embedding_dimension;
+        }
+        if (*probed_dimension != config.embedding_dimension) {
+          magic_core::log::info() << model << " embeds to " << *probed_dimension
+                                  << " dimensions (embedding_dimension is "
+                                  << config.embedding_dimension << ")";
+        }
+      }
+      return *probed_dimension;
+    };
+    std::optional<magic_core::EmbeddingModel> registered = model_registry.active();
+    magic_core::EmbeddingModel active_model =
+        registered ? *registered
+                   : model_registry.ensure_active(model, stored_dimension > 0
+                                                             ? stored_dimension
+                                                             : dimension_of_configured_model());
+    // A newly configured model is moved to in the background; searches keep using the active
+    // one until its vectors are all re-embedded
+    bool reembed = false;
+    if (active_model.name != model) {
+      try {
+        model_registry.register_model(model, dimension_of_configured_model());
+        reembed = true;
+        magic_core::log::info() << "embedding_model is " << model
+                                << " but the stored vectors come from " << active_model.name
+                                << "; embedding with " << active_model.name
+                                << " until they are re-embedded";
+      } catch (const magic_core::EmbeddingModelRegistryError& e) {
+        magic_core::log::warning() << "Cannot re-embed with " << model << ": " << e.what()
+                                   << "; embedding with " << active_model.name;
+      }
+    }
+    // A new shard starts on the first one's model. One still on another model than the
+    // configured one (e.g. a re-embed stopped between the shards' swaps) is re-embedded too.
+    for (size_t i = 1; i < shard_count; ++i) {
+      magic_core::EmbeddingModelRegistry shard_registry(*shard_dbs[i]);
+      if (shard_registry.ensure_active(active_model.name, active_model.dimension).name != model) {
+        try {
+          shard_registry.register_model(model, dimension_of_configured_model());
+          reembed = true;
+        } catch (const magic_core::EmbeddingModelRegistryError& e) {
+          magic_core::log::warning() << "Cannot re-embed shard " << i << " with " << model
+                                     << ": " << e.what();
+        }
+      }
+    }
+    const std::string target_model = model;
+    model = active_model.name;
+    magic_core::log::info() << "Embedding Model: " << model << " (" << active_model.dimension
+                            << " dimensions)";
+    // Probing the endpoints overlaps opening the stores
+    auto embedding_client_probe = std::async(std::launch::async, [&config, model] {
+      return std::make_shared<magic_core::OllamaClient>(config.embedding_endpoints, model);
+    });
+    magic_core::VectorIndexOptions index_options;
+    index_options.type = magic_core::parse_vector_index_type(config.vector_index_type);
+    index_options.metric = magic_core::parse_vector_metric(config.vector_index_metric);
+    index_options.hnsw_m = config.vector_index_hnsw_m;
+    index_options.ef_construction = config.vector_index_ef_construction;
+    index_options.ef_search = config.vector_index_ef_search;
+    index_options.ivf_lists = config.vector_index_ivf_lists;
+    index_options.pq_subquantizers = config.vector_index_pq_subquantizers;
+    index_options.nprobe = config.vector_index_nprobe;
+    index_options.gpu_device = config.vector_index_gpu_device;
+    index_options.gpu_min_batch = static_cast<size_t>(config.vector_index_gpu_min_batch);
+    if (index_options.gpu_device >= 0) {
+      if (!magic_core::faiss_gpu::compiled_in()) {
+        magic_core::log::warning() << "vector_index.gpu_device is set but this build has no "
+                                      "faiss GPU support (MAGIC_FAISS_GPU); indexing on the CPU";
+        index_options.gpu_device = -1;
+      } else if (index_options.gpu_device >= magic_core::faiss_gpu::device_count()) {
+        magic_core::log::warning() << "No CUDA device " << index_options.gpu_device << " ("
+                                   << magic_core::faiss_gpu::device_count()
+                                   << " found); indexing on the CPU";
+        index_options.gpu_device = -1;
+      } else {
+        magic_core::log::info() << "Vector index GPU: device " << index_options.gpu_device;
+      }
+    }
+    magic_core::log::info() << "Vector index: " << config.vector_index_type;
+    // Index snapshots live next to each database so restarts can skip the rebuilds. The chunk
+    // slab cache budget is split between the shards. The indexes load once the server is up.
+    std::vector<std::shared_ptr<magic_core::MetadataStore>> shard_stores;
+    for (size_t i = 0; i < shard_count; ++i) {
+      std::filesystem::path index_path = magic_core::ShardMap::shard_db_path(metadata_path, i);
+      index_path.replace_extension(".faiss");
+      shard_stores.push_back(std::make_shared<magic_core::MetadataStore>(
+          *shard_dbs[i], index_path, index_options,
+          static_cast<size_t>(config.search_chunk_slab_cache_mb) * 1024 * 1024 / shard_count,
+          magic_core::MetadataStore::IndexLoading::Deferred));
+    }
+    std::shared_ptr<magic_core::OllamaClient> embedding_client = embedding_client_probe.get();
+    // Everything embeds through this one, so a finished re-embed switches them all at once
+    auto ollama_client =
+        std::make_shared<magic_core::ModelSwitchingClient>(embedding_client, model);
+    auto metadata_store =
+        std::make_shared<magic_core::ShardedMetadataStore>(std::move(shard_map), shard_stores);
     auto task_queue_repo = std::make_shared<magic_core::TaskQueueRepo>(db_manager);
-    auto content_extractor_factory = std::make_shared<magic_core::ContentExtractorFactory>();
+    if (reembed) {
+      bool queued = false;
+      for (auto status : {magic_core::TaskStatus::PENDING, magic_core::TaskStatus::PROCESSING}) {
+        for (const auto& task : task_queue_repo->get_tasks_by_status(status)) {
+          queued = queued || (task.task_type == "REEMBED" && task.target_tag == target_model);
+        }
+      }
+      if (!queued) {
+        long long task_id = task_queue_repo->create_tagged_task("REEMBED", target_model,
+                                                                magic_core::TaskPriority::BULK);
+        magic_core::log::info() << "Queued re-embedding with " << target_model << " as task "
+                                << task_id;
+      }
+    }
+    // Chunks decode with the dictionary they were written with; the newest compresses new ones
+    auto dictionaries = metadata_store->get_compression_dictionaries();
+    for (const auto& dictionary : dictionaries) {
+      magic_core::CompressionService::register_dictionary(dictionary.dictionary);
+    }
+    if (!dictionaries.empty()) {
+      magic_core::log::info() << "Compression dictionaries: " << dictionaries.size()
+                              << " (active "
+                              << magic_core::CompressionService::active_dictionary_id() << ")";
+    }
+    // One vocab for every extractor and worker
+    std::shared_ptr<const magic_core::Tokenizer> tokenizer;
+    if (!config.tokenizer_vocab_path.empty()) {
+      auto wordpiece = magic_core::WordPieceTokenizer::load(config.tokenizer_vocab_path,
+                                                            config.tokenizer_lowercase);
+      magic_core::log::info() << "Tokenizer: WordPiece, " << wordpiece->vocab_size() << " tokens";
+      tokenizer = wordpiece;
+    }
+    auto content_extractor_factory =
+        std::make_shared<magic_core::ContentExtractorFactory>(tokenizer);
 
     auto file_processing_service = std::make_shared<magic_core::FileProcessingService>(
         metadata_store, task_queue_repo, content_extractor_factory, ollama_client);
     auto file_delete_service = std::make_shared<magic_core::FileDeleteService>(metadata_store);
     auto file_info_service = std::make_shared<magic_core::FileInfoService>(metadata_store);
-    auto search_service =
-        std::make_shared<magic_core::SearchService>(metadata_store, ollama_client);
+    magic_core::SearchPlan search_plan;
+    search_plan.file_shortlist = config.search_file_shortlist;
+    search_plan.exact_chunk_scan = config.search_exact_chunk_scan;
+    std::shared_ptr<magic_core::RerankClient> reranker;
+    magic_core::RerankOptions rerank;
+    if (!config.rerank_url.empty()) {
+      rerank.candidates = config.rerank_candidates;
+      rerank.batch_size = static_cast<size_t>(config.rerank_batch_size);
+      rerank.budget = std::chrono::milliseconds(config.rerank_budget_ms);
+      // Scores past the budget are thrown away, so curl drops the request then instead of
+      // holding a connection later searches need
+      magic_core::HttpClientOptions rerank_http;
+      rerank_http.request_timeout = rerank.budget;
+      rerank_http.connect_timeout = std::min(rerank_http.connect_timeout, rerank.budget);
+      reranker = std::make_shared<magic_core::RerankClient>(config.rerank_url, config.rerank_model,
+                                                            rerank_http);
+      rerank.max_chars = static_cast<size_t>(config.rerank_max_chars);
+      magic_core::log::info() << "Re-ranking the top " << rerank.candidates << " chunks with "
+                              << config.rerank_url;
+    }
+    auto search_service = std::make_shared<magic_core::SearchService>(
+        metadata_store, ollama_client, nullptr,
+        static_cast<size_t>(config.search_query_cache_entries),
+        static_cast<size_t>(config.search_result_cache_entries), search_plan, reranker, rerank);
+    auto embedding_cache = std::make_shared<magic_core::EmbeddingCache>(
+        db_manager, model, magic_core::EmbeddingCache::DEFAULT_MEMORY_ENTRIES,
+        static_cast<size_t>(config.embedding_cache_near_duplicate_entries),
+        config.embedding_cache_near_duplicate_distance);
     auto services = std::make_shared<magic_core::ServiceProvider>(
-        metadata_store, task_queue_repo, ollama_client, content_extractor_factory);
-    auto worker_pool =
-        std::make_shared<magic_core::async::WorkerPool>(config.num_workers, services);
+        metadata_store, task_queue_repo, ollama_client, content_extractor_factory, embedding_cache);
+    magic_core::EmbeddingModelHooks model_hooks;
+    model_hooks.client_for = [endpoints = config.embedding_endpoints](const std::string& name) {
+      return std::make_shared<magic_core::OllamaClient>(endpoints, name);
+    };
+    model_hooks.cache_for = [&db_manager](const std::string& name) {
+      return std::make_shared<magic_core::EmbeddingCache>(db_manager, name);
+    };
+    model_hooks.activate = [ollama_client, embedding_cache](
+                               const std::string& name,
+                               std::shared_ptr<magic_core::OllamaClient> client) {
+      ollama_client->switch_to(std::move(client), name);
+      embedding_cache->set_model(name);
+      magic_core::log::info() << "Embedding Model: " << name;
+    };
+    services->set_embedding_model_hooks(std::move(model_hooks));
+    if (!config.generation_model.empty()) {
+      // Answers take far longer than embeddings, hence a timeout of their own
+      magic_core::HttpClientOptions generation_http;
+      generation_http.request_timeout = std::chrono::seconds(config.generation_request_timeout_s);
+      magic_core::GenerationSettings generation;
+      generation.client = std::make_shared<magic_core::OllamaClient>(
+          config.generation_endpoints, config.generation_model, generation_http);
+      generation.max_input_chars = static_cast<size_t>(config.generation_max_input_chars);
+      services->set_generation_settings(std::move(generation));
+      magic_core::log::info() << "Generation Model: " << config.generation_model << " ("
+                              << config.generation_workers << " workers)";
+    }
+    if (config.worker_memory_budget_mb > 0) {
+      services->set_memory_budget(std::make_shared<magic_core::async::MemoryBudget>(
+          static_cast<size_t>(config.worker_memory_budget_mb) << 20));
+      magic_core::log::info() << "Worker memory budget: " << config.worker_memory_budget_mb
+                              << " MB";
+    }
+    magic_core::SnapshotOptions snapshot_options;
+    snapshot_options.pages_per_step = config.snapshot_pages_per_step;
+    snapshot_options.max_bytes_per_second = static_cast<size_t>(config.snapshot_max_mb_per_s)
+                                            << 20;
+    services->set_snapshot_options(snapshot_options);
+    magic_core::async::WorkerPoolOptions pool_options;
+    pool_options.min_workers = static_cast<size_t>(config.num_workers);
+    pool_options.max_workers = static_cast<size_t>(config.max_workers);
+    pool_options.interactive_workers = static_cast<size_t>(config.interactive_workers);
+    pool_options.bulk_workers = static_cast<size_t>(config.bulk_workers);
+    if (!config.generation_model.empty()) {
+      pool_options.generation_workers = static_cast<size_t>(config.generation_workers);
+    }
+    auto worker_pool = std::make_shared<magic_core::async::WorkerPool>(pool_options, services);
+    std::unique_ptr<magic_core::FileWatcherService> file_watcher;
+    if (config.watch_enabled) {
+      std::filesystem::create_directories(config.watch_inbox_root);
+      magic_core::FileWatcherOptions watch_options;
+      watch_options.settle = std::chrono::milliseconds(config.watch_settle_ms);
+      watch_options.recursive = config.watch_recursive;
+      watch_options.ignore = config.watch_ignore;
+      file_watcher = std::make_unique<magic_core::FileWatcherService>(
+          file_processing_service, file_delete_service,
+          std::vector<std::filesystem::path>{config.watch_inbox_root}, watch_options);
+    }
+    // Each shard rebuilds, snapshots and vacuums its own indexes and database
+    std::vector<std::unique_ptr<magic_core::background::IndexMaintenanceService>>
+        index_maintenance;
+    for (size_t i = 0; i < shard_count; ++i) {
+      index_maintenance.push_back(
+          std::make_unique<magic_core::background::IndexMaintenanceService>(
+              shard_stores[i], task_queue_repo, *shard_dbs[i]));
+    }
     std::string host = server_url.substr(0, server_url.find(':'));
     int port = std::stoi(server_url.substr(server_url.find(':') + 1));
-    magic_api::Server server(host, port);
+    magic_api::Server server(host, port, config.http_threads);
+    auto remote_task_service =
+        std::make_shared<magic_core::RemoteTaskService>(metadata_store, task_queue_repo);
+    // Searches and ingest requests run here rather than on the HTTP threads; a full queue
+    // answers 503
+    auto search_executor = std::make_shared<magic_core::async::BoundedExecutor>(
+        "search", static_cast<size_t>(config.search_threads),
+        static_cast<size_t>(config.search_queue_depth));
+    auto ingest_executor = std::make_shared<magic_core::async::BoundedExecutor>(
+        "ingest", static_cast<size_t>(config.ingest_threads),
+        static_cast<size_t>(config.ingest_queue_depth));
+    auto worker_limiter = std::make_shared<magic_core::async::InFlightLimiter>(
+        static_cast<size_t>(config.remote_worker_max_in_flight));
+    magic_core::log::info() << "HTTP threads: " << config.http_threads << ", search "
+                            << config.search_threads << " (queue " << config.search_queue_depth
+                            << "), ingest " << config.ingest_threads << " (queue "
+                            << config.ingest_queue_depth << ")";
+    auto readiness = std::make_shared<magic_core::async::Readiness>();
     magic_api::Routes routes(file_processing_service, file_delete_service, file_info_service,
-                             search_service, task_queue_repo);
+                             search_service, task_queue_repo, remote_task_service,
+                             search_executor, ingest_executor, worker_limiter, readiness);
     routes.register_routes(server);
 
-    // --- 2. START BACKGROUND SERVICES ---
-    std::cout << "Disabling Crow's internal signal handling..." << std::endl;
+    magic_core::log::info() << "Disabling Crow's internal signal handling...";
     server.get_app().signal_clear();
-
-    worker_pool->start();
     server.start();
-    std::cout << "Server started successfully. Press Ctrl+C to exit." << std::endl;
-
-    // --- 3. WAIT FOR SHUTDOWN SIGNAL ---
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+    magic_core::log::info() << "Server started successfully. Press Ctrl+C to exit.";
 
+    // --- 2. WARM UP ---
+    // "/" reports warming, and searches, ingestion and remote workers get 503, until every
+    // shard's indexes are in. The shards load side by side, and the model warms up meanwhile.
+    readiness->set_stage("loading indexes");
+    // Crow's loop only ends with stop(); a failed warm-up has to end it before the routes it
+    // calls into go away, or the process waits on the server thread forever
+    auto stop_serving = [&] {
+      search_executor->shutdown();
+      ingest_executor->shutdown();
+      server.stop();
+    };
+    try {
+      std::vector<std::future<void>> loading;
+      for (size_t i = 0; i < shard_count; ++i) {
+        loading.push_back(std::async(std::launch::async, [&config, i, store = shard_stores[i]] {
+          store->load_indexes();
+          if (config.startup_prefault_vectors) {
+            const size_t bytes = store->prefault_vectors();
+            magic_core::log::info() << "Shard " << i << ": read " << (bytes >> 20)
+                                    << " MB of vectors into memory";
+          }
+        }));
+      }
+      std::future<size_t> model_warm_up;
+      if (config.startup_warm_up_model) {
+        model_warm_up = std::async(std::launch::async,
+                                   [embedding_client] { return embedding_client->warm_up(); });
+      }
+      for (auto& shard : loading) {
+        shard.get();
+      }
+      if (model_warm_up.valid()) {
+        readiness->set_stage("warming up the embedding model");
+        magic_core::log::info() << "Embedding model loaded on " << model_warm_up.get() << " of "
+                                << config.embedding_endpoints.size() << " endpoints";
+      }
+      readiness->mark_ready();
+      magic_core::log::info() << "Ready after "
+                              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     readiness->warming_for())
+                                     .count()
+                              << " ms";
+    } catch (...) {
+      stop_serving();
+      throw;
+    }
+
+    // --- 3. START BACKGROUND SERVICES ---
+    worker_pool->start();
+    if (file_watcher) {
+      file_watcher->start();
+    }
+    for (auto& maintenance : index_maintenance) {
+      maintenance->start();
+    }
+
+    // --- 4. WAIT FOR SHUTDOWN SIGNAL ---
     {
       std::unique_lock<std::mutex> lock(shutdown_mutex);
       shutdown_cv.wait(lock, [] { return shutdown_requested.load(); });
     }
 
-    // --- 4. GRACEFUL SHUTDOWN SEQUENCE ---
-    std::cout << "[1/3] Stopping API server to refuse new requests..." << std::endl;
-    server.stop();
+    // --- 5. GRACEFUL SHUTDOWN SEQUENCE ---
+    magic_core::log::info() << "[1/6] Stopping API server to refuse new requests...";
+    // Requests already queued are answered first; later ones get 503 until the server stops
+    stop_serving();
+
+    magic_core::log::info() << "[2/6] Stopping file watcher and queueing pending changes...";
+    if (file_watcher) {
+      file_watcher->stop();
+    }
 
-    std::cout << "[2/3] Stopping worker pool to finish processing..." << std::endl;
+    magic_core::log::info() << "[3/6] Stopping worker pool to finish processing...";
     worker_pool->stop();  // Blocks until all workers are done
 
-    std::cout << "[3/3] Shutting down database connections..." << std::endl;
+    magic_core::log::info() << "[4/6] Stopping index maintenance...";
+    for (auto& maintenance : index_maintenance) {
+      maintenance->stop();  // Waits for a running job to finish
+    }
+
+    magic_core::log::info() << "[5/6] Persisting the search indexes...";
+    metadata_store->persist_faiss_index();
+
+    magic_core::log::info() << "[6/6] Shutting down database connections...";
+    for (auto& shard : shard_managers) {
+      shard->shutdown();
+    }
     db_manager.shutdown();
+    // Writes the traces still queued
+    magic_core::trace::set_exporter(nullptr);
 
-    std::cout << "Shutdown complete." << std::endl;
+    magic_core::log::info() << "Shutdown complete.";
+    magic_core::log::Logger::global().flush();
   } catch (const std::exception& e) {
-    std::cerr << "Error starting server: " << e.what() << std::endl;
+    magic_core::log::error() << "Error starting server: " << e.what();
+    magic_core::log::Logger::global().flush();
     return 1;
   }
 
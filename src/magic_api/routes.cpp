@@ -1,25 +1,108 @@
 #include "magic_api/routes.hpp"
 
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <nlohmann/json.hpp>
 
+#include "magic_core/async/bounded_executor.hpp"
+#include "magic_core/async/in_flight_limiter.hpp"
+#include "magic_core/async/readiness.hpp"
+#include "magic_core/services/content_encoding.hpp"
 #include "magic_core/services/file_delete_service.hpp"
 #include "magic_core/services/file_info_service.hpp"
 #include "magic_core/services/file_processing_service.hpp"
+#include "magic_core/services/remote_task_service.hpp"
+#include "magic_core/services/search_response_encoder.hpp"
 #include "magic_core/services/search_service.hpp"
 #include "magic_core/db/task_queue_repo.hpp"
+#include "magic_core/types/logger.hpp"
+#include "magic_core/types/metrics.hpp"
+#include "magic_core/types/trace.hpp"
 
 namespace magic_api {
+
+namespace log = magic_core::log;
+
+namespace {
+
+nlohmann::json chunk_to_json(const magic_core::SearchService::ChunkResultDTO &chunk,
+                             magic_core::ChunkContentMode mode) {
+  nlohmann::json chunk_json;
+  chunk_json["id"] = chunk.id;
+  chunk_json["file_id"] = chunk.file_id;
+  chunk_json["chunk_index"] = chunk.chunk_index;
+  if (mode == magic_core::ChunkContentMode::Full) {
+    chunk_json["content"] = chunk.content;
+  } else if (mode == magic_core::ChunkContentMode::Snippet) {
+    chunk_json["snippet"] = chunk.content;
+    chunk_json["snippet_offset"] = chunk.content_offset;
+  }
+  return chunk_json;
+}
+
+nlohmann::json file_to_json(const magic_core::BasicFileMetadata &file) {
+  nlohmann::json file_info;
+  file_info["id"] = file.id;
+  file_info["path"] = file.path;
+  file_info["size"] = file.file_size;
+  file_info["type"] = file.file_type;
+  file_info["status"] = magic_core::to_string(file.processing_status);
+  return file_info;
+}
+
+nlohmann::json task_to_json(const magic_core::TaskDTO &task) {
+  nlohmann::json task_json;
+  task_json["id"] = task.id;
+  task_json["task_type"] = task.task_type;
+  task_json["status"] = magic_core::to_string(task.status);
+  task_json["priority"] = task.priority;
+  task_json["target_path"] = task.target_path;
+  task_json["target_tag"] = task.target_tag;
+  task_json["payload"] = task.payload;
+  task_json["error_message"] = task.error_message;
+  task_json["created_at"] = magic_core::TaskQueueRepo::time_point_to_string(task.created_at);
+  task_json["updated_at"] = magic_core::TaskQueueRepo::time_point_to_string(task.updated_at);
+  return task_json;
+}
+
+// A /tasks/stream event; message is the progress message, or the error of a failed task
+std::string task_update_event(const magic_core::TaskUpdate &update) {
+  nlohmann::json event;
+  event["event"] = "task";
+  event["task_id"] = update.task_id;
+  event["status"] = magic_core::to_string(update.status);
+  event["progress_percent"] = update.progress_percent;
+  event["message"] = update.message;
+  return event.dump();
+}
+
+bool is_finished(magic_core::TaskStatus status) {
+  return status == magic_core::TaskStatus::COMPLETED || status == magic_core::TaskStatus::FAILED;
+}
+
+}  // namespace
+
 Routes::Routes(std::shared_ptr<magic_core::FileProcessingService> file_processing_service,
                std::shared_ptr<magic_core::FileDeleteService> file_delete_service,
                std::shared_ptr<magic_core::FileInfoService> file_info_service,
                std::shared_ptr<magic_core::SearchService> search_service,
-               std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo)
+               std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo,
+               std::shared_ptr<magic_core::RemoteTaskService> remote_task_service,
+               std::shared_ptr<magic_core::async::BoundedExecutor> search_executor,
+               std::shared_ptr<magic_core::async::BoundedExecutor> ingest_executor,
+               std::shared_ptr<magic_core::async::InFlightLimiter> worker_limiter,
+               std::shared_ptr<const magic_core::async::Readiness> readiness)
     : file_processing_service_(file_processing_service),
       file_delete_service_(file_delete_service),
       file_info_service_(file_info_service),
       search_service_(search_service),
-      task_queue_repo_(task_queue_repo) {}
+      task_queue_repo_(task_queue_repo),
+      remote_task_service_(remote_task_service),
+      search_executor_(search_executor),
+      ingest_executor_(ingest_executor),
+      worker_limiter_(worker_limiter),
+      readiness_(readiness) {}
 
 void Routes::register_routes(Server &server) {
   auto &app = server.get_app();
@@ -28,24 +111,75 @@ void Routes::register_routes(Server &server) {
   CROW_ROUTE(app, "/")
   ([this](const crow::request &req) { return handle_health_check(req); });
 
+  // Prometheus scrape endpoint
+  CROW_ROUTE(app, "/metrics")
+  ([this](const crow::request &req) { return handle_metrics(req); });
+
   // File processing endpoint
   CROW_ROUTE(app, "/process_file")
-      .methods(crow::HTTPMethod::POST)(
-          [this](const crow::request &req) { return handle_process_file(req); });
+      .methods(crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res) {
+        dispatch(ingest_executor_.get(), req, res, &Routes::handle_process_file);
+      });
 
-  // Search endpoint
-  CROW_ROUTE(app, "/search").methods(crow::HTTPMethod::POST)([this](const crow::request &req) {
-    return handle_search(req);
-  });
+  // Bulk directory ingestion endpoint
+  CROW_ROUTE(app, "/process_directory")
+      .methods(crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res) {
+        dispatch(ingest_executor_.get(), req, res, &Routes::handle_process_directory);
+      });
+
+  // Search endpoints embed the query, which can take a while; they answer from the search
+  // executor so a slow embedding server never ties up Crow's threads
+  CROW_ROUTE(app, "/search")
+      .methods(crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res) {
+        dispatch(search_executor_.get(), req, res, &Routes::handle_search);
+      });
+
+  // Many searches in one request, one embedding call and one index pass
+  CROW_ROUTE(app, "/search/batch")
+      .methods(crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res) {
+        dispatch(search_executor_.get(), req, res, &Routes::handle_search_batch);
+      });
+
+  // /search over a WebSocket: the file hits go out as soon as the file index answers, and each
+  // chunk as its content is read, instead of all of it at the end
+  CROW_WEBSOCKET_ROUTE(app, "/search/stream")
+      .onopen([this](crow::websocket::connection &conn) {
+        std::lock_guard<std::mutex> lock(search_streams_->mutex);
+        search_streams_->connections[&conn] = search_streams_->next_serial++;
+      })
+      .onclose([this](crow::websocket::connection &conn, const std::string &, uint16_t) {
+        std::lock_guard<std::mutex> lock(search_streams_->mutex);
+        search_streams_->connections.erase(&conn);
+      })
+      .onmessage([this](crow::websocket::connection &conn, const std::string &message, bool) {
+        handle_search_stream(conn, message);
+      });
 
   // File search endpoint
-  CROW_ROUTE(app, "/files/search").methods(crow::HTTPMethod::POST)([this](const crow::request &req) {
-    return handle_file_search(req);
+  CROW_ROUTE(app, "/files/search")
+      .methods(crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res) {
+        dispatch(search_executor_.get(), req, res, &Routes::handle_file_search);
+      });
+
+  // A chunk's full content, for searches that asked for ids or snippets only
+  CROW_ROUTE(app, "/chunks/<int>")
+  ([this](const crow::request &req, int chunk_id) { return handle_get_chunk(req, chunk_id); });
+
+  // Dictionaries named by the frames of chunk_content "zstd" searches
+  CROW_ROUTE(app, "/compression/dictionaries/<uint>")
+  ([this](const crow::request &req, unsigned int id) {
+    crow::response res = handle_get_compression_dictionary(req, id);
+    compress_response(req, res);
+    return res;
   });
 
-  // List files endpoint
+  // List files endpoint: pages by ?after_id=&limit=, or ?format=ndjson exports every file
   CROW_ROUTE(app, "/files")
-  ([this](const crow::request &req) { return handle_list_files(req); });
+  ([this](const crow::request &req, crow::response &res) { handle_list_files(req, res); });
+
+  // Configured collections and how much each one holds
+  CROW_ROUTE(app, "/collections")
+  ([this](const crow::request &req) { return handle_list_collections(req); });
 
   // Get file info endpoint
   CROW_ROUTE(app, "/files/<string>")
@@ -56,13 +190,28 @@ void Routes::register_routes(Server &server) {
   // Delete file endpoint
   CROW_ROUTE(app, "/files/<string>")
       .methods(crow::HTTPMethod::DELETE)([this](const crow::request &req, const std::string &path) {
-        return handle_delete_file(req, path);
+        return when_ready([&] { return handle_delete_file(req, path); });
       });
 
   // Task management endpoints
   CROW_ROUTE(app, "/tasks")
   ([this](const crow::request &req) { return handle_list_tasks(req); });
 
+  // Progress pushed as workers report it, instead of polled from the database
+  if (task_queue_repo_) {
+    task_queue_repo_->set_task_update_listener(
+        [streams = task_streams_](const magic_core::TaskUpdate &update) {
+          streams->publish(update);
+        });
+  }
+  CROW_WEBSOCKET_ROUTE(app, "/tasks/stream")
+      .onclose([this](crow::websocket::connection &conn, const std::string &, uint16_t) {
+        task_streams_->remove(&conn);
+      })
+      .onmessage([this](crow::websocket::connection &conn, const std::string &message, bool) {
+        handle_task_stream(conn, message);
+      });
+
   CROW_ROUTE(app, "/tasks/<string>/status")
   ([this](const crow::request &req, const std::string &task_id) {
     return handle_get_task_status(req, task_id);
@@ -75,129 +224,523 @@ void Routes::register_routes(Server &server) {
 
   CROW_ROUTE(app, "/tasks/clear")
       .methods(crow::HTTPMethod::POST)([this](const crow::request &req) {
-        return handle_clear_completed_tasks(req);
+        return when_ready([&] { return handle_clear_completed_tasks(req); });
+      });
+
+  // Online backup, written by a bulk worker while writes go on
+  CROW_ROUTE(app, "/snapshot")
+      .methods(crow::HTTPMethod::POST)([this](const crow::request &req, crow::response &res) {
+        dispatch(ingest_executor_.get(), req, res, &Routes::handle_snapshot);
+      });
+
+  // Remote ingestion workers (magic_worker). Past their limit they get 429, which a worker
+  // retries after backing off as long as Retry-After asks, without failing its task.
+  CROW_ROUTE(app, "/tasks/claim")
+      .methods(crow::HTTPMethod::POST)([this](const crow::request &req) {
+        return limited(worker_limiter_.get(), [&] { return handle_claim_tasks(req); });
       });
 
-  std::cout << "All routes registered successfully" << std::endl;
+  CROW_ROUTE(app, "/tasks/<string>/lease")
+      .methods(crow::HTTPMethod::POST)(
+          [this](const crow::request &req, const std::string &task_id) {
+            return limited(worker_limiter_.get(),
+                           [&] { return handle_renew_task_lease(req, task_id); });
+          });
+
+  CROW_ROUTE(app, "/tasks/<string>/result")
+      .methods(crow::HTTPMethod::POST)(
+          [this](const crow::request &req, const std::string &task_id) {
+            return limited(worker_limiter_.get(),
+                           [&] { return handle_complete_task(req, task_id); });
+          });
+
+  CROW_ROUTE(app, "/tasks/<string>/fail")
+      .methods(crow::HTTPMethod::POST)(
+          [this](const crow::request &req, const std::string &task_id) {
+            return limited(worker_limiter_.get(), [&] { return handle_fail_task(req, task_id); });
+          });
+
+  log::info() << "All routes registered successfully";
+}
+
+void Routes::dispatch(magic_core::async::BoundedExecutor *executor,
+                      const crow::request &req,
+                      crow::response &res,
+                      RequestHandler handler) {
+  // Crow keeps req and res alive until res.end()
+  auto respond = [this, &req, &res, handler] {
+    // Traced when traces are exported or the caller asked for the timing breakdown
+    const bool timing = req.get_header_value(TIMING_HEADER) == "1";
+    std::shared_ptr<magic_core::trace::FileExporter> exporter = magic_core::trace::exporter();
+    std::optional<magic_core::trace::Trace> request_trace;
+    if (timing || exporter) {
+      auto parent = magic_core::trace::parse_traceparent(req.get_header_value("traceparent"));
+      if (parent) {
+        request_trace.emplace(parent->trace_id, parent->span_id);
+      } else {
+        request_trace.emplace();
+      }
+    }
+    {
+      std::optional<magic_core::trace::Scope> scope;
+      if (request_trace) {
+        scope.emplace(*request_trace);
+      }
+      magic_core::trace::Span span("http.request");
+      span.set_attribute("http.method", crow::method_name(req.method));
+      span.set_attribute("http.target", req.url);
+      try {
+        res = (this->*handler)(req);
+      } catch (const std::exception &e) {
+        res = create_json_response(create_error_response(e.what()), 500);
+      }
+      span.set_attribute("http.status_code", res.code);
+    }
+    compress_response(req, res);
+    if (request_trace) {
+      if (timing) {
+        res.set_header("Server-Timing", request_trace->server_timing());
+        res.set_header("X-Trace-Id", request_trace->trace_id());
+      }
+      if (exporter) {
+        exporter->export_trace(*request_trace);
+      }
+    }
+    res.end();
+  };
+  if (warming()) {
+    res = create_overload_response("Server is warming up, retry shortly", 503);
+    res.end();
+    return;
+  }
+  if (!executor) {
+    respond();
+    return;
+  }
+  if (!executor->try_submit(respond)) {
+    res = create_overload_response("Server is busy, retry shortly", 503);
+    res.end();
+  }
+}
+
+crow::response Routes::limited(magic_core::async::InFlightLimiter *limiter,
+                               const std::function<crow::response()> &handler) {
+  if (warming()) {
+    return create_overload_response("Server is warming up, retry shortly", 503);
+  }
+  if (!limiter) {
+    return handler();
+  }
+  magic_core::async::InFlightLimiter::Permit permit = limiter->try_acquire();
+  if (!permit) {
+    return create_overload_response("Too many worker requests, retry shortly", 429);
+  }
+  return handler();
+}
+
+crow::response Routes::when_ready(const std::function<crow::response()> &handler) {
+  if (warming()) {
+    return create_overload_response("Server is warming up, retry shortly", 503);
+  }
+  return handler();
+}
+
+crow::response Routes::create_overload_response(const std::string &error, int status_code) {
+  crow::response res = create_json_response(create_error_response(error), status_code);
+  res.set_header("Retry-After", "1");
+  return res;
+}
+
+bool Routes::warming() const {
+  return readiness_ && !readiness_->ready();
 }
 
 crow::response Routes::handle_health_check(const crow::request &req) {
   nlohmann::json response = create_success_response("Magic Folder API is running");
   response["version"] = "0.1.0";
   response["status"] = "healthy";
-  return create_json_response(response);
+  if (warming()) {
+    // 503 keeps load balancers away until the indexes are in; the stage says how far it got
+    response["status"] = "warming";
+    response["stage"] = readiness_->stage();
+    response["warming_for_s"] =
+        std::chrono::duration<double>(readiness_->warming_for()).count();
+  }
+  // Load per endpoint class, to tell saturation from failure
+  auto executor_json = [](const magic_core::async::BoundedExecutor &executor) {
+    nlohmann::json load;
+    load["active"] = executor.active();
+    load["queued"] = executor.queued();
+    load["rejected"] = executor.rejected();
+    return load;
+  };
+  if (search_executor_) {
+    response["search_executor"] = executor_json(*search_executor_);
+  }
+  if (ingest_executor_) {
+    response["ingest_executor"] = executor_json(*ingest_executor_);
+  }
+  if (worker_limiter_) {
+    nlohmann::json workers;
+    workers["in_flight"] = worker_limiter_->in_flight();
+    workers["rejected"] = worker_limiter_->rejected();
+    response["worker_requests"] = workers;
+  }
+  return create_json_response(response, response["status"] == "warming" ? 503 : 200);
+}
+
+crow::response Routes::handle_metrics(const crow::request &req) {
+  namespace metrics = magic_core::metrics;
+  // Queue depths and executor load are sampled per scrape; everything else counts as it goes
+  if (task_queue_repo_) {
+    for (auto status : {magic_core::TaskStatus::PENDING, magic_core::TaskStatus::PROCESSING,
+                        magic_core::TaskStatus::COMPLETED, magic_core::TaskStatus::FAILED}) {
+      std::string label = magic_core::to_string(status);
+      std::transform(label.begin(), label.end(), label.begin(),
+                     [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+      metrics::gauge("magic_task_queue_depth", "Tasks in the queue by status",
+                     "status=\"" + label + "\"")
+          .set(static_cast<double>(task_queue_repo_->count_tasks_by_status(status)));
+    }
+  }
+  auto executor_gauges = [](const std::string &name,
+                            const magic_core::async::BoundedExecutor &executor) {
+    const std::string labels = "executor=\"" + name + "\"";
+    metrics::gauge("magic_executor_active", "Requests being handled", labels)
+        .set(static_cast<double>(executor.active()));
+    metrics::gauge("magic_executor_queued", "Requests waiting for a thread", labels)
+        .set(static_cast<double>(executor.queued()));
+    metrics::gauge("magic_executor_rejected", "Requests answered 503 since start", labels)
+        .set(static_cast<double>(executor.rejected()));
+  };
+  if (search_executor_) {
+    executor_gauges("search", *search_executor_);
+  }
+  if (ingest_executor_) {
+    executor_gauges("ingest", *ingest_executor_);
+  }
+
+  crow::response res(200, metrics::Registry::global().render());
+  res.set_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+  return res;
 }
 
 crow::response Routes::handle_process_file(const crow::request &req) {
   try {
     std::string file_path = extract_file_path_from_request(req);
-    std::cout << "Processing file: " << file_path << std::endl;
+    log::info() << "Processing file: " << file_path;
     // Request processing to add task to queue
     std::optional<long long> task_id = file_processing_service_->request_processing(file_path);
     if (!task_id.has_value()) {
-      std::cout << "File already being processed: " << file_path << std::endl;
+      log::info() << "File already being processed: " << file_path;
       return create_json_response(create_error_response("File already being processed"), 400);
     }
     nlohmann::json response = create_success_response("File processing queued successfully");
     return create_json_response(response);
   } catch (const std::exception &e) {
-    std::cerr << "Exception in handle_process_file: " << e.what() << std::endl;
+    log::error() << "Exception in handle_process_file: " << e.what();
     nlohmann::json error_response = create_error_response(e.what());
     return create_json_response(error_response, 400);
   }
 }
 
+crow::response Routes::handle_process_directory(const crow::request &req) {
+  try {
+    const nlohmann::json body = parse_json_body(req.body);
+    std::string directory_path = body.value("directory_path", "");
+    if (directory_path.empty()) {
+      return create_json_response(create_error_response("directory_path is required"), 400);
+    }
+    const bool bulk_load = body.value("bulk_load", false);
+    log::info() << "Processing directory: " << directory_path << (bulk_load ? " (bulk load)" : "");
+    magic_core::DirectoryProcessingResult result =
+        file_processing_service_->request_directory_processing(
+            directory_path, magic_core::TaskPriority::BULK, bulk_load);
+
+    nlohmann::json data;
+    data["files_found"] = result.files_found;
+    data["queued"] = result.task_ids.size();
+    data["skipped"] = result.skipped;
+    data["duplicates"] = result.duplicates;
+    data["unsupported"] = result.unsupported;
+    data["task_ids"] = result.task_ids;
+    data["errors"] = result.errors;
+    data["bulk_load"] = result.bulk_load;
+    return create_json_response(create_success_response("Directory processing queued", data));
+  } catch (const std::exception &e) {
+    log::error() << "Exception in handle_process_directory: " << e.what();
+    return create_json_response(create_error_response(e.what()), 400);
+  }
+}
+
 // handlers have a lot to do
 crow::response Routes::handle_search(const crow::request &req) {
   try {
     std::string query = extract_search_query_from_request(req);
     int top_k = extract_top_k_from_request(req);
+    magic_core::VectorSearchOptions tuning = extract_search_tuning_from_request(req);
+    magic_core::ChunkContentOptions content = extract_chunk_content_from_request(req);
+    magic_core::SearchMode mode = extract_search_mode_from_request(req);
+    magic_core::SearchFilter filter = extract_search_filter_from_request(req);
 
-    std::cout << "Magic search for: " << query << " with top_k: " << top_k << std::endl;
+    log::info() << "Magic search for: " << query << " with top_k: " << top_k;
 
     // Use the magic search that returns both files and chunks
-    magic_core::SearchService::MagicSearchResult search_results = search_service_->search(query, top_k);
-    
-    nlohmann::json response;
-    
-    // Add file results
-    nlohmann::json file_results = nlohmann::json::array();
-    for (const magic_core::FileSearchResult &result : search_results.file_results) {
-      nlohmann::json result_json;
-      result_json["id"] = result.file.id;
-      result_json["path"] = result.file.path;
-      result_json["score"] = result.distance;
-      file_results.push_back(result_json);
-    }
-    response["files"] = file_results;
-    std::cout << "File results: " << file_results.size() << std::endl;
-    // Add chunk results
-    nlohmann::json chunk_results = nlohmann::json::array();
-    for (const magic_core::SearchService::ChunkResultDTO &result : search_results.chunk_results) {
-      nlohmann::json result_json;
-      result_json["id"] = result.id;
-      result_json["file_id"] = result.file_id;
-      result_json["chunk_index"] = result.chunk_index;
-      result_json["content"] = result.content;
-      result_json["score"] = result.distance;
-      chunk_results.push_back(result_json);
-    }
-    response["chunks"] = chunk_results;
-    std::cout << "Chunk results: " << chunk_results.size() << std::endl;
-    return create_json_response(response);
+    magic_core::SearchService::MagicSearchResult search_results =
+        search_service_->search(query, top_k, tuning, content, mode, filter);
+
+    log::info() << "File results: " << search_results.file_results.size();
+    log::info() << "Chunk results: " << search_results.chunk_results.size();
+    const magic_core::ResponseFormat format = extract_response_format_from_request(req);
+    return create_search_response(
+        magic_core::SearchResponseEncoder::encode(search_results, content.mode, format), format);
   } catch (const std::exception &e) {
     nlohmann::json error_response = create_error_response(e.what());
     return create_json_response(error_response, 400);
   }
 }
 
+void Routes::handle_search_stream(crow::websocket::connection &conn, const std::string &message) {
+  // Messages arrive on the connection's own thread, so it is open and registered here
+  uint64_t serial;
+  {
+    std::lock_guard<std::mutex> lock(search_streams_->mutex);
+    serial = search_streams_->connections[&conn];
+  }
+  auto send_error = [this, &conn, serial](const std::string &error) {
+    nlohmann::json event;
+    event["event"] = "error";
+    event["error"] = error;
+    send_search_event(&conn, serial, event.dump());
+  };
+  if (warming()) {
+    send_error("Server is warming up, retry shortly");
+    return;
+  }
+  // Parsed here, so a bad request is answered without taking an executor thread
+  crow::request req;
+  req.body = message;
+  std::string query;
+  int top_k;
+  magic_core::VectorSearchOptions tuning;
+  magic_core::ChunkContentOptions content;
+  magic_core::SearchMode mode;
+  magic_core::SearchFilter filter;
+  try {
+    query = extract_search_query_from_request(req);
+    top_k = extract_top_k_from_request(req);
+    tuning = extract_search_tuning_from_request(req);
+    content = extract_chunk_content_from_request(req);
+    mode = extract_search_mode_from_request(req);
+    filter = extract_search_filter_from_request(req);
+  } catch (const std::exception &e) {
+    send_error(e.what());
+    return;
+  }
+
+  // The connection is only touched through send_search_event, which knows whether it closed
+  crow::websocket::connection *target = &conn;
+  auto run = [this, target, serial, query, top_k, tuning, content, mode, filter] {
+    log::info() << "Streaming search for: " << query << " with top_k: " << top_k;
+    magic_core::SearchService::SearchObserver observer;
+    observer.on_files = [this, target,
+                         serial](const std::vector<magic_core::FileSearchResult> &files) {
+      send_search_event(target, serial,
+                        magic_core::SearchResponseEncoder::encode_stream_files(
+                            files, magic_core::ResponseFormat::Json));
+    };
+    observer.on_chunk = [this, target, serial, chunk_mode = content.mode](
+                            const magic_core::SearchService::ChunkResultDTO &chunk) {
+      send_search_event(target, serial,
+                        magic_core::SearchResponseEncoder::encode_stream_chunk(
+                            chunk, chunk_mode, magic_core::ResponseFormat::Json));
+    };
+    nlohmann::json done;
+    try {
+      auto result =
+          search_service_->search_streaming(query, top_k, tuning, content, mode, filter, observer);
+      done["event"] = "done";
+      done["files"] = result.file_results.size();
+      done["chunks"] = result.chunk_results.size();
+    } catch (const std::exception &e) {
+      done["event"] = "error";
+      done["error"] = e.what();
+    }
+    send_search_event(target, serial, done.dump());
+  };
+  if (!search_executor_) {
+    run();
+  } else if (!search_executor_->try_submit(run)) {
+    send_error("Server is busy, retry shortly");
+  }
+}
+
+void Routes::send_search_event(crow::websocket::connection *conn,
+                               uint64_t serial,
+                               const std::string &text) {
+  // Crow queues the frame on the connection's own thread, so this never blocks on the client
+  std::lock_guard<std::mutex> lock(search_streams_->mutex);
+  auto it = search_streams_->connections.find(conn);
+  if (it != search_streams_->connections.end() && it->second == serial) {
+    conn->send_text(text);
+  }
+}
+
+crow::response Routes::handle_search_batch(const crow::request &req) {
+  try {
+    auto json_body = parse_json_body(req.body);
+    auto queries = json_body.value("queries", std::vector<std::string>{});
+    if (queries.empty() || queries.size() > MAX_BATCH_QUERIES) {
+      return create_json_response(
+          create_error_response("queries must hold between 1 and " +
+                                std::to_string(MAX_BATCH_QUERIES) + " strings"),
+          400);
+    }
+    int top_k = extract_top_k_from_request(req);
+    magic_core::VectorSearchOptions tuning = extract_search_tuning_from_request(req);
+    magic_core::ChunkContentOptions content = extract_chunk_content_from_request(req);
+    magic_core::SearchMode mode = extract_search_mode_from_request(req);
+    magic_core::SearchFilter filter = extract_search_filter_from_request(req);
+
+    log::info() << "Batch search for " << queries.size() << " queries with top_k: " << top_k;
+
+    auto batch = search_service_->search_batch(queries, top_k, tuning, content, mode, filter);
+    const magic_core::ResponseFormat format = extract_response_format_from_request(req);
+    return create_search_response(
+        magic_core::SearchResponseEncoder::encode_batch(batch, queries, content.mode, format),
+        format);
+  } catch (const std::exception &e) {
+    nlohmann::json error_response = create_error_response(e.what());
+    return create_json_response(error_response, 400);
+  }
+}
+
+crow::response Routes::handle_get_chunk(const crow::request &req, int chunk_id) {
+  try {
+    auto chunk = search_service_->get_chunk(chunk_id);
+    if (!chunk) {
+      return create_json_response(create_error_response("Chunk not found"), 404);
+    }
+    return create_json_response(chunk_to_json(*chunk, magic_core::ChunkContentMode::Full));
+  } catch (const std::exception &e) {
+    return create_json_response(create_error_response(e.what()), 500);
+  }
+}
+
 crow::response Routes::handle_file_search(const crow::request &req) {
   try {
     std::string query = extract_search_query_from_request(req);
     int top_k = extract_top_k_from_request(req);
+    magic_core::VectorSearchOptions tuning = extract_search_tuning_from_request(req);
+    magic_core::SearchFilter filter = extract_search_filter_from_request(req);
 
-    std::cout << "File search for: " << query << " with top_k: " << top_k << std::endl;
+    log::info() << "File search for: " << query << " with top_k: " << top_k;
 
     // Use the file-only search
-    std::vector<magic_core::FileSearchResult> search_results = search_service_->search_files(query, top_k);
-    
-    nlohmann::json results = nlohmann::json::array();
-    for (const magic_core::FileSearchResult &result : search_results) {
-      nlohmann::json result_json;
-      result_json["path"] = result.file.path;
-      result_json["score"] = result.distance;
-      results.push_back(result_json);
-    }
+    std::vector<magic_core::FileSearchResult> search_results =
+        search_service_->search_files(query, top_k, tuning, filter);
 
-    return create_json_response(results);
+    const magic_core::ResponseFormat format = extract_response_format_from_request(req);
+    return create_search_response(
+        magic_core::SearchResponseEncoder::encode_files(search_results, format), format);
   } catch (const std::exception &e) {
     nlohmann::json error_response = create_error_response(e.what());
     return create_json_response(error_response, 400);
   }
 }
 
-crow::response Routes::handle_list_files(const crow::request &req) {
+void Routes::handle_list_files(const crow::request &req, crow::response &res) {
   try {
-    std::cout << "Listing files" << std::endl;
-    auto files = file_info_service_->list_files();
+    const char *format = req.url_params.get("format");
+    if (format && std::string(format) == "ndjson") {
+      stream_files_ndjson(res);
+      compress_response(req, res);
+      res.end();
+      return;
+    }
+    const auto [after_id, limit] = extract_page_from_request(req);
+    log::info() << "Listing files after id " << after_id;
+    auto files = file_info_service_->list_files_page(after_id, limit);
     nlohmann::json results = nlohmann::json::array();
     for (const auto &file : files) {
-      nlohmann::json file_info;
-      file_info["path"] = file.path;
-      file_info["size"] = file.file_size;
-      file_info["type"] = file.file_type;
-      results.push_back(file_info);
+      results.push_back(file_to_json(file));
     }
-    return create_json_response(results);
+    nlohmann::json response;
+    response["files"] = results;
+    response["next_after_id"] =
+        static_cast<int>(files.size()) == limit ? nlohmann::json(files.back().id) : nullptr;
+    res = create_json_response(response);
   } catch (const std::exception &e) {
     nlohmann::json error_response = create_error_response(e.what());
-    return create_json_response(error_response, 400);
+    res = create_json_response(error_response, 400);
+  }
+  compress_response(req, res);
+  res.end();
+}
+
+void Routes::stream_files_ndjson(crow::response &res) {
+  log::info() << "Exporting files as NDJSON";
+  res.code = 200;
+  res.set_header("Content-Type", "application/x-ndjson");
+  // One page in memory at a time; each line is written out before the next page is read
+  int64_t after_id = 0;
+  for (;;) {
+    auto files = file_info_service_->list_files_page(after_id, EXPORT_PAGE_SIZE);
+    std::string lines;
+    for (const auto &file : files) {
+      lines += file_to_json(file).dump();
+      lines += '\n';
+    }
+    res.write(lines);
+    if (static_cast<int>(files.size()) < EXPORT_PAGE_SIZE) {
+      break;
+    }
+    after_id = files.back().id;
+  }
+}
+
+crow::response Routes::handle_get_compression_dictionary(const crow::request &req,
+                                                         unsigned int id) {
+  try {
+    auto dictionary = search_service_->get_compression_dictionary(id);
+    if (!dictionary) {
+      return create_json_response(create_error_response("Dictionary not found"), 404);
+    }
+    crow::response res(200, std::string(dictionary->begin(), dictionary->end()));
+    res.add_header("Content-Type", "application/octet-stream");
+    // A dictionary id names the same bytes forever
+    res.add_header("Cache-Control", "public, max-age=31536000, immutable");
+    return res;
+  } catch (const std::exception &e) {
+    return create_json_response(create_error_response(e.what()), 500);
+  }
+}
+
+crow::response Routes::handle_list_collections(const crow::request &req) {
+  try {
+    nlohmann::json collections = nlohmann::json::array();
+    for (const auto &collection : file_info_service_->list_collections()) {
+      nlohmann::json entry;
+      entry["name"] = collection.name;
+      entry["root"] = collection.root;
+      entry["files"] = collection.file_index.size - collection.file_index.tombstones;
+      entry["chunks"] = collection.chunk_index.size - collection.chunk_index.tombstones;
+      entry["bulk_loading"] = collection.bulk_loading;
+      collections.push_back(std::move(entry));
+    }
+    nlohmann::json response;
+    response["collections"] = std::move(collections);
+    crow::response res = create_json_response(response);
+    compress_response(req, res);
+    return res;
+  } catch (const std::exception &e) {
+    return create_json_response(create_error_response(e.what()), 500);
   }
 }
 
 crow::response Routes::handle_get_file_info(const crow::request &req, const std::string &path) {
   try {
-    std::cout << "Getting file info for: " << path << std::endl;
+    log::info() << "Getting file info for: " << path;
 
     nlohmann::json file_info;
     file_info["path"] = path;
@@ -213,7 +756,7 @@ crow::response Routes::handle_get_file_info(const crow::request &req, const std:
 
 crow::response Routes::handle_delete_file(const crow::request &req, const std::string &path) {
   try {
-    std::cout << "Deleting file: " << path << std::endl;
+    log::info() << "Deleting file: " << path;
     // TODO: Implement actual file deletion
 
     nlohmann::json response = create_success_response("File deleted successfully");
@@ -224,6 +767,42 @@ crow::response Routes::handle_delete_file(const crow::request &req, const std::s
   }
 }
 
+crow::response Routes::create_search_response(std::string body,
+                                              magic_core::ResponseFormat format) {
+  crow::response resp(200, std::move(body));
+  resp.add_header("Content-Type", magic_core::SearchResponseEncoder::content_type(format));
+  // Caches have to key the body on what the client accepted
+  resp.add_header("Vary", "Accept");
+  return resp;
+}
+
+magic_core::ResponseFormat Routes::extract_response_format_from_request(
+    const crow::request &req) {
+  return magic_core::SearchResponseEncoder::negotiate(req.get_header_value("Accept"));
+}
+
+void Routes::compress_response(const crow::request &req, crow::response &res) {
+  if (res.body.size() < magic_core::ContentEncoder::MIN_COMPRESSED_SIZE ||
+      !res.get_header_value("Content-Encoding").empty()) {
+    return;
+  }
+  // Caches have to key bodies this large on what the client accepted, compressed or not
+  const std::string vary = res.get_header_value("Vary");
+  res.set_header("Vary", vary.empty() ? "Accept-Encoding" : vary + ", Accept-Encoding");
+  const magic_core::ContentEncoding encoding =
+      magic_core::ContentEncoder::negotiate(req.get_header_value("Accept-Encoding"));
+  if (encoding == magic_core::ContentEncoding::Identity) {
+    return;
+  }
+  try {
+    res.body = magic_core::ContentEncoder::encode(res.body, encoding);
+    res.set_header("Content-Encoding", magic_core::ContentEncoder::token(encoding));
+  } catch (const std::exception &e) {
+    // Still a valid response, just a bigger one
+    log::warning() << "Sending the response uncompressed: " << e.what();
+  }
+}
+
 crow::response Routes::create_json_response(const nlohmann::json &json_data, int status_code) {
   crow::response resp(status_code, json_data.dump(2));
   resp.add_header("Content-Type", "application/json");
@@ -267,79 +846,165 @@ int Routes::extract_top_k_from_request(const crow::request &req) {
   return json_body.value("top_k", 10);
 }
 
+std::pair<int64_t, int> Routes::extract_page_from_request(const crow::request &req) {
+  int64_t after_id = 0;
+  int limit = DEFAULT_PAGE_SIZE;
+  try {
+    if (const char *value = req.url_params.get("after_id")) {
+      after_id = std::stoll(value);
+    }
+    if (const char *value = req.url_params.get("limit")) {
+      limit = std::stoi(value);
+    }
+  } catch (const std::exception &) {
+    throw std::invalid_argument("after_id and limit must be integers");
+  }
+  if (after_id < 0 || limit <= 0 || limit > MAX_PAGE_SIZE) {
+    throw std::invalid_argument("after_id cannot be negative and limit must be between 1 and " +
+                                std::to_string(MAX_PAGE_SIZE));
+  }
+  return {after_id, limit};
+}
+
+magic_core::VectorSearchOptions Routes::extract_search_tuning_from_request(
+    const crow::request &req) {
+  auto json_body = parse_json_body(req.body);
+  magic_core::VectorSearchOptions tuning;
+  tuning.ef_search = json_body.value("ef_search", 0);
+  tuning.nprobe = json_body.value("nprobe", 0);
+  if ((json_body.contains("ef_search") && tuning.ef_search <= 0) ||
+      (json_body.contains("nprobe") && tuning.nprobe <= 0)) {
+    throw std::invalid_argument("ef_search and nprobe must be greater than 0");
+  }
+  if (tuning.ef_search > MAX_EF_SEARCH || tuning.nprobe > MAX_NPROBE) {
+    throw std::invalid_argument("ef_search must be at most " + std::to_string(MAX_EF_SEARCH) +
+                                " and nprobe at most " + std::to_string(MAX_NPROBE));
+  }
+  return tuning;
+}
+
+magic_core::ChunkContentOptions Routes::extract_chunk_content_from_request(
+    const crow::request &req) {
+  auto json_body = parse_json_body(req.body);
+  magic_core::ChunkContentOptions content;
+  const std::string mode = json_body.value("chunk_content", "full");
+  if (mode == "full") {
+    content.mode = magic_core::ChunkContentMode::Full;
+  } else if (mode == "snippet") {
+    content.mode = magic_core::ChunkContentMode::Snippet;
+  } else if (mode == "none") {
+    content.mode = magic_core::ChunkContentMode::None;
+  } else if (mode == "zstd") {
+    content.mode = magic_core::ChunkContentMode::Compressed;
+  } else {
+    throw std::invalid_argument("chunk_content must be one of full, snippet, none or zstd");
+  }
+  const int snippet_chars =
+      json_body.value("snippet_chars", static_cast<int>(content.snippet_chars));
+  if (snippet_chars <= 0) {
+    throw std::invalid_argument("snippet_chars must be greater than 0");
+  }
+  content.snippet_chars = static_cast<size_t>(snippet_chars);
+  return content;
+}
+
+magic_core::SearchMode Routes::extract_search_mode_from_request(const crow::request &req) {
+  auto json_body = parse_json_body(req.body);
+  const std::string mode = json_body.value("mode", "vector");
+  if (mode == "vector") {
+    return magic_core::SearchMode::Vector;
+  }
+  if (mode == "hybrid") {
+    return magic_core::SearchMode::Hybrid;
+  }
+  if (mode == "lexical") {
+    return magic_core::SearchMode::Lexical;
+  }
+  throw std::invalid_argument("mode must be one of vector, hybrid or lexical");
+}
+
+magic_core::SearchFilter Routes::extract_search_filter_from_request(const crow::request &req) {
+  auto json_body = parse_json_body(req.body);
+  magic_core::SearchFilter filter;
+  if (json_body.contains("file_types")) {
+    const auto &types = json_body["file_types"];
+    if (!types.is_array()) {
+      throw std::invalid_argument("file_types must be an array");
+    }
+    for (const auto &type : types) {
+      const std::string name = type.is_string() ? type.get<std::string>() : "";
+      const magic_core::FileType parsed = magic_core::file_type_from_string(name);
+      if (parsed == magic_core::FileType::Unknown && name != "Unknown") {
+        throw std::invalid_argument("file_types must hold Text, PDF, Markdown, Code or Unknown");
+      }
+      filter.file_types.push_back(parsed);
+    }
+  }
+  filter.path_prefix = json_body.value("path_prefix", "");
+  if (json_body.contains("collections")) {
+    const auto &collections = json_body["collections"];
+    if (!collections.is_array()) {
+      throw std::invalid_argument("collections must be an array of collection names");
+    }
+    for (const auto &collection : collections) {
+      if (!collection.is_string()) {
+        throw std::invalid_argument("collections must be an array of collection names");
+      }
+      filter.collections.push_back(collection.get<std::string>());
+    }
+  }
+  for (const auto &[field, bound] : {std::pair{"modified_after", &filter.modified_after},
+                                     std::pair{"modified_before", &filter.modified_before}}) {
+    if (json_body.contains(field)) {
+      if (!json_body[field].is_number_integer()) {
+        throw std::invalid_argument(std::string(field) + " must be epoch milliseconds");
+      }
+      *bound = std::chrono::system_clock::time_point(
+          std::chrono::milliseconds(json_body[field].get<int64_t>()));
+    }
+  }
+  return filter;
+}
+
 // ============================================================================
 // Task Management Route Handlers
 // ============================================================================
 
 crow::response Routes::handle_list_tasks(const crow::request &req) {
   try {
-    std::cout << "Listing tasks" << std::endl;
-    
+    log::info() << "Listing tasks";
+
     // Parse optional status filter from query parameters
     std::optional<magic_core::TaskStatus> status_filter;
     std::string query_string = req.url_params.get("status") ? req.url_params.get("status") : "";
-    
-    nlohmann::json tasks_json = nlohmann::json::array();
-    
     if (!query_string.empty()) {
-      // Filter by specific status
       try {
-        magic_core::TaskStatus status = magic_core::task_status_from_string(query_string);
-        auto tasks = task_queue_repo_->get_tasks_by_status(status);
-        
-        for (const auto &task : tasks) {
-          nlohmann::json task_json;
-          task_json["id"] = task.id;
-          task_json["task_type"] = task.task_type;
-          task_json["status"] = magic_core::to_string(task.status);
-          task_json["priority"] = task.priority;
-          task_json["target_path"] = task.target_path;
-          task_json["target_tag"] = task.target_tag;
-          task_json["payload"] = task.payload;
-          task_json["error_message"] = task.error_message;
-          task_json["created_at"] = magic_core::TaskQueueRepo::time_point_to_string(task.created_at);
-          task_json["updated_at"] = magic_core::TaskQueueRepo::time_point_to_string(task.updated_at);
-          tasks_json.push_back(task_json);
-        }
+        status_filter = magic_core::task_status_from_string(query_string);
       } catch (const std::exception &e) {
-        nlohmann::json error_response = create_error_response("Invalid status filter: " + query_string);
+        nlohmann::json error_response =
+            create_error_response("Invalid status filter: " + query_string);
         return create_json_response(error_response, 400);
       }
-    } else {
-      // Get all tasks by iterating through all statuses
-      std::vector<magic_core::TaskStatus> all_statuses = {
-        magic_core::TaskStatus::PENDING,
-        magic_core::TaskStatus::PROCESSING, 
-        magic_core::TaskStatus::COMPLETED,
-        magic_core::TaskStatus::FAILED
-      };
-      
-      for (const auto &status : all_statuses) {
-        auto tasks = task_queue_repo_->get_tasks_by_status(status);
-        for (const auto &task : tasks) {
-          nlohmann::json task_json;
-          task_json["id"] = task.id;
-          task_json["task_type"] = task.task_type;
-          task_json["status"] = magic_core::to_string(task.status);
-          task_json["priority"] = task.priority;
-          task_json["target_path"] = task.target_path;
-          task_json["target_tag"] = task.target_tag;
-          task_json["payload"] = task.payload;
-          task_json["error_message"] = task.error_message;
-          task_json["created_at"] = magic_core::TaskQueueRepo::time_point_to_string(task.created_at);
-          task_json["updated_at"] = magic_core::TaskQueueRepo::time_point_to_string(task.updated_at);
-          tasks_json.push_back(task_json);
-        }
-      }
     }
-    
+    const auto [after_id, limit] = extract_page_from_request(req);
+
+    auto tasks = task_queue_repo_->list_tasks_page(status_filter, after_id, limit);
+    nlohmann::json tasks_json = nlohmann::json::array();
+    for (const auto &task : tasks) {
+      tasks_json.push_back(task_to_json(task));
+    }
+
     nlohmann::json response = create_success_response("Tasks retrieved successfully");
     response["data"]["tasks"] = tasks_json;
     response["data"]["count"] = tasks_json.size();
-    
+    response["data"]["next_after_id"] =
+        static_cast<int>(tasks.size()) == limit ? nlohmann::json(tasks.back().id) : nullptr;
+
     return create_json_response(response);
+  } catch (const std::invalid_argument &e) {
+    return create_json_response(create_error_response(e.what()), 400);
   } catch (const std::exception &e) {
-    std::cerr << "Exception in handle_list_tasks: " << e.what() << std::endl;
+    log::error() << "Exception in handle_list_tasks: " << e.what();
     nlohmann::json error_response = create_error_response(e.what());
     return create_json_response(error_response, 500);
   }
@@ -347,41 +1012,16 @@ crow::response Routes::handle_list_tasks(const crow::request &req) {
 
 crow::response Routes::handle_get_task_status(const crow::request &req, const std::string &task_id) {
   try {
-    std::cout << "Getting task status for task ID: " << task_id << std::endl;
+    log::info() << "Getting task status for task ID: " << task_id;
     
     long long id = std::stoll(task_id);
     
-    // Get all tasks and find the matching one
-    std::vector<magic_core::TaskStatus> all_statuses = {
-      magic_core::TaskStatus::PENDING,
-      magic_core::TaskStatus::PROCESSING, 
-      magic_core::TaskStatus::COMPLETED,
-      magic_core::TaskStatus::FAILED
-    };
-    
-    for (const auto &status : all_statuses) {
-      auto tasks = task_queue_repo_->get_tasks_by_status(status);
-      for (const auto &task : tasks) {
-        if (task.id == id) {
-          nlohmann::json task_json;
-          task_json["id"] = task.id;
-          task_json["task_type"] = task.task_type;
-          task_json["status"] = magic_core::to_string(task.status);
-          task_json["priority"] = task.priority;
-          task_json["target_path"] = task.target_path;
-          task_json["target_tag"] = task.target_tag;
-          task_json["payload"] = task.payload;
-          task_json["error_message"] = task.error_message;
-          task_json["created_at"] = magic_core::TaskQueueRepo::time_point_to_string(task.created_at);
-          task_json["updated_at"] = magic_core::TaskQueueRepo::time_point_to_string(task.updated_at);
-          
-          nlohmann::json response = create_success_response("Task status retrieved successfully");
-          response["data"] = task_json;
-          return create_json_response(response);
-        }
-      }
+    if (auto task = task_queue_repo_->get_task(id)) {
+      nlohmann::json response = create_success_response("Task status retrieved successfully");
+      response["data"] = task_to_json(*task);
+      return create_json_response(response);
     }
-    
+
     nlohmann::json error_response = create_error_response("Task not found");
     return create_json_response(error_response, 404);
     
@@ -389,7 +1029,7 @@ crow::response Routes::handle_get_task_status(const crow::request &req, const st
     nlohmann::json error_response = create_error_response("Invalid task ID format");
     return create_json_response(error_response, 400);
   } catch (const std::exception &e) {
-    std::cerr << "Exception in handle_get_task_status: " << e.what() << std::endl;
+    log::error() << "Exception in handle_get_task_status: " << e.what();
     nlohmann::json error_response = create_error_response(e.what());
     return create_json_response(error_response, 500);
   }
@@ -397,7 +1037,7 @@ crow::response Routes::handle_get_task_status(const crow::request &req, const st
 
 crow::response Routes::handle_get_task_progress(const crow::request &req, const std::string &task_id) {
   try {
-    std::cout << "Getting task progress for task ID: " << task_id << std::endl;
+    log::info() << "Getting task progress for task ID: " << task_id;
     
     long long id = std::stoll(task_id);
     auto progress = task_queue_repo_->get_task_progress(id);
@@ -421,15 +1061,158 @@ crow::response Routes::handle_get_task_progress(const crow::request &req, const
     nlohmann::json error_response = create_error_response("Invalid task ID format");
     return create_json_response(error_response, 400);
   } catch (const std::exception &e) {
-    std::cerr << "Exception in handle_get_task_progress: " << e.what() << std::endl;
+    log::error() << "Exception in handle_get_task_progress: " << e.what();
     nlohmann::json error_response = create_error_response(e.what());
     return create_json_response(error_response, 500);
   }
 }
 
+void Routes::handle_task_stream(crow::websocket::connection &conn, const std::string &message) {
+  auto send_error = [&conn](const std::string &error, std::optional<long long> task_id = {}) {
+    nlohmann::json event;
+    event["event"] = "error";
+    event["error"] = error;
+    if (task_id) {
+      event["task_id"] = *task_id;
+    }
+    conn.send_text(event.dump());
+  };
+  std::vector<long long> subscribe;
+  std::vector<long long> unsubscribe;
+  try {
+    auto json_body = parse_json_body(message);
+    subscribe = json_body.value("subscribe", std::vector<long long>{});
+    unsubscribe = json_body.value("unsubscribe", std::vector<long long>{});
+  } catch (const std::exception &e) {
+    send_error(std::string("Expected {\"subscribe\": [ids], \"unsubscribe\": [ids]}: ") +
+               e.what());
+    return;
+  }
+  if (!task_queue_repo_) {
+    send_error("Tasks are not available");
+    return;
+  }
+
+  for (long long task_id : unsubscribe) {
+    task_streams_->unsubscribe(&conn, task_id);
+  }
+  for (long long task_id : subscribe) {
+    // The state is read and sent under the lock publish() takes, so an update the read missed
+    // is sent after it and one it already holds can never be overtaken by it
+    std::lock_guard<std::mutex> lock(task_streams_->mutex);
+    auto &followed = task_streams_->by_connection[&conn];
+    if (!followed.count(task_id) && followed.size() >= MAX_TASK_SUBSCRIPTIONS) {
+      send_error("A connection follows at most " + std::to_string(MAX_TASK_SUBSCRIPTIONS) +
+                     " tasks",
+                 task_id);
+      continue;
+    }
+    // One read per subscription, where polling read the task every second
+    try {
+      auto task = task_queue_repo_->get_task(task_id);
+      if (!task) {
+        send_error("Task not found", task_id);
+        continue;
+      }
+      magic_core::TaskUpdate current{task_id, task->status, 0.0f,
+                                     task->error_message.value_or("")};
+      if (auto progress = task_queue_repo_->get_task_progress(task_id)) {
+        current.progress_percent = progress->progress_percent;
+        if (task->status != magic_core::TaskStatus::FAILED) {
+          current.message = progress->status_message;
+        }
+      }
+      conn.send_text(task_update_event(current));
+      if (!is_finished(task->status)) {
+        followed.insert(task_id);
+        task_streams_->by_task[task_id].insert(&conn);
+      }
+    } catch (const std::exception &e) {
+      send_error(e.what(), task_id);
+    }
+  }
+}
+
+void Routes::TaskSubscriptions::publish(const magic_core::TaskUpdate &update) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = by_task.find(update.task_id);
+  if (it == by_task.end()) {
+    return;
+  }
+  // Crow queues the frame on each connection's own thread, so a worker never waits on a client
+  const std::string event = task_update_event(update);
+  for (crow::websocket::connection *conn : it->second) {
+    conn->send_text(event);
+  }
+  if (is_finished(update.status)) {
+    for (crow::websocket::connection *conn : it->second) {
+      by_connection[conn].erase(update.task_id);
+    }
+    by_task.erase(it);
+  }
+}
+
+void Routes::TaskSubscriptions::unsubscribe(crow::websocket::connection *conn, long long task_id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = by_task.find(task_id);
+  if (it != by_task.end()) {
+    it->second.erase(conn);
+    if (it->second.empty()) {
+      by_task.erase(it);
+    }
+  }
+  auto followed = by_connection.find(conn);
+  if (followed != by_connection.end()) {
+    followed->second.erase(task_id);
+  }
+}
+
+void Routes::TaskSubscriptions::remove(crow::websocket::connection *conn) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto followed = by_connection.find(conn);
+  if (followed == by_connection.end()) {
+    return;
+  }
+  for (long long task_id : followed->second) {
+    auto it = by_task.find(task_id);
+    if (it != by_task.end()) {
+      it->second.erase(conn);
+      if (it->second.empty()) {
+        by_task.erase(it);
+      }
+    }
+  }
+  by_connection.erase(followed);
+}
+
+crow::response Routes::handle_snapshot(const crow::request &req) {
+  try {
+    const nlohmann::json body = parse_json_body(req.body);
+    const std::string path = body.value("path", "");
+    if (path.empty()) {
+      return create_json_response(create_error_response("path is required"), 400);
+    }
+    // The worker may run in another directory than this request
+    const std::string destination = std::filesystem::absolute(path).lexically_normal().string();
+    if (std::filesystem::exists(destination)) {
+      return create_json_response(create_error_response(destination + " already exists"), 400);
+    }
+    log::info() << "Snapshot requested to " << destination;
+    long long task_id = task_queue_repo_->create_tagged_task("SNAPSHOT", destination,
+                                                             magic_core::TaskPriority::BULK);
+    nlohmann::json data;
+    data["task_id"] = task_id;
+    data["path"] = destination;
+    return create_json_response(create_success_response("Snapshot queued", data));
+  } catch (const std::exception &e) {
+    log::error() << "Exception in handle_snapshot: " << e.what();
+    return create_json_response(create_error_response(e.what()), 400);
+  }
+}
+
 crow::response Routes::handle_clear_completed_tasks(const crow::request &req) {
   try {
-    std::cout << "Clearing completed tasks" << std::endl;
+    log::info() << "Clearing completed tasks";
     
     // Parse optional days parameter from request body
     int older_than_days = 7; // Default
@@ -439,7 +1222,7 @@ crow::response Routes::handle_clear_completed_tasks(const crow::request &req) {
         older_than_days = json_body.value("older_than_days", 7);
       } catch (const std::exception &e) {
         // If JSON parsing fails, use default value
-        std::cout << "Using default older_than_days value due to parsing error: " << e.what() << std::endl;
+        log::info() << "Using default older_than_days value due to parsing error: " << e.what();
       }
     }
     
@@ -450,10 +1233,98 @@ crow::response Routes::handle_clear_completed_tasks(const crow::request &req) {
     return create_json_response(response);
     
   } catch (const std::exception &e) {
-    std::cerr << "Exception in handle_clear_completed_tasks: " << e.what() << std::endl;
+    log::error() << "Exception in handle_clear_completed_tasks: " << e.what();
     nlohmann::json error_response = create_error_response(e.what());
     return create_json_response(error_response, 500);
   }
 }
 
+crow::response Routes::handle_claim_tasks(const crow::request &req) {
+  try {
+    auto json_body = parse_json_body(req.body);
+    std::string worker = json_body.value("worker", "");
+    int max_tasks = std::clamp(json_body.value("max_tasks", 1), 1, MAX_CLAIMED_TASKS);
+    magic_core::TaskLane lane =
+        magic_core::task_lane_from_string(json_body.value("lane", std::string("any")));
+
+    nlohmann::json tasks = nlohmann::json::array();
+    for (const auto &remote : remote_task_service_->claim_tasks(worker, max_tasks, lane)) {
+      nlohmann::json task_json;
+      task_json["id"] = remote.task.id;
+      task_json["task_type"] = remote.task.task_type;
+      task_json["priority"] = remote.task.priority;
+      task_json["target_path"] = remote.task.target_path;
+      task_json["attempts"] = remote.task.attempts;
+      task_json["stored_chunk_hashes"] = remote.stored_chunk_hashes;
+      tasks.push_back(task_json);
+    }
+    nlohmann::json data;
+    data["tasks"] = tasks;
+    data["lease_ms"] = task_queue_repo_->lease_duration().count();
+    return create_json_response(create_success_response("Tasks claimed", data));
+  } catch (const std::exception &e) {
+    log::error() << "Exception in handle_claim_tasks: " << e.what();
+    return create_json_response(create_error_response(e.what()), 400);
+  }
+}
+
+crow::response Routes::handle_renew_task_lease(const crow::request &req,
+                                               const std::string &task_id) {
+  try {
+    auto json_body = parse_json_body(req.body);
+    remote_task_service_->report_progress(std::stoll(task_id), json_body.value("worker", ""),
+                                          json_body.value("percent", 0.0f),
+                                          json_body.value("message", std::string()));
+    return create_json_response(create_success_response("Lease renewed"));
+  } catch (const magic_core::TaskLeaseLostError &e) {
+    return create_json_response(create_error_response(e.what()), 409);
+  } catch (const std::exception &e) {
+    log::error() << "Exception in handle_renew_task_lease: " << e.what();
+    return create_json_response(create_error_response(e.what()), 400);
+  }
+}
+
+crow::response Routes::handle_complete_task(const crow::request &req, const std::string &task_id) {
+  try {
+    auto json_body = parse_json_body(req.body);
+    std::vector<magic_core::RemoteChunk> chunks;
+    for (const auto &chunk_json : json_body.value("chunks", nlohmann::json::array())) {
+      magic_core::RemoteChunk chunk;
+      chunk.chunk_index = chunk_json.at("chunk_index").get<int>();
+      chunk.content = chunk_json.at("content").get<std::string>();
+      chunk.vector_embedding = chunk_json.value("embedding", std::vector<float>{});
+      chunks.push_back(std::move(chunk));
+    }
+    remote_task_service_->complete_file_task(std::stoll(task_id), json_body.value("worker", ""),
+                                             std::move(chunks),
+                                             json_body.value("embedding_model", std::string()));
+    return create_json_response(create_success_response("Task completed"));
+  } catch (const magic_core::TaskLeaseLostError &e) {
+    return create_json_response(create_error_response(e.what()), 409);
+  } catch (const magic_core::EmbeddingModelMismatchError &e) {
+    return create_json_response(create_error_response(e.what()), 400);
+  } catch (const std::invalid_argument &e) {
+    return create_json_response(create_error_response(e.what()), 400);
+  } catch (const nlohmann::json::exception &e) {
+    return create_json_response(create_error_response(e.what()), 400);
+  } catch (const std::exception &e) {
+    log::error() << "Exception in handle_complete_task: " << e.what();
+    return create_json_response(create_error_response(e.what()), 500);
+  }
+}
+
+crow::response Routes::handle_fail_task(const crow::request &req, const std::string &task_id) {
+  try {
+    auto json_body = parse_json_body(req.body);
+    remote_task_service_->fail_task(std::stoll(task_id), json_body.value("worker", ""),
+                                    json_body.value("error", std::string("Remote worker failed")));
+    return create_json_response(create_success_response("Task marked as failed"));
+  } catch (const magic_core::TaskLeaseLostError &e) {
+    return create_json_response(create_error_response(e.what()), 409);
+  } catch (const std::exception &e) {
+    log::error() << "Exception in handle_fail_task: " << e.what();
+    return create_json_response(create_error_response(e.what()), 400);
+  }
+}
+
 }  // namespace magic_api
\ No newline at end of file
@@ -1,14 +1,17 @@
 #include "magic_api/server.hpp"
 
 namespace magic_api {
-Server::Server(const std::string &host, int port) : host_(host), port_(port), running_(false) {}
+Server::Server(const std::string &host, int port, int threads)
+    : host_(host), port_(port), threads_(threads), running_(false) {}
 void Server::start() {
   if (running_) {
     return;
   }
   running_ = true;
   server_thread_future_ =
-      std::async(std::launch::async, [this] { app_.port(port_).bindaddr(host_).run(); });
+      std::async(std::launch::async, [this] {
+    app_.port(port_).bindaddr(host_).concurrency(static_cast<uint16_t>(threads_)).run();
+  });
 }
 
 void Server::stop() {
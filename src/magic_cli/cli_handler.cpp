@@ -1,10 +1,42 @@
 #include "magic_cli/cli_handler.hpp"
+#include <fstream>
 #include <iostream>
 #include <iomanip> // Required for std::fixed and std::setprecision
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace magic_cli {
 
+namespace {
+
+// One of the easy handles a batch keeps in flight. Each is reused for request after request,
+// and the multi handle keeps their connections alive in between.
+struct BatchTransfer {
+    CURL* easy = nullptr;
+    curl_slist* headers = nullptr;
+    size_t line = 0;
+    std::string input;
+    std::string request_body;
+    std::string response_buffer;
+
+    BatchTransfer() {
+        easy = curl_easy_init();
+        if (!easy) {
+            throw CliError("Failed to initialize CURL");
+        }
+        headers = curl_slist_append(nullptr, "Content-Type: application/json");
+    }
+    ~BatchTransfer() {
+        curl_slist_free_all(headers);
+        curl_easy_cleanup(easy);
+    }
+    BatchTransfer(const BatchTransfer&) = delete;
+    BatchTransfer& operator=(const BatchTransfer&) = delete;
+};
+
+}  // namespace
+
 CliHandler::CliHandler(const std::string& api_base_url)
     : api_base_url_(api_base_url), curl_handle_(nullptr) {
     setup_curl_handle();
@@ -53,6 +85,9 @@ CliOptions CliHandler::parse_arguments(int argc, char* argv[]) {
     options.help = false;
     options.magic_search = true;  // Default to magic search
     options.older_than_days = 7;  // Default for clearing tasks
+    options.bulk_load = false;
+    options.batch_command = Command::Help;
+    options.parallel = 8;
     
     if (argc < 2) {
         options.command = Command::Help;
@@ -63,20 +98,32 @@ CliOptions CliHandler::parse_arguments(int argc, char* argv[]) {
     
     if (command == "process" || command == "p") {
         options.command = Command::Process;
+        const std::string usage =
+            "Usage: process --file <path> | process --dir <path> [--bulk]";
         if (argc < 4) {
-            throw CliError("Process command requires a file path. Usage: process --file <path>");
+            throw CliError("Process command requires a file or directory path. " + usage);
         }
-        for (int i = 2; i < argc; i += 2) {
-            if (i + 1 >= argc) break;
+        for (int i = 2; i < argc; ++i) {
             std::string flag = argv[i];
-            std::string value = argv[i + 1];
-            
+            // --bulk is the one flag without a value
+            if (flag == "--bulk" || flag == "-b") {
+                options.bulk_load = true;
+                continue;
+            }
+            if (i + 1 >= argc) break;
+            std::string value = argv[++i];
+
             if (flag == "--file" || flag == "-f") {
                 options.file_path = value;
+            } else if (flag == "--dir" || flag == "-d") {
+                options.dir_path = value;
             }
         }
-        if (options.file_path.empty()) {
-            throw CliError("Process command requires a file path. Usage: process --file <path>");
+        if (options.file_path.empty() == options.dir_path.empty()) {
+            throw CliError("Process command requires exactly one of --file or --dir. " + usage);
+        }
+        if (options.bulk_load && options.dir_path.empty()) {
+            throw CliError("--bulk only applies to --dir. " + usage);
         }
     } else if (command == "search" || command == "s") {
         options.command = Command::Search;
@@ -180,6 +227,54 @@ CliOptions CliHandler::parse_arguments(int argc, char* argv[]) {
                 options.older_than_days = std::stoi(value);
             }
         }
+    } else if (command == "snapshot") {
+        options.command = Command::Snapshot;
+        for (int i = 2; i < argc; i += 2) {
+            if (i + 1 >= argc) break;
+            std::string flag = argv[i];
+            std::string value = argv[i + 1];
+
+            if (flag == "--dir" || flag == "-d") {
+                options.dir_path = value;
+            }
+        }
+        if (options.dir_path.empty()) {
+            throw CliError("Snapshot command requires a directory. Usage: snapshot --dir <path>");
+        }
+    } else if (command == "batch" || command == "b") {
+        options.command = Command::Batch;
+        const std::string usage =
+            "Usage: batch <process|search|filesearch> [--input <file>] [--parallel <n>] "
+            "[--top-k <num>]";
+        if (argc < 3) {
+            throw CliError("Batch command requires the command to run per line. " + usage);
+        }
+        std::string batch_command = argv[2];
+        if (batch_command == "process" || batch_command == "p") {
+            options.batch_command = Command::Process;
+        } else if (batch_command == "search" || batch_command == "s") {
+            options.batch_command = Command::Search;
+        } else if (batch_command == "filesearch" || batch_command == "fs") {
+            options.batch_command = Command::FileSearch;
+        } else {
+            throw CliError("Batch command cannot run '" + batch_command + "'. " + usage);
+        }
+        for (int i = 3; i < argc; i += 2) {
+            if (i + 1 >= argc) break;
+            std::string flag = argv[i];
+            std::string value = argv[i + 1];
+
+            if (flag == "--input" || flag == "-i") {
+                options.input_path = value;
+            } else if (flag == "--parallel" || flag == "-j") {
+                options.parallel = std::stoi(value);
+            } else if (flag == "--top-k" || flag == "-k") {
+                options.top_k = std::stoi(value);
+            }
+        }
+        if (options.parallel <= 0) {
+            throw CliError("--parallel must be greater than 0. " + usage);
+        }
     } else if (command == "help" || command == "h" || command == "--help" || command == "-h") {
         options.command = Command::Help;
     } else {
@@ -225,10 +320,31 @@ void CliHandler::execute_command(const CliOptions& options) {
         case Command::ClearTasks:
             handle_clear_tasks_command(options);
             break;
+        case Command::Snapshot:
+            handle_snapshot_command(options);
+            break;
+        case Command::Batch:
+            handle_batch_command(options);
+            break;
     }
 }
 
 void CliHandler::handle_process_command(const CliOptions& options) {
+    if (!options.dir_path.empty()) {
+        std::cout << "Processing directory: " << options.dir_path << std::endl;
+        nlohmann::json request_data = {
+            {"directory_path", options.dir_path},
+            {"bulk_load", options.bulk_load}
+        };
+        try {
+            nlohmann::json response = make_post_request("/process_directory", request_data);
+            print_json_response(response);
+        } catch (const std::exception& e) {
+            print_error("Failed to process directory: " + std::string(e.what()));
+        }
+        return;
+    }
+
     std::cout << "Processing file: " << options.file_path << std::endl;
     
     nlohmann::json request_data = {
@@ -300,6 +416,140 @@ void CliHandler::handle_help_command(const CliOptions& options) {
     print_help();
 }
 
+void CliHandler::handle_batch_command(const CliOptions& options) {
+    std::ifstream input_file;
+    if (!options.input_path.empty()) {
+        input_file.open(options.input_path);
+        if (!input_file.is_open()) {
+            throw CliError("Failed to open batch input: " + options.input_path);
+        }
+    }
+    std::istream& input = options.input_path.empty() ? std::cin : input_file;
+
+    std::string url;
+    switch (options.batch_command) {
+        case Command::Process:
+            url = build_url("/process_file");
+            break;
+        case Command::Search:
+            url = build_url("/search");
+            break;
+        default:
+            url = build_url("/files/search");
+            break;
+    }
+    auto request_for = [&](const std::string& line) {
+        if (options.batch_command == Command::Process) {
+            return nlohmann::json{{"file_path", line}};
+        }
+        return nlohmann::json{{"query", line}, {"top_k", options.top_k}};
+    };
+
+    CURLM* multi = curl_multi_init();
+    if (!multi) {
+        throw CliError("Failed to initialize CURL");
+    }
+    // Requests share options.parallel connections; over HTTP/2 they are multiplexed on one
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(options.parallel));
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    std::vector<std::unique_ptr<BatchTransfer>> transfers;
+    std::vector<BatchTransfer*> idle;
+    for (int i = 0; i < options.parallel; ++i) {
+        transfers.push_back(std::make_unique<BatchTransfer>());
+        idle.push_back(transfers.back().get());
+    }
+
+    size_t line_number = 0;
+    size_t requests = 0;
+    size_t failures = 0;
+    bool input_done = false;
+    int running = 0;
+    std::string line;
+    while (true) {
+        // Keep every idle handle busy while there is input left
+        while (!idle.empty() && !input_done) {
+            if (!std::getline(input, line)) {
+                input_done = true;
+                break;
+            }
+            ++line_number;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                continue;
+            }
+            BatchTransfer* transfer = idle.back();
+            idle.pop_back();
+            transfer->line = line_number;
+            transfer->input = line;
+            transfer->request_body = request_for(line).dump();
+            transfer->response_buffer.clear();
+
+            CURL* easy = transfer->easy;
+            curl_easy_reset(easy);
+            curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDS, transfer->request_body.c_str());
+            curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->headers);
+            curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, write_callback);
+            curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->response_buffer);
+            curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+            curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer);
+            curl_multi_add_handle(multi, easy);
+            ++requests;
+        }
+        if (input_done && idle.size() == transfers.size()) {
+            break;
+        }
+
+        curl_multi_perform(multi, &running);
+        int messages_left = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi, &messages_left)) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+            char* private_data = nullptr;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &private_data);
+            auto* transfer = reinterpret_cast<BatchTransfer*>(private_data);
+            long http_code = 0;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE, &http_code);
+
+            nlohmann::json result = {{"line", transfer->line}, {"input", transfer->input}};
+            if (message->data.result != CURLE_OK) {
+                result["error"] = "CURL request failed: " +
+                                  std::string(curl_easy_strerror(message->data.result));
+            } else {
+                result["status"] = http_code;
+                nlohmann::json response =
+                    nlohmann::json::parse(transfer->response_buffer, nullptr, false);
+                result["response"] =
+                    response.is_discarded() ? nlohmann::json(transfer->response_buffer) : response;
+                if (http_code != 200) {
+                    result["error"] =
+                        "HTTP request failed with status code: " + std::to_string(http_code);
+                }
+            }
+            failures += result.contains("error") ? 1 : 0;
+            // One line per result, flushed so a consumer sees it as soon as it arrives
+            std::cout << result.dump() << std::endl;
+
+            curl_multi_remove_handle(multi, message->easy_handle);
+            idle.push_back(transfer);
+        }
+        if (running > 0) {
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+    }
+
+    transfers.clear();
+    curl_multi_cleanup(multi);
+    if (options.verbose || failures > 0) {
+        std::cerr << "Batch: " << requests << " request(s), " << failures << " failed"
+                  << std::endl;
+    }
+}
+
 nlohmann::json CliHandler::make_get_request(const std::string& endpoint) {
     if (!curl_handle_) {
         throw CliError("CURL handle not initialized");
@@ -497,8 +747,10 @@ Magic Folder CLI - Intelligent File Management System
 Usage: magic_cli <command> [options]
 
 File Management Commands:
-  process, p    Process a file for indexing
+  process, p    Process a file, or every file in a directory, for indexing
     --file, -f <path>    Path to the file to process
+    --dir, -d <path>     Directory to walk recursively
+    --bulk, -b           With --dir: defer index updates until the import has drained
 
   search, s     Magic search for files and chunks using semantic search
     --query, -q <query>  Search query
@@ -511,6 +763,13 @@ File Management Commands:
 
   list, l       List all indexed files
 
+  batch, b      Run process, search or filesearch for every line of input, printing
+                one NDJSON result per line as it completes
+    <process|search|filesearch>  What each line is: a file path or a query
+    --input, -i <file>   Read the lines from a file instead of stdin
+    --parallel, -j <n>   Requests kept in flight over keep-alive connections (default: 8)
+    --top-k, -k <num>    Number of results per search (default: 5)
+
 Task Management Commands:
   tasks, lt     List all tasks in the queue
     --status, -s <status>  Filter by task status (PENDING, PROCESSING, COMPLETED, FAILED)
@@ -524,6 +783,9 @@ Task Management Commands:
   clear-tasks, ct   Clear completed and failed tasks
     --days, -d <num>       Clear tasks older than N days (default: 7)
 
+  snapshot      Back up the databases, vectors and indexes while the server runs
+    --dir, -d <path>       New directory the snapshot is written to, on the server's disk
+
 General:
   help, h       Show this help message
 
@@ -533,10 +795,14 @@ Environment Variables:
 Examples:
   # File operations
   magic_cli process --file /path/to/document.txt
+  magic_cli process --dir /path/to/notes
+  magic_cli process --dir /path/to/archive --bulk
   magic_cli search --query "machine learning algorithms" --top-k 10
   magic_cli search --query "python code" --files-only
   magic_cli filesearch --query "documentation" --top-k 5
   magic_cli list
+  find /path/to/notes -name '*.md' | magic_cli batch process
+  magic_cli batch search --input queries.txt --parallel 16 > results.ndjson
 
   # Task management
   magic_cli tasks                           # List all tasks
@@ -544,6 +810,7 @@ Examples:
   magic_cli task-status --id 123           # Get status of task 123
   magic_cli task-progress --id 123         # Get progress of task 123
   magic_cli clear-tasks --days 30          # Clear tasks older than 30 days
+  magic_cli snapshot --dir /backups/today  # Queue a snapshot, then follow it with task-progress
 )" << std::endl;
 }
 
@@ -614,6 +881,21 @@ void CliHandler::handle_clear_tasks_command(const CliOptions& options) {
     }
 }
 
+void CliHandler::handle_snapshot_command(const CliOptions& options) {
+    std::cout << "Requesting a snapshot to: " << options.dir_path << std::endl;
+
+    nlohmann::json request_data = {
+        {"path", options.dir_path}
+    };
+
+    try {
+        nlohmann::json response = make_post_request("/snapshot", request_data);
+        print_json_response(response);
+    } catch (const std::exception& e) {
+        print_error("Failed to request a snapshot: " + std::string(e.what()));
+    }
+}
+
 // ============================================================================
 // Task Management Response Printers
 // ============================================================================
@@ -0,0 +1,59 @@
+#include "magic_core/async/bounded_executor.hpp"
+
+#include <exception>
+#include <utility>
+
+#include "magic_core/types/logger.hpp"
+
+namespace magic_core::async {
+
+BoundedExecutor::BoundedExecutor(std::string name, size_t threads, size_t queue_depth)
+    : name_(std::move(name)), queue_(queue_depth) {
+  if (threads == 0) {
+    threads = 1;
+  }
+  threads_.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this] { thread_loop(); });
+  }
+}
+
+BoundedExecutor::~BoundedExecutor() {
+  shutdown();
+}
+
+bool BoundedExecutor::try_submit(Job job) {
+  if (!queue_.try_push(std::move(job))) {
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void BoundedExecutor::shutdown() {
+  if (shut_down_.exchange(true)) {
+    return;
+  }
+  queue_.close();
+  for (auto &thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+void BoundedExecutor::thread_loop() {
+  while (std::optional<Job> job = queue_.pop()) {
+    active_.fetch_add(1, std::memory_order_relaxed);
+    try {
+      (*job)();
+    } catch (const std::exception &e) {
+      log::warning() << name_ << " job failed: " << e.what();
+    } catch (...) {
+      log::warning() << name_ << " job failed with an unknown error";
+    }
+    active_.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace magic_core::async
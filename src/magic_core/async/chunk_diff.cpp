@@ -0,0 +1,53 @@
+#include "magic_core/async/chunk_diff.hpp"
+
+namespace magic_core {
+
+ChunkMatcher::ChunkMatcher(std::vector<StoredChunk> stored) : stored_(std::move(stored)) {
+  for (size_t s = 0; s < stored_.size(); ++s) {
+    // Stored vectors are read at the store's dimension or not at all
+    if (!stored_[s].content_hash.empty() && !stored_[s].vector_embedding.empty()) {
+      by_hash_[stored_[s].content_hash].push_back(s);
+    } else {
+      unusable_.push_back(stored_[s].id);
+    }
+  }
+}
+
+std::optional<int64_t> ChunkMatcher::match(Chunk& chunk, const std::string& content_hash) {
+  auto it = by_hash_.find(content_hash);
+  if (it == by_hash_.end() || it->second.empty()) {
+    return std::nullopt;
+  }
+  StoredChunk& row = stored_[it->second.front()];
+  it->second.pop_front();
+  chunk.vector_embedding = std::move(row.vector_embedding);
+  return row.id;
+}
+
+std::vector<int64_t> ChunkMatcher::unmatched() const {
+  std::vector<int64_t> ids = unusable_;
+  for (const auto& [hash, rows] : by_hash_) {
+    for (size_t s : rows) {
+      ids.push_back(stored_[s].id);
+    }
+  }
+  return ids;
+}
+
+ChunkDiff diff_chunks(std::vector<Chunk>& chunks,
+                      const std::vector<std::string>& content_hashes,
+                      std::vector<StoredChunk> stored) {
+  ChunkDiff diff;
+  ChunkMatcher matcher(std::move(stored));
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (auto id = matcher.match(chunks[i], content_hashes[i])) {
+      diff.kept.emplace_back(*id, chunks[i].chunk_index);
+    } else {
+      diff.fresh.push_back(i);
+    }
+  }
+  diff.removed_ids = matcher.unmatched();
+  return diff;
+}
+
+}  // namespace magic_core
@@ -0,0 +1,99 @@
+#include "magic_core/async/memory_budget.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "magic_core/types/metrics.hpp"
+
+namespace magic_core::async {
+
+namespace {
+
+metrics::Gauge &reserved_gauge() {
+  static metrics::Gauge &gauge = metrics::gauge(
+      "magic_memory_budget_reserved_bytes", "Bytes of the memory budget reserved by tasks");
+  return gauge;
+}
+
+metrics::Counter &waits_counter() {
+  static metrics::Counter &counter = metrics::counter(
+      "magic_memory_budget_waits_total", "Reservations that had to wait for the memory budget");
+  return counter;
+}
+
+}  // namespace
+
+void MemoryBudget::Reservation::release() noexcept {
+  if (budget_) {
+    budget_->release(bytes_);
+    budget_ = nullptr;
+    bytes_ = 0;
+  }
+}
+
+MemoryBudget::MemoryBudget(size_t capacity_bytes) : capacity_(capacity_bytes) {
+  if (capacity_bytes == 0) {
+    throw std::invalid_argument("A memory budget needs a capacity above 0");
+  }
+}
+
+bool MemoryBudget::admits(std::list<size_t>::iterator waiter) const {
+  return waiter == waiters_.begin() && reserved_ + *waiter <= capacity_;
+}
+
+MemoryBudget::Reservation MemoryBudget::reserve(size_t bytes,
+                                                const std::function<void()> &still_waiting,
+                                                std::chrono::steady_clock::duration interval) {
+  bytes = std::min(bytes, capacity_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto waiter = waiters_.insert(waiters_.end(), bytes);
+  if (!admits(waiter)) {
+    waits_counter().add();
+    auto next_report = std::chrono::steady_clock::now() + interval;
+    try {
+      while (!admits(waiter)) {
+        if (changed_.wait_until(lock, next_report) == std::cv_status::timeout && still_waiting) {
+          lock.unlock();
+          still_waiting();
+          lock.lock();
+          next_report = std::chrono::steady_clock::now() + interval;
+        }
+      }
+    } catch (...) {
+      // Unlocked only while still_waiting runs, which is where anything can throw
+      if (!lock.owns_lock()) {
+        lock.lock();
+      }
+      waiters_.erase(waiter);
+      changed_.notify_all();
+      throw;
+    }
+  }
+  waiters_.erase(waiter);
+  reserved_ += bytes;
+  reserved_gauge().add(static_cast<double>(bytes));
+  // The next in line may fit as well
+  changed_.notify_all();
+  return Reservation(this, bytes);
+}
+
+void MemoryBudget::release(size_t bytes) noexcept {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reserved_ -= bytes;
+  }
+  reserved_gauge().add(-static_cast<double>(bytes));
+  changed_.notify_all();
+}
+
+size_t MemoryBudget::reserved() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return reserved_;
+}
+
+size_t MemoryBudget::waiting() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return waiters_.size();
+}
+
+}  // namespace magic_core::async
@@ -1,18 +1,38 @@
 #include "magic_core/async/process_file_task.hpp"
 
-#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <iomanip>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <system_error>
+#include <utility>
 #include <vector>
 
+#include "magic_core/async/chunk_diff.hpp"
+#include "magic_core/async/memory_budget.hpp"
 #include "magic_core/async/service_provider.hpp"
+#include "magic_core/async/summarize_file_task.hpp"
+#include "magic_core/async/work_stealing_executor.hpp"
+#include "magic_core/db/embedding_cache.hpp"
 #include "magic_core/db/metadata_store.hpp"
+#include "magic_core/db/near_duplicate_index.hpp"
+#include "magic_core/db/task_queue_repo.hpp"
 #include "magic_core/extractors/content_extractor.hpp"
 #include "magic_core/extractors/content_extractor_factory.hpp"
 #include "magic_core/llm/ollama_client.hpp"
 #include "magic_core/services/compression_service.hpp"
 #include "magic_core/types/chunk.hpp"
+#include "magic_core/types/trace.hpp"
+#include "magic_core/types/vector_math.hpp"
 
 namespace magic_core {
 
@@ -24,105 +44,629 @@ ProcessFileTask::ProcessFileTask(long long id,
                                  std::string file_path)
     : ITask(id, status, created_at, updated_at, error_message), file_path_(std::move(file_path)) {}
 
-void ProcessFileTask::execute(ServiceProvider& services, const ProgressUpdater& on_progress) {
-  on_progress(0.0f, "Starting processing...");
 
-  // 1. Get file metadata:
-  MetadataStore& store = services.get_metadata_store();
-  std::optional<FileMetadata> metadata = store.get_file_metadata(file_path_);
-  if (!metadata) {
-    throw std::runtime_error("Could not find file metadata for path: " + file_path_);
+// --- Private Helper Methods for Clarity ---
+
+namespace {
+
+// Items processed and time spent working (not waiting) by one pipeline stage
+class StageMeter {
+ public:
+  void record(size_t items, std::chrono::steady_clock::duration busy) {
+    items_ += items;
+    busy_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count();
   }
-  store.update_file_processing_status(metadata->id, ProcessingStatus::PROCESSING);
-  on_progress(0.05f, "File metadata loaded.");
 
-  // 2. Extract content and chunks
-  ContentExtractorFactory& factory = services.get_extractor_factory();
-  const ContentExtractor& extractor = factory.get_extractor_for(metadata->path);
-  ExtractionResult extraction_result = extractor.extract_with_hash(metadata->path);
-  on_progress(0.1f, "Content extracted.");
+  // Throughput while busy, in items per second
+  double rate() const {
+    const long long busy_ns = busy_ns_.load();
+    return busy_ns > 0 ? static_cast<double>(items_.load()) * 1e9 / busy_ns : 0.0;
+  }
 
-  // 3. Process chunks, get embeddings, and save in batches
-  process_chunks_in_batches(metadata->id, extraction_result.chunks, services, on_progress);
+ private:
+  std::atomic<size_t> items_{0};
+  std::atomic<long long> busy_ns_{0};
+};
 
-  // 4. Calculate and store the final document-level embedding
-  finalize_document_embedding(metadata->id, extraction_result.chunks, store);
-  on_progress(0.95f, "Document summary embedding stored.");
+std::string format_rate(double rate) {
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1) << rate;
+  return ss.str();
+}
 
-  // 5. Finalize state
-  store.rebuild_faiss_index();  // Consider if this can be done less frequently
-  on_progress(1.0f, "Processing complete.");
+// How long the writing thread waits for a batch before looking for work to help with again
+constexpr std::chrono::milliseconds BATCH_WAIT{50};
+
+// Running sum of a file's chunk vectors. The normalized sum is the normalized mean, without
+// keeping every vector until the end.
+class VectorSum {
+ public:
+  explicit VectorSum(size_t dimension) : sum_(dimension) {}
+
+  void add(const std::vector<float>& vector) {
+    // An embedding model other than the store's gives vectors of another length
+    if (vector.size() != sum_.size()) {
+      throw std::runtime_error("Received a " + std::to_string(vector.size()) +
+                               "-dimensional embedding; the store holds " +
+                               std::to_string(sum_.size()) + "-dimensional vectors.");
+    }
+    vector_math::add(sum_.data(), vector.data(), sum_.size());
+    ++count_;
+  }
+
+  size_t count() const {
+    return count_;
+  }
+  std::vector<float> normalized() && {
+    vector_math::normalize(sum_);
+    return std::move(sum_);
+  }
+
+ private:
+  std::vector<float> sum_;
+  size_t count_ = 0;
+};
+
+// Hands a file with content to the generation lane, once it is searchable
+void queue_summary(ServiceProvider& services,
+                   const std::string& path,
+                   const std::string& content_hash,
+                   size_t chunks) {
+  if (chunks > 0 && services.get_generation_settings().client) {
+    SummarizeFileTask::queue(services.get_task_queue_repo(), path, content_hash);
+  }
 }
 
-// --- Private Helper Methods for Clarity ---
+// Stores the file's document embedding, from vectors of embedding_model, and marks it processed
+void store_document_embedding(long long file_id,
+                              VectorSum&& summary,
+                              MetadataStore& store,
+                              const std::string& embedding_model) {
+  trace::Span span("task.finalize");
+  if (summary.count() == 0) {
+    // If there's no content, just mark as processed.
+    store.update_file_processing_status(file_id, ProcessingStatus::PROCESSED);
+    return;
+  }
+  store.update_file_ai_analysis(file_id, std::move(summary).normalized(), "", "",
+                                ProcessingStatus::PROCESSED, embedding_model);
+}
+
+}  // namespace
 
-void ProcessFileTask::process_chunks_in_batches(long long file_id,
-                                                std::vector<Chunk>& chunks,
-                                                ServiceProvider& services,
-                                                const ProgressUpdater& on_progress) {
-  auto& ollama = services.get_ollama_client();
-  auto& store = services.get_metadata_store();
-  std::vector<ProcessedChunk> batch;
-  const size_t BATCH_SIZE = 64;
-  batch.reserve(BATCH_SIZE);
+/*
+Groups the chunks added to it into batches and embeds and compresses each one as a subtask, so
+a big file is not limited to the thread that claimed it: idle workers steal its batches from
+the shared executor. A batch takes as many chunks as OllamaClient::embedding_batch_size() says
+when it starts, so batches follow the endpoints' tuning while the file is being embedded.
+Without an executor (outside a WorkerPool) the file gets EMBED_REQUESTS_IN_FLIGHT helper
+threads of its own. Embedding takes vectors from the embedding cache when one is configured and
+only sends the remaining chunks to the server; when the cache detects near-duplicates, a chunk
+it misses can still take the vector of a near-identical chunk embedded before, found by the
+SimHash fingerprint add() computes as the chunk comes out of the extractor.
 
-  for (size_t i = 0; i < chunks.size(); ++i) {
-    auto& chunk = chunks[i];
-    chunk.vector_embedding = ollama.get_embedding(chunk.content);
+  add (this thread) -> embed + compress (subtasks, any thread) -> write (this thread)
+
+At most BATCHES_IN_FLIGHT batches are queued or waiting to be written, which bounds the memory
+one file holds and how many workers it can borrow: add() blocks once that many are out. While
+waiting for a batch, this thread runs queued subtasks itself, so the file makes progress even
+when no worker is idle. Writes (and therefore progress updates) stay on the calling thread, and
+every written vector goes into the file's running sum. The first failure cancels the batches
+that have not started and is rethrown by add() or finish().
+
+Chunks only ever move: add() moves each one into a slot of the pending batch, its text is lent
+to the embedding request and moved back, and the writer reads the slots in place. A written
+batch goes back to a spare list with its slots, so later batches compress into buffers that
+already have room and reuse the request's string array; after the first BATCHES_IN_FLIGHT + 1
+batches the only allocations left per chunk are the ones the extractor and the embedding client
+make for the text and vector they hand over.
+*/
+class ProcessFileTask::BatchPipeline {
+ public:
+  // expected_chunks is how many chunks will be added, or 0 while the document is still being
+  // extracted; it sizes a file's own helper threads and the progress reports. Writes are
+  // tagged with embedding_model, the store's model when the task started embedding.
+  BatchPipeline(long long file_id,
+                size_t expected_chunks,
+                MetadataStore& store,
+                ServiceProvider& services,
+                const ProgressUpdater& on_progress,
+                VectorSum& summary,
+                const std::string& embedding_model)
+      : file_id_(file_id),
+        expected_chunks_(expected_chunks),
+        embedding_model_(embedding_model),
+        ollama_(services.get_ollama_client()),
+        store_(store),
+        cache_(services.get_embedding_cache()),
+        on_progress_(on_progress),
+        summary_(summary),
+        context_(trace::current()),
+        executor_(services.get_executor()
+                      ? services.get_executor()
+                      : &own_executor_.emplace(
+                            helper_threads(expected_chunks, ollama_.embedding_batch_size()))),
+        group_(*executor_) {}
+
+  // extracted is the fraction of the document read when chunk came out of the extractor
+  void add(Chunk&& chunk, std::string&& content_hash, float extracted) {
+    if (!pending_) {
+      pending_ = take_spare();
+      pending_->limit = ollama_.embedding_batch_size();
+    }
+    Batch& batch = *pending_;
+    if (batch.size == batch.slots.size()) {
+      batch.slots.emplace_back();
+    }
+    if (cache_ && cache_->detects_near_duplicates()) {
+      batch.fingerprints.push_back(NearDuplicateIndex::fingerprint(chunk.content));
+    }
+    batch.slots[batch.size++].chunk = std::move(chunk);
+    batch.content_hashes.push_back(std::move(content_hash));
+    batch.extracted = extracted;
+    if (batch.size >= batch.limit) {
+      submit();
+    }
+  }
 
-    if (chunk.vector_embedding.empty()) {
-      throw std::runtime_error("Received empty embedding for a chunk.");
+  // Embeds and writes whatever is left, then rethrows the first subtask failure
+  void finish() {
+    if (pending_) {
+      submit();
     }
+    while (batches_written_ < batches_submitted_) {
+      write_or_wait();
+    }
+    group_.wait();
+  }
 
-    batch.push_back({chunk, CompressionService::compress(chunk.content)});
+ private:
+  // Slots [0, size) are this batch's chunks; slots past size and the scratch vectors keep the
+  // buffers of the batches that used them before. The hashes move into their slots once the
+  // cache no longer needs them side by side.
+  struct Batch {
+    std::vector<ProcessedChunk> slots;
+    size_t size = 0;
+    // The client's tuned batch size when the batch was started
+    size_t limit = 0;
+    float extracted = 0.0f;
+    std::vector<std::string> content_hashes;
+    // Per chunk when the cache detects near-duplicates, empty otherwise
+    std::vector<std::optional<uint64_t>> fingerprints;
+    std::vector<std::string> texts;
+    std::vector<std::string> miss_keys;
+    std::vector<std::optional<uint64_t>> miss_fingerprints;
+    std::vector<size_t> misses;
+  };
 
-    if (batch.size() >= BATCH_SIZE) {
-      store.upsert_chunk_metadata(file_id, batch);
-      batch.clear();
+  std::shared_ptr<Batch> take_spare() {
+    if (spare_.empty()) {
+      auto batch = std::make_shared<Batch>();
+      batch->slots.reserve(ollama_.embedding_batch_size());
+      return batch;
     }
+    std::shared_ptr<Batch> batch = std::move(spare_.back());
+    spare_.pop_back();
+    return batch;
+  }
 
-    if (i % 10 == 0) {
-      float progress = 0.1f + (0.8f * (static_cast<float>(i + 1) / chunks.size()));
-      std::string message =
-          "Embedding chunk " + std::to_string(i + 1) + " of " + std::to_string(chunks.size());
-      on_progress(progress, message);
+  static size_t helper_threads(size_t expected_chunks, size_t batch_size) {
+    if (expected_chunks == 0) {
+      return EMBED_REQUESTS_IN_FLIGHT;
     }
+    const size_t batches = (expected_chunks + batch_size - 1) / batch_size;
+    return std::min(EMBED_REQUESTS_IN_FLIGHT, batches - 1);
   }
 
-  if (!batch.empty()) {
-    store.upsert_chunk_metadata(file_id, batch);
+  void submit() {
+    while (batches_submitted_ - batches_written_ >= BATCHES_IN_FLIGHT) {
+      write_or_wait();
+    }
+    std::shared_ptr<Batch> batch = std::move(pending_);
+    ++batches_submitted_;
+    // Batches run on whichever thread steals them, under this thread's span
+    group_.run([this, batch, context = context_] {
+      trace::Scope scope(context);
+      embed_and_compress(*batch);
+      std::lock_guard<std::mutex> lock(ready_mutex_);
+      ready_.push_back(batch);
+    });
+  }
+
+  void embed_and_compress(Batch& batch) {
+    const size_t count = batch.size;
+    auto began = std::chrono::steady_clock::now();
+    std::optional<trace::Span> embed_span(std::in_place, "task.embed");
+    embed_span->set_attribute("chunks", static_cast<int64_t>(count));
+
+    // Only chunks the cache has not seen go to the embedding server
+    std::vector<std::vector<float>> cached;
+    if (cache_) {
+      cached = cache_->lookup(batch.content_hashes);
+    }
+    std::vector<size_t>& misses = batch.misses;
+    misses.clear();
+    for (size_t i = 0; i < count; ++i) {
+      if (cache_ && !cached[i].empty()) {
+        batch.slots[i].chunk.vector_embedding = std::move(cached[i]);
+      } else {
+        misses.push_back(i);
+      }
+    }
+    size_t near_duplicates = 0;
+    if (!misses.empty() && !batch.fingerprints.empty()) {
+      std::vector<std::optional<uint64_t>>& fingerprints = batch.miss_fingerprints;
+      fingerprints.resize(misses.size());
+      for (size_t m = 0; m < misses.size(); ++m) {
+        fingerprints[m] = batch.fingerprints[misses[m]];
+      }
+      std::vector<std::vector<float>> near = cache_->lookup_near(fingerprints);
+      size_t kept = 0;
+      for (size_t m = 0; m < misses.size(); ++m) {
+        if (!near[m].empty()) {
+          batch.slots[misses[m]].chunk.vector_embedding = std::move(near[m]);
+          ++near_duplicates;
+        } else {
+          fingerprints[kept] = fingerprints[m];
+          misses[kept++] = misses[m];
+        }
+      }
+      misses.resize(kept);
+      fingerprints.resize(kept);
+    }
+
+    if (!misses.empty()) {
+      // The request borrows the texts; a failed batch is dropped whole, so only success
+      // hands them back
+      std::vector<std::string>& texts = batch.texts;
+      texts.resize(misses.size());
+      for (size_t m = 0; m < misses.size(); ++m) {
+        texts[m] = std::move(batch.slots[misses[m]].chunk.content);
+      }
+      std::vector<std::vector<float>> embeddings = ollama_.get_embeddings(texts);
+      for (size_t m = 0; m < misses.size(); ++m) {
+        batch.slots[misses[m]].chunk.content = std::move(texts[m]);
+      }
+      if (embeddings.size() != texts.size()) {
+        throw std::runtime_error("Received " + std::to_string(embeddings.size()) +
+                                 " embeddings for " + std::to_string(texts.size()) + " chunks.");
+      }
+      for (const auto& embedding : embeddings) {
+        if (embedding.empty()) {
+          throw std::runtime_error("Received empty embedding for a chunk.");
+        }
+      }
+      if (cache_) {
+        std::vector<std::string>& keys = batch.miss_keys;
+        keys.resize(misses.size());
+        for (size_t m = 0; m < misses.size(); ++m) {
+          keys[m] = std::move(batch.content_hashes[misses[m]]);
+        }
+        cache_->store(keys, embeddings);
+        if (!batch.fingerprints.empty()) {
+          cache_->remember(batch.miss_fingerprints, keys);
+        }
+        for (size_t m = 0; m < misses.size(); ++m) {
+          batch.content_hashes[misses[m]] = std::move(keys[m]);
+        }
+      }
+      for (size_t m = 0; m < misses.size(); ++m) {
+        batch.slots[misses[m]].chunk.vector_embedding = std::move(embeddings[m]);
+      }
+    }
+    embed_span->set_attribute("cache_misses", static_cast<int64_t>(misses.size()));
+    embed_span->set_attribute("near_duplicates", static_cast<int64_t>(near_duplicates));
+    embed_span.reset();
+    embed_meter_.record(count, std::chrono::steady_clock::now() - began);
+
+    began = std::chrono::steady_clock::now();
+    trace::Span compress_span("task.compress");
+    for (size_t i = 0; i < count; ++i) {
+      ProcessedChunk& slot = batch.slots[i];
+      CompressionService::compress_into(slot.chunk.content, slot.compressed_content);
+      slot.content_hash = std::move(batch.content_hashes[i]);
+    }
+    compress_meter_.record(count, std::chrono::steady_clock::now() - began);
+  }
+
+  // Writes the oldest finished batch, or helps with queued subtasks until one finishes
+  void write_or_wait() {
+    if (group_.failed()) {
+      // Rethrows the first subtask failure once the running ones are done
+      group_.wait();
+    }
+    const uint64_t seen = group_.completions();
+    std::shared_ptr<Batch> batch;
+    {
+      std::lock_guard<std::mutex> lock(ready_mutex_);
+      if (!ready_.empty()) {
+        batch = std::move(ready_.front());
+        ready_.pop_front();
+      }
+    }
+    if (!batch) {
+      group_.help_or_wait(seen, BATCH_WAIT);
+      return;
+    }
+
+    const std::span<const ProcessedChunk> chunks(batch->slots.data(), batch->size);
+    const auto began = std::chrono::steady_clock::now();
+    {
+      trace::Span span("task.write");
+      span.set_attribute("chunks", static_cast<int64_t>(chunks.size()));
+      store_.upsert_chunk_metadata(file_id_, chunks, embedding_model_);
+    }
+    write_meter_.record(chunks.size(), std::chrono::steady_clock::now() - began);
+    for (const ProcessedChunk& processed : chunks) {
+      summary_.add(processed.chunk.vector_embedding);
+    }
+    written_ += chunks.size();
+    ++batches_written_;
+    const float extracted = batch->extracted;
+    batch->size = 0;
+    batch->content_hashes.clear();
+    batch->fingerprints.clear();
+    spare_.push_back(std::move(batch));
+
+    const std::string rates = " (chunks/s: embed " + format_rate(embed_meter_.rate()) +
+                              ", compress " + format_rate(compress_meter_.rate()) + ", write " +
+                              format_rate(write_meter_.rate()) + ")";
+    if (expected_chunks_ > 0) {
+      float progress = 0.1f + (0.8f * (static_cast<float>(written_) / expected_chunks_));
+      on_progress_(progress, "Embedding chunk " + std::to_string(written_) + " of " +
+                                 std::to_string(expected_chunks_) + rates);
+    } else {
+      // The chunk count is not known until the extractor is done; report how far it has read
+      on_progress_(0.1f + 0.8f * extracted,
+                   "Embedding chunk " + std::to_string(written_) + ", " +
+                       std::to_string(static_cast<int>(extracted * 100)) +
+                       "% of the document read" + rates);
+    }
+  }
+
+  const long long file_id_;
+  const size_t expected_chunks_;
+  const std::string embedding_model_;
+  OllamaClient& ollama_;
+  MetadataStore& store_;
+  EmbeddingCache* cache_;
+  const ProgressUpdater& on_progress_;
+  VectorSum& summary_;
+  const trace::Context context_;
+
+  StageMeter embed_meter_;
+  StageMeter compress_meter_;
+  StageMeter write_meter_;
+
+  // Chunks added since the last batch was submitted, if any
+  std::shared_ptr<Batch> pending_;
+  // Written batches waiting to be refilled; only this thread touches them
+  std::vector<std::shared_ptr<Batch>> spare_;
+  size_t batches_submitted_ = 0;
+  size_t batches_written_ = 0;
+  size_t written_ = 0;
+
+  // Finished batches in completion order; each is written as soon as the writer sees it
+  std::mutex ready_mutex_;
+  std::deque<std::shared_ptr<Batch>> ready_;
+
+  std::optional<async::WorkStealingExecutor> own_executor_;
+  async::WorkStealingExecutor* executor_;
+  // Declared last: its destructor waits for running batches before the state above goes away
+  async::TaskGroup group_;
+};
+
+void ProcessFileTask::execute(ServiceProvider& services, const ProgressUpdater& on_progress) {
+  // Read before anything is embedded or a stored vector is read; every vector write is tagged
+  // with it, so one that lands after a re-embed switched models is refused
+  MetadataStore& store = services.get_metadata_store(file_path_);
+  const std::string embedding_model = store.embedding_model();
+  try {
+    process(services, on_progress, embedding_model);
+  } catch (const std::exception& e) {
+    if (store.embedding_model() == embedding_model) {
+      throw;
+    }
+    // The vectors made so far belong to the old model; a fresh task embeds the file with the
+    // new one
+    const long long task_id =
+        services.get_task_queue_repo().create_file_process_task("PROCESS_FILE", file_path_);
+    on_progress(1.0f, "The embedding model changed to " + store.embedding_model() +
+                          " meanwhile (" + e.what() + "); queued task " +
+                          std::to_string(task_id) + " to embed the file again.");
   }
 }
 
-void ProcessFileTask::finalize_document_embedding(long long file_id,
-                                                  const std::vector<Chunk>& chunks,
-                                                  MetadataStore& store) {
-  if (chunks.empty()) {
-    // If there's no content, just mark as processed.
-    store.update_file_processing_status(file_id, ProcessingStatus::PROCESSED);
+void ProcessFileTask::process(ServiceProvider& services,
+                              const ProgressUpdater& on_progress,
+                              const std::string& embedding_model) {
+  on_progress(0.0f, "Starting processing...");
+  if (superseded(services, on_progress)) {
     return;
   }
 
-  std::vector<float> doc_embedding(MetadataStore::VECTOR_DIMENSION, 0.0f);
-  for (const auto& chunk : chunks) {
-    for (size_t i = 0; i < doc_embedding.size(); ++i) {
-      doc_embedding[i] += chunk.vector_embedding[i];
+  // 1. Get file metadata:
+  MetadataStore& store = services.get_metadata_store(file_path_);
+  std::optional<BasicFileMetadata> metadata = store.get_basic_file_metadata(file_path_);
+  if (!metadata) {
+    throw std::runtime_error("Could not find file metadata for path: " + file_path_);
+  }
+  store.update_file_processing_status(metadata->id, ProcessingStatus::PROCESSING);
+  on_progress(0.05f, "File metadata loaded.");
+
+  // 2. Extract content and chunks. Room for them is reserved first; a file too large to hold
+  // chunked whole within the budget is streamed instead, and everything else waits its turn.
+  ContentExtractorFactory& factory = services.get_extractor_factory();
+  const ContentExtractor& extractor = factory.get_extractor_for(metadata->path);
+  bool stream = extractor.streams_chunks();
+  async::MemoryBudget::Reservation memory;
+  if (async::MemoryBudget* budget = services.get_memory_budget()) {
+    std::error_code error;
+    const std::uintmax_t on_disk = std::filesystem::file_size(metadata->path, error);
+    const size_t file_size = error ? metadata->file_size : static_cast<size_t>(on_disk);
+    stream = stream || memory_footprint(file_size, false) >
+                           budget->capacity() / STREAM_ABOVE_BUDGET_DIVISOR;
+    const size_t bytes = memory_footprint(file_size, stream);
+    memory = budget->reserve(
+        bytes,
+        [&] {
+          on_progress(0.05f, "Waiting for " + std::to_string(bytes >> 20) +
+                                 " MB of the memory budget...");
+        },
+        MEMORY_WAIT_REPORT_INTERVAL);
+  }
+  if (stream) {
+    process_streamed(*metadata, extractor, services, on_progress, embedding_model);
+    on_progress(1.0f, "Processing complete.");
+    return;
+  }
+  std::optional<trace::Span> extract_span(std::in_place, "task.extract");
+  ExtractionResult extraction_result = extractor.extract_with_hash(metadata->path);
+  extract_span->set_attribute("chunks", static_cast<int64_t>(extraction_result.chunks.size()));
+  extract_span.reset();
+  on_progress(0.1f, "Content extracted.");
+  // Extraction takes long enough for the file to be saved again meanwhile
+  if (std::optional<long long> newer = superseded(services, on_progress)) {
+    // The file is back in the queue, not left PROCESSING; a newer task that already started
+    // or finished has set its status itself
+    std::optional<TaskDTO> task = services.get_task_queue_repo().get_task(*newer);
+    if (task && task->status == TaskStatus::PENDING) {
+      store.update_file_processing_status(metadata->id, ProcessingStatus::QUEUED);
     }
+    return;
   }
 
-  // Normalize the final vector
-  float norm = 0.0f;
-  for (float val : doc_embedding) {
-    norm += val * val;
+  // 3. Diff against the chunks stored by the previous run. Unchanged chunks keep their row,
+  // vector and index entry; only new or edited ones are embedded and written. Batches are
+  // committed as they finish, so a run that died or lost its lease resumes here from the last
+  // batch it wrote.
+  std::vector<Chunk>& chunks = extraction_result.chunks;
+  std::optional<trace::Span> diff_span(std::in_place, "task.diff");
+  std::vector<std::string> content_hashes;
+  content_hashes.reserve(chunks.size());
+  for (const auto& chunk : chunks) {
+    content_hashes.push_back(EmbeddingCache::content_key(chunk.content));
+  }
+  ChunkDiff diff = diff_chunks(chunks, content_hashes, store.get_stored_chunks(metadata->id));
+  store.reconcile_chunks(metadata->id, diff.kept, diff.removed_ids);
+  diff_span->set_attribute("kept", static_cast<int64_t>(diff.kept.size()));
+  diff_span.reset();
+  if (!diff.kept.empty()) {
+    on_progress(0.1f, std::to_string(diff.kept.size()) + " of " + std::to_string(chunks.size()) +
+                          " chunks already stored.");
   }
-  norm = std::sqrt(norm);
-  if (norm > 0.0f) {
-    for (float& val : doc_embedding) {
-      val /= norm;
+
+  // 4. Process the remaining chunks, get embeddings, and save in batches. Kept chunks already
+  // hold their stored vectors.
+  VectorSum summary(store.dimension());
+  for (const Chunk& chunk : chunks) {
+    if (!chunk.vector_embedding.empty()) {
+      summary.add(chunk.vector_embedding);
     }
   }
+  if (!diff.fresh.empty()) {
+    BatchPipeline pipeline(metadata->id, diff.fresh.size(), store, services, on_progress,
+                           summary, embedding_model);
+    for (size_t i : diff.fresh) {
+      pipeline.add(std::move(chunks[i]), std::move(content_hashes[i]), 1.0f);
+    }
+    pipeline.finish();
+  }
+
+  // 5. Calculate and store the final document-level embedding. The store updates the live
+  // Faiss index in place, so no rebuild is needed here. The file is searchable from here on;
+  // its summary and category follow from the generation lane.
+  const size_t embedded = summary.count();
+  store_document_embedding(metadata->id, std::move(summary), store, embedding_model);
+  queue_summary(services, file_path_, metadata->content_hash, embedded);
+  on_progress(0.95f, "Document summary embedding stored.");
+
+  on_progress(1.0f, "Processing complete.");
+}
+
+std::optional<long long> ProcessFileTask::superseded(ServiceProvider& services,
+                                                     const ProgressUpdater& on_progress) const {
+  std::optional<long long> newer =
+      services.get_task_queue_repo().find_superseding_task(get_id());
+  if (!newer) {
+    return std::nullopt;
+  }
+  on_progress(1.0f, "Superseded by task " + std::to_string(*newer) + ", which processes the "
+                    "latest version of the file; skipped.");
+  return newer;
+}
+
+/*
+The streaming counterpart of steps 2-5 above, for extractors that read a document piece by piece
+(PDFs, page by page). Each chunk is diffed against the stored rows as it arrives and either
+keeps its row or goes straight into the embedding pipeline, so the first batch is embedded
+while the extractor is still reading and the document's text is never held whole. Rows no
+chunk matched are removed once the extractor is done.
+*/
+void ProcessFileTask::process_streamed(const BasicFileMetadata& metadata,
+                                       const ContentExtractor& extractor,
+                                       ServiceProvider& services,
+                                       const ProgressUpdater& on_progress,
+                                       const std::string& embedding_model) {
+  MetadataStore& store = services.get_metadata_store(file_path_);
+  const long long file_id = metadata.id;
+  on_progress(0.1f, "Extracting content while it is embedded.");
+
+  ChunkMatcher matcher(store.get_stored_chunks(file_id));
+  VectorSum summary(store.dimension());
+  std::vector<std::pair<int64_t, int>> kept;
+  size_t kept_total = 0;
+  size_t extracted_chunks = 0;
+  {
+    BatchPipeline pipeline(file_id, 0, store, services, on_progress, summary, embedding_model);
+    trace::Span extract_span("task.extract");
+    extractor.stream_chunks(file_path_, [&](std::vector<Chunk>& chunks, float extracted) {
+      for (Chunk& chunk : chunks) {
+        std::string content_hash = EmbeddingCache::content_key(chunk.content);
+        if (auto row = matcher.match(chunk, content_hash)) {
+          kept.emplace_back(*row, chunk.chunk_index);
+          summary.add(chunk.vector_embedding);
+        } else {
+          pipeline.add(std::move(chunk), std::move(content_hash), extracted);
+        }
+      }
+      extracted_chunks += chunks.size();
+      if (kept.size() >= KEPT_PER_WRITE) {
+        kept_total += kept.size();
+        store.reconcile_chunks(file_id, kept, {});
+        kept.clear();
+      }
+    });
+    extract_span.set_attribute("chunks", static_cast<int64_t>(extracted_chunks));
+    pipeline.finish();
+  }
+  kept_total += kept.size();
+  store.reconcile_chunks(file_id, kept, matcher.unmatched());
+  if (kept_total > 0) {
+    on_progress(0.9f, std::to_string(kept_total) + " of " + std::to_string(extracted_chunks) +
+                          " chunks already stored.");
+  }
 
-  store.update_file_ai_analysis(file_id, doc_embedding, "", "", ProcessingStatus::PROCESSED);
+  const size_t embedded = summary.count();
+  store_document_embedding(file_id, std::move(summary), store, embedding_model);
+  queue_summary(services, file_path_, metadata.content_hash, embedded);
+  on_progress(0.95f, "Document summary embedding stored.");
+}
+
+size_t ProcessFileTask::memory_footprint(size_t file_size, bool streamed) {
+  const size_t in_memory = file_size * IN_MEMORY_BYTES_PER_FILE_BYTE;
+  return streamed ? std::min(in_memory, STREAMED_FOOTPRINT) : in_memory;
+}
+
+void ProcessFileTask::finalize_document_embedding(long long file_id,
+                                                  const std::vector<Chunk>& chunks,
+                                                  MetadataStore& store,
+                                                  const std::string& embedding_model) {
+  VectorSum summary(store.dimension());
+  for (const auto& chunk : chunks) {
+    summary.add(chunk.vector_embedding);
+  }
+  store_document_embedding(file_id, std::move(summary), store, embedding_model);
 }
 
-}  // namespace magic_core
\ No newline at end of file
+}  // namespace magic_core
@@ -0,0 +1,216 @@
+#include "magic_core/async/reembed_task.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <future>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "magic_core/async/service_provider.hpp"
+#include "magic_core/db/embedding_cache.hpp"
+#include "magic_core/db/metadata_store.hpp"
+#include "magic_core/db/sharded_metadata_store.hpp"
+#include "magic_core/llm/ollama_client.hpp"
+#include "magic_core/services/compression_service.hpp"
+#include "magic_core/types/trace.hpp"
+
+namespace magic_core {
+
+ReembedTask::ReembedTask(long long id,
+                         TaskStatus status,
+                         std::chrono::system_clock::time_point created_at,
+                         std::chrono::system_clock::time_point updated_at,
+                         std::optional<std::string> error_message,
+                         std::string model)
+    : ITask(id, status, created_at, updated_at, error_message), model_(std::move(model)) {}
+
+void ReembedTask::execute(ServiceProvider& services, const ProgressUpdater& on_progress) {
+  on_progress(0.0f, "Starting re-embedding with " + model_ + "...");
+  std::vector<MetadataStore*> stores;
+  if (ShardedMetadataStore* shards = services.get_sharded_metadata_store()) {
+    for (size_t i = 0; i < shards->shard_count(); ++i) {
+      if (shards->shard(i).embedding_model() != model_) {
+        stores.push_back(&shards->shard(i));
+      }
+    }
+  } else if (services.get_metadata_store().embedding_model() != model_) {
+    stores.push_back(&services.get_metadata_store());
+  }
+  if (stores.empty()) {
+    on_progress(1.0f, "Already using " + model_ + ".");
+    return;
+  }
+  const EmbeddingModelHooks& hooks = services.get_embedding_model_hooks();
+  if (!hooks.client_for) {
+    throw std::runtime_error("REEMBED needs a client for " + model_ + "; none is configured.");
+  }
+  std::shared_ptr<OllamaClient> client = hooks.client_for(model_);
+  // Keyed by the target model, so a retried run only embeds what the last one did not
+  std::shared_ptr<EmbeddingCache> cache = hooks.cache_for ? hooks.cache_for(model_) : nullptr;
+  std::vector<std::unique_ptr<VectorReplacement>> replacements;
+  for (MetadataStore* store : stores) {
+    replacements.push_back(store->begin_replacement(model_));
+  }
+
+  // The first pass does nearly all the work; the ones after it catch up with what writers
+  // changed meanwhile, until little enough is left to finish with writers held off
+  const float share = 0.89f / static_cast<float>(stores.size());
+  for (size_t s = 0; s < stores.size(); ++s) {
+    MetadataStore& store = *stores[s];
+    VectorReplacement& replacement = *replacements[s];
+    const float from = 0.01f + share * static_cast<float>(s);
+    const float caught_up = from + share * 0.95f;
+    ReplacementWork work = store.pending_replacement(replacement);
+    on_progress(from, std::to_string(work.chunk_ids.size()) + " chunks and " +
+                          std::to_string(work.file_ids.size()) + " file summaries to re-embed.");
+    embed_work(work, replacement, store, *client, cache.get(), on_progress, from, caught_up);
+    for (int pass = 0; pass < MAX_CATCH_UP_PASSES; ++pass) {
+      work = store.pending_replacement(replacement);
+      if (work.chunk_ids.size() + work.file_ids.size() <= INSTALL_THRESHOLD) {
+        break;
+      }
+      embed_work(work, replacement, store, *client, cache.get(), on_progress, caught_up,
+                 from + share);
+    }
+  }
+
+  on_progress(0.9f, "Installing " + model_ + " vectors...");
+  // Each shard's swap runs the next one's before publishing, so writers stay held off until
+  // the last shard is installed and queries switch over
+  std::function<void(size_t)> install = [&](size_t s) {
+    if (s == stores.size()) {
+      if (hooks.activate) {
+        hooks.activate(model_, client);
+      }
+      return;
+    }
+    MetadataStore& store = *stores[s];
+    VectorReplacement& replacement = *replacements[s];
+    store.install_replacement(
+        replacement,
+        [&](const ReplacementWork& late) {
+          embed_work(late, replacement, store, *client, cache.get(), on_progress, 0.9f, 0.95f);
+        },
+        [&install, s] { install(s + 1); });
+  };
+  install(0);
+  on_progress(1.0f, "Switched to " + model_ + ".");
+}
+
+namespace {
+
+// One request's worth of chunks on its way through the embedding server
+struct Batch {
+  std::vector<int64_t> chunk_ids;
+  std::vector<std::vector<float>> vectors;
+  // Content keys of the cache misses and their position in the batch
+  std::vector<std::string> miss_keys;
+  std::vector<size_t> misses;
+  std::future<std::vector<std::vector<float>>> embedded;
+};
+
+}  // namespace
+
+void ReembedTask::embed_work(const ReplacementWork& work,
+                             VectorReplacement& replacement,
+                             MetadataStore& store,
+                             OllamaClient& client,
+                             EmbeddingCache* cache,
+                             const ProgressUpdater& on_progress,
+                             float from,
+                             float to) {
+  trace::Span span("task.reembed");
+  span.set_attribute("chunks", static_cast<int64_t>(work.chunk_ids.size()));
+  const size_t total = work.chunk_ids.size();
+  // Chunks take most of the time; summaries are computed from their vectors
+  const float chunks_to = from + (to - from) * 0.95f;
+
+  // Reads, decompresses and sends the batch starting at start without waiting for it
+  auto send = [&](size_t start) {
+    const size_t end = std::min(start + BATCH_SIZE, total);
+    Batch batch;
+    std::vector<std::string> texts;
+    // Chunks deleted since the work was listed are gone from the result, and need no vector
+    for (auto& [id, content] : store.get_chunk_contents(
+             std::vector<int64_t>(work.chunk_ids.begin() + start, work.chunk_ids.begin() + end))) {
+      batch.chunk_ids.push_back(id);
+      texts.push_back(CompressionService::decompress(content));
+    }
+    std::vector<std::string> keys;
+    if (cache) {
+      keys.reserve(texts.size());
+      for (const auto& text : texts) {
+        keys.push_back(EmbeddingCache::content_key(text));
+      }
+      batch.vectors = cache->lookup(keys);
+    } else {
+      batch.vectors.resize(texts.size());
+    }
+    std::vector<std::string> miss_texts;
+    for (size_t i = 0; i < texts.size(); ++i) {
+      if (batch.vectors[i].empty()) {
+        batch.misses.push_back(i);
+        miss_texts.push_back(std::move(texts[i]));
+        if (cache) {
+          batch.miss_keys.push_back(std::move(keys[i]));
+        }
+      }
+    }
+    if (!miss_texts.empty()) {
+      batch.embedded = client.get_embeddings_async(miss_texts);
+    }
+    return batch;
+  };
+
+  auto finish = [&](Batch& batch) {
+    if (batch.embedded.valid()) {
+      std::vector<std::vector<float>> embeddings = batch.embedded.get();
+      if (embeddings.size() != batch.misses.size()) {
+        throw std::runtime_error("Received " + std::to_string(embeddings.size()) +
+                                 " embeddings for " + std::to_string(batch.misses.size()) +
+                                 " chunks.");
+      }
+      for (const auto& embedding : embeddings) {
+        if (embedding.empty()) {
+          throw std::runtime_error("Received empty embedding for a chunk.");
+        }
+      }
+      if (cache) {
+        cache->store(batch.miss_keys, embeddings);
+      }
+      for (size_t m = 0; m < batch.misses.size(); ++m) {
+        batch.vectors[batch.misses[m]] = std::move(embeddings[m]);
+      }
+    }
+    store.add_replacement_chunks(replacement, batch.chunk_ids, batch.vectors);
+  };
+
+  std::deque<Batch> in_flight;
+  size_t next = 0;
+  size_t done = 0;
+  while (next < total || !in_flight.empty()) {
+    while (next < total && in_flight.size() < BATCHES_IN_FLIGHT) {
+      in_flight.push_back(send(next));
+      next = std::min(next + BATCH_SIZE, total);
+    }
+    finish(in_flight.front());
+    in_flight.pop_front();
+    // Batches finish in the order they were sent
+    done = std::min(done + BATCH_SIZE, total);
+    on_progress(from + (chunks_to - from) * static_cast<float>(done) / static_cast<float>(total),
+                "Re-embedded " + std::to_string(done) + " of " + std::to_string(total) +
+                    " chunks.");
+  }
+
+  for (size_t start = 0; start < work.file_ids.size(); start += SUMMARY_BATCH_SIZE) {
+    const size_t end = std::min(start + SUMMARY_BATCH_SIZE, work.file_ids.size());
+    store.add_replacement_summaries(
+        replacement,
+        std::vector<int>(work.file_ids.begin() + start, work.file_ids.begin() + end));
+  }
+  on_progress(to, "Re-embedded " + std::to_string(work.file_ids.size()) + " file summaries.");
+}
+
+}  // namespace magic_core
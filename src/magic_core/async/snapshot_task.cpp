@@ -0,0 +1,122 @@
+#include "magic_core/async/snapshot_task.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "magic_core/async/service_provider.hpp"
+#include "magic_core/db/epoch_millis.hpp"
+#include "magic_core/db/metadata_store.hpp"
+#include "magic_core/db/sharded_metadata_store.hpp"
+#include "magic_core/db/task_queue_repo.hpp"
+#include "magic_core/types/trace.hpp"
+
+namespace magic_core {
+
+namespace {
+
+// Names the task that owns a "<destination>.partial" directory
+constexpr const char* PARTIAL_MARKER = ".snapshot-task";
+
+bool owns_partial(const std::filesystem::path& partial, long long task_id) {
+  std::ifstream in(partial / PARTIAL_MARKER);
+  long long owner = 0;
+  return in >> owner && owner == task_id;
+}
+
+}  // namespace
+
+SnapshotTask::SnapshotTask(long long id,
+                           TaskStatus status,
+                           std::chrono::system_clock::time_point created_at,
+                           std::chrono::system_clock::time_point updated_at,
+                           std::optional<std::string> error_message,
+                           std::string destination)
+    : ITask(id, status, created_at, updated_at, error_message),
+      destination_(std::move(destination)) {}
+
+void SnapshotTask::execute(ServiceProvider& services, const ProgressUpdater& on_progress) {
+  trace::Span span("task.snapshot");
+  const std::filesystem::path destination(destination_);
+  if (std::filesystem::exists(destination)) {
+    throw std::runtime_error("Snapshot destination " + destination_ + " already exists.");
+  }
+  std::vector<MetadataStore*> stores;
+  if (ShardedMetadataStore* shards = services.get_sharded_metadata_store()) {
+    for (size_t i = 0; i < shards->shard_count(); ++i) {
+      stores.push_back(&shards->shard(i));
+    }
+  } else {
+    stores.push_back(&services.get_metadata_store());
+  }
+  // What an earlier run of this task left behind is incomplete; anything else there is not ours
+  std::filesystem::path partial = destination;
+  partial += ".partial";
+  if (std::filesystem::exists(partial)) {
+    if (!owns_partial(partial, get_id())) {
+      throw std::runtime_error("Snapshot staging directory " + partial.string() +
+                               " already exists and was not left by this task.");
+    }
+    std::filesystem::remove_all(partial);
+  }
+  std::filesystem::create_directories(partial);
+  {
+    std::ofstream marker(partial / PARTIAL_MARKER, std::ios::trunc);
+    marker << get_id() << '\n';
+    if (!marker) {
+      throw std::runtime_error("Could not write the snapshot marker in " + partial.string());
+    }
+  }
+  on_progress(0.0f, "Writing a snapshot of " + std::to_string(stores.size()) + " database(s) to " +
+                        destination_ + "...");
+
+  const SnapshotOptions& options = services.get_snapshot_options();
+  nlohmann::json manifest_shards = nlohmann::json::array();
+  try {
+    const float share = 0.99f / static_cast<float>(stores.size());
+    for (size_t s = 0; s < stores.size(); ++s) {
+      const float from = share * static_cast<float>(s);
+      auto progress = [&](size_t copied, size_t total) {
+        const float done = total ? static_cast<float>(copied) / static_cast<float>(total) : 1.0f;
+        on_progress(from + share * done, "Database " + std::to_string(s + 1) + " of " +
+                                             std::to_string(stores.size()) + ": " +
+                                             std::to_string(copied >> 20) + " of " +
+                                             std::to_string(total >> 20) + " MB copied.");
+      };
+      // The first database holds the queue
+      std::function<void(sqlite::database&)> finalize;
+      if (s == 0) {
+        finalize = [this](sqlite::database& copy) {
+          TaskQueueRepo::complete_task_in_copy(copy, get_id());
+        };
+      }
+      SnapshotInfo info = stores[s]->write_snapshot(partial, options, progress, finalize);
+      manifest_shards.push_back({{"shard", s},
+                                 {"files_generation", info.files_generation},
+                                 {"chunks_generation", info.chunks_generation},
+                                 {"bytes", info.bytes}});
+    }
+    nlohmann::json manifest = {{"created_at", to_epoch_millis(std::chrono::system_clock::now())},
+                               {"task_id", get_id()},
+                               {"shards", std::move(manifest_shards)}};
+    {
+      std::ofstream out(partial / "manifest.json", std::ios::trunc);
+      out << manifest.dump(2) << '\n';
+      if (!out) {
+        throw std::runtime_error("Could not write the snapshot manifest in " + partial.string());
+      }
+    }
+    std::filesystem::remove(partial / PARTIAL_MARKER);
+    std::filesystem::rename(partial, destination);
+  } catch (...) {
+    std::error_code ec;
+    std::filesystem::remove_all(partial, ec);
+    throw;
+  }
+  on_progress(1.0f, "Snapshot written to " + destination_ + ".");
+}
+
+}  // namespace magic_core
@@ -0,0 +1,186 @@
+#include "magic_core/async/summarize_file_task.hpp"
+
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+#include "magic_core/async/service_provider.hpp"
+#include "magic_core/db/metadata_store.hpp"
+#include "magic_core/db/task_queue_repo.hpp"
+#include "magic_core/llm/ollama_client.hpp"
+#include "magic_core/services/compression_service.hpp"
+#include "magic_core/types/trace.hpp"
+
+namespace magic_core {
+
+namespace {
+
+// Cut to at most max bytes without splitting a UTF-8 sequence, then trimmed of whitespace
+std::string clip(std::string text, size_t max) {
+  if (text.size() > max) {
+    size_t end = max;
+    while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+      --end;
+    }
+    text.resize(end);
+  }
+  const size_t first = text.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos) {
+    return {};
+  }
+  const size_t last = text.find_last_not_of(" \t\r\n");
+  return text.substr(first, last - first + 1);
+}
+
+std::string string_field(const nlohmann::json& reply, const char* name) {
+  auto it = reply.find(name);
+  return it != reply.end() && it->is_string() ? it->get<std::string>() : std::string();
+}
+
+// The stored chunk text of the file, in order, up to max_chars
+std::string read_excerpt(MetadataStore& store, int file_id, size_t max_chars) {
+  std::string excerpt;
+  for (const ChunkMetadata& chunk : store.get_chunk_metadata({file_id})) {
+    if (excerpt.size() >= max_chars) {
+      break;
+    }
+    if (!excerpt.empty()) {
+      excerpt += "\n\n";
+    }
+    excerpt += CompressionService::decompress(chunk.content);
+  }
+  return clip(std::move(excerpt), max_chars);
+}
+
+}  // namespace
+
+SummarizeFileTask::SummarizeFileTask(long long id,
+                                     TaskStatus status,
+                                     std::chrono::system_clock::time_point created_at,
+                                     std::chrono::system_clock::time_point updated_at,
+                                     std::optional<std::string> error_message,
+                                     std::string file_path,
+                                     std::string content_hash)
+    : ITask(id, status, created_at, updated_at, error_message),
+      file_path_(std::move(file_path)),
+      content_hash_(std::move(content_hash)) {}
+
+long long SummarizeFileTask::queue(TaskQueueRepo& repo,
+                                   const std::string& file_path,
+                                   const std::string& content_hash) {
+  return repo.create_tagged_file_task("SUMMARIZE_FILE", file_path, content_hash);
+}
+
+std::string SummarizeFileTask::build_prompt(const std::string& filename,
+                                            const std::string& excerpt) {
+  return "You are organizing a user's files. Read the file below and reply with a JSON object "
+         "with three string fields: \"summary\", two or three sentences on what the file is "
+         "about; \"category\", one or two lower-case words for the kind of document, such as "
+         "invoice, meeting notes or source code; and \"filename\", a short descriptive "
+         "kebab-case name for the file that keeps its extension.\n\nFile name: " +
+         filename + "\n\nContent:\n" + excerpt;
+}
+
+FileSuggestions SummarizeFileTask::parse_reply(const std::string& reply) {
+  nlohmann::json json;
+  try {
+    json = nlohmann::json::parse(reply);
+  } catch (const nlohmann::json::exception& e) {
+    throw std::runtime_error("The generation model's reply is not JSON: " +
+                             std::string(e.what()));
+  }
+  if (!json.is_object()) {
+    throw std::runtime_error("The generation model's reply is not a JSON object");
+  }
+  FileSuggestions suggestions;
+  suggestions.summary = clip(string_field(json, "summary"), MAX_SUMMARY_CHARS);
+  suggestions.category = clip(string_field(json, "category"), MAX_CATEGORY_CHARS);
+  // A name, never a path: the suggestion must not point anywhere else
+  std::string filename = string_field(json, "filename");
+  const size_t slash = filename.find_last_of("/\\");
+  if (slash != std::string::npos) {
+    filename.erase(0, slash + 1);
+  }
+  suggestions.filename = clip(std::move(filename), MAX_FILENAME_CHARS);
+  if (suggestions.filename == "." || suggestions.filename == "..") {
+    suggestions.filename.clear();
+  }
+  return suggestions;
+}
+
+void SummarizeFileTask::execute(ServiceProvider& services, const ProgressUpdater& on_progress) {
+  on_progress(0.0f, "Starting summarization...");
+  const GenerationSettings& generation = services.get_generation_settings();
+  if (!generation.client) {
+    throw std::runtime_error("SUMMARIZE_FILE needs a generation model, and none is configured.");
+  }
+
+  MetadataStore& store = services.get_metadata_store(file_path_);
+  std::optional<BasicFileMetadata> metadata = store.get_basic_file_metadata(file_path_);
+  if (!metadata || metadata->content_hash != content_hash_) {
+    on_progress(1.0f, "File changed or deleted since it was queued; skipped.");
+    return;
+  }
+  // A duplicate's chunks are stored under the file it shares them with
+  const int content_id = metadata->content_source_id != 0 ? metadata->content_source_id
+                                                          : metadata->id;
+  std::string excerpt;
+  {
+    trace::Span span("task.read");
+    excerpt = read_excerpt(store, content_id, generation.max_input_chars);
+    span.set_attribute("chars", static_cast<int64_t>(excerpt.size()));
+  }
+  if (excerpt.empty()) {
+    on_progress(1.0f, "File has no text to summarize.");
+    return;
+  }
+  on_progress(0.1f, "Content read.");
+
+  std::string reply;
+  {
+    trace::Span span("task.generate");
+    const std::string filename = std::filesystem::path(file_path_).filename().string();
+    // On a thread of its own, so that progress reports keep the lease alive meanwhile. It is
+    // detached, holding the client until the request ends, so that a stopping worker leaves
+    // right away instead of waiting out the model.
+    auto request = std::make_shared<std::promise<std::string>>();
+    std::future<std::string> answer = request->get_future();
+    std::thread([request, client = generation.client,
+                 prompt = build_prompt(filename, excerpt)] {
+      try {
+        request->set_value(client->generate(prompt, true));
+      } catch (...) {
+        request->set_exception(std::current_exception());
+      }
+    }).detach();
+    auto reported = std::chrono::steady_clock::now();
+    while (answer.wait_for(STOP_POLL_INTERVAL) == std::future_status::timeout) {
+      if (stop_requested()) {
+        throw TaskInterruptedError("Worker stopped while task " + std::to_string(get_id()) +
+                                   " waited for the generation model");
+      }
+      const auto now = std::chrono::steady_clock::now();
+      if (now - reported >= PROGRESS_INTERVAL) {
+        on_progress(0.5f, "Waiting for the generation model...");
+        reported = now;
+      }
+    }
+    reply = answer.get();
+  }
+  FileSuggestions suggestions = parse_reply(reply);
+  on_progress(0.9f, "Summary generated.");
+
+  if (!store.update_file_suggestions(metadata->id, content_hash_, suggestions.summary,
+                                     suggestions.category, suggestions.filename)) {
+    on_progress(1.0f, "File changed while it was summarized; summary dropped.");
+    return;
+  }
+  on_progress(1.0f, "Summary stored.");
+}
+
+}  // namespace magic_core
@@ -13,6 +13,34 @@ ITaskPtr TaskFactory::create_task(const TaskDTO& record) {
                                              *record.target_path);
   }
 
+  if (record.task_type == "REEMBED") {
+    if (!record.target_tag || record.target_tag->empty()) {
+      throw std::runtime_error("REEMBED task is missing the target model in target_tag.");
+    }
+    return std::make_unique<ReembedTask>(record.id, record.status, record.created_at,
+                                         record.updated_at, record.error_message,
+                                         *record.target_tag);
+  }
+
+  if (record.task_type == "SNAPSHOT") {
+    if (!record.target_tag || record.target_tag->empty()) {
+      throw std::runtime_error("SNAPSHOT task is missing the destination directory in target_tag.");
+    }
+    return std::make_unique<SnapshotTask>(record.id, record.status, record.created_at,
+                                          record.updated_at, record.error_message,
+                                          *record.target_tag);
+  }
+
+  if (record.task_type == "SUMMARIZE_FILE") {
+    if (!record.target_path || !record.target_tag) {
+      throw std::runtime_error(
+          "SUMMARIZE_FILE task is missing its target_path or the content hash in target_tag.");
+    }
+    return std::make_unique<SummarizeFileTask>(record.id, record.status, record.created_at,
+                                               record.updated_at, record.error_message,
+                                               *record.target_path, *record.target_tag);
+  }
+
   return nullptr;
 }
 }  // namespace magic_core
\ No newline at end of file
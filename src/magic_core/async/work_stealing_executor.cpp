@@ -0,0 +1,212 @@
+#include "magic_core/async/work_stealing_executor.hpp"
+
+#include <utility>
+
+#include "magic_core/types/logger.hpp"
+
+namespace magic_core::async {
+
+namespace {
+
+std::atomic<uint64_t> next_executor_id{1};
+
+// The slot this thread used last; a thread almost always works for one executor
+struct SlotCache {
+  uint64_t executor_id = 0;
+  void *slot = nullptr;
+};
+thread_local SlotCache slot_cache;
+
+// How long a waiting thread sleeps before looking for stealable work again
+constexpr std::chrono::milliseconds HELP_POLL_INTERVAL{50};
+
+}  // namespace
+
+WorkStealingExecutor::WorkStealingExecutor(size_t threads, std::shared_ptr<WorkSignal> idle_signal)
+    : id_(next_executor_id++), idle_signal_(std::move(idle_signal)) {
+  threads_.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back(&WorkStealingExecutor::thread_loop, this);
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stopping_ = true;
+  }
+  wake_cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+WorkStealingExecutor::Slot &WorkStealingExecutor::own_slot() {
+  if (slot_cache.executor_id == id_) {
+    return *static_cast<Slot *>(slot_cache.slot);
+  }
+  const auto me = std::this_thread::get_id();
+  Slot *slot = nullptr;
+  {
+    std::shared_lock<std::shared_mutex> lock(slots_mutex_);
+    for (const auto &candidate : slots_) {
+      if (candidate->owner == me) {
+        slot = candidate.get();
+        break;
+      }
+    }
+  }
+  if (!slot) {
+    auto fresh = std::make_unique<Slot>();
+    fresh->owner = me;
+    slot = fresh.get();
+    std::unique_lock<std::shared_mutex> lock(slots_mutex_);
+    slots_.push_back(std::move(fresh));
+  }
+  slot_cache = {id_, slot};
+  return *slot;
+}
+
+void WorkStealingExecutor::submit(Job job) {
+  Slot &slot = own_slot();
+  {
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    slot.jobs.push_back(std::move(job));
+  }
+  pending_.fetch_add(1, std::memory_order_acq_rel);
+  if (!threads_.empty()) {
+    {
+      // Pairs with the predicate check in thread_loop so the wakeup is not lost
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
+    wake_cv_.notify_one();
+  }
+  if (idle_signal_) {
+    idle_signal_->notify_one();
+  }
+}
+
+bool WorkStealingExecutor::run_one() {
+  if (pending() == 0) {
+    return false;
+  }
+  Slot &mine = own_slot();
+  Job job;
+  {
+    std::lock_guard<std::mutex> lock(mine.mutex);
+    if (!mine.jobs.empty()) {
+      job = std::move(mine.jobs.back());
+      mine.jobs.pop_back();
+    }
+  }
+  if (!job) {
+    std::shared_lock<std::shared_mutex> slots_lock(slots_mutex_);
+    const size_t count = slots_.size();
+    // Start at a rotating victim so thieves spread over the busy threads
+    const size_t start = next_victim_.fetch_add(1, std::memory_order_relaxed);
+    for (size_t n = 0; n < count && !job; ++n) {
+      Slot &victim = *slots_[(start + n) % count];
+      if (&victim == &mine) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.jobs.empty()) {
+        job = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        steals_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+  if (!job) {
+    return false;
+  }
+  pending_.fetch_sub(1, std::memory_order_acq_rel);
+  try {
+    job();
+  } catch (const std::exception &e) {
+    log::warning() << "Executor job threw: " << e.what();
+  } catch (...) {
+    log::warning() << "Executor job threw an unknown exception";
+  }
+  return true;
+}
+
+void WorkStealingExecutor::thread_loop() {
+  while (!stopping_) {
+    if (run_one()) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_cv_.wait_for(lock, HELP_POLL_INTERVAL, [this] { return stopping_ || pending() > 0; });
+  }
+}
+
+TaskGroup::~TaskGroup() {
+  try {
+    wait();
+  } catch (...) {
+    // Whoever cared about the result called wait() already
+  }
+}
+
+void TaskGroup::run(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++outstanding_;
+  }
+  executor_.submit([this, job = std::move(job)] {
+    if (!failed()) {
+      try {
+        job();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) {
+          error_ = std::current_exception();
+        }
+        failed_.store(true, std::memory_order_release);
+      }
+    }
+    // Notified under the lock: once wait() sees the last job finish the group may be gone
+    std::lock_guard<std::mutex> lock(mutex_);
+    --outstanding_;
+    ++completions_;
+    done_cv_.notify_all();
+  });
+}
+
+uint64_t TaskGroup::completions() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return completions_;
+}
+
+void TaskGroup::help_or_wait(uint64_t seen, std::chrono::milliseconds timeout) {
+  if (executor_.run_one()) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait_for(lock, timeout, [&] { return completions_ != seen || outstanding_ == 0; });
+}
+
+void TaskGroup::wait() {
+  while (true) {
+    uint64_t seen;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (outstanding_ == 0) {
+        break;
+      }
+      seen = completions_;
+    }
+    help_or_wait(seen, HELP_POLL_INTERVAL);
+  }
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error = std::exchange(error_, nullptr);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace magic_core::async
@@ -1,23 +1,35 @@
 #include "magic_core/async/worker.hpp"
 
-#include <iostream>
+#include <deque>
+#include <vector>
 
 #include "magic_core/async/ITask.hpp"
 #include "magic_core/async/service_provider.hpp"
 #include "magic_core/async/task_factory.hpp"
+#include "magic_core/async/work_stealing_executor.hpp"
 #include "magic_core/db/models/task_dto.hpp"
 #include "magic_core/db/task_queue_repo.hpp"
+#include "magic_core/types/logger.hpp"
+#include "magic_core/types/trace.hpp"
 
 namespace magic_core {
 namespace async {
 
-Worker::Worker(int worker_id, std::shared_ptr<ServiceProvider> services)
-    : worker_id_(worker_id), services_(services) {
-  std::cout << "Worker [" << worker_id_ << "] created." << std::endl;
+Worker::Worker(int worker_id,
+               std::shared_ptr<ServiceProvider> services,
+               std::shared_ptr<WorkSignal> work_signal,
+               TaskLane lane)
+    : worker_id_(worker_id),
+      services_(services),
+      work_signal_(work_signal ? std::move(work_signal) : std::make_shared<WorkSignal>()),
+      lane_(lane),
+      lease_owner_(services_->get_task_queue_repo().instance_id() + "/worker-" +
+                   std::to_string(worker_id)) {
+  log::info() << "Worker [" << worker_id_ << "] created.";
 }
 
 Worker::~Worker() {
-  std::cout << "Worker [" << worker_id_ << "] shutting down..." << std::endl;
+  log::info() << "Worker [" << worker_id_ << "] shutting down...";
   // Ensure the stop flag is set before we attempt to join.
   stop();
   // The destructor will block here until the thread has finished its work.
@@ -25,7 +37,7 @@ Worker::~Worker() {
   if (thread.joinable()) {
     thread.join();
   }
-  std::cout << "Worker [" << worker_id_ << "] joined and shut down." << std::endl;
+  log::info() << "Worker [" << worker_id_ << "] joined and shut down.";
 }
 
 void Worker::start() {
@@ -41,49 +53,150 @@ void Worker::start() {
 void Worker::stop() {
   // This is a thread-safe way to signal the loop to terminate.
   should_stop.store(true);
+  // Wake the loop if it is idle so it notices right away
+  work_signal_->notify_all();
 }
 
 void Worker::run_loop() {
-  std::cout << "Worker [" << worker_id_ << "] starting run loop." << std::endl;
+  log::info() << "Worker [" << worker_id_ << "] starting run loop.";
   TaskQueueRepo& task_repo = services_->get_task_queue_repo();
+  // Claimed but not yet started tasks; refilled CLAIM_BATCH_SIZE at a time
+  std::deque<TaskDTO> claimed;
 
   while (!should_stop.load()) {
-    std::optional<TaskDTO> task_dto = task_repo.fetch_and_claim_next_task();
-
-    if (task_dto) {
-      ITaskPtr task = nullptr;
+    // Help finish the files other workers are on before starting another one. Generation
+    // workers keep to their lane, so embedding never runs on more threads than its own.
+    async::WorkStealingExecutor* executor = services_->get_executor();
+    if (executor && lane_ != TaskLane::Generation && executor->run_one()) {
+      continue;
+    }
+    if (claimed.empty()) {
+      // Read before looking at the queue, so a task queued after an empty fetch still wakes us
+      const uint64_t seen_generation = work_signal_->generation();
+      const int batch_size =
+          lane_ == TaskLane::Generation ? GENERATION_CLAIM_BATCH_SIZE : CLAIM_BATCH_SIZE;
       try {
-        task = TaskFactory::create_task(*task_dto);
-        if (!task) {
-          throw std::runtime_error("TaskFactory returned null task for task type: " + task_dto->task_type);
+        for (auto& task_dto : task_repo.fetch_and_claim_tasks(batch_size, lane_, lease_owner_)) {
+          claimed.push_back(std::move(task_dto));
         }
+      } catch (const std::exception& e) {
+        log::error() << "Worker [" << worker_id_ << "] ERROR claiming tasks: " << e.what();
+      }
+      if (claimed.empty()) {
+        idle_ = true;
+        work_signal_->wait_for(seen_generation, IDLE_POLL_INTERVAL,
+                               [this] { return should_stop.load(); });
+        idle_ = false;
+        continue;
+      }
+    }
 
-        task->execute(*services_, [&](float p, const std::string& msg) {
-          task_repo.upsert_task_progress(task_dto->id, p, msg);
-        });
-        task_repo.update_task_status(task_dto->id, TaskStatus::COMPLETED);
+    TaskDTO task_dto = std::move(claimed.front());
+    claimed.pop_front();
+    process_task(task_dto);
+  }
 
-      } catch (const std::exception& e) {
-        std::cerr << "Worker [" << worker_id_ << "] ERROR processing task " << task_dto->id << ": "
-                  << e.what() << std::endl;
-        task_repo.mark_task_as_failed(task_dto->id, e.what());
+  // Hand back whatever we claimed but never started so another worker can run it
+  if (!claimed.empty()) {
+    std::vector<long long> unstarted;
+    for (const auto& task_dto : claimed) {
+      unstarted.push_back(task_dto.id);
+    }
+    try {
+      task_repo.release_claimed_tasks(unstarted);
+    } catch (const std::exception& e) {
+      log::error() << "Worker [" << worker_id_ << "] ERROR releasing " << unstarted.size()
+                   << " claimed tasks: " << e.what();
+    }
+  }
+  log::info() << "Worker [" << worker_id_ << "] run loop terminated.";
+}
+
+void Worker::process_task(const TaskDTO& task_dto) {
+  std::shared_ptr<trace::FileExporter> exporter = trace::exporter();
+  if (!exporter) {
+    run_task(task_dto);
+    return;
+  }
+  trace::Trace task_trace;
+  {
+    trace::Scope scope(task_trace);
+    trace::Span span("task");
+    span.set_attribute("task.id", static_cast<int64_t>(task_dto.id));
+    span.set_attribute("task.type", task_dto.task_type);
+    run_task(task_dto);
+  }
+  exporter->export_trace(task_trace);
+}
+
+void Worker::run_task(const TaskDTO& task_dto) {
+  TaskQueueRepo& task_repo = services_->get_task_queue_repo();
+  ITaskPtr task = nullptr;
+  try {
+    // Claimed tasks wait in the batch while earlier ones run; make sure this one is still ours
+    if (!task_repo.renew_lease(task_dto.id, lease_owner_)) {
+      log::warning() << "Worker [" << worker_id_ << "] lost the lease on task " << task_dto.id
+                     << " before starting it; skipping.";
+      return;
+    }
+    auto lease_renewed = std::chrono::steady_clock::now();
+    const auto renew_every = task_repo.lease_duration() / 3;
+
+    task = TaskFactory::create_task(task_dto);
+    if (!task) {
+      throw std::runtime_error("TaskFactory returned null task for task type: " +
+                               task_dto.task_type);
+    }
+
+    task->set_stop_flag(&should_stop);
+    task->execute(*services_, [&](float p, const std::string& msg) {
+      task_repo.report_task_progress(task_dto.id, p, msg);
+      const auto now = std::chrono::steady_clock::now();
+      if (now - lease_renewed >= renew_every) {
+        if (!task_repo.renew_lease(task_dto.id, lease_owner_)) {
+          throw TaskLeaseLostError("Lease on task " + std::to_string(task_dto.id) +
+                                   " expired and it was reclaimed");
+        }
+        lease_renewed = now;
       }
-    } else {
-      std::this_thread::sleep_for(std::chrono::seconds(5));
+    });
+    if (!task_repo.update_task_status(task_dto.id, TaskStatus::COMPLETED, lease_owner_)) {
+      throw TaskLeaseLostError("Lease on task " + std::to_string(task_dto.id) +
+                               " expired and it was reclaimed before it completed");
+    }
+
+  } catch (const TaskInterruptedError& e) {
+    // Not the task's fault, so the attempt does not count against it
+    log::warning() << "Worker [" << worker_id_ << "] " << e.what() << "; handing it back.";
+    try {
+      task_repo.release_claimed_tasks({task_dto.id});
+    } catch (const std::exception& release_error) {
+      log::error() << "Worker [" << worker_id_ << "] ERROR releasing task " << task_dto.id
+                   << ": " << release_error.what();
+    }
+  } catch (const TaskLeaseLostError& e) {
+    // Whoever reclaimed the task owns its outcome now. The chunks written so far stay, so the
+    // next run only embeds the rest.
+    log::warning() << "Worker [" << worker_id_ << "] " << e.what() << "; abandoning it.";
+  } catch (const std::exception& e) {
+    log::error() << "Worker [" << worker_id_ << "] ERROR processing task " << task_dto.id << ": "
+                 << e.what();
+    if (!task_repo.mark_task_as_failed(task_dto.id, e.what(), lease_owner_)) {
+      log::warning() << "Worker [" << worker_id_ << "] lost the lease on task " << task_dto.id
+                     << "; leaving its outcome to whoever reclaimed it.";
     }
   }
-  std::cout << "Worker [" << worker_id_ << "] run loop terminated." << std::endl;
 }
 
 bool Worker::run_one_task() {
-  std::cout << "Worker [" << worker_id_ << "] running a single synchronous cycle..." << std::endl;
+  log::info() << "Worker [" << worker_id_ << "] running a single synchronous cycle...";
 
-  std::optional<TaskDTO> task_opt = services_->get_task_queue_repo().fetch_and_claim_next_task();
+  std::optional<TaskDTO> task_opt = services_->get_task_queue_repo().fetch_and_claim_next_task(lane_, lease_owner_);
 
   if (task_opt.has_value()) {
-    std::cout << "Worker [" << worker_id_ << "] found task for file: " << task_opt->id << std::endl;
+    log::info() << "Worker [" << worker_id_ << "] found task for file: " << task_opt->id;
     auto on_progress = [&](float p, const std::string& msg) {
-      services_->get_task_queue_repo().upsert_task_progress(task_opt->id, p, msg);
+      services_->get_task_queue_repo().report_task_progress(task_opt->id, p, msg);
     };
 
     try {
@@ -92,16 +205,17 @@ bool Worker::run_one_task() {
         throw std::runtime_error("TaskFactory returned null task for task type: " + task_opt->task_type);
       }
       task->execute(*services_, on_progress);
-      services_->get_task_queue_repo().update_task_status(task_opt->id, TaskStatus::COMPLETED);
+      services_->get_task_queue_repo().update_task_status(task_opt->id, TaskStatus::COMPLETED,
+                                                          lease_owner_);
     } catch (const std::exception& e) {
-      services_->get_task_queue_repo().mark_task_as_failed(task_opt->id, e.what());
-      std::cerr << "Worker [" << worker_id_ << "] CRITICAL ERROR processing file " << task_opt->id
-                << ": " << e.what() << std::endl;
+      services_->get_task_queue_repo().mark_task_as_failed(task_opt->id, e.what(), lease_owner_);
+      log::error() << "Worker [" << worker_id_ << "] CRITICAL ERROR processing file "
+                   << task_opt->id << ": " << e.what();
       return true;
     }
     return true;
   } else {
-    std::cout << "Worker [" << worker_id_ << "] found no pending tasks." << std::endl;
+    log::info() << "Worker [" << worker_id_ << "] found no pending tasks.";
     return false;
   }
 }
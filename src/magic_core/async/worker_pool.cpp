@@ -1,54 +1,230 @@
 #include "magic_core/async/worker_pool.hpp"
 
-#include <iostream>
 
 #include "magic_core/async/service_provider.hpp"
+#include "magic_core/db/task_queue_repo.hpp"
+#include "magic_core/llm/ollama_client.hpp"
+#include "magic_core/types/logger.hpp"
 
 namespace magic_core::async {
 
-WorkerPool::WorkerPool(size_t num_threads, std::shared_ptr<ServiceProvider> services) {
-  if (num_threads == 0) {
+WorkerPool::WorkerPool(size_t num_threads, std::shared_ptr<ServiceProvider> services)
+    : WorkerPool(WorkerPoolOptions{num_threads, num_threads}, std::move(services)) {}
+
+WorkerPool::WorkerPool(WorkerPoolOptions options, std::shared_ptr<ServiceProvider> services)
+    : m_options(options),
+      m_services(services),
+      m_work_signal(std::make_shared<WorkSignal>()) {
+  if (m_options.min_workers == 0) {
     throw std::invalid_argument("WorkerPool must have at least one thread.");
   }
+  if (m_options.max_workers < m_options.min_workers) {
+    throw std::invalid_argument("WorkerPool max_workers must not be below min_workers.");
+  }
+  if (m_options.interactive_workers + m_options.bulk_workers > m_options.min_workers) {
+    throw std::invalid_argument("WorkerPool lane reservations exceed min_workers.");
+  }
+  // Submitted subtasks wake idle workers through the same signal as new tasks
+  m_executor = std::make_shared<WorkStealingExecutor>(0, m_work_signal);
+  m_services->set_executor(m_executor);
 
   // Reserve space in the vector for efficiency
-  m_workers.reserve(num_threads);
+  m_workers.reserve(m_options.max_workers + m_options.generation_workers);
 
-  for (size_t i = 0; i < num_threads; ++i) {
-    m_workers.emplace_back(
-        std::make_unique<Worker>(static_cast<int>(i), services));
+  for (size_t i = 0; i < m_options.min_workers; ++i) {
+    add_worker(next_worker_lane());
+  }
+  for (size_t i = 0; i < m_options.generation_workers; ++i) {
+    add_worker(TaskLane::Generation);
+  }
+  // Newly queued tasks wake an idle worker instead of waiting for the next poll. With reserved
+  // lanes the one woken might not take the task, so every idle worker gets to look.
+  const bool reserved_lanes = m_options.interactive_workers + m_options.bulk_workers +
+                                  m_options.generation_workers >
+                              0;
+  m_services->get_task_queue_repo().set_task_created_listener(
+      [signal = m_work_signal, reserved_lanes] {
+        if (reserved_lanes) {
+          signal->notify_all();
+        } else {
+          signal->notify_one();
+        }
+      });
+  log::Line line = log::info();
+  line << "WorkerPool created with " << m_options.min_workers << " workers";
+  if (m_options.max_workers > m_options.min_workers) {
+    line << " (up to " << m_options.max_workers << ")";
   }
-  std::cout << "WorkerPool created with " << num_threads << " workers." << std::endl;
+  if (m_options.generation_workers > 0) {
+    line << " and " << m_options.generation_workers << " generation workers";
+  }
+  line << ".";
 }
 
 WorkerPool::~WorkerPool() {
-  std::cout << "WorkerPool destructor called. Shutting down all workers..." << std::endl;
+  log::info() << "WorkerPool destructor called. Shutting down all workers...";
+  m_services->get_task_queue_repo().set_task_created_listener(nullptr);
   if (m_is_running) {
     stop();
   }
+  // Join the workers while the executor is still installed for whatever they are finishing
+  {
+    std::lock_guard<std::mutex> lock(m_workers_mutex);
+    m_workers.clear();
+  }
+  m_services->set_executor(nullptr);
 }
 
 void WorkerPool::start() {
   if (m_is_running) {
-    std::cerr << "Warning: WorkerPool is already running." << std::endl;
+    log::warning() << "WorkerPool is already running.";
     return;
   }
-  std::cout << "Starting all workers in the pool..." << std::endl;
-  for (const auto& worker : m_workers) {
-    worker->start();
+  log::info() << "Starting all workers in the pool...";
+  {
+    std::lock_guard<std::mutex> lock(m_workers_mutex);
+    for (const auto& worker : m_workers) {
+      worker->start();
+    }
+    m_is_running = true;
+  }
+  if (m_options.max_workers > m_options.min_workers) {
+    m_scaling = true;
+    m_scaler = std::make_unique<std::thread>(&WorkerPool::scale_loop, this);
   }
-  m_is_running = true;
 }
 
 void WorkerPool::stop() {
   if (!m_is_running) {
     return;
   }
-  std::cout << "Stopping all workers in the pool..." << std::endl;
+  log::info() << "Stopping all workers in the pool...";
+  if (m_scaler) {
+    {
+      std::lock_guard<std::mutex> lock(m_scaler_mutex);
+      m_scaling = false;
+    }
+    m_scaler_cv.notify_all();
+    m_scaler->join();
+    m_scaler.reset();
+  }
+  std::lock_guard<std::mutex> lock(m_workers_mutex);
   for (const auto& worker : m_workers) {
     worker->stop();
   }
   m_is_running = false;
 }
 
-}  // namespace magic_core::async
\ No newline at end of file
+size_t WorkerPool::size() const {
+  std::lock_guard<std::mutex> lock(m_workers_mutex);
+  return m_workers.size();
+}
+
+TaskLane WorkerPool::next_worker_lane() const {
+  size_t interactive = 0;
+  size_t bulk = 0;
+  for (const auto& worker : m_workers) {
+    interactive += worker->lane() == TaskLane::Interactive ? 1 : 0;
+    bulk += worker->lane() == TaskLane::Bulk ? 1 : 0;
+  }
+  if (interactive < m_options.interactive_workers) {
+    return TaskLane::Interactive;
+  }
+  if (bulk < m_options.bulk_workers) {
+    return TaskLane::Bulk;
+  }
+  return TaskLane::Any;
+}
+
+// Callers hold m_workers_mutex, except the constructor
+void WorkerPool::add_worker(TaskLane lane) {
+  m_workers.emplace_back(
+      std::make_unique<Worker>(m_next_worker_id++, m_services, m_work_signal, lane));
+  if (m_is_running) {
+    m_workers.back()->start();
+  }
+}
+
+bool WorkerPool::embedding_server_saturated() const {
+  int healthy = 0;
+  int outstanding = 0;
+  for (const auto& endpoint : m_services->get_ollama_client().endpoint_status()) {
+    if (endpoint.healthy) {
+      ++healthy;
+      outstanding += endpoint.outstanding;
+    }
+  }
+  // With every endpoint down, more workers would only fail or wait on the recovery probe
+  return healthy == 0 || outstanding >= healthy * m_options.saturated_outstanding_per_endpoint;
+}
+
+void WorkerPool::rebalance(std::chrono::steady_clock::time_point now) {
+  size_t backlog = m_executor->pending();
+  try {
+    backlog += m_services->get_task_queue_repo().count_pending_tasks(TaskLane::Any);
+  } catch (const std::exception& e) {
+    log::warning() << "WorkerPool could not read the task backlog: " << e.what();
+    return;
+  }
+
+  std::unique_ptr<Worker> retired;
+  {
+    std::lock_guard<std::mutex> lock(m_workers_mutex);
+    if (!m_is_running) {
+      return;
+    }
+    size_t workers = 0;
+    size_t idle = 0;
+    for (const auto& worker : m_workers) {
+      if (worker->lane() != TaskLane::Generation) {
+        ++workers;
+        idle += worker->is_idle() ? 1 : 0;
+      }
+    }
+
+    if (backlog > idle && workers < m_options.max_workers && !embedding_server_saturated()) {
+      add_worker(next_worker_lane());
+      m_idle_since.reset();
+      log::info() << "WorkerPool grew to " << workers + 1 << " workers (backlog " << backlog
+                  << ").";
+    } else if (backlog == 0 && idle > 0 && workers > m_options.min_workers) {
+      if (!m_idle_since) {
+        m_idle_since = now;
+      } else if (now - *m_idle_since >= m_options.idle_before_shrink) {
+        for (auto it = m_workers.rbegin(); it != m_workers.rend(); ++it) {
+          // Reserved workers are part of min_workers and never retired
+          if ((*it)->is_idle() && (*it)->lane() == TaskLane::Any) {
+            retired = std::move(*it);
+            m_workers.erase(std::next(it).base());
+            break;
+          }
+        }
+        // The next worker has to sit idle for a whole window of its own
+        m_idle_since = now;
+      }
+    } else {
+      m_idle_since.reset();
+    }
+  }
+  if (retired) {
+    // Joined outside the lock; an idle worker exits as soon as it sees the stop
+    retired->stop();
+    retired.reset();
+    log::info() << "WorkerPool shrank to " << size() - m_options.generation_workers
+                << " workers.";
+  }
+}
+
+void WorkerPool::scale_loop() {
+  std::unique_lock<std::mutex> lock(m_scaler_mutex);
+  while (m_scaling) {
+    if (m_scaler_cv.wait_for(lock, m_options.scale_interval, [this] { return !m_scaling; })) {
+      break;
+    }
+    lock.unlock();
+    rebalance(std::chrono::steady_clock::now());
+    lock.lock();
+  }
+}
+
+}  // namespace magic_core::async
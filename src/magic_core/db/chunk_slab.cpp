@@ -0,0 +1,156 @@
+#include "magic_core/db/chunk_slab.hpp"
+
+#include <algorithm>
+
+#include "magic_core/types/vector_math.hpp"
+
+namespace magic_core {
+
+void ChunkSlab::append(int64_t id, const float *vector) {
+  const size_t n = static_cast<size_t>(dimension);
+  const size_t row = vectors.size();
+  vectors.insert(vectors.end(), vector, vector + n);
+  float *stored = vectors.data() + row;
+  if (metric == VectorMetric::Cosine) {
+    vector_math::normalize(stored, n);
+  } else {
+    squared_norms.push_back(vector_math::dot(stored, stored, n));
+  }
+  ids.push_back(id);
+}
+
+void ChunkSlab::reserve(size_t rows) {
+  ids.reserve(rows);
+  vectors.reserve(rows * static_cast<size_t>(dimension));
+  if (metric != VectorMetric::Cosine) {
+    squared_norms.reserve(rows);
+  }
+}
+
+size_t ChunkSlab::bytes() const {
+  return ids.capacity() * sizeof(int64_t) +
+         (vectors.capacity() + squared_norms.capacity()) * sizeof(float);
+}
+
+std::vector<VectorIndexHit> scan_slabs(const std::vector<const ChunkSlab *> &slabs,
+                                       const std::vector<float> &query,
+                                       int k) {
+  if (slabs.empty() || k <= 0) {
+    return {};
+  }
+  const int dimension = slabs.front()->dimension;
+  const VectorMetric metric = slabs.front()->metric;
+  if (query.size() != static_cast<size_t>(dimension)) {
+    throw VectorIndexError("Query vector has " + std::to_string(query.size()) +
+                           " dimensions, expected " + std::to_string(dimension));
+  }
+
+  std::vector<float> prepared = query;
+  float query_norm = 0.0f;
+  if (metric == VectorMetric::Cosine) {
+    vector_math::normalize(prepared);
+  } else {
+    query_norm = vector_math::dot(prepared.data(), prepared.data(), prepared.size());
+  }
+
+  std::vector<VectorIndexHit> hits;
+  std::vector<float> products;
+  for (const ChunkSlab *slab : slabs) {
+    if (slab->dimension != dimension || slab->metric != metric) {
+      throw VectorIndexError("Chunk slabs of different shapes cannot be scanned together");
+    }
+    products.resize(slab->size());
+    vector_math::dot_rows(prepared.data(), slab->vectors.data(), slab->size(),
+                          static_cast<size_t>(dimension), products.data());
+    for (size_t row = 0; row < slab->size(); ++row) {
+      // |q - x|^2 = |q|^2 + |x|^2 - 2 q.x, which rounding can push just below zero
+      const float distance =
+          metric == VectorMetric::Cosine
+              ? 1.0f - products[row]
+              : std::max(0.0f, query_norm + slab->squared_norms[row] - 2.0f * products[row]);
+      hits.push_back({slab->ids[row], distance});
+    }
+  }
+
+  const auto closer = [](const VectorIndexHit &a, const VectorIndexHit &b) {
+    return a.distance < b.distance || (a.distance == b.distance && a.id < b.id);
+  };
+  if (hits.size() > static_cast<size_t>(k)) {
+    std::partial_sort(hits.begin(), hits.begin() + k, hits.end(), closer);
+    hits.resize(k);
+  } else {
+    std::sort(hits.begin(), hits.end(), closer);
+  }
+  return hits;
+}
+
+std::shared_ptr<const ChunkSlab> ChunkSlabCache::get(int file_id) {
+  if (capacity_bytes_ == 0) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(file_id);
+  if (it == index_.end()) {
+    ++misses_;
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  ++hits_;
+  return it->second->slab;
+}
+
+void ChunkSlabCache::put(int file_id, std::shared_ptr<const ChunkSlab> slab, uint64_t ticket) {
+  // Files without chunks are cached too, so they stop costing a query; count their bookkeeping
+  const size_t bytes = sizeof(ChunkSlab) + slab->bytes();
+  if (bytes > capacity_bytes_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Invalidations bump the epoch while holding the mutex, so this check cannot go stale
+  if (epoch_.load(std::memory_order_acquire) != ticket) {
+    return;
+  }
+  erase_locked(file_id);
+  entries_.push_front({file_id, std::move(slab), bytes});
+  index_.emplace(file_id, entries_.begin());
+  bytes_ += bytes;
+  while (bytes_ > capacity_bytes_) {
+    erase_locked(entries_.back().file_id);
+  }
+}
+
+void ChunkSlabCache::invalidate(int file_id) {
+  invalidate(std::vector<int>{file_id});
+}
+
+void ChunkSlabCache::invalidate(const std::vector<int> &file_ids) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  epoch_.fetch_add(1, std::memory_order_acq_rel);
+  for (int file_id : file_ids) {
+    erase_locked(file_id);
+  }
+}
+
+void ChunkSlabCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  epoch_.fetch_add(1, std::memory_order_acq_rel);
+  entries_.clear();
+  index_.clear();
+  bytes_ = 0;
+}
+
+ChunkSlabCache::Stats ChunkSlabCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return {hits_, misses_, entries_.size(), bytes_};
+}
+
+void ChunkSlabCache::erase_locked(int file_id) {
+  auto it = index_.find(file_id);
+  if (it != index_.end()) {
+    bytes_ -= it->second->bytes;
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+}
+
+}  // namespace magic_core
@@ -2,50 +2,173 @@
 #define SQLCIPHER_CRYPTO_OPENSSL 1
 #include <sqlcipher/sqlite3.h>
 #include "magic_core/db/connection_pool.hpp"
+#include <openssl/evp.h>
+#include <algorithm>
+#include <fstream>
+#include <future>
 #include <stdexcept>
+#include <vector>
+#include "magic_core/types/metrics.hpp"
 
 namespace magic_core {
 
-ConnectionPool::ConnectionPool(const std::string& db_path, const std::string& db_key, int pool_size)
-    : db_path_(db_path), db_key_(db_key) {
-  for (int i = 0; i < pool_size; ++i) {
-    auto db = std::make_unique<sqlite::database>(db_path_);
-    sqlite3* handle = db->connection().get();
-    if (!handle) {
-      throw std::runtime_error("Failed to get native handle for connection in pool.");
-    }
+namespace {
 
-    if (sqlite3_key(handle, db_key_.c_str(), db_key_.length()) != SQLITE_OK) {
-      throw std::runtime_error("Failed to key database for connection in pool: " +
-                               std::string(sqlite3_errmsg(handle)));
-    }
+std::string to_hex(const unsigned char* bytes, size_t size) {
+  static const char DIGITS[] = "0123456789abcdef";
+  std::string hex;
+  hex.reserve(size * 2);
+  for (size_t i = 0; i < size; ++i) {
+    hex.push_back(DIGITS[bytes[i] >> 4]);
+    hex.push_back(DIGITS[bytes[i] & 0x0f]);
+  }
+  return hex;
+}
+
+}  // namespace
+
+ConnectionPool::ConnectionPool(const std::string& db_path,
+                               const std::string& db_key,
+                               int min_size,
+                               int max_size,
+                               ConnectionAccess access,
+                               const CipherOptions& cipher)
+    : db_path_(db_path),
+      db_key_(db_key),
+      access_(access),
+      cipher_(cipher),
+      max_size_(std::max(min_size, max_size)) {
+  if (min_size <= 0) {
+    return;
+  }
+  // The first one may create the file; the rest each run the key derivation, so they open side
+  // by side
+  pool_.push(open_connection(db_path_, db_key_, access_, cipher_));
+  std::vector<std::future<std::unique_ptr<PooledDatabase>>> opening;
+  for (int i = 1; i < min_size; ++i) {
+    opening.push_back(std::async(std::launch::async, [this] {
+      return open_connection(db_path_, db_key_, access_, cipher_);
+    }));
+  }
+  for (auto& connection : opening) {
+    pool_.push(connection.get());
+  }
+  open_count_ += min_size;
+  stats_.opened += min_size;
+}
+
+void ConnectionPool::key_database(sqlite::database& db,
+                                  const std::string& db_key,
+                                  const CipherOptions& cipher) {
+  sqlite3* handle = db.connection().get();
+  if (!handle) {
+    throw std::runtime_error("Failed to get native database handle.");
+  }
+  if (sqlite3_key(handle, db_key.c_str(), db_key.length()) != SQLITE_OK) {
+    throw std::runtime_error("Failed to key database: " + std::string(sqlite3_errmsg(handle)));
+  }
+  // Only read when the first page is, so they go in before anything else touches the file
+  const CipherOptions defaults;
+  if (cipher.kdf_iter != defaults.kdf_iter) {
+    db << "PRAGMA kdf_iter = " + std::to_string(cipher.kdf_iter) + ";";
+  }
+  if (cipher.cipher_page_size != defaults.cipher_page_size) {
+    db << "PRAGMA cipher_page_size = " + std::to_string(cipher.cipher_page_size) + ";";
+  }
 
-    // Run a test query to ensure the key is correct
-    *db << "SELECT count(*) FROM sqlite_master;";
+  // Run a test query to ensure the key is correct
+  db << "SELECT count(*) FROM sqlite_master;";
+}
+
+std::string ConnectionPool::derive_raw_key(const std::string& db_path,
+                                           const std::string& passphrase,
+                                           const CipherOptions& cipher) {
+  unsigned char salt[SALT_BYTES];
+  std::ifstream file(db_path, std::ios::binary);
+  if (!file.read(reinterpret_cast<char*>(salt), SALT_BYTES)) {
+    return "";
+  }
+  unsigned char key[KEY_BYTES];
+  if (PKCS5_PBKDF2_HMAC(passphrase.data(), static_cast<int>(passphrase.size()), salt,
+                        SALT_BYTES, cipher.kdf_iter, EVP_sha512(), KEY_BYTES, key) != 1) {
+    return "";
+  }
+  return "x'" + to_hex(key, KEY_BYTES) + to_hex(salt, SALT_BYTES) + "'";
+}
 
-    *db << "PRAGMA foreign_keys = ON;";
-    *db << "PRAGMA journal_mode = WAL;";
+std::unique_ptr<PooledDatabase> ConnectionPool::open_connection(const std::string& db_path,
+                                                                const std::string& db_key,
+                                                                ConnectionAccess access,
+                                                                const CipherOptions& cipher) {
+  auto conn = std::make_unique<PooledDatabase>(db_path);
+  sqlite::database* db = &conn->db;
+  key_database(*db, db_key, cipher);
 
-    pool_.push(std::move(db));
+  *db << "PRAGMA foreign_keys = ON;";
+  *db << "PRAGMA journal_mode = WAL;";
+  // Read-write connections keep the default FULL, so a commit survives a power loss too
+  if (access == ConnectionAccess::ReadOnly) {
+    *db << "PRAGMA synchronous = NORMAL;";
+    *db << "PRAGMA cache_size = -" + std::to_string(READ_CACHE_SIZE_KIB) + ";";
+    *db << "PRAGMA mmap_size = " + std::to_string(READ_MMAP_SIZE) + ";";
+    *db << "PRAGMA temp_store = MEMORY;";
+    *db << "PRAGMA query_only = ON;";
   }
+  return conn;
 }
 
-std::unique_ptr<sqlite::database> ConnectionPool::get_connection() {
+std::unique_ptr<PooledDatabase> ConnectionPool::get_connection() {
+  // Every acquisition is observed, so the histogram shows how often callers wait at all
+  static metrics::Histogram &wait_seconds = metrics::histogram(
+      "magic_connection_pool_wait_seconds", "Time get_connection() callers waited for one");
   std::unique_lock<std::mutex> lock(mtx_);
-  // Wait until a connection is available or shutdown is requested
-  cv_.wait(lock, [this] { return shutting_down_ || !pool_.empty(); });
+  ++stats_.acquisitions;
+  const auto can_proceed = [this] {
+    return shutting_down_ || !pool_.empty() || open_count_ < max_size_;
+  };
+  double waited_seconds = 0.0;
+  if (!can_proceed()) {
+    // Wait until a connection is available or shutdown is requested
+    const auto started = std::chrono::steady_clock::now();
+    cv_.wait(lock, can_proceed);
+    const auto waited = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started);
+    ++stats_.waits;
+    stats_.total_wait += waited;
+    stats_.max_wait = std::max(stats_.max_wait, waited);
+    waited_seconds = std::chrono::duration<double>(waited).count();
+  }
+  wait_seconds.observe(waited_seconds);
 
   if (shutting_down_) {
     throw std::runtime_error("Connection pool is shut down");
   }
 
+  if (pool_.empty()) {
+    // Room for another one. Opened outside the lock: keying reads the database, and returns
+    // should not wait behind it.
+    ++open_count_;
+    ++stats_.opened;
+    lock.unlock();
+    try {
+      return open_connection(db_path_, db_key_, access_, cipher_);
+    } catch (...) {
+      lock.lock();
+      --open_count_;
+      --stats_.opened;
+      // The slot is free again for a caller waiting on a full pool
+      cv_.notify_one();
+      throw;
+    }
+  }
+
   // Get the connection from the front of the queue
-  std::unique_ptr<sqlite::database> conn = std::move(pool_.front());
+  std::unique_ptr<PooledDatabase> conn = std::move(pool_.front());
   pool_.pop();
   return conn;
 }
 
-void ConnectionPool::return_connection(std::unique_ptr<sqlite::database> conn) {
+void ConnectionPool::return_connection(std::unique_ptr<PooledDatabase> conn) {
   std::lock_guard<std::mutex> lock(mtx_);
   if (!shutting_down_) {
     pool_.push(std::move(conn));
@@ -54,6 +177,15 @@ void ConnectionPool::return_connection(std::unique_ptr<sqlite::database> conn) {
   cv_.notify_one();
 }
 
+std::unique_ptr<PooledDatabase> ConnectionPool::open_unpooled(const std::string& db_path) const {
+  return open_connection(db_path.empty() ? db_path_ : db_path, db_key_, access_, cipher_);
+}
+
+ConnectionPoolStats ConnectionPool::stats() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return stats_;
+}
+
 void ConnectionPool::shutdown() {
   std::lock_guard<std::mutex> lock(mtx_);
   shutting_down_ = true;
@@ -0,0 +1,106 @@
+#define SQLITE_HAS_CODEC 1
+#define SQLCIPHER_CRYPTO_OPENSSL 1
+#include <sqlcipher/sqlite3.h>
+
+#include "magic_core/db/database_backup.hpp"
+
+#include <system_error>
+#include <utility>
+
+#include "magic_core/db/database_manager.hpp"
+
+namespace magic_core {
+
+DatabaseBackup::DatabaseBackup(DatabaseManager &source, std::filesystem::path destination)
+    : destination_path_(std::move(destination)) {
+  if (std::filesystem::exists(destination_path_)) {
+    throw DatabaseBackupError("Backup destination " + destination_path_.string() +
+                              " already exists");
+  }
+  try {
+    source_ = source.open_unpooled_connection(ConnectionAccess::ReadOnly);
+    // Reading in a transaction pins the snapshot every step copies from
+    source_->db << "BEGIN";
+    source_->db << "SELECT count(*) FROM sqlite_master" >> [](int) {};
+    source_->db << "PRAGMA page_size" >> page_size_;
+    destination_ =
+        source.open_unpooled_connection(ConnectionAccess::ReadWrite, destination_path_);
+  } catch (const std::exception &e) {
+    remove_destination();
+    throw DatabaseBackupError("Cannot start a backup to " + destination_path_.string() + ": " +
+                              e.what());
+  }
+  sqlite3 *target = destination_->db.connection().get();
+  backup_ = sqlite3_backup_init(target, "main", source_->db.connection().get(), "main");
+  if (!backup_) {
+    const std::string error = sqlite3_errmsg(target);
+    destination_.reset();
+    remove_destination();
+    throw DatabaseBackupError("Cannot start a backup to " + destination_path_.string() + ": " +
+                              error);
+  }
+}
+
+DatabaseBackup::~DatabaseBackup() {
+  if (backup_) {
+    sqlite3_backup_finish(backup_);
+  }
+  if (!finished_) {
+    destination_.reset();
+    remove_destination();
+  }
+}
+
+bool DatabaseBackup::step(int pages) {
+  if (done_) {
+    return true;
+  }
+  const int rc = sqlite3_backup_step(backup_, pages);
+  if (rc == SQLITE_DONE) {
+    done_ = true;
+    return true;
+  }
+  // Only the destination can be locked, and nothing else has it open: try again next step
+  if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+    return false;
+  }
+  throw DatabaseBackupError("Backup to " + destination_path_.string() +
+                            " failed: " + sqlite3_errstr(rc));
+}
+
+int DatabaseBackup::page_count() const {
+  return sqlite3_backup_pagecount(backup_);
+}
+
+int DatabaseBackup::remaining() const {
+  return sqlite3_backup_remaining(backup_);
+}
+
+void DatabaseBackup::finish(const std::function<void(sqlite::database &)> &finalize) {
+  if (!done_) {
+    throw DatabaseBackupError("Backup to " + destination_path_.string() + " is not complete");
+  }
+  const int rc = sqlite3_backup_finish(backup_);
+  backup_ = nullptr;
+  if (rc != SQLITE_OK) {
+    throw DatabaseBackupError("Backup to " + destination_path_.string() +
+                              " failed: " + sqlite3_errstr(rc));
+  }
+  if (finalize) {
+    finalize(destination_->db);
+  }
+  // The last connection to close checkpoints the copy's WAL into it
+  destination_.reset();
+  source_->db << "COMMIT";
+  source_.reset();
+  finished_ = true;
+}
+
+void DatabaseBackup::remove_destination() noexcept {
+  std::error_code ignored;
+  for (const char *suffix : {"", "-wal", "-shm"}) {
+    std::filesystem::remove(destination_path_.string() + suffix, ignored);
+  }
+}
+
+}  // namespace magic_core
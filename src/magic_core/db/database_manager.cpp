@@ -4,18 +4,53 @@
 
 #include "magic_core/db/database_manager.hpp"
 
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
+
+#include "magic_core/db/pooled_connection.hpp"
+#include "magic_core/db/schema_migrations.hpp"
+#include "magic_core/db/shard_map.hpp"
+#include "magic_core/db/transaction.hpp"
+#include "magic_core/types/logger.hpp"
 
 namespace magic_core {
 
+namespace {
+
+// A table whose vectors live in a segment file, referenced by offset
+struct VectorTable {
+  const char* name;
+  const char* table;
+  const char* blob_column;  // Where vectors were kept before the segment files
+  const char* offset_column;
+};
+
+constexpr VectorTable VECTOR_TABLES[] = {
+    {"files", "files", "summary_vector_blob", "summary_vector_offset"},
+    {"chunks", "chunks", "vector_blob", "vector_offset"},
+};
+
+// Legacy BLOBs are moved over this many rows per transaction
+constexpr size_t MIGRATION_BATCH_SIZE = 4096;
+
+}  // namespace
+
 DatabaseManager& DatabaseManager::get_instance() {
   static DatabaseManager instance;
   return instance;
 }
 
+std::unique_ptr<DatabaseManager> DatabaseManager::create() {
+  return std::unique_ptr<DatabaseManager>(new DatabaseManager());
+}
+
 void DatabaseManager::initialize(const std::filesystem::path& db_path,
                                  const std::string& db_key,
-                                 int pool_size) {
+                                 int pool_size,
+                                 int read_pool_size,
+                                 VectorEncoding vector_encoding,
+                                 const ConnectionOptions& connections) {
   if (is_initialized_) {
     return;
   }
@@ -24,109 +59,349 @@ void DatabaseManager::initialize(const std::filesystem::path& db_path,
   std::filesystem::create_directories(db_path.parent_path());
 
   // 1. Perform one-time schema setup before creating the pool
-  setup_schema(db_path, db_key);
+  const CipherOptions& cipher = connections.cipher;
+  setup_schema(db_path, db_key, cipher);
 
-  // 2. Create the connection pool for workers to use
-  pool_ = std::make_unique<ConnectionPool>(db_path.string(), db_key, pool_size);
+  // 2. Work out the key the other connections use on the one the writer gets, then create the
+  // connection pools: readers never wait behind connections held for writing
+  std::string connection_key;
+  std::unique_ptr<PooledDatabase> writer_connection =
+      open_keyed_connection(db_path, db_key, cipher, connection_key);
+  pool_ = std::make_unique<ConnectionPool>(db_path.string(), connection_key,
+                                           std::min(connections.min_pool_size, pool_size),
+                                           pool_size, ConnectionAccess::ReadWrite, cipher);
+  read_pool_ = std::make_unique<ConnectionPool>(
+      db_path.string(), connection_key, std::min(connections.min_pool_size, read_pool_size),
+      read_pool_size, ConnectionAccess::ReadOnly, cipher);
 
+  db_path_ = db_path;
+  db_key_ = db_key;
+  vector_encoding_ = vector_encoding;
   is_initialized_ = true;
+
+  // 3. Bring the vector segments in line with the database
+  maintain_vector_stores();
+
+  // 4. Start the writer on a connection of its own
+  writer_ = std::make_unique<DatabaseWriter>(std::move(writer_connection));
+}
+
+std::unique_ptr<PooledDatabase> DatabaseManager::open_keyed_connection(
+    const std::filesystem::path& db_path,
+    const std::string& db_key,
+    const CipherOptions& cipher,
+    std::string& connection_key) {
+  if (cipher.raw_key) {
+    std::string raw_key = ConnectionPool::derive_raw_key(db_path.string(), db_key, cipher);
+    if (!raw_key.empty()) {
+      try {
+        auto conn = ConnectionPool::open_connection(db_path.string(), raw_key,
+                                                    ConnectionAccess::ReadWrite, cipher);
+        connection_key = std::move(raw_key);
+        return conn;
+      } catch (const std::exception& e) {
+        // E.g. a database with a plaintext header or another KDF: the file does not start
+        // with the salt, or the key is derived differently
+        log::warning() << "The database rejected the derived raw key (" << e.what()
+                       << "); keying connections with the passphrase";
+      }
+    }
+  }
+  connection_key = db_key;
+  return ConnectionPool::open_connection(db_path.string(), db_key, ConnectionAccess::ReadWrite,
+                                         cipher);
 }
 void DatabaseManager::shutdown() {
   if (!is_initialized_) {
     return;
   }
+  // Commits the writes still queued
+  writer_.reset();
+  {
+    std::lock_guard<std::mutex> lock(vector_stores_mutex_);
+    vector_stores_.clear();
+  }
   pool_->shutdown();
+  read_pool_->shutdown();
   is_initialized_ = false;
 }
-std::unique_ptr<sqlite::database> DatabaseManager::get_connection() {
+std::unique_ptr<PooledDatabase> DatabaseManager::get_connection(ConnectionAccess access) {
   if (!is_initialized_) {
     throw std::runtime_error("DatabaseManager has not been initialized.");
   }
-  return pool_->get_connection();
+  return pool(access).get_connection();
 }
 
-void DatabaseManager::return_connection(std::unique_ptr<sqlite::database> conn) {
+void DatabaseManager::return_connection(std::unique_ptr<PooledDatabase> conn,
+                                        ConnectionAccess access) {
   if (!is_initialized_) {
     return;
   }
-  pool_->return_connection(std::move(conn));
+  pool(access).return_connection(std::move(conn));
+}
+
+ConnectionPoolStats DatabaseManager::pool_stats(ConnectionAccess access) const {
+  if (!is_initialized_) {
+    throw std::runtime_error("DatabaseManager has not been initialized.");
+  }
+  return pool(access).stats();
+}
+
+std::unique_ptr<PooledDatabase> DatabaseManager::open_unpooled_connection(
+    ConnectionAccess access, const std::filesystem::path& db_path) const {
+  if (!is_initialized_) {
+    throw std::runtime_error("DatabaseManager has not been initialized.");
+  }
+  return pool(access).open_unpooled(db_path.string());
+}
+
+void DatabaseManager::reserve_row_ids(int64_t first_id, int64_t last_id) {
+  PooledConnection conn(*this);
+  Transaction tx(*conn, true);
+  // AUTOINCREMENT hands out one more than the larger of sqlite_sequence and the largest id
+  for (const VectorTable& table : VECTOR_TABLES) {
+    const std::string name = table.table;
+    *conn << "UPDATE sqlite_sequence SET seq = ? WHERE name = ? AND seq < ?" << first_id - 1
+          << name << first_id - 1;
+    *conn << "INSERT INTO sqlite_sequence (name, seq) SELECT ?, ? WHERE NOT EXISTS "
+             "(SELECT 1 FROM sqlite_sequence WHERE name = ?)"
+          << name << first_id - 1 << name;
+    int64_t used = 0;
+    *conn << "SELECT seq FROM sqlite_sequence WHERE name = ?" << name >> used;
+    if (used >= last_id) {
+      throw ShardMapError("Database " + db_path_.string() + " has used up its " + name +
+                          " ids (" + std::to_string(first_id) + " to " +
+                          std::to_string(last_id) + "); its ids would collide with the "
+                          "next database's");
+    }
+    // Reopened with every start, so a changed range replaces the old bound. Aborting the
+    // insert after the fact rolls it back, as a BEFORE trigger does not see the new id yet.
+    const std::string trigger = name + "_id_range";
+    *conn << "DROP TRIGGER IF EXISTS " + trigger;
+    *conn << "CREATE TRIGGER " + trigger + " AFTER INSERT ON " + name +
+                 " WHEN NEW.id > " + std::to_string(last_id) +
+                 " BEGIN SELECT RAISE(ABORT, '" + name +
+                 " id past the end of this database''s range'); END";
+  }
+  tx.commit();
+}
+
+ConnectionPool& DatabaseManager::pool(ConnectionAccess access) const {
+  return access == ConnectionAccess::ReadOnly ? *read_pool_ : *pool_;
+}
+
+DatabaseWriter& DatabaseManager::writer() {
+  if (!is_initialized_ || !writer_) {
+    throw std::runtime_error("DatabaseManager has not been initialized.");
+  }
+  return *writer_;
+}
+
+std::filesystem::path DatabaseManager::vector_store_path(const std::filesystem::path& db_path,
+                                                         const std::string& name) {
+  // metadata.db -> metadata.chunks.vec
+  std::filesystem::path path = db_path;
+  path.replace_extension("." + name + ".vec");
+  return path;
+}
+
+std::shared_ptr<VectorStore> DatabaseManager::vector_store(const std::string& name,
+                                                           int dimension) {
+  if (!is_initialized_) {
+    throw std::runtime_error("DatabaseManager has not been initialized.");
+  }
+  std::lock_guard<std::mutex> lock(vector_stores_mutex_);
+  auto it = vector_stores_.find(name);
+  if (it != vector_stores_.end()) {
+    if (it->second->dimension() != dimension) {
+      throw VectorStoreError("Vector store '" + name + "' holds " +
+                             std::to_string(it->second->dimension()) +
+                             "-dimensional vectors, not " + std::to_string(dimension));
+    }
+    return it->second;
+  }
+  auto store = std::make_shared<VectorStore>(vector_store_path(db_path_, name), db_key_,
+                                             dimension, vector_store_epoch(name),
+                                             vector_encoding_);
+  vector_stores_.emplace(name, store);
+  return store;
+}
+
+std::shared_ptr<VectorStore> DatabaseManager::create_replacement_vector_store(
+    const std::string& name, int dimension) {
+  if (!is_initialized_) {
+    throw std::runtime_error("DatabaseManager has not been initialized.");
+  }
+  // Whatever an abandoned replacement left there was never committed
+  const auto path = VectorStore::compacted_path(vector_store_path(db_path_, name));
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  return std::make_shared<VectorStore>(path, db_key_, dimension, vector_store_epoch(name) + 1,
+                                       vector_encoding_);
+}
+
+std::shared_ptr<VectorStore> DatabaseManager::install_replacement_vector_store(
+    const std::string& name, std::shared_ptr<VectorStore> replacement) {
+  if (!is_initialized_) {
+    throw std::runtime_error("DatabaseManager has not been initialized.");
+  }
+  const auto path = vector_store_path(db_path_, name);
+  if (replacement->path() != VectorStore::compacted_path(path)) {
+    throw VectorStoreError("Vector store " + replacement->path().string() +
+                           " is not a replacement for '" + name + "'");
+  }
+  const int dimension = replacement->dimension();
+  replacement.reset();
+  std::lock_guard<std::mutex> lock(vector_stores_mutex_);
+  // Readers of the old store keep its mapping, and with it the replaced file, until they let go
+  std::filesystem::rename(VectorStore::compacted_path(path), path);
+  auto store = std::make_shared<VectorStore>(path, db_key_, dimension, vector_store_epoch(name),
+                                             vector_encoding_);
+  vector_stores_[name] = store;
+  return store;
+}
+
+int64_t DatabaseManager::vector_store_epoch(const std::string& name) {
+  PooledConnection conn(*this, ConnectionAccess::ReadOnly);
+  int64_t epoch = 0;
+  *conn << "SELECT epoch FROM vector_segments WHERE name = ?" << name >>
+      [&](int64_t value) { epoch = value; };
+  return epoch;
+}
+
+void DatabaseManager::maintain_vector_stores() {
+  for (const VectorTable& table : VECTOR_TABLES) {
+    const std::string name = table.name;
+    const std::string rows = table.table;
+    const std::string blob = table.blob_column;
+    const std::string offset = table.offset_column;
+    const auto path = vector_store_path(db_path_, name);
+    const int64_t epoch = vector_store_epoch(name);
+
+    // Offsets into a segment that has gone missing point at nothing; the vectors are gone.
+    // A committed replacement still waiting to be renamed into place counts as the segment.
+    if (!std::filesystem::exists(path) && VectorStore::stored_dimension(path, epoch) == 0) {
+      PooledConnection conn(*this);
+      *conn << "UPDATE " + rows + " SET " + offset + " = NULL WHERE " + offset + " IS NOT NULL";
+      if (conn->rows_modified() > 0) {
+        log::warning() << "Vector segment " << path << " is missing; "
+                       << conn->rows_modified() << " " << rows
+                       << " rows lost their vectors and must be re-processed.";
+      }
+    }
+
+    // Vectors written before the segment files existed are moved out of their BLOB column
+    int dimension = VectorStore::stored_dimension(path, epoch);
+    if (dimension == 0) {
+      PooledConnection conn(*this);
+      *conn << "SELECT length(" + blob + ") FROM " + rows + " WHERE " + blob +
+                   " IS NOT NULL LIMIT 1" >>
+          [&](int64_t bytes) { dimension = static_cast<int>(bytes / sizeof(float)); };
+    }
+    if (dimension == 0) {
+      continue;
+    }
+    auto store = vector_store(name, dimension);
+    const size_t vector_bytes = static_cast<size_t>(dimension) * sizeof(float);
+    size_t migrated = 0;
+    size_t dropped = 0;
+    size_t batch_rows = MIGRATION_BATCH_SIZE;
+    while (batch_rows == MIGRATION_BATCH_SIZE) {
+      PooledConnection conn(*this);
+      Transaction tx(*conn, true);
+      std::vector<int64_t> ids;
+      std::vector<float> vectors;
+      std::vector<int64_t> mismatched_ids;
+      *conn << "SELECT id, " + blob + " FROM " + rows + " WHERE " + blob + " IS NOT NULL LIMIT ?"
+            << static_cast<int64_t>(MIGRATION_BATCH_SIZE) >>
+          [&](int64_t id, std::vector<char> vector_blob) {
+            if (vector_blob.size() == vector_bytes) {
+              ids.push_back(id);
+              const float* data = reinterpret_cast<const float*>(vector_blob.data());
+              vectors.insert(vectors.end(), data, data + dimension);
+            } else {
+              mismatched_ids.push_back(id);
+            }
+          };
+      batch_rows = ids.size() + mismatched_ids.size();
+      const auto offsets = store->append(ids, vectors.data());
+      for (size_t i = 0; i < ids.size(); ++i) {
+        *conn << "UPDATE " + rows + " SET " + offset + " = ?, " + blob + " = NULL WHERE id = ?"
+              << offsets[i] << ids[i];
+      }
+      // Every index rebuild already skipped these, so nothing searchable is lost
+      for (int64_t id : mismatched_ids) {
+        *conn << "UPDATE " + rows + " SET " + blob + " = NULL WHERE id = ?" << id;
+      }
+      tx.commit();
+      migrated += ids.size();
+      dropped += mismatched_ids.size();
+    }
+    if (migrated > 0 || dropped > 0) {
+      log::info() << "Moved " << migrated << " " << rows << " vectors into " << path << " ("
+                  << dropped << " of the wrong dimension dropped).";
+    }
+
+    // Replaced vectors stay behind as dead records; rewrite the segment once they dominate
+    std::vector<int64_t> live_ids;
+    std::vector<VectorStore::Offset> live_offsets;
+    {
+      PooledConnection conn(*this);
+      *conn << "SELECT id, " + offset + " FROM " + rows + " WHERE " + offset +
+                   " IS NOT NULL ORDER BY " + offset >>
+          [&](int64_t id, int64_t record) {
+            live_ids.push_back(id);
+            live_offsets.push_back(record);
+          };
+    }
+    const size_t records = store->record_count();
+    const size_t dead = records > live_ids.size() ? records - live_ids.size() : 0;
+    // A compaction writes the configured encoding, so it doubles as the conversion
+    const VectorEncoding stored_encoding = store->encoding();
+    const bool convert = stored_encoding != vector_encoding_;
+    if (!convert && (dead <= live_ids.size() || dead < COMPACTION_MIN_DEAD_RECORDS)) {
+      continue;
+    }
+    store->write_compacted(live_offsets, live_ids);
+    {
+      // Once this commits, a restart installs the compacted file even if the rename below
+      // never happens
+      PooledConnection conn(*this);
+      Transaction tx(*conn, true);
+      for (size_t i = 0; i < live_ids.size(); ++i) {
+        *conn << "UPDATE " + rows + " SET " + offset + " = ? WHERE id = ?"
+              << static_cast<int64_t>(i) << live_ids[i];
+      }
+      *conn << "UPDATE vector_segments SET epoch = epoch + 1 WHERE name = ?" << name;
+      tx.commit();
+    }
+    store->install_compacted();
+    log::Line line = log::info();
+    line << "Compacted " << path << ": dropped " << dead << " dead records";
+    if (convert) {
+      line << ", converted " << live_ids.size() << " vectors from " << to_string(stored_encoding)
+           << " to " << to_string(vector_encoding_);
+    }
+    line << ".";
+  }
 }
 
 void DatabaseManager::setup_schema(const std::filesystem::path& db_path,
-                                   const std::string& db_key) {
+                                   const std::string& db_key,
+                                   const CipherOptions& cipher) {
   // Use a temporary, single-use connection just for schema setup.
-  // This ensures table creation is a single, non-pooled operation.
+  // This ensures table creation is a single, non-pooled operation. It is keyed with the
+  // passphrase: a new database only gets its salt once this connection writes to it.
   sqlite::database db(db_path.string());
-  sqlite3* handle = db.connection().get();
-  if (!handle) {
-    throw std::runtime_error("Setup: Failed to get native database handle.");
-  }
-  if (sqlite3_key(handle, db_key.c_str(), db_key.length()) != SQLITE_OK) {
-    throw std::runtime_error("Setup: Failed to key database: " +
-                             std::string(sqlite3_errmsg(handle)));
-  }
-  db << "SELECT count(*) FROM sqlite_master;";
+  ConnectionPool::key_database(db, db_key, cipher);
+  // Lets index maintenance hand free pages back a few at a time. Only takes effect on a
+  // database with no tables yet; older ones keep their mode until a full VACUUM.
+  db << "PRAGMA auto_vacuum = INCREMENTAL;";
   db << "PRAGMA foreign_keys = ON;";
   db << "PRAGMA journal_mode = WAL;";
 
-  db << R"(
-      CREATE TABLE IF NOT EXISTS files (
-          id INTEGER PRIMARY KEY AUTOINCREMENT,
-          path TEXT UNIQUE NOT NULL,
-          original_path TEXT,
-          file_hash TEXT NOT NULL,
-          processing_status TEXT NOT NULL,
-          summary_vector_blob BLOB,
-          suggested_category TEXT,
-          suggested_filename TEXT,
-          tags TEXT,
-          last_modified TEXT NOT NULL,
-          created_at TEXT NOT NULL,
-          file_type TEXT NOT NULL,
-          file_size INTEGER NOT NULL
-      )
-    )";
-
-  // chunks
-  db << R"(
-      CREATE TABLE IF NOT EXISTS chunks (
-          id INTEGER PRIMARY KEY AUTOINCREMENT,
-          file_id INTEGER NOT NULL,
-          chunk_index INTEGER NOT NULL,
-          content BLOB NOT NULL,
-          vector_blob BLOB,
-          FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE
-      )
-    )";
-
-  // task_queue
-  db << R"(
-      CREATE TABLE IF NOT EXISTS task_queue (
-          id INTEGER PRIMARY KEY AUTOINCREMENT,
-          task_type TEXT NOT NULL,
-          status TEXT DEFAULT 'PENDING',
-          priority INTEGER DEFAULT 10,
-          error_message TEXT,
-          created_at TEXT NOT NULL,
-          updated_at TEXT NOT NULL,
-          target_path TEXT NULL, -- Used by PROCESS_FILE, DELETE_FILE, etc.
-          target_tag TEXT NULL,  -- Used by RETROACTIVE_TAG, RENAME_TAG, etc.
-          payload TEXT NULL      -- For less common or complex arguments like 'keywords'
-      )
-    )";
-  db << R"(
-        CREATE TABLE IF NOT EXISTS task_progress (
-        task_id INTEGER PRIMARY KEY, -- This is a FOREIGN KEY to task_queue.id
-        progress_percent REAL NOT NULL DEFAULT 0.0,
-        status_message TEXT NOT NULL DEFAULT 'Initializing...',
-        updated_at TEXT NOT NULL,
-        FOREIGN KEY (task_id) REFERENCES task_queue(id) ON DELETE CASCADE
-    )
-    )";
-  db << R"(
-      CREATE INDEX IF NOT EXISTS idx_task_queue_status_priority 
-      ON task_queue(status, priority, created_at)
-    )";
+  // Creates the schema on a new database and migrates an existing one to this build's version
+  migrate_schema(db);
 }
 
 }  // namespace magic_core
\ No newline at end of file
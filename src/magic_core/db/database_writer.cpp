@@ -0,0 +1,161 @@
+#include "magic_core/db/database_writer.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "magic_core/types/metrics.hpp"
+
+namespace magic_core {
+
+DatabaseWriter::DatabaseWriter(std::unique_ptr<PooledDatabase> connection,
+                               DatabaseWriterOptions options)
+    : connection_(std::move(connection)), options_(options) {
+  if (options_.max_batch == 0) {
+    options_.max_batch = 1;
+  }
+  // Writes made outside the writer (schema setup, task creation) still take the lock briefly
+  connection_->db << "PRAGMA busy_timeout = 5000;";
+  thread_ = std::thread(&DatabaseWriter::run_loop, this);
+}
+
+DatabaseWriter::~DatabaseWriter() {
+  stop();
+}
+
+void DatabaseWriter::set_options(DatabaseWriterOptions options) {
+  if (options.max_batch == 0) {
+    options.max_batch = 1;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+  }
+  // A batch waiting out the old delay re-checks against the new limits
+  cv_.notify_all();
+}
+
+DatabaseWriterOptions DatabaseWriter::options() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return options_;
+}
+
+std::future<void> DatabaseWriter::submit(Write write) {
+  Pending pending{std::move(write), {}};
+  std::future<void> done = pending.done.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      throw DatabaseWriterError("Database writer is shut down");
+    }
+    queue_.push_back(std::move(pending));
+  }
+  cv_.notify_one();
+  return done;
+}
+
+void DatabaseWriter::run(Write write) {
+  if (std::this_thread::get_id() == thread_.get_id()) {
+    throw DatabaseWriterError("A database write may not wait on the writer it runs on");
+  }
+  submit(std::move(write)).get();
+}
+
+void DatabaseWriter::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void DatabaseWriter::run_loop() {
+  while (true) {
+    std::deque<Pending> batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;  // Stopping with nothing left to commit
+      }
+      // Give concurrent writers a moment to join this transaction
+      if (!stopping_ && options_.commit_delay.count() > 0 &&
+          queue_.size() < options_.max_batch) {
+        cv_.wait_for(lock, options_.commit_delay,
+                     [this] { return stopping_ || queue_.size() >= options_.max_batch; });
+      }
+      const size_t take = std::min(queue_.size(), options_.max_batch);
+      for (size_t i = 0; i < take; ++i) {
+        batch.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+    }
+    commit_batch(batch);
+  }
+}
+
+void DatabaseWriter::commit_batch(std::deque<Pending> &batch) {
+  static metrics::Histogram &duration = metrics::histogram(
+      "magic_sqlite_transaction_seconds", "Write transactions from BEGIN to COMMIT");
+  static metrics::Histogram &batch_sizes = metrics::histogram(
+      "magic_sqlite_transaction_writes", "Writes committed together", metrics::size_buckets());
+  metrics::ScopedTimer timer(duration);
+  batch_sizes.observe(static_cast<double>(batch.size()));
+  sqlite::database &db = connection_->db;
+  std::vector<std::exception_ptr> errors(batch.size());
+  try {
+    db << "BEGIN IMMEDIATE;";
+  } catch (...) {
+    const auto error = std::current_exception();
+    for (auto &pending : batch) {
+      pending.done.set_exception(error);
+    }
+    return;
+  }
+
+  size_t succeeded = 0;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    try {
+      db << "SAVEPOINT pending_write;";
+      batch[i].write(*connection_);
+      db << "RELEASE pending_write;";
+      ++succeeded;
+    } catch (...) {
+      errors[i] = std::current_exception();
+      try {
+        db << "ROLLBACK TO pending_write;";
+        db << "RELEASE pending_write;";
+      } catch (...) {
+        // The commit below reports whatever state this leaves the transaction in
+      }
+    }
+  }
+
+  try {
+    db << "COMMIT;";
+  } catch (...) {
+    const auto error = std::current_exception();
+    try {
+      db << "ROLLBACK;";
+    } catch (...) {
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+      batch[i].done.set_exception(errors[i] ? errors[i] : error);
+    }
+    return;
+  }
+
+  ++commits_;
+  writes_committed_ += succeeded;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (errors[i]) {
+      batch[i].done.set_exception(errors[i]);
+    } else {
+      batch[i].done.set_value();
+    }
+  }
+}
+
+}  // namespace magic_core
@@ -0,0 +1,210 @@
+#include "magic_core/db/embedding_cache.hpp"
+
+#include <openssl/evp.h>
+#include <sqlite_modern_cpp.h>
+
+#include <cstring>
+#include <nlohmann/json.hpp>
+
+#include "magic_core/db/pooled_connection.hpp"
+#include "magic_core/db/sqlite_error_utils.hpp"
+
+namespace magic_core {
+
+EmbeddingCache::EmbeddingCache(DatabaseManager& db_manager,
+                               std::string model,
+                               size_t memory_entries,
+                               size_t near_duplicate_entries,
+                               int near_duplicate_distance)
+    : db_manager_(db_manager), model_(std::move(model)), memory_(memory_entries) {
+  if (near_duplicate_entries > 0) {
+    near_ = std::make_unique<NearDuplicateIndex>(near_duplicate_entries, near_duplicate_distance);
+  }
+}
+
+std::string EmbeddingCache::content_key(std::string_view text) {
+  unsigned char hash[EVP_MAX_MD_SIZE];
+  unsigned int hash_len = 0;
+  if (EVP_Digest(text.data(), text.size(), hash, &hash_len, EVP_sha256(), nullptr) != 1) {
+    throw EmbeddingCacheError("Failed to hash chunk content");
+  }
+  static constexpr char HEX[] = "0123456789abcdef";
+  std::string key(hash_len * 2, '\0');
+  for (unsigned int i = 0; i < hash_len; ++i) {
+    key[2 * i] = HEX[hash[i] >> 4];
+    key[2 * i + 1] = HEX[hash[i] & 0x0F];
+  }
+  return key;
+}
+
+namespace {
+
+std::string memory_key(const std::string& model, const std::string& key) {
+  std::string combined;
+  combined.reserve(model.size() + 1 + key.size());
+  combined.append(model).push_back('\0');
+  combined.append(key);
+  return combined;
+}
+
+}  // namespace
+
+std::string EmbeddingCache::model() const {
+  std::lock_guard<std::mutex> lock(model_mutex_);
+  return model_;
+}
+
+void EmbeddingCache::set_model(std::string model) {
+  std::lock_guard<std::mutex> lock(model_mutex_);
+  model_ = std::move(model);
+  if (near_) {
+    near_->clear();
+  }
+}
+
+std::vector<std::vector<float>> EmbeddingCache::lookup(const std::vector<std::string>& keys) {
+  return fetch(keys, /*counted*/ true);
+}
+
+std::vector<std::vector<float>> EmbeddingCache::lookup_near(
+    const std::vector<std::optional<uint64_t>>& fingerprints) {
+  std::vector<std::vector<float>> vectors(fingerprints.size());
+  if (!near_) {
+    return vectors;
+  }
+  std::vector<size_t> found;
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < fingerprints.size(); ++i) {
+    if (!fingerprints[i]) {
+      continue;
+    }
+    if (auto key = near_->find(*fingerprints[i])) {
+      found.push_back(i);
+      keys.push_back(std::move(*key));
+    }
+  }
+  if (keys.empty()) {
+    return vectors;
+  }
+  // The key may have been evicted from the table since, in which case the chunk is embedded
+  std::vector<std::vector<float>> originals = fetch(keys, /*counted*/ false);
+  size_t hits = 0;
+  for (size_t f = 0; f < found.size(); ++f) {
+    if (!originals[f].empty()) {
+      vectors[found[f]] = std::move(originals[f]);
+      ++hits;
+    }
+  }
+  near_hits_ += hits;
+  return vectors;
+}
+
+void EmbeddingCache::remember(const std::vector<std::optional<uint64_t>>& fingerprints,
+                              const std::vector<std::string>& keys) {
+  if (fingerprints.size() != keys.size()) {
+    throw EmbeddingCacheError("embedding_cache_remember: " + std::to_string(keys.size()) +
+                              " keys for " + std::to_string(fingerprints.size()) +
+                              " fingerprints");
+  }
+  if (!near_) {
+    return;
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (fingerprints[i]) {
+      near_->insert(*fingerprints[i], keys[i]);
+    }
+  }
+}
+
+std::vector<std::vector<float>> EmbeddingCache::fetch(const std::vector<std::string>& keys,
+                                                      bool counted) {
+  const std::string model = this->model();
+  std::vector<std::vector<float>> vectors(keys.size());
+  std::vector<size_t> not_in_memory;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (auto vector = memory_.get(memory_key(model, keys[i]))) {
+      vectors[i] = std::move(*vector);
+    } else {
+      not_in_memory.push_back(i);
+    }
+  }
+  if (counted) {
+    memory_hits_ += keys.size() - not_in_memory.size();
+  }
+  if (not_in_memory.empty()) {
+    return vectors;
+  }
+
+  std::unordered_map<std::string, std::vector<float>> found;
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    // The whole miss list is one JSON parameter, so there is no bound parameter limit to batch
+    // around and the statement text never changes
+    nlohmann::json missing = nlohmann::json::array();
+    for (size_t i : not_in_memory) {
+      missing.push_back(keys[i]);
+    }
+    conn.prepare("SELECT content_hash, vector_blob FROM embedding_cache "
+                 "WHERE model = ? AND content_hash IN (SELECT value FROM json_each(?))")
+            << model << missing.dump() >>
+        [&](std::string content_hash, std::vector<char> vector_blob) {
+          std::vector<float> vector(vector_blob.size() / sizeof(float));
+          std::memcpy(vector.data(), vector_blob.data(), vector.size() * sizeof(float));
+          found.emplace(std::move(content_hash), std::move(vector));
+        };
+  } catch (const sqlite::sqlite_exception& e) {
+    throw EmbeddingCacheError(format_db_error("embedding_cache_lookup", e));
+  }
+
+  size_t disk_hits = 0;
+  for (size_t i : not_in_memory) {
+    auto it = found.find(keys[i]);
+    if (it != found.end() && !it->second.empty()) {
+      vectors[i] = it->second;
+      memory_.put(memory_key(model, keys[i]), it->second);
+      ++disk_hits;
+    }
+  }
+  if (counted) {
+    disk_hits_ += disk_hits;
+    misses_ += not_in_memory.size() - disk_hits;
+  }
+  return vectors;
+}
+
+void EmbeddingCache::store(const std::vector<std::string>& keys,
+                           const std::vector<std::vector<float>>& vectors) {
+  if (keys.size() != vectors.size()) {
+    throw EmbeddingCacheError("embedding_cache_store: " + std::to_string(keys.size()) +
+                              " keys for " + std::to_string(vectors.size()) + " vectors");
+  }
+  if (keys.empty()) {
+    return;
+  }
+  const std::string model = this->model();
+  try {
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      auto& insert = conn.prepare(
+          "INSERT OR REPLACE INTO embedding_cache (content_hash, model, vector_blob) "
+          "VALUES (?, ?, ?)");
+      for (size_t i = 0; i < keys.size(); ++i) {
+        std::vector<char> vector_blob(vectors[i].size() * sizeof(float));
+        std::memcpy(vector_blob.data(), vectors[i].data(), vector_blob.size());
+        insert << keys[i] << model << vector_blob;
+        insert.execute();
+      }
+    });
+  } catch (const sqlite::sqlite_exception& e) {
+    throw EmbeddingCacheError(format_db_error("embedding_cache_store", e));
+  }
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    memory_.put(memory_key(model, keys[i]), vectors[i]);
+  }
+}
+
+EmbeddingCacheStats EmbeddingCache::stats() const {
+  return {memory_hits_.load(), disk_hits_.load(), misses_.load(), near_hits_.load()};
+}
+
+}  // namespace magic_core
@@ -0,0 +1,136 @@
+#include "magic_core/db/embedding_model_registry.hpp"
+
+#include <sqlite_modern_cpp.h>
+
+#include "magic_core/db/epoch_millis.hpp"
+#include "magic_core/db/pooled_connection.hpp"
+#include "magic_core/db/sqlite_error_utils.hpp"
+
+namespace magic_core {
+
+EmbeddingModelRegistry::EmbeddingModelRegistry(DatabaseManager& db_manager)
+    : db_manager_(db_manager) {}
+
+std::vector<EmbeddingModel> EmbeddingModelRegistry::list() {
+  std::vector<EmbeddingModel> models;
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT id, name, dimension, created_at, active FROM embedding_models "
+                 "ORDER BY id") >>
+        [&](int64_t id, std::string name, int dimension, int64_t created_at, int active) {
+          models.push_back({id, std::move(name), dimension, from_epoch_millis(created_at),
+                            active != 0});
+        };
+  } catch (const sqlite::sqlite_exception& e) {
+    throw EmbeddingModelRegistryError(format_db_error("list_embedding_models", e));
+  }
+  return models;
+}
+
+std::optional<EmbeddingModel> EmbeddingModelRegistry::active() {
+  for (auto& model : list()) {
+    if (model.active) {
+      return std::move(model);
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<EmbeddingModel> EmbeddingModelRegistry::find(const std::string& name) {
+  for (auto& model : list()) {
+    if (model.name == name) {
+      return std::move(model);
+    }
+  }
+  return std::nullopt;
+}
+
+EmbeddingModel EmbeddingModelRegistry::register_model(const std::string& name, int dimension) {
+  if (name.empty() || dimension <= 0) {
+    throw EmbeddingModelRegistryError("An embedding model needs a name and a positive dimension");
+  }
+  if (auto existing = find(name)) {
+    if (existing->dimension == dimension) {
+      return *existing;
+    }
+    if (existing->active) {
+      throw EmbeddingModelRegistryError("Embedding model '" + name + "' is registered with " +
+                                        std::to_string(existing->dimension) +
+                                        " dimensions, not " + std::to_string(dimension));
+    }
+    // Only the active model has vectors (a re-embed's are discarded unless it installs them),
+    // so an inactive one, e.g. registered with a guessed dimension, can still be resized
+    try {
+      db_manager_.writer().run([&](PooledDatabase& conn) {
+        auto& update = conn.prepare(
+            "UPDATE embedding_models SET dimension = ? WHERE name = ? AND active = 0");
+        update << dimension << name;
+        update.execute();
+      });
+    } catch (const sqlite::sqlite_exception& e) {
+      throw EmbeddingModelRegistryError(format_db_error("register_embedding_model", e));
+    }
+    // Activated meanwhile, the row kept its dimension and the check above throws
+    return register_model(name, dimension);
+  }
+  try {
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      auto& insert = conn.prepare(
+          "INSERT OR IGNORE INTO embedding_models (name, dimension, created_at) VALUES (?, ?, ?)");
+      insert << name << dimension << to_epoch_millis(std::chrono::system_clock::now());
+      insert.execute();
+    });
+  } catch (const sqlite::sqlite_exception& e) {
+    throw EmbeddingModelRegistryError(format_db_error("register_embedding_model", e));
+  }
+  // Another registration may have won the race; either way the row is there now
+  return register_model(name, dimension);
+}
+
+void EmbeddingModelRegistry::activate_in(PooledDatabase& conn, const std::string& name) {
+  bool exists = false;
+  conn.prepare("SELECT 1 FROM embedding_models WHERE name = ?") << name >>
+      [&](int) { exists = true; };
+  if (!exists) {
+    throw EmbeddingModelRegistryError("Embedding model '" + name + "' is not registered");
+  }
+  // Deactivate first: the partial unique index allows one active row at any point
+  auto& deactivate =
+      conn.prepare("UPDATE embedding_models SET active = 0 WHERE active = 1 AND name != ?");
+  deactivate << name;
+  deactivate.execute();
+  auto& update = conn.prepare("UPDATE embedding_models SET active = 1 WHERE name = ?");
+  update << name;
+  update.execute();
+}
+
+void EmbeddingModelRegistry::activate(const std::string& name) {
+  try {
+    db_manager_.writer().run([&](PooledDatabase& conn) { activate_in(conn, name); });
+  } catch (const sqlite::sqlite_exception& e) {
+    throw EmbeddingModelRegistryError(format_db_error("activate_embedding_model", e));
+  }
+}
+
+EmbeddingModel EmbeddingModelRegistry::ensure_active(const std::string& name, int dimension) {
+  if (auto current = active()) {
+    return *current;
+  }
+  register_model(name, dimension);
+  try {
+    // Only if nobody activated another model in the meantime
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      bool any_active = false;
+      conn.prepare("SELECT 1 FROM embedding_models WHERE active = 1") >>
+          [&](int) { any_active = true; };
+      if (!any_active) {
+        activate_in(conn, name);
+      }
+    });
+  } catch (const sqlite::sqlite_exception& e) {
+    throw EmbeddingModelRegistryError(format_db_error("activate_embedding_model", e));
+  }
+  return *active();
+}
+
+}  // namespace magic_core
@@ -0,0 +1,113 @@
+#include "magic_core/db/faiss_gpu.hpp"
+
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/impl/FaissException.h>
+
+#include <map>
+
+#include "magic_core/types/logger.hpp"
+
+#if defined(MAGIC_FAISS_GPU)
+#include <faiss/gpu/GpuCloner.h>
+#include <faiss/gpu/GpuClonerOptions.h>
+#include <faiss/gpu/StandardGpuResources.h>
+#include <faiss/gpu/utils/DeviceUtils.h>
+#endif
+
+namespace magic_core::faiss_gpu {
+
+namespace {
+
+struct Device {
+  std::mutex mutex;
+#if defined(MAGIC_FAISS_GPU)
+  // Created on first use and kept for the life of the process, like the CUDA context itself
+  std::unique_ptr<faiss::gpu::StandardGpuResources> resources;
+#endif
+};
+
+// std::map nodes never move, so a Device stays put once created
+Device &device_state(int device) {
+  static std::mutex registry_mutex;
+  static std::map<int, Device> devices;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  return devices[device];
+}
+
+}  // namespace
+
+bool compiled_in() {
+#if defined(MAGIC_FAISS_GPU)
+  return true;
+#else
+  return false;
+#endif
+}
+
+int device_count() {
+#if defined(MAGIC_FAISS_GPU)
+  try {
+    return faiss::gpu::getNumDevices();
+  } catch (const faiss::FaissException &e) {
+    log::warning() << "Cannot list CUDA devices: " << e.what();
+    return 0;
+  }
+#else
+  return 0;
+#endif
+}
+
+bool supports(const faiss::Index &index) {
+  return dynamic_cast<const faiss::IndexFlat *>(&index) != nullptr ||
+         dynamic_cast<const faiss::IndexIVF *>(&index) != nullptr;
+}
+
+std::unique_ptr<faiss::Index> to_gpu(const faiss::Index &index, int device) {
+#if defined(MAGIC_FAISS_GPU)
+  if (device < 0 || device >= device_count() || !supports(index)) {
+    return nullptr;
+  }
+  Device &state = device_state(device);
+  std::lock_guard<std::mutex> lock(state.mutex);
+  try {
+    if (!state.resources) {
+      state.resources = std::make_unique<faiss::gpu::StandardGpuResources>();
+    }
+    faiss::gpu::GpuClonerOptions options;
+    // Half-precision PQ lookup tables: needed for the larger sub-quantizer counts to fit in
+    // shared memory, at no measurable recall cost
+    options.useFloat16 = true;
+    return std::unique_ptr<faiss::Index>(
+        faiss::gpu::index_cpu_to_gpu(state.resources.get(), device, &index, &options));
+  } catch (const faiss::FaissException &e) {
+    log::warning() << "Cannot copy a vector index to GPU " << device << ": " << e.what();
+    return nullptr;
+  }
+#else
+  (void)index;
+  (void)device;
+  return nullptr;
+#endif
+}
+
+std::unique_ptr<faiss::Index> to_cpu(const faiss::Index &index, int device) {
+#if defined(MAGIC_FAISS_GPU)
+  std::lock_guard<std::mutex> lock(device_state(device).mutex);
+  return std::unique_ptr<faiss::Index>(faiss::gpu::index_gpu_to_cpu(&index));
+#else
+  (void)index;
+  (void)device;
+  throw faiss::FaissException("faiss GPU support is not compiled in");
+#endif
+}
+
+std::unique_lock<std::mutex> lock(int device) {
+  return std::unique_lock<std::mutex>(device_state(device).mutex);
+}
+
+std::unique_lock<std::mutex> try_lock(int device) {
+  return std::unique_lock<std::mutex>(device_state(device).mutex, std::try_to_lock);
+}
+
+}  // namespace magic_core::faiss_gpu
@@ -0,0 +1,140 @@
+#include "magic_core/db/index_snapshot.hpp"
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include "magic_core/types/logger.hpp"
+
+namespace magic_core {
+
+namespace {
+
+constexpr char MAGIC[4] = {'M', 'F', 'I', 'S'};
+constexpr size_t IV_SIZE = 12;
+constexpr size_t TAG_SIZE = 16;
+// magic + version + generation, authenticated but not encrypted
+constexpr size_t AAD_SIZE = sizeof(MAGIC) + sizeof(uint32_t) + sizeof(int64_t);
+constexpr size_t HEADER_SIZE = AAD_SIZE + IV_SIZE + TAG_SIZE;
+
+using CipherCtx = std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)>;
+
+std::array<unsigned char, 32> derive_key(const std::string &db_key) {
+  static const std::string label = "magic-folder/index-snapshot/v1";
+  std::string material = label + db_key;
+  std::array<unsigned char, 32> key{};
+  unsigned int key_len = 0;
+  if (EVP_Digest(material.data(), material.size(), key.data(), &key_len, EVP_sha256(),
+                 nullptr) != 1 ||
+      key_len != key.size()) {
+    throw IndexSnapshotError("Failed to derive index snapshot key");
+  }
+  return key;
+}
+
+std::vector<uint8_t> make_aad(uint32_t version, long long generation) {
+  std::vector<uint8_t> aad(AAD_SIZE);
+  const int64_t gen = generation;
+  std::memcpy(aad.data(), MAGIC, sizeof(MAGIC));
+  std::memcpy(aad.data() + sizeof(MAGIC), &version, sizeof(version));
+  std::memcpy(aad.data() + sizeof(MAGIC) + sizeof(version), &gen, sizeof(gen));
+  return aad;
+}
+
+}  // namespace
+
+void IndexSnapshot::write(const std::filesystem::path &path,
+                          const std::string &db_key,
+                          long long generation,
+                          const std::vector<uint8_t> &payload) {
+  const auto key = derive_key(db_key);
+  const auto aad = make_aad(FORMAT_VERSION, generation);
+
+  unsigned char iv[IV_SIZE];
+  if (RAND_bytes(iv, IV_SIZE) != 1) {
+    throw IndexSnapshotError("Failed to generate snapshot IV");
+  }
+
+  CipherCtx ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+  std::vector<uint8_t> ciphertext(payload.size());
+  unsigned char tag[TAG_SIZE];
+  int len = 0;
+  if (!ctx || EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, key.data(), iv) != 1 ||
+      EVP_EncryptUpdate(ctx.get(), nullptr, &len, aad.data(), static_cast<int>(aad.size())) != 1 ||
+      EVP_EncryptUpdate(ctx.get(), ciphertext.data(), &len, payload.data(),
+                        static_cast<int>(payload.size())) != 1 ||
+      EVP_EncryptFinal_ex(ctx.get(), ciphertext.data() + len, &len) != 1 ||
+      EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, TAG_SIZE, tag) != 1) {
+    throw IndexSnapshotError("Failed to encrypt index snapshot");
+  }
+
+  std::filesystem::path tmp_path = path;
+  tmp_path += ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+      throw IndexSnapshotError("Could not open index snapshot for writing: " + tmp_path.string());
+    }
+    out.write(reinterpret_cast<const char *>(aad.data()), aad.size());
+    out.write(reinterpret_cast<const char *>(iv), IV_SIZE);
+    out.write(reinterpret_cast<const char *>(tag), TAG_SIZE);
+    out.write(reinterpret_cast<const char *>(ciphertext.data()), ciphertext.size());
+    if (!out) {
+      throw IndexSnapshotError("Failed to write index snapshot: " + tmp_path.string());
+    }
+  }
+  std::filesystem::rename(tmp_path, path);
+}
+
+std::optional<std::vector<uint8_t>> IndexSnapshot::read(const std::filesystem::path &path,
+                                                        const std::string &db_key,
+                                                        long long expected_generation) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open()) {
+    return std::nullopt;
+  }
+  std::vector<uint8_t> file_bytes((std::istreambuf_iterator<char>(in)),
+                                  std::istreambuf_iterator<char>());
+  if (file_bytes.size() < HEADER_SIZE ||
+      std::memcmp(file_bytes.data(), MAGIC, sizeof(MAGIC)) != 0) {
+    log::warning() << "Ignoring malformed index snapshot " << path;
+    return std::nullopt;
+  }
+
+  uint32_t version = 0;
+  int64_t generation = 0;
+  std::memcpy(&version, file_bytes.data() + sizeof(MAGIC), sizeof(version));
+  std::memcpy(&generation, file_bytes.data() + sizeof(MAGIC) + sizeof(version), sizeof(generation));
+  if (version != FORMAT_VERSION || generation != expected_generation) {
+    return std::nullopt;
+  }
+
+  const auto key = derive_key(db_key);
+  const uint8_t *iv = file_bytes.data() + AAD_SIZE;
+  const uint8_t *tag = iv + IV_SIZE;
+  const uint8_t *ciphertext = tag + TAG_SIZE;
+  const size_t ciphertext_size = file_bytes.size() - HEADER_SIZE;
+
+  CipherCtx ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+  std::vector<uint8_t> payload(ciphertext_size);
+  int len = 0;
+  if (!ctx || EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, key.data(), iv) != 1 ||
+      EVP_DecryptUpdate(ctx.get(), nullptr, &len, file_bytes.data(),
+                        static_cast<int>(AAD_SIZE)) != 1 ||
+      EVP_DecryptUpdate(ctx.get(), payload.data(), &len, ciphertext,
+                        static_cast<int>(ciphertext_size)) != 1 ||
+      EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, TAG_SIZE,
+                          const_cast<uint8_t *>(tag)) != 1 ||
+      EVP_DecryptFinal_ex(ctx.get(), payload.data() + len, &len) != 1) {
+    log::warning() << "Index snapshot " << path << " failed to authenticate";
+    return std::nullopt;
+  }
+  return payload;
+}
+
+}  // namespace magic_core
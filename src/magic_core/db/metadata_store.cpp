@@ -1,40 +1,218 @@
 #include "magic_core/db/metadata_store.hpp"
 
 #include <faiss/IndexHNSW.h>
-#include <faiss/IndexIDMap.h>
 
-#include <iomanip>
-#include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <future>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
+#include "magic_core/db/database_backup.hpp"
+#include "magic_core/db/embedding_model_registry.hpp"
+#include "magic_core/db/epoch_millis.hpp"
+#include "magic_core/db/index_snapshot.hpp"
 #include "magic_core/db/pooled_connection.hpp"
 #include "magic_core/db/sqlite_error_utils.hpp"
-#include "magic_core/db/transaction.hpp"
+#include "magic_core/types/logger.hpp"
+#include "magic_core/types/metrics.hpp"
+#include "magic_core/types/trace.hpp"
+#include "magic_core/types/vector_math.hpp"
 
 namespace magic_core {
 
-std::string MetadataStore::time_point_to_string(const std::chrono::system_clock::time_point &tp) {
-  auto time_t = std::chrono::system_clock::to_time_t(tp);
-  std::stringstream ss;
-  ss << std::put_time(std::gmtime(&time_t), "%Y-%m-%d %H:%M:%S");
-  return ss.str();
+namespace {
+
+// Keeps a copy to max_bytes_per_second by sleeping off whatever it gets ahead; 0 never sleeps
+class CopyPacer {
+ public:
+  explicit CopyPacer(size_t max_bytes_per_second)
+      : rate_(max_bytes_per_second), start_(std::chrono::steady_clock::now()) {}
+
+  void add(size_t bytes) {
+    copied_ += bytes;
+    if (rate_ > 0) {
+      const std::chrono::duration<double> due(static_cast<double>(copied_) / rate_);
+      std::this_thread::sleep_until(
+          start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(due));
+    }
+  }
+  size_t copied() const {
+    return copied_;
+  }
+
+ private:
+  const size_t rate_;
+  const std::chrono::steady_clock::time_point start_;
+  size_t copied_ = 0;
+};
+
+// Throws unless vectors of model may be written where active is the active model; checked
+// under the index commit lock, which a re-embed holds exclusively while it swaps models
+void check_embedding_model(const std::string &active, const std::string &model, int file_id) {
+  if (!model.empty() && model != active) {
+    throw EmbeddingModelMismatchError("Vectors for file_id " + std::to_string(file_id) +
+                                      " come from " + model + ", but the active embedding " +
+                                      "model is " + active + ".");
+  }
+}
+
+// SQL conditions on the files table (aliased f) for every field of filter that is set, each
+// prefixed with " AND ". bind_filter binds their parameters in the same order. The statement
+// text depends only on which fields are set, so it stays cacheable.
+std::string filter_conditions(const SearchFilter &filter) {
+  std::string sql;
+  if (!filter.file_types.empty()) {
+    sql += " AND f.file_type IN (SELECT value FROM json_each(?))";
+  }
+  if (!filter.path_prefix.empty()) {
+    // A range on the unique path index rather than LIKE, which could not use it
+    sql += " AND f.path >= ? AND f.path < ?";
+  }
+  if (filter.modified_after) {
+    sql += " AND f.last_modified >= ?";
+  }
+  if (filter.modified_before) {
+    sql += " AND f.last_modified < ?";
+  }
+  return sql;
+}
+
+void bind_filter(sqlite::database_binder &statement, const SearchFilter &filter) {
+  if (!filter.file_types.empty()) {
+    nlohmann::json types = nlohmann::json::array();
+    for (FileType type : filter.file_types) {
+      types.push_back(to_string(type));
+    }
+    statement << types.dump();
+  }
+  if (!filter.path_prefix.empty()) {
+    // Every string starting with the prefix sorts below the prefix with its last byte bumped.
+    // Paths are UTF-8, which never contains a 0xFF byte, so the bump cannot overflow.
+    std::string upper = filter.path_prefix;
+    upper.back() = static_cast<char>(static_cast<unsigned char>(upper.back()) + 1);
+    statement << filter.path_prefix << upper;
+  }
+  if (filter.modified_after) {
+    statement << to_epoch_millis(*filter.modified_after);
+  }
+  if (filter.modified_before) {
+    statement << to_epoch_millis(*filter.modified_before);
+  }
 }
 
-std::chrono::system_clock::time_point MetadataStore::string_to_time_point(
-    const std::string &time_str) {
-  std::tm tm_struct = {};
-  std::stringstream ss(time_str);
-  ss >> std::get_time(&tm_struct, "%Y-%m-%d %H:%M:%S");
-  if (ss.fail()) {
-    throw std::runtime_error("Failed to parse time string: " + time_str +
-                             ". Expected format YYYY-MM-DD HH:MM:SS.");
+// The rows that currently have a vector: each file's chunks with one (sorted by id), and the
+// files with a summary
+struct LiveVectors {
+  std::unordered_map<int, std::vector<int64_t>> file_chunks;
+  std::vector<int> summarized_files;
+};
+
+LiveVectors read_live_vectors(DatabaseManager &db_manager) {
+  LiveVectors live;
+  PooledConnection conn(db_manager, ConnectionAccess::ReadOnly);
+  conn.prepare("SELECT file_id, id FROM chunks WHERE vector_offset IS NOT NULL "
+               "ORDER BY file_id, id") >>
+      [&](int file_id, int64_t id) { live.file_chunks[file_id].push_back(id); };
+  conn.prepare("SELECT id FROM files WHERE summary_vector_offset IS NOT NULL") >>
+      [&](int id) { live.summarized_files.push_back(id); };
+  return live;
+}
+
+ReplacementWork pending_work(const VectorReplacement &replacement, const LiveVectors &live) {
+  static const std::vector<int64_t> NO_CHUNKS;
+  ReplacementWork work;
+  for (const auto &[file_id, chunk_ids] : live.file_chunks) {
+    for (int64_t id : chunk_ids) {
+      if (!replacement.chunks.count(id)) {
+        work.chunk_ids.push_back(id);
+      }
+    }
   }
-  // We stored GMT time.
-  return std::chrono::system_clock::from_time_t(timegm(&tm_struct));
+  std::sort(work.chunk_ids.begin(), work.chunk_ids.end());
+  for (int file_id : live.summarized_files) {
+    auto chunks = live.file_chunks.find(file_id);
+    const auto &current = chunks != live.file_chunks.end() ? chunks->second : NO_CHUNKS;
+    auto summary = replacement.files.find(file_id);
+    if (summary == replacement.files.end() || summary->second.chunk_ids != current) {
+      work.file_ids.push_back(file_id);
+    }
+  }
+  return work;
+}
+
+// Threads decoding one batch of a streamed rebuild, and the fewest rows worth a thread
+constexpr size_t REBUILD_READ_THREADS = 4;
+constexpr size_t MIN_ROWS_PER_READ_THREAD = 2048;
+
+// Reads rows of records, (offset, id) pairs in file order, for VectorIndex::rebuild. A batch is
+// decrypted and decoded in slices on up to REBUILD_READ_THREADS threads. A row whose record is
+// missing throws when strict and is skipped with a warning otherwise; label names its rows.
+VectorIndex::RowReader record_reader(
+    const VectorStore &store,
+    const std::vector<std::pair<VectorStore::Offset, int64_t>> &records,
+    std::string label,
+    bool strict) {
+  return [&store, &records, label = std::move(label), strict](
+             const std::vector<size_t> &rows, std::vector<faiss::idx_t> &ids,
+             std::vector<float> &vectors) {
+    const size_t dimension = static_cast<size_t>(store.dimension());
+    std::vector<VectorStore::Offset> offsets;
+    std::vector<int64_t> keys;
+    offsets.reserve(rows.size());
+    keys.reserve(rows.size());
+    for (size_t row : rows) {
+      offsets.push_back(records[row].first);
+      keys.push_back(records[row].second);
+    }
+    vectors.resize(rows.size() * dimension);
+    const size_t slices = std::clamp<size_t>(rows.size() / MIN_ROWS_PER_READ_THREAD, 1,
+                                             REBUILD_READ_THREADS);
+    const size_t per_slice = (rows.size() + slices - 1) / slices;
+    std::vector<std::vector<bool>> found(slices);
+    auto read_slice = [&](size_t slice) {
+      const size_t begin = std::min(rows.size(), slice * per_slice);
+      const size_t end = std::min(rows.size(), begin + per_slice);
+      found[slice] = store.read_many({offsets.begin() + begin, offsets.begin() + end},
+                                     {keys.begin() + begin, keys.begin() + end},
+                                     vectors.data() + begin * dimension);
+    };
+    std::vector<std::thread> threads;
+    for (size_t slice = 1; slice < slices; ++slice) {
+      threads.emplace_back(read_slice, slice);
+    }
+    read_slice(0);
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+      if (!found[i / per_slice][i % per_slice]) {
+        if (strict) {
+          throw MetadataStoreError("Vector of " + label + " ID " + std::to_string(keys[i]) +
+                                   " is missing from " + store.path().string());
+        }
+        log::warning() << "Skipping " << label << " ID " << keys[i]
+                       << " during index rebuild: no vector at offset " << offsets[i] << " of "
+                       << store.path() << ".";
+        continue;
+      }
+      if (kept != i) {
+        std::copy_n(vectors.begin() + i * dimension, dimension,
+                    vectors.begin() + kept * dimension);
+      }
+      ids.push_back(keys[i]);
+      ++kept;
+    }
+    vectors.resize(kept * dimension);
+  };
 }
 
+}  // namespace
+
 std::chrono::system_clock::time_point MetadataStore::get_file_last_modified(
     const std::filesystem::path &file_path) {
   auto ftime = std::filesystem::last_write_time(file_path);
@@ -43,20 +221,74 @@ std::chrono::system_clock::time_point MetadataStore::get_file_last_modified(
   return sctp;
 }
 
-MetadataStore::MetadataStore(DatabaseManager &db_manager)
-    : db_manager_(db_manager), faiss_index_(nullptr) {
-  rebuild_faiss_index();
+MetadataStore::MetadataStore(DatabaseManager &db_manager,
+                             std::filesystem::path index_path,
+                             VectorIndexOptions index_options,
+                             size_t chunk_slab_cache_bytes,
+                             IndexLoading loading)
+    : db_manager_(db_manager),
+      index_options_(index_options),
+      space_(open_vector_space(db_manager, index_options)),
+      chunk_slabs_(chunk_slab_cache_bytes),
+      index_path_(std::move(index_path)) {
+  if (loading == IndexLoading::Eager) {
+    load_indexes();
+  }
+}
+MetadataStore::~MetadataStore() = default;
+
+void MetadataStore::load_indexes() {
+  const auto space = vector_space();
+  // The snapshots decrypt and deserialize independently, so the chunk one loads alongside
+  auto chunks = std::async(std::launch::async, [this, &space] {
+    return load_index_snapshot(*space->chunk_index, chunk_index_path(), "chunks");
+  });
+  const bool files_loaded = load_index_snapshot(*space->file_index, index_path_, "files");
+  const bool chunks_loaded = chunks.get();
+  // Indexes without a usable snapshot have to be built from the database once
+  if (!files_loaded) {
+    rebuild_faiss_index();
+  }
+  if (!chunks_loaded) {
+    rebuild_chunk_index();
+  }
+  if (!files_loaded || !chunks_loaded) {
+    persist_faiss_index();
+  }
+}
+
+size_t MetadataStore::prefault_vectors() const {
+  const auto space = vector_space();
+  return space->file_vectors->prefault() + space->chunk_vectors->prefault();
 }
-MetadataStore::~MetadataStore() {
-  if (faiss_index_) {
-    delete faiss_index_;
+
+std::shared_ptr<const MetadataStore::VectorSpace> MetadataStore::open_vector_space(
+    DatabaseManager &db_manager, const VectorIndexOptions &index_options) {
+  auto space = std::make_shared<VectorSpace>();
+  // Databases that have not registered a model yet hold default-sized vectors
+  if (auto model = EmbeddingModelRegistry(db_manager).active()) {
+    space->model = model->name;
+    space->dimension = model->dimension;
+  } else {
+    space->dimension = DEFAULT_VECTOR_DIMENSION;
   }
+  space->file_vectors = db_manager.vector_store("files", space->dimension);
+  space->chunk_vectors = db_manager.vector_store("chunks", space->dimension);
+  space->file_index = std::make_shared<VectorIndex>(space->dimension, index_options);
+  space->chunk_index = std::make_shared<VectorIndex>(space->dimension, index_options);
+  return space;
+}
+
+std::shared_ptr<const MetadataStore::VectorSpace> MetadataStore::vector_space() const {
+  std::lock_guard<std::mutex> lock(space_mutex_);
+  return space_;
 }
 
 // MetadataStore is non-movable to keep DB references stable
 
 void MetadataStore::initialize() {
   rebuild_faiss_index();
+  rebuild_chunk_index();
 }
 
 /*
@@ -66,45 +298,85 @@ This is used to create a file stub while the file is being processed.
 @returns the id of the file
 */
 int MetadataStore::upsert_file_stub(const BasicFileMetadata &basic_metadata) {
+  return upsert_file_stubs({basic_metadata}).front();
+}
+
+/*
+Upserts every stub in a single transaction, so bulk ingestion pays for one write lock per batch
+instead of one per file.
+
+@returns the file ids, in the same order as the stubs
+*/
+std::vector<int> MetadataStore::upsert_file_stubs(const std::vector<BasicFileMetadata> &stubs) {
+  std::vector<int> result_ids;
+  if (stubs.empty()) {
+    return result_ids;
+  }
   try {
-    std::string last_modified_str = time_point_to_string(basic_metadata.last_modified);
-    std::string created_at_str = time_point_to_string(basic_metadata.created_at);
+    result_ids.reserve(stubs.size());
+    std::vector<int> existing_ids;
+    std::vector<ContentHandover> handovers;
+    std::shared_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+    const auto space = vector_space();
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      for (const auto &basic_metadata : stubs) {
+        int64_t last_modified = to_epoch_millis(basic_metadata.last_modified);
+        int64_t created_at = to_epoch_millis(basic_metadata.created_at);
+
+        // Check if file exists BEFORE doing the upsert
+        int existing_id = -1;
+        std::string existing_hash;
+        conn.prepare("SELECT id, file_hash FROM files WHERE path = ?") << basic_metadata.path >>
+            [&](int id, std::string file_hash) {
+              existing_id = id;
+              existing_hash = std::move(file_hash);
+            };
+
+        if (existing_id != -1) {
+          // Paths sharing the old content keep it
+          if (existing_hash != basic_metadata.content_hash) {
+            if (auto handover = hand_over_content(conn, *space, existing_id, "[]")) {
+              handovers.push_back(std::move(*handover));
+            }
+          }
+          // File exists, update it and reset AI-generated fields since file content changed. A
+          // duplicate that gets a stub is processed on its own from now on.
+          auto &update = conn.prepare(
+              "UPDATE files SET original_path=?, file_hash=?, processing_status=?, "
+              "tags=?, last_modified=?, file_type=?, file_size=?, "
+              "summary_vector_offset=NULL, suggested_category=NULL, suggested_filename=NULL, "
+              "summary=NULL, content_source_id=NULL WHERE path=?");
+          update << basic_metadata.original_path << basic_metadata.content_hash
+                 << to_string(basic_metadata.processing_status) << basic_metadata.tags
+                 << last_modified << to_string(basic_metadata.file_type)
+                 << static_cast<int64_t>(basic_metadata.file_size) << basic_metadata.path;
+          update.execute();
+          result_ids.push_back(existing_id);
+          existing_ids.push_back(existing_id);
+        } else {
+          // File doesn't exist, insert new
+          auto &insert = conn.prepare(
+              "INSERT INTO files (path, original_path, file_hash, processing_status, tags, "
+              "last_modified, created_at, file_type, file_size) VALUES (?,?,?,?,?,?,?,?,?)");
+          insert << basic_metadata.path << basic_metadata.original_path
+                 << basic_metadata.content_hash << to_string(basic_metadata.processing_status)
+                 << basic_metadata.tags << last_modified << created_at
+                 << to_string(basic_metadata.file_type)
+                 << static_cast<int64_t>(basic_metadata.file_size);
+          insert.execute();
+          result_ids.push_back(static_cast<int>(conn.db.last_insert_rowid()));
+        }
+      }
+    });
 
-    int result_id = -1;
-    PooledConnection conn(db_manager_);
-    Transaction tx(*conn, /*immediate*/ true);
-
-    // Check if file exists BEFORE doing the upsert
-    int existing_id = -1;
-    *conn << "SELECT id FROM files WHERE path = ?" << basic_metadata.path >>
-        [&](int id) { existing_id = id; };
-
-    if (existing_id != -1) {
-      // File exists, update it and reset AI-generated fields since file content changed
-      *conn << "UPDATE files SET original_path=?, file_hash=?, processing_status=?, "
-               "tags=?, last_modified=?, file_type=?, file_size=?, "
-               "summary_vector_blob=NULL, suggested_category=NULL, suggested_filename=NULL WHERE "
-               "path=?"
-            << basic_metadata.original_path << basic_metadata.content_hash
-            << to_string(basic_metadata.processing_status) << basic_metadata.tags
-            << last_modified_str << to_string(basic_metadata.file_type)
-            << static_cast<int64_t>(basic_metadata.file_size) << basic_metadata.path;
-      result_id = existing_id;
-    } else {
-      // File doesn't exist, insert new
-      *conn << "INSERT INTO files (path, original_path, file_hash, processing_status, tags, "
-               "last_modified, created_at, file_type, file_size) VALUES (?,?,?,?,?,?,?,?,?)"
-            << basic_metadata.path << basic_metadata.original_path << basic_metadata.content_hash
-            << to_string(basic_metadata.processing_status) << basic_metadata.tags
-            << last_modified_str << created_at_str << to_string(basic_metadata.file_type)
-            << static_cast<int64_t>(basic_metadata.file_size);
-      result_id = static_cast<int>(conn->last_insert_rowid());
+    apply_handovers(*space, handovers);
+    // The summary vectors were reset above, so those files must stop matching searches
+    for (int existing_id : existing_ids) {
+      remove_from_faiss_index(existing_id);
     }
-
-    tx.commit();
-    return result_id;
+    return result_ids;
   } catch (const sqlite::sqlite_exception &e) {
-    throw MetadataStoreError(format_db_error("upsert_file_stub", e));
+    throw MetadataStoreError(format_db_error("upsert_file_stubs", e));
   }
 }
 
@@ -112,42 +384,62 @@ void MetadataStore::update_file_ai_analysis(int file_id,
                                             const std::vector<float> &summary_vector,
                                             const std::string &suggested_category,
                                             const std::string &suggested_filename,
-                                            ProcessingStatus processing_status) {
+                                            ProcessingStatus processing_status,
+                                            const std::string &embedding_model) {
   try {
-    PooledConnection conn(db_manager_);
-    Transaction tx(*conn, true);
-
+    std::shared_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+    const auto space = vector_space();
+    if (!summary_vector.empty()) {
+      check_embedding_model(space->model, embedding_model, file_id);
+    }
     // Validate vector dimensions if provided
-    if (!summary_vector.empty() && summary_vector.size() != VECTOR_DIMENSION) {
+    if (!summary_vector.empty() && summary_vector.size() != static_cast<size_t>(space->dimension)) {
       throw MetadataStoreError("Vector embedding size mismatch for file_id " +
                                std::to_string(file_id) + ". Expected " +
-                               std::to_string(VECTOR_DIMENSION) + " dimensions, got " +
+                               std::to_string(space->dimension) + " dimensions, got " +
                                std::to_string(summary_vector.size()) + ".");
     }
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      bool exists = false;
+      conn.prepare("SELECT 1 FROM files WHERE id = ? LIMIT 1") << file_id >>
+          [&](int /*dummy*/) { exists = true; };
+      if (!exists) {
+        throw MetadataStoreError("File with ID " + std::to_string(file_id) + " not found");
+      }
 
-    bool exists = false;
-    *conn << "SELECT 1 FROM files WHERE id = ? LIMIT 1" << file_id >> [&](int /*dummy*/) {
-      exists = true;
-    };
-    if (!exists) {
-      throw MetadataStoreError("File with ID " + std::to_string(file_id) + " not found");
-    }
-
-    // Convert vector to blob if not empty
-    if (!summary_vector.empty()) {
-      std::vector<char> vector_blob(summary_vector.size() * sizeof(float));
-      std::memcpy(vector_blob.data(), summary_vector.data(), vector_blob.size());
-
-      *conn << "UPDATE files SET summary_vector_blob = ?, suggested_category = ?, "
-               "suggested_filename = ?, processing_status = ? WHERE id = ?"
-            << vector_blob << suggested_category << suggested_filename
-            << to_string(processing_status) << file_id;
+      // The vector goes to the segment first; the row only points at it once this commits
+      if (!summary_vector.empty()) {
+        const VectorStore::Offset offset = space->file_vectors->append(file_id, summary_vector);
+        auto &update = conn.prepare(
+            "UPDATE files SET summary_vector_offset = ?, suggested_category = ?, "
+            "suggested_filename = ?, processing_status = ? WHERE id = ?");
+        update << offset << suggested_category << suggested_filename
+               << to_string(processing_status) << file_id;
+        update.execute();
+      } else {
+        auto &update = conn.prepare(
+            "UPDATE files SET summary_vector_offset = NULL, suggested_category = ?, "
+            "suggested_filename = ?, processing_status = ? WHERE id = ?");
+        update << suggested_category << suggested_filename << to_string(processing_status)
+               << file_id;
+        update.execute();
+      }
+      // Duplicates are as far along as the file whose content they share
+      auto &duplicates =
+          conn.prepare("UPDATE files SET processing_status = ? WHERE content_source_id = ?");
+      duplicates << to_string(processing_status) << file_id;
+      duplicates.execute();
+    });
+
+    if (bulk_loading()) {
+      // Picked up by end_bulk_load()'s rebuild
+      bulk_deferred_ = true;
+      bump_search_generation();
+    } else if (!summary_vector.empty()) {
+      update_faiss_index(file_id, summary_vector);
     } else {
-      *conn << "UPDATE files SET summary_vector_blob = NULL, suggested_category = ?, "
-               "suggested_filename = ?, processing_status = ? WHERE id = ?"
-            << suggested_category << suggested_filename << to_string(processing_status) << file_id;
+      remove_from_faiss_index(file_id);
     }
-    tx.commit();
   } catch (const sqlite::sqlite_exception &e) {
     throw MetadataStoreError(format_db_error("update_file_ai_analysis", e));
   }
@@ -155,34 +447,195 @@ void MetadataStore::update_file_ai_analysis(int file_id,
 
 void MetadataStore::update_file_processing_status(int file_id, ProcessingStatus processing_status) {
   try {
-    PooledConnection conn(db_manager_);
-    *conn << "UPDATE files SET processing_status = ? WHERE id = ?" << to_string(processing_status)
-          << file_id;
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      auto &update = conn.prepare(
+          "UPDATE files SET processing_status = ? WHERE id = ? OR content_source_id = ?");
+      update << to_string(processing_status) << file_id << file_id;
+      update.execute();
+    });
+    bump_search_generation();
   } catch (const sqlite::sqlite_exception &e) {
     throw MetadataStoreError(format_db_error("update_file_processing_status", e));
   }
 }
 
-void MetadataStore::upsert_chunk_metadata(int file_id, const std::vector<ProcessedChunk> &chunks) {
+bool MetadataStore::update_file_suggestions(int file_id,
+                                            const std::string &content_hash,
+                                            const std::string &summary,
+                                            const std::string &suggested_category,
+                                            const std::string &suggested_filename) {
+  try {
+    int changes = 0;
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      auto &update = conn.prepare(
+          "UPDATE files SET summary = ?, suggested_category = ?, suggested_filename = ? "
+          "WHERE id = ? AND file_hash = ?");
+      update << summary << suggested_category << suggested_filename << file_id << content_hash;
+      update.execute();
+      changes = conn.db.rows_modified();
+    });
+    if (changes == 0) {
+      return false;
+    }
+    // Hits carry the suggestions, so cached results go stale
+    bump_search_generation();
+    return true;
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("update_file_suggestions", e));
+  }
+}
+
+void MetadataStore::upsert_chunk_metadata(int file_id,
+                                          std::span<const ProcessedChunk> chunks,
+                                          const std::string &embedding_model) {
   if (chunks.empty())
     return;
 
   try {
-    PooledConnection conn(db_manager_);
-    Transaction tx(*conn, true);
-    for (const auto &chunk : chunks) {
-      std::vector<char> vector_blob(chunk.chunk.vector_embedding.size() * sizeof(float));
-      std::memcpy(vector_blob.data(), chunk.chunk.vector_embedding.data(), vector_blob.size());
-      *conn
-          << "REPLACE INTO chunks (file_id, chunk_index, content, vector_blob) VALUES (?, ?, ?, ?)"
-          << file_id << chunk.chunk.chunk_index << chunk.compressed_content << vector_blob;
+    std::vector<int64_t> chunk_ids;
+    chunk_ids.reserve(chunks.size());
+    std::shared_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+    const auto space = vector_space();
+    check_embedding_model(space->model, embedding_model, file_id);
+    const bool deferred = bulk_loading();
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      std::vector<int64_t> stored_ids;
+      std::vector<float> stored_vectors;
+      stored_ids.reserve(chunks.size());
+      stored_vectors.reserve(chunks.size() * space->dimension);
+      auto &replace_chunk = conn.prepare(
+          "REPLACE INTO chunks (file_id, chunk_index, content, content_hash) VALUES (?, ?, ?, ?)");
+      // The blob is compressed, so the full-text index gets the plain text next to it
+      auto &index_text = conn.prepare("INSERT INTO chunks_fts (rowid, content) VALUES (?, ?)");
+      for (const auto &chunk : chunks) {
+        replace_chunk << file_id << chunk.chunk.chunk_index << chunk.compressed_content;
+        // Bound in place rather than through a copied optional
+        if (chunk.content_hash.empty()) {
+          replace_chunk << nullptr;
+        } else {
+          replace_chunk << chunk.content_hash;
+        }
+        replace_chunk.execute();
+        chunk_ids.push_back(conn.db.last_insert_rowid());
+        if (!deferred) {
+          index_text << chunk_ids.back() << chunk.chunk.content;
+          index_text.execute();
+        }
+        const auto &vector = chunk.chunk.vector_embedding;
+        if (vector.size() == static_cast<size_t>(space->dimension)) {
+          stored_ids.push_back(chunk_ids.back());
+          stored_vectors.insert(stored_vectors.end(), vector.begin(), vector.end());
+        }
+      }
+      // One append for the whole batch, then point the fresh rows at their records
+      const auto offsets = space->chunk_vectors->append(stored_ids, stored_vectors.data());
+      auto &set_offset = conn.prepare("UPDATE chunks SET vector_offset = ? WHERE id = ?");
+      for (size_t i = 0; i < stored_ids.size(); ++i) {
+        set_offset << offsets[i] << stored_ids[i];
+        set_offset.execute();
+      }
+    });
+
+    static metrics::Counter &ingested =
+        metrics::counter("magic_chunks_ingested_total", "Chunks stored by upsert_chunk_metadata");
+    ingested.add(chunks.size());
+    chunk_slabs_.invalidate(file_id);
+    if (deferred) {
+      bulk_deferred_ = true;
+      bump_search_generation();
+      commit_lock.unlock();
+      // Keeps the WAL from growing with the whole import; only one writer claims the count
+      if ((bulk_unchecked_chunks_ += static_cast<int64_t>(chunks.size())) >=
+              BULK_CHECKPOINT_CHUNKS &&
+          bulk_unchecked_chunks_.exchange(0) >= BULK_CHECKPOINT_CHUNKS) {
+        checkpoint_wal();
+      }
+      return;
+    }
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      const auto &vector = chunks[i].chunk.vector_embedding;
+      if (vector.size() == static_cast<size_t>(space->dimension)) {
+        space->chunk_index->upsert(chunk_ids[i], vector);
+      } else if (!vector.empty()) {
+        log::warning() << "Not indexing chunk ID " << chunk_ids[i]
+                       << " due to mismatched vector dimension. Expected " << space->dimension
+                       << ", got " << vector.size() << ".";
+      }
     }
-    tx.commit();
+    bump_search_generation();
   } catch (const sqlite::sqlite_exception &e) {
     throw MetadataStoreError(format_db_error("upsert_chunk_metadata", e));
   }
 }
 
+std::vector<StoredChunk> MetadataStore::get_stored_chunks(int file_id) {
+  const auto space = vector_space();
+  std::vector<StoredChunk> chunks;
+  std::vector<int64_t> keys;
+  std::vector<VectorStore::Offset> offsets;
+  std::vector<size_t> with_vector;
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT id, chunk_index, COALESCE(content_hash, ''), vector_offset FROM chunks "
+                 "WHERE file_id = ? ORDER BY chunk_index")
+            << file_id >>
+        [&](int64_t id, int chunk_index, std::string content_hash,
+            std::optional<int64_t> vector_offset) {
+          if (vector_offset) {
+            with_vector.push_back(chunks.size());
+            keys.push_back(id);
+            offsets.push_back(*vector_offset);
+          }
+          chunks.push_back({id, chunk_index, std::move(content_hash), {}});
+        };
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("get_stored_chunks", e));
+  }
+
+  std::vector<float> vectors(keys.size() * space->dimension);
+  const std::vector<bool> found = space->chunk_vectors->read_many(offsets, keys, vectors.data());
+  for (size_t i = 0; i < with_vector.size(); ++i) {
+    if (found[i]) {
+      const auto begin = vectors.begin() + i * space->dimension;
+      chunks[with_vector[i]].vector_embedding.assign(begin, begin + space->dimension);
+    }
+  }
+  return chunks;
+}
+
+void MetadataStore::reconcile_chunks(int file_id,
+                                     const std::vector<std::pair<int64_t, int>> &kept,
+                                     const std::vector<int64_t> &removed_ids) {
+  if (kept.empty() && removed_ids.empty()) {
+    return;
+  }
+
+  try {
+    std::shared_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+    const auto space = vector_space();
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      auto &renumber =
+          conn.prepare("UPDATE chunks SET chunk_index = ? WHERE id = ? AND file_id = ? AND "
+                       "chunk_index IS NOT ?");
+      for (const auto &[id, chunk_index] : kept) {
+        renumber << chunk_index << id << file_id << chunk_index;
+        renumber.execute();
+      }
+      if (!removed_ids.empty()) {
+        auto &remove = conn.prepare(
+            "DELETE FROM chunks WHERE file_id = ? AND id IN (SELECT value FROM json_each(?))");
+        remove << file_id << nlohmann::json(removed_ids).dump();
+        remove.execute();
+      }
+    });
+    chunk_slabs_.invalidate(file_id);
+    space->chunk_index->remove_ids(removed_ids);
+    bump_search_generation();
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("reconcile_chunks", e));
+  }
+}
+
 std::vector<ChunkMetadata> MetadataStore::get_chunk_metadata(std::vector<int> file_ids) {
   std::vector<ChunkMetadata> chunks;
 
@@ -190,12 +643,11 @@ std::vector<ChunkMetadata> MetadataStore::get_chunk_metadata(std::vector<int> fi
     return chunks;
 
   try {
-    PooledConnection conn(db_manager_);
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
 
-    std::string file_ids_str = int_vector_to_comma_string(file_ids);
-
-    *conn << "SELECT id, file_id, chunk_index, content FROM chunks WHERE file_id IN (" +
-                 file_ids_str + ") ORDER BY file_id, chunk_index" >>
+    conn.prepare("SELECT id, file_id, chunk_index, content FROM chunks WHERE file_id IN "
+                 "(SELECT value FROM json_each(?)) ORDER BY file_id, chunk_index")
+            << int_vector_to_json_array(file_ids) >>
         [&](int id, int file_id, int chunk_index, std::vector<char> content) {
           ChunkMetadata chunk;
           chunk.id = id;
@@ -211,59 +663,191 @@ std::vector<ChunkMetadata> MetadataStore::get_chunk_metadata(std::vector<int> fi
   return chunks;
 }
 
-void MetadataStore::fill_chunk_metadata(std::vector<ChunkSearchResult> &chunks) {
+void MetadataStore::fill_chunk_metadata(std::vector<ChunkSearchResult> &chunks,
+                                        bool with_content) {
   if (chunks.empty()) {
     return;
   }
 
+  trace::Span span("sqlite.chunk_metadata");
+  span.set_attribute("chunks", static_cast<int64_t>(chunks.size()));
   try {
-    PooledConnection conn(db_manager_);
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
     std::vector<int> chunk_ids;
     chunk_ids.reserve(chunks.size());
     for (const auto &chunk : chunks) {
       chunk_ids.push_back(chunk.id);
     }
 
-    std::string chunk_ids_str = int_vector_to_comma_string(chunk_ids);
     std::unordered_map<int, std::tuple<int, int, std::vector<char>>> id_to_metadata;
 
-    *conn << "SELECT id, file_id, chunk_index, content FROM chunks WHERE id IN (" + chunk_ids_str +
-                 ")" >>
-        [&](int id, int file_id, int chunk_index, std::vector<char> content) {
-          id_to_metadata[id] = {file_id, chunk_index, std::move(content)};
-        };
+    if (with_content) {
+      conn.prepare("SELECT id, file_id, chunk_index, content FROM chunks WHERE id IN "
+                   "(SELECT value FROM json_each(?))")
+              << int_vector_to_json_array(chunk_ids) >>
+          [&](int id, int file_id, int chunk_index, std::vector<char> content) {
+            id_to_metadata[id] = {file_id, chunk_index, std::move(content)};
+          };
+    } else {
+      conn.prepare("SELECT id, file_id, chunk_index FROM chunks WHERE id IN "
+                   "(SELECT value FROM json_each(?))")
+              << int_vector_to_json_array(chunk_ids) >>
+          [&](int id, int file_id, int chunk_index) {
+            id_to_metadata[id] = {file_id, chunk_index, {}};
+          };
+    }
 
-    // Fill in the metadata for each chunk (preserving distances)
+    // Fill in the metadata for each chunk (preserving distances). Each id is hit once, so the
+    // blob moves out of the map instead of being copied.
+    size_t missing = 0;
     for (auto &chunk : chunks) {
       auto it = id_to_metadata.find(chunk.id);
       if (it != id_to_metadata.end()) {
         chunk.file_id = std::get<0>(it->second);
         chunk.chunk_index = std::get<1>(it->second);
-        chunk.compressed_content = std::get<2>(it->second);
+        chunk.compressed_content = std::move(std::get<2>(it->second));
       } else {
-        std::cout << "Chunk with ID " << chunk.id << " not found" << std::endl;
+        ++missing;
       }
     }
+    if (missing > 0) {
+      log::warning() << missing << " chunk IDs from the index were not found in the DB.";
+    }
   } catch (const sqlite::sqlite_exception &e) {
     throw MetadataStoreError(format_db_error("fill_chunk_metadata", e));
   }
 }
 
+std::optional<ChunkMetadata> MetadataStore::get_chunk(int chunk_id) {
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    std::optional<ChunkMetadata> chunk;
+    conn.prepare("SELECT file_id, chunk_index, content FROM chunks WHERE id = ?") << chunk_id >>
+        [&](int file_id, int chunk_index, std::vector<char> content) {
+          chunk = ChunkMetadata{chunk_id, {}, file_id, chunk_index, std::move(content)};
+        };
+    return chunk;
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("get_chunk", e));
+  }
+}
+
+std::vector<std::vector<char>> MetadataStore::sample_chunk_contents(int limit) {
+  std::vector<std::vector<char>> contents;
+  if (limit <= 0) {
+    return contents;
+  }
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    // The ids are shuffled from the index alone; only the picked rows' blobs are read
+    conn.prepare("SELECT content FROM chunks WHERE id IN "
+                 "(SELECT id FROM chunks ORDER BY random() LIMIT ?)")
+            << limit >>
+        [&](std::vector<char> content) { contents.push_back(std::move(content)); };
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("sample_chunk_contents", e));
+  }
+  return contents;
+}
+
+int64_t MetadataStore::count_chunks() {
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    int64_t count = 0;
+    *conn << "SELECT COUNT(*) FROM chunks" >> count;
+    return count;
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("count_chunks", e));
+  }
+}
+
+std::vector<std::pair<int64_t, std::vector<char>>> MetadataStore::chunks_missing_text(
+    int limit, int64_t after_id) {
+  std::vector<std::pair<int64_t, std::vector<char>>> chunks;
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT id, content FROM chunks WHERE id > ? AND NOT EXISTS "
+                 "(SELECT 1 FROM chunks_fts WHERE rowid = chunks.id) ORDER BY id LIMIT ?")
+            << after_id << limit >>
+        [&](int64_t id, std::vector<char> content) {
+          chunks.emplace_back(id, std::move(content));
+        };
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("chunks_missing_text", e));
+  }
+  return chunks;
+}
+
+void MetadataStore::index_chunk_text(const std::vector<std::pair<int64_t, std::string>> &texts) {
+  if (texts.empty()) {
+    return;
+  }
+  try {
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      auto &insert = conn.prepare(
+          "INSERT INTO chunks_fts (rowid, content) SELECT ?, ? "
+          "WHERE EXISTS (SELECT 1 FROM chunks WHERE id = ?) "
+          "AND NOT EXISTS (SELECT 1 FROM chunks_fts WHERE rowid = ?)");
+      for (const auto &[id, text] : texts) {
+        insert << id << text << id << id;
+        insert.execute();
+      }
+    });
+    bump_search_generation();
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("index_chunk_text", e));
+  }
+}
+
+void MetadataStore::save_compression_dictionary(const CompressionDictionary &dictionary) {
+  try {
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      auto &insert = conn.prepare(
+          "INSERT OR REPLACE INTO compression_dictionaries "
+          "(id, dictionary, sample_count, chunk_count, created_at) VALUES (?, ?, ?, ?, ?)");
+      insert << static_cast<int64_t>(dictionary.id) << dictionary.dictionary
+             << dictionary.sample_count << dictionary.chunk_count
+             << to_epoch_millis(dictionary.created_at);
+      insert.execute();
+    });
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("save_compression_dictionary", e));
+  }
+}
+
+std::vector<CompressionDictionary> MetadataStore::get_compression_dictionaries() {
+  std::vector<CompressionDictionary> dictionaries;
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    *conn << "SELECT id, dictionary, sample_count, chunk_count, created_at "
+             "FROM compression_dictionaries ORDER BY created_at, id" >>
+        [&](int64_t id, std::vector<char> dictionary, int64_t sample_count, int64_t chunk_count,
+            int64_t created_at) {
+          dictionaries.push_back({static_cast<uint32_t>(id), std::move(dictionary), sample_count,
+                                  chunk_count, from_epoch_millis(created_at)});
+        };
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("get_compression_dictionaries", e));
+  }
+  return dictionaries;
+}
+
 std::optional<FileMetadata> MetadataStore::get_file_metadata(const std::string &path) {
   try {
     std::optional<FileMetadata> result;
-    PooledConnection conn(db_manager_);
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
 
-    *conn << "SELECT id, path, original_path, file_hash, processing_status, tags, "
-             "last_modified, created_at, file_type, file_size, summary_vector_blob, "
-             "suggested_category, suggested_filename FROM files WHERE path = ?"
-          << path >>
+    conn.prepare("SELECT id, path, original_path, file_hash, processing_status, tags, "
+                 "last_modified, created_at, file_type, file_size, summary_vector_offset, "
+                 "suggested_category, suggested_filename, summary FROM files WHERE path = ?")
+            << path >>
         [&](int id, std::string path, std::optional<std::string> original_path,
             std::string file_hash, std::optional<std::string> processing_status,
-            std::optional<std::string> tags, std::string last_modified, std::string created_at,
-            std::string file_type, int64_t file_size, std::optional<std::vector<char>> vector_blob,
+            std::optional<std::string> tags, int64_t last_modified, int64_t created_at,
+            std::string file_type, int64_t file_size, std::optional<int64_t> vector_offset,
             std::optional<std::string> suggested_category,
-            std::optional<std::string> suggested_filename) {
+            std::optional<std::string> suggested_filename,
+            std::optional<std::string> summary) {
           FileMetadata metadata;
           metadata.id = id;
           metadata.path = path;
@@ -274,21 +858,19 @@ std::optional<FileMetadata> MetadataStore::get_file_metadata(const std::string &
             metadata.processing_status = processing_status_from_string(*processing_status);
           if (tags)
             metadata.tags = *tags;
-          metadata.last_modified = string_to_time_point(last_modified);
-          metadata.created_at = string_to_time_point(created_at);
+          metadata.last_modified = from_epoch_millis(last_modified);
+          metadata.created_at = from_epoch_millis(created_at);
           metadata.file_type = file_type_from_string(file_type);
           metadata.file_size = static_cast<size_t>(file_size);
 
-          // Handle vector blob
-          if (vector_blob && vector_blob->size() == VECTOR_DIMENSION * sizeof(float)) {
-            const float *data = reinterpret_cast<const float *>(vector_blob->data());
-            metadata.summary_vector_embedding.assign(data, data + VECTOR_DIMENSION);
-          }
+          load_summary_vector(metadata, vector_offset);
 
           if (suggested_category)
             metadata.suggested_category = *suggested_category;
           if (suggested_filename)
             metadata.suggested_filename = *suggested_filename;
+          if (summary)
+            metadata.summary = *summary;
 
           result = std::move(metadata);
         };
@@ -302,17 +884,18 @@ std::optional<FileMetadata> MetadataStore::get_file_metadata(const std::string &
 std::optional<FileMetadata> MetadataStore::get_file_metadata(int id) {
   try {
     std::optional<FileMetadata> result;
-    PooledConnection conn(db_manager_);
-    *conn << "SELECT id, path, original_path, file_hash, processing_status, tags, "
-             "last_modified, created_at, file_type, file_size, summary_vector_blob, "
-             "suggested_category, suggested_filename FROM files WHERE id = ?"
-          << id >>
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT id, path, original_path, file_hash, processing_status, tags, "
+                 "last_modified, created_at, file_type, file_size, summary_vector_offset, "
+                 "suggested_category, suggested_filename, summary FROM files WHERE id = ?")
+            << id >>
         [&](int id, std::string path, std::optional<std::string> original_path,
             std::string file_hash, std::optional<std::string> processing_status,
-            std::optional<std::string> tags, std::string last_modified, std::string created_at,
-            std::string file_type, int64_t file_size, std::optional<std::vector<char>> vector_blob,
+            std::optional<std::string> tags, int64_t last_modified, int64_t created_at,
+            std::string file_type, int64_t file_size, std::optional<int64_t> vector_offset,
             std::optional<std::string> suggested_category,
-            std::optional<std::string> suggested_filename) {
+            std::optional<std::string> suggested_filename,
+            std::optional<std::string> summary) {
           FileMetadata metadata;
           metadata.id = id;
           metadata.path = path;
@@ -323,21 +906,19 @@ std::optional<FileMetadata> MetadataStore::get_file_metadata(int id) {
             metadata.processing_status = processing_status_from_string(*processing_status);
           if (tags)
             metadata.tags = *tags;
-          metadata.last_modified = string_to_time_point(last_modified);
-          metadata.created_at = string_to_time_point(created_at);
+          metadata.last_modified = from_epoch_millis(last_modified);
+          metadata.created_at = from_epoch_millis(created_at);
           metadata.file_type = file_type_from_string(file_type);
           metadata.file_size = static_cast<size_t>(file_size);
 
-          // Handle vector blob
-          if (vector_blob && vector_blob->size() == VECTOR_DIMENSION * sizeof(float)) {
-            const float *data = reinterpret_cast<const float *>(vector_blob->data());
-            metadata.summary_vector_embedding.assign(data, data + VECTOR_DIMENSION);
-          }
+          load_summary_vector(metadata, vector_offset);
 
           if (suggested_category)
             metadata.suggested_category = *suggested_category;
           if (suggested_filename)
             metadata.suggested_filename = *suggested_filename;
+          if (summary)
+            metadata.summary = *summary;
 
           result = std::move(metadata);
         };
@@ -348,16 +929,105 @@ std::optional<FileMetadata> MetadataStore::get_file_metadata(int id) {
   }
 }
 
+std::optional<BasicFileMetadata> MetadataStore::get_basic_file_metadata(const std::string &path) {
+  return query_basic_file_metadata("path", path);
+}
+
+std::optional<BasicFileMetadata> MetadataStore::get_basic_file_metadata(int id) {
+  return query_basic_file_metadata("id", id);
+}
+
+template <typename Key>
+std::optional<BasicFileMetadata> MetadataStore::query_basic_file_metadata(
+    const std::string &column, const Key &key) {
+  try {
+    std::optional<BasicFileMetadata> result;
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT id, path, original_path, file_hash, processing_status, tags, "
+                 "last_modified, created_at, file_type, file_size, "
+                 "COALESCE(content_source_id, 0) FROM files WHERE " +
+                 column + " = ?")
+            << key >>
+        [&](int id, std::string path, std::optional<std::string> original_path,
+            std::string file_hash, std::optional<std::string> processing_status,
+            std::optional<std::string> tags, int64_t last_modified, int64_t created_at,
+            std::string file_type, int64_t file_size, int content_source_id) {
+          BasicFileMetadata metadata;
+          metadata.id = id;
+          metadata.path = std::move(path);
+          if (original_path)
+            metadata.original_path = *original_path;
+          metadata.content_hash = std::move(file_hash);
+          if (processing_status)
+            metadata.processing_status = processing_status_from_string(*processing_status);
+          if (tags)
+            metadata.tags = *tags;
+          metadata.last_modified = from_epoch_millis(last_modified);
+          metadata.created_at = from_epoch_millis(created_at);
+          metadata.file_type = file_type_from_string(file_type);
+          metadata.file_size = static_cast<size_t>(file_size);
+          metadata.content_source_id = content_source_id;
+          result = std::move(metadata);
+        };
+    return result;
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("get_basic_file_metadata_by_" + column, e));
+  }
+}
+
+std::vector<float> MetadataStore::get_file_summary_vector(int file_id) {
+  try {
+    std::optional<int64_t> offset;
+    {
+      PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+      conn.prepare("SELECT summary_vector_offset FROM files WHERE id = ?") << file_id >>
+          [&](std::optional<int64_t> vector_offset) { offset = vector_offset; };
+    }
+    FileMetadata metadata;
+    metadata.id = file_id;
+    load_summary_vector(metadata, offset);
+    return std::move(metadata.summary_vector_embedding);
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("get_file_summary_vector", e));
+  }
+}
+
+// Paths of every stored file below directory, found through a range scan on the path index
+std::pair<std::string, std::string> MetadataStore::path_range_under(const std::string &directory) {
+  std::string prefix = directory;
+  if (prefix.empty() || prefix.back() != '/') {
+    prefix += '/';
+  }
+  // '0' is the character right after '/', so [prefix, upper) is exactly the paths below it
+  std::string upper = prefix;
+  upper.back() = '0';
+  return {prefix, upper};
+}
+
+std::vector<std::string> MetadataStore::get_file_paths_under(const std::string &directory) {
+  const auto [prefix, upper] = path_range_under(directory);
+
+  std::vector<std::string> paths;
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    *conn << "SELECT path FROM files WHERE path >= ? AND path < ?" << prefix << upper >>
+        [&](std::string path) { paths.push_back(std::move(path)); };
+    return paths;
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("get_file_paths_under", e));
+  }
+}
+
 bool MetadataStore::file_exists(const std::string &path) {
   return get_file_metadata(path).has_value();
 }
 
 std::optional<ProcessingStatus> MetadataStore::file_processing_status(std::string content_hash) {
   try {
-    PooledConnection conn(db_manager_);
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
     std::optional<ProcessingStatus> result;
     // Column is stored as file_hash in the schema
-    *conn << "SELECT processing_status FROM files WHERE file_hash = ?" << content_hash >>
+    conn.prepare("SELECT processing_status FROM files WHERE file_hash = ?") << content_hash >>
         [&](std::string processing_status) {
           result = processing_status_from_string(processing_status);
         };
@@ -367,31 +1037,48 @@ std::optional<ProcessingStatus> MetadataStore::file_processing_status(std::strin
   }
 }
 
-// TODO: This will probably not be super usable. eventually it should have pagination
+// Looks up many hashes in one query; hashes that are not stored are absent from the result
+std::unordered_map<std::string, ProcessingStatus> MetadataStore::file_processing_statuses(
+    const std::vector<std::string> &content_hashes) {
+  std::unordered_map<std::string, ProcessingStatus> statuses;
+  if (content_hashes.empty()) {
+    return statuses;
+  }
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT file_hash, processing_status FROM files WHERE file_hash IN "
+                 "(SELECT value FROM json_each(?))")
+            << nlohmann::json(content_hashes).dump() >>
+        [&](std::string file_hash, std::string processing_status) {
+      statuses[file_hash] = processing_status_from_string(processing_status);
+    };
+    return statuses;
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("file_processing_statuses", e));
+  }
+}
+
+// Loads every summary vector; listings should page through list_files_page instead
 std::vector<FileMetadata> MetadataStore::list_all_files() {
   std::vector<FileMetadata> files;
 
   try {
-    PooledConnection conn(db_manager_);
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
     *conn << "SELECT id, path, file_hash, last_modified, created_at, file_type, file_size, "
-             "summary_vector_blob FROM files" >>
-        [&](int id, std::string path, std::string file_hash, std::string last_modified,
-            std::string created_at, std::string file_type, int64_t file_size,
-            std::optional<std::vector<char>> vector_blob) {
+             "summary_vector_offset FROM files" >>
+        [&](int id, std::string path, std::string file_hash, int64_t last_modified,
+            int64_t created_at, std::string file_type, int64_t file_size,
+            std::optional<int64_t> vector_offset) {
           FileMetadata metadata;
           metadata.id = id;
           metadata.path = path;
           metadata.content_hash = file_hash;
-          metadata.last_modified = string_to_time_point(last_modified);
-          metadata.created_at = string_to_time_point(created_at);
+          metadata.last_modified = from_epoch_millis(last_modified);
+          metadata.created_at = from_epoch_millis(created_at);
           metadata.file_type = file_type_from_string(file_type);
           metadata.file_size = static_cast<size_t>(file_size);
 
-          // Handle vector blob
-          if (vector_blob && vector_blob->size() == VECTOR_DIMENSION * sizeof(float)) {
-            const float *data = reinterpret_cast<const float *>(vector_blob->data());
-            metadata.summary_vector_embedding.assign(data, data + VECTOR_DIMENSION);
-          }
+          load_summary_vector(metadata, vector_offset);
 
           files.push_back(std::move(metadata));
         };
@@ -402,253 +1089,1521 @@ std::vector<FileMetadata> MetadataStore::list_all_files() {
   return files;
 }
 
+std::vector<BasicFileMetadata> MetadataStore::list_files_page(int64_t after_id, int limit) {
+  std::vector<BasicFileMetadata> files;
+  if (limit <= 0) {
+    return files;
+  }
+  files.reserve(static_cast<size_t>(limit));
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    // A range scan on the primary key; the vector columns are never read
+    conn.prepare("SELECT id, path, original_path, file_hash, processing_status, tags, "
+                 "last_modified, created_at, file_type, file_size FROM files WHERE id > ? "
+                 "ORDER BY id LIMIT ?")
+            << after_id << limit >>
+        [&](int id, std::string path, std::optional<std::string> original_path,
+            std::string file_hash, std::optional<std::string> processing_status,
+            std::optional<std::string> tags, int64_t last_modified, int64_t created_at,
+            std::string file_type, int64_t file_size) {
+          BasicFileMetadata metadata;
+          metadata.id = id;
+          metadata.path = std::move(path);
+          if (original_path)
+            metadata.original_path = *original_path;
+          metadata.content_hash = std::move(file_hash);
+          if (processing_status)
+            metadata.processing_status = processing_status_from_string(*processing_status);
+          if (tags)
+            metadata.tags = *tags;
+          metadata.last_modified = from_epoch_millis(last_modified);
+          metadata.created_at = from_epoch_millis(created_at);
+          metadata.file_type = file_type_from_string(file_type);
+          metadata.file_size = static_cast<size_t>(file_size);
+          files.push_back(std::move(metadata));
+        };
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("list_files_page", e));
+  }
+  return files;
+}
+
 void MetadataStore::delete_file_metadata(const std::string &path) {
   try {
-    PooledConnection conn(db_manager_);
-    *conn << "DELETE FROM files WHERE path = ?" << path;
+    int file_id = -1;
+    std::vector<int64_t> chunk_ids;
+    std::optional<ContentHandover> handover;
+    std::shared_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+    const auto space = vector_space();
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      conn.prepare("SELECT id FROM files WHERE path = ?") << path >>
+          [&](int id) { file_id = id; };
+      if (file_id != -1) {
+        handover = hand_over_content(conn, *space, file_id, "[]");
+        conn.prepare("SELECT id FROM chunks WHERE file_id = ?") << file_id >>
+            [&](int64_t id) { chunk_ids.push_back(id); };
+      }
+      // chunks go with the file through ON DELETE CASCADE
+      auto &remove = conn.prepare("DELETE FROM files WHERE path = ?");
+      remove << path;
+      remove.execute();
+    });
+    // Keep the indexes in step with the generation bumps the delete triggers just made
+    if (handover) {
+      apply_handovers(*space, {*handover});
+    }
+    if (file_id != -1) {
+      space->file_index->remove(file_id);
+      chunk_slabs_.invalidate(file_id);
+    }
+    space->chunk_index->remove_ids(chunk_ids);
+    bump_search_generation();
   } catch (const sqlite::sqlite_exception &e) {
     throw MetadataStoreError(format_db_error("delete_file_metadata", e));
   }
 }
 
-void MetadataStore::rebuild_faiss_index() {
-  // Clean up existing index
-  if (faiss_index_) {
-    delete faiss_index_;
-    faiss_index_ = nullptr;
+size_t MetadataStore::delete_files_under(const std::string &directory) {
+  const auto [prefix, upper] = path_range_under(directory);
+  try {
+    std::vector<faiss::idx_t> file_ids;
+    std::vector<faiss::idx_t> chunk_ids;
+    std::vector<ContentHandover> handovers;
+    std::shared_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+    const auto space = vector_space();
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      conn.prepare("SELECT id FROM files WHERE path >= ? AND path < ?") << prefix << upper >>
+          [&](int64_t id) { file_ids.push_back(id); };
+      if (file_ids.empty()) {
+        return;
+      }
+      const std::string ids_json = nlohmann::json(file_ids).dump();
+      // Only duplicates outside the directory can inherit
+      for (faiss::idx_t id : file_ids) {
+        if (auto handover = hand_over_content(conn, *space, static_cast<int>(id), ids_json)) {
+          handovers.push_back(std::move(*handover));
+        }
+      }
+      conn.prepare("SELECT id FROM chunks WHERE file_id IN (SELECT value FROM json_each(?))")
+              << ids_json >>
+          [&](int64_t id) { chunk_ids.push_back(id); };
+      // chunks go with their files through ON DELETE CASCADE
+      auto &remove = conn.prepare("DELETE FROM files WHERE id IN (SELECT value FROM json_each(?))");
+      remove << ids_json;
+      remove.execute();
+    });
+    if (file_ids.empty()) {
+      return 0;
+    }
+    apply_handovers(*space, handovers);
+    space->file_index->remove_ids(file_ids);
+    space->chunk_index->remove_ids(chunk_ids);
+    chunk_slabs_.invalidate(std::vector<int>(file_ids.begin(), file_ids.end()));
+    bump_search_generation();
+    return file_ids.size();
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("delete_files_under", e));
   }
+}
 
-  // Create new index
-  faiss_index_ = create_base_index();
-  if (!faiss_index_) {
-    throw MetadataStoreError("Failed to create base Faiss index");
+std::vector<bool> MetadataStore::add_duplicate_files(const std::vector<BasicFileMetadata> &stubs) {
+  std::vector<bool> added(stubs.size(), false);
+  if (stubs.empty()) {
+    return added;
   }
-
   try {
-    std::vector<faiss::idx_t> faiss_ids;
-    std::vector<float> all_vectors_flat;
-    int current_num_vectors = 0;
-
-    {
-      // Scope the connection strictly to the DB fetch
-      PooledConnection conn(db_manager_);
-      // Fetch all IDs and vectors from the database
-      *conn << "SELECT id, summary_vector_blob FROM files WHERE summary_vector_blob IS NOT NULL" >>
-          [&](int64_t id, std::vector<char> vector_blob) {
-            // Validate vector size to match expected dimension
-            if (vector_blob.size() == VECTOR_DIMENSION * sizeof(float)) {
-              faiss_ids.push_back(id);
-              const float *vec_ptr = reinterpret_cast<const float *>(vector_blob.data());
-              // Append vector data to a flat vector
-              all_vectors_flat.insert(all_vectors_flat.end(), vec_ptr, vec_ptr + VECTOR_DIMENSION);
-              current_num_vectors++;
-            } else if (vector_blob.size() > 0) {
-              // Log a warning for mismatched dimensions, but continue processing others
-              std::cerr << "Warning: Skipping file ID " << id
-                        << " during index rebuild due to mismatched vector dimension. Expected "
-                        << VECTOR_DIMENSION * sizeof(float) << " bytes, got " << vector_blob.size()
-                        << " bytes." << std::endl;
-            }
-          };
-    }
+    std::vector<ContentHandover> handovers;
+    // Rows that had content of their own before becoming duplicates
+    std::vector<faiss::idx_t> replaced_ids;
+    std::vector<faiss::idx_t> replaced_chunk_ids;
+    std::shared_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+    const auto space = vector_space();
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      for (size_t i = 0; i < stubs.size(); ++i) {
+        const BasicFileMetadata &stub = stubs[i];
+        int source_id = -1;
+        std::string source_status;
+        conn.prepare("SELECT id, processing_status FROM files WHERE file_hash = ? AND path != ? "
+                     "AND content_source_id IS NULL AND processing_status != 'FAILED' "
+                     "ORDER BY id LIMIT 1")
+                << stub.content_hash << stub.path >>
+            [&](int id, std::string status) {
+              source_id = id;
+              source_status = std::move(status);
+            };
+        if (source_id == -1) {
+          continue;
+        }
+        int existing_id = -1;
+        std::string existing_hash;
+        conn.prepare("SELECT id, file_hash FROM files WHERE path = ?") << stub.path >>
+            [&](int id, std::string file_hash) {
+              existing_id = id;
+              existing_hash = std::move(file_hash);
+            };
+        if (existing_id != -1 && existing_hash == stub.content_hash) {
+          continue;
+        }
+
+        const int64_t last_modified = to_epoch_millis(stub.last_modified);
+        if (existing_id != -1) {
+          if (auto handover = hand_over_content(conn, *space, existing_id, "[]")) {
+            handovers.push_back(std::move(*handover));
+          }
+          conn.prepare("SELECT id FROM chunks WHERE file_id = ?") << existing_id >>
+              [&](int64_t id) { replaced_chunk_ids.push_back(id); };
+          auto &remove_chunks = conn.prepare("DELETE FROM chunks WHERE file_id = ?");
+          remove_chunks << existing_id;
+          remove_chunks.execute();
+          auto &update = conn.prepare(
+              "UPDATE files SET original_path=?, file_hash=?, processing_status=?, tags=?, "
+              "last_modified=?, file_type=?, file_size=?, summary_vector_offset=NULL, "
+              "suggested_category=NULL, suggested_filename=NULL, summary=NULL, "
+              "content_source_id=? WHERE id=?");
+          update << stub.original_path << stub.content_hash << source_status << stub.tags
+                 << last_modified << to_string(stub.file_type)
+                 << static_cast<int64_t>(stub.file_size) << source_id << existing_id;
+          update.execute();
+          replaced_ids.push_back(existing_id);
+        } else {
+          auto &insert = conn.prepare(
+              "INSERT INTO files (path, original_path, file_hash, processing_status, tags, "
+              "last_modified, created_at, file_type, file_size, content_source_id) "
+              "VALUES (?,?,?,?,?,?,?,?,?,?)");
+          insert << stub.path << stub.original_path << stub.content_hash << source_status
+                 << stub.tags << last_modified << to_epoch_millis(stub.created_at)
+                 << to_string(stub.file_type) << static_cast<int64_t>(stub.file_size)
+                 << source_id;
+          insert.execute();
+        }
+        added[i] = true;
+      }
+    });
 
-    if (current_num_vectors > 0) {
-      // Add all vectors to the Faiss index in one go
-      faiss_index_->add_with_ids(current_num_vectors, all_vectors_flat.data(), faiss_ids.data());
+    apply_handovers(*space, handovers);
+    if (!replaced_ids.empty()) {
+      space->file_index->remove_ids(replaced_ids);
+      space->chunk_index->remove_ids(replaced_chunk_ids);
+      chunk_slabs_.invalidate(std::vector<int>(replaced_ids.begin(), replaced_ids.end()));
     }
+    bump_search_generation();
+    return added;
   } catch (const sqlite::sqlite_exception &e) {
-    throw MetadataStoreError(format_db_error("rebuild_faiss_index", e));
+    throw MetadataStoreError(format_db_error("add_duplicate_files", e));
   }
 }
 
-std::vector<FileSearchResult> MetadataStore::search_similar_files(
-    const std::vector<float> &query_vector, int k) {
-  if (!faiss_index_) {
-    return {};
+std::optional<MetadataStore::ContentHandover> MetadataStore::hand_over_content(
+    PooledDatabase &conn, const VectorSpace &space, int file_id, const std::string &excluded_ids) {
+  int heir = -1;
+  conn.prepare("SELECT id FROM files WHERE content_source_id = ? "
+               "AND id NOT IN (SELECT value FROM json_each(?)) ORDER BY id LIMIT 1")
+          << file_id << excluded_ids >>
+      [&](int id) { heir = id; };
+  if (heir == -1) {
+    return std::nullopt;
   }
 
-  int actual_k = std::min(k, (int)faiss_index_->ntotal);
-  if (actual_k <= 0) {
-    return {};
+  ContentHandover handover{file_id, heir, {}};
+  std::optional<int64_t> offset;
+  std::string category;
+  std::string filename;
+  std::optional<std::string> summary;
+  std::string status;
+  conn.prepare("SELECT summary_vector_offset, COALESCE(suggested_category, ''), "
+               "COALESCE(suggested_filename, ''), summary, processing_status FROM files "
+               "WHERE id = ?")
+          << file_id >>
+      [&](std::optional<int64_t> vector_offset, std::string suggested_category,
+          std::string suggested_filename, std::optional<std::string> file_summary,
+          std::string processing_status) {
+        offset = vector_offset;
+        category = std::move(suggested_category);
+        filename = std::move(suggested_filename);
+        summary = std::move(file_summary);
+        status = std::move(processing_status);
+      };
+  // Segment records are keyed by row id, so the heir gets its own copy of the summary
+  std::optional<VectorStore::Offset> heir_offset;
+  if (offset) {
+    handover.summary.resize(space.dimension);
+    if (space.file_vectors->read(*offset, file_id, handover.summary.data())) {
+      heir_offset = space.file_vectors->append(heir, handover.summary);
+    } else {
+      handover.summary.clear();
+    }
   }
 
-  std::vector<float> distances(actual_k);
-  std::vector<faiss::idx_t> labels(actual_k);
-  search_faiss_index(faiss_index_, query_vector, actual_k, distances, labels);
+  auto &adopt = conn.prepare(
+      "UPDATE files SET content_source_id = NULL, summary_vector_offset = ?, "
+      "suggested_category = ?, suggested_filename = ?, summary = ?, processing_status = ? "
+      "WHERE id = ?");
+  if (heir_offset) {
+    adopt << *heir_offset;
+  } else {
+    adopt << nullptr;
+  }
+  adopt << category << filename;
+  if (summary) {
+    adopt << *summary;
+  } else {
+    adopt << nullptr;
+  }
+  adopt << status << heir;
+  adopt.execute();
+  auto &repoint =
+      conn.prepare("UPDATE files SET content_source_id = ? WHERE content_source_id = ?");
+  repoint << heir << file_id;
+  repoint.execute();
+  auto &move_chunks = conn.prepare("UPDATE chunks SET file_id = ? WHERE file_id = ?");
+  move_chunks << heir << file_id;
+  move_chunks.execute();
+  return handover;
+}
 
-  // Build a list of valid ids in label order
-  std::vector<int> label_ids;
-  label_ids.reserve(actual_k);
-  for (int i = 0; i < actual_k; ++i) {
-    if (labels[i] != -1) {
-      label_ids.push_back(static_cast<int>(labels[i]));
+void MetadataStore::apply_handovers(const VectorSpace &space,
+                                    const std::vector<ContentHandover> &handovers) {
+  for (const ContentHandover &handover : handovers) {
+    chunk_slabs_.invalidate(handover.from);
+    chunk_slabs_.invalidate(handover.heir);
+    if (bulk_loading()) {
+      bulk_deferred_ = true;
+    } else if (!handover.summary.empty()) {
+      space.file_index->upsert(handover.heir, handover.summary);
     }
   }
-  if (label_ids.empty()) {
-    return {};
+  if (!handovers.empty()) {
+    bump_search_generation();
   }
+}
 
-  // Fetch all required file metadata in one query using a single connection
-  std::unordered_map<int, FileMetadata> id_to_metadata;
-  {
+std::unordered_map<int, std::vector<std::string>> MetadataStore::fetch_duplicate_paths(
+    const std::vector<int> &file_ids) {
+  std::unordered_map<int, std::vector<std::string>> paths;
+  if (file_ids.empty()) {
+    return paths;
+  }
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT content_source_id, path FROM files WHERE content_source_id IN "
+                 "(SELECT value FROM json_each(?)) ORDER BY path")
+            << int_vector_to_json_array(file_ids) >>
+        [&](int source_id, std::string path) { paths[source_id].push_back(std::move(path)); };
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("fetch_duplicate_paths", e));
+  }
+  return paths;
+}
+
+void MetadataStore::update_faiss_index(int file_id, const std::vector<float> &summary_vector) {
+  const auto space = vector_space();
+  try {
+    space->file_index->upsert(file_id, summary_vector);
+    bump_search_generation();
+  } catch (const VectorIndexError &e) {
+    // A failed in-place update leaves the index in an unknown state, start over from the DB
+    log::warning() << "Incremental index update failed for file ID " << file_id << ": "
+                   << e.what() << ". Rebuilding the Faiss index.";
+    rebuild_faiss_index();
+  }
+}
+
+void MetadataStore::remove_from_faiss_index(int file_id) {
+  const auto space = vector_space();
+  space->file_index->remove(file_id);
+  bump_search_generation();
+}
+
+void MetadataStore::rebuild_faiss_index() {
+  const auto space = vector_space();
+  try {
+    rebuild_from_store(*space->file_index, *space->file_vectors, "files", "summary_vector_offset");
+    bump_search_generation();
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("rebuild_faiss_index", e));
+  } catch (const VectorIndexError &e) {
+    throw MetadataStoreError(std::string("Failed to rebuild Faiss index: ") + e.what());
+  }
+}
+
+void MetadataStore::rebuild_chunk_index() {
+  const auto space = vector_space();
+  try {
+    // A rebuild is the recovery path, so nothing read before it is trusted
+    chunk_slabs_.clear();
+    rebuild_from_store(*space->chunk_index, *space->chunk_vectors, "chunks", "vector_offset");
+    bump_search_generation();
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("rebuild_chunk_index", e));
+  } catch (const VectorIndexError &e) {
+    throw MetadataStoreError(std::string("Failed to rebuild chunk index: ") + e.what());
+  }
+}
+
+bool MetadataStore::begin_bulk_load() {
+  std::unique_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+  if (bulk_loading()) {
+    return false;
+  }
+  bulk_deferred_ = false;
+  bulk_unchecked_chunks_ = 0;
+  writer_options_before_bulk_ = db_manager_.writer().options();
+  DatabaseWriterOptions bulk = writer_options_before_bulk_;
+  bulk.commit_delay = std::max<std::chrono::microseconds>(bulk.commit_delay, BULK_COMMIT_DELAY);
+  bulk.max_batch = std::max(bulk.max_batch, BULK_MAX_BATCH);
+  db_manager_.writer().set_options(bulk);
+  bulk_loading_.store(true, std::memory_order_release);
+  log::info() << "Bulk load started; index updates are deferred until it ends";
+  return true;
+}
+
+MetadataStore::BulkLoadPin MetadataStore::pin_bulk_load() {
+  // Under the lock end_bulk_load() checks the pins with, so it either ended the load before or
+  // sees this pin
+  std::unique_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+  bulk_load_pins_.fetch_add(1, std::memory_order_acq_rel);
+  return BulkLoadPin(&bulk_load_pins_);
+}
+
+bool MetadataStore::end_bulk_load() {
+  // Writers are held off until the rebuilt indexes cover everything committed so far
+  std::unique_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+  if (!bulk_loading() || bulk_load_pins_.load(std::memory_order_acquire) > 0) {
+    return false;
+  }
+  bulk_loading_.store(false, std::memory_order_release);
+  db_manager_.writer().set_options(writer_options_before_bulk_);
+  if (bulk_deferred_.exchange(false)) {
+    rebuild_faiss_index();
+    rebuild_chunk_index();
+  }
+  log::info() << "Bulk load finished; file index " << vector_space()->file_index->stats().size
+              << " vectors, chunk index " << vector_space()->chunk_index->stats().size;
+  return true;
+}
+
+void MetadataStore::checkpoint_wal() {
+  // Run on the read-write pool: a checkpoint cannot run inside the writer's transactions.
+  // PASSIVE copies what it can without waiting on the writer.
+  try {
     PooledConnection conn(db_manager_);
-    std::string ids_str = int_vector_to_comma_string(label_ids);
-    *conn << "SELECT id, path, original_path, file_hash, processing_status, tags, "
-                 "last_modified, created_at, file_type, file_size, summary_vector_blob, "
-                 "suggested_category, suggested_filename FROM files WHERE id IN (" + ids_str + ")" >>
-        [&](int id, std::string path, std::optional<std::string> original_path,
-            std::string file_hash, std::optional<std::string> processing_status,
-            std::optional<std::string> tags, std::string last_modified, std::string created_at,
-            std::string file_type, int64_t file_size, std::optional<std::vector<char>> vector_blob,
-            std::optional<std::string> suggested_category,
-            std::optional<std::string> suggested_filename) {
-          FileMetadata metadata;
-          metadata.id = id;
-          metadata.path = path;
-          if (original_path)
-            metadata.original_path = *original_path;
-          metadata.content_hash = file_hash;
-          if (processing_status)
-            metadata.processing_status = processing_status_from_string(*processing_status);
-          if (tags)
-            metadata.tags = *tags;
-          metadata.last_modified = string_to_time_point(last_modified);
-          metadata.created_at = string_to_time_point(created_at);
-          metadata.file_type = file_type_from_string(file_type);
-          metadata.file_size = static_cast<size_t>(file_size);
-          if (vector_blob && vector_blob->size() == VECTOR_DIMENSION * sizeof(float)) {
-            const float *data = reinterpret_cast<const float *>(vector_blob->data());
-            metadata.summary_vector_embedding.assign(data, data + VECTOR_DIMENSION);
+    *conn << "PRAGMA wal_checkpoint(PASSIVE);" >> [](int, int, int) {};
+  } catch (const sqlite::sqlite_exception &e) {
+    log::warning() << format_db_error("checkpoint_wal", e);
+  }
+}
+
+void MetadataStore::read_all_vectors(const std::string &table,
+                                     std::vector<faiss::idx_t> &ids,
+                                     std::vector<float> &vectors) {
+  const auto space = vector_space();
+  ids.clear();
+  vectors.clear();
+  try {
+    if (table == "files") {
+      read_stored_vectors(*space->file_vectors, "files", "summary_vector_offset", ids, vectors);
+    } else if (table == "chunks") {
+      read_stored_vectors(*space->chunk_vectors, "chunks", "vector_offset", ids, vectors);
+    } else {
+      throw MetadataStoreError("No stored vectors in table '" + table +
+                               "' (expected files or chunks)");
+    }
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("read_all_vectors", e));
+  }
+}
+
+std::vector<std::pair<VectorStore::Offset, int64_t>> MetadataStore::stored_vector_records(
+    const std::string &table, const std::string &offset_column) {
+  std::vector<std::pair<VectorStore::Offset, int64_t>> records;
+  PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+  // In file order, so the reads walk the mapping front to back
+  *conn << "SELECT id, " + offset_column + " FROM " + table + " WHERE " + offset_column +
+               " IS NOT NULL ORDER BY " + offset_column >>
+      [&](int64_t id, int64_t offset) { records.emplace_back(offset, id); };
+  return records;
+}
+
+void MetadataStore::rebuild_from_store(VectorIndex &index,
+                                       const VectorStore &store,
+                                       const std::string &table,
+                                       const std::string &offset_column) {
+  // Only the (offset, id) list is held whole, 16 bytes a row; the vectors are streamed
+  std::vector<std::pair<VectorStore::Offset, int64_t>> records;
+  index.rebuild(
+      [&] {
+        records = stored_vector_records(table, offset_column);
+        return records.size();
+      },
+      record_reader(store, records, table, /*strict*/ false));
+}
+
+void MetadataStore::read_stored_vectors(const VectorStore &store,
+                                        const std::string &table,
+                                        const std::string &offset_column,
+                                        std::vector<faiss::idx_t> &ids,
+                                        std::vector<float> &vectors_flat) {
+  std::vector<int64_t> keys;
+  std::vector<VectorStore::Offset> offsets;
+  for (const auto &[offset, id] : stored_vector_records(table, offset_column)) {
+    keys.push_back(id);
+    offsets.push_back(offset);
+  }
+  // Decrypted straight into the buffer the index is built from
+  const size_t dimension = static_cast<size_t>(store.dimension());
+  vectors_flat.resize(keys.size() * dimension);
+  const std::vector<bool> found = store.read_many(offsets, keys, vectors_flat.data());
+  size_t kept = 0;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (!found[i]) {
+      log::warning() << "Skipping " << table << " ID " << keys[i]
+                     << " during index rebuild: no vector at offset " << offsets[i] << " of "
+                     << store.path() << ".";
+      continue;
+    }
+    if (kept != i) {
+      std::copy_n(vectors_flat.begin() + i * dimension, dimension,
+                  vectors_flat.begin() + kept * dimension);
+    }
+    ids.push_back(keys[i]);
+    ++kept;
+  }
+  vectors_flat.resize(kept * dimension);
+}
+
+void MetadataStore::load_summary_vector(FileMetadata &metadata,
+                                        const std::optional<int64_t> &offset) const {
+  const auto space = vector_space();
+  if (!offset) {
+    return;
+  }
+  metadata.summary_vector_embedding.resize(space->dimension);
+  if (!space->file_vectors->read(*offset, metadata.id, metadata.summary_vector_embedding.data())) {
+    metadata.summary_vector_embedding.clear();
+  }
+}
+
+std::filesystem::path MetadataStore::chunk_index_path() const {
+  if (index_path_.empty()) {
+    return {};
+  }
+  // metadata.faiss -> metadata.chunks.faiss
+  std::filesystem::path path = index_path_;
+  path.replace_extension(".chunks" + index_path_.extension().string());
+  return path;
+}
+
+bool MetadataStore::load_faiss_index() {
+  const auto space = vector_space();
+  const bool files_loaded = load_index_snapshot(*space->file_index, index_path_, "files");
+  const bool chunks_loaded = load_index_snapshot(*space->chunk_index, chunk_index_path(), "chunks");
+  return files_loaded && chunks_loaded;
+}
+
+bool MetadataStore::load_index_snapshot(VectorIndex &index,
+                                        const std::filesystem::path &path,
+                                        const std::string &generation_name) {
+  if (path.empty()) {
+    return false;
+  }
+  try {
+    auto payload =
+        IndexSnapshot::read(path, db_manager_.get_db_key(), get_index_generation(generation_name));
+    if (!payload) {
+      return false;
+    }
+    index.load(*payload);
+    bump_search_generation();
+    return true;
+  } catch (const std::exception &e) {
+    log::warning() << "Could not load index snapshot " << path << ": " << e.what()
+                   << ". Rebuilding it from the database.";
+    return false;
+  }
+}
+
+void MetadataStore::persist_faiss_index() {
+  if (index_path_.empty()) {
+    return;
+  }
+  if (bulk_loading()) {
+    log::info() << "Not snapshotting the indexes during a bulk load";
+    return;
+  }
+  try {
+    long long files_generation = 0;
+    long long chunks_generation = 0;
+    std::vector<uint8_t> files_payload;
+    std::vector<uint8_t> chunks_payload;
+    {
+      std::unique_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+      const auto space = vector_space();
+      files_generation = get_index_generation("files");
+      chunks_generation = get_index_generation("chunks");
+      files_payload = space->file_index->serialize();
+      chunks_payload = space->chunk_index->serialize();
+    }
+    IndexSnapshot::write(index_path_, db_manager_.get_db_key(), files_generation, files_payload);
+    IndexSnapshot::write(chunk_index_path(), db_manager_.get_db_key(), chunks_generation,
+                         chunks_payload);
+  } catch (const std::exception &e) {
+    log::warning() << "Could not persist index snapshots to " << index_path_ << ": " << e.what();
+  }
+}
+
+SnapshotInfo MetadataStore::write_snapshot(
+    const std::filesystem::path &dir,
+    const SnapshotOptions &options,
+    const std::function<void(size_t copied, size_t total)> &on_progress,
+    const std::function<void(sqlite::database &)> &finalize) {
+  if (options.pages_per_step <= 0) {
+    throw std::invalid_argument("A snapshot copies at least one page per step");
+  }
+  trace::Span span("store.snapshot");
+  std::filesystem::create_directories(dir);
+  SnapshotInfo info;
+  std::unique_ptr<DatabaseBackup> backup;
+  std::shared_ptr<const VectorSpace> space;
+  std::vector<uint8_t> files_payload;
+  std::vector<uint8_t> chunks_payload;
+  size_t file_records = 0;
+  size_t chunk_records = 0;
+  try {
+    std::unique_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+    if (bulk_loading()) {
+      throw MetadataStoreError("Cannot snapshot during a bulk load: the indexes lag the database");
+    }
+    // Every committed row's vector is appended before its commit, so the segments hold at least
+    // the records the pinned database refers to
+    backup = std::make_unique<DatabaseBackup>(db_manager_,
+                                              dir / db_manager_.get_db_path().filename());
+    backup->source() << "SELECT name, generation FROM index_generations" >>
+        [&](const std::string &name, long long generation) {
+          if (name == "files") {
+            info.files_generation = generation;
+          } else if (name == "chunks") {
+            info.chunks_generation = generation;
           }
-          if (suggested_category)
-            metadata.suggested_category = *suggested_category;
-          if (suggested_filename)
-            metadata.suggested_filename = *suggested_filename;
-          id_to_metadata[id] = std::move(metadata);
         };
+    space = vector_space();
+    if (!index_path_.empty()) {
+      files_payload = space->file_index->serialize();
+      chunks_payload = space->chunk_index->serialize();
+    }
+    file_records = space->file_vectors->record_count();
+    chunk_records = space->chunk_vectors->record_count();
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("write_snapshot", e));
+  }
+
+  // The first step learns the size of the database
+  bool copied = backup->step(options.pages_per_step);
+  const size_t page_size = static_cast<size_t>(backup->page_size());
+  const size_t total = static_cast<size_t>(backup->page_count()) * page_size +
+                       space->file_vectors->copy_size(file_records) +
+                       space->chunk_vectors->copy_size(chunk_records) + files_payload.size() +
+                       chunks_payload.size();
+  CopyPacer pacer(options.max_bytes_per_second);
+  auto report = [&](size_t bytes) {
+    pacer.add(bytes);
+    if (on_progress) {
+      on_progress(std::min(pacer.copied(), total), total);
+    }
+  };
+  int remaining = backup->remaining();
+  report(static_cast<size_t>(backup->page_count() - remaining) * page_size);
+  while (!copied) {
+    copied = backup->step(options.pages_per_step);
+    const int left = backup->remaining();
+    report(static_cast<size_t>(remaining - left) * page_size);
+    remaining = left;
+  }
+
+  const std::filesystem::path &db_path = db_manager_.get_db_path();
+  space->file_vectors->copy_to(
+      dir / DatabaseManager::vector_store_path(db_path, "files").filename(), file_records, report);
+  space->chunk_vectors->copy_to(
+      dir / DatabaseManager::vector_store_path(db_path, "chunks").filename(), chunk_records,
+      report);
+  if (!index_path_.empty()) {
+    const std::string &key = db_manager_.get_db_key();
+    IndexSnapshot::write(dir / index_path_.filename(), key, info.files_generation, files_payload);
+    report(files_payload.size());
+    IndexSnapshot::write(dir / chunk_index_path().filename(), key, info.chunks_generation,
+                         chunks_payload);
+    report(chunks_payload.size());
+  }
+  try {
+    backup->finish(finalize);
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("write_snapshot", e));
+  }
+  info.bytes = total;
+  if (on_progress) {
+    on_progress(total, total);
+  }
+  log::info() << "Snapshot of " << db_path << " written to " << dir << " (" << total
+              << " bytes)";
+  return info;
+}
+
+long long MetadataStore::get_index_generation(const std::string &name) {
+  try {
+    long long generation = 0;
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT generation FROM index_generations WHERE name = ?") << name >>
+        [&](long long value) { generation = value; };
+    return generation;
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("get_index_generation", e));
+  }
+}
+
+std::unique_ptr<VectorReplacement> MetadataStore::begin_replacement(const std::string &model) {
+  auto registered = EmbeddingModelRegistry(db_manager_).find(model);
+  if (!registered) {
+    throw MetadataStoreError("Embedding model '" + model + "' is not registered");
+  }
+  const int dimension = registered->dimension;
+  auto replacement = std::make_unique<VectorReplacement>();
+  replacement->model = model;
+  replacement->dimension = dimension;
+  replacement->file_vectors = db_manager_.create_replacement_vector_store("files", dimension);
+  replacement->chunk_vectors = db_manager_.create_replacement_vector_store("chunks", dimension);
+  return replacement;
+}
+
+ReplacementWork MetadataStore::pending_replacement(const VectorReplacement &replacement) {
+  try {
+    return pending_work(replacement, read_live_vectors(db_manager_));
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("pending_replacement", e));
+  }
+}
+
+std::vector<std::pair<int64_t, std::vector<char>>> MetadataStore::get_chunk_contents(
+    const std::vector<int64_t> &chunk_ids) {
+  std::vector<std::pair<int64_t, std::vector<char>>> chunks;
+  if (chunk_ids.empty()) {
+    return chunks;
+  }
+  try {
+    nlohmann::json ids_json(chunk_ids);
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT id, content FROM chunks WHERE id IN (SELECT value FROM json_each(?))")
+            << ids_json.dump() >>
+        [&](int64_t id, std::vector<char> content) {
+          chunks.emplace_back(id, std::move(content));
+        };
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("get_chunk_contents", e));
+  }
+  return chunks;
+}
+
+void MetadataStore::add_replacement_chunks(VectorReplacement &replacement,
+                                           const std::vector<int64_t> &chunk_ids,
+                                           const std::vector<std::vector<float>> &vectors) {
+  if (chunk_ids.size() != vectors.size()) {
+    throw MetadataStoreError("add_replacement_chunks: " + std::to_string(chunk_ids.size()) +
+                             " chunk ids for " + std::to_string(vectors.size()) + " vectors");
+  }
+  const size_t dimension = static_cast<size_t>(replacement.dimension);
+  std::vector<float> flat;
+  flat.reserve(vectors.size() * dimension);
+  for (const auto &vector : vectors) {
+    if (vector.size() != dimension) {
+      throw MetadataStoreError("Received a " + std::to_string(vector.size()) +
+                               "-dimensional embedding for a " + std::to_string(dimension) +
+                               "-dimensional replacement");
+    }
+    flat.insert(flat.end(), vector.begin(), vector.end());
+  }
+  const auto offsets = replacement.chunk_vectors->append(chunk_ids, flat.data());
+  for (size_t i = 0; i < chunk_ids.size(); ++i) {
+    replacement.chunks[chunk_ids[i]] = offsets[i];
+    if (replacement.chunk_index) {
+      replacement.chunk_index->upsert(chunk_ids[i], vectors[i]);
+    }
+  }
+}
+
+void MetadataStore::add_replacement_summaries(VectorReplacement &replacement,
+                                              const std::vector<int> &file_ids) {
+  if (file_ids.empty()) {
+    return;
+  }
+  std::unordered_map<int, std::vector<int64_t>> file_chunks;
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT file_id, id FROM chunks WHERE vector_offset IS NOT NULL AND file_id IN "
+                 "(SELECT value FROM json_each(?)) ORDER BY file_id, id")
+            << int_vector_to_json_array(file_ids) >>
+        [&](int file_id, int64_t id) { file_chunks[file_id].push_back(id); };
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("add_replacement_summaries", e));
+  }
+
+  const size_t dimension = static_cast<size_t>(replacement.dimension);
+  std::vector<int64_t> summarized;
+  std::vector<float> summaries;
+  std::vector<float> chunk_vectors;
+  for (int file_id : file_ids) {
+    std::vector<int64_t> &chunk_ids = file_chunks[file_id];
+    std::vector<VectorStore::Offset> offsets;
+    offsets.reserve(chunk_ids.size());
+    for (int64_t id : chunk_ids) {
+      auto it = replacement.chunks.find(id);
+      if (it == replacement.chunks.end()) {
+        break;
+      }
+      offsets.push_back(it->second);
+    }
+    if (offsets.size() != chunk_ids.size()) {
+      continue;
+    }
+    if (chunk_ids.empty()) {
+      // Nothing to sum the new model's summary from
+      replacement.files[file_id] = {std::nullopt, {}};
+      if (replacement.file_index) {
+        replacement.file_index->remove(file_id);
+      }
+      continue;
+    }
+    chunk_vectors.resize(chunk_ids.size() * dimension);
+    const std::vector<bool> found =
+        replacement.chunk_vectors->read_many(offsets, chunk_ids, chunk_vectors.data());
+    if (std::find(found.begin(), found.end(), false) != found.end()) {
+      throw MetadataStoreError("Replacement chunk vectors of file ID " + std::to_string(file_id) +
+                               " are missing from " + replacement.chunk_vectors->path().string());
+    }
+    std::vector<const float *> rows;
+    rows.reserve(chunk_ids.size());
+    for (size_t i = 0; i < chunk_ids.size(); ++i) {
+      rows.push_back(chunk_vectors.data() + i * dimension);
+    }
+    // The normalized sum is the normalized mean, as for a processed file
+    std::vector<float> summary(dimension);
+    vector_math::sum(rows.data(), rows.size(), dimension, summary.data());
+    vector_math::normalize(summary);
+    summaries.insert(summaries.end(), summary.begin(), summary.end());
+    summarized.push_back(file_id);
+    replacement.files[file_id].chunk_ids = std::move(chunk_ids);
+  }
+  if (summarized.empty()) {
+    return;
+  }
+
+  const auto offsets = replacement.file_vectors->append(summarized, summaries.data());
+  for (size_t i = 0; i < summarized.size(); ++i) {
+    const int file_id = static_cast<int>(summarized[i]);
+    replacement.files[file_id].offset = offsets[i];
+    if (replacement.file_index) {
+      replacement.file_index->upsert(
+          file_id, std::vector<float>(summaries.begin() + i * dimension,
+                                      summaries.begin() + (i + 1) * dimension));
+    }
+  }
+}
+
+void MetadataStore::install_replacement(VectorReplacement &replacement,
+                                        const std::function<void(const ReplacementWork &)> &finish,
+                                        const std::function<void()> &on_installed) {
+  trace::Span span("store.install_replacement");
+  // The bulk of the index build happens while writers still run; what they change meanwhile
+  // goes into the built indexes through finish
+  try {
+    std::vector<std::pair<VectorStore::Offset, int64_t>> records;
+    replacement.chunk_index = std::make_shared<VectorIndex>(replacement.dimension, index_options_);
+    replacement.chunk_index->rebuild(
+        [&] {
+          records.reserve(replacement.chunks.size());
+          for (const auto &[id, offset] : replacement.chunks) {
+            records.emplace_back(offset, id);
+          }
+          std::sort(records.begin(), records.end());
+          return records.size();
+        },
+        record_reader(*replacement.chunk_vectors, records, "replacement chunk", /*strict*/ true));
+    replacement.file_index = std::make_shared<VectorIndex>(replacement.dimension, index_options_);
+    replacement.file_index->rebuild(
+        [&] {
+          records.clear();
+          for (const auto &[id, summary] : replacement.files) {
+            if (summary.offset) {
+              records.emplace_back(*summary.offset, id);
+            }
+          }
+          std::sort(records.begin(), records.end());
+          return records.size();
+        },
+        record_reader(*replacement.file_vectors, records, "replacement file", /*strict*/ true));
+  } catch (const VectorIndexError &e) {
+    throw MetadataStoreError(std::string("Failed to build replacement indexes: ") + e.what());
+  }
+
+  std::unique_lock<std::shared_mutex> commit_lock(index_commit_mutex_);
+  try {
+    if (ReplacementWork late = pending_replacement(replacement); !late.empty()) {
+      finish(late);
+    }
+    const LiveVectors live = read_live_vectors(db_manager_);
+    const ReplacementWork left = pending_work(replacement, live);
+    if (!left.empty()) {
+      throw MetadataStoreError("Replacement vectors of '" + replacement.model + "' still lack " +
+                               std::to_string(left.chunk_ids.size()) + " chunks and " +
+                               std::to_string(left.file_ids.size()) + " file summaries");
+    }
+
+    // Vectors of rows deleted or rewritten since they were embedded go nowhere
+    std::unordered_set<int64_t> live_chunks;
+    for (const auto &[file_id, chunk_ids] : live.file_chunks) {
+      live_chunks.insert(chunk_ids.begin(), chunk_ids.end());
+    }
+    std::vector<faiss::idx_t> stale;
+    for (auto it = replacement.chunks.begin(); it != replacement.chunks.end();) {
+      if (live_chunks.count(it->first)) {
+        ++it;
+      } else {
+        stale.push_back(it->first);
+        it = replacement.chunks.erase(it);
+      }
+    }
+    replacement.chunk_index->remove_ids(stale);
+    const std::unordered_set<int> live_files(live.summarized_files.begin(),
+                                             live.summarized_files.end());
+    stale.clear();
+    for (auto it = replacement.files.begin(); it != replacement.files.end();) {
+      if (live_files.count(it->first)) {
+        ++it;
+      } else {
+        stale.push_back(it->first);
+        it = replacement.files.erase(it);
+      }
+    }
+    replacement.file_index->remove_ids(stale);
+
+    db_manager_.writer().run([&](PooledDatabase &conn) {
+      auto &chunk_update = conn.prepare("UPDATE chunks SET vector_offset = ? WHERE id = ?");
+      for (const auto &[id, offset] : replacement.chunks) {
+        chunk_update << offset << id;
+        chunk_update.execute();
+      }
+      auto &file_update = conn.prepare("UPDATE files SET summary_vector_offset = ? WHERE id = ?");
+      auto &file_clear =
+          conn.prepare("UPDATE files SET summary_vector_offset = NULL WHERE id = ?");
+      for (const auto &[id, summary] : replacement.files) {
+        if (summary.offset) {
+          file_update << *summary.offset << id;
+          file_update.execute();
+        } else {
+          file_clear << id;
+          file_clear.execute();
+        }
+      }
+      // From here on a restart installs the replacement segments in place of the live ones
+      auto &epoch_update = conn.prepare("UPDATE vector_segments SET epoch = ? WHERE name = ?");
+      epoch_update << replacement.file_vectors->epoch() << "files";
+      epoch_update.execute();
+      epoch_update << replacement.chunk_vectors->epoch() << "chunks";
+      epoch_update.execute();
+      // Snapshots of the old indexes must never be loaded over the new vectors
+      auto &generation_update =
+          conn.prepare("UPDATE index_generations SET generation = generation + 1");
+      generation_update.execute();
+      EmbeddingModelRegistry::activate_in(conn, replacement.model);
+    });
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("install_replacement", e));
   }
 
-  // Assemble results in the same order as the labels/distances
+  auto space = std::make_shared<VectorSpace>();
+  space->model = replacement.model;
+  space->dimension = replacement.dimension;
+  space->file_vectors =
+      db_manager_.install_replacement_vector_store("files", std::move(replacement.file_vectors));
+  space->chunk_vectors =
+      db_manager_.install_replacement_vector_store("chunks", std::move(replacement.chunk_vectors));
+  space->file_index = std::move(replacement.file_index);
+  space->chunk_index = std::move(replacement.chunk_index);
+  const size_t chunks = replacement.chunks.size();
+  const size_t files = replacement.files.size();
+  replacement.chunks.clear();
+  replacement.files.clear();
+  if (on_installed) {
+    on_installed();
+  }
+  {
+    std::lock_guard<std::mutex> lock(space_mutex_);
+    space_ = std::move(space);
+  }
+  // Slabs hold the old model's vectors
+  chunk_slabs_.clear();
+  bump_search_generation();
+  commit_lock.unlock();
+
+  log::info() << "Switched to embedding model '" << replacement.model << "' (" << chunks
+              << " chunk and " << files << " file vectors).";
+  persist_faiss_index();
+}
+
+std::vector<FileSearchResult> MetadataStore::search_similar_files(
+    const std::vector<float> &query_vector,
+    int k,
+    const VectorSearchOptions &tuning,
+    const SearchFilter &filter) {
+  const auto space = vector_space();
+  if (space->file_index->size() == 0 || k <= 0) {
+    return {};
+  }
+  std::optional<VectorIndex::IdFilter> allowed;
+  if (!filter.empty()) {
+    allowed = resolve_search_filter(filter);
+    if (allowed->empty()) {
+      return {};
+    }
+  }
+
+  std::vector<VectorIndexHit> hits;
+  try {
+    trace::Span span("ann.files");
+    span.set_attribute("k", k);
+    hits = space->file_index->search(query_vector, k, allowed ? &*allowed : nullptr, tuning);
+  } catch (const VectorIndexError &e) {
+    throw MetadataStoreError(e.what());
+  }
+
+  // Build a list of valid ids in hit order
+  std::vector<int> label_ids;
+  label_ids.reserve(hits.size());
+  for (const auto &hit : hits) {
+    label_ids.push_back(static_cast<int>(hit.id));
+  }
+  if (label_ids.empty()) {
+    return {};
+  }
+
+  std::unordered_map<int, FileMetadata> id_to_metadata = fetch_file_metadata(label_ids);
+  auto duplicates = fetch_duplicate_paths(label_ids);
+
+  // Assemble results in the same order as the hits
   std::vector<FileSearchResult> results;
   results.reserve(label_ids.size());
-  for (int i = 0; i < actual_k; ++i) {
-    int id = static_cast<int>(labels[i]);
-    if (id == -1)
-      continue;
+  size_t missing = 0;
+  for (const auto &hit : hits) {
+    int id = static_cast<int>(hit.id);
     auto it = id_to_metadata.find(id);
     if (it != id_to_metadata.end()) {
-      results.push_back({id, distances[i], std::move(it->second)});
+      results.push_back({id, hit.distance, std::move(it->second), std::move(duplicates[id])});
     } else {
-      std::cerr << "Warning: Faiss returned ID " << id
-                << " but no corresponding metadata found in DB." << std::endl;
+      ++missing;
     }
   }
+  // One line per search rather than one per stale hit
+  if (missing > 0) {
+    log::warning() << "Faiss returned " << missing << " file IDs with no metadata in the DB.";
+  }
 
   return results;
 }
 
 std::vector<ChunkSearchResult> MetadataStore::search_similar_chunks(
-    const std::vector<int> &file_ids, const std::vector<float> &query_vector, int k) {
+    const std::vector<int> &file_ids,
+    const std::vector<float> &query_vector,
+    int k,
+    const VectorSearchOptions &tuning,
+    bool with_content) {
+  const auto space = vector_space();
   // Early return if no file IDs provided
-  if (file_ids.empty()) {
+  if (file_ids.empty() || k <= 0) {
     return {};
   }
 
   try {
-    // Load vectors from DB into memory first to avoid holding a connection while enriching results
-    std::vector<faiss::idx_t> faiss_ids;
-    std::vector<float> all_vectors_flat;
-    int current_num_vectors = 0;
+    // Only the chunk ids are read here; the vectors are already in the shared chunk index
+    VectorIndex::IdFilter candidate_chunks;
     {
-      PooledConnection conn(db_manager_);
-      std::string file_ids_str = int_vector_to_comma_string(file_ids);
-      *conn << "SELECT id, vector_blob FROM chunks WHERE file_id IN (" + file_ids_str +
-                   ") ORDER BY file_id, chunk_index" >>
-          [&](int64_t id, std::vector<char> vector_blob) {
-            if (vector_blob.size() == VECTOR_DIMENSION * sizeof(float)) {
-              faiss_ids.push_back(id);
-              const float *vec_ptr = reinterpret_cast<const float *>(vector_blob.data());
-              all_vectors_flat.insert(all_vectors_flat.end(), vec_ptr, vec_ptr + VECTOR_DIMENSION);
-              current_num_vectors++;
-            } else if (vector_blob.size() > 0) {
-              std::cerr << "Warning: Skipping chunk ID " << id
-                        << " during index rebuild due to mismatched vector dimension. Expected "
-                        << VECTOR_DIMENSION * sizeof(float) << " bytes, got " << vector_blob.size()
-                        << " bytes." << std::endl;
-            }
-          };
-    }
-
-    // Create temporary chunk index and perform FAISS search without holding DB connection
-    auto chunk_index = std::unique_ptr<faiss::IndexIDMap>(create_base_index());
-    if (current_num_vectors > 0) {
-      chunk_index->add_with_ids(current_num_vectors, all_vectors_flat.data(), faiss_ids.data());
+      trace::Span span("sqlite.chunk_candidates");
+      PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+      conn.prepare("SELECT id FROM chunks WHERE file_id IN (SELECT value FROM json_each(?))")
+              << int_vector_to_json_array(file_ids) >>
+          [&](int64_t id) { candidate_chunks.insert(id); };
     }
-
-    // Search the faiss index for the query vector
-    int actual_k = std::min(k, (int)chunk_index->ntotal);
-    if (actual_k <= 0) {
+    if (candidate_chunks.empty()) {
       return {};
     }
 
-    std::vector<float> distances(actual_k);
-    std::vector<faiss::idx_t> labels(actual_k);
-    search_faiss_index(chunk_index.get(), query_vector, actual_k, distances, labels);
+    std::vector<VectorIndexHit> hits;
+    try {
+      trace::Span span("ann.chunks");
+      span.set_attribute("candidates", static_cast<int64_t>(candidate_chunks.size()));
+      hits = space->chunk_index->search(query_vector, k, &candidate_chunks, tuning);
+    } catch (const VectorIndexError &e) {
+      throw MetadataStoreError(e.what());
+    }
 
-    // The labels are chunk ids, so we need to get the actual chunks from the database
+    // The hits are chunk ids, so we need to get the actual chunks from the database
     std::vector<ChunkSearchResult> chunks;
-    chunks.reserve(labels.size());
-    for (int i = 0; i < labels.size(); i++) {
-      const auto &faiss_id = labels[i];
+    chunks.reserve(hits.size());
+    for (const auto &hit : hits) {
       ChunkSearchResult chunk;
-      chunk.id = static_cast<int>(faiss_id);
-      chunk.distance = distances[i];
+      chunk.id = static_cast<int>(hit.id);
+      chunk.distance = hit.distance;
       chunks.push_back(chunk);
     }
 
     // Fill in the metadata (file_id, content)
-    fill_chunk_metadata(chunks);
+    fill_chunk_metadata(chunks, with_content);
     return chunks;
   } catch (const sqlite::sqlite_exception &e) {
     throw MetadataStoreError("Failed to search similar chunks: " + std::string(e.what()));
   }
 }
 
-/* Wrapper for faiss search with error handling and dimension checking */
-void MetadataStore::search_faiss_index(faiss::IndexIDMap *index,
-                                       const std::vector<float> &query_vector,
-                                       int k,
-                                       std::vector<float> &distances,
-                                       std::vector<faiss::idx_t> &labels) {
-  if (!index || index->ntotal == 0) {
-    // If the index is empty or not built, we can't search.
-    throw MetadataStoreError("Faiss index not initialized or empty. Cannot perform search.");
+std::vector<std::vector<FileSearchResult>> MetadataStore::search_similar_files_batch(
+    const std::vector<std::vector<float>> &query_vectors,
+    int k,
+    const VectorSearchOptions &tuning,
+    const SearchFilter &filter) {
+  const auto space = vector_space();
+  std::vector<std::vector<FileSearchResult>> results(query_vectors.size());
+  if (query_vectors.empty() || space->file_index->size() == 0 || k <= 0) {
+    return results;
+  }
+  std::optional<VectorIndex::IdFilter> allowed;
+  if (!filter.empty()) {
+    allowed = resolve_search_filter(filter);
+    if (allowed->empty()) {
+      return results;
+    }
+  }
+
+  std::vector<float> flat;
+  flat.reserve(query_vectors.size() * space->dimension);
+  for (const auto &query : query_vectors) {
+    flat.insert(flat.end(), query.begin(), query.end());
+  }
+  std::vector<std::vector<VectorIndexHit>> hits;
+  try {
+    trace::Span span("ann.files");
+    span.set_attribute("k", k);
+    span.set_attribute("queries", static_cast<int64_t>(query_vectors.size()));
+    hits = space->file_index->search_batch(flat, k, tuning, allowed ? &*allowed : nullptr);
+  } catch (const VectorIndexError &e) {
+    throw MetadataStoreError(e.what());
+  }
+
+  // Queries in a batch tend to overlap, so each file is fetched once
+  std::vector<int> label_ids;
+  std::unordered_set<int> seen;
+  for (const auto &query_hits : hits) {
+    for (const auto &hit : query_hits) {
+      if (seen.insert(static_cast<int>(hit.id)).second) {
+        label_ids.push_back(static_cast<int>(hit.id));
+      }
+    }
+  }
+  const std::unordered_map<int, FileMetadata> id_to_metadata = fetch_file_metadata(label_ids);
+  const auto duplicates = fetch_duplicate_paths(label_ids);
+
+  for (size_t q = 0; q < hits.size(); ++q) {
+    results[q].reserve(hits[q].size());
+    for (const auto &hit : hits[q]) {
+      const int id = static_cast<int>(hit.id);
+      auto it = id_to_metadata.find(id);
+      if (it != id_to_metadata.end()) {
+        auto paths = duplicates.find(id);
+        results[q].push_back({id, hit.distance, it->second,
+                              paths != duplicates.end() ? paths->second
+                                                        : std::vector<std::string>{}});
+      }
+    }
+  }
+  return results;
+}
+
+std::vector<std::vector<ChunkSearchResult>> MetadataStore::search_similar_chunks_batch(
+    const std::vector<std::vector<int>> &file_ids,
+    const std::vector<std::vector<float>> &query_vectors,
+    int k,
+    const VectorSearchOptions &tuning,
+    bool with_content) {
+  const auto space = vector_space();
+  if (file_ids.size() != query_vectors.size()) {
+    throw MetadataStoreError("search_similar_chunks_batch needs one file list per query");
+  }
+  std::vector<std::vector<ChunkSearchResult>> results(query_vectors.size());
+  if (k <= 0) {
+    return results;
+  }
+
+  try {
+    // Chunk ids of every candidate file of every query, in one query
+    std::vector<int> all_files;
+    std::unordered_set<int> seen;
+    for (const auto &ids : file_ids) {
+      for (int id : ids) {
+        if (seen.insert(id).second) {
+          all_files.push_back(id);
+        }
+      }
+    }
+    if (all_files.empty()) {
+      return results;
+    }
+    std::unordered_map<int, std::vector<int64_t>> chunks_by_file;
+    {
+      trace::Span span("sqlite.chunk_candidates");
+      PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+      conn.prepare("SELECT id, file_id FROM chunks WHERE file_id IN "
+                   "(SELECT value FROM json_each(?))")
+              << int_vector_to_json_array(all_files) >>
+          [&](int64_t id, int file_id) { chunks_by_file[file_id].push_back(id); };
+    }
+
+    // Candidate sets differ per query, so the chunk searches stay separate; each is
+    // restricted to a few files' chunks and therefore cheap
+    std::vector<ChunkSearchResult> all_chunks;
+    std::vector<size_t> query_of;
+    std::optional<trace::Span> search_span(std::in_place, "ann.chunks");
+    for (size_t q = 0; q < query_vectors.size(); ++q) {
+      VectorIndex::IdFilter candidates;
+      for (int file_id : file_ids[q]) {
+        auto it = chunks_by_file.find(file_id);
+        if (it != chunks_by_file.end()) {
+          candidates.insert(it->second.begin(), it->second.end());
+        }
+      }
+      if (candidates.empty()) {
+        continue;
+      }
+      std::vector<VectorIndexHit> hits;
+      try {
+        hits = space->chunk_index->search(query_vectors[q], k, &candidates, tuning);
+      } catch (const VectorIndexError &e) {
+        throw MetadataStoreError(e.what());
+      }
+      for (const auto &hit : hits) {
+        ChunkSearchResult chunk;
+        chunk.id = static_cast<int>(hit.id);
+        chunk.distance = hit.distance;
+        all_chunks.push_back(chunk);
+        query_of.push_back(q);
+      }
+    }
+    search_span.reset();
+
+    fill_chunk_metadata(all_chunks, with_content);
+    for (size_t i = 0; i < all_chunks.size(); ++i) {
+      results[query_of[i]].push_back(std::move(all_chunks[i]));
+    }
+    return results;
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError("Failed to search similar chunks: " + std::string(e.what()));
+  }
+}
+
+std::optional<std::unordered_map<int, std::shared_ptr<const ChunkSlab>>>
+MetadataStore::load_chunk_slabs(const std::vector<int> &file_ids) {
+  // Taken before the read, so a commit landing during it keeps these slabs out of the cache. A
+  // model swap clears the cache after publishing its space, so it counts as such a commit.
+  const uint64_t ticket = chunk_slabs_.ticket();
+  const auto space = vector_space();
+  std::unordered_map<int, std::shared_ptr<const ChunkSlab>> slabs;
+  std::vector<int> missing;
+  size_t total_chunks = 0;
+  for (int file_id : file_ids) {
+    auto slab = chunk_slabs_.get(file_id);
+    if (slab && slab->dimension == space->dimension) {
+      total_chunks += slab->size();
+      slabs.emplace(file_id, std::move(slab));
+    } else {
+      missing.push_back(file_id);
+    }
+  }
+  if (missing.empty()) {
+    return total_chunks > EXACT_SCAN_MAX_CHUNKS ? std::nullopt : std::optional(std::move(slabs));
+  }
+
+  trace::Span span("load.chunk_slabs");
+  span.set_attribute("files", static_cast<int64_t>(missing.size()));
+  std::vector<int64_t> keys;
+  std::vector<int> owners;
+  std::vector<VectorStore::Offset> offsets;
+  {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    // In offset order the store is read front to back
+    conn.prepare("SELECT id, file_id, vector_offset FROM chunks WHERE file_id IN "
+                 "(SELECT value FROM json_each(?)) AND vector_offset IS NOT NULL "
+                 "ORDER BY vector_offset")
+            << int_vector_to_json_array(missing) >>
+        [&](int64_t id, int file_id, int64_t vector_offset) {
+          keys.push_back(id);
+          owners.push_back(file_id);
+          offsets.push_back(vector_offset);
+        };
+  }
+  if (total_chunks + keys.size() > EXACT_SCAN_MAX_CHUNKS) {
+    return std::nullopt;
   }
 
-  if (query_vector.size() != VECTOR_DIMENSION) {
-    throw MetadataStoreError("Query vector dimension mismatch. Expected " +
-                             std::to_string(VECTOR_DIMENSION) + ", got " +
-                             std::to_string(query_vector.size()));
+  std::vector<float> vectors(keys.size() * space->dimension);
+  const std::vector<bool> found = space->chunk_vectors->read_many(offsets, keys, vectors.data());
+  const VectorMetric metric = space->chunk_index->options().metric;
+  std::unordered_map<int, size_t> rows;
+  for (int owner : owners) {
+    ++rows[owner];
+  }
+  std::unordered_map<int, std::shared_ptr<ChunkSlab>> loaded;
+  for (int file_id : missing) {
+    auto slab = std::make_shared<ChunkSlab>(space->dimension, metric);
+    slab->reserve(rows[file_id]);
+    loaded.emplace(file_id, std::move(slab));
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (found[i]) {
+      loaded[owners[i]]->append(keys[i], vectors.data() + i * space->dimension);
+    }
   }
+  for (auto &[file_id, slab] : loaded) {
+    chunk_slabs_.put(file_id, slab, ticket);
+    slabs.emplace(file_id, std::move(slab));
+  }
+  return slabs;
+}
 
-  index->search(1, query_vector.data(), k, distances.data(), labels.data());
+std::vector<ChunkSearchResult> MetadataStore::scan_similar_chunks(
+    const std::vector<int> &file_ids,
+    const std::vector<float> &query_vector,
+    int k,
+    bool with_content) {
+  return std::move(scan_similar_chunks_batch({file_ids}, {query_vector}, k, with_content)[0]);
 }
 
-faiss::IndexIDMap *MetadataStore::create_base_index() {
-  auto base_index = new faiss::IndexHNSWFlat(VECTOR_DIMENSION, HNSW_M_PARAM);
-  base_index->hnsw.efConstruction = HNSW_EF_CONSTRUCTION_PARAM;
-  // Wrap with IDMap to enable add_with_ids
-  return new faiss::IndexIDMap(base_index);
+std::vector<std::vector<ChunkSearchResult>> MetadataStore::scan_similar_chunks_batch(
+    const std::vector<std::vector<int>> &file_ids,
+    const std::vector<std::vector<float>> &query_vectors,
+    int k,
+    bool with_content) {
+  if (file_ids.size() != query_vectors.size()) {
+    throw MetadataStoreError("scan_similar_chunks_batch needs one file list per query");
+  }
+  std::vector<std::vector<ChunkSearchResult>> results(query_vectors.size());
+  if (k <= 0) {
+    return results;
+  }
+
+  try {
+    std::vector<int> all_files;
+    std::unordered_set<int> seen;
+    for (const auto &ids : file_ids) {
+      for (int id : ids) {
+        if (seen.insert(id).second) {
+          all_files.push_back(id);
+        }
+      }
+    }
+    if (all_files.empty()) {
+      return results;
+    }
+    auto slabs = load_chunk_slabs(all_files);
+    if (!slabs) {
+      return search_similar_chunks_batch(file_ids, query_vectors, k, {}, with_content);
+    }
+
+    std::vector<ChunkSearchResult> all_chunks;
+    std::vector<size_t> query_of;
+    std::optional<trace::Span> scan_span(std::in_place, "scan.chunks");
+    for (size_t q = 0; q < query_vectors.size(); ++q) {
+      std::vector<const ChunkSlab *> candidates;
+      for (int file_id : file_ids[q]) {
+        auto it = slabs->find(file_id);
+        if (it != slabs->end() && it->second->size() > 0) {
+          candidates.push_back(it->second.get());
+        }
+      }
+      std::vector<VectorIndexHit> hits;
+      try {
+        hits = scan_slabs(candidates, query_vectors[q], k);
+      } catch (const VectorIndexError &e) {
+        throw MetadataStoreError(e.what());
+      }
+      for (const auto &hit : hits) {
+        ChunkSearchResult chunk;
+        chunk.id = static_cast<int>(hit.id);
+        chunk.distance = hit.distance;
+        all_chunks.push_back(chunk);
+        query_of.push_back(q);
+      }
+    }
+    scan_span.reset();
+
+    fill_chunk_metadata(all_chunks, with_content);
+    for (size_t i = 0; i < all_chunks.size(); ++i) {
+      results[query_of[i]].push_back(std::move(all_chunks[i]));
+    }
+    return results;
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("scan_similar_chunks", e));
+  }
+}
+
+std::string MetadataStore::text_match_expression(const std::string &query) {
+  std::string expression;
+  std::string word;
+  for (char c : query + ' ') {
+    const auto byte = static_cast<unsigned char>(c);
+    // The tokenizer's word characters; multi-byte UTF-8 is left for it to split
+    if (std::isalnum(byte) || c == '_' || byte >= 0x80) {
+      word += c;
+    } else if (!word.empty()) {
+      if (!expression.empty()) {
+        expression += " OR ";
+      }
+      expression += '"' + word + '"';
+      word.clear();
+    }
+  }
+  return expression;
+}
+
+std::vector<ChunkSearchResult> MetadataStore::search_chunks_lexical(const std::string &query,
+                                                                    int k,
+                                                                    bool with_content,
+                                                                    const SearchFilter &filter) {
+  const std::string expression = text_match_expression(query);
+  if (expression.empty() || k <= 0) {
+    return {};
+  }
+  std::vector<ChunkSearchResult> chunks;
+  trace::Span span("sqlite.lexical");
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    // rank is bm25() unless configured otherwise, and lets FTS5 sort while it scans
+    const bool filtered = !filter.empty();
+    auto &statement =
+        conn.prepare(std::string("SELECT c.id, c.file_id, c.chunk_index, chunks_fts.rank") +
+                     (with_content ? ", c.content" : ", NULL") +
+                     " FROM chunks_fts JOIN chunks c ON c.id = chunks_fts.rowid" +
+                     (filtered ? " JOIN files f ON f.id = c.file_id" : "") +
+                     " WHERE chunks_fts MATCH ?" + filter_conditions(filter) +
+                     " ORDER BY chunks_fts.rank LIMIT ?");
+    statement << expression;
+    bind_filter(statement, filter);
+    statement << k >>
+        [&](int id, int file_id, int chunk_index, double rank, std::vector<char> content) {
+          ChunkSearchResult chunk;
+          chunk.id = id;
+          chunk.distance = static_cast<float>(rank);
+          chunk.file_id = file_id;
+          chunk.chunk_index = chunk_index;
+          chunk.compressed_content = std::move(content);
+          chunks.push_back(std::move(chunk));
+        };
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("search_chunks_lexical", e));
+  }
+  return chunks;
+}
+
+VectorIndex::IdFilter MetadataStore::resolve_search_filter(const SearchFilter &filter) {
+  VectorIndex::IdFilter ids;
+  trace::Span span("sqlite.search_filter");
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    // A duplicate matching the filter stands for the file whose content it shares
+    auto &statement = conn.prepare("SELECT COALESCE(f.content_source_id, f.id) FROM files f "
+                                   "WHERE 1" + filter_conditions(filter));
+    bind_filter(statement, filter);
+    statement >> [&](int64_t id) { ids.insert(id); };
+  } catch (const sqlite::sqlite_exception &e) {
+    throw MetadataStoreError(format_db_error("resolve_search_filter", e));
+  }
+  return ids;
+}
+
+std::vector<FileSearchResult> MetadataStore::get_file_search_results(
+    const std::vector<SearchResult> &hits) {
+  std::vector<int> file_ids;
+  file_ids.reserve(hits.size());
+  for (const auto &hit : hits) {
+    file_ids.push_back(hit.id);
+  }
+  if (file_ids.empty()) {
+    return {};
+  }
+  std::unordered_map<int, FileMetadata> id_to_metadata = fetch_file_metadata(file_ids);
+  auto duplicates = fetch_duplicate_paths(file_ids);
+  std::vector<FileSearchResult> results;
+  results.reserve(hits.size());
+  for (const auto &hit : hits) {
+    auto it = id_to_metadata.find(hit.id);
+    if (it != id_to_metadata.end()) {
+      results.push_back(
+          {hit.id, hit.distance, std::move(it->second), std::move(duplicates[hit.id])});
+    }
+  }
+  return results;
+}
+
+// One query using a single connection. Hits only need the row, so the vector file is never touched
+std::unordered_map<int, FileMetadata> MetadataStore::fetch_file_metadata(
+    const std::vector<int> &file_ids) {
+  std::unordered_map<int, FileMetadata> id_to_metadata;
+  if (file_ids.empty()) {
+    return id_to_metadata;
+  }
+  {
+    trace::Span span("sqlite.file_metadata");
+    span.set_attribute("files", static_cast<int64_t>(file_ids.size()));
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    conn.prepare("SELECT id, path, original_path, file_hash, processing_status, tags, "
+                 "last_modified, created_at, file_type, file_size, suggested_category, "
+                 "suggested_filename, summary FROM files WHERE id IN "
+                 "(SELECT value FROM json_each(?))")
+            << int_vector_to_json_array(file_ids) >>
+        [&](int id, std::string path, std::optional<std::string> original_path,
+            std::string file_hash, std::optional<std::string> processing_status,
+            std::optional<std::string> tags, int64_t last_modified, int64_t created_at,
+            std::string file_type, int64_t file_size,
+            std::optional<std::string> suggested_category,
+            std::optional<std::string> suggested_filename,
+            std::optional<std::string> summary) {
+          FileMetadata metadata;
+          metadata.id = id;
+          metadata.path = path;
+          if (original_path)
+            metadata.original_path = *original_path;
+          metadata.content_hash = file_hash;
+          if (processing_status)
+            metadata.processing_status = processing_status_from_string(*processing_status);
+          if (tags)
+            metadata.tags = *tags;
+          metadata.last_modified = from_epoch_millis(last_modified);
+          metadata.created_at = from_epoch_millis(created_at);
+          metadata.file_type = file_type_from_string(file_type);
+          metadata.file_size = static_cast<size_t>(file_size);
+          if (suggested_category)
+            metadata.suggested_category = *suggested_category;
+          if (suggested_filename)
+            metadata.suggested_filename = *suggested_filename;
+          if (summary)
+            metadata.summary = *summary;
+          id_to_metadata[id] = std::move(metadata);
+        };
+  }
+  return id_to_metadata;
 }
 
-std::string MetadataStore::int_vector_to_comma_string(const std::vector<int> &vector) {
-  std::stringstream ss;
+std::string MetadataStore::int_vector_to_json_array(const std::vector<int> &vector) {
+  std::string json = "[";
   for (size_t i = 0; i < vector.size(); ++i) {
-    ss << vector[i];
-    if (i < vector.size() - 1)
-      ss << ",";
+    if (i > 0)
+      json += ',';
+    json += std::to_string(vector[i]);
   }
-  return ss.str();
+  json += ']';
+  return json;
 }
 
 
@@ -0,0 +1,162 @@
+#include "magic_core/db/near_duplicate_index.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <stdexcept>
+
+namespace magic_core {
+
+namespace {
+
+// splitmix64's finalizer: spreads the bits of word hashes that differ in a few places
+uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+// Letters, digits and every byte of a UTF-8 sequence make up words; the rest separates them
+bool is_word_byte(unsigned char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+// Dates, amounts and reference numbers are what templates fill in, so all numbers hash alike
+constexpr uint64_t NUMBER_WORD = 0x9e3779b97f4a7c15ull;
+
+}  // namespace
+
+// Bits left over when 64 does not divide into the bands are compared but not banded on
+NearDuplicateIndex::NearDuplicateIndex(size_t capacity, int max_distance)
+    : capacity_(capacity),
+      max_distance_(max_distance),
+      bands_used_(static_cast<size_t>(std::clamp(max_distance, 0, MAX_DISTANCE)) + 1),
+      band_bits_(64 / bands_used_),
+      band_mask_(band_bits_ == 64 ? ~uint64_t{0} : (uint64_t{1} << band_bits_) - 1) {
+  if (max_distance < 0 || max_distance > MAX_DISTANCE) {
+    throw std::invalid_argument("Near-duplicate distance must be 0 to " +
+                                std::to_string(MAX_DISTANCE) + " bits, not " +
+                                std::to_string(max_distance));
+  }
+  entries_.reserve(capacity_);
+}
+
+std::optional<uint64_t> NearDuplicateIndex::fingerprint(std::string_view text) {
+  std::array<int, 64> weights{};
+  std::array<uint64_t, SHINGLE_WORDS> window{};
+  size_t words = 0;
+  size_t shingles = 0;
+  size_t i = 0;
+  while (i < text.size()) {
+    while (i < text.size() && !is_word_byte(static_cast<unsigned char>(text[i]))) {
+      ++i;
+    }
+    if (i == text.size()) {
+      break;
+    }
+    // FNV-1a of the lower-cased word
+    uint64_t word = 14695981039346656037ull;
+    bool number = true;
+    for (; i < text.size() && is_word_byte(static_cast<unsigned char>(text[i])); ++i) {
+      unsigned char c = static_cast<unsigned char>(text[i]);
+      if (c >= 'A' && c <= 'Z') {
+        c = static_cast<unsigned char>(c - 'A' + 'a');
+      }
+      number = number && c >= '0' && c <= '9';
+      word ^= c;
+      word *= 1099511628211ull;
+    }
+    if (number) {
+      word = NUMBER_WORD;
+    }
+    window[words % SHINGLE_WORDS] = word;
+    if (++words < SHINGLE_WORDS) {
+      continue;
+    }
+    // Position-dependent, so "a b" and "b a" are different shingles
+    uint64_t shingle = 0;
+    for (size_t w = 0; w < SHINGLE_WORDS; ++w) {
+      shingle = mix(shingle ^ window[(words + w) % SHINGLE_WORDS]);
+    }
+    for (size_t bit = 0; bit < 64; ++bit) {
+      weights[bit] += (shingle >> bit) & 1 ? 1 : -1;
+    }
+    ++shingles;
+  }
+  if (shingles < MIN_SHINGLES) {
+    return std::nullopt;
+  }
+  uint64_t result = 0;
+  for (size_t bit = 0; bit < 64; ++bit) {
+    if (weights[bit] > 0) {
+      result |= uint64_t{1} << bit;
+    }
+  }
+  return result;
+}
+
+std::optional<std::string> NearDuplicateIndex::find(uint64_t fingerprint) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Entry* nearest = nullptr;
+  int nearest_distance = max_distance_ + 1;
+  for (size_t b = 0; b < bands_used_; ++b) {
+    auto [first, last] = bands_[b].equal_range(band(fingerprint, b));
+    for (auto it = first; it != last; ++it) {
+      const Entry& entry = entries_[it->second];
+      const int distance = std::popcount(entry.fingerprint ^ fingerprint);
+      if (distance < nearest_distance) {
+        nearest = &entry;
+        nearest_distance = distance;
+      }
+    }
+  }
+  if (!nearest) {
+    return std::nullopt;
+  }
+  return nearest->key;
+}
+
+void NearDuplicateIndex::insert(uint64_t fingerprint, std::string key) {
+  if (capacity_ == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t slot = next_;
+  next_ = (next_ + 1) % capacity_;
+  if (slot == entries_.size()) {
+    entries_.emplace_back();
+  } else {
+    for (size_t b = 0; b < bands_used_; ++b) {
+      auto [first, last] = bands_[b].equal_range(band(entries_[slot].fingerprint, b));
+      for (auto it = first; it != last; ++it) {
+        if (it->second == slot) {
+          bands_[b].erase(it);
+          break;
+        }
+      }
+    }
+  }
+  entries_[slot] = Entry{fingerprint, std::move(key)};
+  for (size_t b = 0; b < bands_used_; ++b) {
+    bands_[b].emplace(band(fingerprint, b), slot);
+  }
+}
+
+void NearDuplicateIndex::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  next_ = 0;
+  for (auto& map : bands_) {
+    map.clear();
+  }
+}
+
+size_t NearDuplicateIndex::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+}  // namespace magic_core
@@ -0,0 +1,519 @@
+#include "magic_core/db/schema_migrations.hpp"
+
+#include <iterator>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "magic_core/db/transaction.hpp"
+#include "magic_core/types/logger.hpp"
+
+namespace magic_core {
+
+namespace {
+
+void add_column_if_missing(sqlite::database& db,
+                           const std::string& table,
+                           const std::string& column,
+                           const std::string& type) {
+  int count = 0;
+  db << "SELECT COUNT(*) FROM pragma_table_info(?) WHERE name = ?" << table << column >> count;
+  if (count == 0) {
+    db << "ALTER TABLE " + table + " ADD COLUMN " + column + " " + type;
+  }
+}
+
+std::string files_table_sql(const std::string& name) {
+  return "CREATE TABLE IF NOT EXISTS " + name + R"( (
+          id INTEGER PRIMARY KEY AUTOINCREMENT,
+          path TEXT UNIQUE NOT NULL,
+          original_path TEXT,
+          file_hash TEXT NOT NULL,
+          processing_status TEXT NOT NULL,
+          summary_vector_blob BLOB,
+          summary_vector_offset INTEGER,
+          suggested_category TEXT,
+          suggested_filename TEXT,
+          tags TEXT,
+          last_modified INTEGER NOT NULL,
+          created_at INTEGER NOT NULL,
+          file_type TEXT NOT NULL,
+          file_size INTEGER NOT NULL
+      )
+    )";
+}
+
+std::string task_queue_table_sql(const std::string& name) {
+  return "CREATE TABLE IF NOT EXISTS " + name + R"( (
+          id INTEGER PRIMARY KEY AUTOINCREMENT,
+          task_type TEXT NOT NULL,
+          status TEXT DEFAULT 'PENDING',
+          priority INTEGER DEFAULT 10,
+          error_message TEXT,
+          created_at INTEGER NOT NULL,
+          updated_at INTEGER NOT NULL,
+          target_path TEXT NULL, -- Used by PROCESS_FILE, DELETE_FILE, etc.
+          target_tag TEXT NULL,  -- Used by RETROACTIVE_TAG, RENAME_TAG, etc.
+          payload TEXT NULL      -- For less common or complex arguments like 'keywords'
+      )
+    )";
+}
+
+std::string task_progress_table_sql(const std::string& name) {
+  return "CREATE TABLE IF NOT EXISTS " + name + R"( (
+        task_id INTEGER PRIMARY KEY, -- This is a FOREIGN KEY to task_queue.id
+        progress_percent REAL NOT NULL DEFAULT 0.0,
+        status_message TEXT NOT NULL DEFAULT 'Initializing...',
+        updated_at INTEGER NOT NULL,
+        FOREIGN KEY (task_id) REFERENCES task_queue(id) ON DELETE CASCADE
+    )
+    )";
+}
+
+// A table with timestamp columns, which hold INTEGER epoch millis
+struct TimestampTable {
+  const char* table;
+  std::string (*create_sql)(const std::string& name);
+  std::vector<std::string> columns;
+  std::set<std::string> timestamp_columns;
+};
+
+const std::vector<TimestampTable>& timestamp_tables() {
+  static const std::vector<TimestampTable> tables = {
+      {"files",
+       files_table_sql,
+       {"id", "path", "original_path", "file_hash", "processing_status", "summary_vector_blob",
+        "summary_vector_offset", "suggested_category", "suggested_filename", "tags",
+        "last_modified", "created_at", "file_type", "file_size"},
+       {"last_modified", "created_at"}},
+      // Parent before child, so task_progress's foreign key refers to the rebuilt task_queue
+      {"task_queue",
+       task_queue_table_sql,
+       {"id", "task_type", "status", "priority", "error_message", "created_at", "updated_at",
+        "target_path", "target_tag", "payload"},
+       {"created_at", "updated_at"}},
+      {"task_progress",
+       task_progress_table_sql,
+       {"task_id", "progress_percent", "status_message", "updated_at"},
+       {"updated_at"}},
+  };
+  return tables;
+}
+
+std::string column_type(sqlite::database& db, const std::string& table, const std::string& column) {
+  std::string type;
+  db << "SELECT type FROM pragma_table_info(?) WHERE name = ?" << table << column >>
+      [&](std::string value) { type = std::move(value); };
+  return type;
+}
+
+void create_task_queue_indexes(sqlite::database& db) {
+  db << R"(
+      CREATE INDEX IF NOT EXISTS idx_task_queue_status_priority
+      ON task_queue(status, priority, created_at)
+    )";
+}
+
+// Any change to the vectors an index is built from bumps its generation counter
+void create_index_generation_triggers(sqlite::database& db) {
+  db << R"(
+      CREATE TRIGGER IF NOT EXISTS trg_files_vector_insert AFTER INSERT ON files
+      WHEN NEW.summary_vector_blob IS NOT NULL
+      BEGIN
+          UPDATE index_generations SET generation = generation + 1 WHERE name = 'files';
+      END
+    )";
+  db << R"(
+      CREATE TRIGGER IF NOT EXISTS trg_files_vector_update
+      AFTER UPDATE OF summary_vector_blob ON files
+      WHEN OLD.summary_vector_blob IS NOT NEW.summary_vector_blob
+      BEGIN
+          UPDATE index_generations SET generation = generation + 1 WHERE name = 'files';
+      END
+    )";
+  db << R"(
+      CREATE TRIGGER IF NOT EXISTS trg_files_vector_delete AFTER DELETE ON files
+      WHEN OLD.summary_vector_blob IS NOT NULL
+      BEGIN
+          UPDATE index_generations SET generation = generation + 1 WHERE name = 'files';
+      END
+    )";
+  db << R"(
+      CREATE TRIGGER IF NOT EXISTS trg_chunks_vector_insert AFTER INSERT ON chunks
+      WHEN NEW.vector_blob IS NOT NULL
+      BEGIN
+          UPDATE index_generations SET generation = generation + 1 WHERE name = 'chunks';
+      END
+    )";
+  db << R"(
+      CREATE TRIGGER IF NOT EXISTS trg_chunks_vector_update
+      AFTER UPDATE OF vector_blob ON chunks
+      WHEN OLD.vector_blob IS NOT NEW.vector_blob
+      BEGIN
+          UPDATE index_generations SET generation = generation + 1 WHERE name = 'chunks';
+      END
+    )";
+  db << R"(
+      CREATE TRIGGER IF NOT EXISTS trg_chunks_vector_delete AFTER DELETE ON chunks
+      WHEN OLD.vector_blob IS NOT NULL
+      BEGIN
+          UPDATE index_generations SET generation = generation + 1 WHERE name = 'chunks';
+      END
+    )";
+  const std::pair<const char*, const char*> offset_columns[] = {
+      {"files", "summary_vector_offset"},
+      {"chunks", "vector_offset"},
+  };
+  for (const auto& [table, column] : offset_columns) {
+    const std::string rows = table;
+    const std::string offset = column;
+    const std::string bump = "UPDATE index_generations SET generation = generation + 1 "
+                             "WHERE name = '" + rows + "';";
+    db << "CREATE TRIGGER IF NOT EXISTS trg_" + rows + "_offset_insert AFTER INSERT ON " + rows +
+              " WHEN NEW." + offset + " IS NOT NULL BEGIN " + bump + " END";
+    db << "CREATE TRIGGER IF NOT EXISTS trg_" + rows + "_offset_update AFTER UPDATE OF " +
+              offset + " ON " + rows + " WHEN OLD." + offset + " IS NOT NEW." + offset +
+              " BEGIN " + bump + " END";
+    db << "CREATE TRIGGER IF NOT EXISTS trg_" + rows + "_offset_delete AFTER DELETE ON " + rows +
+              " WHEN OLD." + offset + " IS NOT NULL BEGIN " + bump + " END";
+  }
+}
+
+// Version 1: the schema as it stood when versioning was introduced. Everything is IF NOT EXISTS,
+// so databases created before then are brought level instead of rejected.
+void baseline_schema(sqlite::database& db) {
+  db << files_table_sql("files");
+
+  // chunks
+  db << R"(
+      CREATE TABLE IF NOT EXISTS chunks (
+          id INTEGER PRIMARY KEY AUTOINCREMENT,
+          file_id INTEGER NOT NULL,
+          chunk_index INTEGER NOT NULL,
+          content BLOB NOT NULL,
+          vector_blob BLOB,
+          vector_offset INTEGER,
+          FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE
+      )
+    )";
+
+  // Vectors live in per-table segment files next to the database; rows hold their offset
+  add_column_if_missing(db, "files", "summary_vector_offset", "INTEGER");
+  add_column_if_missing(db, "chunks", "vector_offset", "INTEGER");
+  // Each segment's epoch is bumped with every compaction, in the same transaction that rewrites
+  // the offsets, so the database always says which version of the file its offsets refer to
+  db << R"(
+      CREATE TABLE IF NOT EXISTS vector_segments (
+          name TEXT PRIMARY KEY,
+          epoch INTEGER NOT NULL DEFAULT 0
+      )
+    )";
+  db << "INSERT OR IGNORE INTO vector_segments (name, epoch) VALUES ('files', 0)";
+  db << "INSERT OR IGNORE INTO vector_segments (name, epoch) VALUES ('chunks', 0)";
+
+  // Chunk searches look up the candidate files' chunk ids
+  db << "CREATE INDEX IF NOT EXISTS idx_chunks_file_id ON chunks(file_id)";
+
+  // Embeddings by chunk content and model, so unchanged and repeated chunks are not re-embedded.
+  // Not tied to chunks: entries outlive the files they came from.
+  db << R"(
+      CREATE TABLE IF NOT EXISTS embedding_cache (
+          content_hash TEXT NOT NULL,
+          model TEXT NOT NULL,
+          vector_blob BLOB NOT NULL,
+          PRIMARY KEY (content_hash, model)
+      ) WITHOUT ROWID
+    )";
+
+  // task_queue
+  db << task_queue_table_sql("task_queue");
+  db << task_progress_table_sql("task_progress");
+  create_task_queue_indexes(db);
+
+  // Generation counters for the in-memory vector indexes. Any change to the vectors an index is
+  // built from bumps its counter, so a persisted index snapshot is only reused while it matches.
+  db << R"(
+      CREATE TABLE IF NOT EXISTS index_generations (
+          name TEXT PRIMARY KEY,
+          generation INTEGER NOT NULL DEFAULT 0
+      )
+    )";
+  db << "INSERT OR IGNORE INTO index_generations (name, generation) VALUES ('files', 0)";
+  db << "INSERT OR IGNORE INTO index_generations (name, generation) VALUES ('chunks', 0)";
+  create_index_generation_triggers(db);
+}
+
+// Version 2. Databases created before timestamps were epoch millis declared them TEXT and
+// stored "YYYY-MM-DD HH:MM:SS" in UTC. TEXT affinity would turn integers written into those
+// columns back into text, so such tables are rebuilt with INTEGER columns and their values
+// converted. Dropping a table drops its indexes and triggers, which are created again after.
+void epoch_millis_timestamps(sqlite::database& db) {
+  std::vector<const TimestampTable*> stale;
+  for (const TimestampTable& table : timestamp_tables()) {
+    if (column_type(db, table.table, *table.timestamp_columns.begin()) == "TEXT") {
+      stale.push_back(&table);
+    }
+  }
+  if (stale.empty()) {
+    return;
+  }
+
+  for (const TimestampTable* table : stale) {
+    const std::string name = table->table;
+    const std::string rebuilt = name + "_epoch_millis";
+    std::string columns;
+    std::string select;
+    for (const std::string& column : table->columns) {
+      const std::string separator = columns.empty() ? "" : ", ";
+      columns += separator + column;
+      if (table->timestamp_columns.count(column) == 0) {
+        select += separator + column;
+      } else {
+        // Unparseable text becomes 0 rather than failing the NOT NULL constraint
+        select += separator + "CASE typeof(" + column + ") WHEN 'text' THEN COALESCE(CAST(" +
+                  "strftime('%s', " + column + ") AS INTEGER) * 1000, 0) ELSE " + column +
+                  " END";
+      }
+    }
+    db << table->create_sql(rebuilt);
+    db << "INSERT INTO " + rebuilt + " (" + columns + ") SELECT " + select + " FROM " + name;
+    db << "DROP TABLE " + name;
+    db << "ALTER TABLE " + rebuilt + " RENAME TO " + name;
+  }
+  create_task_queue_indexes(db);
+  create_index_generation_triggers(db);
+  log::info() << "Converted timestamps in " << stale.size() << " tables to epoch milliseconds.";
+}
+
+// Version 3: indexes for the hot lookups
+void covering_indexes(sqlite::database& db) {
+  // Chunks are fetched by file and read in chunk order. id is the rowid, so the id/file_id
+  // lookups of chunk searches are answered from the index alone.
+  db << "CREATE INDEX IF NOT EXISTS idx_chunks_file_id_chunk_index ON chunks(file_id, chunk_index)";
+  // Its prefix serves every query the single-column index did
+  db << "DROP INDEX IF EXISTS idx_chunks_file_id";
+  // Every ingest request asks for the processing status of a content hash
+  db << "CREATE INDEX IF NOT EXISTS idx_files_file_hash ON files(file_hash, processing_status)";
+}
+
+// Version 4: content hashes on chunks, so reprocessing a file only embeds the chunks that changed.
+// Existing rows keep a NULL hash and are replaced the next time their file is processed.
+void chunk_content_hashes(sqlite::database& db) {
+  add_column_if_missing(db, "chunks", "content_hash", "TEXT");
+}
+
+// Version 5: claim order with aging. A pending task gains one priority level for every minute it
+// waits, so a backlog of bulk work is eventually interleaved with newer interactive tasks instead
+// of starving behind them. TaskQueueRepo orders claims by the same expression.
+void aged_task_priority_index(sqlite::database& db) {
+  db << R"(
+      CREATE INDEX IF NOT EXISTS idx_task_queue_status_aged_priority
+      ON task_queue(status, priority * 60000 + created_at)
+    )";
+}
+
+// Version 6: leases on claimed tasks. A claim records its owner and an expiry the owner keeps
+// pushing forward; tasks whose owner died are reclaimed when the lease runs out.
+void task_leases(sqlite::database& db) {
+  add_column_if_missing(db, "task_queue", "lease_owner", "TEXT");
+  add_column_if_missing(db, "task_queue", "lease_expires_at", "INTEGER");
+  add_column_if_missing(db, "task_queue", "attempts", "INTEGER NOT NULL DEFAULT 0");
+  // Claims made before leases existed have nobody to renew them
+  db << "UPDATE task_queue SET lease_expires_at = 0 "
+        "WHERE status = 'PROCESSING' AND lease_expires_at IS NULL";
+  db << R"(
+      CREATE INDEX IF NOT EXISTS idx_task_queue_status_lease
+      ON task_queue(status, lease_expires_at)
+    )";
+}
+
+// Version 7: trained zstd dictionaries for chunk content, keyed by the id zstd records in every
+// frame compressed with them. Old dictionaries stay so the chunks written with them still decode.
+void compression_dictionaries(sqlite::database& db) {
+  db << R"(
+      CREATE TABLE IF NOT EXISTS compression_dictionaries (
+          id INTEGER PRIMARY KEY,
+          dictionary BLOB NOT NULL,
+          sample_count INTEGER NOT NULL,
+          chunk_count INTEGER NOT NULL,
+          created_at INTEGER NOT NULL
+      )
+    )";
+}
+
+// Version 8: a full-text index over chunk content, keyed by chunk id. The blobs are compressed,
+// so the plain text is written by MetadataStore alongside them; chunks stored before this version
+// are indexed in the background by index maintenance. Underscores stay inside tokens so
+// identifiers such as ERR_CONN_RESET match whole.
+void chunk_text_index(sqlite::database& db) {
+  db << R"(
+      CREATE VIRTUAL TABLE IF NOT EXISTS chunks_fts
+      USING fts5(content, tokenize = "unicode61 tokenchars '_'")
+    )";
+  db << R"(
+      CREATE TRIGGER IF NOT EXISTS trg_chunks_fts_delete AFTER DELETE ON chunks
+      BEGIN
+          DELETE FROM chunks_fts WHERE rowid = OLD.id;
+      END
+    )";
+}
+
+// Version 9: indexes for search filters, which resolve to file ids before the vector search.
+// Path prefixes already range over the unique path index.
+void search_filter_indexes(sqlite::database& db) {
+  db << "CREATE INDEX IF NOT EXISTS idx_files_file_type_modified "
+        "ON files(file_type, last_modified)";
+  db << "CREATE INDEX IF NOT EXISTS idx_files_last_modified ON files(last_modified)";
+}
+
+// Version 10: the embedding models vectors have been written with. Exactly one is active: the
+// one the vector segments and indexes hold and queries are embedded with. The others are kept
+// while a re-embed into them is under way, or after one has replaced them.
+void embedding_model_registry(sqlite::database& db) {
+  db << R"(
+      CREATE TABLE IF NOT EXISTS embedding_models (
+          id INTEGER PRIMARY KEY,
+          name TEXT NOT NULL UNIQUE,
+          dimension INTEGER NOT NULL,
+          created_at INTEGER NOT NULL,
+          active INTEGER NOT NULL DEFAULT 0
+      )
+    )";
+  db << "CREATE UNIQUE INDEX IF NOT EXISTS idx_embedding_models_active "
+        "ON embedding_models(active) WHERE active = 1";
+}
+
+// Version 11: content-addressed duplicates. Another path of a stored file's content gets its own
+// row pointing at the file whose chunks and summary it shares, instead of a copy of them.
+// MetadataStore hands the content to a remaining duplicate before the source row goes; SET NULL
+// only guards against writers that do not.
+void duplicate_files(sqlite::database& db) {
+  add_column_if_missing(db, "files", "content_source_id",
+                        "INTEGER REFERENCES files(id) ON DELETE SET NULL");
+  db << "CREATE INDEX IF NOT EXISTS idx_files_content_source_id ON files(content_source_id) "
+        "WHERE content_source_id IS NOT NULL";
+}
+
+// Version 12: the generation lane. Files get the summary it writes beside the suggested
+// category and filename, and its SUMMARIZE_FILE tasks are claimed apart from the embedding
+// lanes, each through an aged priority index of its own so that neither steps over the
+// other's backlog. The WHERE clauses must match TaskQueueRepo's lane conditions word for word.
+void generation_lane(sqlite::database& db) {
+  add_column_if_missing(db, "files", "summary", "TEXT");
+  db << R"(
+      CREATE INDEX IF NOT EXISTS idx_task_queue_generation_aged_priority
+      ON task_queue(status, priority * 60000 + created_at)
+      WHERE task_type = 'SUMMARIZE_FILE'
+    )";
+  db << R"(
+      CREATE INDEX IF NOT EXISTS idx_task_queue_embedding_aged_priority
+      ON task_queue(status, priority * 60000 + created_at)
+      WHERE task_type != 'SUMMARIZE_FILE'
+    )";
+}
+
+// Version 13: task coalescing. A path holds at most one pending task of each type, so a file
+// saved over and over is processed once; duplicates queued before then are completed in
+// favour of the newest. TaskQueueRepo's ON CONFLICT target must match the unique index's WHERE
+// clause word for word. The second index finds a claimed task's newer duplicates.
+void coalesced_file_tasks(sqlite::database& db) {
+  db << R"(
+      UPDATE task_queue SET status = 'COMPLETED'
+      WHERE status = 'PENDING' AND target_path IS NOT NULL AND id NOT IN (
+          SELECT MAX(id) FROM task_queue WHERE status = 'PENDING' AND target_path IS NOT NULL
+          GROUP BY task_type, target_path)
+    )";
+  db << R"(
+      CREATE UNIQUE INDEX IF NOT EXISTS idx_task_queue_pending_path
+      ON task_queue(task_type, target_path)
+      WHERE status = 'PENDING' AND target_path IS NOT NULL
+    )";
+  db << R"(
+      CREATE INDEX IF NOT EXISTS idx_task_queue_type_path
+      ON task_queue(task_type, target_path)
+      WHERE target_path IS NOT NULL
+    )";
+}
+
+struct Migration {
+  int version;
+  const char* description;
+  void (*apply)(sqlite::database& db);
+};
+
+// Append new steps with the next version; a shipped step must never change
+const Migration MIGRATIONS[] = {
+    {1, "baseline schema", baseline_schema},
+    {2, "timestamps as epoch milliseconds", epoch_millis_timestamps},
+    {3, "covering indexes for chunk and hash lookups", covering_indexes},
+    {4, "chunk content hashes", chunk_content_hashes},
+    {5, "aged task priority index", aged_task_priority_index},
+    {6, "task leases", task_leases},
+    {7, "compression dictionaries", compression_dictionaries},
+    {8, "chunk full-text index", chunk_text_index},
+    {9, "search filter indexes", search_filter_indexes},
+    {10, "embedding model registry", embedding_model_registry},
+    {11, "duplicate files", duplicate_files},
+    {12, "generation lane", generation_lane},
+    {13, "coalesced file tasks", coalesced_file_tasks},
+};
+
+}  // namespace
+
+int latest_schema_version() {
+  return MIGRATIONS[std::size(MIGRATIONS) - 1].version;
+}
+
+int schema_version(sqlite::database& db) {
+  int version = 0;
+  db << "PRAGMA user_version;" >> version;
+  return version;
+}
+
+void migrate_schema(sqlite::database& db) {
+  const int current = schema_version(db);
+  const int latest = latest_schema_version();
+  if (current > latest) {
+    throw SchemaMigrationError("Database schema version " + std::to_string(current) +
+                               " is newer than this build supports (" + std::to_string(latest) +
+                               ")");
+  }
+  if (current == latest) {
+    return;
+  }
+
+  // Rebuilding a parent table with foreign keys on would cascade into its children; SQLite
+  // ignores this pragma inside a transaction, so it brackets all of them
+  db << "PRAGMA foreign_keys = OFF;";
+  try {
+    for (const Migration& migration : MIGRATIONS) {
+      if (migration.version <= current) {
+        continue;
+      }
+      Transaction tx(db, true);
+      migration.apply(db);
+      int violations = 0;
+      db << "SELECT COUNT(*) FROM pragma_foreign_key_check" >> violations;
+      if (violations > 0) {
+        log::warning() << violations << " rows violate foreign keys after schema "
+                       << "migration " << migration.version << " (" << migration.description << ").";
+      }
+      db << "PRAGMA user_version = " + std::to_string(migration.version) + ";";
+      tx.commit();
+    }
+  } catch (const sqlite::sqlite_exception& e) {
+    db << "PRAGMA foreign_keys = ON;";
+    throw SchemaMigrationError(std::string("Schema migration failed: ") + e.what() + " (" +
+                               e.get_sql() + ")");
+  } catch (...) {
+    db << "PRAGMA foreign_keys = ON;";
+    throw;
+  }
+  db << "PRAGMA foreign_keys = ON;";
+  if (current > 0) {
+    log::info() << "Migrated database schema from version " << current << " to " << latest << ".";
+  }
+}
+
+}  // namespace magic_core
@@ -0,0 +1,139 @@
+#include "magic_core/db/shard_map.hpp"
+
+#include <set>
+#include <utility>
+
+namespace magic_core {
+
+namespace {
+
+// FNV-1a: the same on every platform and build, unlike std::hash, so a path keeps its shard
+uint64_t stable_hash(const std::string &text) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : text) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+bool is_under(const std::string &path, const std::string &root) {
+  if (path.size() < root.size() || path.compare(0, root.size(), root) != 0) {
+    return false;
+  }
+  return path.size() == root.size() || path[root.size()] == '/' || root.empty() ||
+         root.back() == '/';
+}
+
+}  // namespace
+
+ShardingStrategy parse_sharding_strategy(const std::string &name) {
+  if (name == "folder") {
+    return ShardingStrategy::FolderRoot;
+  }
+  if (name == "hash") {
+    return ShardingStrategy::PathHash;
+  }
+  throw ShardMapError("Unknown sharding strategy: " + name);
+}
+
+ShardMap::ShardMap(size_t shard_count, ShardingStrategy strategy, std::vector<std::string> roots)
+    : shard_count_(shard_count), strategy_(strategy), roots_(std::move(roots)) {
+  if (shard_count_ == 0 || shard_count_ > MAX_SHARDS) {
+    throw ShardMapError("Shard count must be 1 to " + std::to_string(MAX_SHARDS) + ", not " +
+                        std::to_string(shard_count_));
+  }
+  for (auto &root : roots_) {
+    while (root.size() > 1 && root.back() == '/') {
+      root.pop_back();
+    }
+  }
+}
+
+ShardMap ShardMap::for_collections(const std::vector<Collection> &collections) {
+  if (collections.size() + 1 > MAX_SHARDS) {
+    throw ShardMapError("At most " + std::to_string(MAX_SHARDS - 1) + " collections, not " +
+                        std::to_string(collections.size()));
+  }
+  std::vector<std::string> names{DEFAULT_COLLECTION};
+  // The empty root is under every path, so whatever no collection claims lands in shard 0
+  std::vector<std::string> roots{""};
+  std::set<std::string> seen_names{DEFAULT_COLLECTION};
+  std::set<std::string> seen_roots;
+  for (const auto &collection : collections) {
+    if (collection.name.empty() || !seen_names.insert(collection.name).second) {
+      throw ShardMapError("Collection names must be unique and not empty or \"" +
+                          std::string(DEFAULT_COLLECTION) + "\": \"" + collection.name + "\"");
+    }
+    std::string root = collection.root;
+    while (root.size() > 1 && root.back() == '/') {
+      root.pop_back();
+    }
+    if (root.empty() || !seen_roots.insert(root).second) {
+      throw ShardMapError("Collection " + collection.name + " needs a root of its own");
+    }
+    names.push_back(collection.name);
+    roots.push_back(std::move(root));
+  }
+  ShardMap map(names.size(), ShardingStrategy::FolderRoot, std::move(roots));
+  map.names_ = std::move(names);
+  return map;
+}
+
+std::optional<size_t> ShardMap::collection_shard(const std::string &name) const {
+  for (size_t i = 0; i < names_.size(); ++i) {
+    if (names_[i] == name) {
+      return i;
+    }
+  }
+  return std::nullopt;
+}
+
+std::string ShardMap::collection_name(size_t shard) const {
+  return shard < names_.size() ? names_[shard] : std::string();
+}
+
+std::string ShardMap::collection_root(size_t shard) const {
+  return has_collections() && shard < roots_.size() ? roots_[shard] : std::string();
+}
+
+size_t ShardMap::shard_for_path(const std::string &path) const {
+  if (shard_count_ == 1) {
+    return 0;
+  }
+  if (strategy_ == ShardingStrategy::FolderRoot) {
+    size_t longest = 0;
+    size_t shard = shard_count_;
+    for (size_t i = 0; i < roots_.size(); ++i) {
+      if (is_under(path, roots_[i]) && (shard == shard_count_ || roots_[i].size() > longest)) {
+        longest = roots_[i].size();
+        shard = i % shard_count_;
+      }
+    }
+    if (shard < shard_count_) {
+      return shard;
+    }
+  }
+  return static_cast<size_t>(stable_hash(path) % shard_count_);
+}
+
+size_t ShardMap::shard_for_id(int64_t id) const {
+  if (id <= 0) {
+    return 0;
+  }
+  const auto shard = static_cast<size_t>((id - 1) / SHARD_ID_STRIDE);
+  // Ids past the last range can only be the last shard's
+  return shard < shard_count_ ? shard : shard_count_ - 1;
+}
+
+std::filesystem::path ShardMap::shard_db_path(const std::filesystem::path &db_path,
+                                              size_t shard) {
+  if (shard == 0) {
+    return db_path;
+  }
+  std::filesystem::path path = db_path;
+  path.replace_extension(".shard" + std::to_string(shard) + db_path.extension().string());
+  return path;
+}
+
+}  // namespace magic_core
@@ -0,0 +1,410 @@
+#include "magic_core/db/sharded_metadata_store.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "magic_core/async/work_stealing_executor.hpp"
+
+namespace magic_core {
+
+namespace {
+
+// fn(shard_index, store) for every included shard at once: the first on the calling thread,
+// the rest on executor, which the caller helps while it waits. Element i is shard i's answer,
+// left empty for a shard not included; the first exception thrown is rethrown once every
+// started shard has finished.
+template <typename Fn>
+auto fan_out(const std::vector<std::shared_ptr<MetadataStore>> &shards,
+             const std::vector<bool> &included,
+             async::WorkStealingExecutor *executor,
+             Fn &&fn) {
+  using Result = std::invoke_result_t<Fn &, size_t, MetadataStore &>;
+  std::vector<Result> results(shards.size());
+  std::optional<size_t> inline_shard;
+  std::optional<async::TaskGroup> group;
+  for (size_t i = 0; i < shards.size(); ++i) {
+    if (!included[i]) {
+      continue;
+    }
+    if (!inline_shard) {
+      inline_shard = i;
+      continue;
+    }
+    if (!group) {
+      group.emplace(*executor);
+    }
+    group->run([&results, &fn, &shards, i] { results[i] = fn(i, *shards[i]); });
+  }
+  if (inline_shard) {
+    results[*inline_shard] = fn(*inline_shard, *shards[*inline_shard]);
+  }
+  if (group) {
+    group->wait();
+  }
+  return results;
+}
+
+// The best k of every shard's best k. Each shard's list is already sorted by ascending
+// distance, so a heap over the lists' heads yields the merged order; ties keep shard order.
+template <typename Hit>
+std::vector<Hit> merge_top_k(std::vector<std::vector<Hit>> &&per_shard, int k) {
+  if (per_shard.size() == 1) {
+    return std::move(per_shard[0]);
+  }
+  struct Head {
+    float distance;
+    size_t list;
+    size_t index;
+  };
+  auto after = [](const Head &a, const Head &b) {
+    return a.distance != b.distance ? a.distance > b.distance : a.list > b.list;
+  };
+  std::priority_queue<Head, std::vector<Head>, decltype(after)> heads(after);
+  size_t total = 0;
+  for (size_t list = 0; list < per_shard.size(); ++list) {
+    if (!per_shard[list].empty()) {
+      heads.push({per_shard[list][0].distance, list, 0});
+      total += per_shard[list].size();
+    }
+  }
+  const size_t limit = k < 0 ? total : std::min(total, static_cast<size_t>(k));
+  std::vector<Hit> merged;
+  merged.reserve(limit);
+  while (merged.size() < limit) {
+    const Head head = heads.top();
+    heads.pop();
+    auto &hits = per_shard[head.list];
+    merged.push_back(std::move(hits[head.index]));
+    if (head.index + 1 < hits.size()) {
+      heads.push({hits[head.index + 1].distance, head.list, head.index + 1});
+    }
+  }
+  return merged;
+}
+
+// Element q merges every shard's answer to query q
+template <typename Hit>
+std::vector<std::vector<Hit>> merge_top_k_batch(
+    std::vector<std::vector<std::vector<Hit>>> &&per_shard, size_t queries, int k) {
+  std::vector<std::vector<Hit>> merged(queries);
+  for (size_t q = 0; q < queries; ++q) {
+    std::vector<std::vector<Hit>> answers;
+    answers.reserve(per_shard.size());
+    for (auto &shard : per_shard) {
+      answers.push_back(q < shard.size() ? std::move(shard[q]) : std::vector<Hit>{});
+    }
+    merged[q] = merge_top_k(std::move(answers), k);
+  }
+  return merged;
+}
+
+}  // namespace
+
+ShardedMetadataStore::ShardedMetadataStore(std::shared_ptr<MetadataStore> store)
+    : ShardedMetadataStore(ShardMap(), {std::move(store)}) {}
+
+ShardedMetadataStore::ShardedMetadataStore(ShardMap map,
+                                           std::vector<std::shared_ptr<MetadataStore>> shards)
+    : map_(std::move(map)), shards_(std::move(shards)), all_shards_(shards_.size(), true) {
+  if (shards_.size() != map_.shard_count()) {
+    throw ShardMapError("The shard map has " + std::to_string(map_.shard_count()) +
+                        " shards, not " + std::to_string(shards_.size()));
+  }
+  for (const auto &store : shards_) {
+    if (!store) {
+      throw ShardMapError("Every shard needs a metadata store");
+    }
+  }
+  if (shards_.size() > 1) {
+    // The calling thread takes one shard, so one thread fewer than shards never leaves one
+    // waiting
+    executor_ = std::make_unique<async::WorkStealingExecutor>(shards_.size() - 1);
+  }
+}
+
+ShardedMetadataStore::~ShardedMetadataStore() = default;
+
+std::vector<bool> ShardedMetadataStore::shards_for(const SearchFilter &filter) const {
+  if (filter.collections.empty()) {
+    return all_shards_;
+  }
+  std::vector<bool> included(shards_.size(), false);
+  for (const auto &name : filter.collections) {
+    std::optional<size_t> shard = map_.collection_shard(name);
+    if (!shard) {
+      throw std::invalid_argument("Unknown collection: " + name);
+    }
+    included[*shard] = true;
+  }
+  return included;
+}
+
+std::vector<bool> ShardedMetadataStore::shards_with_work(
+    const std::vector<std::vector<int>> &split) const {
+  std::vector<bool> included(split.size());
+  for (size_t shard = 0; shard < split.size(); ++shard) {
+    included[shard] = !split[shard].empty();
+  }
+  return included;
+}
+
+std::vector<bool> ShardedMetadataStore::shards_with_work(
+    const std::vector<std::vector<std::vector<int>>> &split) const {
+  std::vector<bool> included(split.size(), false);
+  for (size_t shard = 0; shard < split.size(); ++shard) {
+    for (const auto &ids : split[shard]) {
+      if (!ids.empty()) {
+        included[shard] = true;
+        break;
+      }
+    }
+  }
+  return included;
+}
+
+std::vector<std::vector<int>> ShardedMetadataStore::split_by_shard(
+    const std::vector<int> &file_ids) const {
+  std::vector<std::vector<int>> split(shards_.size());
+  if (shards_.size() == 1) {
+    split[0] = file_ids;
+    return split;
+  }
+  for (int id : file_ids) {
+    split[map_.shard_for_id(id)].push_back(id);
+  }
+  return split;
+}
+
+std::vector<std::vector<std::vector<int>>> ShardedMetadataStore::split_by_shard(
+    const std::vector<std::vector<int>> &file_ids) const {
+  std::vector<std::vector<std::vector<int>>> split(
+      shards_.size(), std::vector<std::vector<int>>(file_ids.size()));
+  for (size_t q = 0; q < file_ids.size(); ++q) {
+    auto per_shard = split_by_shard(file_ids[q]);
+    for (size_t s = 0; s < shards_.size(); ++s) {
+      split[s][q] = std::move(per_shard[s]);
+    }
+  }
+  return split;
+}
+
+uint64_t ShardedMetadataStore::search_generation() const {
+  uint64_t generation = 0;
+  for (const auto &store : shards_) {
+    generation += store->search_generation();
+  }
+  return generation;
+}
+
+std::vector<CollectionInfo> ShardedMetadataStore::collections() const {
+  std::vector<CollectionInfo> infos;
+  if (!map_.has_collections()) {
+    return infos;
+  }
+  infos.reserve(shards_.size());
+  for (size_t shard = 0; shard < shards_.size(); ++shard) {
+    const auto &store = *shards_[shard];
+    infos.push_back({map_.collection_name(shard), map_.collection_root(shard),
+                     store.file_index_stats(), store.chunk_index_stats(), store.bulk_loading()});
+  }
+  return infos;
+}
+
+std::vector<FileSearchResult> ShardedMetadataStore::search_similar_files(
+    const std::vector<float> &query_vector,
+    int k,
+    const VectorSearchOptions &tuning,
+    const SearchFilter &filter) {
+  return merge_top_k(fan_out(shards_, shards_for(filter), executor_.get(),
+                             [&](size_t, MetadataStore &store) {
+                               return store.search_similar_files(query_vector, k, tuning, filter);
+                             }),
+                     k);
+}
+
+std::vector<std::vector<FileSearchResult>> ShardedMetadataStore::search_similar_files_batch(
+    const std::vector<std::vector<float>> &query_vectors,
+    int k,
+    const VectorSearchOptions &tuning,
+    const SearchFilter &filter) {
+  return merge_top_k_batch(fan_out(shards_, shards_for(filter), executor_.get(),
+                                   [&](size_t, MetadataStore &store) {
+                                     return store.search_similar_files_batch(query_vectors, k,
+                                                                             tuning, filter);
+                                   }),
+                           query_vectors.size(), k);
+}
+
+std::vector<ChunkSearchResult> ShardedMetadataStore::search_similar_chunks(
+    const std::vector<int> &file_ids,
+    const std::vector<float> &query_vector,
+    int k,
+    const VectorSearchOptions &tuning,
+    bool with_content) {
+  const auto split = split_by_shard(file_ids);
+  return merge_top_k(fan_out(shards_, shards_with_work(split), executor_.get(),
+                             [&](size_t shard, MetadataStore &store) {
+                               return store.search_similar_chunks(split[shard], query_vector, k,
+                                                                  tuning, with_content);
+                             }),
+                     k);
+}
+
+std::vector<std::vector<ChunkSearchResult>> ShardedMetadataStore::search_similar_chunks_batch(
+    const std::vector<std::vector<int>> &file_ids,
+    const std::vector<std::vector<float>> &query_vectors,
+    int k,
+    const VectorSearchOptions &tuning,
+    bool with_content) {
+  const auto split = split_by_shard(file_ids);
+  return merge_top_k_batch(
+      fan_out(shards_, shards_with_work(split), executor_.get(),
+              [&](size_t shard, MetadataStore &store) {
+                return store.search_similar_chunks_batch(split[shard], query_vectors, k, tuning,
+                                                         with_content);
+              }),
+      query_vectors.size(), k);
+}
+
+std::vector<ChunkSearchResult> ShardedMetadataStore::scan_similar_chunks(
+    const std::vector<int> &file_ids,
+    const std::vector<float> &query_vector,
+    int k,
+    bool with_content) {
+  const auto split = split_by_shard(file_ids);
+  return merge_top_k(fan_out(shards_, shards_with_work(split), executor_.get(),
+                             [&](size_t shard, MetadataStore &store) {
+                               return store.scan_similar_chunks(split[shard], query_vector, k,
+                                                                with_content);
+                             }),
+                     k);
+}
+
+std::vector<std::vector<ChunkSearchResult>> ShardedMetadataStore::scan_similar_chunks_batch(
+    const std::vector<std::vector<int>> &file_ids,
+    const std::vector<std::vector<float>> &query_vectors,
+    int k,
+    bool with_content) {
+  const auto split = split_by_shard(file_ids);
+  return merge_top_k_batch(
+      fan_out(shards_, shards_with_work(split), executor_.get(),
+              [&](size_t shard, MetadataStore &store) {
+                return store.scan_similar_chunks_batch(split[shard], query_vectors, k,
+                                                       with_content);
+              }),
+      query_vectors.size(), k);
+}
+
+std::vector<ChunkSearchResult> ShardedMetadataStore::search_chunks_lexical(
+    const std::string &query, int k, bool with_content, const SearchFilter &filter) {
+  // bm25() scores compare across shards only roughly: each shard weighs terms by its own
+  // document frequencies
+  return merge_top_k(fan_out(shards_, shards_for(filter), executor_.get(),
+                             [&](size_t, MetadataStore &store) {
+                               return store.search_chunks_lexical(query, k, with_content, filter);
+                             }),
+                     k);
+}
+
+std::vector<FileSearchResult> ShardedMetadataStore::get_file_search_results(
+    const std::vector<SearchResult> &hits) {
+  if (shards_.size() == 1) {
+    return shards_[0]->get_file_search_results(hits);
+  }
+  std::vector<std::vector<SearchResult>> split(shards_.size());
+  std::vector<bool> included(shards_.size(), false);
+  for (const auto &hit : hits) {
+    const size_t shard = map_.shard_for_id(hit.id);
+    split[shard].push_back(hit);
+    included[shard] = true;
+  }
+  auto found = fan_out(shards_, included, executor_.get(), [&](size_t shard, MetadataStore &store) {
+    return store.get_file_search_results(split[shard]);
+  });
+  // Each shard answers in the order it was asked and drops ids it has no row for
+  std::vector<size_t> next(shards_.size(), 0);
+  std::vector<FileSearchResult> results;
+  results.reserve(hits.size());
+  for (const auto &hit : hits) {
+    const size_t shard = map_.shard_for_id(hit.id);
+    if (next[shard] < found[shard].size() && found[shard][next[shard]].id == hit.id) {
+      results.push_back(std::move(found[shard][next[shard]++]));
+    }
+  }
+  return results;
+}
+
+std::optional<ChunkMetadata> ShardedMetadataStore::get_chunk(int chunk_id) {
+  return for_id(chunk_id).get_chunk(chunk_id);
+}
+
+std::vector<CompressionDictionary> ShardedMetadataStore::get_compression_dictionaries() {
+  std::vector<CompressionDictionary> dictionaries;
+  for (const auto &store : shards_) {
+    auto stored = store->get_compression_dictionaries();
+    dictionaries.insert(dictionaries.end(), std::make_move_iterator(stored.begin()),
+                        std::make_move_iterator(stored.end()));
+  }
+  return dictionaries;
+}
+
+std::optional<FileMetadata> ShardedMetadataStore::get_file_metadata(const std::string &path) {
+  return for_path(path).get_file_metadata(path);
+}
+
+void ShardedMetadataStore::delete_file_metadata(const std::string &path) {
+  for_path(path).delete_file_metadata(path);
+}
+
+size_t ShardedMetadataStore::delete_files_under(const std::string &directory) {
+  size_t deleted = 0;
+  for (size_t count : fan_out(shards_, all_shards_, executor_.get(),
+                              [&](size_t, MetadataStore &store) {
+                                return store.delete_files_under(directory);
+                              })) {
+    deleted += count;
+  }
+  return deleted;
+}
+
+std::vector<FileMetadata> ShardedMetadataStore::list_all_files() {
+  std::vector<FileMetadata> files;
+  for (const auto &store : shards_) {
+    auto stored = store->list_all_files();
+    files.insert(files.end(), std::make_move_iterator(stored.begin()),
+                 std::make_move_iterator(stored.end()));
+  }
+  return files;
+}
+
+std::vector<BasicFileMetadata> ShardedMetadataStore::list_files_page(int64_t after_id,
+                                                                     int limit) {
+  std::vector<BasicFileMetadata> page;
+  for (size_t shard = map_.shard_for_id(after_id + 1);
+       shard < shards_.size() && static_cast<int>(page.size()) < limit; ++shard) {
+    auto files = shards_[shard]->list_files_page(after_id, limit - static_cast<int>(page.size()));
+    page.insert(page.end(), std::make_move_iterator(files.begin()),
+                std::make_move_iterator(files.end()));
+  }
+  return page;
+}
+
+bool ShardedMetadataStore::begin_bulk_load() {
+  bool opened = false;
+  for (const auto &store : shards_) {
+    opened = store->begin_bulk_load() || opened;
+  }
+  return opened;
+}
+
+void ShardedMetadataStore::persist_faiss_index() {
+  for (const auto &store : shards_) {
+    store->persist_faiss_index();
+  }
+}
+
+}  // namespace magic_core
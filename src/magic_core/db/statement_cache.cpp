@@ -0,0 +1,21 @@
+#include "magic_core/db/statement_cache.hpp"
+
+namespace magic_core {
+
+sqlite::database_binder& StatementCache::get(sqlite::database& db, const std::string& sql) {
+  auto it = statements_.find(sql);
+  if (it == statements_.end()) {
+    if (statements_.size() >= MAX_STATEMENTS) {
+      statements_.clear();
+    }
+    it = statements_.emplace(sql, std::make_unique<sqlite::database_binder>(db << sql)).first;
+  } else {
+    // Drops bindings and finishes any step left behind by a query whose callback threw
+    it->second->reset();
+  }
+  // A binder that was never run executes itself on destruction; cached ones must not
+  it->second->used(true);
+  return *it->second;
+}
+
+}  // namespace magic_core
@@ -2,16 +2,92 @@
 
 #include <sqlite_modern_cpp.h>
 
+#include <algorithm>
 #include <ctime>
 #include <iomanip>
+#include <random>
 #include <sstream>
+#include <unordered_map>
 
+#include "magic_core/db/epoch_millis.hpp"
 #include "magic_core/db/pooled_connection.hpp"
 #include "magic_core/db/sqlite_error_utils.hpp"
-#include "magic_core/db/transaction.hpp"
+#include "magic_core/types/logger.hpp"
 
 namespace magic_core {
 
+// A path has at most one pending task of a type (schema version 13): queueing another returns
+// the pending one, which keeps its place in the queue and takes the more urgent priority. The
+// conflict target must match the unique index's WHERE clause word for word.
+static constexpr const char* INSERT_TASK_SQL =
+    "INSERT INTO task_queue (task_type, target_path, priority, created_at, updated_at) "
+    "VALUES (?,?,?,?,?) ON CONFLICT (task_type, target_path) "
+    "WHERE status = 'PENDING' AND target_path IS NOT NULL DO UPDATE SET "
+    "priority = MIN(priority, excluded.priority), updated_at = excluded.updated_at RETURNING id";
+// The same, where the newest request's tag wins (e.g. SUMMARIZE_FILE's content hash)
+static constexpr const char* INSERT_TAGGED_FILE_TASK_SQL =
+    "INSERT INTO task_queue (task_type, target_path, target_tag, priority, created_at, "
+    "updated_at) VALUES (?,?,?,?,?,?) ON CONFLICT (task_type, target_path) "
+    "WHERE status = 'PENDING' AND target_path IS NOT NULL DO UPDATE SET "
+    "priority = MIN(priority, excluded.priority), target_tag = excluded.target_tag, "
+    "updated_at = excluded.updated_at RETURNING id";
+
+// A task on the same path and of the same type queued or claimed after task ?
+static constexpr const char* SUPERSEDING_TASK_SQL =
+    "SELECT n.id FROM task_queue t JOIN task_queue n ON n.task_type = t.task_type AND "
+    "n.target_path = t.target_path WHERE t.id = ? AND t.target_path IS NOT NULL AND "
+    "n.target_path IS NOT NULL AND n.id > t.id ORDER BY n.id DESC LIMIT 1";
+
+static constexpr const char* SUPERSEDED_MESSAGE =
+    "Superseded by a task queued for the same path since";
+
+// Claim order: one priority level is worth a minute of waiting. Must match the expression of
+// the aged priority indexes (schema versions 5 and 12) for the claim query to use them.
+static constexpr int64_t AGING_MILLIS_PER_PRIORITY = 60000;
+static constexpr const char* AGED_PRIORITY_SQL = "priority * 60000 + created_at";
+
+// The generation lane's tasks, and everything else. Each must match the WHERE clause of its
+// partial index (schema version 12) for claims to use that index.
+static constexpr const char* GENERATION_TASKS_SQL = " AND task_type = 'SUMMARIZE_FILE'";
+static constexpr const char* EMBEDDING_TASKS_SQL = " AND task_type != 'SUMMARIZE_FILE'";
+
+static std::string lane_condition(TaskLane lane) {
+  switch (lane) {
+    case TaskLane::Interactive:
+      return EMBEDDING_TASKS_SQL + std::string(" AND priority <= ") +
+             std::to_string(TaskPriority::NORMAL);
+    case TaskLane::Bulk:
+      return EMBEDDING_TASKS_SQL + std::string(" AND priority > ") +
+             std::to_string(TaskPriority::NORMAL);
+    case TaskLane::Generation:
+      return GENERATION_TASKS_SQL;
+    case TaskLane::Any:
+      break;
+  }
+  return EMBEDDING_TASKS_SQL;
+}
+
+static void write_progress(PooledDatabase& conn, const TaskQueueRepo::ProgressRecord& progress) {
+  auto& upsert = conn.prepare(
+      "INSERT INTO task_progress (task_id, progress_percent, status_message, updated_at) "
+      "VALUES (?,?,?,?) "
+      "ON CONFLICT(task_id) DO UPDATE SET "
+      "progress_percent = excluded.progress_percent, "
+      "status_message = excluded.status_message, "
+      "updated_at = excluded.updated_at");
+  upsert << progress.task_id << progress.percent << progress.message << progress.updated_at;
+  upsert.execute();
+}
+
+// Random, so claims of a restarted process never pass for those of the one that died
+static std::string make_instance_id() {
+  std::random_device rd;
+  std::uniform_int_distribution<uint64_t> dist;
+  std::stringstream ss;
+  ss << std::hex << std::setw(16) << std::setfill('0') << dist(rd);
+  return ss.str();
+}
+
 static std::string format_time(const std::chrono::system_clock::time_point& tp) {
   auto time_t = std::chrono::system_clock::to_time_t(tp);
   std::stringstream ss;
@@ -19,125 +95,488 @@ static std::string format_time(const std::chrono::system_clock::time_point& tp)
   return ss.str();
 }
 
-static std::chrono::system_clock::time_point parse_time(const std::string& time_str) {
-  std::tm tm_struct = {};
-  std::stringstream ss(time_str);
-  ss >> std::get_time(&tm_struct, "%Y-%m-%d %H:%M:%S");
-  return std::chrono::system_clock::from_time_t(timegm(&tm_struct));
-}
+struct TaskQueueRepo::ProgressTable {
+  struct Entry {
+    ProgressRecord progress;
+    std::chrono::steady_clock::time_point last_flush{};
+    // progress has changed since it was last written
+    bool dirty = false;
+    // A flush for this task is waiting on the writer; it writes whatever is latest by then
+    bool flush_queued = false;
+  };
+
+  std::mutex mutex;
+  std::unordered_map<long long, Entry> entries;
+};
 
-TaskQueueRepo::TaskQueueRepo(DatabaseManager& db_manager) : db_manager_(db_manager) {}
+TaskQueueRepo::TaskQueueRepo(DatabaseManager& db_manager,
+                             std::chrono::milliseconds progress_flush_interval,
+                             std::chrono::milliseconds lease_duration)
+    : db_manager_(db_manager),
+      progress_(std::make_shared<ProgressTable>()),
+      progress_flush_interval_(progress_flush_interval),
+      lease_duration_(lease_duration),
+      instance_id_(make_instance_id()) {}
 
 std::string TaskQueueRepo::time_point_to_string(const std::chrono::system_clock::time_point& tp) {
   return format_time(tp);
 }
-std::chrono::system_clock::time_point TaskQueueRepo::string_to_time_point(
-    const std::string& time_str) {
-  return parse_time(time_str);
+
+TaskProgressDTO TaskQueueRepo::to_dto(const ProgressRecord& progress) {
+  return TaskProgressDTO{progress.task_id, progress.percent, progress.message,
+                         time_point_to_string(from_epoch_millis(progress.updated_at))};
 }
 
 long long TaskQueueRepo::create_file_process_task(const std::string& task_type,
                                      const std::string& target_path,
                                      int priority) {
-  PooledConnection conn(db_manager_);
+  long long task_id = -1;
   try {
     auto now = std::chrono::system_clock::now();
-    std::string created_at_str = time_point_to_string(now);
-    std::string updated_at_str = created_at_str;
-    *conn
-        << "INSERT INTO task_queue (task_type, target_path, priority, created_at, updated_at) VALUES "
-           "(?,?,?,?,?)"
-        << task_type << target_path << priority << created_at_str << updated_at_str;
-    return static_cast<long long>(conn->last_insert_rowid());
+    int64_t created_at = to_epoch_millis(now);
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      conn.prepare(INSERT_TASK_SQL) << task_type << target_path << priority << created_at
+                                    << created_at >>
+          task_id;
+    });
   } catch (const sqlite::sqlite_exception& e) {
     throw TaskQueueRepoError(format_db_error("create_task", e));
   }
+  // Notify once the task is committed, so the woken worker can claim it
+  notify_task_created();
+  return task_id;
+}
+
+long long TaskQueueRepo::create_tagged_task(const std::string& task_type,
+                                            const std::string& target_tag,
+                                            int priority) {
+  long long task_id = -1;
+  try {
+    int64_t created_at = to_epoch_millis(std::chrono::system_clock::now());
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      auto& insert = conn.prepare(
+          "INSERT INTO task_queue (task_type, target_tag, priority, created_at, updated_at) "
+          "VALUES (?,?,?,?,?)");
+      insert << task_type << target_tag << priority << created_at << created_at;
+      insert.execute();
+      task_id = static_cast<long long>(conn.db.last_insert_rowid());
+    });
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error("create_tagged_task", e));
+  }
+  notify_task_created();
+  return task_id;
+}
+
+/*
+Queues one task per path in a single transaction.
+
+@returns the task ids, in the same order as the paths
+*/
+std::vector<long long> TaskQueueRepo::create_file_process_tasks(
+    const std::string& task_type, const std::vector<std::string>& target_paths, int priority) {
+  std::vector<long long> task_ids;
+  if (target_paths.empty()) {
+    return task_ids;
+  }
+  task_ids.reserve(target_paths.size());
+  try {
+    int64_t created_at = to_epoch_millis(std::chrono::system_clock::now());
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      // A path listed twice gets the same task both times
+      for (const auto& target_path : target_paths) {
+        long long task_id = -1;
+        conn.prepare(INSERT_TASK_SQL) << task_type << target_path << priority << created_at
+                                      << created_at >>
+            task_id;
+        task_ids.push_back(task_id);
+      }
+    });
+  } catch (const sqlite::sqlite_exception& e) {
+    task_ids.clear();
+    throw TaskQueueRepoError(format_db_error("create_tasks", e));
+  }
+  // One notification per task, so a large batch wakes as many idle workers as it can keep busy
+  for (size_t i = 0; i < task_ids.size(); ++i) {
+    notify_task_created();
+  }
+  return task_ids;
+}
+
+void TaskQueueRepo::set_task_created_listener(std::function<void()> listener) {
+  std::lock_guard<std::mutex> lock(listener_mutex_);
+  task_created_listener_ = std::move(listener);
+}
+
+void TaskQueueRepo::notify_task_created() {
+  std::lock_guard<std::mutex> lock(listener_mutex_);
+  if (task_created_listener_) {
+    task_created_listener_();
+  }
+}
+
+void TaskQueueRepo::set_task_update_listener(std::function<void(const TaskUpdate&)> listener) {
+  std::lock_guard<std::mutex> lock(listener_mutex_);
+  task_update_listener_ = std::move(listener);
+}
+
+void TaskQueueRepo::notify_task_updated(const TaskUpdate& update) {
+  std::lock_guard<std::mutex> lock(listener_mutex_);
+  if (task_update_listener_) {
+    task_update_listener_(update);
+  }
+}
+
+long long TaskQueueRepo::create_tagged_file_task(const std::string& task_type,
+                                                 const std::string& file_path,
+                                                 const std::string& target_tag,
+                                                 int priority) {
+  long long task_id = -1;
+  try {
+    int64_t created_at = to_epoch_millis(std::chrono::system_clock::now());
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      conn.prepare(INSERT_TAGGED_FILE_TASK_SQL) << task_type << file_path << target_tag
+                                                << priority << created_at << created_at >>
+          task_id;
+    });
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error("create_tagged_file_task", e));
+  }
+  notify_task_created();
+  return task_id;
+}
+
+std::optional<TaskDTO> TaskQueueRepo::fetch_and_claim_next_task(TaskLane lane,
+                                                                const std::string& lease_owner) {
+  std::vector<TaskDTO> claimed = fetch_and_claim_tasks(1, lane, lease_owner);
+  if (claimed.empty()) {
+    return std::nullopt;
+  }
+  return std::move(claimed.front());
 }
 
-std::optional<TaskDTO> TaskQueueRepo::fetch_and_claim_next_task() {
-  std::optional<TaskDTO> result;
+/*
+Claims up to max_tasks pending tasks in a single UPDATE ... RETURNING statement, so draining a
+backlog takes one write lock per batch instead of a BEGIN IMMEDIATE + SELECT + UPDATE per task.
+
+Tasks are taken in aged priority order, so bulk work that has waited long enough is claimed
+ahead of newer interactive tasks. lane restricts the claim to one priority band.
+
+@returns the claimed tasks in queue order (aged priority, then id)
+*/
+std::vector<TaskDTO> TaskQueueRepo::fetch_and_claim_tasks(int max_tasks,
+                                                         TaskLane lane,
+                                                         const std::string& lease_owner) {
+  std::vector<TaskDTO> claimed;
+  if (max_tasks <= 0) {
+    return claimed;
+  }
+  {
+    const auto now = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(reclaim_mutex_, std::try_to_lock);
+    if (lock.owns_lock() && (last_reclaim_ == std::chrono::steady_clock::time_point{} ||
+                             now - last_reclaim_ >= lease_duration_ / 2)) {
+      last_reclaim_ = now;
+      lock.unlock();
+      try {
+        reclaim_expired_leases();
+      } catch (const TaskQueueRepoError& e) {
+        log::warning() << e.what();
+      }
+    }
+  }
   try {
-    PooledConnection conn(db_manager_);
-    Transaction tx(*conn, true);
+    auto now = std::chrono::system_clock::now();
+    int64_t updated_at_ms = to_epoch_millis(now);
+    int64_t lease_expires_at = to_epoch_millis(now + lease_duration_);
+    const std::string& owner = lease_owner.empty() ? instance_id_ : lease_owner;
+    std::string processing_status = to_string(TaskStatus::PROCESSING);
     std::string pending_status = to_string(TaskStatus::PENDING);
-    *conn << "SELECT id, task_type, status, priority, error_message, created_at, "
-             "updated_at, target_path, target_tag, payload FROM task_queue WHERE status = ? ORDER "
-             "BY priority ASC, created_at ASC "
-             "LIMIT 1"
-          << pending_status >>
-        [&](long long id, std::string task_type, std::string status_db, int priority,
-            std::optional<std::string> error_message, std::string created_at,
-            std::string updated_at, std::string target_path, std::string target_tag,
-            std::string payload) {
-          TaskDTO task;
-          task.id = id;
-          task.task_type = task_type;
-          task.target_path = target_path;
-          task.target_tag = target_tag;
-          task.payload = payload;
-          task.status = task_status_from_string(status_db);
-          task.priority = priority;
-          if (error_message)
-            task.error_message = *error_message;
-          task.created_at = string_to_time_point(created_at);
-          task.updated_at = string_to_time_point(updated_at);
-          result = std::move(task);
-        };
+    const std::string sql =
+        std::string("UPDATE task_queue SET status = ?, updated_at = ?, lease_owner = ?, "
+                    "lease_expires_at = ?, attempts = attempts + 1 WHERE id IN (SELECT id FROM "
+                    "task_queue WHERE status = ?") +
+        lane_condition(lane) + " ORDER BY " + AGED_PRIORITY_SQL +
+        " ASC LIMIT ?) RETURNING id, task_type, status, priority, error_message, created_at, "
+        "updated_at, target_path, target_tag, payload, lease_owner, attempts";
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      conn.prepare(sql) << processing_status << updated_at_ms << owner << lease_expires_at
+                        << pending_status << max_tasks >>
+          [&](long long id, std::string task_type, std::string status_db, int priority,
+              std::optional<std::string> error_message, int64_t created_at,
+              int64_t updated_at, std::string target_path, std::string target_tag,
+              std::string payload, std::optional<std::string> leased_to, int attempts) {
+            TaskDTO task;
+            task.id = id;
+            task.task_type = task_type;
+            task.target_path = target_path;
+            task.target_tag = target_tag;
+            task.payload = payload;
+            task.status = task_status_from_string(status_db);
+            task.priority = priority;
+            if (error_message)
+              task.error_message = *error_message;
+            task.created_at = from_epoch_millis(created_at);
+            task.updated_at = from_epoch_millis(updated_at);
+            task.lease_owner = leased_to;
+            task.attempts = attempts;
+            claimed.push_back(std::move(task));
+          };
+    });
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error("fetch_and_claim_tasks", e));
+  }
 
-    if (result) {
-      auto now = std::chrono::system_clock::now();
-      std::string updated_at_str = time_point_to_string(now);
-      std::string processing_status = to_string(TaskStatus::PROCESSING);
-      *conn << "UPDATE task_queue SET status = ?, updated_at = ? WHERE id = ?" << processing_status
-            << updated_at_str << result->id;
-      result->status = TaskStatus::PROCESSING;
-      result->updated_at = now;
+  // RETURNING does not preserve the subquery's order
+  auto aged_priority = [](const TaskDTO& task) {
+    return task.priority * AGING_MILLIS_PER_PRIORITY + to_epoch_millis(task.created_at);
+  };
+  std::sort(claimed.begin(), claimed.end(), [&](const TaskDTO& a, const TaskDTO& b) {
+    if (aged_priority(a) != aged_priority(b)) {
+      return aged_priority(a) < aged_priority(b);
     }
-    tx.commit();
-    return result;
+    return a.id < b.id;
+  });
+  return claimed;
+}
+
+void TaskQueueRepo::release_claimed_tasks(const std::vector<long long>& task_ids) {
+  if (task_ids.empty()) {
+    return;
+  }
+  try {
+    auto now = std::chrono::system_clock::now();
+    int64_t updated_at_ms = to_epoch_millis(now);
+    std::string pending_status = to_string(TaskStatus::PENDING);
+    std::string processing_status = to_string(TaskStatus::PROCESSING);
+    std::string completed_status = to_string(TaskStatus::COMPLETED);
+    std::vector<long long> superseded;
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      superseded.clear();
+      for (long long task_id : task_ids) {
+        // An attempt that never started does not count against the task
+        auto& release = conn.prepare(
+            "UPDATE OR IGNORE task_queue SET status = ?, updated_at = ?, lease_owner = NULL, "
+            "lease_expires_at = NULL, attempts = MAX(attempts - 1, 0) "
+            "WHERE id = ? AND status = ?");
+        release << pending_status << updated_at_ms << task_id << processing_status;
+        release.execute();
+        // Still claimed: its path was queued again meanwhile, and that task does the work
+        conn.prepare("UPDATE task_queue SET status = ?, updated_at = ?, lease_owner = NULL, "
+                     "lease_expires_at = NULL WHERE id = ? AND status = ? RETURNING id")
+                << completed_status << updated_at_ms << task_id << processing_status >>
+            [&](long long id) { superseded.push_back(id); };
+      }
+    });
+    notify_released(superseded, TaskStatus::COMPLETED, SUPERSEDED_MESSAGE);
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error("release_claimed_tasks", e));
+  }
+}
+
+void TaskQueueRepo::notify_released(const std::vector<long long>& task_ids,
+                                    TaskStatus status,
+                                    const std::string& message) {
+  for (long long task_id : task_ids) {
+    // The claim's progress went stale with it, so it is dropped rather than written
+    float last_percent = 0.0f;
+    take_unflushed_progress(task_id, &last_percent);
+    notify_task_updated({task_id, status, status == TaskStatus::PENDING ? 0.0f : last_percent,
+                         message});
+  }
+}
+
+bool TaskQueueRepo::renew_lease(long long task_id, const std::string& lease_owner) {
+  try {
+    int64_t lease_expires_at = to_epoch_millis(std::chrono::system_clock::now() + lease_duration_);
+    std::string processing_status = to_string(TaskStatus::PROCESSING);
+    bool renewed = false;
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      conn.prepare("UPDATE task_queue SET lease_expires_at = ? "
+                   "WHERE id = ? AND status = ? AND lease_owner = ? RETURNING id")
+              << lease_expires_at << task_id << processing_status << lease_owner >>
+          [&](long long) { renewed = true; };
+    });
+    return renewed;
   } catch (const sqlite::sqlite_exception& e) {
-    throw TaskQueueRepoError(format_db_error("fetch_and_claim_next_task", e));
+    throw TaskQueueRepoError(format_db_error("renew_lease", e));
   }
 }
 
-void TaskQueueRepo::update_task_status(long long task_id, TaskStatus new_status) {
+size_t TaskQueueRepo::reclaim_expired_leases() {
+  try {
+    int64_t now_ms = to_epoch_millis(std::chrono::system_clock::now());
+    std::string processing_status = to_string(TaskStatus::PROCESSING);
+    std::string pending_status = to_string(TaskStatus::PENDING);
+    std::string failed_status = to_string(TaskStatus::FAILED);
+    std::string completed_status = to_string(TaskStatus::COMPLETED);
+    const std::string gave_up = "Lease expired " + std::to_string(MAX_TASK_ATTEMPTS) +
+                                " times; its worker keeps dying on this task";
+    std::vector<long long> failed;
+    std::vector<long long> requeued;
+    std::vector<long long> superseded;
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      failed.clear();
+      requeued.clear();
+      superseded.clear();
+      conn.prepare("UPDATE task_queue SET status = ?, error_message = ?, updated_at = ?, "
+                   "lease_owner = NULL, lease_expires_at = NULL "
+                   "WHERE status = ? AND lease_expires_at < ? AND attempts >= ? RETURNING id")
+              << failed_status << gave_up << now_ms << processing_status << now_ms
+              << MAX_TASK_ATTEMPTS >>
+          [&](long long id) { failed.push_back(id); };
+      conn.prepare("UPDATE OR IGNORE task_queue SET status = ?, updated_at = ?, "
+                   "lease_owner = NULL, lease_expires_at = NULL "
+                   "WHERE status = ? AND lease_expires_at < ? RETURNING id")
+              << pending_status << now_ms << processing_status << now_ms >>
+          [&](long long id) { requeued.push_back(id); };
+      // Left over where the path already has a pending task, which supersedes them
+      conn.prepare("UPDATE task_queue SET status = ?, updated_at = ?, lease_owner = NULL, "
+                   "lease_expires_at = NULL WHERE status = ? AND lease_expires_at < ? "
+                   "RETURNING id")
+              << completed_status << now_ms << processing_status << now_ms >>
+          [&](long long id) { superseded.push_back(id); };
+    });
+    notify_released(failed, TaskStatus::FAILED, gave_up);
+    notify_released(requeued, TaskStatus::PENDING, "Lease expired; queued again");
+    notify_released(superseded, TaskStatus::COMPLETED, SUPERSEDED_MESSAGE);
+    const size_t reclaimed = failed.size() + requeued.size() + superseded.size();
+    if (reclaimed > 0) {
+      log::Line line = log::warning();
+      line << "Reclaimed " << requeued.size() << " tasks with expired leases";
+      if (!failed.empty()) {
+        line << " and failed " << failed.size() << " that ran out of attempts";
+      }
+      if (!superseded.empty()) {
+        line << "; " << superseded.size() << " were superseded by tasks queued since";
+      }
+      line << ".";
+    }
+    return reclaimed;
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error("reclaim_expired_leases", e));
+  }
+}
+
+std::optional<TaskQueueRepo::ProgressRecord> TaskQueueRepo::take_unflushed_progress(
+    long long task_id, float* last_percent) {
+  std::lock_guard<std::mutex> lock(progress_->mutex);
+  auto it = progress_->entries.find(task_id);
+  if (last_percent) {
+    *last_percent = it == progress_->entries.end() ? 0.0f : it->second.progress.percent;
+  }
+  if (it == progress_->entries.end()) {
+    return std::nullopt;
+  }
+  std::optional<ProgressRecord> unflushed;
+  if (it->second.dirty) {
+    unflushed = std::move(it->second.progress);
+  }
+  // A queued flush finds no entry and does nothing
+  progress_->entries.erase(it);
+  return unflushed;
+}
+
+bool TaskQueueRepo::update_task_status(long long task_id,
+                                       TaskStatus new_status,
+                                       const std::string& lease_owner) {
+  float last_percent = 0.0f;
+  bool updated = false;
   try {
-    PooledConnection conn(db_manager_);
     auto now = std::chrono::system_clock::now();
-    std::string updated_at_str = time_point_to_string(now);
+    int64_t updated_at_ms = to_epoch_millis(now);
     std::string status_str = to_string(new_status);
-    *conn << "UPDATE task_queue SET status = ?, updated_at = ? WHERE id = ?" << status_str
-          << updated_at_str << task_id;
+    std::optional<ProgressRecord> final_progress = take_unflushed_progress(task_id, &last_percent);
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      updated = false;
+      if (lease_owner.empty()) {
+        conn.prepare("UPDATE task_queue SET status = ?, updated_at = ?, lease_owner = NULL, "
+                     "lease_expires_at = NULL WHERE id = ? RETURNING id")
+                << status_str << updated_at_ms << task_id >>
+            [&](long long) { updated = true; };
+      } else {
+        conn.prepare("UPDATE task_queue SET status = ?, updated_at = ?, lease_owner = NULL, "
+                     "lease_expires_at = NULL "
+                     "WHERE id = ? AND status = ? AND lease_owner = ? RETURNING id")
+                << status_str << updated_at_ms << task_id << to_string(TaskStatus::PROCESSING)
+                << lease_owner >>
+            [&](long long) { updated = true; };
+      }
+      // A stale claimant's progress must not overwrite the new one's
+      if (updated && final_progress) {
+        write_progress(conn, *final_progress);
+      }
+    });
   } catch (const sqlite::sqlite_exception& e) {
     throw TaskQueueRepoError(format_db_error("update_task_status", e));
   }
+  if (updated) {
+    notify_task_updated({task_id, new_status, last_percent, {}});
+  }
+  return updated;
+}
+
+void TaskQueueRepo::complete_task_in_copy(sqlite::database& copy, long long task_id) {
+  try {
+    copy << "UPDATE task_queue SET status = ?, updated_at = ?, lease_owner = NULL, "
+            "lease_expires_at = NULL WHERE id = ?"
+         << to_string(TaskStatus::COMPLETED) << to_epoch_millis(std::chrono::system_clock::now())
+         << task_id;
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error("complete_task_in_copy", e));
+  }
 }
 
-void TaskQueueRepo::mark_task_as_failed(long long task_id, const std::string& error_message) {
+bool TaskQueueRepo::mark_task_as_failed(long long task_id,
+                                        const std::string& error_message,
+                                        const std::string& lease_owner) {
+  float last_percent = 0.0f;
+  bool updated = false;
   try {
-    PooledConnection conn(db_manager_);
     auto now = std::chrono::system_clock::now();
-    std::string updated_at_str = time_point_to_string(now);
+    int64_t updated_at_ms = to_epoch_millis(now);
     std::string failed_status = to_string(TaskStatus::FAILED);
-    *conn << "UPDATE task_queue SET status = ?, error_message = ?, updated_at = ? WHERE id = ?"
-          << failed_status << error_message << updated_at_str << task_id;
+    std::optional<ProgressRecord> final_progress = take_unflushed_progress(task_id, &last_percent);
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      updated = false;
+      if (lease_owner.empty()) {
+        conn.prepare("UPDATE task_queue SET status = ?, error_message = ?, updated_at = ?, "
+                     "lease_owner = NULL, lease_expires_at = NULL WHERE id = ? RETURNING id")
+                << failed_status << error_message << updated_at_ms << task_id >>
+            [&](long long) { updated = true; };
+      } else {
+        conn.prepare("UPDATE task_queue SET status = ?, error_message = ?, updated_at = ?, "
+                     "lease_owner = NULL, lease_expires_at = NULL "
+                     "WHERE id = ? AND status = ? AND lease_owner = ? RETURNING id")
+                << failed_status << error_message << updated_at_ms << task_id
+                << to_string(TaskStatus::PROCESSING) << lease_owner >>
+            [&](long long) { updated = true; };
+      }
+      if (updated && final_progress) {
+        write_progress(conn, *final_progress);
+      }
+    });
   } catch (const sqlite::sqlite_exception& e) {
     throw TaskQueueRepoError(format_db_error("mark_task_as_failed", e));
   }
+  if (updated) {
+    notify_task_updated({task_id, TaskStatus::FAILED, last_percent, error_message});
+  }
+  return updated;
 }
 
 std::vector<TaskDTO> TaskQueueRepo::get_tasks_by_status(TaskStatus status) {
   try {
-    PooledConnection conn(db_manager_);
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
     std::vector<TaskDTO> tasks;
     std::string status_str = to_string(status);
-    *conn << "SELECT id, task_type, status, priority, error_message, created_at, "
-             "updated_at, target_path, target_tag, payload FROM task_queue WHERE status = ? ORDER "
-             "BY priority ASC, created_at ASC"
-          << status_str >>
+    conn.prepare("SELECT id, task_type, status, priority, error_message, created_at, "
+                 "updated_at, target_path, target_tag, payload FROM task_queue WHERE status = ? "
+                 "ORDER BY priority ASC, created_at ASC")
+            << status_str >>
         [&](long long id, std::string task_type, std::string status_db, int priority,
-            std::optional<std::string> error_message, std::string created_at,
-            std::string updated_at, std::string target_path, std::string target_tag,
+            std::optional<std::string> error_message, int64_t created_at,
+            int64_t updated_at, std::string target_path, std::string target_tag,
             std::string payload) {
           TaskDTO task;
           task.id = id;
@@ -149,8 +588,8 @@ std::vector<TaskDTO> TaskQueueRepo::get_tasks_by_status(TaskStatus status) {
           task.priority = priority;
           if (error_message)
             task.error_message = *error_message;
-          task.created_at = string_to_time_point(created_at);
-          task.updated_at = string_to_time_point(updated_at);
+          task.created_at = from_epoch_millis(created_at);
+          task.updated_at = from_epoch_millis(updated_at);
           tasks.push_back(std::move(task));
         };
     return tasks;
@@ -159,45 +598,244 @@ std::vector<TaskDTO> TaskQueueRepo::get_tasks_by_status(TaskStatus status) {
   }
 }
 
+std::vector<TaskDTO> TaskQueueRepo::list_tasks_page(std::optional<TaskStatus> status,
+                                                    long long after_id,
+                                                    int limit) {
+  std::vector<TaskDTO> tasks;
+  if (limit <= 0) {
+    return tasks;
+  }
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    // NULL matches every status
+    std::optional<std::string> status_str;
+    if (status) {
+      status_str = to_string(*status);
+    }
+    conn.prepare("SELECT id, task_type, status, priority, error_message, created_at, "
+                 "updated_at, target_path, target_tag, payload, lease_owner, attempts "
+                 "FROM task_queue WHERE id > ? AND (? IS NULL OR status = ?) "
+                 "ORDER BY id LIMIT ?")
+            << after_id << status_str << status_str << limit >>
+        [&](long long id, std::string task_type, std::string status_db, int priority,
+            std::optional<std::string> error_message, int64_t created_at, int64_t updated_at,
+            std::optional<std::string> target_path, std::optional<std::string> target_tag,
+            std::optional<std::string> payload, std::optional<std::string> lease_owner,
+            int attempts) {
+          TaskDTO task;
+          task.id = id;
+          task.task_type = task_type;
+          task.status = task_status_from_string(status_db);
+          task.priority = priority;
+          task.error_message = error_message;
+          task.created_at = from_epoch_millis(created_at);
+          task.updated_at = from_epoch_millis(updated_at);
+          task.target_path = target_path;
+          task.target_tag = target_tag;
+          task.payload = payload;
+          task.lease_owner = lease_owner;
+          task.attempts = attempts;
+          tasks.push_back(std::move(task));
+        };
+    return tasks;
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error("list_tasks_page", e));
+  }
+}
+
+std::optional<TaskDTO> TaskQueueRepo::get_task(long long task_id) {
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    std::optional<TaskDTO> task;
+    conn.prepare("SELECT id, task_type, status, priority, error_message, created_at, "
+                 "updated_at, target_path, target_tag, payload, lease_owner, attempts "
+                 "FROM task_queue WHERE id = ?")
+            << task_id >>
+        [&](long long id, std::string task_type, std::string status_db, int priority,
+            std::optional<std::string> error_message, int64_t created_at, int64_t updated_at,
+            std::optional<std::string> target_path, std::optional<std::string> target_tag,
+            std::optional<std::string> payload, std::optional<std::string> lease_owner,
+            int attempts) {
+          task.emplace();
+          task->id = id;
+          task->task_type = task_type;
+          task->status = task_status_from_string(status_db);
+          task->priority = priority;
+          task->error_message = error_message;
+          task->created_at = from_epoch_millis(created_at);
+          task->updated_at = from_epoch_millis(updated_at);
+          task->target_path = target_path;
+          task->target_tag = target_tag;
+          task->payload = payload;
+          task->lease_owner = lease_owner;
+          task->attempts = attempts;
+        };
+    return task;
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error("get_task", e));
+  }
+}
+
+size_t TaskQueueRepo::count_tasks_by_status(TaskStatus status) {
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    int64_t count = 0;
+    conn.prepare("SELECT COUNT(*) FROM task_queue WHERE status = ?") << to_string(status) >>
+        count;
+    return static_cast<size_t>(count);
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error("count_tasks_by_status", e));
+  }
+}
+
+size_t TaskQueueRepo::count_pending_tasks(TaskLane lane) {
+  return count_lane_tasks(TaskStatus::PENDING, lane, "count_pending_tasks");
+}
+
+size_t TaskQueueRepo::count_claimed_tasks(TaskLane lane) {
+  return count_lane_tasks(TaskStatus::PROCESSING, lane, "count_claimed_tasks");
+}
+
+size_t TaskQueueRepo::count_lane_tasks(TaskStatus status,
+                                       TaskLane lane,
+                                       const std::string& operation) {
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    int64_t count = 0;
+    conn.prepare("SELECT COUNT(*) FROM task_queue WHERE status = ?" + lane_condition(lane))
+            << to_string(status) >>
+        count;
+    return static_cast<size_t>(count);
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error(operation, e));
+  }
+}
+
+std::optional<long long> TaskQueueRepo::find_superseding_task(long long task_id) {
+  try {
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
+    std::optional<long long> newer;
+    conn.prepare(SUPERSEDING_TASK_SQL) << task_id >> [&](long long id) { newer = id; };
+    return newer;
+  } catch (const sqlite::sqlite_exception& e) {
+    throw TaskQueueRepoError(format_db_error("find_superseding_task", e));
+  }
+}
+
 void TaskQueueRepo::clear_completed_tasks(int older_than_days) {
   try {
-    PooledConnection conn(db_manager_);
     auto cutoff_time = std::chrono::system_clock::now() - std::chrono::hours(24 * older_than_days);
-    std::string cutoff_str = time_point_to_string(cutoff_time);
+    int64_t cutoff = to_epoch_millis(cutoff_time);
     std::string completed_status = to_string(TaskStatus::COMPLETED);
     std::string failed_status = to_string(TaskStatus::FAILED);
-    *conn << "DELETE FROM task_queue WHERE status IN (?, ?) AND updated_at <= ?" << completed_status
-          << failed_status << cutoff_str;
+    db_manager_.writer().run([&](PooledDatabase& conn) {
+      conn.db << "DELETE FROM task_queue WHERE status IN (?, ?) AND updated_at <= ?"
+              << completed_status << failed_status << cutoff;
+    });
   } catch (const sqlite::sqlite_exception& e) {
     throw TaskQueueRepoError(format_db_error("clear_completed_tasks", e));
   }
 }
-void TaskQueueRepo::upsert_task_progress(long long task_id, float percent, const std::string& message) {
+
+void TaskQueueRepo::upsert_task_progress(long long task_id,
+                                         float percent,
+                                         const std::string& message) {
+  ProgressRecord progress{task_id, percent, message,
+                          to_epoch_millis(std::chrono::system_clock::now())};
+  {
+    // Keeps a running task's in-memory progress from masking this write
+    std::lock_guard<std::mutex> lock(progress_->mutex);
+    auto it = progress_->entries.find(task_id);
+    if (it != progress_->entries.end()) {
+      it->second.progress = progress;
+      it->second.dirty = false;
+      it->second.last_flush = std::chrono::steady_clock::now();
+    }
+  }
   try {
-    PooledConnection conn(db_manager_);
-    auto now = std::chrono::system_clock::now();
-    std::string ts = time_point_to_string(now);
-    *conn << "INSERT INTO task_progress (task_id, progress_percent, status_message, updated_at) "
-             "VALUES (?,?,?,?) "
-             "ON CONFLICT(task_id) DO UPDATE SET "
-             "progress_percent = excluded.progress_percent, "
-             "status_message = excluded.status_message, "
-             "updated_at = excluded.updated_at"
-          << task_id << percent << message << ts;
+    db_manager_.writer().run([&](PooledDatabase& conn) { write_progress(conn, progress); });
   } catch (const sqlite::sqlite_exception& e) {
     throw TaskQueueRepoError(format_db_error("upsert_task_progress", e));
   }
 }
 
+void TaskQueueRepo::report_task_progress(long long task_id,
+                                         float percent,
+                                         const std::string& message) {
+  notify_task_updated({task_id, TaskStatus::PROCESSING, percent, message});
+  const auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(progress_->mutex);
+    auto& entry = progress_->entries[task_id];
+    entry.progress = ProgressRecord{task_id, percent, message,
+                                    to_epoch_millis(std::chrono::system_clock::now())};
+    entry.dirty = true;
+    // A task's first report is written straight away
+    const bool flushed_before = entry.last_flush != std::chrono::steady_clock::time_point{};
+    if (entry.flush_queued ||
+        (flushed_before && now - entry.last_flush < progress_flush_interval_)) {
+      return;
+    }
+    entry.flush_queued = true;
+    entry.last_flush = now;
+  }
+
+  // Captures the table rather than this: the flush may run after the repo is gone
+  std::shared_ptr<ProgressTable> table = progress_;
+  auto flush = [table, task_id](PooledDatabase& conn) {
+    std::optional<ProgressRecord> latest;
+    {
+      std::lock_guard<std::mutex> lock(table->mutex);
+      auto it = table->entries.find(task_id);
+      if (it == table->entries.end()) {
+        return;
+      }
+      it->second.flush_queued = false;
+      it->second.dirty = false;
+      it->second.last_flush = std::chrono::steady_clock::now();
+      latest = it->second.progress;
+    }
+    try {
+      write_progress(conn, *latest);
+    } catch (const sqlite::sqlite_exception& e) {
+      // Progress is advisory; the next report or the task's completion writes it again
+      log::warning() << format_db_error("report_task_progress", e);
+      std::lock_guard<std::mutex> lock(table->mutex);
+      auto it = table->entries.find(task_id);
+      if (it != table->entries.end()) {
+        it->second.dirty = true;
+      }
+    }
+  };
+  try {
+    // Not waited on; its future is dropped
+    db_manager_.writer().submit(std::move(flush));
+  } catch (const DatabaseWriterError&) {
+    // The writer is shutting down: leave the progress in memory, unflushed
+    std::lock_guard<std::mutex> lock(progress_->mutex);
+    auto it = progress_->entries.find(task_id);
+    if (it != progress_->entries.end()) {
+      it->second.flush_queued = false;
+    }
+  }
+}
+
 std::optional<TaskProgressDTO> TaskQueueRepo::get_task_progress(long long task_id) {
+  {
+    std::lock_guard<std::mutex> lock(progress_->mutex);
+    auto it = progress_->entries.find(task_id);
+    if (it != progress_->entries.end()) {
+      return to_dto(it->second.progress);
+    }
+  }
   try {
-    PooledConnection conn(db_manager_);
+    PooledConnection conn(db_manager_, ConnectionAccess::ReadOnly);
     std::optional<TaskProgressDTO> out;
-    *conn << "SELECT task_id, progress_percent, status_message, updated_at "
-             "FROM task_progress WHERE task_id = ?"
-          << task_id >>
-      [&](long long t_id, float pct, std::string msg, std::string updated_at) {
-        out = TaskProgressDTO{t_id, pct, msg, updated_at};
+    conn.prepare("SELECT task_id, progress_percent, status_message, updated_at "
+                 "FROM task_progress WHERE task_id = ?")
+            << task_id >>
+      [&](long long t_id, float pct, std::string msg, int64_t updated_at) {
+        out = to_dto(ProgressRecord{t_id, pct, msg, updated_at});
       };
     return out;
   } catch (const sqlite::sqlite_exception& e) {
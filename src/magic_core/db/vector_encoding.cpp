@@ -0,0 +1,264 @@
+#include "magic_core/db/vector_encoding.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MAGIC_VECTOR_F16C 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define MAGIC_VECTOR_NEON 1
+#endif
+
+namespace magic_core {
+
+namespace {
+
+uint16_t float_to_half(float value) {
+  uint32_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const uint32_t exponent = (bits >> 23) & 0xFF;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  if (exponent == 0xFF) {
+    return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+  }
+  const int half_exponent = static_cast<int>(exponent) - 127 + 15;
+  if (half_exponent >= 0x1F) {
+    return static_cast<uint16_t>(sign | 0x7C00);
+  }
+  if (half_exponent <= 0) {
+    // Subnormal in half precision, or too small for it
+    if (half_exponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+    mantissa |= 0x800000;
+    const int shift = 14 - half_exponent;
+    uint32_t half = mantissa >> shift;
+    const uint32_t rest = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) {
+      ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+  }
+  uint32_t half = (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+  const uint32_t rest = mantissa & 0x1FFF;
+  // A carry out of the mantissa correctly bumps the exponent
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+    ++half;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+float half_to_float(uint16_t half) {
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  const uint32_t exponent = (half >> 10) & 0x1F;
+  uint32_t mantissa = half & 0x3FF;
+  uint32_t bits = 0;
+  if (exponent == 0x1F) {
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else if (exponent == 0) {
+    if (mantissa == 0) {
+      bits = sign;
+    } else {
+      // Normalize the subnormal
+      int shift = -1;
+      do {
+        ++shift;
+        mantissa <<= 1;
+      } while ((mantissa & 0x400) == 0);
+      bits = sign | (static_cast<uint32_t>(127 - 15 - shift) << 23) | ((mantissa & 0x3FF) << 13);
+    }
+  } else {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+  float value = 0.0f;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void halves_to_floats_scalar(const uint16_t *in, size_t n, float *out) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = half_to_float(in[i]);
+  }
+}
+
+void floats_to_halves_scalar(const float *in, size_t n, uint16_t *out) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = float_to_half(in[i]);
+  }
+}
+
+#if defined(MAGIC_VECTOR_F16C)
+__attribute__((target("avx,f16c"))) void halves_to_floats_f16c(const uint16_t *in,
+                                                               size_t n,
+                                                               float *out) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(halves));
+  }
+  halves_to_floats_scalar(in + i, n - i, out + i);
+}
+
+__attribute__((target("avx,f16c"))) void floats_to_halves_f16c(const float *in,
+                                                               size_t n,
+                                                               uint16_t *out) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), halves);
+  }
+  floats_to_halves_scalar(in + i, n - i, out + i);
+}
+
+bool has_f16c() {
+  static const bool supported = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return supported;
+}
+#endif
+
+void halves_to_floats(const uint16_t *in, size_t n, float *out) {
+#if defined(MAGIC_VECTOR_F16C)
+  if (has_f16c()) {
+    halves_to_floats_f16c(in, n, out);
+    return;
+  }
+#elif defined(MAGIC_VECTOR_NEON)
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + i))));
+  }
+  halves_to_floats_scalar(in + i, n - i, out + i);
+  return;
+#endif
+  halves_to_floats_scalar(in, n, out);
+}
+
+void floats_to_halves(const float *in, size_t n, uint16_t *out) {
+#if defined(MAGIC_VECTOR_F16C)
+  if (has_f16c()) {
+    floats_to_halves_f16c(in, n, out);
+    return;
+  }
+#elif defined(MAGIC_VECTOR_NEON)
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+  }
+  floats_to_halves_scalar(in + i, n - i, out + i);
+  return;
+#endif
+  floats_to_halves_scalar(in, n, out);
+}
+
+}  // namespace
+
+VectorEncoding parse_vector_encoding(const std::string &name) {
+  if (name == "float32") {
+    return VectorEncoding::Float32;
+  }
+  if (name == "float16") {
+    return VectorEncoding::Float16;
+  }
+  if (name == "int8") {
+    return VectorEncoding::Int8;
+  }
+  throw std::invalid_argument("Unknown vector encoding '" + name +
+                              "' (expected float32, float16 or int8)");
+}
+
+std::string to_string(VectorEncoding encoding) {
+  switch (encoding) {
+    case VectorEncoding::Float32:
+      return "float32";
+    case VectorEncoding::Float16:
+      return "float16";
+    case VectorEncoding::Int8:
+      return "int8";
+  }
+  return "unknown";
+}
+
+size_t encoded_vector_size(VectorEncoding encoding, int dimension) {
+  const size_t n = static_cast<size_t>(dimension);
+  switch (encoding) {
+    case VectorEncoding::Float32:
+      return n * sizeof(float);
+    case VectorEncoding::Float16:
+      return n * sizeof(uint16_t);
+    case VectorEncoding::Int8:
+      return sizeof(float) + n;
+  }
+  throw std::invalid_argument("Unknown vector encoding");
+}
+
+void encode_vector(VectorEncoding encoding, const float *in, int dimension, unsigned char *out) {
+  const size_t n = static_cast<size_t>(dimension);
+  switch (encoding) {
+    case VectorEncoding::Float32:
+      std::memcpy(out, in, n * sizeof(float));
+      return;
+    case VectorEncoding::Float16: {
+      // out has no alignment guarantee, so the halves go through a buffer
+      uint16_t halves[256];
+      for (size_t begin = 0; begin < n; begin += std::size(halves)) {
+        const size_t count = std::min(n - begin, std::size(halves));
+        floats_to_halves(in + begin, count, halves);
+        std::memcpy(out + begin * sizeof(uint16_t), halves, count * sizeof(uint16_t));
+      }
+      return;
+    }
+    case VectorEncoding::Int8: {
+      float max_abs = 0.0f;
+      for (size_t i = 0; i < n; ++i) {
+        max_abs = std::max(max_abs, std::fabs(in[i]));
+      }
+      const float scale = max_abs / 127.0f;
+      std::memcpy(out, &scale, sizeof(scale));
+      const float inverse = scale > 0.0f ? 1.0f / scale : 0.0f;
+      for (size_t i = 0; i < n; ++i) {
+        const float code = std::clamp(std::nearbyint(in[i] * inverse), -127.0f, 127.0f);
+        out[sizeof(float) + i] = static_cast<unsigned char>(static_cast<int8_t>(code));
+      }
+      return;
+    }
+  }
+  throw std::invalid_argument("Unknown vector encoding");
+}
+
+void decode_vector(VectorEncoding encoding, const unsigned char *in, int dimension, float *out) {
+  const size_t n = static_cast<size_t>(dimension);
+  switch (encoding) {
+    case VectorEncoding::Float32:
+      std::memcpy(out, in, n * sizeof(float));
+      return;
+    case VectorEncoding::Float16: {
+      uint16_t halves[256];
+      for (size_t begin = 0; begin < n; begin += std::size(halves)) {
+        const size_t count = std::min(n - begin, std::size(halves));
+        std::memcpy(halves, in + begin * sizeof(uint16_t), count * sizeof(uint16_t));
+        halves_to_floats(halves, count, out + begin);
+      }
+      return;
+    }
+    case VectorEncoding::Int8: {
+      float scale = 0.0f;
+      std::memcpy(&scale, in, sizeof(scale));
+      const int8_t *codes = reinterpret_cast<const int8_t *>(in + sizeof(float));
+      // A plain multiply the compiler vectorizes at every baseline
+      for (size_t i = 0; i < n; ++i) {
+        out[i] = scale * static_cast<float>(codes[i]);
+      }
+      return;
+    }
+  }
+  throw std::invalid_argument("Unknown vector encoding");
+}
+
+}  // namespace magic_core
@@ -0,0 +1,891 @@
+#include "magic_core/db/vector_index.hpp"
+
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIVFPQ.h>
+#include <faiss/IndexScalarQuantizer.h>
+#include <faiss/impl/FaissException.h>
+#include <faiss/impl/IDSelector.h>
+#include <faiss/impl/io.h>
+#include <faiss/index_io.h>
+#include <faiss/utils/distances.h>
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <numeric>
+#include <random>
+
+#include "magic_core/db/faiss_gpu.hpp"
+#include "magic_core/types/logger.hpp"
+#include "magic_core/types/metrics.hpp"
+#include "magic_core/types/vector_math.hpp"
+
+namespace magic_core {
+
+namespace {
+
+// Accepts only slots that still map to a live external id
+class LiveSlotSelector : public faiss::IDSelector {
+ public:
+  explicit LiveSlotSelector(const std::vector<faiss::idx_t> &slot_ids) : slot_ids_(slot_ids) {}
+
+  bool is_member(faiss::idx_t slot) const override {
+    return slot >= 0 && static_cast<size_t>(slot) < slot_ids_.size() && slot_ids_[slot] >= 0;
+  }
+
+ private:
+  const std::vector<faiss::idx_t> &slot_ids_;
+};
+
+// Search parameters for whichever index type a snapshot holds. Not copyable: selected points
+// into the object itself.
+struct TunedSearchParameters {
+  TunedSearchParameters(const faiss::Index &index, int k, int ef_search, int nprobe) {
+    if (dynamic_cast<const faiss::IndexHNSW *>(&index)) {
+      hnsw.efSearch = std::max(ef_search, k);
+      selected = &hnsw;
+    } else if (dynamic_cast<const faiss::IndexIVF *>(&index)) {
+      ivf.nprobe = static_cast<size_t>(nprobe);
+      selected = &ivf;
+    }
+  }
+  TunedSearchParameters(const TunedSearchParameters &) = delete;
+  TunedSearchParameters &operator=(const TunedSearchParameters &) = delete;
+
+  faiss::SearchParameters flat;
+  faiss::SearchParametersHNSW hnsw;
+  faiss::SearchParametersIVF ivf;
+  faiss::SearchParameters *selected = &flat;
+};
+
+// PQ codes of 8 bits, i.e. 256 centroids per sub-quantizer
+constexpr int PQ_BITS = 8;
+
+VectorIndexOptions hnsw_options(int hnsw_m, int ef_construction) {
+  VectorIndexOptions options;
+  options.hnsw_m = hnsw_m;
+  options.ef_construction = ef_construction;
+  return options;
+}
+
+}  // namespace
+
+VectorIndexType parse_vector_index_type(const std::string &name) {
+  if (name == "flat") {
+    return VectorIndexType::Flat;
+  }
+  if (name == "hnsw") {
+    return VectorIndexType::Hnsw;
+  }
+  if (name == "hnsw_sq8") {
+    return VectorIndexType::HnswSq8;
+  }
+  if (name == "ivf_pq") {
+    return VectorIndexType::IvfPq;
+  }
+  throw VectorIndexError("Unknown vector index type '" + name +
+                         "', expected flat, hnsw, hnsw_sq8 or ivf_pq");
+}
+
+std::string to_string(VectorIndexType type) {
+  switch (type) {
+    case VectorIndexType::Flat:
+      return "flat";
+    case VectorIndexType::Hnsw:
+      return "hnsw";
+    case VectorIndexType::HnswSq8:
+      return "hnsw_sq8";
+    case VectorIndexType::IvfPq:
+      return "ivf_pq";
+  }
+  return "unknown";
+}
+
+VectorMetric parse_vector_metric(const std::string &name) {
+  if (name == "l2") {
+    return VectorMetric::L2;
+  }
+  if (name == "cosine") {
+    return VectorMetric::Cosine;
+  }
+  throw VectorIndexError("Unknown vector metric '" + name + "', expected l2 or cosine");
+}
+
+std::string to_string(VectorMetric metric) {
+  switch (metric) {
+    case VectorMetric::L2:
+      return "l2";
+    case VectorMetric::Cosine:
+      return "cosine";
+  }
+  return "unknown";
+}
+
+VectorIndex::VectorIndex(int dimension, VectorIndexOptions options)
+    : dimension_(dimension), options_(options) {
+  if (options_.type == VectorIndexType::IvfPq &&
+      (options_.pq_subquantizers <= 0 || dimension_ % options_.pq_subquantizers != 0)) {
+    throw VectorIndexError("pq_subquantizers (" + std::to_string(options_.pq_subquantizers) +
+                           ") must divide the dimension (" + std::to_string(dimension_) + ")");
+  }
+  auto empty = std::make_shared<Snapshot>();
+  empty->index = create_index({});
+  empty->gpu_index = gpu_replica(*empty->index);
+  snapshot_ = std::move(empty);
+}
+
+VectorIndex::VectorIndex(int dimension, int hnsw_m, int ef_construction)
+    : VectorIndex(dimension, hnsw_options(hnsw_m, ef_construction)) {}
+
+size_t VectorIndex::min_training_vectors() const {
+  switch (options_.type) {
+    case VectorIndexType::HnswSq8:
+      return SQ_MIN_TRAINING_VECTORS;
+    case VectorIndexType::IvfPq:
+      return MIN_POINTS_PER_CENTROID *
+             std::max<size_t>(static_cast<size_t>(options_.ivf_lists), size_t{1} << PQ_BITS);
+    default:
+      return 0;
+  }
+}
+
+bool VectorIndex::uses_configured_type() const {
+  const auto snapshot = current();
+  return is_configured_type(*snapshot->index);
+}
+
+bool VectorIndex::is_configured_type(const faiss::Index &index) const {
+  switch (options_.type) {
+    case VectorIndexType::Flat:
+      return dynamic_cast<const faiss::IndexFlat *>(&index) != nullptr;
+    case VectorIndexType::Hnsw:
+      return dynamic_cast<const faiss::IndexHNSWFlat *>(&index) != nullptr;
+    case VectorIndexType::HnswSq8:
+      return dynamic_cast<const faiss::IndexHNSWSQ *>(&index) != nullptr;
+    case VectorIndexType::IvfPq:
+      return dynamic_cast<const faiss::IndexIVFPQ *>(&index) != nullptr;
+  }
+  return false;
+}
+
+faiss::MetricType VectorIndex::faiss_metric() const {
+  return options_.metric == VectorMetric::Cosine ? faiss::METRIC_INNER_PRODUCT : faiss::METRIC_L2;
+}
+
+std::unique_ptr<faiss::Index> VectorIndex::create_flat_index() const {
+  return std::make_unique<faiss::IndexFlat>(dimension_, faiss_metric());
+}
+
+void VectorIndex::prepare_vectors(float *vectors, size_t count) const {
+  if (options_.metric != VectorMetric::Cosine) {
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    vector_math::normalize(vectors + i * dimension_, static_cast<size_t>(dimension_));
+  }
+}
+
+std::unique_ptr<faiss::Index> VectorIndex::create_index(const std::vector<float> &vectors) const {
+  auto index = create_untrained_index(vectors.size() / static_cast<size_t>(dimension_));
+  if (!index->is_trained) {
+    train_index(*index, vectors);
+  }
+  return index;
+}
+
+std::unique_ptr<faiss::Index> VectorIndex::create_untrained_index(size_t count) const {
+  if (count < min_training_vectors()) {
+    return create_flat_index();
+  }
+
+  switch (options_.type) {
+    case VectorIndexType::Flat:
+      return create_flat_index();
+    case VectorIndexType::Hnsw: {
+      auto hnsw =
+          std::make_unique<faiss::IndexHNSWFlat>(dimension_, options_.hnsw_m, faiss_metric());
+      hnsw->hnsw.efConstruction = options_.ef_construction;
+      return hnsw;
+    }
+    case VectorIndexType::HnswSq8: {
+      auto hnsw = std::make_unique<faiss::IndexHNSWSQ>(
+          dimension_, faiss::ScalarQuantizer::QT_8bit, options_.hnsw_m, faiss_metric());
+      hnsw->hnsw.efConstruction = options_.ef_construction;
+      return hnsw;
+    }
+    case VectorIndexType::IvfPq: {
+      auto ivf = std::make_unique<faiss::IndexIVFPQ>(
+          create_flat_index().release(), dimension_, options_.ivf_lists,
+          options_.pq_subquantizers, PQ_BITS, faiss_metric());
+      ivf->own_fields = true;
+      ivf->nprobe = options_.nprobe;
+      return ivf;
+    }
+  }
+  return create_flat_index();
+}
+
+void VectorIndex::train_index(faiss::Index &index, const std::vector<float> &vectors) const {
+  const size_t count = vectors.size() / static_cast<size_t>(dimension_);
+  const std::vector<size_t> rows = training_rows(count);
+  std::vector<float> sample;
+  const float *training = vectors.data();
+  if (rows.size() < count) {
+    sample.reserve(rows.size() * dimension_);
+    for (size_t row : rows) {
+      const float *v = vectors.data() + row * dimension_;
+      sample.insert(sample.end(), v, v + dimension_);
+    }
+    training = sample.data();
+  }
+  index.train(static_cast<faiss::idx_t>(rows.size()), training);
+  if (auto *ivf = dynamic_cast<faiss::IndexIVF *>(&index)) {
+    // Needed to reconstruct candidates for exact filtered searches
+    ivf->make_direct_map(true);
+  }
+}
+
+std::vector<size_t> VectorIndex::training_rows(size_t count) const {
+  std::vector<size_t> rows(count);
+  std::iota(rows.begin(), rows.end(), size_t{0});
+  if (count <= options_.training_sample) {
+    return rows;
+  }
+  // A uniform sample, fixed seed so rebuilds of the same data train the same way. Selection
+  // sampling keeps the rows in order.
+  std::vector<size_t> picked;
+  picked.reserve(options_.training_sample);
+  std::sample(rows.begin(), rows.end(), std::back_inserter(picked), options_.training_sample,
+              std::mt19937(42));
+  return picked;
+}
+
+void VectorIndex::build(Snapshot &fresh, size_t row_count, const RowReader &read) const {
+  fresh.index = create_untrained_index(row_count);
+  // Training and encoding are what a GPU speeds up: flat has neither, HNSW no GPU version
+  if (options_.gpu_device >= 0 && options_.type == VectorIndexType::IvfPq &&
+      !fresh.index->is_trained) {
+    if (auto gpu = faiss_gpu::to_gpu(*fresh.index, options_.gpu_device)) {
+      try {
+        fill(*gpu, /*on_gpu*/ true, fresh, row_count, read);
+        fresh.index = faiss_gpu::to_cpu(*gpu, options_.gpu_device);
+        if (auto *ivf = dynamic_cast<faiss::IndexIVF *>(fresh.index.get())) {
+          ivf->make_direct_map(true);
+        }
+        fresh.gpu_index = std::move(gpu);
+        return;
+      } catch (const faiss::FaissException &e) {
+        log::warning() << "GPU index build failed, building on the CPU: " << e.what();
+        fresh.index = create_untrained_index(row_count);
+        fresh.slot_ids.clear();
+        fresh.id_slots.clear();
+      }
+    }
+  }
+  fill(*fresh.index, /*on_gpu*/ false, fresh, row_count, read);
+  fresh.gpu_index = gpu_replica(*fresh.index);
+}
+
+void VectorIndex::fill(faiss::Index &target,
+                       bool on_gpu,
+                       Snapshot &fresh,
+                       size_t row_count,
+                       const RowReader &read) const {
+  using Batch = std::pair<std::vector<faiss::idx_t>, std::vector<float>>;
+  const auto device_lock = [&] {
+    return on_gpu ? faiss_gpu::lock(options_.gpu_device) : std::unique_lock<std::mutex>();
+  };
+  const auto read_rows = [&](const std::vector<size_t> &rows) {
+    Batch batch;
+    auto &[ids, vectors] = batch;
+    read(rows, ids, vectors);
+    if (vectors.size() != ids.size() * static_cast<size_t>(dimension_)) {
+      throw VectorIndexError("Rebuild received " + std::to_string(vectors.size()) +
+                             " floats for " + std::to_string(ids.size()) + " ids");
+    }
+    prepare_vectors(vectors.data(), ids.size());
+    return batch;
+  };
+  const auto read_batch = [&](size_t begin) {
+    std::vector<size_t> rows(std::min(REBUILD_BATCH, row_count - begin));
+    std::iota(rows.begin(), rows.end(), begin);
+    return read_rows(rows);
+  };
+
+  if (!target.is_trained) {
+    // Only the sample is held for training; its rows are read again as they are added
+    const Batch sample = read_rows(training_rows(row_count));
+    auto device = device_lock();
+    target.train(static_cast<faiss::idx_t>(sample.first.size()), sample.second.data());
+    if (auto *ivf = dynamic_cast<faiss::IndexIVF *>(&target)) {
+      ivf->make_direct_map(true);
+    }
+  }
+
+  fresh.slot_ids.reserve(row_count);
+  fresh.id_slots.reserve(row_count);
+  std::future<Batch> next;
+  if (row_count > 0) {
+    next = std::async(std::launch::async, read_batch, size_t{0});
+  }
+  for (size_t begin = 0; begin < row_count; begin += REBUILD_BATCH) {
+    const Batch batch = next.get();
+    if (begin + REBUILD_BATCH < row_count) {
+      next = std::async(std::launch::async, read_batch, begin + REBUILD_BATCH);
+    }
+    const auto &[ids, vectors] = batch;
+    if (!ids.empty()) {
+      auto device = device_lock();
+      target.add(static_cast<faiss::idx_t>(ids.size()), vectors.data());
+    }
+    for (faiss::idx_t id : ids) {
+      const auto slot = static_cast<faiss::idx_t>(fresh.slot_ids.size());
+      fresh.slot_ids.push_back(id);
+      auto [it, inserted] = fresh.id_slots.emplace(id, slot);
+      if (!inserted) {
+        // Duplicate id in the input: the last occurrence wins.
+        fresh.slot_ids[it->second] = DEAD_SLOT;
+        it->second = slot;
+      }
+    }
+  }
+}
+
+std::unique_ptr<faiss::Index> VectorIndex::gpu_replica(const faiss::Index &index) const {
+  if (options_.gpu_device < 0) {
+    return nullptr;
+  }
+  return faiss_gpu::to_gpu(index, options_.gpu_device);
+}
+
+std::shared_ptr<const VectorIndex::Snapshot> VectorIndex::current() const {
+  std::lock_guard<std::mutex> lock(publish_mutex_);
+  return snapshot_;
+}
+
+void VectorIndex::publish(std::shared_ptr<Snapshot> snapshot) {
+  std::lock_guard<std::mutex> lock(publish_mutex_);
+  snapshot_.swap(snapshot);
+  // The old snapshot is released here, or by the last search still using it
+}
+
+void VectorIndex::check_dimension(size_t size, const char *what) const {
+  if (size != static_cast<size_t>(dimension_)) {
+    throw VectorIndexError(std::string(what) + " dimension mismatch. Expected " +
+                           std::to_string(dimension_) + ", got " + std::to_string(size));
+  }
+}
+
+void VectorIndex::upsert(faiss::idx_t id, const std::vector<float> &vector) {
+  check_dimension(vector.size(), "Vector");
+
+  std::lock_guard<std::mutex> write_lock(write_mutex_);
+  // Writers are serialized, so the published snapshot is ours to mutate in place
+  Snapshot &snapshot = *snapshot_;
+  std::vector<float> prepared;
+  const float *added = vector.data();
+  if (options_.metric == VectorMetric::Cosine) {
+    prepared = vector;
+    prepare_vectors(prepared.data(), 1);
+    added = prepared.data();
+  }
+  // The device goes first: a GPU build on it keeps only this writer waiting, not the searches
+  // that need the snapshot's lock. Only serialized writers change gpu_index.
+  std::unique_lock<std::mutex> device;
+  if (snapshot.gpu_index) {
+    device = faiss_gpu::lock(options_.gpu_device);
+  }
+  std::unique_lock<std::shared_mutex> lock(snapshot.mutex);
+
+  const faiss::idx_t slot = snapshot.index->ntotal;
+  try {
+    snapshot.index->add(1, added);
+  } catch (const faiss::FaissException &e) {
+    throw VectorIndexError("Failed to add vector " + std::to_string(id) + ": " + e.what());
+  }
+  if (snapshot.gpu_index) {
+    try {
+      snapshot.gpu_index->add(1, added);
+    } catch (const faiss::FaissException &e) {
+      // Its slots no longer line up with the CPU copy's; batches go to the CPU until the next
+      // rebuild makes a new one
+      log::warning() << "Dropping the GPU copy of a vector index: " << e.what();
+      snapshot.gpu_index.reset();
+    }
+  }
+  // Only now that the new vector is in does the old one give way; a failed add leaves it found
+  snapshot.slot_ids.push_back(id);
+  auto [it, inserted] = snapshot.id_slots.emplace(id, slot);
+  if (!inserted) {
+    snapshot.slot_ids[it->second] = DEAD_SLOT;
+    it->second = slot;
+  }
+}
+
+bool VectorIndex::remove(faiss::idx_t id) {
+  std::lock_guard<std::mutex> write_lock(write_mutex_);
+  Snapshot &snapshot = *snapshot_;
+  std::unique_lock<std::shared_mutex> lock(snapshot.mutex);
+
+  auto it = snapshot.id_slots.find(id);
+  if (it == snapshot.id_slots.end()) {
+    return false;
+  }
+  snapshot.slot_ids[it->second] = DEAD_SLOT;
+  snapshot.id_slots.erase(it);
+  return true;
+}
+
+size_t VectorIndex::remove_ids(const std::vector<faiss::idx_t> &ids) {
+  std::lock_guard<std::mutex> write_lock(write_mutex_);
+  Snapshot &snapshot = *snapshot_;
+  std::unique_lock<std::shared_mutex> lock(snapshot.mutex);
+
+  size_t removed = 0;
+  for (faiss::idx_t id : ids) {
+    auto it = snapshot.id_slots.find(id);
+    if (it == snapshot.id_slots.end()) {
+      continue;
+    }
+    snapshot.slot_ids[it->second] = DEAD_SLOT;
+    snapshot.id_slots.erase(it);
+    ++removed;
+  }
+  return removed;
+}
+
+void VectorIndex::rebuild(const Loader &loader) {
+  static metrics::Histogram &duration = metrics::histogram(
+      "magic_vector_index_rebuild_seconds", "Vector index rebuilds, loading the vectors included");
+  metrics::ScopedTimer timer(duration);
+  std::lock_guard<std::mutex> write_lock(write_mutex_);
+
+  std::vector<faiss::idx_t> ids;
+  std::vector<float> vectors;
+  loader(ids, vectors);
+  if (vectors.size() != ids.size() * static_cast<size_t>(dimension_)) {
+    throw VectorIndexError("Rebuild received " + std::to_string(vectors.size()) +
+                           " floats for " + std::to_string(ids.size()) + " ids");
+  }
+  // Already in memory, so rows are copied out of the loaded arrays a batch at a time
+  rebuild_locked(ids.size(), [&](const std::vector<size_t> &rows,
+                                 std::vector<faiss::idx_t> &batch_ids,
+                                 std::vector<float> &batch_vectors) {
+    batch_ids.reserve(rows.size());
+    batch_vectors.reserve(rows.size() * dimension_);
+    for (size_t row : rows) {
+      batch_ids.push_back(ids[row]);
+      const auto first = vectors.begin() + row * dimension_;
+      batch_vectors.insert(batch_vectors.end(), first, first + dimension_);
+    }
+  });
+}
+
+void VectorIndex::rebuild(const RowLister &list_rows, const RowReader &read) {
+  static metrics::Histogram &duration = metrics::histogram(
+      "magic_vector_index_rebuild_seconds", "Vector index rebuilds, loading the vectors included");
+  metrics::ScopedTimer timer(duration);
+  std::lock_guard<std::mutex> write_lock(write_mutex_);
+  rebuild_locked(list_rows(), read);
+}
+
+void VectorIndex::rebuild_locked(size_t row_count, const RowReader &read) {
+  // Build the replacement off to the side; readers keep using the current snapshot meanwhile.
+  auto fresh = std::make_shared<Snapshot>();
+  try {
+    build(*fresh, row_count, read);
+  } catch (const faiss::FaissException &e) {
+    throw VectorIndexError(std::string("Failed to rebuild vector index: ") + e.what());
+  }
+  fresh->built_size = fresh->id_slots.size();
+
+  publish(std::move(fresh));
+}
+
+std::vector<uint8_t> VectorIndex::serialize() const {
+  const auto snapshot = current();
+  std::shared_lock<std::shared_mutex> lock(snapshot->mutex);
+
+  // Layout: dimension (int32), slot count (uint64), slot ids (int64 each), faiss index
+  faiss::VectorIOWriter writer;
+  const int32_t dimension = dimension_;
+  const uint64_t slot_count = snapshot->slot_ids.size();
+  writer.data.resize(sizeof(dimension) + sizeof(slot_count) +
+                     snapshot->slot_ids.size() * sizeof(faiss::idx_t));
+  uint8_t *out = writer.data.data();
+  std::memcpy(out, &dimension, sizeof(dimension));
+  std::memcpy(out + sizeof(dimension), &slot_count, sizeof(slot_count));
+  std::memcpy(out + sizeof(dimension) + sizeof(slot_count), snapshot->slot_ids.data(),
+              snapshot->slot_ids.size() * sizeof(faiss::idx_t));
+  try {
+    faiss::write_index(snapshot->index.get(), &writer);
+  } catch (const faiss::FaissException &e) {
+    throw VectorIndexError(std::string("Failed to serialize vector index: ") + e.what());
+  }
+  return std::move(writer.data);
+}
+
+void VectorIndex::load(const std::vector<uint8_t> &bytes) {
+  int32_t dimension = 0;
+  uint64_t slot_count = 0;
+  const size_t fixed_header = sizeof(dimension) + sizeof(slot_count);
+  if (bytes.size() < fixed_header) {
+    throw VectorIndexError("Serialized vector index is truncated");
+  }
+  std::memcpy(&dimension, bytes.data(), sizeof(dimension));
+  std::memcpy(&slot_count, bytes.data() + sizeof(dimension), sizeof(slot_count));
+  if (dimension != dimension_) {
+    throw VectorIndexError("Serialized vector index has dimension " + std::to_string(dimension) +
+                           ", expected " + std::to_string(dimension_));
+  }
+  if (slot_count > (bytes.size() - fixed_header) / sizeof(faiss::idx_t)) {
+    throw VectorIndexError("Serialized vector index is truncated");
+  }
+
+  std::vector<faiss::idx_t> slot_ids(slot_count);
+  std::memcpy(slot_ids.data(), bytes.data() + fixed_header, slot_count * sizeof(faiss::idx_t));
+
+  faiss::VectorIOReader reader;
+  reader.data = bytes;
+  reader.rp = fixed_header + slot_count * sizeof(faiss::idx_t);
+  std::unique_ptr<faiss::Index> loaded;
+  try {
+    loaded.reset(faiss::read_index(&reader));
+    if (auto *ivf = dynamic_cast<faiss::IndexIVF *>(loaded.get())) {
+      ivf->make_direct_map(true);
+    }
+  } catch (const faiss::FaissException &e) {
+    throw VectorIndexError(std::string("Failed to deserialize vector index: ") + e.what());
+  }
+  if (!loaded || loaded->d != dimension_ ||
+      loaded->ntotal != static_cast<faiss::idx_t>(slot_count)) {
+    throw VectorIndexError("Serialized vector index does not match its slot mapping");
+  }
+  // A snapshot of another type (the config changed), or a flat stand-in that now has enough
+  // vectors to train the configured type, is rebuilt instead
+  const bool flat_stand_in = dynamic_cast<const faiss::IndexFlat *>(loaded.get()) != nullptr &&
+                             slot_count < min_training_vectors();
+  if ((!is_configured_type(*loaded) && !flat_stand_in) ||
+      loaded->metric_type != faiss_metric()) {
+    throw VectorIndexError("Serialized vector index is not a " + to_string(options_.type) +
+                           " " + to_string(options_.metric) + " index");
+  }
+
+  auto fresh = std::make_shared<Snapshot>();
+  fresh->id_slots.reserve(slot_ids.size());
+  for (size_t slot = 0; slot < slot_ids.size(); ++slot) {
+    if (slot_ids[slot] == DEAD_SLOT) {
+      continue;
+    }
+    if (!fresh->id_slots.emplace(slot_ids[slot], static_cast<faiss::idx_t>(slot)).second) {
+      throw VectorIndexError("Serialized vector index maps an id to more than one slot");
+    }
+  }
+  fresh->index = std::move(loaded);
+  fresh->gpu_index = gpu_replica(*fresh->index);
+  fresh->slot_ids = std::move(slot_ids);
+  fresh->built_size = fresh->id_slots.size();
+
+  std::lock_guard<std::mutex> write_lock(write_mutex_);
+  publish(std::move(fresh));
+}
+
+std::vector<VectorIndexHit> VectorIndex::search(const std::vector<float> &query,
+                                                int k,
+                                                const IdFilter *allowed,
+                                                const VectorSearchOptions &tuning) const {
+  static metrics::Histogram &duration =
+      metrics::histogram("magic_vector_search_seconds", "Vector index searches",
+                         metrics::latency_buckets(), "queries=\"single\"");
+  metrics::ScopedTimer timer(duration);
+  check_dimension(query.size(), "Query vector");
+
+  // Pinning the snapshot lets a concurrent rebuild publish a new one without waiting for us
+  const auto snapshot = current();
+  std::shared_lock<std::shared_mutex> lock(snapshot->mutex);
+  const faiss::Index &index = *snapshot->index;
+  const std::vector<faiss::idx_t> &slot_ids = snapshot->slot_ids;
+  size_t candidates = snapshot->id_slots.size();
+  if (allowed) {
+    candidates = std::min(candidates, allowed->size());
+  }
+  const int actual_k = std::min(k, static_cast<int>(candidates));
+  if (actual_k <= 0) {
+    return {};
+  }
+
+  std::vector<float> prepared;
+  const std::vector<float> *searched = &query;
+  if (options_.metric == VectorMetric::Cosine) {
+    prepared = query;
+    prepare_vectors(prepared.data(), 1);
+    searched = &prepared;
+  }
+
+  if (allowed && allowed->size() <= EXACT_SEARCH_MAX_CANDIDATES) {
+    return exact_search(*snapshot, *searched, actual_k, *allowed);
+  }
+
+  // Allowed ids become a bitmap over slots up front, so the traversal tests one bit per
+  // visited node instead of hashing its id
+  LiveSlotSelector selector(slot_ids);
+  std::vector<uint8_t> bitmap;
+  std::unique_ptr<faiss::IDSelectorBitmap> allowed_slots;
+  if (allowed) {
+    bitmap = slot_bitmap(*snapshot, *allowed);
+    allowed_slots = std::make_unique<faiss::IDSelectorBitmap>(slot_ids.size(), bitmap.data());
+  }
+  std::vector<float> distances(actual_k);
+  std::vector<faiss::idx_t> slots(actual_k);
+  try {
+    TunedSearchParameters params(index, actual_k, resolved_ef_search(tuning),
+                                 resolved_nprobe(tuning));
+    // Only pay for filtering when something is actually excluded.
+    if (allowed_slots) {
+      params.selected->sel = allowed_slots.get();
+    } else if (snapshot->id_slots.size() != slot_ids.size()) {
+      params.selected->sel = &selector;
+    }
+    index.search(1, searched->data(), actual_k, distances.data(), slots.data(),
+                 params.selected);
+  } catch (const faiss::FaissException &e) {
+    throw VectorIndexError(std::string("Vector index search failed: ") + e.what());
+  }
+  return to_hits(slot_ids, slots.data(), distances.data(), actual_k);
+}
+
+std::vector<std::vector<VectorIndexHit>> VectorIndex::search_batch(
+    const std::vector<float> &queries,
+    int k,
+    const VectorSearchOptions &tuning,
+    const IdFilter *allowed) const {
+  static metrics::Histogram &duration =
+      metrics::histogram("magic_vector_search_seconds", "Vector index searches",
+                         metrics::latency_buckets(), "queries=\"batch\"");
+  metrics::ScopedTimer timer(duration);
+  if (queries.empty() || queries.size() % static_cast<size_t>(dimension_) != 0) {
+    throw VectorIndexError("Query batch of " + std::to_string(queries.size()) +
+                           " floats is not a multiple of the index dimension " +
+                           std::to_string(dimension_));
+  }
+  const size_t count = queries.size() / dimension_;
+
+  const auto snapshot = current();
+  std::shared_lock<std::shared_mutex> lock(snapshot->mutex);
+  const faiss::Index &index = *snapshot->index;
+  const std::vector<faiss::idx_t> &slot_ids = snapshot->slot_ids;
+  size_t candidates = snapshot->id_slots.size();
+  if (allowed) {
+    candidates = std::min(candidates, allowed->size());
+  }
+  const int actual_k = std::min(k, static_cast<int>(candidates));
+  std::vector<std::vector<VectorIndexHit>> results(count);
+  if (actual_k <= 0) {
+    return results;
+  }
+
+  std::vector<float> prepared;
+  const float *searched = queries.data();
+  if (options_.metric == VectorMetric::Cosine) {
+    prepared = queries;
+    prepare_vectors(prepared.data(), count);
+    searched = prepared.data();
+  }
+
+  if (allowed && allowed->size() <= EXACT_SEARCH_MAX_CANDIDATES) {
+    std::vector<float> query(dimension_);
+    for (size_t q = 0; q < count; ++q) {
+      std::copy_n(searched + q * dimension_, dimension_, query.begin());
+      results[q] = exact_search(*snapshot, query, actual_k, *allowed);
+    }
+    return results;
+  }
+
+  if (!allowed && snapshot->gpu_index && count >= options_.gpu_min_batch) {
+    if (auto hits = gpu_search_batch(*snapshot, searched, count, actual_k, tuning)) {
+      return std::move(*hits);
+    }
+  }
+
+  // One call for every query; faiss spreads the queries over its OpenMP threads
+  LiveSlotSelector selector(slot_ids);
+  std::vector<uint8_t> bitmap;
+  std::unique_ptr<faiss::IDSelectorBitmap> allowed_slots;
+  if (allowed) {
+    bitmap = slot_bitmap(*snapshot, *allowed);
+    allowed_slots = std::make_unique<faiss::IDSelectorBitmap>(slot_ids.size(), bitmap.data());
+  }
+  std::vector<float> distances(count * actual_k);
+  std::vector<faiss::idx_t> slots(count * actual_k);
+  try {
+    TunedSearchParameters params(index, actual_k, resolved_ef_search(tuning),
+                                 resolved_nprobe(tuning));
+    if (allowed_slots) {
+      params.selected->sel = allowed_slots.get();
+    } else if (snapshot->id_slots.size() != slot_ids.size()) {
+      params.selected->sel = &selector;
+    }
+    index.search(static_cast<faiss::idx_t>(count), searched, actual_k, distances.data(),
+                 slots.data(), params.selected);
+  } catch (const faiss::FaissException &e) {
+    throw VectorIndexError(std::string("Vector index search failed: ") + e.what());
+  }
+  for (size_t q = 0; q < count; ++q) {
+    results[q] = to_hits(slot_ids, slots.data() + q * actual_k,
+                         distances.data() + q * actual_k, actual_k);
+  }
+  return results;
+}
+
+std::optional<std::vector<std::vector<VectorIndexHit>>> VectorIndex::gpu_search_batch(
+    const Snapshot &snapshot,
+    const float *queries,
+    size_t count,
+    int k,
+    const VectorSearchOptions &tuning) const {
+  // faiss::gpu takes no IDSelector, so tombstones are filtered afterwards: asking for that many
+  // more hits still leaves k live ones
+  const size_t tombstones = snapshot.slot_ids.size() - snapshot.id_slots.size();
+  const size_t fetched = std::min(static_cast<size_t>(k) + tombstones, snapshot.slot_ids.size());
+  if (fetched > static_cast<size_t>(faiss_gpu::MAX_K)) {
+    return std::nullopt;
+  }
+  auto device = faiss_gpu::try_lock(options_.gpu_device);
+  if (!device.owns_lock()) {
+    return std::nullopt;
+  }
+  std::vector<float> distances(count * fetched);
+  std::vector<faiss::idx_t> slots(count * fetched);
+  try {
+    faiss::SearchParametersIVF ivf;
+    ivf.nprobe = static_cast<size_t>(resolved_nprobe(tuning));
+    const bool is_ivf = dynamic_cast<const faiss::IndexIVF *>(snapshot.index.get()) != nullptr;
+    snapshot.gpu_index->search(static_cast<faiss::idx_t>(count), queries,
+                               static_cast<faiss::idx_t>(fetched), distances.data(), slots.data(),
+                               is_ivf ? &ivf : nullptr);
+  } catch (const faiss::FaissException &e) {
+    log::warning() << "GPU search failed, searching on the CPU: " << e.what();
+    return std::nullopt;
+  }
+  device.unlock();
+
+  std::vector<std::vector<VectorIndexHit>> results(count);
+  for (size_t q = 0; q < count; ++q) {
+    results[q] = to_hits(snapshot.slot_ids, slots.data() + q * fetched,
+                         distances.data() + q * fetched, static_cast<int>(fetched));
+    if (results[q].size() > static_cast<size_t>(k)) {
+      results[q].resize(k);
+    }
+  }
+  return results;
+}
+
+std::vector<VectorIndexHit> VectorIndex::to_hits(const std::vector<faiss::idx_t> &slot_ids,
+                                                 const faiss::idx_t *slots,
+                                                 const float *distances,
+                                                 int count) const {
+  std::vector<VectorIndexHit> hits;
+  hits.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    const faiss::idx_t slot = slots[i];
+    if (slot < 0 || slot_ids[slot] == DEAD_SLOT) {
+      continue;
+    }
+    const float distance =
+        options_.metric == VectorMetric::Cosine ? 1.0f - distances[i] : distances[i];
+    hits.push_back({slot_ids[slot], distance});
+  }
+  return hits;
+}
+
+std::vector<uint8_t> VectorIndex::slot_bitmap(const Snapshot &snapshot,
+                                              const IdFilter &allowed) const {
+  // Tombstoned slots are never in id_slots, so their bits stay clear
+  std::vector<uint8_t> bitmap((snapshot.slot_ids.size() + 7) / 8, 0);
+  for (faiss::idx_t id : allowed) {
+    auto it = snapshot.id_slots.find(id);
+    if (it != snapshot.id_slots.end()) {
+      bitmap[it->second >> 3] |= static_cast<uint8_t>(1u << (it->second & 7));
+    }
+  }
+  return bitmap;
+}
+
+int VectorIndex::resolved_ef_search(const VectorSearchOptions &tuning) const {
+  return tuning.ef_search > 0 ? tuning.ef_search : options_.ef_search;
+}
+
+int VectorIndex::resolved_nprobe(const VectorSearchOptions &tuning) const {
+  return tuning.nprobe > 0 ? tuning.nprobe : options_.nprobe;
+}
+
+// Scores each allowed id against its stored vector (decoded, for quantized types). Cost is
+// O(|allowed|), independent of the index size.
+std::vector<VectorIndexHit> VectorIndex::exact_search(const Snapshot &snapshot,
+                                                      const std::vector<float> &query,
+                                                      int k,
+                                                      const IdFilter &allowed) const {
+  std::vector<VectorIndexHit> hits;
+  hits.reserve(std::min(allowed.size(), snapshot.id_slots.size()));
+  std::vector<float> stored(dimension_);
+  try {
+    for (faiss::idx_t id : allowed) {
+      auto it = snapshot.id_slots.find(id);
+      if (it == snapshot.id_slots.end()) {
+        continue;
+      }
+      snapshot.index->reconstruct(it->second, stored.data());
+      const float distance =
+          options_.metric == VectorMetric::Cosine
+              ? 1.0f - vector_math::dot(query.data(), stored.data(), dimension_)
+              : faiss::fvec_L2sqr(query.data(), stored.data(), dimension_);
+      hits.push_back({id, distance});
+    }
+  } catch (const faiss::FaissException &e) {
+    throw VectorIndexError(std::string("Vector index search failed: ") + e.what());
+  }
+  const auto closer = [](const VectorIndexHit &a, const VectorIndexHit &b) {
+    return a.distance < b.distance || (a.distance == b.distance && a.id < b.id);
+  };
+  if (hits.size() > static_cast<size_t>(k)) {
+    std::partial_sort(hits.begin(), hits.begin() + k, hits.end(), closer);
+    hits.resize(k);
+  } else {
+    std::sort(hits.begin(), hits.end(), closer);
+  }
+  return hits;
+}
+
+bool VectorIndex::contains(faiss::idx_t id) const {
+  const auto snapshot = current();
+  std::shared_lock<std::shared_mutex> lock(snapshot->mutex);
+  return snapshot->id_slots.count(id) > 0;
+}
+
+size_t VectorIndex::size() const {
+  const auto snapshot = current();
+  std::shared_lock<std::shared_mutex> lock(snapshot->mutex);
+  return snapshot->id_slots.size();
+}
+
+size_t VectorIndex::tombstone_count() const {
+  const auto snapshot = current();
+  std::shared_lock<std::shared_mutex> lock(snapshot->mutex);
+  return snapshot->slot_ids.size() - snapshot->id_slots.size();
+}
+
+VectorIndexStats VectorIndex::stats() const {
+  const auto snapshot = current();
+  std::shared_lock<std::shared_mutex> lock(snapshot->mutex);
+  VectorIndexStats stats;
+  stats.size = snapshot->id_slots.size();
+  stats.tombstones = snapshot->slot_ids.size() - snapshot->id_slots.size();
+  stats.built_size = snapshot->built_size;
+  stats.uses_configured_type = is_configured_type(*snapshot->index);
+  stats.min_training_vectors = min_training_vectors();
+  stats.gpu = snapshot->gpu_index != nullptr;
+  return stats;
+}
+
+}  // namespace magic_core
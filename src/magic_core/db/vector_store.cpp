@@ -0,0 +1,500 @@
+#include "magic_core/db/vector_store.hpp"
+
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace magic_core {
+
+namespace {
+
+constexpr char MAGIC[4] = {'M', 'F', 'V', 'S'};
+// Counter blocks reserved per record; a record spans ceil(stride / 16) of them
+constexpr int COUNTER_SHIFT = 16;
+
+std::string errno_message() {
+  return std::strerror(errno);
+}
+
+// AES-256-CTR with the key schedule set up once; each record restarts the counter
+class RecordCipher {
+ public:
+  explicit RecordCipher(const unsigned char *key) : ctx_(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free) {
+    if (!ctx_ || EVP_EncryptInit_ex(ctx_.get(), EVP_aes_256_ctr(), nullptr, key, nullptr) != 1) {
+      throw VectorStoreError("Failed to set up vector store cipher");
+    }
+  }
+
+  // Starts the keystream of the record at offset
+  void seek(const unsigned char *nonce, int64_t offset) {
+    unsigned char iv[16];
+    std::memcpy(iv, nonce, 8);
+    const uint64_t counter = static_cast<uint64_t>(offset) << COUNTER_SHIFT;
+    for (int i = 0; i < 8; ++i) {
+      iv[8 + i] = static_cast<unsigned char>(counter >> (56 - 8 * i));
+    }
+    if (EVP_EncryptInit_ex(ctx_.get(), nullptr, nullptr, nullptr, iv) != 1) {
+      throw VectorStoreError("Failed to seek vector store cipher");
+    }
+  }
+
+  // Encrypts or decrypts (the same operation in CTR mode) the next size bytes of the record
+  void apply(const void *in, void *out, size_t size) {
+    int len = 0;
+    if (EVP_EncryptUpdate(ctx_.get(), static_cast<unsigned char *>(out), &len,
+                          static_cast<const unsigned char *>(in), static_cast<int>(size)) != 1) {
+      throw VectorStoreError("Vector store cipher failed");
+    }
+  }
+
+ private:
+  std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx_;
+};
+
+void sync_range(unsigned char *base, size_t begin, size_t end) {
+  const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  const size_t aligned = begin - begin % page;
+  if (::msync(base + aligned, end - aligned, MS_SYNC) != 0) {
+    throw VectorStoreError("Failed to sync vector store: " + errno_message());
+  }
+}
+
+}  // namespace
+
+struct VectorStore::Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t dimension;
+  // A VectorEncoding; files from before encodings existed hold 0, float32
+  uint32_t encoding;
+  int64_t epoch;
+  unsigned char nonce[NONCE_SIZE];
+  uint64_t record_count;
+};
+
+VectorStore::VectorStore(std::filesystem::path path,
+                         const std::string &db_key,
+                         int dimension,
+                         int64_t expected_epoch,
+                         VectorEncoding encoding)
+    : path_(std::move(path)),
+      dimension_(dimension),
+      configured_encoding_(encoding),
+      key_(derive_key(db_key)) {
+  static_assert(sizeof(Header) <= HEADER_SIZE, "header must fit HEADER_SIZE");
+  if (dimension_ <= 0) {
+    throw VectorStoreError("Vector store dimension must be positive");
+  }
+
+  std::error_code ec;
+  const auto compacted = compacted_path();
+  if (std::filesystem::exists(compacted, ec)) {
+    // The database already committed the compacted offsets, so that file is the one in use
+    Header header{};
+    if (read_header(compacted, header) && header.epoch == expected_epoch) {
+      std::filesystem::rename(compacted, path_);
+    } else {
+      std::filesystem::remove(compacted, ec);
+    }
+  }
+
+  const bool created = open_file(expected_epoch);
+  if (!created && epoch_unlocked() != expected_epoch) {
+    const int64_t found = epoch_unlocked();
+    unmap();
+    throw VectorStoreError("Vector store " + path_.string() + " is at epoch " +
+                           std::to_string(found) + " but the database expects " +
+                           std::to_string(expected_epoch));
+  }
+}
+
+VectorStore::VectorStore(std::filesystem::path path,
+                         const Key &key,
+                         int dimension,
+                         int64_t epoch,
+                         VectorEncoding encoding)
+    : path_(std::move(path)), dimension_(dimension), configured_encoding_(encoding), key_(key) {
+  open_file(epoch);
+}
+
+VectorStore::~VectorStore() {
+  unmap();
+}
+
+VectorStore::Key VectorStore::derive_key(const std::string &db_key) {
+  static const std::string label = "magic-folder/vector-store/v1";
+  std::string material = label + db_key;
+  Key key{};
+  unsigned int key_len = 0;
+  if (EVP_Digest(material.data(), material.size(), key.data(), &key_len, EVP_sha256(),
+                 nullptr) != 1 ||
+      key_len != key.size()) {
+    throw VectorStoreError("Failed to derive vector store key");
+  }
+  return key;
+}
+
+bool VectorStore::read_header(const std::filesystem::path &path, Header &header) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  const ssize_t n = ::pread(fd, &header, sizeof(header), 0);
+  ::close(fd);
+  return n == static_cast<ssize_t>(sizeof(header)) &&
+         std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+int VectorStore::stored_dimension(const std::filesystem::path &path) {
+  Header header{};
+  return read_header(path, header) ? static_cast<int>(header.dimension) : 0;
+}
+
+int VectorStore::stored_dimension(const std::filesystem::path &path, int64_t expected_epoch) {
+  Header header{};
+  if (read_header(compacted_path(path), header) && header.epoch == expected_epoch) {
+    return static_cast<int>(header.dimension);
+  }
+  return stored_dimension(path);
+}
+
+bool VectorStore::open_file(int64_t epoch) {
+  fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd_ < 0) {
+    throw VectorStoreError("Could not open vector store " + path_.string() + ": " +
+                           errno_message());
+  }
+  struct stat file_stat {};
+  if (::fstat(fd_, &file_stat) != 0) {
+    unmap();
+    throw VectorStoreError("Could not stat vector store " + path_.string());
+  }
+
+  if (file_stat.st_size == 0) {
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.dimension = static_cast<uint32_t>(dimension_);
+    header.encoding = static_cast<uint32_t>(configured_encoding_);
+    encoding_ = configured_encoding_;
+    header.epoch = epoch;
+    // Fresh per file: a compacted file reuses offsets for different records
+    if (RAND_bytes(header.nonce, NONCE_SIZE) != 1) {
+      unmap();
+      throw VectorStoreError("Failed to generate vector store nonce");
+    }
+    const size_t size = HEADER_SIZE + INITIAL_CAPACITY * stride();
+    if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+      unmap();
+      throw VectorStoreError("Could not size vector store " + path_.string() + ": " +
+                             errno_message());
+    }
+    map(size);
+    std::memcpy(data_, &header, sizeof(header));
+    sync_range(data_, 0, HEADER_SIZE);
+    return true;
+  }
+
+  map(static_cast<size_t>(file_stat.st_size));
+  Header header{};
+  if (mapped_size_ >= HEADER_SIZE) {
+    std::memcpy(&header, data_, sizeof(header));
+  }
+  std::string problem;
+  if (mapped_size_ < HEADER_SIZE || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != FORMAT_VERSION) {
+    problem = "is not a vector store";
+  } else if (header.encoding > static_cast<uint32_t>(VectorEncoding::Int8)) {
+    problem = "has unknown vector encoding " + std::to_string(header.encoding);
+  } else if (header.dimension != static_cast<uint32_t>(dimension_)) {
+    problem = "holds " + std::to_string(header.dimension) + "-dimensional vectors, expected " +
+              std::to_string(dimension_);
+  } else {
+    // The stride depends on the encoding, so it is known before the size check
+    encoding_ = static_cast<VectorEncoding>(header.encoding);
+    if (HEADER_SIZE + header.record_count * stride() > mapped_size_) {
+      problem = "is truncated";
+    }
+  }
+  if (!problem.empty()) {
+    unmap();
+    throw VectorStoreError("Vector store " + path_.string() + " " + problem);
+  }
+  return false;
+}
+
+void VectorStore::map(size_t size) {
+  void *mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (mapping == MAP_FAILED) {
+    const std::string error = errno_message();
+    unmap();
+    throw VectorStoreError("Could not map vector store " + path_.string() + ": " + error);
+  }
+  data_ = static_cast<unsigned char *>(mapping);
+  mapped_size_ = size;
+}
+
+void VectorStore::unmap() noexcept {
+  if (data_) {
+    ::munmap(data_, mapped_size_);
+    data_ = nullptr;
+    mapped_size_ = 0;
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+size_t VectorStore::capacity() const {
+  return (mapped_size_ - HEADER_SIZE) / stride();
+}
+
+void VectorStore::grow_to(size_t records) {
+  if (records <= capacity()) {
+    return;
+  }
+  const size_t new_capacity = std::max(records, capacity() * 2);
+  const size_t size = HEADER_SIZE + new_capacity * stride();
+  if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+    throw VectorStoreError("Could not grow vector store " + path_.string() + ": " +
+                           errno_message());
+  }
+  ::munmap(data_, mapped_size_);
+  data_ = nullptr;
+  map(size);
+}
+
+void VectorStore::write_header(uint64_t record_count) {
+  std::memcpy(data_ + offsetof(Header, record_count), &record_count, sizeof(record_count));
+  sync_range(data_, 0, HEADER_SIZE);
+}
+
+std::vector<VectorStore::Offset> VectorStore::append(const std::vector<int64_t> &keys,
+                                                     const float *vectors) {
+  std::vector<Offset> offsets;
+  if (keys.empty()) {
+    return offsets;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  const size_t first = count_unlocked();
+  grow_to(first + keys.size());
+  // Count the records before writing them: after a crash the space is skipped rather than
+  // rewritten, which would reuse its keystream
+  write_header(first + keys.size());
+
+  Header header{};
+  std::memcpy(&header, data_, sizeof(header));
+  RecordCipher cipher(key_.data());
+  const size_t vector_bytes = encoded_vector_size(encoding_, dimension_);
+  std::vector<unsigned char> encoded(encoding_ == VectorEncoding::Float32 ? 0 : vector_bytes);
+  offsets.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const Offset offset = static_cast<Offset>(first + i);
+    unsigned char *record = data_ + HEADER_SIZE + static_cast<size_t>(offset) * stride();
+    const float *vector = vectors + i * dimension_;
+    cipher.seek(header.nonce, offset);
+    cipher.apply(&keys[i], record, sizeof(int64_t));
+    if (encoding_ == VectorEncoding::Float32) {
+      cipher.apply(vector, record + sizeof(int64_t), vector_bytes);
+    } else {
+      encode_vector(encoding_, vector, dimension_, encoded.data());
+      cipher.apply(encoded.data(), record + sizeof(int64_t), vector_bytes);
+    }
+    offsets.push_back(offset);
+  }
+  sync_range(data_, HEADER_SIZE + first * stride(), HEADER_SIZE + (first + keys.size()) * stride());
+  return offsets;
+}
+
+VectorStore::Offset VectorStore::append(int64_t key, const std::vector<float> &vector) {
+  if (vector.size() != static_cast<size_t>(dimension_)) {
+    throw VectorStoreError("Vector of " + std::to_string(vector.size()) +
+                           " floats does not match the store dimension " +
+                           std::to_string(dimension_));
+  }
+  return append(std::vector<int64_t>{key}, vector.data()).front();
+}
+
+bool VectorStore::read(Offset offset, int64_t key, float *out) const {
+  return read_many({offset}, {key}, out).front();
+}
+
+std::vector<bool> VectorStore::read_many(const std::vector<Offset> &offsets,
+                                         const std::vector<int64_t> &keys,
+                                         float *out) const {
+  std::vector<bool> found(offsets.size(), false);
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  Header header{};
+  std::memcpy(&header, data_, sizeof(header));
+  RecordCipher cipher(key_.data());
+  const size_t vector_bytes = encoded_vector_size(encoding_, dimension_);
+  std::vector<unsigned char> encoded(encoding_ == VectorEncoding::Float32 ? 0 : vector_bytes);
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    const Offset offset = offsets[i];
+    if (offset < 0 || static_cast<uint64_t>(offset) >= header.record_count) {
+      continue;
+    }
+    const unsigned char *record = data_ + HEADER_SIZE + static_cast<size_t>(offset) * stride();
+    int64_t stored_key = 0;
+    cipher.seek(header.nonce, offset);
+    cipher.apply(record, &stored_key, sizeof(stored_key));
+    if (stored_key != keys[i]) {
+      continue;
+    }
+    if (encoding_ == VectorEncoding::Float32) {
+      cipher.apply(record + sizeof(int64_t), out + i * dimension_, vector_bytes);
+    } else {
+      cipher.apply(record + sizeof(int64_t), encoded.data(), vector_bytes);
+      decode_vector(encoding_, encoded.data(), dimension_, out + i * dimension_);
+    }
+    found[i] = true;
+  }
+  return found;
+}
+
+void VectorStore::write_compacted(const std::vector<Offset> &offsets,
+                                  const std::vector<int64_t> &keys) {
+  const auto target = compacted_path();
+  std::error_code ec;
+  std::filesystem::remove(target, ec);
+  VectorStore compacted(target, key_, dimension_, epoch() + 1, configured_encoding_);
+  // Copied in bounded batches so a large store never needs a second full copy in memory
+  constexpr size_t BATCH = 4096;
+  std::vector<float> buffer;
+  for (size_t begin = 0; begin < offsets.size(); begin += BATCH) {
+    const size_t end = std::min(offsets.size(), begin + BATCH);
+    const std::vector<Offset> batch_offsets(offsets.begin() + begin, offsets.begin() + end);
+    const std::vector<int64_t> batch_keys(keys.begin() + begin, keys.begin() + end);
+    buffer.resize(batch_offsets.size() * dimension_);
+    const auto found = read_many(batch_offsets, batch_keys, buffer.data());
+    if (std::find(found.begin(), found.end(), false) != found.end()) {
+      throw VectorStoreError("Vector store " + path_.string() +
+                             " is missing records it was asked to keep");
+    }
+    compacted.append(batch_keys, buffer.data());
+  }
+}
+
+void VectorStore::install_compacted() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  unmap();
+  std::filesystem::rename(compacted_path(), path_);
+  open_file(0);
+}
+
+size_t VectorStore::prefault() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  const size_t used = HEADER_SIZE + count_unlocked() * stride();
+  // The hint starts the reads ahead; touching a byte of each page waits for them
+  ::madvise(data_, used, MADV_WILLNEED);
+  const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  unsigned char sum = 0;
+  for (size_t at = 0; at < used; at += page) {
+    sum ^= static_cast<volatile const unsigned char *>(data_)[at];
+  }
+  (void)sum;
+  return used;
+}
+
+size_t VectorStore::copy_to(const std::filesystem::path &destination,
+                            size_t records,
+                            const std::function<void(size_t)> &after_step) const {
+  std::ofstream out(destination, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw VectorStoreError("Could not create " + destination.string() + ": " + errno_message());
+  }
+  int64_t epoch = 0;
+  size_t total = HEADER_SIZE;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (records > count_unlocked()) {
+      throw VectorStoreError("Vector store " + path_.string() + " holds fewer than " +
+                             std::to_string(records) + " records");
+    }
+    epoch = epoch_unlocked();
+    total += records * stride();
+    unsigned char header[HEADER_SIZE];
+    std::memcpy(header, data_, HEADER_SIZE);
+    const uint64_t count = records;
+    std::memcpy(header + offsetof(Header, record_count), &count, sizeof(count));
+    out.write(reinterpret_cast<const char *>(header), HEADER_SIZE);
+  }
+  for (size_t copied = HEADER_SIZE; copied < total;) {
+    const size_t bytes = std::min(COPY_STEP_BYTES, total - copied);
+    {
+      // An append that grows the file remaps it, so data_ is only good under the lock
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      if (epoch_unlocked() != epoch) {
+        throw VectorStoreError("Vector store " + path_.string() +
+                               " was compacted while it was copied");
+      }
+      out.write(reinterpret_cast<const char *>(data_ + copied),
+                static_cast<std::streamsize>(bytes));
+    }
+    copied += bytes;
+    if (after_step) {
+      after_step(bytes);
+    }
+  }
+  out.flush();
+  if (!out) {
+    throw VectorStoreError("Could not write " + destination.string() + ": " + errno_message());
+  }
+  return total;
+}
+
+size_t VectorStore::copy_size(size_t records) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return HEADER_SIZE + records * stride();
+}
+
+size_t VectorStore::record_count() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return count_unlocked();
+}
+
+VectorEncoding VectorStore::encoding() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return encoding_;
+}
+
+int64_t VectorStore::epoch() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return epoch_unlocked();
+}
+
+size_t VectorStore::count_unlocked() const {
+  uint64_t count = 0;
+  std::memcpy(&count, data_ + offsetof(Header, record_count), sizeof(count));
+  return static_cast<size_t>(count);
+}
+
+int64_t VectorStore::epoch_unlocked() const {
+  int64_t value = 0;
+  std::memcpy(&value, data_ + offsetof(Header, epoch), sizeof(value));
+  return value;
+}
+
+std::filesystem::path VectorStore::compacted_path() const {
+  return compacted_path(path_);
+}
+
+std::filesystem::path VectorStore::compacted_path(const std::filesystem::path &path) {
+  std::filesystem::path compacted = path;
+  compacted += ".compact";
+  return compacted;
+}
+
+}  // namespace magic_core
@@ -0,0 +1,89 @@
+#include "magic_core/extractors/code_extractor.hpp"
+
+#include <string>
+#include <unordered_map>
+
+#include "magic_core/extractors/mapped_file.hpp"
+
+namespace magic_core {
+
+std::optional<CodeExtractor::Syntax> CodeExtractor::syntax_for(const fs::path& file_path) {
+    static const std::unordered_map<std::string, Syntax> SYNTAX_BY_EXTENSION = [] {
+        const Syntax c_family{Language::Brace, {.backtick_strings = false, .preprocessor = true}};
+        const Syntax braces{Language::Brace, {}};
+        const Syntax backticks{Language::Brace, {.backtick_strings = true}};
+        const Syntax python{Language::Python, {}};
+        std::unordered_map<std::string, Syntax> map;
+        for (const char* extension : {".c", ".h", ".cc", ".cpp", ".cxx", ".hh", ".hpp", ".hxx",
+                                      ".m", ".mm"}) {
+            map.emplace(extension, c_family);
+        }
+        for (const char* extension : {".java", ".kt", ".kts", ".scala", ".cs", ".rs", ".swift",
+                                      ".php"}) {
+            map.emplace(extension, braces);
+        }
+        for (const char* extension : {".go", ".js", ".jsx", ".mjs", ".cjs", ".ts", ".tsx"}) {
+            map.emplace(extension, backticks);
+        }
+        for (const char* extension : {".py", ".pyi"}) {
+            map.emplace(extension, python);
+        }
+        return map;
+    }();
+    auto it = SYNTAX_BY_EXTENSION.find(file_path.extension().string());
+    if (it == SYNTAX_BY_EXTENSION.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+bool CodeExtractor::can_handle(const std::filesystem::path& file_path) const {
+    return syntax_for(file_path).has_value();
+}
+
+FileType CodeExtractor::get_file_type() const {
+    return FileType::Code;
+}
+
+ExtractionResult CodeExtractor::extract_with_hash(const std::filesystem::path& file_path) const {
+    std::optional<Syntax> syntax = syntax_for(file_path);
+    if (!syntax) {
+        throw ContentExtractorError("Not a supported source file: " + file_path.string());
+    }
+    // Hash and chunk straight from the mapping; only the chunks themselves are copied
+    MappedFile file(file_path);
+    std::string_view content = file.view();
+    if (content.empty()) {
+        return {"", {}};
+    }
+    return {compute_hash_from_content(content), extract_chunks_from_content(content, *syntax)};
+}
+
+void CodeExtractor::stream_chunks(const std::filesystem::path& file_path,
+                                  const ChunkSink& sink) const {
+    std::optional<Syntax> syntax = syntax_for(file_path);
+    if (!syntax) {
+        throw ContentExtractorError("Not a supported source file: " + file_path.string());
+    }
+    MappedFile file(file_path);
+    std::string_view content = file.view();
+    stream_built_chunks(content, section_starts(content, *syntax), sink);
+}
+
+std::vector<Chunk> CodeExtractor::get_chunks(const std::filesystem::path& file_path) const {
+    return extract_with_hash(file_path).chunks;
+}
+
+std::vector<size_t> CodeExtractor::section_starts(std::string_view content, const Syntax& syntax) {
+    // Each declaration is a section; small ones merge until TARGET_MIN_TOKENS
+    return syntax.language == Language::Python
+               ? find_python_declaration_starts(content)
+               : find_brace_declaration_starts(content, syntax.brace);
+}
+
+std::vector<Chunk> CodeExtractor::extract_chunks_from_content(std::string_view content,
+                                                              const Syntax& syntax) const {
+    return build_chunks(content, section_starts(content, syntax));
+}
+
+}  // namespace magic_core
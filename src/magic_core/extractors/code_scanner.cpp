@@ -0,0 +1,374 @@
+#include "magic_core/extractors/code_scanner.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace magic_core {
+
+namespace {
+
+constexpr std::string_view SCOPE_KEYWORDS[] = {
+    "class",  "struct", "namespace", "enum",   "union",    "interface", "impl",      "trait",
+    "mod",    "object", "extern",    "module", "protocol", "extension", "record"};
+
+bool is_identifier_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' ||
+         c == '$';
+}
+
+bool is_blank_char(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+bool is_scope_keyword(std::string_view word) {
+  return std::find(std::begin(SCOPE_KEYWORDS), std::end(SCOPE_KEYWORDS), word) !=
+         std::end(SCOPE_KEYWORDS);
+}
+
+size_t line_end(std::string_view text, size_t from) {
+  size_t end = text.find('\n', from);
+  return end == std::string_view::npos ? text.size() : end;
+}
+
+// Offset just past the literal whose opening quote is at open. Unless multiline, an
+// unterminated literal ends at the line break.
+size_t skip_quoted(std::string_view text, size_t open, bool multiline) {
+  const char quote = text[open];
+  size_t i = open + 1;
+  while (i < text.size()) {
+    const char c = text[i];
+    if (c == '\\') {
+      i += 2;
+      continue;
+    }
+    if (c == quote) {
+      return i + 1;
+    }
+    if (c == '\n' && !multiline) {
+      return i;
+    }
+    ++i;
+  }
+  return text.size();
+}
+
+// Offset just past a character literal at open, or open + 1 if the quote does not start one
+// (a Rust lifetime, a C++14 digit separator)
+size_t skip_char_literal(std::string_view text, size_t open) {
+  size_t i = open + 1;
+  if (i < text.size() && text[i] == '\\') {
+    // '\n', '\x41', 'é'
+    const size_t limit = std::min(text.size(), open + 12);
+    for (i += 2; i < limit && text[i] != '\n'; ++i) {
+      if (text[i] == '\'') {
+        return i + 1;
+      }
+    }
+    return open + 1;
+  }
+  // One UTF-8 code point, then the closing quote
+  if (i < text.size()) {
+    ++i;
+    while (i < text.size() && (static_cast<unsigned char>(text[i]) & 0xC0) == 0x80) {
+      ++i;
+    }
+  }
+  return i < text.size() && text[i] == '\'' ? i + 1 : open + 1;
+}
+
+// Offset just past a C++ raw string R"delim(...)delim" whose quote is at open, or 0 if it is
+// not one
+size_t skip_raw_string(std::string_view text, size_t open) {
+  if (open == 0 || text[open - 1] != 'R') {
+    return 0;
+  }
+  const size_t paren = text.find('(', open + 1);
+  if (paren == std::string_view::npos || paren - open > 17) {
+    return 0;
+  }
+  std::string closing = ")";
+  closing.append(text.substr(open + 1, paren - open - 1));
+  closing += '"';
+  const size_t close = text.find(closing, paren + 1);
+  return close == std::string_view::npos ? text.size() : close + closing.size();
+}
+
+// Offset of the end of a preprocessor directive starting at from, through backslash
+// continuations
+size_t directive_end(std::string_view text, size_t from) {
+  size_t end = line_end(text, from);
+  while (end < text.size()) {
+    size_t last = end;
+    while (last > from && (text[last - 1] == '\r' || text[last - 1] == ' ')) {
+      --last;
+    }
+    if (last == from || text[last - 1] != '\\') {
+      break;
+    }
+    end = line_end(text, end + 1);
+  }
+  return end;
+}
+
+}  // namespace
+
+std::vector<size_t> find_brace_declaration_starts(std::string_view text, BraceSyntax syntax) {
+  std::vector<size_t> starts;
+  // Open braces, true for class-like scopes, and how many of them are other blocks
+  std::vector<bool> braces;
+  size_t open_blocks = 0;
+  // Open parentheses and brackets
+  size_t nesting = 0;
+  // The last statement or block at a declaration scope is complete, so the next line starts
+  // a new declaration
+  bool item_done = true;
+  // A scope keyword came before any parenthesis in the current statement
+  bool item_is_scope = false;
+  bool item_has_paren = false;
+
+  auto at_declaration_scope = [&] { return open_blocks == 0 && nesting == 0; };
+  auto end_item = [&] {
+    item_is_scope = false;
+    item_has_paren = false;
+    if (at_declaration_scope()) {
+      item_done = true;
+    }
+  };
+
+  size_t line = 0;
+  while (line < text.size()) {
+    size_t first = line;
+    while (first < text.size() && is_blank_char(text[first])) {
+      ++first;
+    }
+    if (first == text.size() || text[first] == '\n') {
+      if (at_declaration_scope()) {
+        item_done = true;
+      }
+      line = first + 1;
+      continue;
+    }
+    // A closing brace or parenthesis ends what came before rather than starting something
+    if (at_declaration_scope() && item_done && text[first] != '}' && text[first] != ')' &&
+        text[first] != '{') {
+      if (line > 0) {
+        starts.push_back(line);
+      }
+      item_done = false;
+    }
+    if (syntax.preprocessor && text[first] == '#' && first + 1 < text.size() &&
+        text[first + 1] != '[' && text[first + 1] != '!') {
+      line = directive_end(text, first) + 1;
+      end_item();
+      continue;
+    }
+
+    size_t pos = first;
+    while (pos < text.size() && text[pos] != '\n') {
+      const char c = text[pos];
+      const char next = pos + 1 < text.size() ? text[pos + 1] : '\0';
+      if (c == '/' && next == '/') {
+        pos = line_end(text, pos);
+        break;
+      }
+      if (c == '/' && next == '*') {
+        // May run over several lines, which are then skipped whole
+        const size_t close = text.find("*/", pos + 2);
+        pos = close == std::string_view::npos ? text.size() : close + 2;
+        continue;
+      }
+      if (c == '"') {
+        const size_t raw = syntax.preprocessor ? skip_raw_string(text, pos) : 0;
+        pos = raw ? raw : skip_quoted(text, pos, false);
+        continue;
+      }
+      if (c == '\'') {
+        pos = skip_char_literal(text, pos);
+        continue;
+      }
+      if (c == '`' && syntax.backtick_strings) {
+        pos = skip_quoted(text, pos, true);
+        continue;
+      }
+      if (is_identifier_char(c)) {
+        size_t end = pos + 1;
+        while (end < text.size() && is_identifier_char(text[end])) {
+          ++end;
+        }
+        if (!item_has_paren && is_scope_keyword(text.substr(pos, end - pos))) {
+          item_is_scope = true;
+        }
+        pos = end;
+        continue;
+      }
+      switch (c) {
+        case '(':
+          item_has_paren = true;
+          ++nesting;
+          break;
+        case '[':
+          ++nesting;
+          break;
+        case ')':
+        case ']':
+          if (nesting > 0) {
+            --nesting;
+          }
+          break;
+        case '{': {
+          const bool scope = item_is_scope && at_declaration_scope();
+          braces.push_back(scope);
+          if (!scope) {
+            ++open_blocks;
+          }
+          item_is_scope = false;
+          item_has_paren = false;
+          // The first member of a class or namespace starts a declaration of its own
+          if (scope) {
+            item_done = true;
+          }
+          break;
+        }
+        case '}':
+          if (!braces.empty()) {
+            if (!braces.back()) {
+              --open_blocks;
+            }
+            braces.pop_back();
+          }
+          end_item();
+          break;
+        case ';':
+          end_item();
+          break;
+        default:
+          break;
+      }
+      ++pos;
+    }
+    line = pos + 1;
+  }
+  return starts;
+}
+
+std::vector<size_t> find_python_declaration_starts(std::string_view text) {
+  struct Scope {
+    size_t indent;
+    bool is_class;
+  };
+  std::vector<Scope> scopes;
+  size_t open_functions = 0;
+  // Open parentheses, brackets and braces, which continue a logical line
+  size_t nesting = 0;
+  bool continued = false;
+  // First of the comment lines right above the current line
+  size_t comment_start = std::string_view::npos;
+  bool after_decorator = false;
+
+  auto starts_with_word = [&](size_t at, std::string_view word) {
+    if (text.substr(at, word.size()) != word) {
+      return false;
+    }
+    const size_t after = at + word.size();
+    return after == text.size() || !is_identifier_char(text[after]);
+  };
+
+  std::vector<size_t> starts;
+  size_t line = 0;
+  while (line < text.size()) {
+    size_t pos = line;
+    if (nesting == 0 && !continued) {
+      size_t indent = 0;
+      size_t first = line;
+      while (first < text.size() && is_blank_char(text[first])) {
+        indent = text[first] == '\t' ? (indent / 8 + 1) * 8 : indent + 1;
+        ++first;
+      }
+      if (first == text.size() || text[first] == '\n') {
+        comment_start = std::string_view::npos;
+        line = first + 1;
+        continue;
+      }
+      if (text[first] == '#') {
+        if (comment_start == std::string_view::npos) {
+          comment_start = line;
+        }
+        line = line_end(text, first) + 1;
+        continue;
+      }
+
+      bool left_body = false;
+      while (!scopes.empty() && scopes.back().indent >= indent) {
+        if (!scopes.back().is_class) {
+          --open_functions;
+        }
+        scopes.pop_back();
+        left_body = true;
+      }
+      const bool decorator = text[first] == '@';
+      const bool is_class = starts_with_word(first, "class");
+      size_t def_at = first;
+      if (starts_with_word(first, "async")) {
+        def_at = first + 5;
+        while (def_at < text.size() && is_blank_char(text[def_at])) {
+          ++def_at;
+        }
+      }
+      const bool is_def = starts_with_word(def_at, "def");
+
+      if (open_functions == 0) {
+        const bool declaration = decorator || is_class || is_def;
+        if (declaration ? !after_decorator : left_body) {
+          const size_t at = comment_start != std::string_view::npos ? comment_start : line;
+          if (at > 0) {
+            starts.push_back(at);
+          }
+        }
+      }
+      after_decorator = decorator;
+      comment_start = std::string_view::npos;
+      if (is_class || is_def) {
+        scopes.push_back({indent, is_class});
+        if (is_def) {
+          ++open_functions;
+        }
+      }
+      pos = first;
+    }
+
+    continued = false;
+    while (pos < text.size() && text[pos] != '\n') {
+      const char c = text[pos];
+      if (c == '#') {
+        pos = line_end(text, pos);
+        break;
+      }
+      if (c == '"' || c == '\'') {
+        const std::string_view triple = text.substr(pos, 3);
+        if (triple == R"(""")" || triple == "'''") {
+          const size_t close = text.find(triple, pos + 3);
+          pos = close == std::string_view::npos ? text.size() : close + 3;
+        } else {
+          pos = skip_quoted(text, pos, false);
+        }
+        continue;
+      }
+      if (c == '(' || c == '[' || c == '{') {
+        ++nesting;
+      } else if ((c == ')' || c == ']' || c == '}') && nesting > 0) {
+        --nesting;
+      } else if (c == '\\' && (pos + 1 == text.size() || text[pos + 1] == '\n' ||
+                               (text[pos + 1] == '\r' && pos + 2 < text.size() &&
+                                text[pos + 2] == '\n'))) {
+        continued = true;
+      }
+      ++pos;
+    }
+    line = pos + 1;
+  }
+  return starts;
+}
+
+}  // namespace magic_core
@@ -1,68 +1,250 @@
 #include "magic_core/extractors/content_extractor.hpp"
-#include <utf8.h>
 #include <openssl/evp.h>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <fstream>
 #include <iomanip>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace magic_core {
 
-std::string ContentExtractor::get_string_content(const fs::path& file_path) const {
-  std::ifstream file_stream(file_path);
-  if (!file_stream.is_open()) {
-    throw ContentExtractorError("Could not open file: " + file_path.string());
-  }
-
-  std::stringstream buffer;
-  buffer << file_stream.rdbuf();
-  const std::string content = buffer.str();
-  return content;
-}
+ContentExtractor::ContentExtractor(std::shared_ptr<const Tokenizer> tokenizer)
+    : tokenizer_(tokenizer ? std::move(tokenizer)
+                           : std::make_shared<ApproximateTokenizer>(CHAR_PER_TOKEN_ESTIMATE)) {}
 
 FileType ContentExtractor::get_file_type() const {
   return FileType::Unknown;
 }
-// New helper method for computing hash from already-loaded content
-std::string ContentExtractor::compute_hash_from_content(const std::string& content) const {
-  EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
+
+void ContentExtractor::stream_chunks(const fs::path& file_path, const ChunkSink& sink) const {
+  std::vector<Chunk> chunks = extract_with_hash(file_path).chunks;
+  sink(chunks, 1.0f);
+}
+
+namespace {
+
+using DigestCtx = std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>;
+
+DigestCtx new_sha256_context() {
+  DigestCtx mdctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
   if (!mdctx) {
     throw ContentExtractorError("Failed to create EVP context for hashing");
   }
-
-  if (EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr) != 1) {
-    EVP_MD_CTX_free(mdctx);
+  if (EVP_DigestInit_ex(mdctx.get(), EVP_sha256(), nullptr) != 1) {
     throw ContentExtractorError("Failed to initialize SHA256 digest");
   }
+  return mdctx;
+}
 
-  // Hash the content - handle empty strings properly
-  if (!content.empty()) {
-    if (EVP_DigestUpdate(mdctx, content.data(), content.length()) != 1) {
-      EVP_MD_CTX_free(mdctx);
-      throw ContentExtractorError("Failed to update SHA256 digest");
-    }
+void update_digest(EVP_MD_CTX* mdctx, const char* data, size_t size) {
+  // Hash the content - handle empty reads properly
+  if (size > 0 && EVP_DigestUpdate(mdctx, data, size) != 1) {
+    throw ContentExtractorError("Failed to update SHA256 digest");
   }
+}
 
+std::string finalize_hex_digest(EVP_MD_CTX* mdctx) {
   unsigned char hash[EVP_MAX_MD_SIZE];
   unsigned int hash_len;
   if (EVP_DigestFinal_ex(mdctx, hash, &hash_len) != 1) {
-    EVP_MD_CTX_free(mdctx);
     throw ContentExtractorError("Failed to finalize SHA256 digest");
   }
 
-  EVP_MD_CTX_free(mdctx);
-
   std::stringstream ss;
   for (unsigned int i = 0; i < hash_len; i++) {
     ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
   }
-
   return ss.str();
 }
 
+}  // namespace
+
+// New helper method for computing hash from already-loaded content
+std::string ContentExtractor::compute_hash_from_content(std::string_view content) const {
+  DigestCtx mdctx = new_sha256_context();
+  update_digest(mdctx.get(), content.data(), content.length());
+  return finalize_hex_digest(mdctx.get());
+}
+
+// Streams the file through the digest in fixed-size blocks, so hashing for dedupe needs
+// constant memory and never materializes the content as a string. The result is identical
+// to compute_hash_from_content over the whole file.
 std::string ContentExtractor::get_content_hash(const fs::path& file_path) const {
-  std::string content = get_string_content(file_path);
-  return compute_hash_from_content(content);
+  std::ifstream file_stream(file_path, std::ios::binary);
+  if (!file_stream.is_open()) {
+    throw ContentExtractorError("Could not open file: " + file_path.string());
+  }
+
+  DigestCtx mdctx = new_sha256_context();
+  std::vector<char> block(HASH_BLOCK_SIZE);
+  while (file_stream) {
+    file_stream.read(block.data(), static_cast<std::streamsize>(block.size()));
+    update_digest(mdctx.get(), block.data(), static_cast<size_t>(file_stream.gcount()));
+  }
+  if (file_stream.bad()) {
+    throw ContentExtractorError("Failed to read file: " + file_path.string());
+  }
+  return finalize_hex_digest(mdctx.get());
+}
+
+std::vector<ContentExtractor::Region> ContentExtractor::split_regions(
+    std::string_view content, const std::vector<size_t>& section_starts) {
+  // Cut the document into regions of at least PARALLEL_REGION_SIZE bytes, each starting at a
+  // section boundary. Regions never merge across that boundary, so they chunk independently.
+  // Small documents are a single region.
+  std::vector<Region> regions;
+  size_t region_begin = 0;
+  size_t first_start = 0;
+  for (size_t i = 0; i < section_starts.size(); ++i) {
+    const size_t start = section_starts[i];
+    if (start < content.size() && start - region_begin >= PARALLEL_REGION_SIZE &&
+        content.size() - start >= PARALLEL_REGION_SIZE) {
+      regions.push_back({region_begin, start, first_start, i});
+      region_begin = start;
+      first_start = i;
+    }
+  }
+  regions.push_back({region_begin, content.size(), first_start, section_starts.size()});
+  return regions;
+}
+
+std::vector<Chunk> ContentExtractor::build_chunks(std::string_view content,
+                                                  const std::vector<size_t>& section_starts) const {
+  if (content.empty()) {
+    return {};
+  }
+
+  const std::vector<Region> regions = split_regions(content, section_starts);
+  std::vector<std::vector<Chunk>> region_chunks(regions.size());
+  auto build = [&](size_t r) {
+    const Region& region = regions[r];
+    build_region(content.substr(region.begin, region.end - region.begin), region.begin,
+                 section_starts.data() + region.first_start,
+                 section_starts.data() + region.last_start, region_chunks[r]);
+  };
+
+  const size_t num_threads = std::min(
+      {regions.size(), MAX_EXTRACTION_THREADS,
+       static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()))});
+  if (num_threads <= 1) {
+    for (size_t r = 0; r < regions.size(); ++r) {
+      build(r);
+    }
+  } else {
+    // Each thread claims the next unbuilt region; the first failure is rethrown here
+    std::atomic<size_t> next_region{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (size_t n = 0; n < num_threads; ++n) {
+      threads.emplace_back([&] {
+        try {
+          for (size_t r = next_region++; r < regions.size(); r = next_region++) {
+            build(r);
+          }
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  if (region_chunks.size() == 1) {
+    return std::move(region_chunks.front());
+  }
+  size_t total = 0;
+  for (const auto& chunks : region_chunks) {
+    total += chunks.size();
+  }
+  std::vector<Chunk> chunks;
+  chunks.reserve(total);
+  for (auto& region : region_chunks) {
+    for (Chunk& chunk : region) {
+      chunk.chunk_index = static_cast<int>(chunks.size());
+      chunks.push_back(std::move(chunk));
+    }
+  }
+  return chunks;
+}
+
+void ContentExtractor::stream_built_chunks(std::string_view content,
+                                           const std::vector<size_t>& section_starts,
+                                           const ChunkSink& sink) const {
+  std::vector<Chunk> chunks;
+  if (content.empty()) {
+    sink(chunks, 1.0f);
+    return;
+  }
+  // The same regions as build_chunks, so both produce the same chunks
+  int next_index = 0;
+  for (const Region& region : split_regions(content, section_starts)) {
+    chunks.clear();
+    build_region(content.substr(region.begin, region.end - region.begin), region.begin,
+                 section_starts.data() + region.first_start,
+                 section_starts.data() + region.last_start, chunks);
+    for (Chunk& chunk : chunks) {
+      chunk.chunk_index = next_index++;
+    }
+    sink(chunks, static_cast<float>(region.end) / static_cast<float>(content.size()));
+  }
+}
+
+void ContentExtractor::build_region(std::string_view region, size_t offset,
+                                    const size_t* starts_begin, const size_t* starts_end,
+                                    std::vector<Chunk>& chunks) const {
+  // Every chunk but the last holds at least TARGET_MIN_TOKENS, about MIN_CHUNK_SIZE bytes
+  chunks.reserve(
+      std::min(static_cast<size_t>(starts_end - starts_begin), region.size() / MIN_CHUNK_SIZE) +
+      1);
+
+  auto emit = [&](std::string_view chunk_content) {
+    if (tokenizer_->count_tokens(chunk_content) <= TARGET_MAX_TOKENS) {
+      Chunk chunk{.content = std::string(chunk_content),
+                  .chunk_index = static_cast<int>(chunks.size())};
+      chunks.push_back(std::move(chunk));
+      return;
+    }
+    // The merged chunk is too large, apply the fixed-size fallback
+    for (std::string_view small_chunk : split_into_fixed_views(chunk_content)) {
+      Chunk chunk{.content = std::string(small_chunk),
+                  .chunk_index = static_cast<int>(chunks.size())};
+      chunks.push_back(std::move(chunk));
+    }
+  };
+
+  // Sections are contiguous, so the sections merged so far are always [merge_start, end). A
+  // run is recounted as it grows, but it stays below TARGET_MIN_TOKENS until it is emitted.
+  size_t merge_start = 0;
+  for (const size_t* start = starts_begin; start != starts_end; ++start) {
+    const size_t end = *start - offset;
+    if (end > merge_start &&
+        tokenizer_->count_tokens(region.substr(merge_start, end - merge_start)) >=
+            TARGET_MIN_TOKENS) {
+      emit(region.substr(merge_start, end - merge_start));
+      merge_start = end;
+    }
+  }
+  // Whatever is left, however short, becomes the last chunk
+  if (merge_start < region.size()) {
+    emit(region.substr(merge_start));
+  }
 }
 
 /**
@@ -70,24 +252,18 @@ std::string ContentExtractor::get_content_hash(const fs::path& file_path) const
  *
  */
 std::vector<std::string> ContentExtractor::split_into_fixed_chunks(const std::string& text) const {
-  std::vector<std::string> out;
-  if (text.empty())
-    return out;
-
-  size_t bytes_in_chunk = 0;
-  auto chunk_start = text.begin();
-
-  for (auto it = text.begin(); it != text.end(); utf8::next(it, text.end())) {
-    bytes_in_chunk = it - chunk_start;
-    if (bytes_in_chunk >= FIXED_CHUNK_SIZE - OVERLAP_SIZE) {
-      out.emplace_back(chunk_start, it);  // up to, but *not* including it
-      chunk_start = it;
-    }
-  }
-  // last chunk
-  if (chunk_start != text.end())
-    out.emplace_back(chunk_start, text.end());
+  std::vector<std::string_view> views = split_into_fixed_views(text);
+  return std::vector<std::string>(views.begin(), views.end());
+}
 
+std::vector<std::string_view> ContentExtractor::split_into_fixed_views(std::string_view text) const {
+  std::vector<std::string_view> out;
+  // Pieces of FIXED less OVERLAP tokens, cut on code point boundaries
+  while (!text.empty()) {
+    size_t length = tokenizer_->prefix_length(text, TARGET_FIXED_TOKENS - TARGET_OVERLAP_TOKENS);
+    out.emplace_back(text.substr(0, length));
+    text.remove_prefix(length);
+  }
   return out;
 }
 }  // namespace magic_core
\ No newline at end of file
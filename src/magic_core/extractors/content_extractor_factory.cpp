@@ -1,14 +1,18 @@
 #include "magic_core/extractors/content_extractor_factory.hpp"
+#include "magic_core/extractors/code_extractor.hpp"
 #include "magic_core/extractors/markdown_extractor.hpp"
+#include "magic_core/extractors/pdf_extractor.hpp"
 #include "magic_core/extractors/plaintext_extractor.hpp"
 #include "magic_core/extractors/content_extractor.hpp"
 
 #include <stdexcept>
 
 namespace magic_core {
-ContentExtractorFactory::ContentExtractorFactory() {
-    extractors.push_back(std::make_unique<MarkdownExtractor>());
-    extractors.push_back(std::make_unique<PlainTextExtractor>());
+ContentExtractorFactory::ContentExtractorFactory(std::shared_ptr<const Tokenizer> tokenizer) {
+    extractors.push_back(std::make_unique<MarkdownExtractor>(tokenizer));
+    extractors.push_back(std::make_unique<PlainTextExtractor>(tokenizer));
+    extractors.push_back(std::make_unique<PdfExtractor>(tokenizer));
+    extractors.push_back(std::make_unique<CodeExtractor>(tokenizer));
 }
 
 const ContentExtractor& ContentExtractorFactory::get_extractor_for(
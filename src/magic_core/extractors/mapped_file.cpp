@@ -0,0 +1,93 @@
+#include "magic_core/extractors/mapped_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#include "magic_core/extractors/content_extractor.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAGIC_HAVE_MMAP 1
+#endif
+
+namespace magic_core {
+
+MappedFile::MappedFile(const std::filesystem::path &file_path) {
+#if defined(MAGIC_HAVE_MMAP)
+  int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw ContentExtractorError("Could not open file: " + file_path.string());
+  }
+  struct stat file_stat {};
+  if (::fstat(fd, &file_stat) != 0) {
+    ::close(fd);
+    throw ContentExtractorError("Could not stat file: " + file_path.string());
+  }
+  size_ = static_cast<size_t>(file_stat.st_size);
+  if (size_ > 0) {
+    void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      const int error = errno;
+      ::close(fd);
+      throw ContentExtractorError("Could not map file: " + file_path.string() + ": " +
+                                  std::strerror(error));
+    }
+    // Extractors scan front to back, so let the kernel read ahead aggressively
+    ::madvise(mapping, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char *>(mapping);
+    mapped_ = true;
+  }
+  // The mapping keeps the file alive on its own
+  ::close(fd);
+#else
+  std::ifstream file_stream(file_path, std::ios::binary);
+  if (!file_stream.is_open()) {
+    throw ContentExtractorError("Could not open file: " + file_path.string());
+  }
+  buffer_.assign(std::istreambuf_iterator<char>(file_stream), std::istreambuf_iterator<char>());
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+  release();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+  *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    release();
+    mapped_ = std::exchange(other.mapped_, false);
+    size_ = std::exchange(other.size_, 0);
+    buffer_ = std::move(other.buffer_);
+    const char *other_data = std::exchange(other.data_, nullptr);
+    // An owned buffer moved along with its characters, so re-point at it
+    data_ = mapped_ ? other_data : buffer_.data();
+    other.buffer_.clear();
+  }
+  return *this;
+}
+
+void MappedFile::release() noexcept {
+#if defined(MAGIC_HAVE_MMAP)
+  if (mapped_) {
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+  buffer_.clear();
+}
+
+}  // namespace magic_core
@@ -1,7 +1,7 @@
 #include "magic_core/extractors/markdown_extractor.hpp"
 
-#include <regex>
-#include <sstream>
+#include "magic_core/extractors/mapped_file.hpp"
+#include "magic_core/extractors/text_scanner.hpp"
 #include "magic_core/types/file.hpp"
 
 namespace magic_core {
@@ -11,7 +11,9 @@ bool MarkdownExtractor::can_handle(const std::filesystem::path& file_path) const
 
 // New combined method - single file read for both hash and chunks
 ExtractionResult MarkdownExtractor::extract_with_hash(const std::filesystem::path& file_path) const {
-  std::string content = get_string_content(file_path);
+  // Hash and chunk straight from the mapping; only the chunks themselves are copied
+  MappedFile file(file_path);
+  std::string_view content = file.view();
 
   if (content.empty()) {
     return {"", {}};
@@ -26,6 +28,13 @@ ExtractionResult MarkdownExtractor::extract_with_hash(const std::filesystem::pat
   return {content_hash, chunks};
 }
 
+void MarkdownExtractor::stream_chunks(const std::filesystem::path& file_path,
+                                      const ChunkSink& sink) const {
+  MappedFile file(file_path);
+  std::string_view content = file.view();
+  stream_built_chunks(content, find_heading_starts(content), sink);
+}
+
 FileType MarkdownExtractor::get_file_type() const {
   return FileType::Markdown;
 }
@@ -37,80 +46,8 @@ std::vector<Chunk> MarkdownExtractor::get_chunks(const std::filesystem::path& fi
 }
 
 // Helper method that processes already-loaded content
-std::vector<Chunk> MarkdownExtractor::extract_chunks_from_content(const std::string& content) const {
-  if (content.empty()) {
-    return {};
-  }
-
-  const std::regex heading_regex(
-      R"(^#+\s.*)", std::regex_constants::ECMAScript | std::regex_constants::multiline);
-
-  std::vector<long> split_points;
-  split_points.push_back(0);
-
-  auto headings_begin = std::sregex_iterator(content.begin(), content.end(), heading_regex);
-  auto headings_end = std::sregex_iterator();
-
-  for (std::sregex_iterator i = headings_begin; i != headings_end; ++i) {
-    split_points.push_back(i->position());
-  }
-  split_points.push_back(content.length());
-
-  std::vector<Chunk> final_chunks;
-  int current_chunk_index = 0;
-  std::stringstream merged_chunk_buffer;
-
-  for (size_t i = 0; i < split_points.size() - 1; ++i) {
-    long start = split_points[i];
-    long end = split_points[i + 1];
-    long length = end - start;
-
-    if (length == 0)
-      continue;
-
-    std::string semantic_section = content.substr(start, length);
-
-    // Add the new section to our temporary buffer
-    merged_chunk_buffer << semantic_section;
-    
-
-    // Check if the merged buffer is now large enough to be a chunk
-    if (merged_chunk_buffer.str().length() >= MIN_CHUNK_SIZE) {
-      std::string current_chunk_content = merged_chunk_buffer.str();
-
-      if (current_chunk_content.length() <= MAX_CHUNK_SIZE) {
-        final_chunks.push_back(
-            {.content = current_chunk_content, .chunk_index = current_chunk_index++});
-      } else {
-        // The merged chunk is too large, apply the fixed-size fallback
-        std::vector<std::string> smaller_chunks = split_into_fixed_chunks(current_chunk_content);
-        for (const auto& small_chunk : smaller_chunks) {
-          final_chunks.push_back({.content = small_chunk, .chunk_index = current_chunk_index++});
-        }
-      }
-
-      // Reset the buffer for the next merged chunk
-      merged_chunk_buffer.str("");
-      merged_chunk_buffer.clear();
-    }
-  }
-
-  // Handle any remaining content in the buffer
-  if (!merged_chunk_buffer.str().empty()) {
-    std::string remaining_content = merged_chunk_buffer.str();
-    
-    if (remaining_content.length() <= MAX_CHUNK_SIZE) {
-      final_chunks.push_back({.content = remaining_content, .chunk_index = current_chunk_index++});
-    } else {
-      // Apply fixed-size fallback for large remaining content
-      std::vector<std::string> smaller_chunks = split_into_fixed_chunks(remaining_content);
-      for (const auto& small_chunk : smaller_chunks) {
-        final_chunks.push_back({.content = small_chunk, .chunk_index = current_chunk_index++});
-      }
-    }
-  } else {
-  }
-
-  return final_chunks;
+std::vector<Chunk> MarkdownExtractor::extract_chunks_from_content(std::string_view content) const {
+  // Each heading starts a section
+  return build_chunks(content, find_heading_starts(content));
 }
 }  // namespace magic_core
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "magic_core/extractors/pdf_extractor.hpp"
+
+#include <poppler-document.h>
+#include <poppler-global.h>
+#include <poppler-page.h>
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "magic_core/extractors/text_scanner.hpp"
+#include "magic_core/types/logger.hpp"
+
+namespace magic_core {
+
+namespace {
+
+using Document = std::unique_ptr<poppler::document>;
+
+// poppler reports recoverable syntax errors on stderr by default; they are routine in real PDFs
+void route_poppler_errors() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        poppler::set_debug_error_function(
+            [](const std::string& message, void*) { log::debug() << "poppler: " << message; },
+            nullptr);
+    });
+}
+
+Document open_document(const fs::path& file_path) {
+    route_poppler_errors();
+    Document document(poppler::document::load_from_file(file_path.string()));
+    if (!document) {
+        throw ContentExtractorError("Could not open PDF: " + file_path.string());
+    }
+    if (document->is_locked()) {
+        throw ContentExtractorError("PDF is password protected: " + file_path.string());
+    }
+    return document;
+}
+
+std::string page_text(const poppler::document& document, int index) {
+    std::unique_ptr<poppler::page> page(document.create_page(index));
+    if (!page) {
+        return {};
+    }
+    poppler::byte_array utf8 = page->text().to_utf8();
+    return std::string(utf8.begin(), utf8.end());
+}
+
+bool is_blank(std::string_view text) {
+    return std::all_of(text.begin(), text.end(),
+                       [](unsigned char c) { return std::isspace(c) != 0; });
+}
+
+// Extracts pages on worker threads and hands their text back in page order. A worker only
+// claims a page less than `ahead` pages past the one next() returns next, so a slow consumer
+// holds back extraction instead of letting finished pages pile up.
+class PageReader {
+public:
+    PageReader(const fs::path& file_path, int pages, size_t threads, size_t ahead)
+        : file_path_(file_path), pages_(pages), ahead_(static_cast<int>(ahead)) {
+        threads_.reserve(threads);
+        for (size_t n = 0; n < threads; ++n) {
+            threads_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~PageReader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        changed_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    PageReader(const PageReader&) = delete;
+    PageReader& operator=(const PageReader&) = delete;
+
+    // The next page's text; rethrows the first extraction failure
+    std::string next() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return error_ || done_.count(next_take_) > 0; });
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        auto page = done_.extract(next_take_++);
+        lock.unlock();
+        changed_.notify_all();
+        return std::move(page.mapped());
+    }
+
+private:
+    void run() {
+        try {
+            Document document = open_document(file_path_);
+            while (true) {
+                int page;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    changed_.wait(lock, [this] {
+                        return stopping_ || error_ || next_claim_ >= pages_ ||
+                               next_claim_ < next_take_ + ahead_;
+                    });
+                    if (stopping_ || error_ || next_claim_ >= pages_) {
+                        return;
+                    }
+                    page = next_claim_++;
+                }
+                std::string text = page_text(*document, page);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    done_.emplace(page, std::move(text));
+                }
+                changed_.notify_all();
+            }
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+            changed_.notify_all();
+        }
+    }
+
+    const fs::path file_path_;
+    const int pages_;
+    const int ahead_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    // Extracted pages not yet taken, by page index
+    std::map<int, std::string> done_;
+    int next_claim_ = 0;
+    int next_take_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace
+
+bool PdfExtractor::can_handle(const std::filesystem::path& file_path) const {
+    return file_path.extension().string() == ".pdf";
+}
+
+FileType PdfExtractor::get_file_type() const {
+    return FileType::PDF;
+}
+
+ExtractionResult PdfExtractor::extract_with_hash(const std::filesystem::path& file_path) const {
+    // The hash streams over the file's bytes; the chunks over its pages
+    std::string content_hash = get_content_hash(file_path);
+    if (std::filesystem::file_size(file_path) == 0) {
+        return {"", {}};
+    }
+    std::vector<Chunk> chunks;
+    stream_chunks(file_path, [&](std::vector<Chunk>& page_chunks, float) {
+        std::move(page_chunks.begin(), page_chunks.end(), std::back_inserter(chunks));
+    });
+    return {content_hash, std::move(chunks)};
+}
+
+std::vector<Chunk> PdfExtractor::get_chunks(const std::filesystem::path& file_path) const {
+    return extract_with_hash(file_path).chunks;
+}
+
+void PdfExtractor::stream_chunks(const std::filesystem::path& file_path,
+                                 const ChunkSink& sink) const {
+    std::error_code size_error;
+    const bool empty_file = std::filesystem::file_size(file_path, size_error) == 0 && !size_error;
+    const int pages = empty_file ? 0 : open_document(file_path)->pages();
+    if (pages <= 0) {
+        std::vector<Chunk> none;
+        sink(none, 1.0f);
+        return;
+    }
+
+    const size_t threads = std::min(
+        {static_cast<size_t>(pages), MAX_EXTRACTION_THREADS,
+         static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()))});
+    PageReader reader(file_path, pages, threads, threads * PAGES_AHEAD_PER_THREAD);
+
+    // A page's last chunk is held back while it is below TARGET_MIN_TOKENS and chunked again
+    // with the next page, as if the document were one text with a paragraph break per page
+    std::string carry;
+    int next_index = 0;
+    for (int page = 0; page < pages; ++page) {
+        std::string text = reader.next();
+        const bool last_page = page + 1 == pages;
+        if (is_blank(text)) {
+            text.clear();
+        }
+        if (!carry.empty()) {
+            text = text.empty() ? std::move(carry) : carry + "\n\n" + text;
+            carry.clear();
+        }
+
+        std::vector<Chunk> chunks = build_chunks(text, find_paragraph_breaks(text));
+        if (!last_page && !chunks.empty() &&
+            tokenizer_->count_tokens(chunks.back().content) < TARGET_MIN_TOKENS) {
+            carry = std::move(chunks.back().content);
+            chunks.pop_back();
+        }
+        for (Chunk& chunk : chunks) {
+            chunk.chunk_index = next_index++;
+        }
+        if (!chunks.empty() || last_page) {
+            sink(chunks, static_cast<float>(page + 1) / pages);
+        }
+    }
+}
+
+}  // namespace magic_core
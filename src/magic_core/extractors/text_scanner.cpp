@@ -0,0 +1,80 @@
+#include "magic_core/extractors/text_scanner.hpp"
+
+#include <cstring>
+
+namespace magic_core {
+
+namespace {
+
+// Whitespace as matched by \s in the "C" locale
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// Position of the first '\n' or '\r' at or after from, or text.size(). '\r' is searched for only
+// up to the next '\n', so every byte is looked at by memchr at most twice.
+size_t find_line_end(std::string_view text, size_t from) {
+  if (from >= text.size()) {
+    return text.size();
+  }
+  const char *begin = text.data();
+  const char *end = begin + text.size();
+  const char *newline =
+      static_cast<const char *>(std::memchr(begin + from, '\n', end - begin - from));
+  const char *limit = newline ? newline : end;
+  const char *carriage =
+      static_cast<const char *>(std::memchr(begin + from, '\r', limit - begin - from));
+  return (carriage ? carriage : limit) - begin;
+}
+
+}  // namespace
+
+std::vector<size_t> find_heading_starts(std::string_view text) {
+  std::vector<size_t> starts;
+  size_t line = 0;
+  while (line < text.size()) {
+    size_t hashes = line;
+    while (hashes < text.size() && text[hashes] == '#') {
+      ++hashes;
+    }
+    if (hashes == line || hashes == text.size() || !is_space(text[hashes])) {
+      line = find_line_end(text, line) + 1;
+      continue;
+    }
+    starts.push_back(line);
+    // The separator may itself be the line break ("#\n"), in which case the heading text runs
+    // on to the end of the following line, which therefore cannot start a heading either
+    line = find_line_end(text, hashes + 1) + 1;
+  }
+  return starts;
+}
+
+std::vector<size_t> find_paragraph_breaks(std::string_view text) {
+  std::vector<size_t> breaks;
+  const char *begin = text.data();
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const void *found = std::memchr(begin + pos, '\n', text.size() - pos);
+    if (!found) {
+      break;
+    }
+    // Take the whole whitespace run after the newline; the break ends at its last newline
+    size_t run = static_cast<const char *>(found) - begin + 1;
+    size_t last_newline = std::string_view::npos;
+    while (run < text.size() && is_space(text[run])) {
+      if (text[run] == '\n') {
+        last_newline = run;
+      }
+      ++run;
+    }
+    if (last_newline != std::string_view::npos) {
+      breaks.push_back(last_newline + 1);
+      pos = last_newline + 1;
+    } else {
+      pos = run;
+    }
+  }
+  return breaks;
+}
+
+}  // namespace magic_core
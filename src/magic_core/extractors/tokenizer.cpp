@@ -0,0 +1,234 @@
+#include "magic_core/extractors/tokenizer.hpp"
+
+#include <utf8.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace magic_core {
+
+namespace {
+
+bool is_ascii_space(unsigned char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool is_ascii_punctuation(unsigned char c) {
+  return (c >= 33 && c <= 47) || (c >= 58 && c <= 64) || (c >= 91 && c <= 96) ||
+         (c >= 123 && c <= 126);
+}
+
+// Word separators outside ASCII that BERT also treats as whitespace
+bool is_unicode_space(uint32_t cp) {
+  return cp == 0x00A0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200A) || cp == 0x2028 ||
+         cp == 0x2029 || cp == 0x202F || cp == 0x205F || cp == 0x3000;
+}
+
+// The CJK blocks BERT splits into one word per character
+bool is_cjk(uint32_t cp) {
+  return (cp >= 0x4E00 && cp <= 0x9FFF) || (cp >= 0x3400 && cp <= 0x4DBF) ||
+         (cp >= 0x20000 && cp <= 0x2A6DF) || (cp >= 0x2A700 && cp <= 0x2B81F) ||
+         (cp >= 0x2B820 && cp <= 0x2CEAF) || (cp >= 0xF900 && cp <= 0xFAFF) ||
+         (cp >= 0x2F800 && cp <= 0x2FA1F);
+}
+
+}  // namespace
+
+size_t ApproximateTokenizer::count_tokens(std::string_view text) const {
+  return static_cast<size_t>(std::ceil(static_cast<float>(text.size()) / bytes_per_token_));
+}
+
+size_t ApproximateTokenizer::prefix_length(std::string_view text, size_t max_tokens) const {
+  const size_t max_bytes =
+      std::max<size_t>(static_cast<size_t>(std::max<size_t>(max_tokens, 1) * bytes_per_token_), 1);
+  // Cut at the first code point boundary at or past max_bytes
+  auto it = text.begin();
+  while (it != text.end() && static_cast<size_t>(it - text.begin()) < max_bytes) {
+    utf8::next(it, text.end());
+  }
+  return it - text.begin();
+}
+
+std::shared_ptr<const WordPieceTokenizer> WordPieceTokenizer::load(
+    const std::filesystem::path& vocab_path, bool lowercase) {
+  static std::mutex cache_mutex;
+  static std::map<std::pair<std::string, bool>, std::weak_ptr<const WordPieceTokenizer>> cache;
+
+  const auto key = std::make_pair(std::filesystem::absolute(vocab_path).string(), lowercase);
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  if (auto cached = cache[key].lock()) {
+    return cached;
+  }
+
+  std::ifstream vocab_stream(vocab_path);
+  if (!vocab_stream.is_open()) {
+    throw TokenizerError("Could not open tokenizer vocab: " + vocab_path.string());
+  }
+  std::unordered_set<std::string> vocab;
+  std::string line;
+  while (std::getline(vocab_stream, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (!line.empty()) {
+      vocab.insert(line);
+    }
+  }
+  if (vocab.empty()) {
+    throw TokenizerError("Tokenizer vocab is empty: " + vocab_path.string());
+  }
+
+  auto tokenizer = std::make_shared<const WordPieceTokenizer>(std::move(vocab), lowercase);
+  cache[key] = tokenizer;
+  return tokenizer;
+}
+
+WordPieceTokenizer::WordPieceTokenizer(std::unordered_set<std::string> vocab, bool lowercase)
+    : vocab_(std::move(vocab)), lowercase_(lowercase) {
+  for (const auto& piece : vocab_) {
+    max_piece_bytes_ = std::max(max_piece_bytes_, piece.size());
+  }
+}
+
+size_t WordPieceTokenizer::count_tokens(std::string_view text) const {
+  size_t count = 0;
+  for_each_token(text, [&](size_t) {
+    ++count;
+    return true;
+  });
+  return count;
+}
+
+size_t WordPieceTokenizer::prefix_length(std::string_view text, size_t max_tokens) const {
+  const size_t limit = std::max<size_t>(max_tokens, 1);
+  size_t count = 0;
+  size_t cut = text.size();
+  // The prefix ends where the first token past the limit begins
+  for_each_token(text, [&](size_t begin) {
+    if (count == limit) {
+      cut = begin;
+      return false;
+    }
+    ++count;
+    return true;
+  });
+  return cut;
+}
+
+template <typename OnToken>
+void WordPieceTokenizer::for_each_token(std::string_view text, OnToken&& on_token) const {
+  std::string lowered;
+  std::string candidate;
+  std::vector<size_t> pieces;
+  auto it = text.begin();
+  while (it != text.end()) {
+    const size_t start = it - text.begin();
+    const auto c = static_cast<unsigned char>(*it);
+    if (c < 0x80) {
+      if (is_ascii_space(c) || c < 0x20 || c == 0x7F) {
+        ++it;
+        continue;
+      }
+      if (is_ascii_punctuation(c)) {
+        ++it;
+        if (!on_token(start)) {
+          return;
+        }
+        continue;
+      }
+    } else {
+      auto next = it;
+      const uint32_t cp = utf8::next(next, text.end());
+      if (is_unicode_space(cp)) {
+        it = next;
+        continue;
+      }
+      if (is_cjk(cp)) {
+        it = next;
+        if (!on_token(start)) {
+          return;
+        }
+        continue;
+      }
+    }
+
+    // A word runs until whitespace, punctuation or a CJK character
+    size_t chars = 0;
+    while (it != text.end()) {
+      const auto b = static_cast<unsigned char>(*it);
+      if (b < 0x80) {
+        if (is_ascii_space(b) || is_ascii_punctuation(b) || b < 0x20 || b == 0x7F) {
+          break;
+        }
+        ++it;
+      } else {
+        auto next = it;
+        const uint32_t cp = utf8::next(next, text.end());
+        if (is_unicode_space(cp) || is_cjk(cp)) {
+          break;
+        }
+        it = next;
+      }
+      ++chars;
+    }
+
+    split_word(text.substr(start, (it - text.begin()) - start), chars, lowered, candidate,
+               pieces);
+    for (size_t piece : pieces) {
+      if (!on_token(start + piece)) {
+        return;
+      }
+    }
+  }
+}
+
+void WordPieceTokenizer::split_word(std::string_view word, size_t chars, std::string& lowered,
+                                    std::string& candidate, std::vector<size_t>& pieces) const {
+  pieces.clear();
+  if (chars > MAX_WORD_CHARS) {
+    pieces.push_back(0);
+    return;
+  }
+  lowered.assign(word);
+  if (lowercase_) {
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c) {
+      return c < 0x80 ? static_cast<char>(std::tolower(c)) : static_cast<char>(c);
+    });
+  }
+
+  // Greedy longest match, continuation pieces carry the "##" prefix
+  size_t start = 0;
+  while (start < lowered.size()) {
+    const std::string_view prefix = start == 0 ? "" : "##";
+    size_t end =
+        std::min(lowered.size(), start + std::max(max_piece_bytes_, prefix.size()) - prefix.size());
+    bool found = false;
+    while (end > start) {
+      // Candidate pieces end on a code point boundary
+      if (end < lowered.size() && (static_cast<unsigned char>(lowered[end]) & 0xC0) == 0x80) {
+        --end;
+        continue;
+      }
+      candidate.assign(prefix);
+      candidate.append(lowered, start, end - start);
+      if (vocab_.count(candidate) > 0) {
+        found = true;
+        break;
+      }
+      --end;
+    }
+    if (!found) {
+      pieces.assign(1, 0);
+      return;
+    }
+    pieces.push_back(start);
+    start = end;
+  }
+}
+
+}  // namespace magic_core
@@ -0,0 +1,75 @@
+#include "magic_core/llm/adaptive_batch_controller.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace magic_core {
+
+AdaptiveBatchController::AdaptiveBatchController(AdaptiveBatchOptions options)
+    : options_(options),
+      batch_size_(options.initial_batch),
+      in_flight_limit_(options.initial_in_flight) {
+  if (options.min_batch == 0 || options.min_batch > options.initial_batch ||
+      options.initial_batch > options.max_batch) {
+    throw std::invalid_argument("Batch sizes must satisfy 1 <= min <= initial <= max");
+  }
+  if (options.initial_in_flight == 0 || options.initial_in_flight > options.max_in_flight) {
+    throw std::invalid_argument("Requests in flight must satisfy 1 <= initial <= max");
+  }
+  if (options.tolerance < 1.0) {
+    throw std::invalid_argument("Latency tolerance must be at least 1");
+  }
+}
+
+void AdaptiveBatchController::record_success(size_t texts,
+                                             size_t chars,
+                                             std::chrono::steady_clock::duration latency) {
+  if (chars == 0) {
+    return;
+  }
+  const double per_char = std::chrono::duration<double>(latency).count() / chars;
+  std::lock_guard<std::mutex> lock(mutex_);
+  // A partial batch (a search query, the end of a file) pays the request's fixed cost over
+  // fewer characters, so it looking slow says nothing about the endpoint: it neither shrinks
+  // the values nor drifts the baseline, and only counts when it was in time regardless
+  const bool partial = texts < batch_size_;
+  if (partial) {
+    if (baseline_ != 0.0 && per_char > baseline_ * options_.tolerance) {
+      return;
+    }
+    baseline_ = baseline_ == 0.0 ? per_char : std::min(per_char, baseline_);
+  } else {
+    baseline_ =
+        baseline_ == 0.0 ? per_char : std::min(per_char, baseline_ * (1 + BASELINE_DRIFT));
+    if (per_char > baseline_ * options_.tolerance) {
+      batch_size_ = std::max(options_.min_batch, batch_size_ * 3 / 4);
+      in_flight_limit_ = std::max<size_t>(1, in_flight_limit_ * 3 / 4);
+      in_time_ = 0;
+      return;
+    }
+    batch_size_ = std::min(options_.max_batch, batch_size_ + options_.batch_step);
+  }
+  if (++in_time_ >= in_flight_limit_) {
+    in_flight_limit_ = std::min(options_.max_in_flight, in_flight_limit_ + 1);
+    in_time_ = 0;
+  }
+}
+
+void AdaptiveBatchController::record_failure() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  batch_size_ = std::max(options_.min_batch, batch_size_ / 2);
+  in_flight_limit_ = std::max<size_t>(1, in_flight_limit_ / 2);
+  in_time_ = 0;
+}
+
+size_t AdaptiveBatchController::batch_size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return batch_size_;
+}
+
+size_t AdaptiveBatchController::in_flight_limit() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return in_flight_limit_;
+}
+
+}  // namespace magic_core
@@ -0,0 +1,134 @@
+#include "magic_core/llm/fake_embedding_client.hpp"
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+#include "magic_core/types/vector_math.hpp"
+
+namespace magic_core {
+
+namespace {
+
+// FNV-1a, so a word hashes the same everywhere, unlike std::hash
+uint64_t hash_word(const std::string &word) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : word) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t splitmix64(uint64_t &state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Adds the word's pseudo-random vector, components uniform in [-1, 1)
+void add_word(std::vector<float> &acc, const std::string &word) {
+  uint64_t state = hash_word(word);
+  for (float &x : acc) {
+    x += static_cast<float>(splitmix64(state) >> 40) * (2.0f / (1 << 24)) - 1.0f;
+  }
+}
+
+}  // namespace
+
+FakeEmbeddingClient::FakeEmbeddingClient(FakeEmbeddingOptions options)
+    : OllamaClient("fake"), options_(options) {
+  if (options_.dimension <= 0) {
+    throw OllamaError("Fake embedding dimension must be positive");
+  }
+}
+
+std::vector<float> FakeEmbeddingClient::embed(const std::string &text) const {
+  std::vector<float> vector(static_cast<size_t>(options_.dimension), 0.0f);
+  std::string word;
+  bool any_word = false;
+  auto flush_word = [&] {
+    if (!word.empty()) {
+      add_word(vector, word);
+      any_word = true;
+      word.clear();
+    }
+  };
+  for (unsigned char c : text) {
+    if (std::isalnum(c)) {
+      word += static_cast<char>(std::tolower(c));
+    } else {
+      flush_word();
+    }
+  }
+  flush_word();
+  if (!any_word) {
+    // Text without words still gets a stable, nonzero vector
+    add_word(vector, text);
+  }
+  vector_math::normalize(vector);
+  return vector;
+}
+
+std::vector<float> FakeEmbeddingClient::get_embedding(const std::string &text) {
+  return get_embeddings({text}).front();
+}
+
+std::vector<std::vector<float>> FakeEmbeddingClient::get_embeddings(
+    const std::vector<std::string> &texts_to_embed) {
+  ++outstanding_;
+  requests_.fetch_add(1, std::memory_order_relaxed);
+  texts_.fetch_add(texts_to_embed.size(), std::memory_order_relaxed);
+  const auto started = std::chrono::steady_clock::now();
+  std::vector<std::vector<float>> embeddings;
+  embeddings.reserve(texts_to_embed.size());
+  for (const auto &text : texts_to_embed) {
+    embeddings.push_back(embed(text));
+  }
+  // The simulated latency includes the time spent computing the vectors
+  std::this_thread::sleep_until(started + options_.request_latency +
+                                options_.per_text_latency * texts_to_embed.size());
+  --outstanding_;
+  return embeddings;
+}
+
+std::future<std::vector<std::vector<float>>> FakeEmbeddingClient::get_embeddings_async(
+    const std::vector<std::string> &texts_to_embed) {
+  return std::async(std::launch::async,
+                    [this, texts_to_embed] { return get_embeddings(texts_to_embed); });
+}
+
+std::string FakeEmbeddingClient::generate(const std::string &prompt, bool json_output) {
+  ++outstanding_;
+  requests_.fetch_add(1, std::memory_order_relaxed);
+  std::this_thread::sleep_for(options_.request_latency);
+  --outstanding_;
+  std::string summary = "Summary of: " + prompt.substr(0, 100) + "...";
+  if (!json_output) {
+    return summary;
+  }
+  char filename[32];
+  std::snprintf(filename, sizeof(filename), "summary-%08llx",
+                static_cast<unsigned long long>(hash_word(prompt) & 0xffffffffu));
+  return nlohmann::json{
+      {"summary", summary}, {"category", "uncategorized"}, {"filename", filename}}
+      .dump();
+}
+
+std::string FakeEmbeddingClient::summarize_text(const std::string &text) {
+  return "Summary of: " + text.substr(0, 100) + "...";
+}
+
+bool FakeEmbeddingClient::is_server_available() {
+  return true;
+}
+
+std::vector<OllamaEndpointStatus> FakeEmbeddingClient::endpoint_status() const {
+  return {{"fake://", true, outstanding_.load()}};
+}
+
+}  // namespace magic_core
@@ -0,0 +1,227 @@
+#include "magic_core/llm/http_client.hpp"
+
+#include <curl/curl.h>
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace magic_core {
+
+namespace {
+
+struct Transfer {
+  std::string method;
+  std::string url;
+  std::string request_body;
+  std::string response_body;
+  std::promise<HttpResponse> promise;
+  std::function<void()> on_done;
+  std::chrono::steady_clock::time_point submitted;
+  curl_slist *headers = nullptr;
+  char error[CURL_ERROR_SIZE] = {};
+};
+
+size_t append_body(char *data, size_t size, size_t count, void *user_data) {
+  static_cast<std::string *>(user_data)->append(data, size * count);
+  return size * count;
+}
+
+void ensure_curl_initialized() {
+  static std::once_flag once;
+  std::call_once(once, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
+
+}  // namespace
+
+struct HttpClient::State {
+  CURLM *multi = nullptr;
+  std::thread loop;
+
+  std::mutex mutex;
+  bool stopping = false;
+  std::deque<std::unique_ptr<Transfer>> submitted;
+
+  // Only touched by the loop thread
+  std::unordered_map<CURL *, std::unique_ptr<Transfer>> active;
+  std::vector<CURL *> idle_handles;
+};
+
+HttpClient::HttpClient(std::string base_url, HttpClientOptions options)
+    : base_url_(std::move(base_url)), options_(options), state_(std::make_unique<State>()) {
+  while (!base_url_.empty() && base_url_.back() == '/') {
+    base_url_.pop_back();
+  }
+  ensure_curl_initialized();
+  state_->multi = curl_multi_init();
+  if (!state_->multi) {
+    throw HttpError("Failed to create a curl multi handle");
+  }
+  curl_multi_setopt(state_->multi, CURLMOPT_MAX_HOST_CONNECTIONS, options_.max_connections);
+  curl_multi_setopt(state_->multi, CURLMOPT_MAXCONNECTS, options_.max_connections);
+  state_->loop = std::thread(&HttpClient::run_loop, this);
+}
+
+HttpClient::~HttpClient() {
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->stopping = true;
+  }
+  curl_multi_wakeup(state_->multi);
+  state_->loop.join();
+  for (CURL *easy : state_->idle_handles) {
+    curl_easy_cleanup(easy);
+  }
+  curl_multi_cleanup(state_->multi);
+}
+
+std::future<HttpResponse> HttpClient::request_async(const std::string &method,
+                                                    const std::string &path,
+                                                    std::string body,
+                                                    std::function<void()> on_done) {
+  auto transfer = std::make_unique<Transfer>();
+  transfer->method = method;
+  transfer->on_done = std::move(on_done);
+  transfer->url = base_url_ + path;
+  transfer->request_body = std::move(body);
+  transfer->submitted = std::chrono::steady_clock::now();
+  std::future<HttpResponse> result = transfer->promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    if (state_->stopping) {
+      throw HttpError("HTTP client for " + base_url_ + " is shutting down");
+    }
+    state_->submitted.push_back(std::move(transfer));
+  }
+  curl_multi_wakeup(state_->multi);
+  return result;
+}
+
+HttpResponse HttpClient::request(const std::string &method,
+                                 const std::string &path,
+                                 std::string body) {
+  return request_async(method, path, std::move(body)).get();
+}
+
+void HttpClient::run_loop() {
+  State &state = *state_;
+
+  auto start = [&](std::unique_ptr<Transfer> transfer) {
+    CURL *easy = nullptr;
+    if (!state.idle_handles.empty()) {
+      easy = state.idle_handles.back();
+      state.idle_handles.pop_back();
+    } else {
+      easy = curl_easy_init();
+    }
+    if (!easy) {
+      if (transfer->on_done) {
+        transfer->on_done();
+      }
+      transfer->promise.set_exception(
+          std::make_exception_ptr(HttpError("Failed to create a curl easy handle")));
+      return;
+    }
+    curl_easy_setopt(easy, CURLOPT_URL, transfer->url.c_str());
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, append_body);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->response_body);
+    curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, transfer->error);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS,
+                     static_cast<long>(options_.connect_timeout.count()));
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, static_cast<long>(options_.request_timeout.count()));
+    if (transfer->method == "GET") {
+      curl_easy_setopt(easy, CURLOPT_HTTPGET, 1L);
+    } else {
+      if (transfer->method != "POST") {
+        curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, transfer->method.c_str());
+      }
+      curl_easy_setopt(easy, CURLOPT_POSTFIELDS, transfer->request_body.data());
+      curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE,
+                       static_cast<curl_off_t>(transfer->request_body.size()));
+    }
+    if (!transfer->request_body.empty()) {
+      transfer->headers = curl_slist_append(nullptr, "Content-Type: application/json");
+      // Large batches would otherwise wait on a 100-continue round trip
+      transfer->headers = curl_slist_append(transfer->headers, "Expect:");
+      curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->headers);
+    }
+    curl_multi_add_handle(state.multi, easy);
+    state.active.emplace(easy, std::move(transfer));
+  };
+
+  auto finish = [&](CURL *easy, CURLcode code) {
+    auto it = state.active.find(easy);
+    std::unique_ptr<Transfer> transfer = std::move(it->second);
+    state.active.erase(it);
+    curl_multi_remove_handle(state.multi, easy);
+
+    // Before the future is ready, so whoever waits on it already sees on_done's effects
+    if (transfer->on_done) {
+      transfer->on_done();
+    }
+    if (code == CURLE_OK) {
+      HttpResponse response;
+      curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &response.status);
+      response.body = std::move(transfer->response_body);
+      response.elapsed = std::chrono::steady_clock::now() - transfer->submitted;
+      transfer->promise.set_value(std::move(response));
+    } else {
+      std::string detail = transfer->error[0] ? transfer->error : curl_easy_strerror(code);
+      transfer->promise.set_exception(std::make_exception_ptr(
+          HttpError(transfer->method + " " + transfer->url + " failed: " + detail)));
+    }
+    curl_slist_free_all(transfer->headers);
+    // The connection stays in the multi handle's cache; the easy handle is kept for reuse
+    curl_easy_reset(easy);
+    state.idle_handles.push_back(easy);
+  };
+
+  while (true) {
+    std::deque<std::unique_ptr<Transfer>> submitted;
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      if (state.stopping) {
+        break;
+      }
+      submitted.swap(state.submitted);
+    }
+    for (auto &transfer : submitted) {
+      start(std::move(transfer));
+    }
+
+    int running = 0;
+    curl_multi_perform(state.multi, &running);
+    int queued = 0;
+    while (CURLMsg *message = curl_multi_info_read(state.multi, &queued)) {
+      if (message->msg == CURLMSG_DONE) {
+        finish(message->easy_handle, message->data.result);
+      }
+    }
+    // Wakes early for socket activity, curl's own timers or curl_multi_wakeup
+    curl_multi_poll(state.multi, nullptr, 0, 1000, nullptr);
+  }
+
+  // Nobody is left to drive the transfers, so fail them rather than leave callers blocked
+  const auto shut_down = [this] {
+    return std::make_exception_ptr(HttpError("HTTP client for " + base_url_ + " shut down"));
+  };
+  for (auto &[easy, transfer] : state.active) {
+    curl_multi_remove_handle(state.multi, easy);
+    curl_slist_free_all(transfer->headers);
+    curl_easy_cleanup(easy);
+    transfer->promise.set_exception(shut_down());
+  }
+  state.active.clear();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  for (auto &transfer : state.submitted) {
+    transfer->promise.set_exception(shut_down());
+  }
+  state.submitted.clear();
+}
+
+}  // namespace magic_core
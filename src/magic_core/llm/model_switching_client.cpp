@@ -0,0 +1,74 @@
+#include "magic_core/llm/model_switching_client.hpp"
+
+#include <utility>
+
+namespace magic_core {
+
+ModelSwitchingClient::ModelSwitchingClient(std::shared_ptr<OllamaClient> client,
+                                           std::string model)
+    : OllamaClient(model), client_(std::move(client)), model_(std::move(model)) {
+  if (!client_) {
+    throw OllamaError("ModelSwitchingClient needs a client to forward to");
+  }
+}
+
+std::shared_ptr<OllamaClient> ModelSwitchingClient::current() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return client_;
+}
+
+void ModelSwitchingClient::switch_to(std::shared_ptr<OllamaClient> client, std::string model) {
+  if (!client) {
+    throw OllamaError("ModelSwitchingClient needs a client to forward to");
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  client_ = std::move(client);
+  model_ = std::move(model);
+}
+
+std::string ModelSwitchingClient::model() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return model_;
+}
+
+std::vector<float> ModelSwitchingClient::get_embedding(const std::string &text) {
+  return current()->get_embedding(text);
+}
+
+std::vector<std::vector<float>> ModelSwitchingClient::get_embeddings(
+    const std::vector<std::string> &texts_to_embed) {
+  return current()->get_embeddings(texts_to_embed);
+}
+
+std::future<std::vector<std::vector<float>>> ModelSwitchingClient::get_embeddings_async(
+    const std::vector<std::string> &texts_to_embed) {
+  // The future may outlive a switch; it keeps the client it was sent through
+  auto client = current();
+  auto future = client->get_embeddings_async(texts_to_embed);
+  return std::async(std::launch::deferred,
+                    [client = std::move(client), future = std::move(future)]() mutable {
+                      return future.get();
+                    });
+}
+
+std::string ModelSwitchingClient::generate(const std::string &prompt, bool json_output) {
+  return current()->generate(prompt, json_output);
+}
+
+std::string ModelSwitchingClient::summarize_text(const std::string &text) {
+  return current()->summarize_text(text);
+}
+
+bool ModelSwitchingClient::is_server_available() {
+  return current()->is_server_available();
+}
+
+std::vector<OllamaEndpointStatus> ModelSwitchingClient::endpoint_status() const {
+  return current()->endpoint_status();
+}
+
+size_t ModelSwitchingClient::embedding_batch_size() const {
+  return current()->embedding_batch_size();
+}
+
+}  // namespace magic_core
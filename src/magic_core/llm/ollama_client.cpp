@@ -1,67 +1,451 @@
 #include "magic_core/llm/ollama_client.hpp"
-#include "ollama.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+#include "magic_core/types/logger.hpp"
+#include "magic_core/types/metrics.hpp"
 
 namespace magic_core {
 
-OllamaClient::OllamaClient(const std::string &ollama_url, const std::string &embedding_model)
-    : ollama_url_(ollama_url), embedding_model_(embedding_model) {
-  setup_server_connection();
+namespace {
+
+std::vector<std::vector<float>> parse_embeddings(const HttpResponse &response, size_t expected) {
+  if (response.status != 200) {
+    throw OllamaError("Embedding request failed with HTTP " + std::to_string(response.status) +
+                      ": " + response.body);
+  }
+  try {
+    auto json_response = nlohmann::json::parse(response.body);
+    if (!json_response.contains("embeddings") || !json_response["embeddings"].is_array()) {
+      throw OllamaError("Response does not contain an embeddings array");
+    }
+
+    auto embeddings = json_response["embeddings"].get<std::vector<std::vector<float>>>();
+    if (embeddings.size() != expected) {
+      throw OllamaError("Expected " + std::to_string(expected) + " embeddings, got " +
+                        std::to_string(embeddings.size()));
+    }
+    return embeddings;
+  } catch (const nlohmann::json::exception &e) {
+    throw OllamaError("Failed to parse Ollama JSON: " + std::string(e.what()));
+  }
 }
 
-void OllamaClient::setup_server_connection() {
-  // Set the server URL for ollama-hpp
-  ollama::setServerURL(ollama_url_);
-  // Your custom initialization logic
-  if (!ollama::is_running()) {
-    throw OllamaError("Ollama server is not running at " + ollama_url_);
+std::string parse_generation(const HttpResponse &response) {
+  if (response.status != 200) {
+    throw OllamaError("Generation request failed with HTTP " + std::to_string(response.status) +
+                      ": " + response.body);
+  }
+  try {
+    auto json_response = nlohmann::json::parse(response.body);
+    if (!json_response.contains("response") || !json_response["response"].is_string()) {
+      throw OllamaError("Response does not contain the generated text");
+    }
+    return json_response["response"].get<std::string>();
+  } catch (const nlohmann::json::exception &e) {
+    throw OllamaError("Failed to parse Ollama JSON: " + std::string(e.what()));
   }
 }
 
-// The Ollama api supports batch requests for the embeddings, this will have to be a separate endpoint
+constexpr const char *EMBED_PATH = "/api/embed";
+constexpr const char *GENERATE_PATH = "/api/generate";
+
+}  // namespace
+
+OllamaClient::OllamaClient(const std::string &ollama_url,
+                           const std::string &embedding_model,
+                           HttpClientOptions http_options)
+    : OllamaClient(std::vector<std::string>{ollama_url}, embedding_model, http_options) {}
+
+OllamaClient::OllamaClient(const std::vector<std::string> &endpoint_urls,
+                           const std::string &embedding_model,
+                           HttpClientOptions http_options)
+    : embedding_model_(embedding_model) {
+  if (endpoint_urls.empty()) {
+    throw OllamaError("No Ollama endpoints configured");
+  }
+  std::string all_urls;
+  for (const auto &url : endpoint_urls) {
+    auto endpoint = std::make_unique<Endpoint>();
+    endpoint->url = url;
+    endpoint->http = std::make_unique<HttpClient>(url, http_options);
+    const std::string labels = "endpoint=\"" + url + "\"";
+    endpoint->batch_size_gauge = &metrics::gauge(
+        "magic_embed_tuned_batch_size", "Texts per embedding request tuned for the endpoint",
+        labels);
+    endpoint->in_flight_gauge = &metrics::gauge(
+        "magic_embed_tuned_in_flight", "Embedding requests in flight tuned for the endpoint",
+        labels);
+    publish_tuning(*endpoint);
+    endpoints_.push_back(std::move(endpoint));
+    all_urls += (all_urls.empty() ? "" : ", ") + url;
+  }
+  // Probed all at once, so a start waits for the slowest endpoint rather than for all of them
+  std::vector<std::future<HttpResponse>> probes;
+  for (auto &endpoint : endpoints_) {
+    try {
+      probes.push_back(endpoint->http->request_async("GET", "/api/version"));
+    } catch (const HttpError &) {
+      probes.emplace_back();
+    }
+  }
+  bool any_available = false;
+  for (size_t i = 0; i < endpoints_.size(); ++i) {
+    bool available = false;
+    try {
+      available = probes[i].valid() && probes[i].get().status == 200;
+    } catch (const HttpError &) {
+    }
+    if (available) {
+      any_available = true;
+    } else {
+      mark_down(*endpoints_[i], "not responding");
+    }
+  }
+  if (!any_available) {
+    throw OllamaError("Ollama server is not running at " + all_urls);
+  }
+}
+
+OllamaClient::OllamaClient(std::string embedding_model)
+    : embedding_model_(std::move(embedding_model)) {}
+
 std::vector<float> OllamaClient::get_embedding(const std::string &text) {
+  return get_embeddings_async({text}).get().front();
+}
+
+std::vector<std::vector<float>> OllamaClient::get_embeddings(
+    const std::vector<std::string> &texts_to_embed) {
+  {
+    std::unique_lock<std::mutex> lock(capacity_mutex_);
+    capacity_freed_.wait_for(lock, CAPACITY_WAIT, [this] { return has_capacity(); });
+  }
+  return get_embeddings_async(texts_to_embed).get();
+}
+
+std::future<std::vector<std::vector<float>>> OllamaClient::get_embeddings_async(
+    const std::vector<std::string> &texts_to_embed) {
+  if (texts_to_embed.empty()) {
+    std::promise<std::vector<std::vector<float>>> empty;
+    empty.set_value({});
+    return empty.get_future();
+  }
+
+  // /api/embed takes a list of inputs and returns one embedding per input, in order
+  std::string body =
+      nlohmann::json{{"model", embedding_model_}, {"input", texts_to_embed}}.dump();
+  Endpoint *endpoint = pick_endpoint({});
+  if (!endpoint) {
+    throw OllamaError("Batch embedding generation failed: no Ollama endpoint is available");
+  }
+  static metrics::Histogram &batch_sizes = metrics::histogram(
+      "magic_embed_batch_size", "Texts per embedding request", metrics::size_buckets());
+  static metrics::Histogram &latency =
+      metrics::histogram("magic_embed_request_seconds",
+                         "Embedding requests from send to parsed reply, retries included");
+  static metrics::Counter &failovers = metrics::counter(
+      "magic_embed_failovers_total", "Embedding requests resent after an endpoint failed");
+  batch_sizes.observe(static_cast<double>(texts_to_embed.size()));
+  size_t chars = 0;
+  for (const auto &text : texts_to_embed) {
+    chars += text.size();
+  }
+  // Requests below the smallest batch, like search queries, are mostly fixed cost and tell
+  // the controller nothing, not even by failing
+  std::optional<BatchShape> shape;
+  if (texts_to_embed.size() >= endpoint->tuning.min_batch()) {
+    shape = BatchShape{texts_to_embed.size(), chars};
+  }
+  const auto started = std::chrono::steady_clock::now();
+  std::future<HttpResponse> response =
+      send(*endpoint, EMBED_PATH, std::move(body), "Batch embedding generation failed: ",
+           failovers, shape);
+  return std::async(std::launch::deferred,
+                    [started, response = std::move(response),
+                     expected = texts_to_embed.size()]() mutable {
+                      auto embeddings = parse_embeddings(response.get(), expected);
+                      latency.observe(std::chrono::duration<double>(
+                                          std::chrono::steady_clock::now() - started)
+                                          .count());
+                      return embeddings;
+                    });
+}
+
+std::string OllamaClient::generate(const std::string &prompt, bool json_output) {
+  // stream: false makes /api/generate answer with one object holding the whole response
+  nlohmann::json request{{"model", embedding_model_}, {"prompt", prompt}, {"stream", false}};
+  if (json_output) {
+    request["format"] = "json";
+  }
+  Endpoint *endpoint = pick_endpoint({});
+  if (!endpoint) {
+    throw OllamaError("Text generation failed: no Ollama endpoint is available");
+  }
+  static metrics::Histogram &latency =
+      metrics::histogram("magic_generate_request_seconds",
+                         "Generation requests from send to parsed reply, retries included",
+                         {0.5, 1, 2.5, 5, 10, 30, 60, 120, 300});
+  static metrics::Counter &failovers = metrics::counter(
+      "magic_generate_failovers_total", "Generation requests resent after an endpoint failed");
+  metrics::ScopedTimer timer(latency);
+  return parse_generation(
+      send(*endpoint, GENERATE_PATH, request.dump(), "Text generation failed: ", failovers)
+          .get());
+}
+
+std::future<HttpResponse> OllamaClient::send(Endpoint &first,
+                                             const char *path,
+                                             std::string body,
+                                             std::string failure_prefix,
+                                             metrics::Counter &failovers,
+                                             std::optional<BatchShape> shape) {
+  std::future<HttpResponse> response = submit(first, path, body);
+  // Deferred: waiting and failover run on whichever thread calls get(), so a request never
+  // costs a thread
+  return std::async(
+      std::launch::deferred,
+      [this, endpoint = &first, path, &failovers, shape, response = std::move(response),
+       body = std::move(body), failure_prefix = std::move(failure_prefix)]() mutable {
+        std::vector<Endpoint *> tried;
+        while (true) {
+          std::string failure;
+          try {
+            HttpResponse result = response.get();
+            if (shape && result.status == 200) {
+              endpoint->tuning.record_success(shape->texts, shape->chars, result.elapsed);
+              publish_tuning(*endpoint);
+            }
+            // A 4xx is about the request itself, another endpoint would answer the same
+            if (result.status < 500) {
+              return result;
+            }
+            failure = "HTTP " + std::to_string(result.status) + ": " + result.body;
+          } catch (const HttpError &e) {
+            failure = e.what();
+          }
+          // Timeouts land here too: the endpoint was sent more than it could take
+          if (shape) {
+            endpoint->tuning.record_failure();
+            publish_tuning(*endpoint);
+          }
+          mark_down(*endpoint, failure);
+          tried.push_back(endpoint);
+          endpoint = pick_endpoint(tried);
+          if (!endpoint) {
+            throw OllamaError(failure_prefix + failure);
+          }
+          failovers.add();
+          response = submit(*endpoint, path, body);
+        }
+      });
+}
+
+std::future<HttpResponse> OllamaClient::submit(Endpoint &endpoint,
+                                               const char *path,
+                                               const std::string &body) {
+  ++endpoint.outstanding;
   try {
-    ollama::response response = ollama::generate_embeddings(embedding_model_, text);
+    // Released when the transfer ends rather than when its reply is collected, so a future
+    // dropped unread does not hold the slot for good
+    return endpoint.http->request_async("POST", path, body,
+                                        [this, &endpoint] { release(endpoint); });
+  } catch (const HttpError &) {
+    release(endpoint);
+    // Surfaces through get() like any other transfer failure, so it fails over the same way
+    std::promise<HttpResponse> failed;
+    failed.set_exception(std::current_exception());
+    return failed.get_future();
+  }
+}
+
+OllamaClient::Endpoint *OllamaClient::pick_endpoint(const std::vector<Endpoint *> &tried) {
+  auto untried = [&](Endpoint *endpoint) {
+    return std::find(tried.begin(), tried.end(), endpoint) == tried.end();
+  };
 
-    // Get the JSON structure
-    auto json_response = response.as_json();
+  // Rotating the starting point spreads ties instead of always loading the first endpoint
+  const size_t start = next_endpoint_++;
+  Endpoint *best = nullptr;
+  for (size_t n = 0; n < endpoints_.size(); ++n) {
+    Endpoint *endpoint = endpoints_[(start + n) % endpoints_.size()].get();
+    if (!untried(endpoint)) {
+      continue;
+    }
+    if (!endpoint->healthy && !poll_recovery(*endpoint)) {
+      continue;
+    }
+    // The fewest requests in flight for its tuned limit, compared without dividing
+    if (!best || endpoint->outstanding * static_cast<long long>(best->tuning.in_flight_limit()) <
+                     best->outstanding *
+                         static_cast<long long>(endpoint->tuning.in_flight_limit())) {
+      best = endpoint;
+    }
+  }
+  if (best) {
+    return best;
+  }
 
-    // Check if embedding field exists
-    if (!json_response.contains("embeddings")) {
-      // Log the response itself
-      throw OllamaError("Response does not contain embedding field");
+  // Everything is down: check now rather than refuse work until the retry times pass
+  for (auto &endpoint : endpoints_) {
+    if (untried(endpoint.get()) && is_endpoint_available(*endpoint)) {
+      std::lock_guard<std::mutex> lock(endpoint->probe_mutex);
+      endpoint->probe = {};
+      endpoint->healthy = true;
+      return endpoint.get();
     }
+  }
+  return nullptr;
+}
 
-    // Handle different embedding response formats
-    auto embeddings = json_response["embeddings"];
-    if (embeddings.is_array()) {
-      if (embeddings.size() > 0 && embeddings[0].is_array()) {
-        // Array of arrays - take the first embedding vector
-        return embeddings[0].get<std::vector<float>>();
-      } else {
-        // Single array of floats
-        return embeddings.get<std::vector<float>>();
+bool OllamaClient::poll_recovery(Endpoint &endpoint) {
+  std::unique_lock<std::mutex> lock(endpoint.probe_mutex, std::try_to_lock);
+  if (!lock.owns_lock() || endpoint.healthy) {
+    return endpoint.healthy;
+  }
+  if (!endpoint.probe.valid()) {
+    if (std::chrono::steady_clock::now() >= endpoint.retry_at) {
+      try {
+        endpoint.probe = endpoint.http->request_async("GET", "/api/version");
+      } catch (const HttpError &) {
+        endpoint.retry_at = std::chrono::steady_clock::now() + ENDPOINT_RETRY_AFTER;
       }
-    } else {
-      throw OllamaError("Embeddings field is not an array");
     }
+    return false;
+  }
+  if (endpoint.probe.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    return false;
+  }
+  bool recovered = false;
+  try {
+    recovered = endpoint.probe.get().status == 200;
+  } catch (const HttpError &) {
+  }
+  if (recovered) {
+    log::info() << "Embedding endpoint " << endpoint.url << " is back";
+    endpoint.healthy = true;
+  } else {
+    endpoint.retry_at = std::chrono::steady_clock::now() + ENDPOINT_RETRY_AFTER;
+  }
+  return recovered;
+}
+
+void OllamaClient::mark_down(Endpoint &endpoint, const std::string &reason) {
+  std::lock_guard<std::mutex> lock(endpoint.probe_mutex);
+  if (endpoint.healthy.exchange(false) && endpoints_.size() > 1) {
+    log::warning() << "Embedding endpoint " << endpoint.url << " failed (" << reason
+                   << "), sending its requests elsewhere";
+  }
+  endpoint.retry_at = std::chrono::steady_clock::now() + ENDPOINT_RETRY_AFTER;
+}
 
-  } catch (const ollama::exception &e) {
-    // Wrap ollama-hpp exceptions in your custom exception
-    throw OllamaError("Embedding generation failed: " + std::string(e.what()));
+void OllamaClient::release(Endpoint &endpoint) {
+  --endpoint.outstanding;
+  // Taking the mutex orders this after a waiter's check, so its wakeup is not lost
+  {
+    std::lock_guard<std::mutex> lock(capacity_mutex_);
   }
-  catch (const nlohmann::json::exception &e) {
-    throw OllamaError("Failed to parse Ollama JSON: " + std::string(e.what()) + text);
+  capacity_freed_.notify_all();
+}
+
+bool OllamaClient::has_capacity() const {
+  bool any_healthy = false;
+  for (const auto &endpoint : endpoints_) {
+    if (endpoint->healthy) {
+      any_healthy = true;
+      if (static_cast<size_t>(std::max(0, endpoint->outstanding.load())) <
+          endpoint->tuning.in_flight_limit()) {
+        return true;
+      }
+    }
   }
+  // Requests to down endpoints fail or recover them, waiting would not help either
+  return !any_healthy;
+}
+
+void OllamaClient::publish_tuning(Endpoint &endpoint) {
+  endpoint.batch_size_gauge->set(static_cast<double>(endpoint.tuning.batch_size()));
+  endpoint.in_flight_gauge->set(static_cast<double>(endpoint.tuning.in_flight_limit()));
 }
 
 std::string OllamaClient::summarize_text(const std::string &text) {
-  // TODO: Implement text summarization using ollama
-  // For now, return a placeholder
-  return "Summary of: " + text.substr(0, 100) + "...";
+  return generate("Summarize the following text in two or three sentences. Reply with the "
+                  "summary only.\n\n" +
+                  text);
+}
+
+OllamaClient::~OllamaClient() {
+  for (auto &endpoint : endpoints_) {
+    endpoint->http.reset();
+  }
+}
+
+size_t OllamaClient::warm_up() {
+  const std::string body =
+      nlohmann::json{{"model", embedding_model_}, {"input", std::vector<std::string>{"warm up"}}}.dump();
+  std::vector<std::pair<Endpoint *, std::future<HttpResponse>>> replies;
+  for (auto &endpoint : endpoints_) {
+    if (endpoint->healthy) {
+      replies.emplace_back(endpoint.get(), submit(*endpoint, EMBED_PATH, body));
+    }
+  }
+  size_t warmed = 0;
+  for (auto &[endpoint, reply] : replies) {
+    try {
+      HttpResponse response = reply.get();
+      if (response.status == 200) {
+        ++warmed;
+      } else {
+        log::warning() << "Warming up " << embedding_model_ << " on " << endpoint->url
+                       << " failed with HTTP " << response.status;
+      }
+    } catch (const HttpError &e) {
+      log::warning() << "Warming up " << embedding_model_ << " on " << endpoint->url
+                     << " failed: " << e.what();
+    }
+  }
+  return warmed;
 }
 
 bool OllamaClient::is_server_available() {
-  return ollama::is_running();
+  for (auto &endpoint : endpoints_) {
+    if (is_endpoint_available(*endpoint)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool OllamaClient::is_endpoint_available(Endpoint &endpoint) {
+  try {
+    return endpoint.http->request("GET", "/api/version").status == 200;
+  } catch (const HttpError &) {
+    return false;
+  }
+}
+
+std::vector<OllamaEndpointStatus> OllamaClient::endpoint_status() const {
+  std::vector<OllamaEndpointStatus> status;
+  status.reserve(endpoints_.size());
+  for (const auto &endpoint : endpoints_) {
+    status.push_back({endpoint->url, endpoint->healthy, endpoint->outstanding,
+                      endpoint->tuning.batch_size(), endpoint->tuning.in_flight_limit()});
+  }
+  return status;
+}
+
+size_t OllamaClient::embedding_batch_size() const {
+  size_t batch_size = 0;
+  for (const auto &endpoint : endpoints_) {
+    if (endpoint->healthy) {
+      const size_t tuned = endpoint->tuning.batch_size();
+      batch_size = batch_size == 0 ? tuned : std::min(batch_size, tuned);
+    }
+  }
+  return batch_size != 0 ? batch_size : AdaptiveBatchOptions{}.initial_batch;
 }
 
-}  // namespace magic_core
\ No newline at end of file
+}  // namespace magic_core
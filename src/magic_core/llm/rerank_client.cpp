@@ -0,0 +1,82 @@
+#include "magic_core/llm/rerank_client.hpp"
+
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+namespace magic_core {
+
+namespace {
+
+std::vector<float> parse_scores(const HttpResponse &response, size_t documents) {
+  if (response.status != 200) {
+    throw RerankError("Rerank request failed with HTTP " + std::to_string(response.status) +
+                      ": " + response.body);
+  }
+  std::vector<float> scores(documents);
+  std::vector<bool> scored(documents, false);
+  try {
+    auto json_response = nlohmann::json::parse(response.body);
+    if (!json_response.contains("results") || !json_response["results"].is_array()) {
+      throw RerankError("Response does not contain a results array");
+    }
+    for (const auto &result : json_response["results"]) {
+      const size_t index = result.at("index").get<size_t>();
+      if (index >= documents) {
+        throw RerankError("Rerank result index " + std::to_string(index) + " is out of range");
+      }
+      scores[index] = result.at("relevance_score").get<float>();
+      scored[index] = true;
+    }
+  } catch (const nlohmann::json::exception &e) {
+    throw RerankError("Failed to parse rerank JSON: " + std::string(e.what()));
+  }
+  for (size_t i = 0; i < documents; ++i) {
+    if (!scored[i]) {
+      throw RerankError("Rerank response has no score for document " + std::to_string(i));
+    }
+  }
+  return scores;
+}
+
+}  // namespace
+
+std::optional<std::vector<float>> RerankClient::Pending::get(
+    std::chrono::steady_clock::time_point deadline) {
+  if (!reply_.valid()) {
+    throw RerankError("Rerank batch was already collected");
+  }
+  if (reply_.wait_until(deadline) != std::future_status::ready) {
+    return std::nullopt;
+  }
+  try {
+    return parse_scores(reply_.get(), documents_);
+  } catch (const HttpError &e) {
+    throw RerankError("Rerank request failed: " + std::string(e.what()));
+  }
+}
+
+RerankClient::RerankClient(const std::string &url,
+                           std::string model,
+                           HttpClientOptions http_options)
+    : model_(std::move(model)), http_(url, http_options) {}
+
+RerankClient::Pending RerankClient::score_async(const std::string &query,
+                                                const std::vector<std::string> &documents) {
+  // top_n asks servers that cut the list by default to score every document
+  nlohmann::json request = {{"model", model_},
+                            {"query", query},
+                            {"documents", documents},
+                            {"top_n", documents.size()}};
+  return Pending(http_.request_async("POST", RERANK_PATH, request.dump()), documents.size());
+}
+
+std::vector<float> RerankClient::score(const std::string &query,
+                                       const std::vector<std::string> &documents) {
+  Pending pending = score_async(query, documents);
+  // The HTTP request timeout bounds the wait
+  pending.reply_.wait();
+  return *pending.get(std::chrono::steady_clock::now());
+}
+
+}  // namespace magic_core
@@ -1,37 +1,104 @@
 #include "magic_core/services/compression_service.hpp"
+#include <zdict.h>
 #include <zstd.h>
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
+#include <unordered_map>
 
 namespace magic_core {
 
+namespace {
+
+struct CCtxDeleter {
+    void operator()(ZSTD_CCtx* ctx) const { ZSTD_freeCCtx(ctx); }
+};
+struct DCtxDeleter {
+    void operator()(ZSTD_DCtx* ctx) const { ZSTD_freeDCtx(ctx); }
+};
+
+// Contexts keep their tables between calls, so each thread allocates them once
+ZSTD_CCtx* thread_cctx() {
+    thread_local std::unique_ptr<ZSTD_CCtx, CCtxDeleter> ctx(ZSTD_createCCtx());
+    return ctx.get();
+}
+
+ZSTD_DCtx* thread_dctx() {
+    thread_local std::unique_ptr<ZSTD_DCtx, DCtxDeleter> ctx(ZSTD_createDCtx());
+    return ctx.get();
+}
+
+// Digested dictionaries are shared by every thread; callers hold a reference while using one,
+// so clear_dictionaries() never frees one mid-call
+struct Dictionaries {
+    std::shared_mutex mutex;
+    std::unordered_map<uint32_t, std::shared_ptr<ZSTD_DDict>> ddicts;
+    std::shared_ptr<ZSTD_CDict> active_cdict;
+    uint32_t active_id = 0;
+};
+
+Dictionaries& dictionaries() {
+    static Dictionaries instance;
+    return instance;
+}
+
+std::runtime_error zstd_error(const std::string& what, size_t code) {
+    return std::runtime_error(what + ": " + std::string(ZSTD_getErrorName(code)));
+}
+
+}  // namespace
+
 std::vector<char> CompressionService::compress(std::string_view data, int compression_level) {
+    // Frames are compressed into the thread's scratch buffer, sized for the worst case once, so
+    // the result is a single exact-size allocation instead of a compressBound-sized one
+    thread_local std::vector<char> scratch;
+    compress_into(data, scratch, compression_level);
+    return std::vector<char>(scratch.begin(), scratch.end());
+}
+
+void CompressionService::compress_into(std::string_view data,
+                                       std::vector<char>& out,
+                                       int compression_level) {
     if (data.empty()) {
-        return {};
+        out.clear();
+        return;
+    }
+    std::shared_ptr<ZSTD_CDict> cdict;
+    {
+        std::shared_lock lock(dictionaries().mutex);
+        cdict = dictionaries().active_cdict;
     }
     size_t const worst_case_size = ZSTD_compressBound(data.size());
 
-    std::vector<char> compressed_buffer(worst_case_size);
+    out.resize(worst_case_size);
 
-    size_t const compressed_size = ZSTD_compress(
-        compressed_buffer.data(),
-        compressed_buffer.size(),
-        data.data(),
-        data.size(),
-        compression_level
-    );
+    size_t const compressed_size =
+        cdict ? ZSTD_compress_usingCDict(thread_cctx(), out.data(), out.size(), data.data(),
+                                         data.size(), cdict.get())
+              : ZSTD_compressCCtx(thread_cctx(), out.data(), out.size(), data.data(),
+                                  data.size(), compression_level);
 
     if (ZSTD_isError(compressed_size)) {
-        throw std::runtime_error("ZSTD compression failed: " + std::string(ZSTD_getErrorName(compressed_size)));
+        out.clear();
+        throw zstd_error("ZSTD compression failed", compressed_size);
     }
 
-    compressed_buffer.resize(compressed_size);
-
-    return compressed_buffer;
+    out.resize(compressed_size);
 }
 
 std::string CompressionService::decompress(const std::vector<char>& compressed_data) {
+    std::string decompressed_buffer;
+    decompress_into(compressed_data, decompressed_buffer);
+    return decompressed_buffer;
+}
+
+std::string_view CompressionService::decompress_into(const std::vector<char>& compressed_data,
+                                                     std::string& arena) {
     if (compressed_data.empty()) {
-        return "";
+        arena.clear();
+        return arena;
     }
 
     unsigned long long const decompressed_size = ZSTD_getFrameContentSize(compressed_data.data(), compressed_data.size());
@@ -40,20 +107,95 @@ std::string CompressionService::decompress(const std::vector<char>& compressed_d
         throw std::runtime_error("Failed to get decompressed size or data is not zstd format.");
     }
 
-    std::string decompressed_buffer(decompressed_size, '\0');
+    std::shared_ptr<ZSTD_DDict> ddict;
+    if (uint32_t const dict_id = dictionary_id(compressed_data); dict_id != 0) {
+        std::shared_lock lock(dictionaries().mutex);
+        auto it = dictionaries().ddicts.find(dict_id);
+        if (it == dictionaries().ddicts.end()) {
+            throw std::runtime_error("Data was compressed with dictionary " +
+                                     std::to_string(dict_id) + ", which is not registered.");
+        }
+        ddict = it->second;
+    }
 
-    size_t const actual_dSize = ZSTD_decompress(
-        decompressed_buffer.data(),
-        decompressed_buffer.size(),
-        compressed_data.data(),
-        compressed_data.size()
-    );
+    arena.resize(decompressed_size);
+
+    size_t const actual_dSize =
+        ddict ? ZSTD_decompress_usingDDict(thread_dctx(), arena.data(), arena.size(),
+                                           compressed_data.data(), compressed_data.size(),
+                                           ddict.get())
+              : ZSTD_decompressDCtx(thread_dctx(), arena.data(), arena.size(),
+                                    compressed_data.data(), compressed_data.size());
 
     if (ZSTD_isError(actual_dSize) || actual_dSize != decompressed_size) {
-        throw std::runtime_error("ZSTD decompression failed: " + std::string(ZSTD_getErrorName(actual_dSize)));
+        arena.clear();
+        throw zstd_error("ZSTD decompression failed", actual_dSize);
     }
 
-    return decompressed_buffer;
+    return arena;
+}
+
+std::vector<char> CompressionService::train_dictionary(const std::vector<std::string>& samples,
+                                                       size_t capacity) {
+    std::string joined;
+    std::vector<size_t> sizes;
+    sizes.reserve(samples.size());
+    for (const auto& sample : samples) {
+        joined += sample;
+        sizes.push_back(sample.size());
+    }
+    std::vector<char> dictionary(capacity);
+    size_t const size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), joined.data(),
+                                              sizes.data(), static_cast<unsigned>(sizes.size()));
+    if (ZDICT_isError(size)) {
+        throw std::runtime_error("ZSTD dictionary training failed: " +
+                                 std::string(ZDICT_getErrorName(size)));
+    }
+    dictionary.resize(size);
+    return dictionary;
+}
+
+uint32_t CompressionService::register_dictionary(const std::vector<char>& dictionary,
+                                                 bool activate,
+                                                 int compression_level) {
+    uint32_t const dict_id = ZDICT_getDictID(dictionary.data(), dictionary.size());
+    if (dict_id == 0) {
+        throw std::invalid_argument("Not a zstd dictionary");
+    }
+    std::shared_ptr<ZSTD_DDict> ddict(ZSTD_createDDict(dictionary.data(), dictionary.size()),
+                                      ZSTD_freeDDict);
+    std::shared_ptr<ZSTD_CDict> cdict;
+    if (activate) {
+        cdict.reset(ZSTD_createCDict(dictionary.data(), dictionary.size(), compression_level),
+                    ZSTD_freeCDict);
+    }
+    if (!ddict || (activate && !cdict)) {
+        throw std::invalid_argument("Failed to load zstd dictionary " + std::to_string(dict_id));
+    }
+
+    std::unique_lock lock(dictionaries().mutex);
+    dictionaries().ddicts[dict_id] = std::move(ddict);
+    if (activate) {
+        dictionaries().active_cdict = std::move(cdict);
+        dictionaries().active_id = dict_id;
+    }
+    return dict_id;
+}
+
+uint32_t CompressionService::active_dictionary_id() {
+    std::shared_lock lock(dictionaries().mutex);
+    return dictionaries().active_id;
 }
 
-}
\ No newline at end of file
+uint32_t CompressionService::dictionary_id(const std::vector<char>& compressed_data) {
+    return ZSTD_getDictID_fromFrame(compressed_data.data(), compressed_data.size());
+}
+
+void CompressionService::clear_dictionaries() {
+    std::unique_lock lock(dictionaries().mutex);
+    dictionaries().ddicts.clear();
+    dictionaries().active_cdict.reset();
+    dictionaries().active_id = 0;
+}
+
+}
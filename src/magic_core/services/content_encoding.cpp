@@ -0,0 +1,141 @@
+#include "magic_core/services/content_encoding.hpp"
+
+#include <zlib.h>
+#include <zstd.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+
+namespace magic_core {
+
+namespace {
+
+struct CCtxDeleter {
+  void operator()(ZSTD_CCtx* ctx) const { ZSTD_freeCCtx(ctx); }
+};
+
+ZSTD_CCtx* thread_cctx() {
+  thread_local std::unique_ptr<ZSTD_CCtx, CCtxDeleter> ctx(ZSTD_createCCtx());
+  return ctx.get();
+}
+
+std::string_view trimmed(std::string_view text) {
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+bool equals_ignoring_case(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) !=
+        std::tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string zstd_encode(std::string_view body) {
+  std::string out(ZSTD_compressBound(body.size()), '\0');
+  ZSTD_CCtx* cctx = thread_cctx();
+  ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+  ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, ContentEncoder::ZSTD_LEVEL);
+  // Lets the client size its buffer up front
+  ZSTD_CCtx_setParameter(cctx, ZSTD_c_contentSizeFlag, 1);
+  const size_t size = ZSTD_compress2(cctx, out.data(), out.size(), body.data(), body.size());
+  if (ZSTD_isError(size)) {
+    throw std::runtime_error("zstd response compression failed: " +
+                             std::string(ZSTD_getErrorName(size)));
+  }
+  out.resize(size);
+  return out;
+}
+
+std::string gzip_encode(std::string_view body) {
+  z_stream stream{};
+  // 15 window bits, plus 16 for the gzip wrapper rather than zlib's
+  if (deflateInit2(&stream, ContentEncoder::GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("gzip response compression failed to initialize");
+  }
+  std::string out(deflateBound(&stream, static_cast<uLong>(body.size())), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+  stream.avail_in = static_cast<uInt>(body.size());
+  stream.next_out = reinterpret_cast<Bytef*>(out.data());
+  stream.avail_out = static_cast<uInt>(out.size());
+  const int result = deflate(&stream, Z_FINISH);
+  const size_t size = stream.total_out;
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    throw std::runtime_error("gzip response compression failed");
+  }
+  out.resize(size);
+  return out;
+}
+
+}  // namespace
+
+ContentEncoding ContentEncoder::negotiate(std::string_view accept_encoding) {
+  bool zstd = false;
+  bool gzip = false;
+  while (!accept_encoding.empty()) {
+    const size_t comma = accept_encoding.find(',');
+    std::string_view coding = accept_encoding.substr(0, comma);
+    accept_encoding = comma == std::string_view::npos ? std::string_view()
+                                                      : accept_encoding.substr(comma + 1);
+    double quality = 1.0;
+    const size_t semicolon = coding.find(';');
+    if (semicolon != std::string_view::npos) {
+      std::string_view parameter = trimmed(coding.substr(semicolon + 1));
+      if (parameter.size() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') &&
+          parameter[1] == '=') {
+        quality = std::strtod(std::string(parameter.substr(2)).c_str(), nullptr);
+      }
+      coding = coding.substr(0, semicolon);
+    }
+    coding = trimmed(coding);
+    if (quality <= 0.0) {
+      continue;
+    }
+    if (equals_ignoring_case(coding, "zstd")) {
+      zstd = true;
+    } else if (equals_ignoring_case(coding, "gzip") || equals_ignoring_case(coding, "x-gzip") ||
+               coding == "*") {
+      gzip = true;
+    }
+  }
+  return zstd ? ContentEncoding::Zstd : gzip ? ContentEncoding::Gzip : ContentEncoding::Identity;
+}
+
+const char* ContentEncoder::token(ContentEncoding encoding) {
+  switch (encoding) {
+    case ContentEncoding::Zstd:
+      return "zstd";
+    case ContentEncoding::Gzip:
+      return "gzip";
+    default:
+      return "";
+  }
+}
+
+std::string ContentEncoder::encode(std::string_view body, ContentEncoding encoding) {
+  switch (encoding) {
+    case ContentEncoding::Zstd:
+      return zstd_encode(body);
+    case ContentEncoding::Gzip:
+      return gzip_encode(body);
+    default:
+      return std::string(body);
+  }
+}
+
+}  // namespace magic_core
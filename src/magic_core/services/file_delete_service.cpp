@@ -3,11 +3,19 @@
 namespace magic_core {
 
 FileDeleteService::FileDeleteService(std::shared_ptr<magic_core::MetadataStore> metadata_store)
-    : metadata_store_(metadata_store) {}
+    : metadata_store_(std::make_shared<ShardedMetadataStore>(std::move(metadata_store))) {}
+
+FileDeleteService::FileDeleteService(
+    std::shared_ptr<magic_core::ShardedMetadataStore> metadata_store)
+    : metadata_store_(std::move(metadata_store)) {}
 
 void FileDeleteService::delete_file(const std::filesystem::path &file_path) {
-  // First, we need to delete the file from the sqllite table
+  // Removes the row, its chunks and their vectors from the file and chunk indexes
   metadata_store_->delete_file_metadata(file_path);
-  // Now we need to make sure to delete the file from the in memory vector store
+}
+
+size_t FileDeleteService::delete_directory(const std::filesystem::path &directory) {
+  // One write and one index update for the whole directory, however many files it held
+  return metadata_store_->delete_files_under(directory.string());
 }
 }  // namespace magic_core
\ No newline at end of file
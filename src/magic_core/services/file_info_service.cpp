@@ -4,14 +4,27 @@ namespace magic_core {
 // This is a basic wrapper right now, but eventually would provide necessary statistics and other
 // business logic
 FileInfoService::FileInfoService(std::shared_ptr<magic_core::MetadataStore> metadata_store)
-    : metadata_store_(metadata_store) {}
+    : metadata_store_(std::make_shared<ShardedMetadataStore>(std::move(metadata_store))) {}
+
+FileInfoService::FileInfoService(
+    std::shared_ptr<magic_core::ShardedMetadataStore> metadata_store)
+    : metadata_store_(std::move(metadata_store)) {}
 
 std::vector<magic_core::FileMetadata> FileInfoService::list_files() {
   return metadata_store_->list_all_files();
 }
 
+std::vector<magic_core::BasicFileMetadata> FileInfoService::list_files_page(int64_t after_id,
+                                                                           int limit) {
+  return metadata_store_->list_files_page(after_id, limit);
+}
+
 std::optional<magic_core::FileMetadata> FileInfoService::get_file_info(
     const std::filesystem::path &file_path) {
   return metadata_store_->get_file_metadata(file_path);
 }
+
+std::vector<magic_core::CollectionInfo> FileInfoService::list_collections() {
+  return metadata_store_->collections();
+}
 }  // namespace magic_core
\ No newline at end of file
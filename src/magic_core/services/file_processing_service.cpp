@@ -1,10 +1,85 @@
 #include "magic_core/services/file_processing_service.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+#include "magic_core/async/bounded_queue.hpp"
 #include "magic_core/db/metadata_store.hpp"
+#include "magic_core/types/logger.hpp"
 // #include "magic_core/services/compression_service.hpp" // not used here
 
 namespace magic_core {
 
+namespace {
+
+// Directories still to be listed, shared by the walker threads. The walk is over once nothing
+// is pending and no walker is listing a directory that could add more.
+class DirectoryFrontier {
+ public:
+  explicit DirectoryFrontier(std::filesystem::path root) {
+    pending_.push_back(std::move(root));
+  }
+
+  std::optional<std::filesystem::path> next() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return stopped_ || !pending_.empty() || active_ == 0; });
+    if (stopped_ || pending_.empty()) {
+      return std::nullopt;
+    }
+    std::filesystem::path directory = std::move(pending_.back());
+    pending_.pop_back();
+    ++active_;
+    return directory;
+  }
+
+  void add(std::filesystem::path directory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(std::move(directory));
+    cv_.notify_one();
+  }
+
+  // Called once a directory returned by next() has been listed
+  void done() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --active_;
+    if (active_ == 0 && pending_.empty()) {
+      cv_.notify_all();
+    }
+  }
+
+  void stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::filesystem::path> pending_;
+  size_t active_ = 0;
+  bool stopped_ = false;
+};
+
+struct HashedFile {
+  std::filesystem::path path;
+  std::optional<BasicFileMetadata> stub;
+  bool unsupported = false;
+  std::string error;
+};
+
+size_t thread_count(size_t max_threads) {
+  return std::clamp<size_t>(std::thread::hardware_concurrency(), 1, max_threads);
+}
+
+}  // namespace
+
 auto to_sys_time = [](std::filesystem::file_time_type ftime) {
   return std::chrono::time_point_cast<std::chrono::system_clock::duration>(
       ftime - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now());
@@ -15,6 +90,15 @@ FileProcessingService::FileProcessingService(
     std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo,
     std::shared_ptr<magic_core::ContentExtractorFactory> content_extractor_factory,
     std::shared_ptr<magic_core::OllamaClient> ollama_client)
+    : FileProcessingService(std::make_shared<ShardedMetadataStore>(std::move(metadata_store)),
+                            std::move(task_queue_repo), std::move(content_extractor_factory),
+                            std::move(ollama_client)) {}
+
+FileProcessingService::FileProcessingService(
+    std::shared_ptr<magic_core::ShardedMetadataStore> metadata_store,
+    std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo,
+    std::shared_ptr<magic_core::ContentExtractorFactory> content_extractor_factory,
+    std::shared_ptr<magic_core::OllamaClient> ollama_client)
     : metadata_store_(metadata_store),
       task_queue_repo_(task_queue_repo),
       content_extractor_factory_(content_extractor_factory),
@@ -39,7 +123,7 @@ BasicFileMetadata FileProcessingService::create_file_stub(const std::filesystem:
 
 // Acts as a preflight check to make sure the request is valid and we are not just wasting time
 std::optional<long long> FileProcessingService::request_processing(
-    const std::filesystem::path& file_path) {
+    const std::filesystem::path& file_path, int priority) {
   // Quick preflight: path must exist
   if (!std::filesystem::exists(file_path)) {
     return std::nullopt;
@@ -49,15 +133,213 @@ std::optional<long long> FileProcessingService::request_processing(
       content_extractor_factory_->get_extractor_for(file_path);
   std::string content_hash = extractor.get_content_hash(file_path);
 
-  auto requested_file_processing_status = metadata_store_->file_processing_status(content_hash);
+  MetadataStore& store = metadata_store_->for_path(file_path.string());
+  auto requested_file_processing_status = store.file_processing_status(content_hash);
   if (requested_file_processing_status.has_value() &&
       *requested_file_processing_status != ProcessingStatus::FAILED) {
+    // A new path (or one that held other content) shares the stored content's chunks
+    auto stored = store.get_basic_file_metadata(file_path.string());
+    if ((!stored || stored->content_hash != content_hash) &&
+        store.add_duplicate_files(
+            {create_file_stub(file_path, extractor.get_file_type(), content_hash)})
+            .front()) {
+      log::info() << "Recorded " << file_path << " as a duplicate of stored content";
+    }
     return std::nullopt;
   }
-  metadata_store_->upsert_file_stub(
-      create_file_stub(file_path, extractor.get_file_type(), content_hash));
-  long long task_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", file_path.string());
+  store.upsert_file_stub(create_file_stub(file_path, extractor.get_file_type(), content_hash));
+  long long task_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", file_path.string(), priority);
   return task_id;
 }
 
-}  // namespace magic_core
\ No newline at end of file
+/*
+Walks the tree with a few lister threads feeding a pool of hashers, while the calling thread
+groups the hashed files into batches. Each batch costs one status lookup, one stub transaction
+and one task transaction. Symlinks are not followed, so the walk cannot loop.
+*/
+DirectoryProcessingResult FileProcessingService::request_directory_processing(
+    const std::filesystem::path& directory, int priority, bool bulk_load) {
+  if (!std::filesystem::is_directory(directory)) {
+    throw std::invalid_argument("Not a directory: " + directory.string());
+  }
+
+  DirectoryProcessingResult result;
+  result.bulk_load = bulk_load;
+  std::mutex errors_mutex;
+  auto record_error = [&](const std::filesystem::path& path, const std::string& reason) {
+    std::lock_guard<std::mutex> lock(errors_mutex);
+    result.errors.push_back(path.string() + ": " + reason);
+  };
+
+  const size_t walk_threads = thread_count(MAX_WALK_THREADS);
+  const size_t hash_threads = thread_count(MAX_HASH_THREADS);
+  DirectoryFrontier frontier(directory);
+  async::BoundedQueue<std::filesystem::path> files(DIRECTORY_BATCH_SIZE);
+  async::BoundedQueue<HashedFile> hashed(DIRECTORY_BATCH_SIZE);
+  // The last thread out of each stage closes the queue it feeds
+  std::atomic<size_t> walkers_running{walk_threads};
+  std::atomic<size_t> hashers_running{hash_threads};
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < walk_threads; ++i) {
+    threads.emplace_back([&] {
+      while (auto current = frontier.next()) {
+        std::error_code ec;
+        std::filesystem::directory_iterator it(
+            *current, std::filesystem::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+          std::error_code status_ec;
+          const auto status = it->symlink_status(status_ec);
+          if (status_ec) {
+            continue;
+          }
+          if (std::filesystem::is_directory(status)) {
+            frontier.add(it->path());
+          } else if (std::filesystem::is_regular_file(status) && !files.push(it->path())) {
+            frontier.stop();
+            break;
+          }
+        }
+        if (ec) {
+          record_error(*current, ec.message());
+        }
+        frontier.done();
+      }
+      if (--walkers_running == 0) {
+        files.close();
+      }
+    });
+  }
+  for (size_t i = 0; i < hash_threads; ++i) {
+    threads.emplace_back([&] {
+      while (auto path = files.pop()) {
+        HashedFile file{*path};
+        const ContentExtractor* extractor = nullptr;
+        try {
+          extractor = &content_extractor_factory_->get_extractor_for(*path);
+        } catch (const std::runtime_error&) {
+          file.unsupported = true;
+        }
+        if (extractor != nullptr) {
+          try {
+            file.stub = create_file_stub(*path, extractor->get_file_type(),
+                                         extractor->get_content_hash(*path));
+          } catch (const std::exception& e) {
+            file.error = e.what();
+          }
+        }
+        if (!hashed.push(std::move(file))) {
+          break;
+        }
+      }
+      if (--hashers_running == 0) {
+        hashed.close();
+      }
+    });
+  }
+
+  auto shut_down = [&] {
+    frontier.stop();
+    files.close();
+    hashed.close();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  };
+
+  // Per shard: a copy can only share the chunks of content stored in its own shard
+  std::vector<std::unordered_set<std::string>> queued_hashes(metadata_store_->shard_count());
+  // A bulk load is opened only on the shards the walk writes to, so importing one collection
+  // leaves the others' indexes live. Each stays pinned until the walk is over: workers may
+  // drain one batch's tasks before the next is queued.
+  std::vector<bool> bulk_opened(metadata_store_->shard_count(), false);
+  std::vector<MetadataStore::BulkLoadPin> bulk_pins;
+  std::vector<BasicFileMetadata> batch;
+  auto flush_shard = [&](size_t shard, std::vector<BasicFileMetadata>& stubs) {
+    MetadataStore& store = metadata_store_->shard(shard);
+    if (bulk_load && !bulk_opened[shard]) {
+      // Before the shard's first task is queued, so its first file processed already skips
+      // the indexes
+      bulk_pins.push_back(store.pin_bulk_load());
+      store.begin_bulk_load();
+      bulk_opened[shard] = true;
+    }
+    std::vector<std::string> hashes;
+    hashes.reserve(stubs.size());
+    for (const auto& stub : stubs) {
+      hashes.push_back(stub.content_hash);
+    }
+    auto statuses = store.file_processing_statuses(hashes);
+
+    std::vector<BasicFileMetadata> to_queue;
+    std::vector<BasicFileMetadata> duplicates;
+    std::vector<std::string> paths;
+    for (auto& stub : stubs) {
+      auto status = statuses.find(stub.content_hash);
+      bool already_known =
+          status != statuses.end() && status->second != ProcessingStatus::FAILED;
+      if (already_known || !queued_hashes[shard].insert(stub.content_hash).second) {
+        duplicates.push_back(std::move(stub));
+        continue;
+      }
+      paths.push_back(stub.path);
+      to_queue.push_back(std::move(stub));
+    }
+
+    store.upsert_file_stubs(to_queue);
+    auto task_ids = task_queue_repo_->create_file_process_tasks("PROCESS_FILE", paths, priority);
+    result.task_ids.insert(result.task_ids.end(), task_ids.begin(), task_ids.end());
+    // After the stubs, so a copy of a file in this batch finds its row
+    for (bool added : store.add_duplicate_files(duplicates)) {
+      ++(added ? result.duplicates : result.skipped);
+    }
+  };
+  auto flush = [&] {
+    if (batch.empty()) {
+      return;
+    }
+    if (metadata_store_->shard_count() == 1) {
+      flush_shard(0, batch);
+    } else {
+      std::vector<std::vector<BasicFileMetadata>> by_shard(metadata_store_->shard_count());
+      for (auto& stub : batch) {
+        by_shard[metadata_store_->shard_map().shard_for_path(stub.path)].push_back(
+            std::move(stub));
+      }
+      for (size_t shard = 0; shard < by_shard.size(); ++shard) {
+        if (!by_shard[shard].empty()) {
+          flush_shard(shard, by_shard[shard]);
+        }
+      }
+    }
+    batch.clear();
+  };
+
+  try {
+    while (auto file = hashed.pop()) {
+      ++result.files_found;
+      if (file->unsupported) {
+        ++result.unsupported;
+      } else if (!file->stub.has_value()) {
+        record_error(file->path, file->error);
+      } else {
+        batch.push_back(std::move(*file->stub));
+        if (batch.size() >= DIRECTORY_BATCH_SIZE) {
+          flush();
+        }
+      }
+    }
+    flush();
+  } catch (...) {
+    shut_down();
+    throw;
+  }
+  shut_down();
+
+  if (!result.errors.empty()) {
+    log::info() << "Skipped " << result.errors.size() << " unreadable files under " << directory;
+  }
+  return result;
+}
+
+}  // namespace magic_core
@@ -0,0 +1,372 @@
+#include "magic_core/services/file_watch_backend.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <CoreServices/CoreServices.h>
+#include <dispatch/dispatch.h>
+#endif
+
+#include "magic_core/types/logger.hpp"
+
+namespace magic_core {
+
+namespace {
+
+bool is_plain_file(const std::filesystem::directory_entry &entry) {
+  std::error_code ec;
+  return entry.symlink_status(ec).type() == std::filesystem::file_type::regular;
+}
+
+bool is_plain_directory(const std::filesystem::directory_entry &entry) {
+  std::error_code ec;
+  return entry.symlink_status(ec).type() == std::filesystem::file_type::directory;
+}
+
+// Reports every regular file below root as modified. Used for directories that appear in a
+// watched tree (their files may have been written before a watch existed) and for rescans.
+void report_tree(const std::filesystem::path &root,
+                 const FileWatchBackend::ChangeCallback &on_change) {
+  std::error_code ec;
+  std::filesystem::recursive_directory_iterator it(
+      root, std::filesystem::directory_options::skip_permission_denied, ec);
+  for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+    if (is_plain_file(*it)) {
+      on_change(it->path(), FileChangeKind::Modified);
+    }
+  }
+}
+
+#if defined(__linux__)
+
+class InotifyWatchBackend : public FileWatchBackend {
+ public:
+  explicit InotifyWatchBackend(std::vector<std::filesystem::path> roots)
+      : roots_(std::move(roots)) {
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+      throw std::runtime_error(std::string("inotify_init1 failed: ") + std::strerror(errno));
+    }
+    if (pipe2(wake_pipe_, O_NONBLOCK | O_CLOEXEC) != 0) {
+      close(inotify_fd_);
+      throw std::runtime_error(std::string("pipe2 failed: ") + std::strerror(errno));
+    }
+    size_t failures = 0;
+    for (const auto &root : roots_) {
+      failures += add_watches(root);
+    }
+    if (failures > 0) {
+      close_fds();
+      throw std::runtime_error("could not watch " + std::to_string(failures) +
+                               " directories (is fs.inotify.max_user_watches too low?)");
+    }
+  }
+
+  ~InotifyWatchBackend() override {
+    close_fds();
+  }
+
+  void run(const ChangeCallback &on_change) override {
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {wake_pipe_[0], POLLIN, 0}};
+    while (true) {
+      if (poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::runtime_error(std::string("poll on inotify failed: ") + std::strerror(errno));
+      }
+      if (fds[1].revents != 0) {
+        return;
+      }
+      if ((fds[0].revents & POLLIN) == 0) {
+        continue;
+      }
+      ssize_t length;
+      while ((length = read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+        for (char *ptr = buffer; ptr < buffer + length;) {
+          const auto *event = reinterpret_cast<const struct inotify_event *>(ptr);
+          handle_event(*event, on_change);
+          ptr += sizeof(struct inotify_event) + event->len;
+        }
+      }
+    }
+  }
+
+  void stop() override {
+    const char byte = 1;
+    // A full pipe already holds a pending wakeup, so a failed write can be ignored
+    (void)!write(wake_pipe_[1], &byte, 1);
+  }
+
+  std::string name() const override {
+    return "inotify";
+  }
+
+ private:
+  static constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE |
+                                         IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR |
+                                         IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+  void handle_event(const struct inotify_event &event, const ChangeCallback &on_change) {
+    if (event.mask & IN_Q_OVERFLOW) {
+      // Events were dropped. Re-reporting everything is safe because processing skips
+      // unchanged content; deletions made during the overflow are picked up by a later rescan.
+      log::warning() << "inotify queue overflowed, rescanning watched directories";
+      for (const auto &root : roots_) {
+        report_tree(root, on_change);
+      }
+      return;
+    }
+    auto watched = watch_paths_.find(event.wd);
+    if (watched == watch_paths_.end()) {
+      return;
+    }
+    if (event.mask & IN_IGNORED) {
+      watch_paths_.erase(watched);
+      return;
+    }
+    if (event.len == 0) {
+      return;
+    }
+
+    std::filesystem::path path = watched->second / event.name;
+    if (event.mask & IN_ISDIR) {
+      if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+        add_watches(path);
+        report_tree(path, on_change);
+      } else if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+        on_change(path, FileChangeKind::RemovedTree);
+      }
+      return;
+    }
+    if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+      on_change(path, FileChangeKind::Removed);
+    } else {
+      on_change(path, FileChangeKind::Modified);
+    }
+  }
+
+  // Watches directory and every directory below it. Returns the number that failed.
+  size_t add_watches(const std::filesystem::path &directory) {
+    size_t failures = add_watch(directory) ? 0 : 1;
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(
+        directory, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+      if (is_plain_directory(*it) && !add_watch(it->path())) {
+        ++failures;
+      }
+    }
+    return failures;
+  }
+
+  bool add_watch(const std::filesystem::path &directory) {
+    int wd = inotify_add_watch(inotify_fd_, directory.c_str(), WATCH_MASK);
+    if (wd < 0) {
+      log::warning() << "Could not watch " << directory << ": " << std::strerror(errno);
+      return false;
+    }
+    // A directory moved within the tree keeps its watch descriptor, so this also renames it
+    watch_paths_[wd] = directory;
+    return true;
+  }
+
+  void close_fds() {
+    for (int fd : {inotify_fd_, wake_pipe_[0], wake_pipe_[1]}) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+    inotify_fd_ = wake_pipe_[0] = wake_pipe_[1] = -1;
+  }
+
+  std::vector<std::filesystem::path> roots_;
+  int inotify_fd_ = -1;
+  int wake_pipe_[2] = {-1, -1};
+  // Only touched by the constructor and the run() thread
+  std::unordered_map<int, std::filesystem::path> watch_paths_;
+};
+
+using NativeWatchBackend = InotifyWatchBackend;
+
+#elif defined(__APPLE__)
+
+class FSEventsWatchBackend : public FileWatchBackend {
+ public:
+  explicit FSEventsWatchBackend(std::vector<std::filesystem::path> roots)
+      : roots_(std::move(roots)) {}
+
+  void run(const ChangeCallback &on_change) override {
+    on_change_ = &on_change;
+    CFMutableArrayRef paths = CFArrayCreateMutable(nullptr, 0, &kCFTypeArrayCallBacks);
+    for (const auto &root : roots_) {
+      CFStringRef path =
+          CFStringCreateWithCString(nullptr, root.c_str(), kCFStringEncodingUTF8);
+      CFArrayAppendValue(paths, path);
+      CFRelease(path);
+    }
+
+    FSEventStreamContext context{0, this, nullptr, nullptr, nullptr};
+    FSEventStreamRef stream = FSEventStreamCreate(
+        nullptr, &FSEventsWatchBackend::on_events, &context, paths, kFSEventStreamEventIdSinceNow,
+        LATENCY_SECONDS, kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagNoDefer);
+    CFRelease(paths);
+    if (stream == nullptr) {
+      throw std::runtime_error("FSEventStreamCreate failed");
+    }
+
+    dispatch_queue_t queue = dispatch_queue_create("magic_folder.file_watcher", nullptr);
+    FSEventStreamSetDispatchQueue(stream, queue);
+    bool started = FSEventStreamStart(stream);
+    if (started) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stopped_; });
+      FSEventStreamStop(stream);
+    }
+    FSEventStreamInvalidate(stream);
+    FSEventStreamRelease(stream);
+    // Drain a callback that may still be running before on_change goes out of scope
+    dispatch_sync_f(queue, nullptr, [](void *) {});
+    dispatch_release(queue);
+    if (!started) {
+      throw std::runtime_error("FSEventStreamStart failed");
+    }
+  }
+
+  void stop() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    cv_.notify_all();
+  }
+
+  std::string name() const override {
+    return "fsevents";
+  }
+
+ private:
+  // FSEvents' own coalescing window; FileWatcherService debounces on top of it
+  static constexpr CFTimeInterval LATENCY_SECONDS = 0.1;
+
+  static void on_events(ConstFSEventStreamRef /*stream*/,
+                        void *info,
+                        size_t count,
+                        void *event_paths,
+                        const FSEventStreamEventFlags flags[],
+                        const FSEventStreamEventId /*ids*/[]) {
+    auto *self = static_cast<FSEventsWatchBackend *>(info);
+    auto **paths = static_cast<char **>(event_paths);
+    for (size_t i = 0; i < count; ++i) {
+      self->handle_event(paths[i], flags[i]);
+    }
+  }
+
+  // FSEvents coalesces flags, so whether the item still exists decides what happened to it
+  void handle_event(const std::filesystem::path &path, FSEventStreamEventFlags flags) {
+    if (flags & (kFSEventStreamEventFlagMustScanSubDirs | kFSEventStreamEventFlagRootChanged)) {
+      report_tree(path, *on_change_);
+      return;
+    }
+    std::error_code ec;
+    bool exists = std::filesystem::exists(std::filesystem::symlink_status(path, ec));
+    if (flags & kFSEventStreamEventFlagItemIsDir) {
+      if (!exists) {
+        (*on_change_)(path, FileChangeKind::RemovedTree);
+      } else if (flags & (kFSEventStreamEventFlagItemCreated | kFSEventStreamEventFlagItemRenamed)) {
+        report_tree(path, *on_change_);
+      }
+      return;
+    }
+    if (flags & kFSEventStreamEventFlagItemIsFile) {
+      (*on_change_)(path, exists ? FileChangeKind::Modified : FileChangeKind::Removed);
+    }
+  }
+
+  std::vector<std::filesystem::path> roots_;
+  const ChangeCallback *on_change_ = nullptr;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopped_ = false;
+};
+
+using NativeWatchBackend = FSEventsWatchBackend;
+
+#endif
+
+}  // namespace
+
+PollingWatchBackend::PollingWatchBackend(std::vector<std::filesystem::path> roots,
+                                         std::chrono::milliseconds interval)
+    : roots_(std::move(roots)), interval_(interval) {}
+
+void PollingWatchBackend::run(const ChangeCallback &on_change) {
+  Snapshot previous = take_snapshot();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!cv_.wait_for(lock, interval_, [this] { return stopped_; })) {
+    lock.unlock();
+    Snapshot current = take_snapshot();
+    for (const auto &[path, stamp] : current) {
+      auto before = previous.find(path);
+      if (before == previous.end() || before->second.last_write != stamp.last_write ||
+          before->second.size != stamp.size) {
+        on_change(path, FileChangeKind::Modified);
+      }
+    }
+    for (const auto &[path, stamp] : previous) {
+      if (current.find(path) == current.end()) {
+        on_change(path, FileChangeKind::Removed);
+      }
+    }
+    previous = std::move(current);
+    lock.lock();
+  }
+}
+
+void PollingWatchBackend::stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stopped_ = true;
+  cv_.notify_all();
+}
+
+PollingWatchBackend::Snapshot PollingWatchBackend::take_snapshot() const {
+  Snapshot snapshot;
+  for (const auto &root : roots_) {
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(
+        root, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+      if (!is_plain_file(*it)) {
+        continue;
+      }
+      std::error_code stat_ec;
+      FileStamp stamp{it->last_write_time(stat_ec), it->file_size(stat_ec)};
+      if (!stat_ec) {
+        snapshot.emplace(it->path().string(), stamp);
+      }
+    }
+  }
+  return snapshot;
+}
+
+std::unique_ptr<FileWatchBackend> create_file_watch_backend(
+    const std::vector<std::filesystem::path> &roots) {
+#if defined(__linux__) || defined(__APPLE__)
+  try {
+    return std::make_unique<NativeWatchBackend>(roots);
+  } catch (const std::exception &e) {
+    log::warning() << "Native file watching unavailable (" << e.what()
+                   << "), falling back to polling";
+  }
+#endif
+  return std::make_unique<PollingWatchBackend>(roots);
+}
+
+}  // namespace magic_core
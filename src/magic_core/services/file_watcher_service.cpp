@@ -0,0 +1,230 @@
+#include "magic_core/services/file_watcher_service.hpp"
+
+#include <algorithm>
+
+#include "magic_core/types/logger.hpp"
+
+namespace magic_core {
+
+namespace {
+
+// Glob match supporting '*' (any run) and '?' (any single character)
+bool glob_match(const std::string &pattern, const std::string &name) {
+  size_t p = 0, n = 0, star = std::string::npos, resume = 0;
+  while (n < name.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+      ++p;
+      ++n;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      resume = n;
+    } else if (star != std::string::npos) {
+      p = star + 1;
+      n = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+}  // namespace
+
+FileWatcherService::FileWatcherService(
+    std::shared_ptr<FileProcessingService> file_processing_service,
+    std::shared_ptr<FileDeleteService> file_delete_service,
+    std::vector<std::filesystem::path> roots,
+    FileWatcherOptions options,
+    std::unique_ptr<FileWatchBackend> backend)
+    : file_processing_service_(file_processing_service),
+      file_delete_service_(file_delete_service),
+      options_(std::move(options)),
+      backend_(std::move(backend)) {
+  // Stored paths come from the watcher, so make them independent of the working directory
+  for (const auto &root : roots) {
+    roots_.push_back(std::filesystem::absolute(root).lexically_normal());
+  }
+}
+
+FileWatcherService::~FileWatcherService() {
+  stop();
+}
+
+void FileWatcherService::start() {
+  if (running_.exchange(true)) {
+    return;
+  }
+  if (!backend_) {
+    backend_ = create_file_watch_backend(roots_);
+  }
+  log::info() << "Watching " << roots_.size() << " directories with the " << backend_->name()
+              << " backend";
+  backend_thread_ = std::make_unique<std::thread>(&FileWatcherService::backend_loop, this);
+  dispatch_thread_ = std::make_unique<std::thread>(&FileWatcherService::dispatch_loop, this);
+}
+
+void FileWatcherService::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(backend_mutex_);
+    backend_->stop();
+  }
+  stop_cv_.notify_all();
+  backend_thread_->join();
+  dispatch_thread_->join();
+  backend_thread_.reset();
+  dispatch_thread_.reset();
+  // Nothing new can arrive now, so flush what would otherwise be lost
+  dispatch_settled(std::chrono::steady_clock::time_point::max());
+}
+
+bool FileWatcherService::is_running() const {
+  return running_;
+}
+
+void FileWatcherService::record_change(const std::filesystem::path &path,
+                                       FileChangeKind kind,
+                                       std::chrono::steady_clock::time_point now) {
+  if (is_ignored(path)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  auto [it, inserted] = pending_.try_emplace(path.string(), PendingChange{kind, now, now});
+  if (!inserted) {
+    // A removed tree also covers the single-file events that trail it
+    if (it->second.kind != FileChangeKind::RemovedTree || kind == FileChangeKind::Modified) {
+      it->second.kind = kind;
+    }
+    it->second.last_seen = now;
+  }
+}
+
+size_t FileWatcherService::dispatch_settled(std::chrono::steady_clock::time_point now) {
+  const auto max_delay = options_.settle * MAX_SETTLE_WINDOWS;
+  std::vector<std::pair<std::string, FileChangeKind>> ready;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    for (auto it = pending_.begin(); it != pending_.end();) {
+      const PendingChange &change = it->second;
+      if (now - change.last_seen >= options_.settle || now - change.first_seen >= max_delay) {
+        ready.emplace_back(it->first, it->second.kind);
+        it = pending_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (const auto &[path, kind] : ready) {
+    dispatch(path, kind);
+  }
+  return ready.size();
+}
+
+size_t FileWatcherService::pending_count() const {
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  return pending_.size();
+}
+
+void FileWatcherService::backend_loop() {
+  auto on_change = [this](const std::filesystem::path &path, FileChangeKind kind) {
+    record_change(path, kind);
+  };
+  try {
+    backend_->run(on_change);
+    return;
+  } catch (const std::exception &e) {
+    log::warning() << "File watch backend " << backend_->name() << " failed: " << e.what();
+  }
+  {
+    std::lock_guard<std::mutex> lock(backend_mutex_);
+    if (!running_) {
+      return;
+    }
+    log::warning() << "Falling back to polling for file changes";
+    backend_ = std::make_unique<PollingWatchBackend>(roots_);
+  }
+  try {
+    backend_->run(on_change);
+  } catch (const std::exception &e) {
+    log::error() << "File watching stopped: " << e.what();
+  }
+}
+
+bool FileWatcherService::is_ignored(const std::filesystem::path &path) const {
+  const std::string name = path.filename().string();
+  if (name.empty()) {
+    return true;
+  }
+  for (const auto &pattern : options_.ignore) {
+    if (glob_match(pattern, name)) {
+      return true;
+    }
+  }
+  if (options_.recursive) {
+    return false;
+  }
+  const auto parent = path.parent_path();
+  return std::none_of(roots_.begin(), roots_.end(),
+                      [&](const std::filesystem::path &root) { return root == parent; });
+}
+
+// Hashing skips files whose content is already queued or indexed, so this only costs reads
+void FileWatcherService::scan_roots() {
+  for (const auto &root : roots_) {
+    try {
+      if (options_.recursive) {
+        file_processing_service_->request_directory_processing(root);
+        continue;
+      }
+      std::error_code ec;
+      for (std::filesystem::directory_iterator it(root, ec), end; !ec && it != end;
+           it.increment(ec)) {
+        record_change(it->path(), FileChangeKind::Modified);
+      }
+    } catch (const std::exception &e) {
+      log::warning() << "Initial scan of " << root << " failed: " << e.what();
+    }
+  }
+}
+
+void FileWatcherService::dispatch_loop() {
+  if (options_.initial_scan) {
+    scan_roots();
+  }
+  std::unique_lock<std::mutex> lock(pending_mutex_);
+  while (running_) {
+    stop_cv_.wait_for(lock, options_.settle / 2, [this] { return !running_; });
+    lock.unlock();
+    dispatch_settled(std::chrono::steady_clock::now());
+    lock.lock();
+  }
+}
+
+void FileWatcherService::dispatch(const std::filesystem::path &path, FileChangeKind kind) {
+  try {
+    std::error_code ec;
+    const auto status = std::filesystem::symlink_status(path, ec);
+    if (std::filesystem::is_regular_file(status)) {
+      // Nobody is waiting on a dropped file the way an API caller is, but it should not queue
+      // behind a whole crawl either
+      file_processing_service_->request_processing(path, TaskPriority::NORMAL);
+    } else if (std::filesystem::exists(status)) {
+      // Directories show up here when their tree event settles; their files are reported
+      // individually
+      return;
+    } else if (kind == FileChangeKind::RemovedTree) {
+      file_delete_service_->delete_directory(path);
+    } else {
+      file_delete_service_->delete_file(path);
+    }
+  } catch (const std::exception &e) {
+    log::warning() << "File watcher could not handle " << path << ": " << e.what();
+  }
+}
+
+}  // namespace magic_core
@@ -0,0 +1,285 @@
+#include "magic_core/services/index_maintenance_service.hpp"
+
+#include <exception>
+#include <functional>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "magic_core/db/pooled_connection.hpp"
+#include "magic_core/types/logger.hpp"
+
+namespace magic_core {
+namespace background {
+
+namespace {
+
+// Runs one job and stamps it, whether or not it succeeded, so a failing job waits for its next
+// interval instead of retrying on every pass
+template <typename Job>
+bool run_if_due(Job &job,
+                std::chrono::steady_clock::time_point now,
+                const char *name,
+                const std::function<void()> &work) {
+  if (!job.due(now)) {
+    return false;
+  }
+  job.last_run = now;
+  try {
+    work();
+  } catch (const std::exception &e) {
+    log::warning() << "Index maintenance job '" << name << "' failed: " << e.what();
+  }
+  return true;
+}
+
+}  // namespace
+
+IndexMaintenanceService::IndexMaintenanceService(
+    std::shared_ptr<magic_core::MetadataStore> metadata_store,
+    std::shared_ptr<magic_core::TaskQueueRepo> task_queue_repo,
+    DatabaseManager &db_manager,
+    IndexMaintenanceOptions options)
+    : metadata_store_(std::move(metadata_store)),
+      task_queue_repo_(std::move(task_queue_repo)),
+      db_manager_(db_manager),
+      options_(options),
+      index_check_{options.index_check_interval},
+      checkpoint_{options.checkpoint_interval},
+      optimize_{options.optimize_interval},
+      task_cleanup_{options.task_cleanup_interval},
+      dictionary_{options.dictionary_interval},
+      text_index_{options.text_index_interval} {}
+
+IndexMaintenanceService::~IndexMaintenanceService() {
+  stop();
+}
+
+void IndexMaintenanceService::start() {
+  if (running_.exchange(true)) {
+    return;
+  }
+  worker_ = std::make_unique<std::thread>(&IndexMaintenanceService::maintenance_loop, this);
+}
+
+void IndexMaintenanceService::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  stop_cv_.notify_all();
+  worker_->join();
+  worker_.reset();
+}
+
+bool IndexMaintenanceService::is_running() const {
+  return running_;
+}
+
+void IndexMaintenanceService::maintenance_loop() {
+  std::unique_lock<std::mutex> lock(stop_mutex_);
+  while (running_) {
+    // Startup has just done its own maintenance, so the first pass waits a full interval
+    if (stop_cv_.wait_for(lock, options_.interval, [this] { return !running_; })) {
+      break;
+    }
+    lock.unlock();
+    run_due_jobs(std::chrono::steady_clock::now());
+    lock.lock();
+  }
+}
+
+size_t IndexMaintenanceService::run_due_jobs(std::chrono::steady_clock::time_point now) {
+  // Not a job of its own: an import that has drained should not wait out an interval
+  if (metadata_store_->bulk_loading()) {
+    try {
+      finish_bulk_load();
+    } catch (const std::exception &e) {
+      log::warning() << "Finishing the bulk load failed: " << e.what();
+    }
+  }
+  size_t ran = 0;
+  ran += run_if_due(index_check_, now, "index check", [this] { check_indexes(); });
+  ran += run_if_due(checkpoint_, now, "WAL checkpoint", [this] { checkpoint_wal(); });
+  ran += run_if_due(optimize_, now, "optimize", [this] { optimize_database(); });
+  ran += run_if_due(task_cleanup_, now, "task cleanup", [this] { clear_completed_tasks(); });
+  ran += run_if_due(dictionary_, now, "dictionary training",
+                    [this] { train_compression_dictionary(); });
+  ran += run_if_due(text_index_, now, "full-text backfill", [this] { index_chunk_text(); });
+  return ran;
+}
+
+bool IndexMaintenanceService::needs_rebuild(const VectorIndexStats &stats,
+                                            const IndexMaintenanceOptions &options) {
+  // Tombstones still cost every search a filter check and hold their vectors in memory
+  if (stats.tombstones >= options.min_tombstones &&
+      static_cast<double>(stats.tombstones) >=
+          options.max_tombstone_ratio * static_cast<double>(stats.size)) {
+    return true;
+  }
+  if (stats.min_training_vectors == 0) {
+    return false;
+  }
+  // The flat stand-in has grown enough to train the configured quantized type
+  if (!stats.uses_configured_type) {
+    return stats.size >= stats.min_training_vectors;
+  }
+  // Vectors added since training are encoded with codebooks that never saw them
+  return static_cast<double>(stats.size) >
+         (1.0 + options.max_growth_ratio) * static_cast<double>(stats.built_size);
+}
+
+bool IndexMaintenanceService::finish_bulk_load() {
+  // Generation tasks, queued or running, write no vectors, so they do not hold the rebuild off
+  if (!metadata_store_->bulk_loading() ||
+      task_queue_repo_->count_pending_tasks(TaskLane::Any) > 0 ||
+      task_queue_repo_->count_claimed_tasks(TaskLane::Any) > 0) {
+    return false;
+  }
+  if (!metadata_store_->end_bulk_load()) {
+    return false;
+  }
+  const size_t indexed = backfill_chunk_text(std::numeric_limits<int>::max());
+  // The import is the bulk of the WAL; TRUNCATE waits for readers so the file shrinks back
+  PooledConnection conn(db_manager_);
+  *conn << "PRAGMA wal_checkpoint(TRUNCATE);" >> [](int, int, int) {};
+  metadata_store_->persist_faiss_index();
+  log::info() << "Index maintenance: bulk load finished, " << indexed
+              << " chunks added to the full-text index";
+  return true;
+}
+
+void IndexMaintenanceService::check_indexes() {
+  // A bulk load's indexes are rebuilt once it ends
+  if (metadata_store_->bulk_loading()) {
+    return;
+  }
+  // One rebuild per pass; the chunk index is the larger one and goes first
+  bool rebuilt = false;
+  if (needs_rebuild(metadata_store_->chunk_index_stats(), options_)) {
+    const auto before = metadata_store_->chunk_index_stats();
+    metadata_store_->rebuild_chunk_index();
+    log::info() << "Index maintenance: rebuilt the chunk index (" << before.size << " vectors, "
+                << before.tombstones << " tombstones dropped)";
+    rebuilt = true;
+  } else if (needs_rebuild(metadata_store_->file_index_stats(), options_)) {
+    const auto before = metadata_store_->file_index_stats();
+    metadata_store_->rebuild_faiss_index();
+    log::info() << "Index maintenance: rebuilt the file index (" << before.size << " vectors, "
+                << before.tombstones << " tombstones dropped)";
+    rebuilt = true;
+  }
+  if (rebuilt) {
+    metadata_store_->persist_faiss_index();
+  }
+}
+
+void IndexMaintenanceService::checkpoint_wal() {
+  // Checkpoints cannot run inside the writer's transactions, so this uses the read-write pool,
+  // which otherwise only serves startup. PASSIVE copies what it can without blocking writers.
+  PooledConnection conn(db_manager_);
+  *conn << "PRAGMA wal_checkpoint(PASSIVE);" >> [](int busy, int log_frames, int checkpointed) {
+    if (busy) {
+      log::warning() << "WAL checkpoint was blocked; " << checkpointed << " of " << log_frames
+                     << " frames copied.";
+    }
+  };
+}
+
+void IndexMaintenanceService::optimize_database() {
+  const std::string vacuum =
+      "PRAGMA incremental_vacuum(" + std::to_string(options_.incremental_vacuum_pages) + ");";
+  db_manager_.writer().run([&](PooledDatabase &conn) {
+    conn.db << "PRAGMA optimize;";
+    // A no-op unless the database was created with auto_vacuum = INCREMENTAL
+    conn.db << vacuum;
+  });
+}
+
+void IndexMaintenanceService::clear_completed_tasks() {
+  task_queue_repo_->clear_completed_tasks(options_.completed_task_retention_days);
+}
+
+bool IndexMaintenanceService::needs_dictionary(int64_t chunk_count,
+                                               int64_t trained_chunk_count,
+                                               const IndexMaintenanceOptions &options) {
+  if (chunk_count < options.min_dictionary_chunks) {
+    return false;
+  }
+  return trained_chunk_count == 0 ||
+         static_cast<double>(chunk_count) >
+             (1.0 + options.dictionary_growth_ratio) * static_cast<double>(trained_chunk_count);
+}
+
+void IndexMaintenanceService::train_compression_dictionary() {
+  const auto stored = metadata_store_->get_compression_dictionaries();
+  const int64_t chunk_count = metadata_store_->count_chunks();
+  if (!needs_dictionary(chunk_count, stored.empty() ? 0 : stored.back().chunk_count, options_)) {
+    return;
+  }
+
+  std::vector<std::string> samples;
+  for (const auto &content : metadata_store_->sample_chunk_contents(options_.dictionary_samples)) {
+    samples.push_back(CompressionService::decompress(content));
+  }
+  std::vector<char> dictionary =
+      CompressionService::train_dictionary(samples, options_.dictionary_capacity);
+  // zstd picks the id; replacing a stored dictionary would orphan the chunks written with it
+  uint32_t id = CompressionService::register_dictionary(dictionary, /*activate*/ false);
+  for (const auto &existing : stored) {
+    if (existing.id == id) {
+      throw std::runtime_error("trained dictionary id " + std::to_string(id) +
+                               " is already taken");
+    }
+  }
+  metadata_store_->save_compression_dictionary({id, dictionary,
+                                                static_cast<int64_t>(samples.size()), chunk_count,
+                                                std::chrono::system_clock::now()});
+  CompressionService::register_dictionary(dictionary);
+  log::info() << "Index maintenance: trained compression dictionary " << id << " ("
+              << dictionary.size() << " bytes from " << samples.size() << " chunks)";
+}
+
+void IndexMaintenanceService::index_chunk_text() {
+  // Left for finish_bulk_load(), which covers the whole import in one pass
+  if (metadata_store_->bulk_loading()) {
+    return;
+  }
+  const size_t indexed = backfill_chunk_text(options_.text_index_batches_per_run);
+  if (indexed > 0) {
+    log::info() << "Index maintenance: added " << indexed << " chunks to the full-text index";
+  }
+}
+
+size_t IndexMaintenanceService::backfill_chunk_text(int max_batches) {
+  size_t indexed = 0;
+  // Walks forward by id, so each batch starts where the last one stopped instead of rescanning
+  int64_t after_id = 0;
+  for (int batch = 0; batch < max_batches; ++batch) {
+    const auto missing = metadata_store_->chunks_missing_text(options_.text_index_batch, after_id);
+    if (missing.empty()) {
+      break;
+    }
+    after_id = missing.back().first;
+    std::vector<std::pair<int64_t, std::string>> texts;
+    texts.reserve(missing.size());
+    for (const auto &[chunk_id, content] : missing) {
+      try {
+        texts.emplace_back(chunk_id, CompressionService::decompress(content));
+      } catch (const std::exception &e) {
+        // Indexed empty so it is not picked up again on every run
+        log::warning() << "Chunk " << chunk_id << " left out of the full-text index: " << e.what();
+        texts.emplace_back(chunk_id, std::string());
+      }
+    }
+    metadata_store_->index_chunk_text(texts);
+    indexed += texts.size();
+    if (missing.size() < static_cast<size_t>(options_.text_index_batch)) {
+      break;
+    }
+  }
+  return indexed;
+}
+
+}  // namespace background
+}  // namespace magic_core
@@ -0,0 +1,168 @@
+#include "magic_core/services/remote_task_service.hpp"
+
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include "magic_core/async/chunk_diff.hpp"
+#include "magic_core/async/process_file_task.hpp"
+#include "magic_core/db/embedding_cache.hpp"
+#include "magic_core/services/compression_service.hpp"
+
+namespace magic_core {
+
+RemoteTaskService::RemoteTaskService(std::shared_ptr<MetadataStore> metadata_store,
+                                     std::shared_ptr<TaskQueueRepo> task_queue_repo)
+    : RemoteTaskService(std::make_shared<ShardedMetadataStore>(std::move(metadata_store)),
+                        std::move(task_queue_repo)) {}
+
+RemoteTaskService::RemoteTaskService(std::shared_ptr<ShardedMetadataStore> metadata_store,
+                                     std::shared_ptr<TaskQueueRepo> task_queue_repo)
+    : metadata_store_(std::move(metadata_store)), task_queue_repo_(std::move(task_queue_repo)) {}
+
+std::vector<RemoteTask> RemoteTaskService::claim_tasks(const std::string& worker,
+                                                       int max_tasks,
+                                                       TaskLane lane) {
+  if (worker.empty()) {
+    throw std::invalid_argument("A remote worker needs a name");
+  }
+  std::vector<RemoteTask> claimed;
+  std::vector<long long> server_side;
+  for (TaskDTO& task : task_queue_repo_->fetch_and_claim_tasks(max_tasks, lane,
+                                                               lease_owner(worker))) {
+    if (task.task_type != "PROCESS_FILE") {
+      // Only file tasks can be done remotely; the rest (REEMBED) work on the server's stores
+      server_side.push_back(task.id);
+      continue;
+    }
+    RemoteTask remote{std::move(task), {}};
+    try {
+      if (remote.task.task_type == "PROCESS_FILE" && remote.task.target_path) {
+        MetadataStore& store = metadata_store_->for_path(*remote.task.target_path);
+        std::optional<BasicFileMetadata> metadata =
+            store.get_basic_file_metadata(*remote.task.target_path);
+        if (metadata) {
+          store.update_file_processing_status(metadata->id, ProcessingStatus::PROCESSING);
+          for (StoredChunk& stored : store.get_stored_chunks(metadata->id)) {
+            // Only rows diff_chunks can reuse
+            if (!stored.content_hash.empty() && !stored.vector_embedding.empty()) {
+              remote.stored_chunk_hashes.push_back(std::move(stored.content_hash));
+            }
+          }
+        }
+        // A file without metadata is failed by complete_file_task, as ProcessFileTask would
+      }
+    } catch (const std::exception& e) {
+      task_queue_repo_->mark_task_as_failed(remote.task.id, e.what());
+      continue;
+    }
+    claimed.push_back(std::move(remote));
+  }
+  task_queue_repo_->release_claimed_tasks(server_side);
+  return claimed;
+}
+
+TaskDTO RemoteTaskService::leased_task(long long task_id, const std::string& worker) {
+  if (!task_queue_repo_->renew_lease(task_id, lease_owner(worker))) {
+    throw TaskLeaseLostError("Task " + std::to_string(task_id) + " is not leased to " + worker);
+  }
+  std::optional<TaskDTO> task = task_queue_repo_->get_task(task_id);
+  if (!task) {
+    throw TaskLeaseLostError("Task " + std::to_string(task_id) + " no longer exists");
+  }
+  return std::move(*task);
+}
+
+void RemoteTaskService::report_progress(long long task_id,
+                                        const std::string& worker,
+                                        float percent,
+                                        const std::string& message) {
+  if (!task_queue_repo_->renew_lease(task_id, lease_owner(worker))) {
+    throw TaskLeaseLostError("Task " + std::to_string(task_id) + " is not leased to " + worker);
+  }
+  task_queue_repo_->report_task_progress(task_id, percent, message);
+}
+
+void RemoteTaskService::complete_file_task(long long task_id,
+                                           const std::string& worker,
+                                           std::vector<RemoteChunk> remote_chunks,
+                                           const std::string& embedding_model) {
+  TaskDTO task = leased_task(task_id, worker);
+  if (task.task_type != "PROCESS_FILE" || !task.target_path) {
+    throw std::invalid_argument("Task " + std::to_string(task_id) + " is not a file task");
+  }
+  MetadataStore& store = metadata_store_->for_path(*task.target_path);
+  std::optional<BasicFileMetadata> metadata = store.get_basic_file_metadata(*task.target_path);
+  if (!metadata) {
+    const std::string error = "Could not find file metadata for path: " + *task.target_path;
+    task_queue_repo_->mark_task_as_failed(task_id, error);
+    throw std::runtime_error(error);
+  }
+
+  std::sort(remote_chunks.begin(), remote_chunks.end(),
+            [](const RemoteChunk& a, const RemoteChunk& b) {
+              return a.chunk_index < b.chunk_index;
+            });
+  std::vector<Chunk> chunks;
+  std::vector<std::string> content_hashes;
+  chunks.reserve(remote_chunks.size());
+  content_hashes.reserve(remote_chunks.size());
+  for (RemoteChunk& remote : remote_chunks) {
+    // Hashed here rather than taken from the worker, so a stale or buggy worker cannot attach
+    // a stored vector to different content
+    content_hashes.push_back(EmbeddingCache::content_key(remote.content));
+    chunks.push_back(
+        {std::move(remote.content), remote.chunk_index, std::move(remote.vector_embedding)});
+  }
+
+  const std::string active_model = store.embedding_model();
+  ChunkDiff diff = diff_chunks(chunks, content_hashes, store.get_stored_chunks(metadata->id));
+  if (!diff.fresh.empty() && embedding_model != active_model) {
+    // The store refuses the vectors anyway; fail the task before anything is written
+    const std::string error = "Task " + std::to_string(task_id) + " was embedded with '" +
+                              embedding_model + "', but the active embedding model is '" +
+                              active_model + "'";
+    task_queue_repo_->mark_task_as_failed(task_id, error, lease_owner(worker));
+    throw EmbeddingModelMismatchError(error);
+  }
+  const size_t dimension = static_cast<size_t>(store.dimension());
+  for (size_t i : diff.fresh) {
+    if (chunks[i].vector_embedding.size() != dimension) {
+      throw std::invalid_argument("Chunk " + std::to_string(chunks[i].chunk_index) +
+                                  " needs an embedding of " + std::to_string(dimension) +
+                                  " floats");
+    }
+  }
+  store.reconcile_chunks(metadata->id, diff.kept, diff.removed_ids);
+
+  // The chunks move into the batch and back out once it is written, since the document
+  // embedding still needs their vectors; the slots and their compression buffers are reused
+  std::vector<ProcessedChunk> batch(std::min(WRITE_BATCH_SIZE, diff.fresh.size()));
+  size_t filled = 0;
+  for (size_t n = 0; n < diff.fresh.size(); ++n) {
+    ProcessedChunk& slot = batch[filled++];
+    slot.chunk = std::move(chunks[diff.fresh[n]]);
+    CompressionService::compress_into(slot.chunk.content, slot.compressed_content);
+    slot.content_hash = std::move(content_hashes[diff.fresh[n]]);
+    if (filled == batch.size() || n + 1 == diff.fresh.size()) {
+      store.upsert_chunk_metadata(metadata->id, std::span(batch.data(), filled), active_model);
+      for (size_t k = 0; k < filled; ++k) {
+        chunks[diff.fresh[n + 1 - filled + k]] = std::move(batch[k].chunk);
+      }
+      filled = 0;
+    }
+  }
+
+  ProcessFileTask::finalize_document_embedding(metadata->id, chunks, store, active_model);
+  task_queue_repo_->update_task_status(task_id, TaskStatus::COMPLETED);
+}
+
+void RemoteTaskService::fail_task(long long task_id,
+                                  const std::string& worker,
+                                  const std::string& error_message) {
+  leased_task(task_id, worker);
+  task_queue_repo_->mark_task_as_failed(task_id, error_message);
+}
+
+}  // namespace magic_core
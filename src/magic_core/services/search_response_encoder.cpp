@@ -0,0 +1,517 @@
+#include "magic_core/services/search_response_encoder.hpp"
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace magic_core {
+
+namespace {
+
+// Length of the valid UTF-8 sequence starting at text[i], or 0 if there is none
+size_t utf8_sequence_length(std::string_view text, size_t i) {
+  const auto byte = [&](size_t at) { return static_cast<unsigned char>(text[at]); };
+  const unsigned char lead = byte(i);
+  size_t length = 0;
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    length = 2;
+  } else if (lead >= 0xe0 && lead <= 0xef) {
+    length = 3;
+  } else if (lead >= 0xf0 && lead <= 0xf4) {
+    length = 4;
+  } else {
+    return 0;
+  }
+  if (i + length > text.size()) {
+    return 0;
+  }
+  for (size_t k = 1; k < length; ++k) {
+    if ((byte(i + k) & 0xc0) != 0x80) {
+      return 0;
+    }
+  }
+  // Overlong forms, surrogates and code points above U+10FFFF
+  const unsigned char second = byte(i + 1);
+  if ((lead == 0xe0 && second < 0xa0) || (lead == 0xed && second > 0x9f) ||
+      (lead == 0xf0 && second < 0x90) || (lead == 0xf4 && second > 0x8f)) {
+    return 0;
+  }
+  return length;
+}
+
+// text with every byte that does not start or continue a valid sequence replaced by U+FFFD.
+// Returns text itself, without copying, when it is valid already (nearly always).
+std::string_view valid_utf8(std::string_view text, std::string &scratch) {
+  size_t i = 0;
+  while (i < text.size()) {
+    if (static_cast<unsigned char>(text[i]) < 0x80) {
+      ++i;
+      continue;
+    }
+    const size_t length = utf8_sequence_length(text, i);
+    if (length == 0) {
+      break;
+    }
+    i += length;
+  }
+  if (i == text.size()) {
+    return text;
+  }
+  scratch.assign(text.substr(0, i));
+  while (i < text.size()) {
+    if (static_cast<unsigned char>(text[i]) < 0x80) {
+      scratch.push_back(text[i++]);
+    } else if (size_t length = utf8_sequence_length(text, i)) {
+      scratch.append(text.substr(i, length));
+      i += length;
+    } else {
+      scratch.append("\xef\xbf\xbd");
+      ++i;
+    }
+  }
+  return scratch;
+}
+
+class JsonWriter {
+ public:
+  explicit JsonWriter(std::string &out) : out_(out) {}
+
+  void begin_map(size_t) {
+    separate();
+    out_.push_back('{');
+    first_ = true;
+  }
+  void end_map() {
+    out_.push_back('}');
+    first_ = false;
+  }
+  void begin_array(size_t) {
+    separate();
+    out_.push_back('[');
+    first_ = true;
+  }
+  void end_array() {
+    out_.push_back(']');
+    first_ = false;
+  }
+  void key(std::string_view name) {
+    string(name);
+    out_.push_back(':');
+    after_key_ = true;
+  }
+  void string(std::string_view value) {
+    separate();
+    static const char HEX[] = "0123456789abcdef";
+    out_.push_back('"');
+    for (char c : valid_utf8(value, scratch_)) {
+      switch (c) {
+        case '"':
+          out_.append("\\\"");
+          break;
+        case '\\':
+          out_.append("\\\\");
+          break;
+        case '\n':
+          out_.append("\\n");
+          break;
+        case '\r':
+          out_.append("\\r");
+          break;
+        case '\t':
+          out_.append("\\t");
+          break;
+        case '\b':
+          out_.append("\\b");
+          break;
+        case '\f':
+          out_.append("\\f");
+          break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            out_.append("\\u00");
+            out_.push_back(HEX[c >> 4]);
+            out_.push_back(HEX[c & 0x0f]);
+          } else {
+            out_.push_back(c);
+          }
+      }
+    }
+    out_.push_back('"');
+  }
+  // Bytes go out base64-encoded
+  void binary(std::string_view value) {
+    separate();
+    static const char ALPHABET[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    out_.push_back('"');
+    size_t i = 0;
+    const auto byte = [&](size_t at) { return static_cast<unsigned char>(value[at]); };
+    for (; i + 3 <= value.size(); i += 3) {
+      const uint32_t triple = (byte(i) << 16) | (byte(i + 1) << 8) | byte(i + 2);
+      out_.push_back(ALPHABET[(triple >> 18) & 0x3f]);
+      out_.push_back(ALPHABET[(triple >> 12) & 0x3f]);
+      out_.push_back(ALPHABET[(triple >> 6) & 0x3f]);
+      out_.push_back(ALPHABET[triple & 0x3f]);
+    }
+    if (const size_t rest = value.size() - i; rest > 0) {
+      const uint32_t triple = (byte(i) << 16) | (rest == 2 ? byte(i + 1) << 8 : 0);
+      out_.push_back(ALPHABET[(triple >> 18) & 0x3f]);
+      out_.push_back(ALPHABET[(triple >> 12) & 0x3f]);
+      out_.push_back(rest == 2 ? ALPHABET[(triple >> 6) & 0x3f] : '=');
+      out_.push_back('=');
+    }
+    out_.push_back('"');
+  }
+  void integer(int64_t value) {
+    separate();
+    char buffer[24];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, end);
+  }
+  void number(float value) {
+    separate();
+    if (!std::isfinite(value)) {
+      out_.append("null");
+      return;
+    }
+    // Shortest digits that read back as the same float
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, end);
+  }
+
+ private:
+  // A comma before every value but the first in its map or array; none right after a key
+  void separate() {
+    if (after_key_) {
+      after_key_ = false;
+    } else if (!first_) {
+      out_.push_back(',');
+    }
+    first_ = false;
+  }
+
+  std::string &out_;
+  std::string scratch_;
+  bool first_ = true;
+  bool after_key_ = false;
+};
+
+class MessagePackWriter {
+ public:
+  explicit MessagePackWriter(std::string &out) : out_(out) {}
+
+  void begin_map(size_t size) {
+    header(size, 0x80, 0xde, 0xdf);
+  }
+  void end_map() {}
+  void begin_array(size_t size) {
+    header(size, 0x90, 0xdc, 0xdd);
+  }
+  void end_array() {}
+  void key(std::string_view name) {
+    string(name);
+  }
+  void string(std::string_view value) {
+    value = valid_utf8(value, scratch_);
+    if (value.size() < 32) {
+      out_.push_back(static_cast<char>(0xa0 | value.size()));
+    } else if (value.size() <= 0xff) {
+      out_.push_back(static_cast<char>(0xd9));
+      big_endian(static_cast<uint8_t>(value.size()));
+    } else if (value.size() <= 0xffff) {
+      out_.push_back(static_cast<char>(0xda));
+      big_endian(static_cast<uint16_t>(value.size()));
+    } else {
+      out_.push_back(static_cast<char>(0xdb));
+      big_endian(static_cast<uint32_t>(value.size()));
+    }
+    out_.append(value);
+  }
+  void binary(std::string_view value) {
+    if (value.size() <= 0xff) {
+      out_.push_back(static_cast<char>(0xc4));
+      big_endian(static_cast<uint8_t>(value.size()));
+    } else if (value.size() <= 0xffff) {
+      out_.push_back(static_cast<char>(0xc5));
+      big_endian(static_cast<uint16_t>(value.size()));
+    } else {
+      out_.push_back(static_cast<char>(0xc6));
+      big_endian(static_cast<uint32_t>(value.size()));
+    }
+    out_.append(value);
+  }
+  void integer(int64_t value) {
+    if (value >= 0 && value < 128) {
+      out_.push_back(static_cast<char>(value));
+    } else if (value >= -32 && value < 0) {
+      out_.push_back(static_cast<char>(value));
+    } else if (value >= INT32_MIN && value <= INT32_MAX) {
+      out_.push_back(static_cast<char>(0xd2));
+      big_endian(static_cast<uint32_t>(static_cast<int32_t>(value)));
+    } else {
+      out_.push_back(static_cast<char>(0xd3));
+      big_endian(static_cast<uint64_t>(value));
+    }
+  }
+  void number(float value) {
+    if (!std::isfinite(value)) {
+      out_.push_back(static_cast<char>(0xc0));  // nil
+      return;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    out_.push_back(static_cast<char>(0xca));
+    big_endian(bits);
+  }
+
+ private:
+  void header(size_t size, unsigned char fix, unsigned char sixteen, unsigned char thirty_two) {
+    if (size < 16) {
+      out_.push_back(static_cast<char>(fix | size));
+    } else if (size <= 0xffff) {
+      out_.push_back(static_cast<char>(sixteen));
+      big_endian(static_cast<uint16_t>(size));
+    } else {
+      out_.push_back(static_cast<char>(thirty_two));
+      big_endian(static_cast<uint32_t>(size));
+    }
+  }
+  template <typename T>
+  void big_endian(T value) {
+    for (int shift = (sizeof(T) - 1) * 8; shift >= 0; shift -= 8) {
+      out_.push_back(static_cast<char>((value >> shift) & 0xff));
+    }
+  }
+
+  std::string &out_;
+  std::string scratch_;
+};
+
+template <typename Writer>
+void write_file(Writer &writer, const FileSearchResult &result) {
+  writer.begin_map(4);
+  writer.key("duplicate_paths");
+  writer.begin_array(result.duplicate_paths.size());
+  for (const std::string &path : result.duplicate_paths) {
+    writer.string(path);
+  }
+  writer.end_array();
+  writer.key("id");
+  writer.integer(result.file.id);
+  writer.key("path");
+  writer.string(result.file.path);
+  writer.key("score");
+  writer.number(result.distance);
+  writer.end_map();
+}
+
+template <typename Writer>
+void write_files(Writer &writer, const std::vector<FileSearchResult> &results) {
+  writer.begin_array(results.size());
+  for (const FileSearchResult &result : results) {
+    write_file(writer, result);
+  }
+  writer.end_array();
+}
+
+template <typename Writer>
+void write_chunk(Writer &writer,
+                 const SearchService::ChunkResultDTO &chunk,
+                 ChunkContentMode mode) {
+  const size_t content_fields = mode == ChunkContentMode::Full ? 1
+                                : mode == ChunkContentMode::None ? 0
+                                                                 : 2;
+  writer.begin_map(4 + content_fields + (chunk.rerank_score ? 1 : 0));
+  writer.key("chunk_index");
+  writer.integer(chunk.chunk_index);
+  if (mode == ChunkContentMode::Full) {
+    writer.key("content");
+    writer.string(chunk.content);
+  } else if (mode == ChunkContentMode::Compressed) {
+    writer.key("content_zstd");
+    writer.binary(chunk.content);
+    writer.key("dictionary_id");
+    writer.integer(chunk.dictionary_id);
+  }
+  writer.key("file_id");
+  writer.integer(chunk.file_id);
+  writer.key("id");
+  writer.integer(chunk.id);
+  if (chunk.rerank_score) {
+    writer.key("rerank_score");
+    writer.number(*chunk.rerank_score);
+  }
+  writer.key("score");
+  writer.number(chunk.distance);
+  if (mode == ChunkContentMode::Snippet) {
+    writer.key("snippet");
+    writer.string(chunk.content);
+    writer.key("snippet_offset");
+    writer.integer(static_cast<int64_t>(chunk.content_offset));
+  }
+  writer.end_map();
+}
+
+// The fields of a search result, inside a map the caller opened with room for them
+template <typename Writer>
+void write_result_fields(Writer &writer,
+                         const SearchService::MagicSearchResult &result,
+                         ChunkContentMode mode) {
+  writer.key("chunks");
+  writer.begin_array(result.chunk_results.size());
+  for (const SearchService::ChunkResultDTO &chunk : result.chunk_results) {
+    write_chunk(writer, chunk, mode);
+  }
+  writer.end_array();
+  writer.key("files");
+  write_files(writer, result.file_results);
+}
+
+// Text a client would write in a header: lowercase, without surrounding spaces
+std::string normalized(std::string_view text) {
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+    text.remove_suffix(1);
+  }
+  std::string lower(text);
+  for (char &c : lower) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return lower;
+}
+
+// Runs write with the writer for format over a fresh body
+template <typename Write>
+std::string encode_with(ResponseFormat format, size_t reserve, Write &&write) {
+  std::string body;
+  body.reserve(reserve);
+  if (format == ResponseFormat::MessagePack) {
+    MessagePackWriter writer(body);
+    write(writer);
+  } else {
+    JsonWriter writer(body);
+    write(writer);
+  }
+  return body;
+}
+
+// A guess at the body size, so appending rarely reallocates
+size_t estimated_size(const SearchService::MagicSearchResult &result) {
+  size_t size = 32 + result.file_results.size() * 96 + result.chunk_results.size() * 96;
+  for (const SearchService::ChunkResultDTO &chunk : result.chunk_results) {
+    size += chunk.content.size();
+  }
+  return size;
+}
+
+}  // namespace
+
+ResponseFormat SearchResponseEncoder::negotiate(const std::string &accept) {
+  std::string_view ranges = accept;
+  while (!ranges.empty()) {
+    const size_t comma = ranges.find(',');
+    std::string_view range = ranges.substr(0, comma);
+    ranges = comma == std::string_view::npos ? std::string_view() : ranges.substr(comma + 1);
+
+    const size_t semicolon = range.find(';');
+    const std::string type = normalized(range.substr(0, semicolon));
+    if (type != "application/msgpack" && type != "application/x-msgpack") {
+      continue;
+    }
+    // "q=0" is an explicit refusal
+    bool refused = false;
+    std::string_view parameters =
+        semicolon == std::string_view::npos ? std::string_view() : range.substr(semicolon + 1);
+    while (!parameters.empty()) {
+      const size_t next = parameters.find(';');
+      const std::string parameter = normalized(parameters.substr(0, next));
+      parameters =
+          next == std::string_view::npos ? std::string_view() : parameters.substr(next + 1);
+      if (parameter.rfind("q=", 0) == 0) {
+        refused = std::strtod(parameter.c_str() + 2, nullptr) <= 0.0;
+      }
+    }
+    if (!refused) {
+      return ResponseFormat::MessagePack;
+    }
+  }
+  return ResponseFormat::Json;
+}
+
+const char *SearchResponseEncoder::content_type(ResponseFormat format) {
+  return format == ResponseFormat::MessagePack ? "application/msgpack" : "application/json";
+}
+
+std::string SearchResponseEncoder::encode(const SearchService::MagicSearchResult &result,
+                                          ChunkContentMode mode,
+                                          ResponseFormat format) {
+  return encode_with(format, estimated_size(result), [&](auto &writer) {
+    writer.begin_map(2);
+    write_result_fields(writer, result, mode);
+    writer.end_map();
+  });
+}
+
+std::string SearchResponseEncoder::encode_batch(
+    const std::vector<SearchService::MagicSearchResult> &results,
+    const std::vector<std::string> &queries,
+    ChunkContentMode mode,
+    ResponseFormat format) {
+  size_t reserve = 16;
+  for (const auto &result : results) {
+    reserve += estimated_size(result);
+  }
+  return encode_with(format, reserve, [&](auto &writer) {
+    writer.begin_map(1);
+    writer.key("results");
+    writer.begin_array(results.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+      writer.begin_map(3);
+      write_result_fields(writer, results[i], mode);
+      writer.key("query");
+      writer.string(i < queries.size() ? queries[i] : std::string());
+      writer.end_map();
+    }
+    writer.end_array();
+    writer.end_map();
+  });
+}
+
+std::string SearchResponseEncoder::encode_files(const std::vector<FileSearchResult> &results,
+                                                ResponseFormat format) {
+  return encode_with(format, 16 + results.size() * 96,
+                     [&](auto &writer) { write_files(writer, results); });
+}
+
+std::string SearchResponseEncoder::encode_stream_files(
+    const std::vector<FileSearchResult> &results, ResponseFormat format) {
+  return encode_with(format, 32 + results.size() * 96, [&](auto &writer) {
+    writer.begin_map(2);
+    writer.key("event");
+    writer.string("files");
+    writer.key("files");
+    write_files(writer, results);
+    writer.end_map();
+  });
+}
+
+std::string SearchResponseEncoder::encode_stream_chunk(const SearchService::ChunkResultDTO &chunk,
+                                                       ChunkContentMode mode,
+                                                       ResponseFormat format) {
+  return encode_with(format, 128 + chunk.content.size(), [&](auto &writer) {
+    writer.begin_map(2);
+    writer.key("chunk");
+    write_chunk(writer, chunk, mode);
+    writer.key("event");
+    writer.string("chunk");
+    writer.end_map();
+  });
+}
+
+}  // namespace magic_core
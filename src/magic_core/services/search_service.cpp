@@ -1,12 +1,105 @@
 #include "magic_core/services/search_service.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "magic_core/services/compression_service.hpp"
+#include "magic_core/types/logger.hpp"
+#include "magic_core/types/metrics.hpp"
+#include "magic_core/types/trace.hpp"
+
 namespace magic_core {
 
+namespace {
+
+// Result cache key prefix of a search() under each mode
+char cache_mode(SearchMode mode) {
+  switch (mode) {
+    case SearchMode::Hybrid:
+      return 'h';
+    case SearchMode::Lexical:
+      return 'l';
+    default:
+      return 'm';
+  }
+}
+
+// Latency of search() and search_batch() under each mode, cache hits included
+metrics::Histogram &rerank_latency() {
+  static metrics::Histogram &latency = metrics::histogram(
+      "magic_rerank_seconds", "Re-ranking stages of searches, decompression included",
+      metrics::latency_buckets());
+  return latency;
+}
+
+metrics::Histogram &search_latency(SearchMode mode) {
+  static metrics::Histogram &vector = metrics::histogram(
+      "magic_search_seconds", "search() and search_batch() calls", metrics::latency_buckets(),
+      "mode=\"vector\"");
+  static metrics::Histogram &hybrid = metrics::histogram(
+      "magic_search_seconds", "search() and search_batch() calls", metrics::latency_buckets(),
+      "mode=\"hybrid\"");
+  static metrics::Histogram &lexical = metrics::histogram(
+      "magic_search_seconds", "search() and search_batch() calls", metrics::latency_buckets(),
+      "mode=\"lexical\"");
+  switch (mode) {
+    case SearchMode::Hybrid:
+      return hybrid;
+    case SearchMode::Lexical:
+      return lexical;
+    default:
+      return vector;
+  }
+}
+
+// The longest prefix of text of at most max_bytes that does not split a UTF-8 sequence
+std::string utf8_prefix(const std::string &text, size_t max_bytes) {
+  if (text.size() <= max_bytes) {
+    return text;
+  }
+  size_t end = max_bytes;
+  while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+    --end;
+  }
+  return text.substr(0, end);
+}
+
+}  // namespace
+
 SearchService::SearchService(std::shared_ptr<magic_core::MetadataStore> metadata_store,
                              std::shared_ptr<magic_core::OllamaClient> ollama_client,
-                             std::function<std::string(const std::vector<char>&)> decompress_fn)
-    : metadata_store_(metadata_store), ollama_client_(ollama_client) {
+                             std::function<std::string(const std::vector<char>&)> decompress_fn,
+                             size_t query_cache_capacity,
+                             size_t result_cache_capacity,
+                             SearchPlan plan,
+                             std::shared_ptr<RerankClient> reranker,
+                             RerankOptions rerank)
+    : SearchService(std::make_shared<ShardedMetadataStore>(std::move(metadata_store)),
+                    std::move(ollama_client), std::move(decompress_fn), query_cache_capacity,
+                    result_cache_capacity, plan, std::move(reranker), rerank) {}
+
+SearchService::SearchService(std::shared_ptr<ShardedMetadataStore> metadata_store,
+                             std::shared_ptr<magic_core::OllamaClient> ollama_client,
+                             std::function<std::string(const std::vector<char>&)> decompress_fn,
+                             size_t query_cache_capacity,
+                             size_t result_cache_capacity,
+                             SearchPlan plan,
+                             std::shared_ptr<RerankClient> reranker,
+                             RerankOptions rerank)
+    : metadata_store_(std::move(metadata_store)),
+      ollama_client_(ollama_client),
+      plan_(plan),
+      reranker_(std::move(reranker)),
+      rerank_(rerank),
+      query_embeddings_(query_cache_capacity),
+      results_(result_cache_capacity) {
+  if (rerank_.candidates > 0 && rerank_.batch_size == 0) {
+    throw std::invalid_argument("Re-ranking needs a batch size above 0");
+  }
   if (decompress_fn) {
     decompress_fn_ = std::move(decompress_fn);
   } else {
@@ -16,41 +109,723 @@ SearchService::SearchService(std::shared_ptr<magic_core::MetadataStore> metadata
   }
 }
 
-std::vector<magic_core::FileSearchResult> SearchService::search_files(const std::string &query,
-                                                                      int k) {
+std::vector<magic_core::FileSearchResult> SearchService::search_files(
+    const std::string &query,
+    int k,
+    const VectorSearchOptions &tuning,
+    const SearchFilter &filter) {
+  // Read before searching, so a change landing mid-search leaves the entry already stale
+  const uint64_t generation = metadata_store_->search_generation();
+  const std::string cache_key = result_cache_key('f', query, k, tuning, {}, filter);
+  if (auto cached = cached_result(cache_key, generation)) {
+    return std::move(cached->file_results);
+  }
+
   // Convert the query to a vector embedding
   std::vector<float> query_embedding = embed_query(query);
 
   // Step 2: Use the metadata store to search for similar files
   // The metadata store will use the Faiss index to find the most similar vectors
   std::vector<magic_core::FileSearchResult> results =
-      metadata_store_->search_similar_files(query_embedding, k);
+      metadata_store_->search_similar_files(query_embedding, k, tuning, filter);
+
+  cache_result(cache_key, generation, {results, {}});
+  return results;
+}
+
+SearchService::MagicSearchResult SearchService::search(const std::string &query,
+                                                       int k,
+                                                       const VectorSearchOptions &tuning,
+                                                       const ChunkContentOptions &content,
+                                                       SearchMode mode,
+                                                       const SearchFilter &filter) {
+  return run_search(query, k, tuning, content, mode, filter, nullptr);
+}
+
+SearchService::MagicSearchResult SearchService::search_streaming(
+    const std::string &query,
+    int k,
+    const VectorSearchOptions &tuning,
+    const ChunkContentOptions &content,
+    SearchMode mode,
+    const SearchFilter &filter,
+    const SearchObserver &observer) {
+  return run_search(query, k, tuning, content, mode, filter, &observer);
+}
+
+SearchService::MagicSearchResult SearchService::run_search(const std::string &query,
+                                                           int k,
+                                                           const VectorSearchOptions &tuning,
+                                                           const ChunkContentOptions &content,
+                                                           SearchMode mode,
+                                                           const SearchFilter &filter,
+                                                           const SearchObserver *observer) {
+  metrics::ScopedTimer timer(search_latency(mode));
+  const uint64_t generation = metadata_store_->search_generation();
+  const std::string cache_key =
+      result_cache_key(cache_mode(mode), query, k, tuning, content, filter);
+  if (auto cached = cached_result(cache_key, generation)) {
+    if (observer) {
+      if (observer->on_files) {
+        observer->on_files(cached->file_results);
+      }
+      if (observer->on_chunk) {
+        for (const auto &chunk : cached->chunk_results) {
+          observer->on_chunk(chunk);
+        }
+      }
+    }
+    return std::move(*cached);
+  }
+
+  std::vector<FileSearchResult> file_hits;
+  std::vector<ChunkSearchResult> chunk_hits;
+  // The lexical fast path never waits on the embedder
+  if (mode != SearchMode::Lexical) {
+    std::vector<float> qvec = embed_query(query);
+    // The re-ranker reads every candidate's text
+    const bool with_content = content.mode != ChunkContentMode::None || reranks(mode);
+    const int chunks = chunk_candidates(k, mode);
+    file_hits = metadata_store_->search_similar_files(qvec, shortlist_size(k), tuning, filter);
+    const std::vector<int> shortlist = get_file_ids(file_hits);
+    if (file_hits.size() > static_cast<size_t>(k)) {
+      file_hits.resize(k);
+    }
+    // Vector files are final here; the chunk search and its decompression still lie ahead
+    if (mode == SearchMode::Vector && observer && observer->on_files) {
+      observer->on_files(file_hits);
+    }
+    chunk_hits = plan_.exact_chunk_scan
+                     ? metadata_store_->scan_similar_chunks(shortlist, qvec, chunks, with_content)
+                     : metadata_store_->search_similar_chunks(shortlist, qvec, chunks, tuning,
+                                                              with_content);
+  }
 
+  MagicSearchResult result = assemble_result(mode, query, k, content, filter,
+                                             std::move(file_hits), std::move(chunk_hits),
+                                             observer);
+  // A search that ran out of re-ranking budget is worse than the next one may be
+  if (!reranks(mode) || result.reranked) {
+    cache_result(cache_key, generation, result);
+  }
+  return result;
+}
+
+std::vector<SearchService::MagicSearchResult> SearchService::search_batch(
+    const std::vector<std::string> &queries,
+    int k,
+    const VectorSearchOptions &tuning,
+    const ChunkContentOptions &content,
+    SearchMode mode,
+    const SearchFilter &filter) {
+  metrics::ScopedTimer timer(search_latency(mode));
+  const uint64_t generation = metadata_store_->search_generation();
+  std::vector<MagicSearchResult> results(queries.size());
+  std::vector<std::string> cache_keys;
+  cache_keys.reserve(queries.size());
+  // Positions of the queries the result cache could not answer
+  std::vector<size_t> pending;
+  std::vector<std::string> pending_queries;
+  for (size_t i = 0; i < queries.size(); ++i) {
+    cache_keys.push_back(
+        result_cache_key(cache_mode(mode), queries[i], k, tuning, content, filter));
+    if (auto cached = cached_result(cache_keys.back(), generation)) {
+      results[i] = std::move(*cached);
+    } else {
+      pending.push_back(i);
+      pending_queries.push_back(queries[i]);
+    }
+  }
+  if (pending.empty()) {
+    return results;
+  }
+
+  std::vector<std::vector<FileSearchResult>> file_hits(pending.size());
+  std::vector<std::vector<ChunkSearchResult>> chunk_hits(pending.size());
+  if (mode != SearchMode::Lexical) {
+    std::vector<std::vector<float>> embeddings = embed_queries(pending_queries);
+    const bool with_content = content.mode != ChunkContentMode::None || reranks(mode);
+    const int chunks = chunk_candidates(k, mode);
+    file_hits = metadata_store_->search_similar_files_batch(embeddings, shortlist_size(k),
+                                                            tuning, filter);
+    std::vector<std::vector<int>> file_ids;
+    file_ids.reserve(file_hits.size());
+    for (auto &hits : file_hits) {
+      file_ids.push_back(get_file_ids(hits));
+      if (hits.size() > static_cast<size_t>(k)) {
+        hits.resize(k);
+      }
+    }
+    chunk_hits = plan_.exact_chunk_scan
+                     ? metadata_store_->scan_similar_chunks_batch(file_ids, embeddings, chunks,
+                                                                  with_content)
+                     : metadata_store_->search_similar_chunks_batch(file_ids, embeddings, chunks,
+                                                                    tuning, with_content);
+  }
+
+  std::vector<std::vector<ChunkSearchResult>> unfinished(pending.size());
+  std::vector<MagicSearchResult *> unfinished_results;
+  for (size_t j = 0; j < pending.size(); ++j) {
+    MagicSearchResult &result = results[pending[j]];
+    result = assemble_result(mode, pending_queries[j], k, content, filter,
+                             std::move(file_hits[j]), std::move(chunk_hits[j]), nullptr,
+                             mode == SearchMode::Lexical ? nullptr : &unfinished[j]);
+    unfinished_results.push_back(&result);
+  }
+  if (mode != SearchMode::Lexical) {
+    finish_chunks_batch(mode, pending_queries, k, content, unfinished, unfinished_results);
+  }
+  for (size_t j = 0; j < pending.size(); ++j) {
+    const MagicSearchResult &result = results[pending[j]];
+    if (!reranks(mode) || result.reranked) {
+      cache_result(cache_keys[pending[j]], generation, result);
+    }
+  }
   return results;
 }
 
-SearchService::MagicSearchResult SearchService::search(const std::string &query, int k) {
-  std::vector<float> qvec = embed_query(query);
-  auto file_hits = metadata_store_->search_similar_files(qvec, k);
-  auto chunk_hits = metadata_store_->search_similar_chunks(get_file_ids(file_hits), qvec, k);
+SearchService::MagicSearchResult SearchService::assemble_result(
+    SearchMode mode,
+    const std::string &query,
+    int k,
+    const ChunkContentOptions &content,
+    const SearchFilter &filter,
+    std::vector<FileSearchResult> file_hits,
+    std::vector<ChunkSearchResult> chunk_hits,
+    const SearchObserver *observer,
+    std::vector<ChunkSearchResult> *unfinished) {
+  static const std::function<void(const ChunkResultDTO &)> no_chunk_observer;
+  const auto &on_chunk = observer ? observer->on_chunk : no_chunk_observer;
+  auto emit_files = [observer](const std::vector<FileSearchResult> &files) {
+    if (observer && observer->on_files) {
+      observer->on_files(files);
+    }
+  };
+  if (mode == SearchMode::Vector) {
+    MagicSearchResult result;
+    result.file_results = std::move(file_hits);
+    if (unfinished) {
+      *unfinished = std::move(chunk_hits);
+    } else {
+      finish_chunks(mode, query, k, content, std::move(chunk_hits), on_chunk, result);
+    }
+    return result;
+  }
+
+  const int chunks = chunk_candidates(k, mode);
+  std::vector<ChunkSearchResult> lexical_hits = metadata_store_->search_chunks_lexical(
+      query, chunks, content.mode != ChunkContentMode::None || reranks(mode), filter);
+  // Files in the order their best chunk matched
+  std::vector<SearchResult> lexical_files;
+  std::unordered_set<int> seen_files;
+  for (const auto &hit : lexical_hits) {
+    if (seen_files.insert(hit.file_id).second) {
+      lexical_files.push_back({hit.file_id, hit.distance});
+    }
+  }
+  if (mode == SearchMode::Lexical) {
+    MagicSearchResult result;
+    result.file_results = metadata_store_->get_file_search_results(lexical_files);
+    emit_files(result.file_results);
+    result.chunk_results = to_chunk_dtos(lexical_hits, query, content, on_chunk);
+    return result;
+  }
+
+  // Hybrid: fuse the file rankings and the chunk rankings separately
+  std::vector<int> lexical_file_ids;
+  for (const auto &file : lexical_files) {
+    lexical_file_ids.push_back(file.id);
+  }
+  auto fused_files = fuse_rankings({get_file_ids(file_hits), lexical_file_ids}, k);
+  std::unordered_map<int, FileSearchResult> known_files;
+  for (auto &hit : file_hits) {
+    known_files.emplace(hit.id, std::move(hit));
+  }
+  std::vector<SearchResult> missing_files;
+  for (const auto &[id, score] : fused_files) {
+    if (!known_files.count(id)) {
+      missing_files.push_back({id, -score});
+    }
+  }
+  for (auto &hit : metadata_store_->get_file_search_results(missing_files)) {
+    known_files.emplace(hit.id, std::move(hit));
+  }
+  MagicSearchResult result;
+  for (const auto &[id, score] : fused_files) {
+    auto it = known_files.find(id);
+    if (it != known_files.end()) {
+      it->second.distance = -score;
+      result.file_results.push_back(std::move(it->second));
+    }
+  }
+  emit_files(result.file_results);
+
+  std::vector<int> vector_chunk_ids;
+  std::vector<int> lexical_chunk_ids;
+  std::unordered_map<int, ChunkSearchResult> known_chunks;
+  for (auto &hit : chunk_hits) {
+    vector_chunk_ids.push_back(hit.id);
+    known_chunks.emplace(hit.id, std::move(hit));
+  }
+  for (auto &hit : lexical_hits) {
+    lexical_chunk_ids.push_back(hit.id);
+    known_chunks.emplace(hit.id, std::move(hit));
+  }
+  std::vector<ChunkSearchResult> fused_chunks;
+  for (const auto &[id, score] : fuse_rankings({vector_chunk_ids, lexical_chunk_ids}, chunks)) {
+    ChunkSearchResult &chunk = known_chunks.at(id);
+    chunk.distance = -score;
+    fused_chunks.push_back(std::move(chunk));
+  }
+  if (unfinished) {
+    *unfinished = std::move(fused_chunks);
+  } else {
+    finish_chunks(mode, query, k, content, std::move(fused_chunks), on_chunk, result);
+  }
+  return result;
+}
+
+void SearchService::finish_chunks(SearchMode mode,
+                                  const std::string &query,
+                                  int k,
+                                  const ChunkContentOptions &content,
+                                  std::vector<ChunkSearchResult> hits,
+                                  const std::function<void(const ChunkResultDTO &)> &on_chunk,
+                                  MagicSearchResult &result) {
+  if (!reranks(mode)) {
+    result.chunk_results = to_chunk_dtos(hits, query, content, on_chunk);
+    return;
+  }
+  RerankRun run;
+  {
+    metrics::ScopedTimer timer(rerank_latency());
+    trace::Span span("search.rerank");
+    span.set_attribute("candidates", static_cast<int64_t>(hits.size()));
+    const auto deadline = std::chrono::steady_clock::now() + rerank_.budget;
+    run = start_rerank(query, hits);
+    result.reranked = finish_rerank(run, k, deadline, hits);
+    span.set_attribute("scored", static_cast<int64_t>(run.scores.size()));
+  }
+  result.chunk_results = to_chunk_dtos(hits, query, content, on_chunk, &run.texts, &run.scores);
+}
+
+void SearchService::finish_chunks_batch(SearchMode mode,
+                                        const std::vector<std::string> &queries,
+                                        int k,
+                                        const ChunkContentOptions &content,
+                                        std::vector<std::vector<ChunkSearchResult>> &hits,
+                                        const std::vector<MagicSearchResult *> &results) {
+  if (!reranks(mode)) {
+    for (size_t i = 0; i < queries.size(); ++i) {
+      results[i]->chunk_results = to_chunk_dtos(hits[i], queries[i], content);
+    }
+    return;
+  }
+  std::vector<RerankRun> runs;
+  runs.reserve(queries.size());
+  {
+    metrics::ScopedTimer timer(rerank_latency());
+    trace::Span span("search.rerank");
+    span.set_attribute("queries", static_cast<int64_t>(queries.size()));
+    const auto deadline = std::chrono::steady_clock::now() + rerank_.budget;
+    for (size_t i = 0; i < queries.size(); ++i) {
+      runs.push_back(start_rerank(queries[i], hits[i]));
+    }
+    int64_t candidates = 0;
+    int64_t scored = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+      candidates += static_cast<int64_t>(hits[i].size());
+      results[i]->reranked = finish_rerank(runs[i], k, deadline, hits[i]);
+      scored += static_cast<int64_t>(runs[i].scores.size());
+    }
+    span.set_attribute("candidates", candidates);
+    span.set_attribute("scored", scored);
+  }
+  for (size_t i = 0; i < queries.size(); ++i) {
+    results[i]->chunk_results =
+        to_chunk_dtos(hits[i], queries[i], content, {}, &runs[i].texts, &runs[i].scores);
+  }
+}
+
+SearchService::RerankRun SearchService::start_rerank(const std::string &query,
+                                                     const std::vector<ChunkSearchResult> &hits) {
+  // Each full batch goes out before the next one is decompressed
+  RerankRun run;
+  std::vector<std::string> batch;
+  run.texts.reserve(hits.size());
+  for (size_t i = 0; i < hits.size(); ++i) {
+    run.texts.push_back(decompress_fn_(hits[i].compressed_content));
+    if (!run.failure.empty()) {
+      continue;
+    }
+    batch.push_back(utf8_prefix(run.texts.back(), rerank_.max_chars));
+    if (batch.size() == rerank_.batch_size || i + 1 == hits.size()) {
+      try {
+        run.batches.push_back(reranker_->score_async(query, batch));
+      } catch (const HttpError &e) {
+        run.failure = e.what();
+      }
+      batch.clear();
+    }
+  }
+  return run;
+}
+
+bool SearchService::finish_rerank(RerankRun &run,
+                                  int k,
+                                  std::chrono::steady_clock::time_point deadline,
+                                  std::vector<ChunkSearchResult> &hits) {
+  static metrics::Counter &fallbacks = metrics::counter(
+      "magic_rerank_fallbacks_total", "Searches whose re-ranking ran out of budget or failed");
+  std::vector<float> scores;
+  scores.reserve(hits.size());
+  for (auto &pending : run.batches) {
+    std::optional<std::vector<float>> batch_scores;
+    try {
+      batch_scores = pending.get(deadline);
+    } catch (const RerankError &e) {
+      run.failure = e.what();
+    }
+    if (!batch_scores) {
+      break;
+    }
+    scores.insert(scores.end(), batch_scores->begin(), batch_scores->end());
+  }
+  const bool complete = scores.size() == hits.size();
+  if (!complete) {
+    fallbacks.add();
+    if (!run.failure.empty()) {
+      log::warning() << "Re-ranking failed, keeping the first-stage order: " << run.failure;
+    }
+  }
+
+  // The scored prefix by descending score, then the rest as the first stage ranked them
+  std::vector<size_t> order(hits.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.begin() + scores.size(),
+                   [&scores](size_t a, size_t b) { return scores[a] > scores[b]; });
+  order.resize(std::min(order.size(), static_cast<size_t>(std::max(k, 0))));
+  std::vector<ChunkSearchResult> ranked;
+  std::vector<std::string> ranked_texts;
+  ranked.reserve(order.size());
+  ranked_texts.reserve(order.size());
+  run.scores.clear();
+  for (size_t i : order) {
+    if (i < scores.size()) {
+      run.scores.push_back(scores[i]);
+    }
+    ranked.push_back(std::move(hits[i]));
+    ranked_texts.push_back(std::move(run.texts[i]));
+  }
+  hits = std::move(ranked);
+  run.texts = std::move(ranked_texts);
+  return complete;
+}
+
+std::vector<std::pair<int, float>> SearchService::fuse_rankings(
+    const std::vector<std::vector<int>> &rankings, size_t k) {
+  std::vector<std::pair<int, float>> fused;
+  std::unordered_map<int, size_t> position;
+  for (const auto &ranking : rankings) {
+    for (size_t rank = 0; rank < ranking.size(); ++rank) {
+      const float score = 1.0f / static_cast<float>(RRF_K + rank + 1);
+      auto [it, inserted] = position.try_emplace(ranking[rank], fused.size());
+      if (inserted) {
+        fused.emplace_back(ranking[rank], score);
+      } else {
+        fused[it->second].second += score;
+      }
+    }
+  }
+  std::stable_sort(fused.begin(), fused.end(),
+                   [](const auto &a, const auto &b) { return a.second > b.second; });
+  if (fused.size() > k) {
+    fused.resize(k);
+  }
+  return fused;
+}
 
+std::vector<SearchService::ChunkResultDTO> SearchService::to_chunk_dtos(
+    const std::vector<ChunkSearchResult> &chunk_hits,
+    const std::string &query,
+    const ChunkContentOptions &content,
+    const std::function<void(const ChunkResultDTO &)> &on_chunk,
+    std::vector<std::string> *decompressed,
+    const std::vector<float> *rerank_scores) {
   std::vector<ChunkResultDTO> chunk_dtos;
   chunk_dtos.reserve(chunk_hits.size());
-
-  for (const auto &hit : chunk_hits) {
+  trace::Span span("search.decompress");
+  span.set_attribute("chunks", static_cast<int64_t>(chunk_hits.size()));
+  for (size_t i = 0; i < chunk_hits.size(); ++i) {
+    const ChunkSearchResult &hit = chunk_hits[i];
     ChunkResultDTO dto;
     dto.id = hit.id;
     dto.distance = hit.distance;
     dto.file_id = hit.file_id;
     dto.chunk_index = hit.chunk_index;
-    dto.content = decompress_fn_(hit.compressed_content);
+    if (rerank_scores && i < rerank_scores->size()) {
+      dto.rerank_score = (*rerank_scores)[i];
+    }
+    if (content.mode == ChunkContentMode::Compressed) {
+      dto.content.assign(hit.compressed_content.begin(), hit.compressed_content.end());
+      dto.dictionary_id = CompressionService::dictionary_id(hit.compressed_content);
+    } else if (content.mode != ChunkContentMode::None) {
+      dto.content = decompressed ? std::move((*decompressed)[i])
+                                 : decompress_fn_(hit.compressed_content);
+    }
+    if (content.mode == ChunkContentMode::Snippet && dto.content.size() > content.snippet_chars) {
+      dto.content_offset = best_snippet_offset(dto.content, query, content.snippet_chars);
+      // Cut in place; the decompressed buffer becomes the snippet without a second allocation
+      dto.content.resize(dto.content_offset + content.snippet_chars);
+      dto.content.erase(0, dto.content_offset);
+      // Drop a UTF-8 sequence the cut split
+      size_t end = dto.content.size();
+      size_t lead = end;
+      while (lead > 0 && (static_cast<unsigned char>(dto.content[lead - 1]) & 0xC0) == 0x80) {
+        --lead;
+      }
+      if (lead > 0 && static_cast<unsigned char>(dto.content[lead - 1]) >= 0xC0) {
+        unsigned char first = static_cast<unsigned char>(dto.content[lead - 1]);
+        size_t length = first >= 0xF0 ? 4 : first >= 0xE0 ? 3 : 2;
+        if (end - (lead - 1) < length) {
+          dto.content.resize(lead - 1);
+        }
+      }
+    }
+    if (on_chunk) {
+      on_chunk(dto);
+    }
     chunk_dtos.push_back(std::move(dto));
   }
+  return chunk_dtos;
+}
+
+std::optional<SearchService::ChunkResultDTO> SearchService::get_chunk(int chunk_id) {
+  auto chunk = metadata_store_->get_chunk(chunk_id);
+  if (!chunk) {
+    return std::nullopt;
+  }
+  ChunkResultDTO dto;
+  dto.id = chunk->id;
+  dto.distance = 0.0f;
+  dto.file_id = chunk->file_id;
+  dto.chunk_index = chunk->chunk_index;
+  trace::Span span("search.decompress");
+  dto.content = decompress_fn_(chunk->content);
+  return dto;
+}
+
+std::optional<std::vector<char>> SearchService::get_compression_dictionary(uint32_t id) {
+  for (auto &stored : metadata_store_->get_compression_dictionaries()) {
+    if (stored.id == id) {
+      return std::move(stored.dictionary);
+    }
+  }
+  return std::nullopt;
+}
+
+size_t SearchService::best_snippet_offset(const std::string &content,
+                                          const std::string &query,
+                                          size_t window) {
+  if (content.size() <= window) {
+    return 0;
+  }
+  auto lower = [](std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+  };
+  const std::string haystack = lower(content);
+  std::vector<std::string> terms;
+  std::string term;
+  for (char c : lower(query) + ' ') {
+    if (std::isalnum(static_cast<unsigned char>(c)) || static_cast<unsigned char>(c) >= 0x80) {
+      term += c;
+    } else if (!term.empty()) {
+      terms.push_back(std::move(term));
+      term.clear();
+    }
+  }
+
+  // (start, end) of every occurrence of every term, in content order
+  std::vector<std::pair<size_t, size_t>> matches;
+  for (const auto &t : terms) {
+    for (size_t at = haystack.find(t); at != std::string::npos; at = haystack.find(t, at + 1)) {
+      matches.emplace_back(at, at + t.size());
+    }
+  }
+  if (matches.empty()) {
+    return 0;
+  }
+  std::sort(matches.begin(), matches.end());
 
-  return {std::move(file_hits), std::move(chunk_dtos)};
+  // Widest run of matches that fits in one window
+  size_t best_first = 0;
+  size_t best_last = 0;
+  for (size_t first = 0, last = 0; first < matches.size(); ++first) {
+    last = std::max(last, first);
+    while (last + 1 < matches.size() && matches[last + 1].second - matches[first].first <= window) {
+      ++last;
+    }
+    if (last - first > best_last - best_first) {
+      best_first = first;
+      best_last = last;
+    }
+  }
+
+  const size_t span_start = matches[best_first].first;
+  const size_t span_end = std::max(matches[best_last].second, span_start);
+  const size_t slack = window > span_end - span_start ? window - (span_end - span_start) : 0;
+  size_t offset = span_start > slack / 2 ? span_start - slack / 2 : 0;
+  offset = std::min(offset, content.size() - window);
+  while (offset > 0 && (static_cast<unsigned char>(content[offset]) & 0xC0) == 0x80) {
+    --offset;
+  }
+  return offset;
 }
+// The same handful of queries arrive over and over, so skip the embedding round trip for them
 std::vector<float> SearchService::embed_query(const std::string &query) {
-  return ollama_client_->get_embedding(query);
+  trace::Span span("search.embed");
+  const std::string key = query_embedding_key(query);
+  if (auto cached = query_embeddings_.get(key)) {
+    span.set_attribute("cached", "true");
+    return std::move(*cached);
+  }
+  std::vector<float> embedding = ollama_client_->get_embedding(query);
+  if (!embedding.empty()) {
+    query_embeddings_.put(key, embedding);
+  }
+  return embedding;
+}
+
+std::string SearchService::query_embedding_key(const std::string &query) const {
+  // A re-embed switches the model; vectors of the previous one must not be reused
+  std::string key = metadata_store_->embedding_model();
+  key.push_back('\0');
+  key += query;
+  return key;
+}
+
+std::vector<std::vector<float>> SearchService::embed_queries(
+    const std::vector<std::string> &queries) {
+  trace::Span span("search.embed");
+  span.set_attribute("queries", static_cast<int64_t>(queries.size()));
+  std::vector<std::vector<float>> embeddings(queries.size());
+  // Each distinct uncached query is sent once, however often it repeats in the batch
+  std::vector<std::string> missing;
+  std::unordered_map<std::string, std::vector<size_t>> positions;
+  for (size_t i = 0; i < queries.size(); ++i) {
+    auto [it, inserted] = positions.try_emplace(queries[i]);
+    it->second.push_back(i);
+    if (!inserted) {
+      continue;
+    }
+    if (auto cached = query_embeddings_.get(query_embedding_key(queries[i]))) {
+      embeddings[i] = std::move(*cached);
+    } else {
+      missing.push_back(queries[i]);
+    }
+  }
+  if (!missing.empty()) {
+    // Sent right away like a single query's embedding: a search does not queue behind the
+    // in-flight limit that get_embeddings waits on for up to CAPACITY_WAIT
+    std::vector<std::vector<float>> fresh = ollama_client_->get_embeddings_async(missing).get();
+    for (size_t m = 0; m < missing.size() && m < fresh.size(); ++m) {
+      if (!fresh[m].empty()) {
+        query_embeddings_.put(query_embedding_key(missing[m]), fresh[m]);
+      }
+      embeddings[positions[missing[m]].front()] = std::move(fresh[m]);
+    }
+  }
+  for (const auto &[query, at] : positions) {
+    for (size_t i = 1; i < at.size(); ++i) {
+      embeddings[at[i]] = embeddings[at.front()];
+    }
+  }
+  return embeddings;
+}
+
+SearchService::CacheStats SearchService::query_cache_stats() const {
+  return {query_embeddings_.hits(), query_embeddings_.misses(), query_embeddings_.size()};
+}
+
+SearchService::CacheStats SearchService::result_cache_stats() const {
+  return {result_hits_, result_misses_, results_.size()};
+}
+
+std::string SearchService::result_cache_key(char mode,
+                                            const std::string &query,
+                                            int k,
+                                            const VectorSearchOptions &tuning,
+                                            const ChunkContentOptions &content,
+                                            const SearchFilter &filter) {
+  std::string key(1, mode);
+  key += std::to_string(k);
+  key += ',';
+  key += std::to_string(tuning.ef_search);
+  key += ',';
+  key += std::to_string(tuning.nprobe);
+  key += ',';
+  key += std::to_string(static_cast<int>(content.mode));
+  if (content.mode == ChunkContentMode::Snippet) {
+    key += ':';
+    key += std::to_string(content.snippet_chars);
+  }
+  for (FileType type : filter.file_types) {
+    key += ",t";
+    key += std::to_string(static_cast<int>(type));
+  }
+  if (!filter.path_prefix.empty()) {
+    // Length first, so a prefix can hold any byte without running into the query
+    key += ",p";
+    key += std::to_string(filter.path_prefix.size());
+    key += ':';
+    key += filter.path_prefix;
+  }
+  if (filter.modified_after) {
+    key += ",a";
+    key += std::to_string(filter.modified_after->time_since_epoch().count());
+  }
+  if (filter.modified_before) {
+    key += ",b";
+    key += std::to_string(filter.modified_before->time_since_epoch().count());
+  }
+  for (const auto &collection : filter.collections) {
+    key += ",c";
+    key += std::to_string(collection.size());
+    key += ':';
+    key += collection;
+  }
+  key += '\n';
+  key += query;
+  return key;
+}
+
+std::optional<SearchService::MagicSearchResult> SearchService::cached_result(
+    const std::string &key, uint64_t generation) {
+  if (results_.capacity() == 0) {
+    return std::nullopt;
+  }
+  auto cached = results_.get(key);
+  if (cached && cached->generation == generation) {
+    ++result_hits_;
+    return std::move(cached->result);
+  }
+  if (cached) {
+    // Computed before the index last changed; it will never be served again
+    results_.erase(key);
+  }
+  ++result_misses_;
+  return std::nullopt;
+}
+
+void SearchService::cache_result(const std::string &key,
+                                 uint64_t generation,
+                                 const MagicSearchResult &result) {
+  if (results_.capacity() == 0) {
+    return;
+  }
+  results_.put(key, CachedResult{generation, result});
 }
 
 std::vector<int> SearchService::get_file_ids(const std::vector<FileSearchResult> &file_results) {
@@ -0,0 +1,179 @@
+#include "magic_core/types/logger.hpp"
+
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+
+#include "magic_core/types/metrics.hpp"
+
+namespace magic_core::log {
+
+namespace {
+
+void write_to_console(const std::vector<Record> &batch) {
+  bool wrote_out = false;
+  bool wrote_err = false;
+  for (const auto &record : batch) {
+    if (record.level <= Level::Info) {
+      std::cout << Logger::format(record) << '\n';
+      wrote_out = true;
+    } else {
+      std::cerr << Logger::format(record) << '\n';
+      wrote_err = true;
+    }
+  }
+  // One flush per batch rather than one per line
+  if (wrote_out) {
+    std::cout.flush();
+  }
+  if (wrote_err) {
+    std::cerr.flush();
+  }
+}
+
+}  // namespace
+
+Level parse_level(const std::string &name) {
+  if (name == "debug") {
+    return Level::Debug;
+  }
+  if (name == "info") {
+    return Level::Info;
+  }
+  if (name == "warning") {
+    return Level::Warning;
+  }
+  if (name == "error") {
+    return Level::Error;
+  }
+  if (name == "off") {
+    return Level::Off;
+  }
+  throw std::invalid_argument("Unknown log level '" + name +
+                              "' (expected debug, info, warning, error or off)");
+}
+
+std::string to_string(Level level) {
+  switch (level) {
+    case Level::Debug:
+      return "debug";
+    case Level::Info:
+      return "info";
+    case Level::Warning:
+      return "warning";
+    case Level::Error:
+      return "error";
+    case Level::Off:
+      return "off";
+  }
+  return "unknown";
+}
+
+Logger::Logger(size_t capacity, Sink sink)
+    : sink_(sink ? std::move(sink) : Sink(write_to_console)), ring_(capacity) {
+  if (capacity == 0) {
+    throw std::invalid_argument("Logger capacity must be positive");
+  }
+  flusher_ = std::thread([this] { run(); });
+}
+
+Logger::~Logger() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_one();
+  flusher_.join();
+}
+
+Logger &Logger::global() {
+  static Logger logger;
+  return logger;
+}
+
+void Logger::write(Level level, std::string message) {
+  if (!enabled(level)) {
+    return;
+  }
+  Record record{level, std::chrono::system_clock::now(), std::move(message)};
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size_ == ring_.size()) {
+      ++dropped_;
+      static metrics::Counter &dropped =
+          metrics::counter("magic_log_lines_dropped_total", "Log lines lost to a full buffer");
+      dropped.add();
+      return;
+    }
+    ring_[(head_ + size_) % ring_.size()] = std::move(record);
+    ++size_;
+    ++queued_;
+  }
+  ready_.notify_one();
+}
+
+void Logger::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t target = queued_;
+  written_.wait(lock, [&] { return delivered_ >= target; });
+}
+
+uint64_t Logger::dropped() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_;
+}
+
+std::string Logger::format(const Record &record) {
+  const auto since_epoch = record.time.time_since_epoch();
+  const std::time_t seconds = std::chrono::system_clock::to_time_t(record.time);
+  const auto millis =
+      std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch).count() % 1000;
+  std::tm utc{};
+  gmtime_r(&seconds, &utc);
+  char stamp[32];
+  const size_t length = std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+  std::string line(stamp, length);
+  line += '.';
+  line += static_cast<char>('0' + millis / 100);
+  line += static_cast<char>('0' + millis / 10 % 10);
+  line += static_cast<char>('0' + millis % 10);
+  line += "Z ";
+  for (char c : to_string(record.level)) {
+    line += static_cast<char>(c - 'a' + 'A');
+  }
+  line += ' ';
+  line += record.message;
+  return line;
+}
+
+void Logger::run() {
+  std::vector<Record> batch;
+  batch.reserve(ring_.size());
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ready_.wait(lock, [&] { return stopping_ || size_ > 0; });
+    if (size_ == 0) {
+      // Stopping, and everything queued has been written
+      return;
+    }
+    // Take the whole backlog so the sink sees one batch, not one wakeup per line
+    const size_t taken = size_;
+    for (size_t i = 0; i < taken; ++i) {
+      batch.push_back(std::move(ring_[(head_ + i) % ring_.size()]));
+    }
+    head_ = (head_ + taken) % ring_.size();
+    size_ = 0;
+    lock.unlock();
+    try {
+      sink_(batch);
+    } catch (...) {
+      // A failing sink loses the batch, not the logger
+    }
+    batch.clear();
+    lock.lock();
+    delivered_ += taken;
+    written_.notify_all();
+  }
+}
+
+}  // namespace magic_core::log
@@ -0,0 +1,170 @@
+#include "magic_core/types/metrics.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+namespace magic_core::metrics {
+
+namespace {
+
+// Prometheus floats: shortest round-tripping form, with its spellings of the infinities
+std::string format_value(double value) {
+  if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+  if (std::isnan(value)) {
+    return "NaN";
+  }
+  char buffer[32];
+  const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  return std::string(buffer, result.ptr);
+}
+
+std::string with_labels(const std::string &name, const std::string &labels,
+                        const std::string &extra = "") {
+  if (labels.empty() && extra.empty()) {
+    return name;
+  }
+  std::string joined = labels;
+  if (!labels.empty() && !extra.empty()) {
+    joined += ',';
+  }
+  joined += extra;
+  return name + "{" + joined + "}";
+}
+
+}  // namespace
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)),
+      buckets_(std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1)) {
+  if (!std::is_sorted(bounds_.begin(), bounds_.end())) {
+    throw std::invalid_argument("Histogram bounds must be ascending");
+  }
+}
+
+void Histogram::observe(double value) noexcept {
+  // A dozen bounds or so, which a linear scan beats a binary search on
+  size_t bucket = 0;
+  while (bucket < bounds_.size() && value > bounds_[bucket]) {
+    ++bucket;
+  }
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot snapshot{bounds_, {}, 0, sum_.load(std::memory_order_relaxed)};
+  snapshot.counts.reserve(bounds_.size());
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < bounds_.size(); ++i) {
+    cumulative += buckets_[i].load(std::memory_order_relaxed);
+    snapshot.counts.push_back(cumulative);
+  }
+  // Derived from the buckets, so +Inf is never below the last bound's count
+  snapshot.count = cumulative + buckets_[bounds_.size()].load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+const std::vector<double> &latency_buckets() {
+  static const std::vector<double> bounds = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005,
+                                             0.01,   0.025,   0.05,   0.1,   0.25,   0.5,
+                                             1.0,    2.5,     5.0,    10.0};
+  return bounds;
+}
+
+const std::vector<double> &size_buckets() {
+  static const std::vector<double> bounds = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024};
+  return bounds;
+}
+
+Registry &Registry::global() {
+  static Registry registry;
+  return registry;
+}
+
+Registry::Family &Registry::family(const std::string &name, const std::string &help, Type type) {
+  auto [it, inserted] = families_.try_emplace(name);
+  if (inserted) {
+    it->second.type = type;
+    it->second.help = help;
+  } else if (it->second.type != type) {
+    throw std::invalid_argument("Metric " + name + " is already registered as another type");
+  }
+  return it->second;
+}
+
+Counter &Registry::counter(const std::string &name, const std::string &help,
+                           const std::string &labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &slot = family(name, help, Type::Counter).counters[labels];
+  if (!slot) {
+    slot = std::make_unique<Counter>();
+  }
+  return *slot;
+}
+
+Gauge &Registry::gauge(const std::string &name, const std::string &help,
+                       const std::string &labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &slot = family(name, help, Type::Gauge).gauges[labels];
+  if (!slot) {
+    slot = std::make_unique<Gauge>();
+  }
+  return *slot;
+}
+
+Histogram &Registry::histogram(const std::string &name,
+                               const std::string &help,
+                               const std::vector<double> &bounds,
+                               const std::string &labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &slot = family(name, help, Type::Histogram).histograms[labels];
+  if (!slot) {
+    slot = std::make_unique<Histogram>(bounds);
+  }
+  return *slot;
+}
+
+std::string Registry::render() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string out;
+  for (const auto &[name, family] : families_) {
+    out += "# HELP " + name + " " + family.help + "\n";
+    switch (family.type) {
+      case Type::Counter:
+        out += "# TYPE " + name + " counter\n";
+        for (const auto &[labels, counter] : family.counters) {
+          out += with_labels(name, labels) + " " + std::to_string(counter->value()) + "\n";
+        }
+        break;
+      case Type::Gauge:
+        out += "# TYPE " + name + " gauge\n";
+        for (const auto &[labels, gauge] : family.gauges) {
+          out += with_labels(name, labels) + " " + format_value(gauge->value()) + "\n";
+        }
+        break;
+      case Type::Histogram:
+        out += "# TYPE " + name + " histogram\n";
+        for (const auto &[labels, histogram] : family.histograms) {
+          const Histogram::Snapshot snapshot = histogram->snapshot();
+          for (size_t i = 0; i < snapshot.bounds.size(); ++i) {
+            out += with_labels(name + "_bucket", labels,
+                               "le=\"" + format_value(snapshot.bounds[i]) + "\"") +
+                   " " + std::to_string(snapshot.counts[i]) + "\n";
+          }
+          out += with_labels(name + "_bucket", labels, "le=\"+Inf\"") + " " +
+                 std::to_string(snapshot.count) + "\n";
+          out += with_labels(name + "_sum", labels) + " " + format_value(snapshot.sum) + "\n";
+          out += with_labels(name + "_count", labels) + " " + std::to_string(snapshot.count) +
+                 "\n";
+        }
+        break;
+    }
+  }
+  return out;
+}
+
+}  // namespace magic_core::metrics
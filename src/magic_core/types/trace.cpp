@@ -0,0 +1,251 @@
+#include "magic_core/types/trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+#include "magic_core/types/metrics.hpp"
+
+namespace magic_core::trace {
+
+namespace {
+
+thread_local Context tls_context;
+
+std::mt19937_64 &thread_rng() {
+  thread_local std::mt19937_64 rng{std::random_device{}()};
+  return rng;
+}
+
+bool is_lower_hex(const std::string &text) {
+  for (char c : text) {
+    if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string unix_nanos(std::chrono::system_clock::time_point time) {
+  return std::to_string(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+}
+
+std::mutex exporter_mutex;
+std::shared_ptr<FileExporter> global_exporter;
+
+}  // namespace
+
+std::string new_trace_id() {
+  return format_span_id(new_span_id()) + format_span_id(new_span_id());
+}
+
+uint64_t new_span_id() {
+  uint64_t id = 0;
+  while (id == 0) {
+    id = thread_rng()();
+  }
+  return id;
+}
+
+std::string format_span_id(uint64_t span_id) {
+  char buffer[17];
+  std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(span_id));
+  return std::string(buffer, 16);
+}
+
+std::optional<TraceParent> parse_traceparent(const std::string &header) {
+  // version (2) - trace id (32) - parent id (16) - flags (2)
+  if (header.size() < 55 || header[2] != '-' || header[35] != '-' || header[52] != '-') {
+    return std::nullopt;
+  }
+  const std::string version = header.substr(0, 2);
+  std::string trace_id = header.substr(3, 32);
+  const std::string span_id = header.substr(36, 16);
+  const std::string flags = header.substr(53, 2);
+  // Later versions may append fields, but version 00 is exactly 55 characters
+  if (version == "ff" || (version == "00" && header.size() != 55) ||
+      (header.size() > 55 && header[55] != '-')) {
+    return std::nullopt;
+  }
+  if (!is_lower_hex(version) || !is_lower_hex(trace_id) || !is_lower_hex(span_id) ||
+      !is_lower_hex(flags)) {
+    return std::nullopt;
+  }
+  const uint64_t parent = std::stoull(span_id, nullptr, 16);
+  if (parent == 0 || trace_id == std::string(32, '0')) {
+    return std::nullopt;
+  }
+  return TraceParent{std::move(trace_id), parent};
+}
+
+Trace::Trace(std::string trace_id, uint64_t remote_parent)
+    : trace_id_(std::move(trace_id)), remote_parent_(remote_parent) {}
+
+void Trace::record(SpanRecord span) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  spans_.push_back(std::move(span));
+}
+
+std::vector<SpanRecord> Trace::spans() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return spans_;
+}
+
+std::string Trace::server_timing() const {
+  std::vector<std::pair<std::string, std::chrono::nanoseconds>> totals;
+  for (const auto &span : spans()) {
+    auto it = std::find_if(totals.begin(), totals.end(),
+                           [&](const auto &total) { return total.first == span.name; });
+    if (it == totals.end()) {
+      totals.emplace_back(span.name, span.duration);
+    } else {
+      it->second += span.duration;
+    }
+  }
+  std::string header;
+  for (const auto &[name, duration] : totals) {
+    char millis[32];
+    std::snprintf(millis, sizeof(millis), "%.3f",
+                  std::chrono::duration<double, std::milli>(duration).count());
+    if (!header.empty()) {
+      header += ", ";
+    }
+    header += name + ";dur=" + millis;
+  }
+  return header;
+}
+
+std::string Trace::to_otlp_json(const std::string &service_name) const {
+  nlohmann::json spans = nlohmann::json::array();
+  for (const auto &span : this->spans()) {
+    nlohmann::json attributes = nlohmann::json::array();
+    for (const auto &[key, value] : span.attributes) {
+      attributes.push_back({{"key", key}, {"value", {{"stringValue", value}}}});
+    }
+    const auto end =
+        span.start + std::chrono::duration_cast<std::chrono::system_clock::duration>(span.duration);
+    spans.push_back({
+        {"traceId", trace_id_},
+        {"spanId", format_span_id(span.span_id)},
+        {"parentSpanId", span.parent_span_id ? format_span_id(span.parent_span_id) : ""},
+        {"name", span.name},
+        // SPAN_KIND_INTERNAL
+        {"kind", 1},
+        {"startTimeUnixNano", unix_nanos(span.start)},
+        {"endTimeUnixNano", unix_nanos(end)},
+        {"attributes", std::move(attributes)},
+    });
+  }
+  nlohmann::json resource = {
+      {"attributes",
+       nlohmann::json::array({{{"key", "service.name"},
+                               {"value", {{"stringValue", service_name}}}}})}};
+  nlohmann::json request = {
+      {"resourceSpans",
+       nlohmann::json::array({{{"resource", std::move(resource)},
+                               {"scopeSpans",
+                                nlohmann::json::array({{{"scope", {{"name", "magic_core"}}},
+                                                        {"spans", std::move(spans)}}})}}})}};
+  return request.dump();
+}
+
+Context current() noexcept {
+  return tls_context;
+}
+
+Scope::Scope(Trace &trace) noexcept : previous_(tls_context) {
+  tls_context = {&trace, trace.remote_parent()};
+}
+
+Scope::Scope(Context context) noexcept : previous_(tls_context) {
+  tls_context = context;
+}
+
+Scope::~Scope() {
+  tls_context = previous_;
+}
+
+Span::Span(const char *name) : trace_(tls_context.trace) {
+  if (!trace_) {
+    return;
+  }
+  previous_ = tls_context;
+  record_.name = name;
+  record_.span_id = new_span_id();
+  record_.parent_span_id = previous_.span_id;
+  record_.start = std::chrono::system_clock::now();
+  started_ = std::chrono::steady_clock::now();
+  tls_context.span_id = record_.span_id;
+}
+
+Span::~Span() {
+  if (!trace_) {
+    return;
+  }
+  record_.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - started_);
+  tls_context = previous_;
+  trace_->record(std::move(record_));
+}
+
+void Span::set_attribute(const char *key, std::string value) {
+  if (trace_) {
+    record_.attributes.emplace_back(key, std::move(value));
+  }
+}
+
+void Span::set_attribute(const char *key, int64_t value) {
+  if (trace_) {
+    record_.attributes.emplace_back(key, std::to_string(value));
+  }
+}
+
+FileExporter::FileExporter(const std::string &path, std::string service_name, size_t queue_depth)
+    : out_(path, std::ios::app), service_name_(std::move(service_name)), queue_(queue_depth) {
+  if (!out_) {
+    throw std::runtime_error("Could not open trace export file: " + path);
+  }
+  writer_ = std::thread([this] { run(); });
+}
+
+FileExporter::~FileExporter() {
+  queue_.close();
+  writer_.join();
+}
+
+bool FileExporter::export_trace(const Trace &trace) {
+  if (queue_.try_push(trace.to_otlp_json(service_name_))) {
+    return true;
+  }
+  static metrics::Counter &dropped =
+      metrics::counter("magic_traces_dropped_total", "Traces lost to a full export queue");
+  dropped.add();
+  return false;
+}
+
+void FileExporter::run() {
+  while (auto line = queue_.pop()) {
+    out_ << *line << '\n';
+    // Flush once the backlog is drained rather than per trace
+    if (queue_.size() == 0) {
+      out_.flush();
+    }
+  }
+  out_.flush();
+}
+
+void set_exporter(std::shared_ptr<FileExporter> exporter) {
+  std::lock_guard<std::mutex> lock(exporter_mutex);
+  global_exporter = std::move(exporter);
+}
+
+std::shared_ptr<FileExporter> exporter() {
+  std::lock_guard<std::mutex> lock(exporter_mutex);
+  return global_exporter;
+}
+
+}  // namespace magic_core::trace
@@ -0,0 +1,247 @@
+#include "magic_core/types/vector_math.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MAGIC_VECTOR_MATH_AVX2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define MAGIC_VECTOR_MATH_NEON 1
+#endif
+
+namespace magic_core::vector_math {
+
+namespace {
+
+struct Kernels {
+  const char *name;
+  void (*add)(float *, const float *, size_t);
+  void (*scale)(float *, size_t, float);
+  float (*dot)(const float *, const float *, size_t);
+  void (*dot_rows)(const float *, const float *, size_t, size_t, float *);
+};
+
+void add_scalar(float *acc, const float *x, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    acc[i] += x[i];
+  }
+}
+
+void scale_scalar(float *x, size_t n, float factor) {
+  for (size_t i = 0; i < n; ++i) {
+    x[i] *= factor;
+  }
+}
+
+float dot_scalar(const float *a, const float *b, size_t n) {
+  float total = 0.0f;
+  for (size_t i = 0; i < n; ++i) {
+    total += a[i] * b[i];
+  }
+  return total;
+}
+
+template <float (*Dot)(const float *, const float *, size_t)>
+void dot_rows_generic(const float *query, const float *rows, size_t count, size_t n, float *out) {
+  for (size_t r = 0; r < count; ++r) {
+    out[r] = Dot(query, rows + r * n, n);
+  }
+}
+
+#if defined(MAGIC_VECTOR_MATH_AVX2)
+__attribute__((target("avx2,fma"))) void add_avx2(float *acc, const float *x, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_loadu_ps(x + i)));
+  }
+  add_scalar(acc + i, x + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void scale_avx2(float *x, size_t n, float factor) {
+  const __m256 f = _mm256_set1_ps(factor);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), f));
+  }
+  scale_scalar(x + i, n - i, factor);
+}
+
+__attribute__((target("avx2,fma"))) float horizontal_sum_avx2(__m256 acc0,
+                                                             __m256 acc1,
+                                                             __m256 acc2,
+                                                             __m256 acc3) {
+  const __m256 acc = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_movehdup_ps(half));
+  return _mm_cvtss_f32(half);
+}
+
+__attribute__((target("avx2,fma"))) float dot_avx2(const float *a, const float *b, size_t n) {
+  // Four independent accumulators hide the FMA latency
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  __m256 acc2 = _mm256_setzero_ps();
+  __m256 acc3 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+    acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+  }
+  return horizontal_sum_avx2(acc0, acc1, acc2, acc3) + dot_scalar(a + i, b + i, n - i);
+}
+
+// dot_avx2 for a dimension known at compile time: no tail, and a trip count the compiler can
+// unroll. Sums in the same order, so the results match dot_avx2 exactly.
+template <size_t N>
+__attribute__((target("avx2,fma"))) void dot_rows_avx2_fixed(const float *query,
+                                                             const float *rows,
+                                                             size_t count,
+                                                             float *out) {
+  static_assert(N % 32 == 0);
+  for (size_t r = 0; r < count; ++r) {
+    const float *row = rows + r * N;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+    for (size_t i = 0; i < N; i += 32) {
+      acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i), _mm256_loadu_ps(row + i), acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i + 8), _mm256_loadu_ps(row + i + 8), acc1);
+      acc2 =
+          _mm256_fmadd_ps(_mm256_loadu_ps(query + i + 16), _mm256_loadu_ps(row + i + 16), acc2);
+      acc3 =
+          _mm256_fmadd_ps(_mm256_loadu_ps(query + i + 24), _mm256_loadu_ps(row + i + 24), acc3);
+    }
+    // + 0.0f for dot_avx2's empty tail, which turns a -0.0 sum into 0.0
+    out[r] = horizontal_sum_avx2(acc0, acc1, acc2, acc3) + 0.0f;
+  }
+}
+
+// Exact scans run over the embedding models' dimensions; those get a kernel of their own
+__attribute__((target("avx2,fma"))) void dot_rows_avx2(const float *query,
+                                                       const float *rows,
+                                                       size_t count,
+                                                       size_t n,
+                                                       float *out) {
+  switch (n) {
+    case 384:
+      return dot_rows_avx2_fixed<384>(query, rows, count, out);
+    case 768:
+      return dot_rows_avx2_fixed<768>(query, rows, count, out);
+    case 1024:
+      return dot_rows_avx2_fixed<1024>(query, rows, count, out);
+    default:
+      return dot_rows_generic<dot_avx2>(query, rows, count, n, out);
+  }
+}
+#endif
+
+#if defined(MAGIC_VECTOR_MATH_NEON)
+void add_neon(float *acc, const float *x, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(acc + i, vaddq_f32(vld1q_f32(acc + i), vld1q_f32(x + i)));
+  }
+  add_scalar(acc + i, x + i, n - i);
+}
+
+void scale_neon(float *x, size_t n, float factor) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(x + i, vmulq_n_f32(vld1q_f32(x + i), factor));
+  }
+  scale_scalar(x + i, n - i, factor);
+}
+
+float dot_neon(const float *a, const float *b, size_t n) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  float32x4_t acc2 = vdupq_n_f32(0.0f);
+  float32x4_t acc3 = vdupq_n_f32(0.0f);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    acc2 = vfmaq_f32(acc2, vld1q_f32(a + i + 8), vld1q_f32(b + i + 8));
+    acc3 = vfmaq_f32(acc3, vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+  }
+  for (; i + 4 <= n; i += 4) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+  const float32x4_t acc = vaddq_f32(vaddq_f32(acc0, acc1), vaddq_f32(acc2, acc3));
+  return vaddvq_f32(acc) + dot_scalar(a + i, b + i, n - i);
+}
+#endif
+
+Kernels select_kernels() {
+#if defined(MAGIC_VECTOR_MATH_AVX2)
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return {"avx2", add_avx2, scale_avx2, dot_avx2, dot_rows_avx2};
+  }
+#elif defined(MAGIC_VECTOR_MATH_NEON)
+  return {"neon", add_neon, scale_neon, dot_neon, dot_rows_generic<dot_neon>};
+#endif
+  return {"scalar", add_scalar, scale_scalar, dot_scalar, dot_rows_generic<dot_scalar>};
+}
+
+const Kernels &kernels() {
+  static const Kernels selected = select_kernels();
+  return selected;
+}
+
+}  // namespace
+
+const char *kernel_name() {
+  return kernels().name;
+}
+
+void add(float *acc, const float *x, size_t n) {
+  kernels().add(acc, x, n);
+}
+
+void scale(float *x, size_t n, float factor) {
+  kernels().scale(x, n, factor);
+}
+
+float dot(const float *a, const float *b, size_t n) {
+  return kernels().dot(a, b, n);
+}
+
+void dot_rows(const float *query, const float *rows, size_t count, size_t n, float *out) {
+  kernels().dot_rows(query, rows, count, n, out);
+}
+
+void sum(const float *const *vectors, size_t count, size_t n, float *out) {
+  const Kernels &k = kernels();
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = 0.0f;
+  }
+  for (size_t v = 0; v < count; ++v) {
+    k.add(out, vectors[v], n);
+  }
+}
+
+void mean(const float *const *vectors, size_t count, size_t n, float *out) {
+  sum(vectors, count, n, out);
+  if (count > 0) {
+    scale(out, n, 1.0f / static_cast<float>(count));
+  }
+}
+
+float normalize(float *x, size_t n) {
+  const Kernels &k = kernels();
+  const float length = std::sqrt(k.dot(x, x, n));
+  if (length > 0.0f) {
+    k.scale(x, n, 1.0f / length);
+  }
+  return length;
+}
+
+}  // namespace magic_core::vector_math
@@ -0,0 +1,78 @@
+#include <csignal>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#include "magic_api/config.hpp"
+#include "magic_core/extractors/content_extractor_factory.hpp"
+#include "magic_core/extractors/tokenizer.hpp"
+#include "magic_core/llm/ollama_client.hpp"
+#include "magic_core/types/logger.hpp"
+#include "magic_worker/remote_worker.hpp"
+
+std::atomic<bool> shutdown_requested = false;
+
+void signal_handler(int) {
+  shutdown_requested = true;
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    // Embedding and tokenizer settings must match the server's, so both read magicrc.json
+    Config config = Config::from_file("magicrc.json");
+    magic_core::log::Logger::global().set_level(magic_core::log::parse_level(config.log_level));
+
+    const char *api_base_url = std::getenv("API_BASE_URL");
+    magic_worker::RemoteWorkerOptions options;
+    options.api_base_url = api_base_url ? api_base_url : "http://127.0.0.1:3030";
+    char hostname[256] = {};
+    gethostname(hostname, sizeof(hostname) - 1);
+    options.name = std::string(hostname) + "-" + std::to_string(getpid());
+    options.threads = static_cast<size_t>(config.num_workers);
+    options.embedding_model = config.embedding_model;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+      std::string flag = argv[i];
+      std::string value = argv[i + 1];
+      if (flag == "--name") {
+        options.name = value;
+      } else if (flag == "--threads") {
+        options.threads = static_cast<size_t>(std::stoul(value));
+      } else if (flag == "--lane") {
+        options.lane = magic_core::task_lane_from_string(value);
+      } else {
+        throw std::invalid_argument("Unknown option: " + flag +
+                                    ". Usage: magic_worker [--name <name>] [--threads <n>] "
+                                    "[--lane any|interactive|bulk]");
+      }
+    }
+
+    auto ollama_client =
+        std::make_shared<magic_core::OllamaClient>(config.embedding_endpoints,
+                                                   config.embedding_model);
+    std::shared_ptr<const magic_core::Tokenizer> tokenizer;
+    if (!config.tokenizer_vocab_path.empty()) {
+      tokenizer = magic_core::WordPieceTokenizer::load(config.tokenizer_vocab_path,
+                                                       config.tokenizer_lowercase);
+    }
+    auto extractor_factory = std::make_shared<magic_core::ContentExtractorFactory>(tokenizer);
+
+    magic_core::log::info() << "Magic Folder worker " << options.name << " ("
+                            << options.threads << " threads) draining "
+                            << options.api_base_url;
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    magic_worker::RemoteWorker worker(options, ollama_client, extractor_factory);
+    worker.run(shutdown_requested);
+    magic_core::log::info() << "Worker stopped.";
+    magic_core::log::Logger::global().flush();
+  } catch (const std::exception &e) {
+    magic_core::log::error() << "Error starting worker: " << e.what();
+    magic_core::log::Logger::global().flush();
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,276 @@
+#include "magic_worker/remote_worker.hpp"
+
+#include <algorithm>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "magic_core/db/embedding_cache.hpp"
+#include "magic_core/types/logger.hpp"
+
+namespace magic_worker {
+
+namespace {
+
+// Lease renewals the server refuses; the task belongs to someone else now
+class LeaseLostError : public RemoteWorkerError {
+ public:
+  using RemoteWorkerError::RemoteWorkerError;
+};
+
+constexpr long HTTP_CONFLICT = 409;
+// The server's limits: too many worker requests at once, or still warming up
+constexpr long HTTP_TOO_MANY_REQUESTS = 429;
+constexpr long HTTP_SERVICE_UNAVAILABLE = 503;
+
+}  // namespace
+
+RemoteWorker::RemoteWorker(RemoteWorkerOptions options,
+                           std::shared_ptr<magic_core::OllamaClient> ollama_client,
+                           std::shared_ptr<magic_core::ContentExtractorFactory> extractor_factory)
+    : options_(std::move(options)),
+      ollama_client_(std::move(ollama_client)),
+      extractor_factory_(std::move(extractor_factory)) {
+  if (options_.name.empty()) {
+    throw RemoteWorkerError("A remote worker needs a name");
+  }
+  if (options_.threads == 0) {
+    throw RemoteWorkerError("A remote worker needs at least one thread");
+  }
+}
+
+void RemoteWorker::run(const std::atomic<bool> &stop_requested) {
+  stop_requested_ = &stop_requested;
+  std::vector<std::thread> threads;
+  threads.reserve(options_.threads);
+  for (size_t i = 0; i < options_.threads; ++i) {
+    threads.emplace_back([this, i, &stop_requested] { run_thread(i, stop_requested); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+void RemoteWorker::run_thread(size_t thread_index, const std::atomic<bool> &stop_requested) {
+  const std::string worker = options_.name + "-" + std::to_string(thread_index);
+  // One handle per thread keeps its connection to the server alive between requests
+  CURL *curl = curl_easy_init();
+  if (!curl) {
+    magic_core::log::error() << "Worker " << worker << ": failed to initialize CURL";
+    return;
+  }
+  while (!stop_requested) {
+    bool worked = false;
+    try {
+      worked = process_next_task(curl, worker);
+    } catch (const std::exception &e) {
+      magic_core::log::error() << "Worker " << worker << ": " << e.what();
+    }
+    if (!worked) {
+      // Sleep in short steps so a stop request is seen promptly
+      const auto until = std::chrono::steady_clock::now() + options_.idle_poll;
+      while (!stop_requested && std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+    }
+  }
+  curl_easy_cleanup(curl);
+}
+
+bool RemoteWorker::process_next_task(CURL *curl, const std::string &worker) {
+  nlohmann::json claim_body;
+  claim_body["worker"] = worker;
+  claim_body["max_tasks"] = 1;
+  claim_body["lane"] = options_.lane == magic_core::TaskLane::Interactive ? "interactive"
+                       : options_.lane == magic_core::TaskLane::Bulk      ? "bulk"
+                                                                          : "any";
+  Response claimed = post(curl, "/tasks/claim", claim_body);
+  if (claimed.status != 200) {
+    throw RemoteWorkerError("Claim failed with HTTP " + std::to_string(claimed.status));
+  }
+  const nlohmann::json &tasks = claimed.body["data"]["tasks"];
+  if (tasks.empty()) {
+    return false;
+  }
+
+  const nlohmann::json &task = tasks[0];
+  const long long task_id = task.at("id").get<long long>();
+  const std::string id = std::to_string(task_id);
+  try {
+    if (task.value("task_type", "") != "PROCESS_FILE") {
+      throw RemoteWorkerError("Unsupported task type: " + task.value("task_type", ""));
+    }
+    nlohmann::json result = embed_file(curl, worker, task_id, task.at("target_path"),
+                                       task.value("stored_chunk_hashes", nlohmann::json::array()));
+    Response stored = post(curl, "/tasks/" + id + "/result", result);
+    if (stored.status == HTTP_CONFLICT) {
+      throw LeaseLostError("Lease lost before the result was stored");
+    }
+    if (stored.status != 200) {
+      throw RemoteWorkerError("Storing the result failed with HTTP " +
+                              std::to_string(stored.status) + ": " +
+                              stored.body.value("error", std::string()));
+    }
+    magic_core::log::info() << "Worker " << worker << ": completed task " << id;
+  } catch (const LeaseLostError &e) {
+    // Someone else owns the task now; report nothing
+    magic_core::log::warning() << "Worker " << worker << ": abandoned task " << id << ": "
+                               << e.what();
+  } catch (const std::exception &e) {
+    magic_core::log::error() << "Worker " << worker << ": task " << id << " failed: "
+                             << e.what();
+    nlohmann::json fail_body;
+    fail_body["worker"] = worker;
+    fail_body["error"] = e.what();
+    post(curl, "/tasks/" + id + "/fail", fail_body);
+  }
+  return true;
+}
+
+nlohmann::json RemoteWorker::embed_file(CURL *curl,
+                                        const std::string &worker,
+                                        long long task_id,
+                                        const std::string &file_path,
+                                        const nlohmann::json &stored_chunk_hashes) {
+  post_progress(curl, worker, task_id, 0.0f, "Extracting content...");
+  magic_core::ExtractionResult extraction =
+      extractor_factory_->get_extractor_for(file_path).extract_with_hash(file_path);
+  post_progress(curl, worker, task_id, 0.1f, "Content extracted.");
+
+  // Chunks whose content the server already has a vector for go up without one
+  const std::unordered_set<std::string> stored(stored_chunk_hashes.begin(),
+                                               stored_chunk_hashes.end());
+  std::vector<size_t> to_embed;
+  for (size_t i = 0; i < extraction.chunks.size(); ++i) {
+    if (!stored.contains(magic_core::EmbeddingCache::content_key(extraction.chunks[i].content))) {
+      to_embed.push_back(i);
+    }
+  }
+
+  // Each batch takes the size the client's endpoints are tuned to at the time
+  for (size_t start = 0, end = 0; start < to_embed.size(); start = end) {
+    end = std::min(start + ollama_client_->embedding_batch_size(), to_embed.size());
+    std::vector<std::string> texts;
+    texts.reserve(end - start);
+    for (size_t n = start; n < end; ++n) {
+      texts.push_back(extraction.chunks[to_embed[n]].content);
+    }
+    std::vector<std::vector<float>> embeddings = ollama_client_->get_embeddings(texts);
+    for (size_t n = start; n < end; ++n) {
+      extraction.chunks[to_embed[n]].vector_embedding = std::move(embeddings[n - start]);
+    }
+    post_progress(curl, worker, task_id, 0.1f + 0.8f * static_cast<float>(end) / to_embed.size(),
+                  "Embedded " + std::to_string(end) + " of " + std::to_string(to_embed.size()) +
+                      " chunks.");
+  }
+
+  nlohmann::json result;
+  result["worker"] = worker;
+  result["embedding_model"] = options_.embedding_model;
+  nlohmann::json chunks = nlohmann::json::array();
+  for (const auto &chunk : extraction.chunks) {
+    nlohmann::json chunk_json;
+    chunk_json["chunk_index"] = chunk.chunk_index;
+    chunk_json["content"] = chunk.content;
+    if (!chunk.vector_embedding.empty()) {
+      chunk_json["embedding"] = chunk.vector_embedding;
+    }
+    chunks.push_back(std::move(chunk_json));
+  }
+  result["chunks"] = std::move(chunks);
+  return result;
+}
+
+void RemoteWorker::post_progress(CURL *curl,
+                                 const std::string &worker,
+                                 long long task_id,
+                                 float percent,
+                                 const std::string &message) {
+  nlohmann::json body;
+  body["worker"] = worker;
+  body["percent"] = percent;
+  body["message"] = message;
+  Response response = post(curl, "/tasks/" + std::to_string(task_id) + "/lease", body);
+  if (response.status == HTTP_CONFLICT) {
+    throw LeaseLostError(response.body.value("error", std::string("Lease lost")));
+  }
+  if (response.status != 200) {
+    throw RemoteWorkerError("Lease renewal failed with HTTP " + std::to_string(response.status));
+  }
+}
+
+RemoteWorker::Response RemoteWorker::post(CURL *curl,
+                                          const std::string &endpoint,
+                                          const nlohmann::json &body) {
+  const std::string payload = body.dump();
+  const auto give_up = std::chrono::steady_clock::now() + MAX_OVERLOAD_WAIT;
+  std::chrono::milliseconds backoff = OVERLOAD_BACKOFF;
+  while (true) {
+    std::chrono::seconds retry_after{0};
+    Response response = send(curl, endpoint, payload, retry_after);
+    if (response.status != HTTP_TOO_MANY_REQUESTS &&
+        response.status != HTTP_SERVICE_UNAVAILABLE) {
+      return response;
+    }
+    // An overloaded server is no verdict on the task: wait as long as it asks, or longer
+    const std::chrono::milliseconds wait =
+        std::max<std::chrono::milliseconds>(backoff, retry_after);
+    if (std::chrono::steady_clock::now() + wait > give_up) {
+      return response;
+    }
+    magic_core::log::warning() << "Server answered " << endpoint << " with HTTP "
+                               << response.status << "; retrying in " << wait.count() << " ms";
+    // In short steps, so a stop request is seen promptly
+    const auto until = std::chrono::steady_clock::now() + wait;
+    while (std::chrono::steady_clock::now() < until) {
+      if (stop_requested_ && *stop_requested_) {
+        return response;
+      }
+      std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+          std::chrono::milliseconds(100), until - std::chrono::steady_clock::now()));
+    }
+    backoff = std::min(backoff * 2, MAX_OVERLOAD_BACKOFF);
+  }
+}
+
+RemoteWorker::Response RemoteWorker::send(CURL *curl,
+                                          const std::string &endpoint,
+                                          const std::string &payload,
+                                          std::chrono::seconds &retry_after) {
+  const std::string url = options_.api_base_url + endpoint;
+  std::string response_buffer;
+
+  curl_easy_reset(curl);
+  curl_slist *headers = curl_slist_append(nullptr, "Content-Type: application/json");
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload.c_str());
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(payload.size()));
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_buffer);
+  CURLcode res = curl_easy_perform(curl);
+  curl_slist_free_all(headers);
+  if (res != CURLE_OK) {
+    throw RemoteWorkerError("Request to " + url + " failed: " + curl_easy_strerror(res));
+  }
+
+  Response response;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response.status);
+  curl_off_t retry_after_s = 0;
+  if (curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retry_after_s) == CURLE_OK) {
+    retry_after = std::chrono::seconds(retry_after_s);
+  }
+  response.body = nlohmann::json::parse(response_buffer, nullptr, /*allow_exceptions*/ false);
+  if (response.body.is_discarded()) {
+    response.body = nlohmann::json::object();
+  }
+  return response;
+}
+
+size_t RemoteWorker::write_callback(void *contents, size_t size, size_t nmemb, std::string *userp) {
+  userp->append(static_cast<char *>(contents), size * nmemb);
+  return size * nmemb;
+}
+
+}  // namespace magic_worker
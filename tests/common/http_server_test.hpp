@@ -0,0 +1,152 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace magic_tests {
+
+/**
+ * Minimal keep-alive HTTP/1.1 server on 127.0.0.1 for exercising HTTP clients without a real
+ * backend. Every connection is served on its own thread by a handler that maps
+ * (method, path, body) to (status, body).
+ */
+class LoopbackHttpServer {
+ public:
+  struct Response {
+    int status = 200;
+    std::string body;
+  };
+  using Handler =
+      std::function<Response(const std::string& method, const std::string& path,
+                             const std::string& body)>;
+
+  explicit LoopbackHttpServer(Handler handler) : handler_(std::move(handler)) {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd_, 64) != 0) {
+      ::close(listen_fd_);
+      throw std::runtime_error("LoopbackHttpServer could not listen");
+    }
+    socklen_t len = sizeof(addr);
+    ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+    acceptor_ = std::thread([this] { accept_loop(); });
+  }
+
+  ~LoopbackHttpServer() {
+    stopping_ = true;
+    ::shutdown(listen_fd_, SHUT_RDWR);
+    ::close(listen_fd_);
+    acceptor_.join();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (int fd : connection_fds_) {
+        ::shutdown(fd, SHUT_RDWR);
+      }
+    }
+    for (auto& thread : connection_threads_) {
+      thread.join();
+    }
+    // Closed only here so a descriptor number is never reused while still listed
+    for (int fd : connection_fds_) {
+      ::close(fd);
+    }
+  }
+
+  std::string url() const {
+    return "http://127.0.0.1:" + std::to_string(port_);
+  }
+  // TCP connections accepted so far; stays at 1 while a single client reuses its connection
+  int connections_accepted() const {
+    return connections_accepted_;
+  }
+  int requests_served() const {
+    return requests_served_;
+  }
+
+ private:
+  void accept_loop() {
+    while (!stopping_) {
+      int fd = ::accept(listen_fd_, nullptr, nullptr);
+      if (fd < 0) {
+        return;
+      }
+      ++connections_accepted_;
+      std::lock_guard<std::mutex> lock(mutex_);
+      connection_fds_.push_back(fd);
+      connection_threads_.emplace_back([this, fd] { serve(fd); });
+    }
+  }
+
+  // Serves requests on fd until the peer closes it or the server shuts down
+  void serve(int fd) {
+    std::string buffer;
+    char chunk[4096];
+    while (true) {
+      size_t header_end;
+      while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+          return;
+        }
+        buffer.append(chunk, static_cast<size_t>(n));
+      }
+      const std::string head = buffer.substr(0, header_end);
+      size_t content_length = 0;
+      const size_t length_at = head.find("Content-Length: ");
+      if (length_at != std::string::npos) {
+        content_length = std::stoul(head.substr(length_at + 16));
+      }
+      while (buffer.size() < header_end + 4 + content_length) {
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+          return;
+        }
+        buffer.append(chunk, static_cast<size_t>(n));
+      }
+      const std::string body = buffer.substr(header_end + 4, content_length);
+      buffer.erase(0, header_end + 4 + content_length);
+
+      const size_t method_end = head.find(' ');
+      const size_t path_end = head.find(' ', method_end + 1);
+      Response response = handler_(head.substr(0, method_end),
+                                   head.substr(method_end + 1, path_end - method_end - 1), body);
+      ++requests_served_;
+      std::string out = "HTTP/1.1 " + std::to_string(response.status) +
+                        " OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                        std::to_string(response.body.size()) + "\r\n\r\n" + response.body;
+      if (::send(fd, out.data(), out.size(), MSG_NOSIGNAL) < 0) {
+        return;
+      }
+    }
+  }
+
+  Handler handler_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::atomic<bool> stopping_{false};
+  std::atomic<int> connections_accepted_{0};
+  std::atomic<int> requests_served_{0};
+  std::thread acceptor_;
+  std::mutex mutex_;
+  std::vector<int> connection_fds_;
+  std::vector<std::thread> connection_threads_;
+};
+
+}  // namespace magic_tests
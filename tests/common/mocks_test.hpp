@@ -24,9 +24,22 @@ class MockOllamaClient : public magic_core::OllamaClient {
     
     ON_CALL(*this, get_embedding(testing::_))
         .WillByDefault(testing::Return(default_embedding));
+    ON_CALL(*this, get_embeddings(testing::_))
+        .WillByDefault([default_embedding](const std::vector<std::string>& texts) {
+          return std::vector<std::vector<float>>(texts.size(), default_embedding);
+        });
   }
 
   MOCK_METHOD(std::vector<float>, get_embedding, (const std::string& text), (override));
+  MOCK_METHOD(std::vector<std::vector<float>>, get_embeddings,
+              (const std::vector<std::string>& texts_to_embed), (override));
+
+  // Routed through the mocked batch call so expectations on get_embeddings cover both
+  std::future<std::vector<std::vector<float>>> get_embeddings_async(
+      const std::vector<std::string>& texts_to_embed) override {
+    return std::async(std::launch::deferred,
+                      [this, texts_to_embed] { return get_embeddings(texts_to_embed); });
+  }
 };
 
 /**
@@ -68,6 +81,13 @@ inline std::vector<float> create_test_embedding(float value = 0.1f, size_t dimen
   return embedding;
 }
 
+// get_embeddings action that returns the same embedding for every input text
+inline auto embed_each_with(std::vector<float> embedding) {
+  return [embedding](const std::vector<std::string>& texts) {
+    return std::vector<std::vector<float>>(texts.size(), embedding);
+  };
+}
+
 // Create a test embedding with custom values
 inline std::vector<float> create_test_embedding_with_values(const std::vector<float>& values) {
   std::vector<float> embedding(1024, 0.1f);
@@ -21,6 +21,11 @@ void TestUtilities::cleanup_temp_db(const std::filesystem::path& db_path) {
   if (std::filesystem::exists(db_path)) {
     std::filesystem::remove(db_path);
   }
+  for (const char* name : {"files", "chunks"}) {
+    const auto segment = magic_core::DatabaseManager::vector_store_path(db_path, name);
+    std::filesystem::remove(segment);
+    std::filesystem::remove(magic_core::VectorStore::compacted_path(segment));
+  }
 
   // Also cleanup the parent directory if it's empty
   auto parent_dir = db_path.parent_path();
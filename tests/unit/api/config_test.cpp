@@ -116,4 +116,259 @@ TEST(ConfigTest, NonPositiveWorkersDefaultsAndValidates) {
   EXPECT_THROW({ (void)Config::from_json(j); }, std::runtime_error);
 }
 
+TEST(ConfigTest, ParsesMaxWorkers) {
+  EXPECT_EQ(Config::from_json({{"num_workers", 3}}).max_workers, 3);
+  EXPECT_EQ(Config::from_json({{"num_workers", 2}, {"max_workers", 6}}).max_workers, 6);
+  EXPECT_THROW(Config::from_json({{"num_workers", 4}, {"max_workers", 2}}), std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesLaneReservations) {
+  Config cfg = Config::from_json(
+      {{"num_workers", 4}, {"interactive_workers", 1}, {"bulk_workers", 2}});
+  EXPECT_EQ(cfg.interactive_workers, 1);
+  EXPECT_EQ(cfg.bulk_workers, 2);
+  EXPECT_EQ(Config::from_json(nlohmann::json::object()).interactive_workers, 0);
+  EXPECT_THROW(
+      Config::from_json({{"num_workers", 2}, {"interactive_workers", 1}, {"bulk_workers", 2}}),
+      std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesWorkerMemoryBudget) {
+  EXPECT_EQ(Config::from_json({{"worker_memory_budget_mb", 512}}).worker_memory_budget_mb, 512);
+  EXPECT_EQ(Config::from_json(nlohmann::json::object()).worker_memory_budget_mb, 0);
+  EXPECT_THROW(Config::from_json({{"worker_memory_budget_mb", -1}}), std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesHttpThreads) {
+  EXPECT_EQ(Config::from_json({{"http_threads", 16}}).http_threads, 16);
+  EXPECT_EQ(Config::from_json(nlohmann::json::object()).http_threads, 4);
+  EXPECT_THROW(Config::from_json({{"http_threads", 0}}), std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesTokenizerSection) {
+  nlohmann::json j = {{"tokenizer", {{"vocab_path", "/models/vocab.txt"}, {"lowercase", false}}}};
+
+  Config cfg = Config::from_json(j);
+
+  EXPECT_EQ(cfg.tokenizer_vocab_path, "/models/vocab.txt");
+  EXPECT_FALSE(cfg.tokenizer_lowercase);
+
+  Config defaults = Config::from_json(nlohmann::json::object());
+  EXPECT_TRUE(defaults.tokenizer_vocab_path.empty());
+  EXPECT_TRUE(defaults.tokenizer_lowercase);
+}
+
+TEST(ConfigTest, EmbeddingEndpointsDefaultToOllamaUrl) {
+  Config defaults = Config::from_json({{"ollama_url", "http://gpu-1:11434"}});
+  EXPECT_EQ(defaults.embedding_endpoints, std::vector<std::string>{"http://gpu-1:11434"});
+
+  Config cfg = Config::from_json(
+      {{"embedding_endpoints", {"http://gpu-1:11434", "http://gpu-2:11434"}}});
+  EXPECT_EQ(cfg.embedding_endpoints.size(), 2u);
+
+  EXPECT_THROW(Config::from_json({{"embedding_endpoints", nlohmann::json::array()}}),
+               std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesEmbeddingDimension) {
+  EXPECT_EQ(Config::from_json(nlohmann::json::object()).embedding_dimension, 1024);
+  EXPECT_EQ(Config::from_json({{"embedding_dimension", 384}}).embedding_dimension, 384);
+  EXPECT_THROW(Config::from_json({{"embedding_dimension", 0}}), std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesSearchSection) {
+  nlohmann::json j = {{"search", {{"query_cache_entries", 0}, {"result_cache_entries", 64}}}};
+
+  Config cfg = Config::from_json(j);
+
+  EXPECT_EQ(cfg.search_query_cache_entries, 0);
+  EXPECT_EQ(cfg.search_result_cache_entries, 64);
+
+  Config defaults = Config::from_json(nlohmann::json::object());
+  EXPECT_EQ(defaults.search_query_cache_entries, 256);
+  EXPECT_EQ(defaults.search_result_cache_entries, 0);
+
+  nlohmann::json negative = {{"search", {{"result_cache_entries", -1}}}};
+  EXPECT_THROW(Config::from_json(negative), std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesSearchExecutorLimits) {
+  Config cfg = Config::from_json({{"search", {{"threads", 8}, {"queue_depth", 16}}}});
+  EXPECT_EQ(cfg.search_threads, 8);
+  EXPECT_EQ(cfg.search_queue_depth, 16);
+
+  Config defaults = Config::from_json(nlohmann::json::object());
+  EXPECT_EQ(defaults.search_threads, 4);
+  EXPECT_EQ(defaults.search_queue_depth, 64);
+
+  EXPECT_THROW(Config::from_json({{"search", {{"threads", 0}}}}), std::runtime_error);
+  EXPECT_THROW(Config::from_json({{"search", {{"queue_depth", 0}}}}), std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesSearchPlan) {
+  Config cfg = Config::from_json(
+      {{"search", {{"file_shortlist", 50}, {"exact_chunk_scan", false},
+                   {"chunk_slab_cache_mb", 0}}}});
+  EXPECT_EQ(cfg.search_file_shortlist, 50);
+  EXPECT_FALSE(cfg.search_exact_chunk_scan);
+  EXPECT_EQ(cfg.search_chunk_slab_cache_mb, 0);
+
+  Config defaults = Config::from_json(nlohmann::json::object());
+  EXPECT_EQ(defaults.search_file_shortlist, 0);
+  EXPECT_TRUE(defaults.search_exact_chunk_scan);
+  EXPECT_EQ(defaults.search_chunk_slab_cache_mb, 128);
+
+  EXPECT_THROW(Config::from_json({{"search", {{"file_shortlist", -1}}}}), std::runtime_error);
+  EXPECT_THROW(Config::from_json({{"search", {{"chunk_slab_cache_mb", -1}}}}),
+               std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesLogLevel) {
+  EXPECT_EQ(Config::from_json({{"log", {{"level", "warning"}}}}).log_level, "warning");
+  EXPECT_EQ(Config::from_json(nlohmann::json::object()).log_level, "info");
+  EXPECT_THROW(Config::from_json({{"log", {{"level", "verbose"}}}}), std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesTracingExportPath) {
+  EXPECT_EQ(Config::from_json({{"tracing", {{"export_path", "traces.jsonl"}}}}).tracing_export_path,
+            "traces.jsonl");
+  EXPECT_TRUE(Config::from_json(nlohmann::json::object()).tracing_export_path.empty());
+}
 
+TEST(ConfigTest, ParsesStartupSection) {
+  Config cfg =
+      Config::from_json({{"startup", {{"prefault_vectors", true}, {"warm_up_model", true}}}});
+  EXPECT_TRUE(cfg.startup_prefault_vectors);
+  EXPECT_TRUE(cfg.startup_warm_up_model);
+
+  Config defaults = Config::from_json(nlohmann::json::object());
+  EXPECT_FALSE(defaults.startup_prefault_vectors);
+  EXPECT_FALSE(defaults.startup_warm_up_model);
+}
+
+TEST(ConfigTest, ParsesSnapshotSection) {
+  Config cfg = Config::from_json({{"snapshot", {{"pages_per_step", 64}, {"max_mb_per_s", 0}}}});
+  EXPECT_EQ(cfg.snapshot_pages_per_step, 64);
+  EXPECT_EQ(cfg.snapshot_max_mb_per_s, 0);
+
+  Config defaults = Config::from_json(nlohmann::json::object());
+  EXPECT_EQ(defaults.snapshot_pages_per_step, 256);
+  EXPECT_EQ(defaults.snapshot_max_mb_per_s, 64);
+  EXPECT_THROW(Config::from_json({{"snapshot", {{"pages_per_step", 0}}}}), std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesRerankSection) {
+  Config cfg = Config::from_json({{"rerank",
+                                   {{"url", "http://localhost:8012"},
+                                    {"model", "bge-reranker-v2-m3"},
+                                    {"candidates", 30},
+                                    {"budget_ms", 80}}}});
+  EXPECT_EQ(cfg.rerank_url, "http://localhost:8012");
+  EXPECT_EQ(cfg.rerank_model, "bge-reranker-v2-m3");
+  EXPECT_EQ(cfg.rerank_candidates, 30);
+  EXPECT_EQ(cfg.rerank_batch_size, 16);
+  EXPECT_EQ(cfg.rerank_budget_ms, 80);
+  EXPECT_EQ(cfg.rerank_max_chars, 2048);
+
+  EXPECT_TRUE(Config::from_json(nlohmann::json::object()).rerank_url.empty());
+  EXPECT_THROW(
+      Config::from_json({{"rerank", {{"url", "http://localhost:8012"}, {"batch_size", 0}}}}),
+      std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesIngestAndRemoteWorkerLimits) {
+  Config cfg = Config::from_json({{"ingest", {{"threads", 3}, {"queue_depth", 8}}},
+                                  {"remote_workers", {{"max_in_flight", 0}}}});
+  EXPECT_EQ(cfg.ingest_threads, 3);
+  EXPECT_EQ(cfg.ingest_queue_depth, 8);
+  EXPECT_EQ(cfg.remote_worker_max_in_flight, 0);
+
+  Config defaults = Config::from_json(nlohmann::json::object());
+  EXPECT_EQ(defaults.ingest_threads, 2);
+  EXPECT_EQ(defaults.ingest_queue_depth, 32);
+  EXPECT_EQ(defaults.remote_worker_max_in_flight, 16);
+
+  EXPECT_THROW(Config::from_json({{"ingest", {{"threads", 0}}}}), std::runtime_error);
+  EXPECT_THROW(Config::from_json({{"remote_workers", {{"max_in_flight", -1}}}}),
+               std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesEmbeddingCacheSection) {
+  Config cfg = Config::from_json(
+      {{"embedding_cache", {{"near_duplicate_entries", 65536}, {"near_duplicate_distance", 4}}}});
+  EXPECT_EQ(cfg.embedding_cache_near_duplicate_entries, 65536);
+  EXPECT_EQ(cfg.embedding_cache_near_duplicate_distance, 4);
+
+  Config defaults = Config::from_json(nlohmann::json::object());
+  EXPECT_EQ(defaults.embedding_cache_near_duplicate_entries, 0);
+  EXPECT_EQ(defaults.embedding_cache_near_duplicate_distance, 7);
+
+  EXPECT_THROW(Config::from_json({{"embedding_cache", {{"near_duplicate_distance", 9}}}}),
+               std::runtime_error);
+  EXPECT_THROW(Config::from_json({{"embedding_cache", {{"near_duplicate_entries", -1}}}}),
+               std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesVectorIndexSection) {
+  nlohmann::json j = {{"vector_index",
+                       {{"type", "ivf_pq"}, {"ivf_lists", 256}, {"pq_subquantizers", 64},
+                        {"nprobe", 8}}}};
+
+  Config cfg = Config::from_json(j);
+
+  EXPECT_EQ(cfg.vector_index_type, "ivf_pq");
+  EXPECT_EQ(cfg.vector_index_ivf_lists, 256);
+  EXPECT_EQ(cfg.vector_index_pq_subquantizers, 64);
+  EXPECT_EQ(cfg.vector_index_nprobe, 8);
+  EXPECT_EQ(cfg.vector_index_hnsw_m, 32);
+
+  Config defaults = Config::from_json(nlohmann::json::object());
+  EXPECT_EQ(defaults.vector_index_type, "hnsw");
+  EXPECT_EQ(defaults.vector_index_ef_construction, 100);
+  EXPECT_EQ(defaults.vector_index_ef_search, 64);
+  EXPECT_EQ(defaults.vector_index_metric, "l2");
+  EXPECT_EQ(Config::from_json({{"vector_index", {{"metric", "cosine"}}}}).vector_index_metric,
+            "cosine");
+  EXPECT_THROW(Config::from_json({{"vector_index", {{"metric", "dot"}}}}), std::runtime_error);
+
+  nlohmann::json unknown = {{"vector_index", {{"type", "lsh"}}}};
+  EXPECT_THROW(Config::from_json(unknown), std::runtime_error);
+  nlohmann::json zero = {{"vector_index", {{"nprobe", 0}}}};
+  EXPECT_THROW(Config::from_json(zero), std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesVectorStoreEncoding) {
+  Config cfg = Config::from_json({{"vector_store", {{"encoding", "float16"}}}});
+  EXPECT_EQ(cfg.vector_store_encoding, "float16");
+
+  Config defaults = Config::from_json(nlohmann::json::object());
+  EXPECT_EQ(defaults.vector_store_encoding, "float32");
+
+  EXPECT_THROW(Config::from_json({{"vector_store", {{"encoding", "int4"}}}}), std::runtime_error);
+}
+
+TEST(ConfigTest, ParsesWatchSection) {
+  nlohmann::json j = {
+      {"watch", {{"enabled", true},
+                 {"inbox_root", "/tmp/inbox"},
+                 {"recursive", false},
+                 {"settle_ms", 250},
+                 {"ignore", {"*.part"}}}}
+  };
+
+  Config cfg = Config::from_json(j);
+
+  EXPECT_TRUE(cfg.watch_enabled);
+  EXPECT_EQ(cfg.watch_inbox_root, "/tmp/inbox");
+  EXPECT_FALSE(cfg.watch_recursive);
+  EXPECT_EQ(cfg.watch_settle_ms, 250);
+  EXPECT_EQ(cfg.watch_ignore, std::vector<std::string>{"*.part"});
+}
+
+TEST(ConfigTest, WatchDisabledByDefault) {
+  Config cfg = Config::from_json(nlohmann::json::object());
+
+  EXPECT_FALSE(cfg.watch_enabled);
+  EXPECT_EQ(cfg.watch_settle_ms, 1500);
+  EXPECT_TRUE(cfg.watch_recursive);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#include "magic_core/async/bounded_executor.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core::async;
+
+TEST(BoundedExecutorTest, RunsSubmittedJobs) {
+  BoundedExecutor executor("test", 2, 8);
+  std::atomic<int> ran{0};
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(executor.try_submit([&] { ran++; }));
+  }
+  executor.shutdown();
+  EXPECT_EQ(ran, 8);
+  EXPECT_EQ(executor.rejected(), 0);
+}
+
+TEST(BoundedExecutorTest, TrySubmit_ShedsWhenQueueIsFull) {
+  BoundedExecutor executor("test", 1, 1);
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  std::promise<void> started;
+
+  ASSERT_TRUE(executor.try_submit([&] {
+    started.set_value();
+    released.wait();
+  }));
+  started.get_future().wait();
+  EXPECT_EQ(executor.active(), 1);
+
+  // The only thread is busy: one job may wait, the next is refused
+  EXPECT_TRUE(executor.try_submit([] {}));
+  EXPECT_EQ(executor.queued(), 1);
+  EXPECT_FALSE(executor.try_submit([] {}));
+  EXPECT_EQ(executor.rejected(), 1);
+
+  release.set_value();
+  executor.shutdown();
+  EXPECT_EQ(executor.queued(), 0);
+}
+
+TEST(BoundedExecutorTest, Shutdown_RunsQueuedJobsThenRefusesNewOnes) {
+  BoundedExecutor executor("test", 1, 4);
+  std::atomic<int> ran{0};
+  for (int i = 0; i < 4; ++i) {
+    executor.try_submit([&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      ran++;
+    });
+  }
+  executor.shutdown();
+  executor.shutdown();
+
+  EXPECT_EQ(ran, 4);
+  EXPECT_FALSE(executor.try_submit([] {}));
+}
+
+TEST(BoundedExecutorTest, ThrowingJobDoesNotStopThread) {
+  BoundedExecutor executor("test", 1, 4);
+  std::atomic<bool> ran{false};
+  executor.try_submit([] { throw std::runtime_error("boom"); });
+  executor.try_submit([&] { ran = true; });
+  executor.shutdown();
+  EXPECT_TRUE(ran);
+}
+
+}  // namespace magic_tests
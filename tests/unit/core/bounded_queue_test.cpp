@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "magic_core/async/bounded_queue.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core::async;
+
+TEST(BoundedQueueTest, PopReturnsItemsInOrder) {
+  BoundedQueue<int> queue(4);
+  queue.push(1);
+  queue.push(2);
+  queue.push(3);
+
+  EXPECT_EQ(queue.pop(), 1);
+  EXPECT_EQ(queue.pop(), 2);
+  EXPECT_EQ(queue.pop(), 3);
+}
+
+TEST(BoundedQueueTest, Close_DrainsRemainingItemsThenEnds) {
+  BoundedQueue<int> queue(4);
+  queue.push(7);
+  queue.close();
+
+  EXPECT_FALSE(queue.push(8));
+  EXPECT_EQ(queue.pop(), 7);
+  EXPECT_EQ(queue.pop(), std::nullopt);
+}
+
+TEST(BoundedQueueTest, Push_BlocksWhileFull) {
+  BoundedQueue<int> queue(1);
+  queue.push(1);
+
+  std::atomic<bool> pushed{false};
+  std::thread producer([&] {
+    queue.push(2);
+    pushed = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(pushed);
+
+  EXPECT_EQ(queue.pop(), 1);
+  producer.join();
+  EXPECT_TRUE(pushed);
+  EXPECT_EQ(queue.pop(), 2);
+}
+
+TEST(BoundedQueueTest, Close_WakesBlockedConsumer) {
+  BoundedQueue<int> queue(1);
+  std::optional<int> result = 0;
+  std::thread consumer([&] { result = queue.pop(); });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  queue.close();
+  consumer.join();
+
+  EXPECT_EQ(result, std::nullopt);
+}
+
+TEST(BoundedQueueTest, MultipleProducersDeliverEveryItem) {
+  BoundedQueue<int> queue(2);
+  constexpr int PER_PRODUCER = 100;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < 3; ++p) {
+    producers.emplace_back([&] {
+      for (int i = 0; i < PER_PRODUCER; ++i) {
+        queue.push(1);
+      }
+    });
+  }
+
+  int total = 0;
+  for (int i = 0; i < 3 * PER_PRODUCER; ++i) {
+    total += queue.pop().value_or(0);
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  EXPECT_EQ(total, 3 * PER_PRODUCER);
+}
+
+TEST(BoundedQueueTest, TryPush_RefusesWhenFullOrClosed) {
+  BoundedQueue<int> queue(1);
+  EXPECT_TRUE(queue.try_push(1));
+  EXPECT_FALSE(queue.try_push(2));
+  EXPECT_EQ(queue.size(), 1);
+
+  EXPECT_EQ(queue.pop(), 1);
+  queue.close();
+  EXPECT_FALSE(queue.try_push(3));
+}
+
+}  // namespace magic_tests
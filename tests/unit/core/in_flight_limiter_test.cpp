@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include <utility>
+
+#include "magic_core/async/in_flight_limiter.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core::async;
+
+TEST(InFlightLimiterTest, RefusesPastLimitUntilPermitReleased) {
+  InFlightLimiter limiter(2);
+  auto first = limiter.try_acquire();
+  auto second = limiter.try_acquire();
+  EXPECT_TRUE(first);
+  EXPECT_TRUE(second);
+  EXPECT_EQ(limiter.in_flight(), 2);
+
+  EXPECT_FALSE(limiter.try_acquire());
+  EXPECT_EQ(limiter.rejected(), 1);
+  EXPECT_EQ(limiter.in_flight(), 2);
+
+  first = InFlightLimiter::Permit();
+  EXPECT_EQ(limiter.in_flight(), 1);
+  EXPECT_TRUE(limiter.try_acquire());
+}
+
+TEST(InFlightLimiterTest, MovedPermitReleasesOnce) {
+  InFlightLimiter limiter(1);
+  {
+    auto permit = limiter.try_acquire();
+    InFlightLimiter::Permit moved = std::move(permit);
+    EXPECT_FALSE(permit);
+    EXPECT_TRUE(moved);
+    EXPECT_EQ(limiter.in_flight(), 1);
+  }
+  EXPECT_EQ(limiter.in_flight(), 0);
+}
+
+TEST(InFlightLimiterTest, ZeroLimitGrantsEveryPermit) {
+  InFlightLimiter limiter(0);
+  auto a = limiter.try_acquire();
+  auto b = limiter.try_acquire();
+  EXPECT_TRUE(a);
+  EXPECT_TRUE(b);
+  EXPECT_EQ(limiter.rejected(), 0);
+}
+
+}  // namespace magic_tests
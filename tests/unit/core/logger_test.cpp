@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "magic_core/types/logger.hpp"
+
+namespace magic_tests {
+
+namespace log = magic_core::log;
+
+// Collects what the flusher hands to the sink
+struct CapturingSink {
+  std::mutex mutex;
+  std::vector<log::Record> records;
+  size_t batches = 0;
+
+  log::Logger::Sink sink() {
+    return [this](const std::vector<log::Record> &batch) {
+      std::lock_guard<std::mutex> lock(mutex);
+      records.insert(records.end(), batch.begin(), batch.end());
+      ++batches;
+    };
+  }
+};
+
+// Records whether it was ever streamed
+struct Probe {
+  bool &formatted;
+};
+
+std::ostream &operator<<(std::ostream &out, const Probe &probe) {
+  probe.formatted = true;
+  return out << "probe";
+}
+
+TEST(LoggerTest, ParseLevel_RoundTripsEveryLevel) {
+  for (auto level : {log::Level::Debug, log::Level::Info, log::Level::Warning,
+                     log::Level::Error, log::Level::Off}) {
+    EXPECT_EQ(log::parse_level(log::to_string(level)), level);
+  }
+  EXPECT_THROW(log::parse_level("verbose"), std::invalid_argument);
+}
+
+TEST(LoggerTest, Flush_DeliversLinesInOrder) {
+  CapturingSink capture;
+  log::Logger logger(64, capture.sink());
+  for (int i = 0; i < 10; ++i) {
+    log::Line(logger, log::Level::Info) << "line " << i;
+  }
+  logger.flush();
+
+  std::lock_guard<std::mutex> lock(capture.mutex);
+  ASSERT_EQ(capture.records.size(), 10u);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(capture.records[i].message, "line " + std::to_string(i));
+    EXPECT_EQ(capture.records[i].level, log::Level::Info);
+  }
+}
+
+TEST(LoggerTest, Write_SkipsLevelsBelowTheThreshold) {
+  CapturingSink capture;
+  log::Logger logger(64, capture.sink());
+  logger.set_level(log::Level::Warning);
+
+  bool formatted = false;
+  log::Line(logger, log::Level::Info) << Probe{formatted};
+  log::Line(logger, log::Level::Error) << "kept";
+  logger.flush();
+
+  std::lock_guard<std::mutex> lock(capture.mutex);
+  ASSERT_EQ(capture.records.size(), 1u);
+  EXPECT_EQ(capture.records[0].message, "kept");
+  // A disabled line never runs its operator<<s
+  EXPECT_FALSE(formatted);
+  EXPECT_FALSE(logger.enabled(log::Level::Info));
+  logger.set_level(log::Level::Off);
+  EXPECT_FALSE(logger.enabled(log::Level::Error));
+}
+
+TEST(LoggerTest, Write_DropsLinesWhenTheBufferIsFull) {
+  std::mutex gate;
+  std::unique_lock<std::mutex> held(gate);
+  std::atomic<int> delivered{0};
+  log::Logger logger(4, [&](const std::vector<log::Record> &batch) {
+    // Stalls the flusher until the test lets it go
+    std::lock_guard<std::mutex> wait(gate);
+    delivered += static_cast<int>(batch.size());
+  });
+
+  logger.write(log::Level::Info, "first");
+  // Keep writing until the flusher is stuck in the sink and the ring overflows
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    logger.write(log::Level::Info, "probe");
+    if (logger.dropped() > 0) {
+      break;
+    }
+  }
+  held.unlock();
+  logger.flush();
+
+  // Reaching here at all means no write waited on the stalled sink
+  EXPECT_GT(logger.dropped(), 0u);
+  // At most a full ring in the stalled batch and another behind it
+  EXPECT_LE(delivered.load(), 8);
+}
+
+TEST(LoggerTest, Write_IsSafeFromManyThreads) {
+  CapturingSink capture;
+  log::Logger logger(1 << 16, capture.sink());
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 1000; ++i) {
+        log::Line(logger, log::Level::Warning) << "thread " << t << " line " << i;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  logger.flush();
+
+  std::lock_guard<std::mutex> lock(capture.mutex);
+  EXPECT_EQ(capture.records.size() + logger.dropped(), 8000u);
+  EXPECT_EQ(logger.dropped(), 0u);
+  // Batched, not one sink call per line
+  EXPECT_LE(capture.batches, capture.records.size());
+}
+
+TEST(LoggerTest, Format_StampsUtcTimeAndLevel) {
+  log::Record record{log::Level::Warning,
+                     std::chrono::system_clock::time_point(std::chrono::milliseconds(1234)),
+                     "disk is slow"};
+  EXPECT_EQ(log::Logger::format(record), "1970-01-01T00:00:01.234Z WARNING disk is slow");
+}
+
+TEST(LoggerTest, Destructor_WritesWhatIsStillQueued) {
+  CapturingSink capture;
+  {
+    log::Logger logger(64, capture.sink());
+    logger.write(log::Level::Error, "last words");
+  }
+  ASSERT_EQ(capture.records.size(), 1u);
+  EXPECT_EQ(capture.records[0].message, "last words");
+}
+
+}  // namespace magic_tests
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "magic_core/types/lru_cache.hpp"
+
+namespace magic_tests {
+
+using magic_core::LruCache;
+
+TEST(LruCacheTest, GetReturnsStoredValue) {
+  LruCache<std::string, int> cache(4);
+  cache.put("a", 1);
+
+  auto value = cache.get("a");
+
+  ASSERT_TRUE(value.has_value());
+  EXPECT_EQ(*value, 1);
+  EXPECT_FALSE(cache.get("b").has_value());
+  EXPECT_EQ(cache.hits(), 1u);
+  EXPECT_EQ(cache.misses(), 1u);
+}
+
+TEST(LruCacheTest, EvictsLeastRecentlyUsed) {
+  LruCache<std::string, int> cache(2);
+  cache.put("a", 1);
+  cache.put("b", 2);
+  // Touching "a" leaves "b" as the oldest entry
+  cache.get("a");
+  cache.put("c", 3);
+
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_TRUE(cache.get("a").has_value());
+  EXPECT_FALSE(cache.get("b").has_value());
+  EXPECT_TRUE(cache.get("c").has_value());
+}
+
+TEST(LruCacheTest, PutReplacesExistingValue) {
+  LruCache<std::string, int> cache(2);
+  cache.put("a", 1);
+  cache.put("a", 2);
+
+  EXPECT_EQ(cache.size(), 1u);
+  EXPECT_EQ(*cache.get("a"), 2);
+}
+
+TEST(LruCacheTest, EraseAndClearRemoveEntries) {
+  LruCache<std::string, int> cache(4);
+  cache.put("a", 1);
+  cache.put("b", 2);
+
+  cache.erase("a");
+  EXPECT_FALSE(cache.get("a").has_value());
+  EXPECT_EQ(cache.size(), 1u);
+
+  cache.clear();
+  EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(LruCacheTest, ZeroCapacityStoresNothing) {
+  LruCache<std::string, int> cache(0);
+  cache.put("a", 1);
+
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_FALSE(cache.get("a").has_value());
+}
+
+TEST(LruCacheTest, ConcurrentUseStaysWithinCapacity) {
+  LruCache<int, int> cache(16);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, t] {
+      for (int i = 0; i < 1000; ++i) {
+        cache.put((i * 7 + t) % 64, i);
+        cache.get(i % 64);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_LE(cache.size(), 16u);
+  EXPECT_EQ(cache.hits() + cache.misses(), 4000u);
+}
+
+}  // namespace magic_tests
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "magic_core/async/memory_budget.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core::async;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Waits up to a second for at least waiters callers to queue on the budget
+bool wait_for_waiters(const MemoryBudget &budget, size_t waiters) {
+  auto deadline = std::chrono::steady_clock::now() + 1s;
+  while (budget.waiting() < waiters && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(1ms);
+  }
+  return budget.waiting() >= waiters;
+}
+
+}  // namespace
+
+TEST(MemoryBudgetTest, ReservationsReturnTheirBytesWhenReleased) {
+  MemoryBudget budget(100);
+  auto first = budget.reserve(60);
+  auto second = budget.reserve(40);
+  EXPECT_TRUE(first);
+  EXPECT_EQ(second.bytes(), 40u);
+  EXPECT_EQ(budget.reserved(), 100u);
+
+  MemoryBudget::Reservation moved = std::move(first);
+  EXPECT_FALSE(first);
+  EXPECT_EQ(budget.reserved(), 100u);
+  moved = MemoryBudget::Reservation();
+  EXPECT_EQ(budget.reserved(), 40u);
+}
+
+TEST(MemoryBudgetTest, WaitsUntilTheBytesFit) {
+  MemoryBudget budget(100);
+  auto held = budget.reserve(80);
+  std::atomic<bool> granted{false};
+
+  std::thread waiter([&] {
+    auto reservation = budget.reserve(50);
+    granted = true;
+  });
+  ASSERT_TRUE(wait_for_waiters(budget, 1));
+  EXPECT_FALSE(granted);
+
+  held = MemoryBudget::Reservation();
+  waiter.join();
+  EXPECT_TRUE(granted);
+  EXPECT_EQ(budget.reserved(), 0u);
+}
+
+TEST(MemoryBudgetTest, SmallReservationsQueueBehindAWaitingLargeOne) {
+  MemoryBudget budget(100);
+  auto held = budget.reserve(30);
+  std::atomic<bool> small_granted{false};
+
+  std::thread large([&] { auto reservation = budget.reserve(90); });
+  ASSERT_TRUE(wait_for_waiters(budget, 1));
+  // Would fit right away, but the large reservation came first
+  std::thread small([&] {
+    auto reservation = budget.reserve(10);
+    small_granted = true;
+  });
+  ASSERT_TRUE(wait_for_waiters(budget, 2));
+  std::this_thread::sleep_for(20ms);
+  EXPECT_FALSE(small_granted);
+
+  held = MemoryBudget::Reservation();
+  large.join();
+  small.join();
+  EXPECT_TRUE(small_granted);
+}
+
+TEST(MemoryBudgetTest, ReservationLargerThanTheBudgetRunsAlone) {
+  MemoryBudget budget(100);
+
+  auto huge = budget.reserve(1000);
+
+  EXPECT_EQ(huge.bytes(), 100u);
+  EXPECT_EQ(budget.reserved(), 100u);
+}
+
+TEST(MemoryBudgetTest, ThrowingWhileWaitingLeavesTheQueue) {
+  MemoryBudget budget(100);
+  auto held = budget.reserve(100);
+
+  EXPECT_THROW(budget.reserve(
+                   10, [] { throw std::runtime_error("lease lost"); }, 1ms),
+               std::runtime_error);
+
+  EXPECT_EQ(budget.waiting(), 0u);
+  held = MemoryBudget::Reservation();
+  EXPECT_EQ(budget.reserve(100).bytes(), 100u);
+}
+
+TEST(MemoryBudgetTest, RejectsAnEmptyBudget) {
+  EXPECT_THROW(MemoryBudget(0), std::invalid_argument);
+}
+
+}  // namespace magic_tests
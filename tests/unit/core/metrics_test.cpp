@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "magic_core/types/metrics.hpp"
+
+namespace magic_tests {
+
+namespace metrics = magic_core::metrics;
+
+TEST(MetricsTest, Histogram_CountsIntoCumulativeBuckets) {
+  metrics::Histogram histogram({1.0, 5.0});
+  histogram.observe(0.5);
+  histogram.observe(1.0);
+  histogram.observe(3.0);
+  histogram.observe(100.0);
+
+  const auto snapshot = histogram.snapshot();
+  ASSERT_EQ(snapshot.counts.size(), 2u);
+  // A value on a bound falls in that bound's bucket
+  EXPECT_EQ(snapshot.counts[0], 2u);
+  EXPECT_EQ(snapshot.counts[1], 3u);
+  EXPECT_EQ(snapshot.count, 4u);
+  EXPECT_DOUBLE_EQ(snapshot.sum, 104.5);
+
+  EXPECT_THROW(metrics::Histogram({2.0, 1.0}), std::invalid_argument);
+}
+
+TEST(MetricsTest, Counter_IsExactUnderContention) {
+  metrics::Counter counter;
+  metrics::Histogram histogram(metrics::size_buckets());
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 10000; ++i) {
+        counter.add();
+        histogram.observe(1.0);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(counter.value(), 80000u);
+  EXPECT_EQ(histogram.snapshot().count, 80000u);
+  EXPECT_DOUBLE_EQ(histogram.snapshot().sum, 80000.0);
+}
+
+TEST(MetricsTest, Registry_ReturnsTheSameMetricPerNameAndLabels) {
+  metrics::Registry registry;
+  auto &a = registry.counter("requests_total", "Requests", "route=\"a\"");
+  auto &b = registry.counter("requests_total", "Requests", "route=\"b\"");
+  EXPECT_EQ(&a, &registry.counter("requests_total", "Requests", "route=\"a\""));
+  EXPECT_NE(&a, &b);
+  EXPECT_THROW(registry.gauge("requests_total", "Requests"), std::invalid_argument);
+}
+
+TEST(MetricsTest, Registry_RendersPrometheusText) {
+  metrics::Registry registry;
+  registry.counter("jobs_total", "Jobs run").add(3);
+  registry.gauge("queue_depth", "Queued", "status=\"pending\"").set(7);
+  auto &latency = registry.histogram("latency_seconds", "Latency", {0.1, 1.0});
+  latency.observe(0.05);
+  latency.observe(2.0);
+
+  const std::string expected =
+      "# HELP jobs_total Jobs run\n"
+      "# TYPE jobs_total counter\n"
+      "jobs_total 3\n"
+      "# HELP latency_seconds Latency\n"
+      "# TYPE latency_seconds histogram\n"
+      "latency_seconds_bucket{le=\"0.1\"} 1\n"
+      "latency_seconds_bucket{le=\"1\"} 1\n"
+      "latency_seconds_bucket{le=\"+Inf\"} 2\n"
+      "latency_seconds_sum 2.05\n"
+      "latency_seconds_count 2\n"
+      "# HELP queue_depth Queued\n"
+      "# TYPE queue_depth gauge\n"
+      "queue_depth{status=\"pending\"} 7\n";
+  EXPECT_EQ(registry.render(), expected);
+}
+
+TEST(MetricsTest, ScopedTimer_ObservesOnceOnExit) {
+  metrics::Histogram histogram(metrics::latency_buckets());
+  {
+    metrics::ScopedTimer timer(histogram);
+  }
+  const auto snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count, 1u);
+  EXPECT_GE(snapshot.sum, 0.0);
+  EXPECT_LT(snapshot.sum, 10.0);
+}
+
+}  // namespace magic_tests
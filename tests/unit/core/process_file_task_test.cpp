@@ -1,14 +1,22 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <atomic>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include "magic_core/async/memory_budget.hpp"
 #include "magic_core/async/process_file_task.hpp"
 #include "magic_core/async/service_provider.hpp"
+#include "magic_core/db/embedding_cache.hpp"
+#include "magic_core/extractors/plaintext_extractor.hpp"
+#include "magic_core/services/compression_service.hpp"
 #include "../../common/mocks_test.hpp"
 #include "../../common/utilities_test.hpp"
 
@@ -21,6 +29,49 @@ using ::testing::ReturnRef;
 using ::testing::StrictMock;
 using ::testing::Throw;
 
+// Hands out one page of chunks per sink call, like the PDF extractor
+class StreamingExtractor : public ContentExtractor {
+ public:
+  explicit StreamingExtractor(std::vector<std::vector<std::string>> pages)
+      : pages_(std::move(pages)) {}
+
+  bool can_handle(const std::filesystem::path&) const override {
+    return true;
+  }
+  std::vector<Chunk> get_chunks(const std::filesystem::path& file_path) const override {
+    return extract_with_hash(file_path).chunks;
+  }
+  ExtractionResult extract_with_hash(const std::filesystem::path& file_path) const override {
+    ExtractionResult result;
+    stream_chunks(file_path, [&](std::vector<Chunk>& chunks, float) {
+      result.chunks.insert(result.chunks.end(), chunks.begin(), chunks.end());
+    });
+    return result;
+  }
+  bool streams_chunks() const override {
+    return true;
+  }
+  void stream_chunks(const std::filesystem::path&, const ChunkSink& sink) const override {
+    int index = 0;
+    for (size_t p = 0; p < pages_.size(); ++p) {
+      std::vector<Chunk> chunks;
+      for (const std::string& text : pages_[p]) {
+        chunks.push_back(Chunk{text, index++, {}});
+      }
+      if (before_page) {
+        before_page(p);
+      }
+      sink(chunks, static_cast<float>(p + 1) / pages_.size());
+    }
+  }
+
+  // Called before each page is handed out
+  std::function<void(size_t)> before_page;
+
+ private:
+  std::vector<std::vector<std::string>> pages_;
+};
+
 class ProcessFileTaskTest : public MetadataStoreTestBase {
  protected:
   void SetUp() override {
@@ -111,6 +162,28 @@ TEST_F(ProcessFileTaskTest, Execute_FileNotFoundInMetadata_ThrowsError) {
   EXPECT_EQ(progress_updates_[0].second, "Starting processing...");
 }
 
+TEST_F(ProcessFileTaskTest, Execute_FileQueuedAgainSinceClaimed_SkipsWithoutReadingIt) {
+  // Arrange - the task is claimed, then the file is saved and queued again
+  const std::string file_path = "/test/saved_twice.txt";
+  metadata_store_->upsert_file_stub(
+      TestUtilities::create_test_basic_file_metadata(file_path, "first_version"));
+  long long claimed_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", file_path);
+  ASSERT_EQ(task_queue_repo_->fetch_and_claim_tasks(1).size(), 1u);
+  long long newer_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", file_path);
+  ASSERT_NE(newer_id, claimed_id);
+  ProcessFileTask task = create_test_task(file_path, claimed_id);
+
+  // Act - the strict mocks fail the test if the file is extracted or embedded
+  task.execute(*service_provider_, progress_callback_);
+
+  // Assert
+  ASSERT_FALSE(progress_updates_.empty());
+  EXPECT_EQ(progress_updates_.back().first, 1.0f);
+  EXPECT_NE(progress_updates_.back().second.find("Superseded by task " + std::to_string(newer_id)),
+            std::string::npos);
+  EXPECT_FALSE(task_queue_repo_->find_superseding_task(newer_id).has_value());
+}
+
 TEST_F(ProcessFileTaskTest, Execute_SuccessfulProcessing_CompletesAllSteps) {
   // Arrange
   auto test_file_path = create_test_file("This is test content for processing.");
@@ -140,9 +213,9 @@ TEST_F(ProcessFileTaskTest, Execute_SuccessfulProcessing_CompletesAllSteps) {
       .WillOnce(Return(mock_extraction_result));
   
   std::vector<float> test_embedding = MockUtilities::create_test_embedding();
-  EXPECT_CALL(*mock_ollama_client_, get_embedding(_))
-      .Times(2) // one per chunk
-      .WillRepeatedly(Return(test_embedding));
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .Times(1) // both chunks fit in one batch
+      .WillOnce(MockUtilities::embed_each_with(test_embedding));
   
   // Act
   EXPECT_NO_THROW({
@@ -241,7 +314,7 @@ TEST_F(ProcessFileTaskTest, Execute_OllamaClientThrowsException_PropagatesError)
       .WillOnce(Return(mock_extraction_result));
   
   // Ollama client throws exception
-  EXPECT_CALL(*mock_ollama_client_, get_embedding(_))
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
       .Times(1)
       .WillOnce(Throw(std::runtime_error("Ollama service unavailable")));
   
@@ -282,9 +355,9 @@ TEST_F(ProcessFileTaskTest, Execute_EmptyEmbeddingFromOllama_ThrowsError) {
   
   // Return empty embedding
   std::vector<float> empty_embedding;
-  EXPECT_CALL(*mock_ollama_client_, get_embedding(_))
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
       .Times(1)
-      .WillOnce(Return(empty_embedding));
+      .WillOnce(Return(std::vector<std::vector<float>>{empty_embedding}));
   
   // Act & Assert
   EXPECT_THROW({
@@ -364,27 +437,426 @@ TEST_F(ProcessFileTaskTest, Execute_LargeNumberOfChunks_ProcessesInBatches) {
       .WillOnce(Return(mock_extraction_result));
   
   std::vector<float> test_embedding = MockUtilities::create_test_embedding();
-  EXPECT_CALL(*mock_ollama_client_, get_embedding(_))
-      .Times(100) // one per chunk
-      .WillRepeatedly(Return(test_embedding));
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .Times(2) // one request per batch of 64
+      .WillRepeatedly(MockUtilities::embed_each_with(test_embedding));
   
   // Act
   EXPECT_NO_THROW({
     task.execute(*service_provider_, progress_callback_);
   });
   
-  // Assert - Should have many progress updates for chunks
+  // Assert - one progress update per batch
   int chunk_progress_count = 0;
   for (const auto& update : progress_updates_) {
     if (update.second.find("Embedding chunk") != std::string::npos) {
       chunk_progress_count++;
     }
   }
-  EXPECT_EQ(chunk_progress_count, 100);
+  EXPECT_EQ(chunk_progress_count, 2);
   
   cleanup_test_file(test_file_path);
 }
 
+TEST_F(ProcessFileTaskTest, Execute_EmbeddingFailsMidPipeline_PropagatesError) {
+  // Arrange
+  auto test_file_path = create_test_file("Pipeline failure content");
+
+  BasicFileMetadata stub = TestUtilities::create_test_basic_file_metadata(
+      test_file_path.string(),
+      "pipeline_hash",
+      FileType::Text,
+      static_cast<size_t>(std::filesystem::file_size(test_file_path)),
+      ProcessingStatus::QUEUED);
+  metadata_store_->upsert_file_stub(stub);
+
+  ProcessFileTask task = create_test_task(test_file_path.string());
+
+  // Four batches, so several stages are busy when the failure happens
+  ExtractionResult mock_extraction_result;
+  mock_extraction_result.content_hash = "pipeline_hash";
+  mock_extraction_result.chunks = MockUtilities::create_test_chunks(256, "Test chunk");
+
+  EXPECT_CALL(*mock_content_extractor_factory_, get_extractor_for(_))
+      .Times(1)
+      .WillOnce(ReturnRef(*mock_content_extractor_));
+
+  EXPECT_CALL(*mock_content_extractor_, extract_with_hash(_))
+      .Times(1)
+      .WillOnce(Return(mock_extraction_result));
+
+  std::vector<float> test_embedding = MockUtilities::create_test_embedding();
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .Times(::testing::Between(1, 4))
+      .WillOnce(MockUtilities::embed_each_with(test_embedding))
+      .WillRepeatedly(Throw(std::runtime_error("Ollama went away")));
+
+  // Act & Assert - the error surfaces on the calling thread and no stage is left hanging
+  EXPECT_THROW({
+    task.execute(*service_provider_, progress_callback_);
+  }, std::runtime_error);
+
+  cleanup_test_file(test_file_path);
+}
+
+TEST_F(ProcessFileTaskTest, Execute_WithEmbeddingCache_EmbedsOnlyChangedChunks) {
+  // Arrange
+  auto test_file_path = create_test_file("Cached content");
+  BasicFileMetadata stub = TestUtilities::create_test_basic_file_metadata(
+      test_file_path.string(), "cache_hash", FileType::Text,
+      static_cast<size_t>(std::filesystem::file_size(test_file_path)), ProcessingStatus::QUEUED);
+  metadata_store_->upsert_file_stub(stub);
+
+  auto cache = std::make_shared<EmbeddingCache>(*db_manager_, "mxbai-embed-large");
+  auto cached_services = std::make_shared<ServiceProvider>(
+      metadata_store_, task_queue_repo_, mock_ollama_client_, mock_content_extractor_factory_,
+      cache);
+
+  ExtractionResult first_version;
+  first_version.content_hash = "cache_hash";
+  first_version.chunks = MockUtilities::create_test_chunks(3, "Cached chunk");
+  ExtractionResult second_version = first_version;
+  second_version.chunks[1].content = "An edited chunk";
+
+  EXPECT_CALL(*mock_content_extractor_factory_, get_extractor_for(_))
+      .Times(2)
+      .WillRepeatedly(ReturnRef(*mock_content_extractor_));
+  EXPECT_CALL(*mock_content_extractor_, extract_with_hash(_))
+      .WillOnce(Return(first_version))
+      .WillOnce(Return(second_version));
+
+  std::vector<float> test_embedding = MockUtilities::create_test_embedding();
+  std::vector<std::vector<std::string>> embedded_texts;
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .Times(2)
+      .WillRepeatedly([&](const std::vector<std::string>& texts) {
+        embedded_texts.push_back(texts);
+        return std::vector<std::vector<float>>(texts.size(), test_embedding);
+      });
+
+  // Act - process the file, then again after one chunk changed
+  create_test_task(test_file_path.string()).execute(*cached_services, progress_callback_);
+  create_test_task(test_file_path.string()).execute(*cached_services, progress_callback_);
+
+  // Assert
+  ASSERT_EQ(embedded_texts.size(), 2);
+  EXPECT_EQ(embedded_texts[0].size(), 3);
+  EXPECT_EQ(embedded_texts[1], std::vector<std::string>{"An edited chunk"});
+  // The unchanged chunks keep their stored vectors and never reach the cache
+  EXPECT_EQ(cache->stats().memory_hits, 0);
+
+  cleanup_test_file(test_file_path);
+}
+
+TEST_F(ProcessFileTaskTest, Execute_WithNearDuplicateDetection_ReusesTemplatedChunkVectors) {
+  // Arrange - two files filled in from one template, the second with one chunk of its own
+  auto letter = [](const std::string& name, const std::string& date) {
+    return "Dear " + name + ", thank you for your order of " + date +
+           ". Your parcel has been packed and will leave our warehouse within two working "
+           "days. You can follow its progress with the tracking link in your account, and our "
+           "team is happy to help with any questions about delivery, returns or refunds.";
+  };
+  auto first_path = create_test_file("First letter");
+  auto second_path = create_test_file("Second letter");
+  for (const auto& [path, hash] : {std::pair{first_path, "first_hash"},
+                                   std::pair{second_path, "second_hash"}}) {
+    metadata_store_->upsert_file_stub(TestUtilities::create_test_basic_file_metadata(
+        path.string(), hash, FileType::Text,
+        static_cast<size_t>(std::filesystem::file_size(path)), ProcessingStatus::QUEUED));
+  }
+
+  auto cache = std::make_shared<EmbeddingCache>(*db_manager_, "mxbai-embed-large",
+                                                EmbeddingCache::DEFAULT_MEMORY_ENTRIES,
+                                                /*near_duplicate_entries*/ 64);
+  auto cached_services = std::make_shared<ServiceProvider>(
+      metadata_store_, task_queue_repo_, mock_ollama_client_, mock_content_extractor_factory_,
+      cache);
+
+  ExtractionResult first;
+  first.content_hash = "first_hash";
+  first.chunks = {{letter("Alice", "12 March"), 0, {}}};
+  ExtractionResult second;
+  second.content_hash = "second_hash";
+  second.chunks = {{letter("Bob", "3 April"), 0, {}}, {"A postscript of its own", 1, {}}};
+
+  EXPECT_CALL(*mock_content_extractor_factory_, get_extractor_for(_))
+      .Times(2)
+      .WillRepeatedly(ReturnRef(*mock_content_extractor_));
+  EXPECT_CALL(*mock_content_extractor_, extract_with_hash(_))
+      .WillOnce(Return(first))
+      .WillOnce(Return(second));
+
+  std::vector<float> test_embedding = MockUtilities::create_test_embedding();
+  std::vector<std::vector<std::string>> embedded_texts;
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .Times(2)
+      .WillRepeatedly([&](const std::vector<std::string>& texts) {
+        embedded_texts.push_back(texts);
+        return std::vector<std::vector<float>>(texts.size(), test_embedding);
+      });
+
+  // Act
+  create_test_task(first_path.string()).execute(*cached_services, progress_callback_);
+  create_test_task(second_path.string()).execute(*cached_services, progress_callback_);
+
+  // Assert - Bob's letter takes the vector of Alice's and keeps its own text
+  ASSERT_EQ(embedded_texts.size(), 2);
+  EXPECT_EQ(embedded_texts[1], std::vector<std::string>{"A postscript of its own"});
+  EXPECT_EQ(cache->stats().near_hits, 1);
+  auto second_id = metadata_store_->get_basic_file_metadata(second_path.string())->id;
+  auto stored = metadata_store_->get_stored_chunks(second_id);
+  ASSERT_EQ(stored.size(), 2);
+  EXPECT_EQ(stored[0].content_hash, EmbeddingCache::content_key(letter("Bob", "3 April")));
+
+  cleanup_test_file(first_path);
+  cleanup_test_file(second_path);
+}
+
+TEST_F(ProcessFileTaskTest, Execute_ModifiedFile_KeepsUnchangedChunkRows) {
+  // Arrange
+  auto test_file_path = create_test_file("Delta content");
+  BasicFileMetadata stub = TestUtilities::create_test_basic_file_metadata(
+      test_file_path.string(), "delta_hash", FileType::Text,
+      static_cast<size_t>(std::filesystem::file_size(test_file_path)), ProcessingStatus::QUEUED);
+  int file_id = metadata_store_->upsert_file_stub(stub);
+
+  ExtractionResult first_version;
+  first_version.content_hash = "delta_hash";
+  first_version.chunks = MockUtilities::create_test_chunks(4, "Delta chunk");
+  // Chunk 1 is edited and chunk 2 deleted, so chunk 3 moves up to index 2
+  ExtractionResult second_version;
+  second_version.content_hash = "delta_hash_2";
+  second_version.chunks = {first_version.chunks[0], first_version.chunks[1],
+                           first_version.chunks[3]};
+  second_version.chunks[1].content = "An edited chunk";
+  second_version.chunks[2].chunk_index = 2;
+
+  EXPECT_CALL(*mock_content_extractor_factory_, get_extractor_for(_))
+      .Times(2)
+      .WillRepeatedly(ReturnRef(*mock_content_extractor_));
+  EXPECT_CALL(*mock_content_extractor_, extract_with_hash(_))
+      .WillOnce(Return(first_version))
+      .WillOnce(Return(second_version));
+
+  std::vector<std::vector<std::string>> embedded_texts;
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .Times(2)
+      .WillRepeatedly([&](const std::vector<std::string>& texts) {
+        embedded_texts.push_back(texts);
+        return std::vector<std::vector<float>>(texts.size(),
+                                               MockUtilities::create_test_embedding());
+      });
+
+  // Act
+  create_test_task(test_file_path.string()).execute(*service_provider_, progress_callback_);
+  auto before = metadata_store_->get_stored_chunks(file_id);
+  create_test_task(test_file_path.string()).execute(*service_provider_, progress_callback_);
+  auto after = metadata_store_->get_stored_chunks(file_id);
+
+  // Assert - one embedding for the edit; the untouched rows survive under their ids
+  ASSERT_EQ(embedded_texts.size(), 2);
+  EXPECT_EQ(embedded_texts[1], std::vector<std::string>{"An edited chunk"});
+  ASSERT_EQ(before.size(), 4);
+  ASSERT_EQ(after.size(), 3);
+  EXPECT_EQ(after[0].id, before[0].id);
+  EXPECT_EQ(after[2].id, before[3].id);
+  EXPECT_EQ(after[2].chunk_index, 2);
+  EXPECT_NE(after[1].id, before[1].id);
+  EXPECT_NE(after[1].id, before[2].id);
+  EXPECT_EQ(metadata_store_->get_file_metadata(file_id)->processing_status,
+            ProcessingStatus::PROCESSED);
+
+  cleanup_test_file(test_file_path);
+}
+
+TEST_F(ProcessFileTaskTest, Execute_ManyBatches_RecycledSlotsStoreEachChunkOnce) {
+  // Arrange - eight batches of 64 and a partial one, so later batches refill the slots of
+  // written ones
+  auto test_file_path = create_test_file("Recycled content");
+  BasicFileMetadata stub = TestUtilities::create_test_basic_file_metadata(
+      test_file_path.string(), "recycled_hash", FileType::Text,
+      static_cast<size_t>(std::filesystem::file_size(test_file_path)), ProcessingStatus::QUEUED);
+  int file_id = metadata_store_->upsert_file_stub(stub);
+
+  const int chunk_count = 8 * 64 + 5;
+  ExtractionResult extraction;
+  extraction.content_hash = "recycled_hash";
+  extraction.chunks = MockUtilities::create_test_chunks(chunk_count, "Recycled chunk");
+
+  EXPECT_CALL(*mock_content_extractor_factory_, get_extractor_for(_))
+      .WillOnce(ReturnRef(*mock_content_extractor_));
+  EXPECT_CALL(*mock_content_extractor_, extract_with_hash(_)).WillOnce(Return(extraction));
+  std::mutex texts_mutex;
+  size_t embedded = 0;
+  bool all_texts_present = true;
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .WillRepeatedly([&](const std::vector<std::string>& texts) {
+        std::lock_guard<std::mutex> lock(texts_mutex);
+        embedded += texts.size();
+        for (const auto& text : texts) {
+          all_texts_present = all_texts_present && text.rfind("Recycled chunk ", 0) == 0;
+        }
+        return std::vector<std::vector<float>>(texts.size(),
+                                               MockUtilities::create_test_embedding());
+      });
+
+  // Act
+  create_test_task(test_file_path.string()).execute(*service_provider_, progress_callback_);
+
+  // Assert - every chunk went out once and its row holds its own content and hash
+  EXPECT_EQ(embedded, static_cast<size_t>(chunk_count));
+  EXPECT_TRUE(all_texts_present);
+  auto stored = metadata_store_->get_stored_chunks(file_id);
+  ASSERT_EQ(stored.size(), static_cast<size_t>(chunk_count));
+  for (const auto& row : metadata_store_->get_chunk_metadata({file_id})) {
+    const std::string expected = "Recycled chunk " + std::to_string(row.chunk_index);
+    EXPECT_EQ(CompressionService::decompress(row.content), expected);
+    EXPECT_EQ(stored[row.chunk_index].content_hash, EmbeddingCache::content_key(expected));
+    EXPECT_FALSE(stored[row.chunk_index].vector_embedding.empty());
+  }
+
+  cleanup_test_file(test_file_path);
+}
+
+TEST_F(ProcessFileTaskTest, Execute_StreamingExtractor_EmbedsBeforeExtractionFinishes) {
+  // Arrange - three pages of a full batch each
+  auto test_file_path = create_test_file("Streamed content");
+  BasicFileMetadata stub = TestUtilities::create_test_basic_file_metadata(
+      test_file_path.string(), "stream_hash", FileType::PDF,
+      static_cast<size_t>(std::filesystem::file_size(test_file_path)), ProcessingStatus::QUEUED);
+  int file_id = metadata_store_->upsert_file_stub(stub);
+
+  std::vector<std::vector<std::string>> pages(3);
+  for (size_t p = 0; p < pages.size(); ++p) {
+    for (int c = 0; c < 64; ++c) {
+      pages[p].push_back("Page " + std::to_string(p) + " chunk " + std::to_string(c));
+    }
+  }
+  StreamingExtractor extractor(pages);
+  std::atomic<int> embed_calls{0};
+  bool embedded_before_last_page = false;
+  extractor.before_page = [&](size_t page) {
+    if (page + 1 != pages.size()) {
+      return;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (embed_calls == 0 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    embedded_before_last_page = embed_calls > 0;
+  };
+
+  EXPECT_CALL(*mock_content_extractor_factory_, get_extractor_for(_))
+      .WillOnce(ReturnRef(extractor));
+  std::vector<float> test_embedding = MockUtilities::create_test_embedding();
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .Times(3)
+      .WillRepeatedly([&](const std::vector<std::string>& texts) {
+        ++embed_calls;
+        return std::vector<std::vector<float>>(texts.size(), test_embedding);
+      });
+
+  // Act
+  create_test_task(test_file_path.string()).execute(*service_provider_, progress_callback_);
+
+  // Assert - the first page was being embedded while the last was still to come
+  EXPECT_TRUE(embedded_before_last_page);
+  auto stored = metadata_store_->get_stored_chunks(file_id);
+  ASSERT_EQ(stored.size(), 192u);
+  EXPECT_EQ(stored.back().chunk_index, 191);
+  EXPECT_EQ(metadata_store_->get_file_metadata(file_id)->processing_status,
+            ProcessingStatus::PROCESSED);
+  EXPECT_EQ(metadata_store_->get_file_summary_vector(file_id).size(), test_embedding.size());
+  EXPECT_EQ(progress_updates_.back().second, "Processing complete.");
+
+  cleanup_test_file(test_file_path);
+}
+
+TEST_F(ProcessFileTaskTest, Execute_StreamingExtractor_KeepsUnchangedChunkRows) {
+  // Arrange
+  auto test_file_path = create_test_file("Streamed delta");
+  BasicFileMetadata stub = TestUtilities::create_test_basic_file_metadata(
+      test_file_path.string(), "stream_delta_hash", FileType::PDF,
+      static_cast<size_t>(std::filesystem::file_size(test_file_path)), ProcessingStatus::QUEUED);
+  int file_id = metadata_store_->upsert_file_stub(stub);
+
+  StreamingExtractor first_version({{"Intro page"}, {"Middle page"}, {"Last page"}});
+  // The middle page is edited and the last one removed
+  StreamingExtractor second_version({{"Intro page"}, {"An edited page"}});
+  EXPECT_CALL(*mock_content_extractor_factory_, get_extractor_for(_))
+      .WillOnce(ReturnRef(first_version))
+      .WillOnce(ReturnRef(second_version));
+
+  std::vector<std::vector<std::string>> embedded_texts;
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .Times(2)
+      .WillRepeatedly([&](const std::vector<std::string>& texts) {
+        embedded_texts.push_back(texts);
+        return std::vector<std::vector<float>>(texts.size(),
+                                               MockUtilities::create_test_embedding());
+      });
+
+  // Act
+  create_test_task(test_file_path.string()).execute(*service_provider_, progress_callback_);
+  auto before = metadata_store_->get_stored_chunks(file_id);
+  create_test_task(test_file_path.string()).execute(*service_provider_, progress_callback_);
+  auto after = metadata_store_->get_stored_chunks(file_id);
+
+  // Assert
+  ASSERT_EQ(embedded_texts.size(), 2);
+  EXPECT_EQ(embedded_texts[1], std::vector<std::string>{"An edited page"});
+  ASSERT_EQ(before.size(), 3);
+  ASSERT_EQ(after.size(), 2);
+  EXPECT_EQ(after[0].id, before[0].id);
+  EXPECT_EQ(after[1].chunk_index, 1);
+  EXPECT_EQ(metadata_store_->get_file_metadata(file_id)->processing_status,
+            ProcessingStatus::PROCESSED);
+
+  cleanup_test_file(test_file_path);
+}
+
+TEST_F(ProcessFileTaskTest, Execute_FileTooLargeForMemoryBudget_StreamsTheSameChunks) {
+  // Arrange - a budget a quarter of which is less than the file chunked whole
+  std::string content;
+  for (int i = 0; i < 40; ++i) {
+    content += "Paragraph " + std::to_string(i) + " of a document too large to hold at once, "
+               "padded so that a few of them make a chunk.\n\n";
+  }
+  auto test_file_path = create_test_file(content);
+  BasicFileMetadata stub = TestUtilities::create_test_basic_file_metadata(
+      test_file_path.string(), "budget_hash", FileType::Text, content.size(),
+      ProcessingStatus::QUEUED);
+  int file_id = metadata_store_->upsert_file_stub(stub);
+  auto budget = std::make_shared<async::MemoryBudget>(content.size());
+  service_provider_->set_memory_budget(budget);
+  PlainTextExtractor extractor;
+  EXPECT_CALL(*mock_content_extractor_factory_, get_extractor_for(_))
+      .WillOnce(ReturnRef(extractor));
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .WillRepeatedly(MockUtilities::embed_each_with(MockUtilities::create_test_embedding()));
+
+  // Act
+  create_test_task(test_file_path.string()).execute(*service_provider_, progress_callback_);
+
+  // Assert - streamed, yet chunked exactly as a whole read would be, and the memory is back
+  bool streamed = false;
+  for (const auto& [progress, message] : progress_updates_) {
+    streamed = streamed || message == "Extracting content while it is embedded.";
+  }
+  EXPECT_TRUE(streamed);
+  auto expected = extractor.extract_with_hash(test_file_path).chunks;
+  auto stored = metadata_store_->get_stored_chunks(file_id);
+  ASSERT_EQ(stored.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(stored[i].content_hash, EmbeddingCache::content_key(expected[i].content));
+  }
+  EXPECT_EQ(budget->reserved(), 0u);
+  EXPECT_EQ(metadata_store_->get_file_metadata(file_id)->processing_status,
+            ProcessingStatus::PROCESSED);
+
+  cleanup_test_file(test_file_path);
+}
+
 TEST_F(ProcessFileTaskTest, GetType_ReturnsCorrectType) {
   // Arrange
   ProcessFileTask task = create_test_task("/test/file.txt");
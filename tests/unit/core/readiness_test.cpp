@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "magic_core/async/readiness.hpp"
+
+namespace magic_tests {
+
+using magic_core::async::Readiness;
+using namespace std::chrono_literals;
+
+TEST(ReadinessTest, StartsWarmingAndReportsTheStage) {
+  Readiness readiness;
+  EXPECT_FALSE(readiness.ready());
+  EXPECT_EQ(readiness.stage(), "starting");
+
+  readiness.set_stage("loading indexes");
+
+  EXPECT_EQ(readiness.stage(), "loading indexes");
+  EXPECT_FALSE(readiness.ready());
+}
+
+TEST(ReadinessTest, ReadyKeepsHowLongTheWarmUpTook) {
+  Readiness readiness;
+  readiness.set_stage("loading indexes");
+  std::this_thread::sleep_for(5ms);
+
+  readiness.mark_ready();
+  const auto took = readiness.warming_for();
+  std::this_thread::sleep_for(5ms);
+
+  EXPECT_TRUE(readiness.ready());
+  EXPECT_TRUE(readiness.stage().empty());
+  EXPECT_GE(took, 5ms);
+  EXPECT_EQ(readiness.warming_for(), took);
+}
+
+}  // namespace magic_tests
@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "magic_core/async/reembed_task.hpp"
+#include "magic_core/async/service_provider.hpp"
+#include "magic_core/db/embedding_cache.hpp"
+#include "magic_core/db/embedding_model_registry.hpp"
+#include "magic_core/llm/fake_embedding_client.hpp"
+#include "magic_core/services/compression_service.hpp"
+#include "../../common/utilities_test.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core;
+
+class ReembedTaskTest : public MetadataStoreTestBase {
+ protected:
+  static constexpr int TARGET_DIMENSION = 384;
+
+  void SetUp() override {
+    MetadataStoreTestBase::SetUp();
+    old_client_ = std::make_shared<FakeEmbeddingClient>();
+    FakeEmbeddingOptions target_options;
+    target_options.dimension = TARGET_DIMENSION;
+    target_client_ = std::make_shared<FakeEmbeddingClient>(target_options);
+    EmbeddingModelRegistry registry(*db_manager_);
+    registry.ensure_active("old-model", MetadataStore::DEFAULT_VECTOR_DIMENSION);
+    registry.register_model("new-model", TARGET_DIMENSION);
+    reopen_store();
+  }
+
+  void TearDown() override {
+    services_.reset();
+    MetadataStoreTestBase::TearDown();
+  }
+
+  // The store opens the active model's vectors, so it is reopened after registering one
+  void reopen_store() {
+    services_.reset();
+    metadata_store_.reset();
+    metadata_store_ = std::make_shared<MetadataStore>(*db_manager_);
+    services_ = std::make_shared<ServiceProvider>(metadata_store_, task_queue_repo_, old_client_,
+                                                  nullptr);
+    EmbeddingModelHooks hooks;
+    hooks.client_for = [this](const std::string &) { return target_client_; };
+    hooks.activate = [this](const std::string &model, std::shared_ptr<OllamaClient>) {
+      activated_.push_back(model);
+    };
+    services_->set_embedding_model_hooks(std::move(hooks));
+  }
+
+  // A processed file whose chunks and summary are embedded with the old model
+  int add_file(const std::string &path, const std::vector<std::string> &texts) {
+    int file_id = metadata_store_->upsert_file_stub(
+        TestUtilities::create_test_basic_file_metadata(path, "hash_" + path));
+    std::vector<ProcessedChunk> chunks;
+    for (size_t i = 0; i < texts.size(); ++i) {
+      Chunk chunk{texts[i], static_cast<int>(i), old_client_->embed(texts[i])};
+      chunks.push_back({chunk, CompressionService::compress(texts[i]), ""});
+    }
+    metadata_store_->upsert_chunk_metadata(file_id, chunks);
+    metadata_store_->update_file_ai_analysis(file_id, old_client_->embed(texts.front()));
+    return file_id;
+  }
+
+  ReembedTask create_task(const std::string &model = "new-model") {
+    auto now = std::chrono::system_clock::now();
+    return ReembedTask(1, TaskStatus::PROCESSING, now, now, std::nullopt, model);
+  }
+
+  std::shared_ptr<FakeEmbeddingClient> old_client_;
+  std::shared_ptr<FakeEmbeddingClient> target_client_;
+  std::shared_ptr<ServiceProvider> services_;
+  std::vector<std::string> activated_;
+  ProgressUpdater no_progress_ = [](float, const std::string &) {};
+};
+
+TEST_F(ReembedTaskTest, Execute_SwitchesVectorsAndIndexesToTheTargetModel) {
+  int apples = add_file("/tmp/apples.txt", {"apples and pears", "orchard harvest season"});
+  int rockets = add_file("/tmp/rockets.txt", {"rocket engines burn fuel"});
+
+  create_task().execute(*services_, no_progress_);
+
+  EXPECT_EQ(metadata_store_->embedding_model(), "new-model");
+  EXPECT_EQ(metadata_store_->dimension(), TARGET_DIMENSION);
+  EXPECT_EQ(EmbeddingModelRegistry(*db_manager_).active()->name, "new-model");
+  EXPECT_EQ(activated_, std::vector<std::string>{"new-model"});
+  // Only chunk content was embedded, once per chunk
+  EXPECT_EQ(target_client_->texts(), 3u);
+
+  auto chunk_hits = metadata_store_->search_similar_chunks(
+      {apples, rockets}, target_client_->embed("rocket engines burn fuel"), 1);
+  ASSERT_EQ(chunk_hits.size(), 1u);
+  EXPECT_EQ(chunk_hits[0].file_id, rockets);
+  auto file_hits =
+      metadata_store_->search_similar_files(target_client_->embed("apples and pears"), 1);
+  ASSERT_EQ(file_hits.size(), 1u);
+  EXPECT_EQ(file_hits[0].id, apples);
+  EXPECT_EQ(metadata_store_->get_file_summary_vector(apples).size(),
+            static_cast<size_t>(TARGET_DIMENSION));
+}
+
+TEST_F(ReembedTaskTest, InstallReplacement_CatchesUpWithWritesMadeDuringTheRun) {
+  int kept = add_file("/tmp/kept.txt", {"kept chunk"});
+  int removed = add_file("/tmp/removed.txt", {"removed chunk"});
+  auto replacement = metadata_store_->begin_replacement("new-model");
+  ReplacementWork work = metadata_store_->pending_replacement(*replacement);
+  ASSERT_EQ(work.chunk_ids.size(), 2u);
+  std::vector<int64_t> ids;
+  std::vector<std::vector<float>> vectors;
+  for (const auto &[id, content] : metadata_store_->get_chunk_contents(work.chunk_ids)) {
+    ids.push_back(id);
+    vectors.push_back(target_client_->embed(CompressionService::decompress(content)));
+  }
+  metadata_store_->add_replacement_chunks(*replacement, ids, vectors);
+  metadata_store_->add_replacement_summaries(*replacement, work.file_ids);
+  EXPECT_TRUE(metadata_store_->pending_replacement(*replacement).empty());
+
+  // Written while the replacement was being built; searches still use the old model
+  int added = add_file("/tmp/added.txt", {"added late"});
+  metadata_store_->delete_file_metadata("/tmp/removed.txt");
+  EXPECT_EQ(metadata_store_->dimension(), MetadataStore::DEFAULT_VECTOR_DIMENSION);
+
+  ReplacementWork late;
+  metadata_store_->install_replacement(*replacement, [&](const ReplacementWork &pending) {
+    late = pending;
+    std::vector<std::vector<float>> late_vectors;
+    for (size_t i = 0; i < pending.chunk_ids.size(); ++i) {
+      late_vectors.push_back(target_client_->embed("added late"));
+    }
+    metadata_store_->add_replacement_chunks(*replacement, pending.chunk_ids, late_vectors);
+    metadata_store_->add_replacement_summaries(*replacement, pending.file_ids);
+  });
+
+  EXPECT_EQ(late.chunk_ids.size(), 1u);
+  EXPECT_EQ(late.file_ids, std::vector<int>{added});
+  EXPECT_EQ(metadata_store_->dimension(), TARGET_DIMENSION);
+  auto hits = metadata_store_->search_similar_files(target_client_->embed("added late"), 3);
+  ASSERT_EQ(hits.size(), 2u);
+  EXPECT_EQ(hits[0].id, added);
+  EXPECT_EQ(hits[1].id, kept);
+  EXPECT_FALSE(metadata_store_->get_file_metadata(removed).has_value());
+}
+
+TEST_F(ReembedTaskTest, InstalledVectorsSurviveARestart) {
+  int file_id = add_file("/tmp/restart.txt", {"persisted after the swap"});
+  create_task().execute(*services_, no_progress_);
+
+  services_.reset();
+  metadata_store_.reset();
+  db_manager_->shutdown();
+  db_manager_->initialize(temp_db_path_, "magic_folder_test_key", /*pool_size*/ 1);
+  reopen_store();
+
+  EXPECT_EQ(metadata_store_->dimension(), TARGET_DIMENSION);
+  auto hits =
+      metadata_store_->search_similar_files(target_client_->embed("persisted after the swap"), 1);
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].id, file_id);
+}
+
+TEST_F(ReembedTaskTest, AbandonedReplacementIsDiscardedOnRestart) {
+  int file_id = add_file("/tmp/abandoned.txt", {"old vectors stay"});
+  {
+    auto replacement = metadata_store_->begin_replacement("new-model");
+    ReplacementWork work = metadata_store_->pending_replacement(*replacement);
+    metadata_store_->add_replacement_chunks(
+        *replacement, work.chunk_ids,
+        std::vector<std::vector<float>>(work.chunk_ids.size(),
+                                        target_client_->embed("old vectors stay")));
+    // Stopped before install_replacement()
+  }
+
+  services_.reset();
+  metadata_store_.reset();
+  db_manager_->shutdown();
+  db_manager_->initialize(temp_db_path_, "magic_folder_test_key", /*pool_size*/ 1);
+  reopen_store();
+
+  EXPECT_EQ(metadata_store_->embedding_model(), "old-model");
+  EXPECT_EQ(metadata_store_->dimension(), MetadataStore::DEFAULT_VECTOR_DIMENSION);
+  const auto chunks_segment = DatabaseManager::vector_store_path(temp_db_path_, "chunks");
+  EXPECT_FALSE(std::filesystem::exists(VectorStore::compacted_path(chunks_segment)));
+  auto hits = metadata_store_->search_similar_files(old_client_->embed("old vectors stay"), 1);
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].id, file_id);
+}
+
+TEST_F(ReembedTaskTest, Execute_WithoutAClientForTheModel_Throws) {
+  services_->set_embedding_model_hooks({});
+  add_file("/tmp/unhooked.txt", {"some text"});
+
+  EXPECT_THROW(create_task().execute(*services_, no_progress_), std::runtime_error);
+  EXPECT_EQ(metadata_store_->embedding_model(), "old-model");
+}
+
+TEST_F(ReembedTaskTest, Execute_UnregisteredModel_Throws) {
+  EXPECT_THROW(create_task("unregistered").execute(*services_, no_progress_),
+               MetadataStoreError);
+  EXPECT_TRUE(activated_.empty());
+}
+
+TEST_F(ReembedTaskTest, Execute_WithEmbeddingCache_ReusesVectorsOfARetriedRun) {
+  add_file("/tmp/cached.txt", {"first chunk", "second chunk"});
+  auto cache = std::make_shared<EmbeddingCache>(*db_manager_, "new-model");
+  cache->store({EmbeddingCache::content_key("first chunk")},
+               {target_client_->embed("first chunk")});
+  EmbeddingModelHooks hooks = services_->get_embedding_model_hooks();
+  hooks.cache_for = [cache](const std::string &) { return cache; };
+  services_->set_embedding_model_hooks(hooks);
+
+  create_task().execute(*services_, no_progress_);
+
+  EXPECT_EQ(target_client_->texts(), 1u);
+  EXPECT_EQ(metadata_store_->embedding_model(), "new-model");
+}
+
+}  // namespace magic_tests
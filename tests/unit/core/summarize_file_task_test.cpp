@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "magic_core/async/service_provider.hpp"
+#include "magic_core/async/summarize_file_task.hpp"
+#include "magic_core/llm/fake_embedding_client.hpp"
+#include "magic_core/services/compression_service.hpp"
+#include "../../common/utilities_test.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core;
+
+namespace {
+
+// Answers every prompt with reply, after delay, and remembers what it was asked
+class ScriptedGenerationClient : public FakeEmbeddingClient {
+ public:
+  std::string generate(const std::string &prompt, bool json_output) override {
+    prompts.push_back(prompt);
+    json_requested = json_output;
+    std::this_thread::sleep_for(delay);
+    return reply;
+  }
+
+  std::string reply;
+  std::chrono::milliseconds delay{0};
+  std::vector<std::string> prompts;
+  bool json_requested = false;
+};
+
+}  // namespace
+
+class SummarizeFileTaskTest : public MetadataStoreTestBase {
+ protected:
+  void SetUp() override {
+    MetadataStoreTestBase::SetUp();
+    embedding_client_ = std::make_shared<FakeEmbeddingClient>();
+    generation_client_ = std::make_shared<ScriptedGenerationClient>();
+    generation_client_->reply =
+        R"({"summary": "Sales rose in the third quarter.", "category": "report",)"
+        R"( "filename": "q3-sales-report.txt"})";
+    services_ = std::make_shared<ServiceProvider>(metadata_store_, task_queue_repo_,
+                                                  embedding_client_, nullptr);
+    GenerationSettings generation;
+    generation.client = generation_client_;
+    services_->set_generation_settings(std::move(generation));
+  }
+
+  void TearDown() override {
+    services_.reset();
+    MetadataStoreTestBase::TearDown();
+  }
+
+  // An embedded file whose chunks hold texts
+  int add_file(const std::string &path,
+               const std::string &content_hash,
+               const std::vector<std::string> &texts) {
+    int file_id = metadata_store_->upsert_file_stub(
+        TestUtilities::create_test_basic_file_metadata(path, content_hash));
+    std::vector<ProcessedChunk> chunks;
+    for (size_t i = 0; i < texts.size(); ++i) {
+      Chunk chunk{texts[i], static_cast<int>(i), embedding_client_->embed(texts[i])};
+      chunks.push_back({chunk, CompressionService::compress(texts[i]), ""});
+    }
+    metadata_store_->upsert_chunk_metadata(file_id, chunks);
+    metadata_store_->update_file_ai_analysis(file_id, embedding_client_->embed(texts.front()));
+    return file_id;
+  }
+
+  SummarizeFileTask create_task(const std::string &path, const std::string &content_hash) {
+    auto now = std::chrono::system_clock::now();
+    return SummarizeFileTask(1, TaskStatus::PROCESSING, now, now, std::nullopt, path,
+                             content_hash);
+  }
+
+  std::shared_ptr<FakeEmbeddingClient> embedding_client_;
+  std::shared_ptr<ScriptedGenerationClient> generation_client_;
+  std::shared_ptr<ServiceProvider> services_;
+  ProgressUpdater no_progress_ = [](float, const std::string &) {};
+};
+
+TEST_F(SummarizeFileTaskTest, Execute_StoresTheModelsSuggestions) {
+  add_file("/tmp/report.txt", "hash_1", {"Third quarter sales", "rose by nine percent"});
+
+  create_task("/tmp/report.txt", "hash_1").execute(*services_, no_progress_);
+
+  ASSERT_EQ(generation_client_->prompts.size(), 1u);
+  EXPECT_TRUE(generation_client_->json_requested);
+  const std::string &prompt = generation_client_->prompts[0];
+  EXPECT_NE(prompt.find("report.txt"), std::string::npos);
+  EXPECT_NE(prompt.find("Third quarter sales\n\nrose by nine percent"), std::string::npos);
+
+  auto metadata = metadata_store_->get_file_metadata("/tmp/report.txt");
+  ASSERT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata->summary, "Sales rose in the third quarter.");
+  EXPECT_EQ(metadata->suggested_category, "report");
+  EXPECT_EQ(metadata->suggested_filename, "q3-sales-report.txt");
+  // The vectors and status are the embedding's, and stay as they were
+  EXPECT_EQ(metadata->processing_status, ProcessingStatus::PROCESSED);
+  EXPECT_FALSE(metadata->summary_vector_embedding.empty());
+}
+
+TEST_F(SummarizeFileTaskTest, Execute_OnlySendsMaxInputChars) {
+  add_file("/tmp/long.txt", "hash_1", {std::string(500, 'a'), std::string(500, 'b')});
+  GenerationSettings generation = services_->get_generation_settings();
+  generation.max_input_chars = 100;
+  services_->set_generation_settings(generation);
+
+  create_task("/tmp/long.txt", "hash_1").execute(*services_, no_progress_);
+
+  ASSERT_EQ(generation_client_->prompts.size(), 1u);
+  const std::string &prompt = generation_client_->prompts[0];
+  EXPECT_EQ(prompt.substr(prompt.size() - 101), "\n" + std::string(100, 'a'));
+}
+
+TEST_F(SummarizeFileTaskTest, Execute_FileChangedSinceQueued_SkipsTheModel) {
+  add_file("/tmp/report.txt", "hash_2", {"Third quarter sales"});
+
+  create_task("/tmp/report.txt", "hash_1").execute(*services_, no_progress_);
+
+  EXPECT_TRUE(generation_client_->prompts.empty());
+  auto metadata = metadata_store_->get_file_metadata("/tmp/report.txt");
+  ASSERT_TRUE(metadata.has_value());
+  EXPECT_TRUE(metadata->summary.empty());
+}
+
+TEST_F(SummarizeFileTaskTest, Execute_WithoutGenerationModel_Throws) {
+  add_file("/tmp/report.txt", "hash_1", {"Third quarter sales"});
+  services_->set_generation_settings({});
+
+  EXPECT_THROW(create_task("/tmp/report.txt", "hash_1").execute(*services_, no_progress_),
+               std::runtime_error);
+}
+
+TEST_F(SummarizeFileTaskTest, Execute_NewContentDropsTheSummary) {
+  add_file("/tmp/report.txt", "hash_1", {"Third quarter sales"});
+  create_task("/tmp/report.txt", "hash_1").execute(*services_, no_progress_);
+
+  // A new version resets what the generation lane wrote until its own task runs
+  metadata_store_->upsert_file_stub(
+      TestUtilities::create_test_basic_file_metadata("/tmp/report.txt", "hash_2"));
+
+  auto metadata = metadata_store_->get_file_metadata("/tmp/report.txt");
+  ASSERT_TRUE(metadata.has_value());
+  EXPECT_TRUE(metadata->summary.empty());
+  EXPECT_TRUE(metadata->suggested_category.empty());
+  EXPECT_FALSE(metadata_store_->update_file_suggestions(metadata->id, "hash_1", "stale", "", ""));
+}
+
+TEST_F(SummarizeFileTaskTest, Execute_WorkerStopping_GivesUpOnTheModel) {
+  add_file("/tmp/report.txt", "hash_1", {"Third quarter sales"});
+  generation_client_->delay = std::chrono::seconds(5);
+  std::atomic<bool> stop{true};
+  SummarizeFileTask task = create_task("/tmp/report.txt", "hash_1");
+  task.set_stop_flag(&stop);
+
+  auto started = std::chrono::steady_clock::now();
+  EXPECT_THROW(task.execute(*services_, no_progress_), TaskInterruptedError);
+
+  EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(2));
+  auto metadata = metadata_store_->get_file_metadata("/tmp/report.txt");
+  ASSERT_TRUE(metadata.has_value());
+  EXPECT_TRUE(metadata->summary.empty());
+}
+
+TEST_F(SummarizeFileTaskTest, ParseReply_KeepsNamesOutOfOtherDirectories) {
+  FileSuggestions suggestions = SummarizeFileTask::parse_reply(
+      R"({"summary": "  A summary.\n", "filename": "../../etc/passwd", "category": 7})");
+
+  EXPECT_EQ(suggestions.summary, "A summary.");
+  EXPECT_EQ(suggestions.filename, "passwd");
+  EXPECT_EQ(suggestions.category, "");
+}
+
+TEST_F(SummarizeFileTaskTest, ParseReply_RejectsAnythingButAnObject) {
+  EXPECT_THROW(SummarizeFileTask::parse_reply("Here is your summary"), std::runtime_error);
+  EXPECT_THROW(SummarizeFileTask::parse_reply(R"(["summary"])"), std::runtime_error);
+}
+
+TEST_F(SummarizeFileTaskTest, Queue_GoesToTheGenerationLaneWithTheContentHash) {
+  long long id = SummarizeFileTask::queue(*task_queue_repo_, "/tmp/report.txt", "hash_1");
+
+  EXPECT_TRUE(task_queue_repo_->fetch_and_claim_tasks(5, TaskLane::Any).empty());
+  auto claimed = task_queue_repo_->fetch_and_claim_tasks(5, TaskLane::Generation);
+  ASSERT_EQ(claimed.size(), 1u);
+  EXPECT_EQ(claimed[0].id, id);
+  EXPECT_EQ(claimed[0].task_type, "SUMMARIZE_FILE");
+  ASSERT_TRUE(claimed[0].target_tag.has_value());
+  EXPECT_EQ(*claimed[0].target_tag, "hash_1");
+}
+
+}  // namespace magic_tests
@@ -7,6 +7,8 @@
 
 #include "magic_core/async/task_factory.hpp"
 #include "magic_core/async/process_file_task.hpp"
+#include "magic_core/async/reembed_task.hpp"
+#include "magic_core/async/summarize_file_task.hpp"
 #include "magic_core/db/models/task_dto.hpp"
 
 namespace magic_tests {
@@ -73,6 +75,80 @@ TEST_F(TaskFactoryTest, CreateTask_ProcessFileTask_EmptyTargetPath) {
   EXPECT_EQ(process_task->get_file_path(), "");
 }
 
+TEST_F(TaskFactoryTest, CreateTask_ReembedTask_TakesTheModelFromTheTag) {
+  // Arrange
+  TaskDTO task_dto = create_test_task_dto("REEMBED");
+  task_dto.target_tag = "all-minilm";
+
+  // Act
+  ITaskPtr task = TaskFactory::create_task(task_dto);
+
+  // Assert
+  ASSERT_NE(task, nullptr);
+  EXPECT_STREQ(task->get_type(), "REEMBED");
+  auto* reembed_task = dynamic_cast<ReembedTask*>(task.get());
+  ASSERT_NE(reembed_task, nullptr);
+  EXPECT_EQ(reembed_task->get_model(), "all-minilm");
+}
+
+TEST_F(TaskFactoryTest, CreateTask_ReembedTask_MissingModel) {
+  // Arrange
+  TaskDTO task_dto = create_test_task_dto("REEMBED");
+  task_dto.target_tag = "";
+
+  // Act & Assert
+  EXPECT_THROW({ TaskFactory::create_task(task_dto); }, std::runtime_error);
+}
+
+TEST_F(TaskFactoryTest, CreateTask_SnapshotTask_TakesTheDestinationFromTheTag) {
+  // Arrange
+  TaskDTO task_dto = create_test_task_dto("SNAPSHOT");
+  task_dto.target_tag = "/backups/today";
+
+  // Act
+  ITaskPtr task = TaskFactory::create_task(task_dto);
+
+  // Assert
+  ASSERT_NE(task, nullptr);
+  EXPECT_STREQ(task->get_type(), "SNAPSHOT");
+  auto* snapshot_task = dynamic_cast<SnapshotTask*>(task.get());
+  ASSERT_NE(snapshot_task, nullptr);
+  EXPECT_EQ(snapshot_task->get_destination(), "/backups/today");
+}
+
+TEST_F(TaskFactoryTest, CreateTask_SnapshotTask_MissingDestination) {
+  // Arrange
+  TaskDTO task_dto = create_test_task_dto("SNAPSHOT");
+
+  // Act & Assert
+  EXPECT_THROW({ TaskFactory::create_task(task_dto); }, std::runtime_error);
+}
+
+TEST_F(TaskFactoryTest, CreateTask_SummarizeFileTask_TakesTheContentHashFromTheTag) {
+  // Arrange
+  TaskDTO task_dto = create_test_task_dto("SUMMARIZE_FILE", "/test/file.txt");
+  task_dto.target_tag = "abc123";
+
+  // Act
+  ITaskPtr task = TaskFactory::create_task(task_dto);
+
+  // Assert
+  ASSERT_NE(task, nullptr);
+  EXPECT_STREQ(task->get_type(), "SUMMARIZE_FILE");
+  auto* summarize_task = dynamic_cast<SummarizeFileTask*>(task.get());
+  ASSERT_NE(summarize_task, nullptr);
+  EXPECT_EQ(summarize_task->get_file_path(), "/test/file.txt");
+  EXPECT_EQ(summarize_task->get_content_hash(), "abc123");
+}
+
+TEST_F(TaskFactoryTest, CreateTask_SummarizeFileTask_MissingContentHash) {
+  // Arrange
+  TaskDTO task_dto = create_test_task_dto("SUMMARIZE_FILE", "/test/file.txt");
+
+  // Act & Assert
+  EXPECT_THROW({ TaskFactory::create_task(task_dto); }, std::runtime_error);
+}
+
 TEST_F(TaskFactoryTest, CreateTask_UnknownTaskType_ReturnsNull) {
   // Arrange
   TaskDTO task_dto = create_test_task_dto("UNKNOWN_TASK");
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "magic_core/types/trace.hpp"
+
+namespace magic_tests {
+
+namespace trace = magic_core::trace;
+
+TEST(TraceTest, Span_IsANoOpWithoutACurrentTrace) {
+  EXPECT_EQ(trace::current().trace, nullptr);
+  trace::Span span("untraced");
+  span.set_attribute("key", "value");
+  EXPECT_EQ(trace::current().trace, nullptr);
+}
+
+TEST(TraceTest, Span_NestsUnderTheCurrentSpan) {
+  trace::Trace request;
+  {
+    trace::Scope scope(request);
+    trace::Span outer("outer");
+    {
+      trace::Span inner("inner");
+      inner.set_attribute("rows", 3);
+    }
+  }
+  EXPECT_EQ(trace::current().trace, nullptr);
+
+  const auto spans = request.spans();
+  ASSERT_EQ(spans.size(), 2u);
+  // Recorded as they end, so the child comes first
+  EXPECT_EQ(spans[0].name, "inner");
+  EXPECT_EQ(spans[1].name, "outer");
+  EXPECT_EQ(spans[0].parent_span_id, spans[1].span_id);
+  EXPECT_EQ(spans[1].parent_span_id, 0u);
+  ASSERT_EQ(spans[0].attributes.size(), 1u);
+  EXPECT_EQ(spans[0].attributes[0].first, "rows");
+  EXPECT_EQ(spans[0].attributes[0].second, "3");
+  EXPECT_GE(spans[1].duration, spans[0].duration);
+}
+
+TEST(TraceTest, Scope_CarriesAContextToAnotherThread) {
+  trace::Trace request;
+  trace::Scope scope(request);
+  trace::Span parent("parent");
+  const trace::Context context = trace::current();
+  std::thread worker([context] {
+    trace::Scope inherited(context);
+    trace::Span child("child");
+  });
+  worker.join();
+
+  const auto spans = request.spans();
+  ASSERT_EQ(spans.size(), 1u);
+  EXPECT_EQ(spans[0].name, "child");
+  EXPECT_EQ(spans[0].parent_span_id, context.span_id);
+}
+
+TEST(TraceTest, ServerTiming_SumsSpansOfTheSameName) {
+  trace::Trace request;
+  request.record({"db", 1, 0, {}, std::chrono::microseconds(1500), {}});
+  request.record({"embed", 2, 0, {}, std::chrono::milliseconds(12), {}});
+  request.record({"db", 3, 0, {}, std::chrono::microseconds(500), {}});
+  EXPECT_EQ(request.server_timing(), "db;dur=2.000, embed;dur=12.000");
+}
+
+TEST(TraceTest, ParseTraceparent_AcceptsOnlyWellFormedHeaders) {
+  auto parent = trace::parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01");
+  ASSERT_TRUE(parent.has_value());
+  EXPECT_EQ(parent->trace_id, "4bf92f3577b34da6a3ce929d0e0e4736");
+  EXPECT_EQ(parent->span_id, 0x00f067aa0ba902b7u);
+
+  trace::Trace request(parent->trace_id, parent->span_id);
+  {
+    trace::Scope scope(request);
+    trace::Span span("root");
+  }
+  EXPECT_EQ(request.spans()[0].parent_span_id, parent->span_id);
+
+  EXPECT_FALSE(trace::parse_traceparent(""));
+  EXPECT_FALSE(trace::parse_traceparent("00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01"));
+  EXPECT_FALSE(trace::parse_traceparent("00-00000000000000000000000000000000-00f067aa0ba902b7-01"));
+  EXPECT_FALSE(trace::parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-0000000000000000-01"));
+  EXPECT_FALSE(trace::parse_traceparent("ff-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"));
+}
+
+TEST(TraceTest, ToOtlpJson_FollowsTheExportRequestShape) {
+  trace::Trace request("4bf92f3577b34da6a3ce929d0e0e4736");
+  request.record({"search.embed", 0x10, 0x20, std::chrono::system_clock::time_point(
+                                                  std::chrono::seconds(1)),
+                  std::chrono::milliseconds(2), {{"cached", "true"}}});
+
+  const auto json = nlohmann::json::parse(request.to_otlp_json("magic_api"));
+  const auto &resource_spans = json.at("resourceSpans").at(0);
+  EXPECT_EQ(resource_spans.at("resource").at("attributes").at(0).at("value").at("stringValue"),
+            "magic_api");
+  const auto &span = resource_spans.at("scopeSpans").at(0).at("spans").at(0);
+  EXPECT_EQ(span.at("traceId"), "4bf92f3577b34da6a3ce929d0e0e4736");
+  EXPECT_EQ(span.at("spanId"), "0000000000000010");
+  EXPECT_EQ(span.at("parentSpanId"), "0000000000000020");
+  EXPECT_EQ(span.at("startTimeUnixNano"), "1000000000");
+  EXPECT_EQ(span.at("endTimeUnixNano"), "1002000000");
+  EXPECT_EQ(span.at("attributes").at(0).at("key"), "cached");
+}
+
+TEST(TraceTest, FileExporter_AppendsOneLinePerTrace) {
+  const auto path = std::filesystem::temp_directory_path() / "magic_trace_test.jsonl";
+  std::filesystem::remove(path);
+  {
+    trace::FileExporter exporter(path.string(), "magic_api");
+    for (int i = 0; i < 3; ++i) {
+      trace::Trace request;
+      {
+        trace::Scope scope(request);
+        trace::Span span("http.request");
+      }
+      EXPECT_TRUE(exporter.export_trace(request));
+    }
+  }
+
+  std::ifstream in(path);
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(in, line);) {
+    lines.push_back(line);
+  }
+  ASSERT_EQ(lines.size(), 3u);
+  for (const auto &line : lines) {
+    EXPECT_NO_THROW(nlohmann::json::parse(line));
+  }
+  std::filesystem::remove(path);
+
+  EXPECT_THROW(trace::FileExporter("/nonexistent/dir/traces.jsonl", "magic_api"),
+               std::runtime_error);
+}
+
+}  // namespace magic_tests
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "magic_core/types/vector_math.hpp"
+
+namespace magic_tests {
+
+namespace vector_math = magic_core::vector_math;
+
+namespace {
+
+std::vector<float> random_vector(size_t n, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+  std::vector<float> v(n);
+  for (float &x : v) {
+    x = uniform(rng);
+  }
+  return v;
+}
+
+// Lengths around the 4-, 8- and 32-wide steps of the kernels, so every tail path runs
+const std::vector<size_t> LENGTHS = {0, 1, 3, 4, 7, 8, 9, 31, 32, 33, 100, 1023, 1024};
+
+}  // namespace
+
+TEST(VectorMathTest, KernelName_IsKnown) {
+  const std::string name = vector_math::kernel_name();
+  EXPECT_TRUE(name == "avx2" || name == "neon" || name == "scalar") << name;
+}
+
+TEST(VectorMathTest, Dot_MatchesDoublePrecision) {
+  for (size_t n : LENGTHS) {
+    auto a = random_vector(n, 1);
+    auto b = random_vector(n, 2);
+    double expected = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+      expected += static_cast<double>(a[i]) * b[i];
+    }
+    EXPECT_NEAR(vector_math::dot(a.data(), b.data(), n), expected, 1e-4) << "n=" << n;
+  }
+}
+
+TEST(VectorMathTest, DotRows_ScoresEveryRowLikeDot) {
+  for (size_t n : LENGTHS) {
+    const size_t count = 5;
+    auto query = random_vector(n, 5);
+    auto rows = random_vector(n * count, 6);
+    std::vector<float> out(count, -1.0f);
+    vector_math::dot_rows(query.data(), rows.data(), count, n, out.data());
+    for (size_t r = 0; r < count; ++r) {
+      EXPECT_EQ(out[r], vector_math::dot(query.data(), rows.data() + r * n, n))
+          << "n=" << n << " row=" << r;
+    }
+  }
+}
+
+TEST(VectorMathTest, DotRows_ModelDimensionsMatchDot) {
+  // The dimensions with kernels of their own
+  for (size_t n : {384u, 768u, 1024u}) {
+    const size_t count = 3;
+    auto query = random_vector(n, 7);
+    auto rows = random_vector(n * count, 8);
+    std::vector<float> out(count, -1.0f);
+    vector_math::dot_rows(query.data(), rows.data(), count, n, out.data());
+    for (size_t r = 0; r < count; ++r) {
+      EXPECT_EQ(out[r], vector_math::dot(query.data(), rows.data() + r * n, n))
+          << "n=" << n << " row=" << r;
+    }
+  }
+}
+
+TEST(VectorMathTest, AddAndScale_AreElementWise) {
+  for (size_t n : LENGTHS) {
+    auto acc = random_vector(n, 3);
+    auto x = random_vector(n, 4);
+    auto expected = acc;
+    for (size_t i = 0; i < n; ++i) {
+      expected[i] = (expected[i] + x[i]) * 0.5f;
+    }
+    vector_math::add(acc.data(), x.data(), n);
+    vector_math::scale(acc.data(), n, 0.5f);
+    EXPECT_EQ(acc, expected) << "n=" << n;
+  }
+}
+
+TEST(VectorMathTest, SumAndMean_CombineEveryVector) {
+  std::vector<std::vector<float>> vectors;
+  std::vector<const float *> pointers;
+  for (uint32_t seed = 0; seed < 5; ++seed) {
+    vectors.push_back(random_vector(1024, 10 + seed));
+  }
+  for (const auto &v : vectors) {
+    pointers.push_back(v.data());
+  }
+
+  std::vector<float> total(1024);
+  std::vector<float> average(1024);
+  vector_math::sum(pointers.data(), pointers.size(), 1024, total.data());
+  vector_math::mean(pointers.data(), pointers.size(), 1024, average.data());
+  for (size_t i = 0; i < 1024; ++i) {
+    float expected = 0.0f;
+    for (const auto &v : vectors) {
+      expected += v[i];
+    }
+    EXPECT_FLOAT_EQ(total[i], expected);
+    EXPECT_NEAR(average[i], expected / 5.0f, 1e-6f);
+  }
+
+  // No vectors sum to zero
+  std::vector<float> empty(8, 3.0f);
+  vector_math::mean(pointers.data(), 0, empty.size(), empty.data());
+  EXPECT_EQ(empty, std::vector<float>(8, 0.0f));
+}
+
+TEST(VectorMathTest, Normalize_GivesUnitLength) {
+  for (size_t n : LENGTHS) {
+    if (n == 0) {
+      continue;
+    }
+    auto v = random_vector(n, 5);
+    auto original = v;
+    const float length = vector_math::normalize(v);
+    double squares = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+      squares += static_cast<double>(v[i]) * v[i];
+      EXPECT_NEAR(v[i] * length, original[i], 1e-5f);
+    }
+    EXPECT_NEAR(squares, 1.0, 1e-5) << "n=" << n;
+  }
+
+  std::vector<float> zeros(16, 0.0f);
+  EXPECT_EQ(vector_math::normalize(zeros), 0.0f);
+  EXPECT_EQ(zeros, std::vector<float>(16, 0.0f));
+}
+
+}  // namespace magic_tests
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "magic_core/async/work_signal.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core::async;
+
+TEST(WorkSignalTest, WaitReturnsImmediatelyIfNotifiedSinceSeen) {
+  WorkSignal signal;
+  const uint64_t seen = signal.generation();
+  signal.notify_one();
+
+  auto started = std::chrono::steady_clock::now();
+  signal.wait_for(seen, std::chrono::seconds(5), [] { return false; });
+
+  EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(1));
+}
+
+TEST(WorkSignalTest, NotifyWakesWaiter) {
+  WorkSignal signal;
+  std::atomic<bool> woke{false};
+  std::thread waiter([&] {
+    signal.wait_for(signal.generation(), std::chrono::seconds(5), [] { return false; });
+    woke = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  signal.notify_all();
+  waiter.join();
+
+  EXPECT_TRUE(woke);
+}
+
+TEST(WorkSignalTest, WaitTimesOutWithoutNotification) {
+  WorkSignal signal;
+  auto started = std::chrono::steady_clock::now();
+  signal.wait_for(signal.generation(), std::chrono::milliseconds(30), [] { return false; });
+
+  EXPECT_GE(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(30));
+}
+
+}  // namespace magic_tests
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "magic_core/async/work_stealing_executor.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core::async;
+
+TEST(WorkStealingExecutorTest, RunOneRunsOwnNewestJobFirst) {
+  WorkStealingExecutor executor;
+  std::vector<int> order;
+  executor.submit([&] { order.push_back(1); });
+  executor.submit([&] { order.push_back(2); });
+  EXPECT_EQ(executor.pending(), 2);
+
+  EXPECT_TRUE(executor.run_one());
+  EXPECT_TRUE(executor.run_one());
+  EXPECT_FALSE(executor.run_one());
+
+  EXPECT_EQ(order, (std::vector<int>{2, 1}));
+  EXPECT_EQ(executor.steals(), 0);
+}
+
+TEST(WorkStealingExecutorTest, IdleThreadStealsOldestJob) {
+  WorkStealingExecutor executor;
+  std::vector<int> order;
+  executor.submit([&] { order.push_back(1); });
+  executor.submit([&] { order.push_back(2); });
+
+  std::thread thief([&] { EXPECT_TRUE(executor.run_one()); });
+  thief.join();
+
+  EXPECT_EQ(order, (std::vector<int>{1}));
+  EXPECT_EQ(executor.steals(), 1);
+  EXPECT_EQ(executor.pending(), 1);
+}
+
+TEST(WorkStealingExecutorTest, SubmitNotifiesIdleSignal) {
+  auto signal = std::make_shared<WorkSignal>();
+  WorkStealingExecutor executor(0, signal);
+  const uint64_t seen = signal->generation();
+
+  executor.submit([] {});
+
+  EXPECT_NE(signal->generation(), seen);
+}
+
+TEST(WorkStealingExecutorTest, OwnThreadsDrainSubmittedJobs) {
+  WorkStealingExecutor executor(2);
+  TaskGroup group(executor);
+  std::atomic<int> ran{0};
+  for (int i = 0; i < 32; ++i) {
+    group.run([&] { ++ran; });
+  }
+  group.wait();
+
+  EXPECT_EQ(ran, 32);
+  EXPECT_EQ(executor.pending(), 0);
+}
+
+TEST(WorkStealingExecutorTest, TaskGroupRethrowsFirstErrorAndSkipsTheRest) {
+  WorkStealingExecutor executor;
+  TaskGroup group(executor);
+  std::atomic<int> ran{0};
+  // Runs newest first on this thread, so the throwing job goes before the others
+  group.run([&] { ++ran; });
+  group.run([&] { ++ran; });
+  group.run([] { throw std::runtime_error("batch failed"); });
+
+  EXPECT_THROW(group.wait(), std::runtime_error);
+  EXPECT_TRUE(group.failed());
+  EXPECT_EQ(ran, 0);
+  EXPECT_EQ(group.completions(), 3);
+}
+
+TEST(WorkStealingExecutorTest, HelpOrWaitRunsQueuedJobsInsteadOfBlocking) {
+  WorkStealingExecutor executor;
+  TaskGroup group(executor);
+  bool ran = false;
+  group.run([&] { ran = true; });
+
+  auto started = std::chrono::steady_clock::now();
+  group.help_or_wait(group.completions(), std::chrono::seconds(5));
+
+  EXPECT_TRUE(ran);
+  EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(1));
+  group.wait();
+}
+
+}  // namespace magic_tests
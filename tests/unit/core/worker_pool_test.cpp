@@ -75,6 +75,112 @@ TEST_F(WorkerPoolTest, StartTwiceShowsWarningAndNoThrow) {
   });
 }
 
+TEST_F(WorkerPoolTest, QueuedTaskWakesIdleWorker) {
+  WorkerPool pool(1, service_provider_);
+  pool.start();
+  // Let the worker find the queue empty and go idle
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // The file has no metadata, so the task fails fast without touching the mocks
+  task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/wakeup.txt");
+
+  // Without the wakeup the worker would not look again until its idle poll interval
+  bool picked_up = false;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (task_queue_repo_->get_tasks_by_status(TaskStatus::PENDING).empty()) {
+      picked_up = true;
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  pool.stop();
+
+  EXPECT_TRUE(picked_up);
+}
+
+TEST_F(WorkerPoolTest, ShutdownDoesNotWaitForIdlePoll) {
+  auto started = std::chrono::steady_clock::now();
+  {
+    WorkerPool pool(2, service_provider_);
+    pool.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    pool.stop();
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(2));
+}
+
+TEST_F(WorkerPoolTest, ConstructorThrowsWhenMaxBelowMin) {
+  WorkerPoolOptions options;
+  options.min_workers = 3;
+  options.max_workers = 2;
+  EXPECT_THROW({ WorkerPool pool(options, service_provider_); }, std::invalid_argument);
+}
+
+TEST_F(WorkerPoolTest, ConstructorThrowsWhenLanesExceedMin) {
+  WorkerPoolOptions options;
+  options.min_workers = 2;
+  options.max_workers = 4;
+  options.interactive_workers = 2;
+  options.bulk_workers = 1;
+  EXPECT_THROW({ WorkerPool pool(options, service_provider_); }, std::invalid_argument);
+}
+
+TEST_F(WorkerPoolTest, BulkBacklogLeavesInteractiveWorkerFree) {
+  WorkerPoolOptions options;
+  options.min_workers = 1;
+  options.max_workers = 1;
+  options.interactive_workers = 1;
+  WorkerPool pool(options, service_provider_);
+  task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/crawl.txt",
+                                             TaskPriority::BULK);
+  pool.start();
+
+  // No metadata, so the interactive task fails fast without touching the mocks
+  task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/interactive.txt",
+                                             TaskPriority::INTERACTIVE);
+  bool picked_up = false;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (std::chrono::steady_clock::now() < deadline) {
+    auto pending = task_queue_repo_->get_tasks_by_status(TaskStatus::PENDING);
+    if (pending.size() == 1 && pending[0].priority == TaskPriority::BULK) {
+      picked_up = true;
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  pool.stop();
+
+  // The only worker is reserved for interactive requests, so the crawl is still waiting
+  EXPECT_TRUE(picked_up);
+}
+
+TEST_F(WorkerPoolTest, InstallsSharedExecutorForItsLifetime) {
+  {
+    WorkerPool pool(1, service_provider_);
+    EXPECT_EQ(service_provider_->get_executor(), &pool.executor());
+  }
+  EXPECT_EQ(service_provider_->get_executor(), nullptr);
+}
+
+TEST_F(WorkerPoolTest, RebalanceNeverShrinksBelowMinimum) {
+  WorkerPoolOptions options;
+  options.min_workers = 2;
+  options.max_workers = 4;
+  // Keep the scaling thread out of the way; the test drives rebalance itself
+  options.scale_interval = std::chrono::hours(1);
+  options.idle_before_shrink = std::chrono::milliseconds(0);
+  WorkerPool pool(options, service_provider_);
+  pool.start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  const auto now = std::chrono::steady_clock::now();
+  pool.rebalance(now);
+  pool.rebalance(now + std::chrono::seconds(1));
+  EXPECT_EQ(pool.size(), 2);
+  pool.stop();
+}
+
 }  // namespace magic_tests
 
 
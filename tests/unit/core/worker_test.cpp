@@ -109,11 +109,11 @@ TEST_F(WorkerTest, RunOneTaskWithPendingTask) {
   
   // Worker does not call get_file_type(); only extract_with_hash is used
   
-  // Set up embedding expectations for each chunk
+  // Set up the embedding expectation for the chunk batch
   std::vector<float> test_embedding = MockUtilities::create_test_embedding();
-  EXPECT_CALL(*mock_ollama_client_, get_embedding(_))
-      .Times(2) // one per chunk
-      .WillRepeatedly(Return(test_embedding));
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .Times(1) // both chunks go in one batch
+      .WillOnce(MockUtilities::embed_each_with(test_embedding));
   
   // Run the task
   bool result = worker_->run_one_task();
@@ -258,9 +258,9 @@ TEST_F(WorkerTest, MultipleTasksProcessedSequentially) {
   
   // Worker does not call get_file_type(); remove expectation
   
-  EXPECT_CALL(*mock_ollama_client_, get_embedding(_))
-      .Times(2) // 2 tasks * 1 chunk each
-      .WillRepeatedly(Return(test_embedding));
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(_))
+      .Times(2) // 2 tasks * 1 batch each
+      .WillRepeatedly(MockUtilities::embed_each_with(test_embedding));
   
   // Process both tasks
   bool result1 = worker_->run_one_task();
@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "magic_core/db/chunk_slab.hpp"
+
+namespace magic_core {
+
+namespace {
+
+constexpr int DIMENSION = 64;
+
+std::vector<float> random_vector(std::mt19937 &rng) {
+  std::normal_distribution<float> normal;
+  std::vector<float> v(DIMENSION);
+  for (float &x : v) {
+    x = normal(rng);
+  }
+  return v;
+}
+
+float l2(const std::vector<float> &a, const std::vector<float> &b) {
+  float total = 0.0f;
+  for (int d = 0; d < DIMENSION; ++d) {
+    total += (a[d] - b[d]) * (a[d] - b[d]);
+  }
+  return total;
+}
+
+float cosine_distance(const std::vector<float> &a, const std::vector<float> &b) {
+  float ab = 0.0f, aa = 0.0f, bb = 0.0f;
+  for (int d = 0; d < DIMENSION; ++d) {
+    ab += a[d] * b[d];
+    aa += a[d] * a[d];
+    bb += b[d] * b[d];
+  }
+  return 1.0f - ab / std::sqrt(aa * bb);
+}
+
+}  // namespace
+
+class ChunkSlabTest : public ::testing::TestWithParam<VectorMetric> {};
+
+TEST_P(ChunkSlabTest, ScanSlabs_MatchesBruteForceAcrossSlabs) {
+  const VectorMetric metric = GetParam();
+  std::mt19937 rng(7);
+  std::vector<ChunkSlab> slabs(3, ChunkSlab(DIMENSION, metric));
+  std::vector<std::pair<int64_t, std::vector<float>>> all;
+  int64_t next_id = 100;
+  for (auto &slab : slabs) {
+    for (int i = 0; i < 20; ++i) {
+      auto v = random_vector(rng);
+      slab.append(next_id, v.data());
+      all.emplace_back(next_id++, std::move(v));
+    }
+  }
+  const auto query = random_vector(rng);
+
+  std::vector<VectorIndexHit> expected;
+  for (const auto &[id, v] : all) {
+    expected.push_back(
+        {id, metric == VectorMetric::Cosine ? cosine_distance(query, v) : l2(query, v)});
+  }
+  std::sort(expected.begin(), expected.end(),
+            [](const auto &a, const auto &b) { return a.distance < b.distance; });
+
+  const auto hits = scan_slabs({&slabs[0], &slabs[1], &slabs[2]}, query, 10);
+  ASSERT_EQ(hits.size(), 10u);
+  for (size_t i = 0; i < hits.size(); ++i) {
+    EXPECT_EQ(hits[i].id, expected[i].id) << "rank " << i;
+    EXPECT_NEAR(hits[i].distance, expected[i].distance, 1e-3f * (1.0f + expected[i].distance));
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Metrics,
+                         ChunkSlabTest,
+                         ::testing::Values(VectorMetric::L2, VectorMetric::Cosine));
+
+TEST(ChunkSlabScanTest, ReturnsEveryRowWhenKExceedsThem) {
+  std::mt19937 rng(1);
+  ChunkSlab slab(DIMENSION, VectorMetric::L2);
+  const auto v = random_vector(rng);
+  slab.append(1, v.data());
+  slab.append(2, v.data());
+
+  const auto hits = scan_slabs({&slab}, v, 5);
+  ASSERT_EQ(hits.size(), 2u);
+  // Equal distances rank by id
+  EXPECT_EQ(hits[0].id, 1);
+  EXPECT_EQ(hits[1].id, 2);
+  EXPECT_FLOAT_EQ(hits[0].distance, 0.0f);
+  EXPECT_EQ(slab.size(), 2u);
+  EXPECT_GE(slab.bytes(), 2 * DIMENSION * sizeof(float));
+}
+
+TEST(ChunkSlabScanTest, NothingToScanReturnsNothing) {
+  std::mt19937 rng(2);
+  EXPECT_TRUE(scan_slabs({}, random_vector(rng), 5).empty());
+  ChunkSlab slab(DIMENSION, VectorMetric::L2);
+  const auto v = random_vector(rng);
+  slab.append(1, v.data());
+  EXPECT_TRUE(scan_slabs({&slab}, v, 0).empty());
+}
+
+TEST(ChunkSlabScanTest, RejectsMismatchedQueriesAndSlabs) {
+  std::mt19937 rng(3);
+  ChunkSlab slab(DIMENSION, VectorMetric::L2);
+  const auto v = random_vector(rng);
+  slab.append(1, v.data());
+  EXPECT_THROW(scan_slabs({&slab}, std::vector<float>(DIMENSION + 1), 1), VectorIndexError);
+
+  ChunkSlab cosine(DIMENSION, VectorMetric::Cosine);
+  cosine.append(2, v.data());
+  EXPECT_THROW(scan_slabs({&slab, &cosine}, v, 1), VectorIndexError);
+}
+
+namespace {
+
+std::shared_ptr<const ChunkSlab> slab_of(size_t rows, int64_t first_id = 1) {
+  std::mt19937 rng(static_cast<uint32_t>(first_id));
+  auto slab = std::make_shared<ChunkSlab>(DIMENSION, VectorMetric::L2);
+  for (size_t i = 0; i < rows; ++i) {
+    slab->append(first_id + static_cast<int64_t>(i), random_vector(rng).data());
+  }
+  return slab;
+}
+
+size_t cached_bytes(const std::shared_ptr<const ChunkSlab> &slab) {
+  return sizeof(ChunkSlab) + slab->bytes();
+}
+
+}  // namespace
+
+TEST(ChunkSlabCacheTest, GetReturnsWhatWasPut) {
+  ChunkSlabCache cache(1 << 20);
+  auto slab = slab_of(3);
+  EXPECT_EQ(cache.get(7), nullptr);
+  cache.put(7, slab, cache.ticket());
+  EXPECT_EQ(cache.get(7), slab);
+
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.files, 1u);
+  EXPECT_EQ(stats.bytes, cached_bytes(slab));
+}
+
+TEST(ChunkSlabCacheTest, EvictsLeastRecentlyUsedPastTheByteCap) {
+  auto a = slab_of(4, 1);
+  auto b = slab_of(4, 10);
+  auto c = slab_of(4, 20);
+  ChunkSlabCache cache(cached_bytes(a) + cached_bytes(b) + cached_bytes(c) / 2);
+  cache.put(1, a, cache.ticket());
+  cache.put(2, b, cache.ticket());
+  // Touching 1 leaves 2 as the least recently used
+  ASSERT_NE(cache.get(1), nullptr);
+  cache.put(3, c, cache.ticket());
+
+  EXPECT_NE(cache.get(1), nullptr);
+  EXPECT_EQ(cache.get(2), nullptr);
+  EXPECT_NE(cache.get(3), nullptr);
+  EXPECT_LE(cache.stats().bytes, cache.capacity_bytes());
+
+  // An evicted slab stays valid for whoever still holds it
+  EXPECT_EQ(b->size(), 4u);
+}
+
+TEST(ChunkSlabCacheTest, InvalidationDropsTheFileAndRejectsOlderLoads) {
+  ChunkSlabCache cache(1 << 20);
+  cache.put(1, slab_of(2), cache.ticket());
+  cache.put(2, slab_of(2), cache.ticket());
+
+  const uint64_t before_write = cache.ticket();
+  cache.invalidate(1);
+  EXPECT_EQ(cache.get(1), nullptr);
+  EXPECT_NE(cache.get(2), nullptr);
+
+  // A slab read before the write committed must not come back
+  cache.put(1, slab_of(2), before_write);
+  EXPECT_EQ(cache.get(1), nullptr);
+  cache.put(1, slab_of(2), cache.ticket());
+  EXPECT_NE(cache.get(1), nullptr);
+
+  cache.invalidate(std::vector<int>{1, 2});
+  EXPECT_EQ(cache.stats().files, 0u);
+  EXPECT_EQ(cache.stats().bytes, 0u);
+}
+
+TEST(ChunkSlabCacheTest, ZeroCapacityAndOversizedSlabsAreNotCached) {
+  ChunkSlabCache disabled(0);
+  disabled.put(1, slab_of(1), disabled.ticket());
+  EXPECT_EQ(disabled.get(1), nullptr);
+
+  auto large = slab_of(8);
+  ChunkSlabCache small(cached_bytes(large) - 1);
+  small.put(1, large, small.ticket());
+  EXPECT_EQ(small.get(1), nullptr);
+  small.put(2, slab_of(0), small.ticket());
+  EXPECT_NE(small.get(2), nullptr);
+  small.clear();
+  EXPECT_EQ(small.get(2), nullptr);
+}
+
+}  // namespace magic_core
@@ -2,6 +2,8 @@
 #include <future>
 #include <atomic>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "../../common/utilities_test.hpp"
 #include "magic_core/db/database_manager.hpp"
@@ -71,6 +73,74 @@ TEST_F(ConnectionPoolTest, BlocksWhenPoolExhaustedAndResumes) {
   EXPECT_TRUE(acquired.load());
 }
 
+TEST_F(ConnectionPoolTest, ReadConnectionsRejectWrites) {
+  auto &mgr = DatabaseManager::get_instance();
+  PooledConnection reader(mgr, ConnectionAccess::ReadOnly);
+
+  int count = -1;
+  *reader << "SELECT COUNT(*) FROM files" >> count;
+  EXPECT_EQ(count, 0);
+  int query_only = 0;
+  *reader << "PRAGMA query_only" >> query_only;
+  EXPECT_EQ(query_only, 1);
+  EXPECT_THROW(*reader << "DELETE FROM files", sqlite::sqlite_exception);
+}
+
+TEST_F(ConnectionPoolTest, ReadPoolIsSeparateAndRecordsWaits) {
+  auto &mgr = DatabaseManager::get_instance();
+  std::vector<std::unique_ptr<PooledConnection>> readers;
+  for (int i = 0; i < DatabaseManager::DEFAULT_READ_POOL_SIZE; ++i) {
+    readers.push_back(std::make_unique<PooledConnection>(mgr, ConnectionAccess::ReadOnly));
+  }
+  // Holding every read connection leaves the read-write pool untouched
+  { PooledConnection writer(mgr); }
+  EXPECT_EQ(mgr.pool_stats(ConnectionAccess::ReadWrite).waits, 0u);
+
+  std::thread t([&]() { PooledConnection reader(mgr, ConnectionAccess::ReadOnly); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  readers.pop_back();
+  t.join();
+
+  auto stats = mgr.pool_stats(ConnectionAccess::ReadOnly);
+  EXPECT_EQ(stats.acquisitions, static_cast<size_t>(DatabaseManager::DEFAULT_READ_POOL_SIZE + 1));
+  EXPECT_EQ(stats.waits, 1u);
+  EXPECT_GE(stats.max_wait, std::chrono::milliseconds(40));
+  EXPECT_EQ(stats.total_wait, stats.max_wait);
+}
+
+TEST_F(ConnectionPoolTest, OpensConnectionsAsTheyAreNeeded) {
+  auto &mgr = DatabaseManager::get_instance();
+  EXPECT_EQ(mgr.pool_stats(ConnectionAccess::ReadOnly).opened, 1u);
+
+  {
+    PooledConnection first(mgr, ConnectionAccess::ReadOnly);
+    PooledConnection second(mgr, ConnectionAccess::ReadOnly);
+    int count = -1;
+    *second << "SELECT COUNT(*) FROM files" >> count;
+    EXPECT_EQ(count, 0);
+  }
+  // Both went back to the pool, so these reuse them
+  { PooledConnection again(mgr, ConnectionAccess::ReadOnly); }
+  auto stats = mgr.pool_stats(ConnectionAccess::ReadOnly);
+  EXPECT_EQ(stats.opened, 2u);
+  EXPECT_EQ(stats.waits, 0u);
+}
+
+TEST_F(ConnectionPoolTest, DerivedRawKeyOpensTheDatabase) {
+  const std::string raw_key = ConnectionPool::derive_raw_key(
+      temp_db_path_.string(), "magic_folder_test_key", CipherOptions{});
+  // x'<32-byte key><16-byte salt>'
+  ASSERT_EQ(raw_key.size(), 3u + 2 * (32 + 16));
+  EXPECT_EQ(raw_key.substr(0, 2), "x'");
+
+  auto conn = ConnectionPool::open_connection(temp_db_path_.string(), raw_key);
+  int count = -1;
+  conn->db << "SELECT COUNT(*) FROM files" >> count;
+  EXPECT_EQ(count, 0);
+  EXPECT_THROW(ConnectionPool::open_connection(temp_db_path_.string(), "wrong_key"),
+               std::exception);
+}
+
 } // namespace magic_core
 
 
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "../../common/utilities_test.hpp"
+#include "magic_core/db/database_backup.hpp"
+#include "magic_core/db/database_manager.hpp"
+#include "magic_core/db/pooled_connection.hpp"
+
+namespace magic_core {
+
+class DatabaseBackupTest : public magic_tests::MetadataStoreTestBase {
+ protected:
+  void SetUp() override {
+    MetadataStoreTestBase::SetUp();
+    copy_path_ = temp_db_path_.parent_path() / (temp_db_path_.stem().string() + "_copy.db");
+  }
+
+  void TearDown() override {
+    magic_tests::TestUtilities::cleanup_temp_db(copy_path_);
+    MetadataStoreTestBase::TearDown();
+  }
+
+  void add_file(const std::string &path) {
+    magic_tests::TestUtilities::create_complete_file_in_store(
+        metadata_store_, magic_tests::TestUtilities::create_test_file_metadata(
+                             path, "hash_" + path, FileType::Text, 1024, true));
+  }
+
+  // Paths in the copy at copy_path_, opened like any other database
+  std::vector<std::string> copied_paths() {
+    auto copy = DatabaseManager::create();
+    copy->initialize(copy_path_, "magic_folder_test_key", 1);
+    std::vector<std::string> paths;
+    {
+      PooledConnection conn(*copy, ConnectionAccess::ReadOnly);
+      *conn << "SELECT path FROM files ORDER BY path" >>
+          [&](std::string path) { paths.push_back(std::move(path)); };
+    }
+    copy->shutdown();
+    return paths;
+  }
+
+  std::filesystem::path copy_path_;
+};
+
+TEST_F(DatabaseBackupTest, CopiesEveryPageInSteps) {
+  add_file("/test/a.txt");
+  add_file("/test/b.txt");
+
+  DatabaseBackup backup(*db_manager_, copy_path_);
+  int steps = 0;
+  while (!backup.step(1)) {
+    ++steps;
+  }
+  backup.finish();
+
+  EXPECT_GT(steps, 1);
+  EXPECT_EQ(backup.remaining(), 0);
+  EXPECT_GT(backup.page_size(), 0);
+  EXPECT_EQ(copied_paths(), (std::vector<std::string>{"/test/a.txt", "/test/b.txt"}));
+}
+
+TEST_F(DatabaseBackupTest, LeavesOutWhatIsWrittenAfterItStarts) {
+  add_file("/test/before.txt");
+
+  DatabaseBackup backup(*db_manager_, copy_path_);
+  backup.step(1);
+  // Not held up by the backup's read
+  add_file("/test/after.txt");
+  while (!backup.step(1)) {
+  }
+  backup.finish([](sqlite::database &copy) { copy << "DELETE FROM task_queue"; });
+
+  EXPECT_EQ(copied_paths(), std::vector<std::string>{"/test/before.txt"});
+  EXPECT_TRUE(metadata_store_->get_file_metadata("/test/after.txt").has_value());
+}
+
+TEST_F(DatabaseBackupTest, UnfinishedCopyIsDeleted) {
+  {
+    DatabaseBackup backup(*db_manager_, copy_path_);
+    backup.step(1);
+  }
+
+  EXPECT_FALSE(std::filesystem::exists(copy_path_));
+}
+
+TEST_F(DatabaseBackupTest, RefusesAnExistingDestination) {
+  {
+    DatabaseBackup backup(*db_manager_, copy_path_);
+    while (!backup.step(100)) {
+    }
+    backup.finish();
+  }
+
+  EXPECT_THROW(DatabaseBackup(*db_manager_, copy_path_), DatabaseBackupError);
+  EXPECT_TRUE(std::filesystem::exists(copy_path_));
+}
+
+}  // namespace magic_core
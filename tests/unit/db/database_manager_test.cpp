@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <sqlite_modern_cpp.h>
+#include <chrono>
 #include <string>
 #include <vector>
 
@@ -46,9 +47,79 @@ TEST_F(DatabaseManagerTest, ReopenWithWrongKey_Fails) {
   // Simulate a new initialization attempt with the wrong key: create a fresh pool with wrong key
   const std::string wrong_key = "incorrect_test_key";
   EXPECT_THROW({
-                  magic_core::ConnectionPool bad_pool(temp_db_path_.string(), wrong_key, 1);
+                  magic_core::ConnectionPool bad_pool(temp_db_path_.string(), wrong_key, 1, 1);
                 },
                 std::exception);
 }
 
+TEST_F(DatabaseManagerTest, Initialize_ConvertsTextTimestampsToEpochMillis) {
+  // Arrange - tables as created before timestamps were epoch millis
+  metadata_store_.reset();
+  task_queue_repo_.reset();
+  db_manager_->shutdown();
+  {
+    auto legacy = ConnectionPool::open_connection(temp_db_path_.string(), "magic_folder_test_key");
+    sqlite::database& db = legacy->db;
+    db << "PRAGMA foreign_keys = OFF;";
+    // Before the schema was versioned
+    db << "PRAGMA user_version = 0;";
+    db << "DROP TABLE task_progress";
+    db << "DROP TABLE task_queue";
+    db << "DROP TABLE files";
+    db << "CREATE TABLE files (id INTEGER PRIMARY KEY AUTOINCREMENT, path TEXT UNIQUE NOT NULL, "
+          "original_path TEXT, file_hash TEXT NOT NULL, processing_status TEXT NOT NULL, "
+          "summary_vector_blob BLOB, summary_vector_offset INTEGER, suggested_category TEXT, "
+          "suggested_filename TEXT, tags TEXT, last_modified TEXT NOT NULL, "
+          "created_at TEXT NOT NULL, file_type TEXT NOT NULL, file_size INTEGER NOT NULL)";
+    db << "CREATE TABLE task_queue (id INTEGER PRIMARY KEY AUTOINCREMENT, task_type TEXT NOT "
+          "NULL, status TEXT DEFAULT 'PENDING', priority INTEGER DEFAULT 10, error_message TEXT, "
+          "created_at TEXT NOT NULL, updated_at TEXT NOT NULL, target_path TEXT NULL, "
+          "target_tag TEXT NULL, payload TEXT NULL)";
+    db << "CREATE TABLE task_progress (task_id INTEGER PRIMARY KEY, progress_percent REAL NOT "
+          "NULL DEFAULT 0.0, status_message TEXT NOT NULL DEFAULT 'Initializing...', "
+          "updated_at TEXT NOT NULL, FOREIGN KEY (task_id) REFERENCES task_queue(id) ON DELETE "
+          "CASCADE)";
+    db << "INSERT INTO files (id, path, file_hash, processing_status, last_modified, created_at, "
+          "file_type, file_size) VALUES (7, '/test/legacy.txt', 'hash', 'PROCESSED', "
+          "'2024-01-02 03:04:05', '2024-01-01 00:00:00', 'Text', 10)";
+    db << "INSERT INTO chunks (file_id, chunk_index, content) VALUES (7, 0, x'00')";
+    db << "INSERT INTO task_queue (id, task_type, status, created_at, updated_at, target_path) "
+          "VALUES (3, 'PROCESS_FILE', 'PENDING', '2024-01-02 03:04:05', '2024-01-02 03:04:06', "
+          "'/test/legacy.txt')";
+    db << "INSERT INTO task_progress (task_id, progress_percent, updated_at) "
+          "VALUES (3, 50.0, '2024-01-02 03:04:06')";
+  }
+
+  // Act
+  db_manager_->initialize(temp_db_path_, "magic_folder_test_key", 1);
+  metadata_store_ = std::make_shared<MetadataStore>(*db_manager_);
+  task_queue_repo_ = std::make_shared<TaskQueueRepo>(*db_manager_);
+
+  // Assert
+  const auto expected = std::chrono::system_clock::from_time_t(1704164645);  // 2024-01-02 03:04:05
+  auto file = metadata_store_->get_file_metadata(7);
+  ASSERT_TRUE(file.has_value());
+  EXPECT_EQ(file->last_modified, expected);
+  EXPECT_EQ(file->created_at, std::chrono::system_clock::from_time_t(1704067200));
+  auto tasks = task_queue_repo_->get_tasks_by_status(TaskStatus::PENDING);
+  ASSERT_EQ(tasks.size(), 1u);
+  EXPECT_EQ(tasks[0].created_at, expected);
+  EXPECT_EQ(tasks[0].updated_at, expected + std::chrono::seconds(1));
+  auto progress = task_queue_repo_->get_task_progress(3);
+  ASSERT_TRUE(progress.has_value());
+  EXPECT_EQ(progress->updated_at, "2024-01-02 03:04:06");
+
+  PooledConnection conn(*db_manager_);
+  std::string type;
+  *conn << "SELECT type FROM pragma_table_info('task_queue') WHERE name = 'created_at'" >> type;
+  EXPECT_EQ(type, "INTEGER");
+  // Rebuilding files did not cascade into its chunks
+  int chunks = 0;
+  *conn << "SELECT COUNT(*) FROM chunks WHERE file_id = 7" >> chunks;
+  EXPECT_EQ(chunks, 1);
+  int fk_on = 0;
+  *conn << "PRAGMA foreign_keys;" >> fk_on;
+  EXPECT_EQ(fk_on, 1);
+}
+
 }  // namespace magic_core
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../common/utilities_test.hpp"
+#include "magic_core/db/database_writer.hpp"
+
+namespace magic_core {
+
+class DatabaseWriterTest : public magic_tests::MetadataStoreTestBase {
+ protected:
+  void SetUp() override {
+    MetadataStoreTestBase::SetUp();
+    PooledConnection conn(*db_manager_);
+    *conn << "CREATE TABLE IF NOT EXISTS writer_test (id INTEGER PRIMARY KEY, value TEXT)";
+    *conn << "DELETE FROM writer_test";
+  }
+
+  std::unique_ptr<DatabaseWriter> make_writer(std::chrono::microseconds commit_delay) {
+    DatabaseWriterOptions options;
+    options.commit_delay = commit_delay;
+    return std::make_unique<DatabaseWriter>(
+        ConnectionPool::open_connection(temp_db_path_.string(), "magic_folder_test_key"),
+        options);
+  }
+
+  static DatabaseWriter::Write insert(int id) {
+    return [id](PooledDatabase &conn) {
+      auto &statement = conn.prepare("INSERT INTO writer_test (id, value) VALUES (?, ?)");
+      statement << id << "value" + std::to_string(id);
+      statement.execute();
+    };
+  }
+
+  int count_rows() {
+    PooledConnection conn(*db_manager_);
+    int count = 0;
+    *conn << "SELECT COUNT(*) FROM writer_test" >> count;
+    return count;
+  }
+};
+
+TEST_F(DatabaseWriterTest, Run_IsVisibleToReadersOnceItReturns) {
+  auto writer = make_writer(std::chrono::microseconds(0));
+  writer->run(insert(1));
+  EXPECT_EQ(count_rows(), 1);
+  EXPECT_EQ(writer->commits(), 1u);
+}
+
+TEST_F(DatabaseWriterTest, FailedWrite_RollsBackAloneAndTheBatchCommits) {
+  // A long delay puts all three writes in one transaction
+  auto writer = make_writer(std::chrono::milliseconds(200));
+  auto first = writer->submit(insert(1));
+  auto failing = writer->submit([](PooledDatabase &conn) {
+    insert(2)(conn);
+    throw std::runtime_error("write failed halfway");
+  });
+  auto third = writer->submit(insert(3));
+
+  EXPECT_NO_THROW(first.get());
+  EXPECT_THROW(failing.get(), std::runtime_error);
+  EXPECT_NO_THROW(third.get());
+  EXPECT_EQ(count_rows(), 2);
+  EXPECT_EQ(writer->commits(), 1u);
+  EXPECT_EQ(writer->writes_committed(), 2u);
+}
+
+TEST_F(DatabaseWriterTest, ConcurrentWriters_ShareCommits) {
+  auto writer = make_writer(std::chrono::milliseconds(2));
+  constexpr int threads = 8;
+  constexpr int writes_per_thread = 25;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      for (int i = 0; i < writes_per_thread; ++i) {
+        writer->run(insert(t * writes_per_thread + i + 1));
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  EXPECT_EQ(count_rows(), threads * writes_per_thread);
+  EXPECT_EQ(writer->writes_committed(), static_cast<size_t>(threads * writes_per_thread));
+  EXPECT_LT(writer->commits(), writer->writes_committed());
+}
+
+TEST_F(DatabaseWriterTest, Stop_CommitsQueuedWritesThenRejectsNewOnes) {
+  auto writer = make_writer(std::chrono::milliseconds(200));
+  auto queued = writer->submit(insert(1));
+  writer->stop();
+
+  EXPECT_NO_THROW(queued.get());
+  EXPECT_EQ(count_rows(), 1);
+  EXPECT_THROW(writer->submit(insert(2)), DatabaseWriterError);
+}
+
+}  // namespace magic_core
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "../../common/utilities_test.hpp"
+#include "magic_core/db/embedding_cache.hpp"
+
+namespace magic_core {
+
+class EmbeddingCacheTest : public magic_tests::MetadataStoreTestBase {
+ protected:
+  std::vector<float> vector_for(const std::string& seed) {
+    return magic_tests::TestUtilities::create_test_vector(seed);
+  }
+};
+
+TEST_F(EmbeddingCacheTest, ContentKey_IsStableAndDistinct) {
+  EXPECT_EQ(EmbeddingCache::content_key("chunk"), EmbeddingCache::content_key("chunk"));
+  EXPECT_NE(EmbeddingCache::content_key("chunk"), EmbeddingCache::content_key("chunk "));
+  EXPECT_EQ(EmbeddingCache::content_key("").size(), 64);
+}
+
+TEST_F(EmbeddingCacheTest, Lookup_MissesUntilStored) {
+  EmbeddingCache cache(*db_manager_, "mxbai-embed-large");
+  std::vector<std::string> keys = {EmbeddingCache::content_key("a"),
+                                   EmbeddingCache::content_key("b")};
+
+  auto before = cache.lookup(keys);
+  ASSERT_EQ(before.size(), 2);
+  EXPECT_TRUE(before[0].empty());
+  EXPECT_TRUE(before[1].empty());
+
+  cache.store({keys[0]}, {vector_for("a")});
+  auto after = cache.lookup(keys);
+
+  EXPECT_EQ(after[0], vector_for("a"));
+  EXPECT_TRUE(after[1].empty());
+  EmbeddingCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.memory_hits, 1);
+  EXPECT_EQ(stats.misses, 3);
+}
+
+TEST_F(EmbeddingCacheTest, Lookup_FindsEntriesStoredByAnotherInstance) {
+  const std::string key = EmbeddingCache::content_key("shared boilerplate");
+  EmbeddingCache(*db_manager_, "mxbai-embed-large").store({key}, {vector_for("shared")});
+
+  EmbeddingCache cache(*db_manager_, "mxbai-embed-large");
+  auto found = cache.lookup({key});
+
+  EXPECT_EQ(found[0], vector_for("shared"));
+  EXPECT_EQ(cache.stats().disk_hits, 1);
+  // Now in memory as well
+  cache.lookup({key});
+  EXPECT_EQ(cache.stats().memory_hits, 1);
+}
+
+TEST_F(EmbeddingCacheTest, Lookup_KeepsModelsApart) {
+  const std::string key = EmbeddingCache::content_key("text");
+  EmbeddingCache(*db_manager_, "model-a").store({key}, {vector_for("a")});
+
+  EmbeddingCache other(*db_manager_, "model-b");
+
+  EXPECT_TRUE(other.lookup({key})[0].empty());
+}
+
+TEST_F(EmbeddingCacheTest, Memory_EvictsLeastRecentlyUsed) {
+  EmbeddingCache cache(*db_manager_, "mxbai-embed-large", /*memory_entries*/ 2);
+  std::vector<std::string> keys = {EmbeddingCache::content_key("1"),
+                                   EmbeddingCache::content_key("2"),
+                                   EmbeddingCache::content_key("3")};
+  cache.store({keys[0], keys[1]}, {vector_for("1"), vector_for("2")});
+  cache.lookup({keys[0]});  // 2 is now the least recently used
+  cache.store({keys[2]}, {vector_for("3")});
+
+  auto found = cache.lookup(keys);
+
+  // Every entry is still found, but 2 had to come from SQLite
+  EXPECT_EQ(found[1], vector_for("2"));
+  EmbeddingCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.memory_hits, 3);
+  EXPECT_EQ(stats.disk_hits, 1);
+}
+
+TEST_F(EmbeddingCacheTest, LookupNear_ReusesVectorOfNearIdenticalChunk) {
+  const std::string letter =
+      "Dear Alice, thank you for your order of 12 March. Your parcel has been packed and will "
+      "leave our warehouse within two working days. You can follow its progress with the "
+      "tracking link in your account, and our team is happy to help with any questions about "
+      "delivery, returns or refunds. Kind regards, the customer service team.";
+  std::string edited = letter;
+  edited.replace(edited.find("12 March"), 8, "3 April");
+  EmbeddingCache cache(*db_manager_, "mxbai-embed-large", EmbeddingCache::DEFAULT_MEMORY_ENTRIES,
+                       /*near_duplicate_entries*/ 16);
+  ASSERT_TRUE(cache.detects_near_duplicates());
+  const std::string key = EmbeddingCache::content_key(letter);
+  cache.store({key}, {vector_for("letter")});
+  cache.remember({NearDuplicateIndex::fingerprint(letter)}, {key});
+
+  auto near = cache.lookup_near({NearDuplicateIndex::fingerprint(edited),
+                                 NearDuplicateIndex::fingerprint("too short"), std::nullopt});
+
+  ASSERT_EQ(near.size(), 3);
+  EXPECT_EQ(near[0], vector_for("letter"));
+  EXPECT_TRUE(near[1].empty());
+  EXPECT_TRUE(near[2].empty());
+  // The reused vector is not cached under the edited chunk's own key
+  EXPECT_TRUE(cache.lookup({EmbeddingCache::content_key(edited)})[0].empty());
+  EmbeddingCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.near_hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+
+  // Fingerprints name vectors of the model they were remembered under
+  cache.set_model("model-b");
+  EXPECT_TRUE(cache.lookup_near({NearDuplicateIndex::fingerprint(edited)})[0].empty());
+}
+
+TEST_F(EmbeddingCacheTest, LookupNear_FindsNothingWhenDisabled) {
+  EmbeddingCache cache(*db_manager_, "mxbai-embed-large");
+  const std::string key = EmbeddingCache::content_key("a");
+  cache.store({key}, {vector_for("a")});
+  cache.remember({uint64_t{42}}, {key});
+
+  EXPECT_FALSE(cache.detects_near_duplicates());
+  EXPECT_TRUE(cache.lookup_near({uint64_t{42}})[0].empty());
+}
+
+TEST_F(EmbeddingCacheTest, Store_MismatchedSizesThrows) {
+  EmbeddingCache cache(*db_manager_, "mxbai-embed-large");
+
+  EXPECT_THROW(cache.store({EmbeddingCache::content_key("a")}, {}), EmbeddingCacheError);
+}
+
+}  // namespace magic_core
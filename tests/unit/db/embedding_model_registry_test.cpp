@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../../common/utilities_test.hpp"
+#include "magic_core/db/embedding_model_registry.hpp"
+
+namespace magic_core {
+
+class EmbeddingModelRegistryTest : public magic_tests::MetadataStoreTestBase {};
+
+TEST_F(EmbeddingModelRegistryTest, Active_IsEmptyUntilAModelIsActivated) {
+  EmbeddingModelRegistry registry(*db_manager_);
+  EXPECT_FALSE(registry.active().has_value());
+
+  registry.register_model("mxbai-embed-large", 1024);
+  EXPECT_FALSE(registry.active().has_value());
+  ASSERT_TRUE(registry.find("mxbai-embed-large").has_value());
+  EXPECT_EQ(registry.find("mxbai-embed-large")->dimension, 1024);
+  EXPECT_FALSE(registry.find("all-minilm").has_value());
+}
+
+TEST_F(EmbeddingModelRegistryTest, RegisterModel_IsIdempotentButKeepsTheActiveDimension) {
+  EmbeddingModelRegistry registry(*db_manager_);
+  EmbeddingModel first = registry.register_model("all-minilm", 384);
+  EmbeddingModel again = registry.register_model("all-minilm", 384);
+
+  EXPECT_EQ(first.id, again.id);
+  EXPECT_EQ(registry.list().size(), 1u);
+  registry.activate("all-minilm");
+  EXPECT_THROW(registry.register_model("all-minilm", 768), EmbeddingModelRegistryError);
+  EXPECT_EQ(registry.find("all-minilm")->dimension, 384);
+  EXPECT_THROW(registry.register_model("", 384), EmbeddingModelRegistryError);
+  EXPECT_THROW(registry.register_model("zero", 0), EmbeddingModelRegistryError);
+}
+
+TEST_F(EmbeddingModelRegistryTest, RegisterModel_ResizesAnInactiveModel) {
+  EmbeddingModelRegistry registry(*db_manager_);
+  registry.ensure_active("mxbai-embed-large", 1024);
+  // Registered with a guessed dimension before the endpoint told the real one
+  EmbeddingModel guessed = registry.register_model("all-minilm", 1024);
+
+  EmbeddingModel resized = registry.register_model("all-minilm", 384);
+
+  EXPECT_EQ(resized.id, guessed.id);
+  EXPECT_EQ(resized.dimension, 384);
+  EXPECT_FALSE(resized.active);
+  EXPECT_EQ(registry.active()->name, "mxbai-embed-large");
+}
+
+TEST_F(EmbeddingModelRegistryTest, Activate_LeavesExactlyOneActiveModel) {
+  EmbeddingModelRegistry registry(*db_manager_);
+  registry.register_model("mxbai-embed-large", 1024);
+  registry.register_model("all-minilm", 384);
+
+  registry.activate("mxbai-embed-large");
+  EXPECT_EQ(registry.active()->name, "mxbai-embed-large");
+  registry.activate("all-minilm");
+  EXPECT_EQ(registry.active()->name, "all-minilm");
+
+  int active = 0;
+  for (const EmbeddingModel& model : registry.list()) {
+    active += model.active ? 1 : 0;
+  }
+  EXPECT_EQ(active, 1);
+  EXPECT_THROW(registry.activate("unregistered"), EmbeddingModelRegistryError);
+  EXPECT_EQ(registry.active()->name, "all-minilm");
+}
+
+TEST_F(EmbeddingModelRegistryTest, EnsureActive_OnlyRegistersIntoAnEmptyRegistry) {
+  EmbeddingModelRegistry registry(*db_manager_);
+  EmbeddingModel first = registry.ensure_active("mxbai-embed-large", 1024);
+  EXPECT_EQ(first.name, "mxbai-embed-large");
+  EXPECT_TRUE(first.active);
+
+  // A different configured model does not displace the one the vectors came from
+  EmbeddingModel second = registry.ensure_active("all-minilm", 384);
+  EXPECT_EQ(second.name, "mxbai-embed-large");
+  EXPECT_EQ(second.dimension, 1024);
+  EXPECT_FALSE(registry.find("all-minilm").has_value());
+}
+
+TEST_F(EmbeddingModelRegistryTest, MetadataStore_IsSizedForTheActiveModel) {
+  EXPECT_EQ(metadata_store_->dimension(), MetadataStore::DEFAULT_VECTOR_DIMENSION);
+  EmbeddingModelRegistry(*db_manager_).ensure_active("all-minilm", 384);
+
+  // Reopen on fresh segments, as on a new database registered with the smaller model
+  metadata_store_.reset();
+  task_queue_repo_.reset();
+  db_manager_->shutdown();
+  for (const char* name : {"files", "chunks"}) {
+    std::filesystem::remove(DatabaseManager::vector_store_path(temp_db_path_, name));
+  }
+  db_manager_->initialize(temp_db_path_, "magic_folder_test_key", /*pool_size*/ 1);
+  metadata_store_ = std::make_shared<MetadataStore>(*db_manager_);
+  ASSERT_EQ(metadata_store_->dimension(), 384);
+
+  int file_id = metadata_store_->upsert_file_stub(
+      magic_tests::TestUtilities::create_test_basic_file_metadata("/tmp/minilm.txt"));
+  std::vector<float> vector(384, 0.0f);
+  vector[0] = 1.0f;
+  metadata_store_->update_file_ai_analysis(file_id, vector);
+  auto results = metadata_store_->search_similar_files(vector, 1);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0].id, file_id);
+
+  EXPECT_THROW(metadata_store_->update_file_ai_analysis(
+                   file_id, std::vector<float>(MetadataStore::DEFAULT_VECTOR_DIMENSION, 0.1f)),
+               MetadataStoreError);
+}
+
+}  // namespace magic_core
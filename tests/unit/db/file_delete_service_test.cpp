@@ -105,6 +105,31 @@ TEST_F(FileDeleteServiceTest, DeleteFile_HandlesFileWithVectorEmbedding) {
   EXPECT_FALSE(file_after.has_value());
 }
 
+TEST_F(FileDeleteServiceTest, DeleteDirectory_RemovesOnlyFilesBelowIt) {
+  magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, magic_tests::TestUtilities::create_test_file_metadata(
+                           "/test2/other.txt", "other123", magic_core::FileType::Text, 10, false));
+
+  size_t deleted = file_delete_service_->delete_directory("/test");
+
+  EXPECT_EQ(deleted, test_files_.size());
+  EXPECT_FALSE(metadata_store_->file_exists("/test/file1.txt"));
+  EXPECT_FALSE(metadata_store_->file_exists("/test/file_with_vector.cpp"));
+  // A sibling that only shares the name prefix is untouched
+  EXPECT_TRUE(metadata_store_->file_exists("/test2/other.txt"));
+}
+
+TEST_F(FileDeleteServiceTest, DeleteDirectory_PurgesVectorsFromSearch) {
+  auto query = metadata_store_->get_file_metadata("/test/file_with_vector.cpp")
+                   ->summary_vector_embedding;
+  ASSERT_FALSE(metadata_store_->search_similar_files(query, 10).empty());
+
+  file_delete_service_->delete_directory("/test");
+
+  // Gone from the live index right away, without waiting for a rebuild
+  EXPECT_TRUE(metadata_store_->search_similar_files(query, 10).empty());
+}
+
 TEST_F(FileDeleteServiceTest, DeleteFile_HandlesNonExistentFile) {
   // Arrange
   std::filesystem::path nonexistent_path = "/test/nonexistent.txt";
@@ -1,7 +1,13 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <memory>
 #include <optional>
+#include <span>
 #include <vector>
+#include "magic_core/db/database_backup.hpp"
 #include "magic_core/db/metadata_store.hpp"
 #include "../../common/utilities_test.hpp"
 
@@ -96,6 +102,34 @@ TEST_F(MetadataStoreTest, CreateFileStub_DuplicatePathUpdates) {
   EXPECT_EQ(retrieved->content_hash, "hash2");
 }
 
+TEST_F(MetadataStoreTest, UpsertFileStubs_BatchReturnsIdsInOrder) {
+  int existing_id = metadata_store_->upsert_file_stub(
+      magic_tests::TestUtilities::create_test_basic_file_metadata("/test/batch_b.txt", "old"));
+
+  std::vector<BasicFileMetadata> stubs = {
+      magic_tests::TestUtilities::create_test_basic_file_metadata("/test/batch_a.txt", "hash_a"),
+      magic_tests::TestUtilities::create_test_basic_file_metadata("/test/batch_b.txt", "hash_b")};
+  std::vector<int> ids = metadata_store_->upsert_file_stubs(stubs);
+
+  ASSERT_EQ(ids.size(), 2u);
+  EXPECT_EQ(ids[1], existing_id);
+  EXPECT_EQ(metadata_store_->get_file_metadata(ids[0])->path, "/test/batch_a.txt");
+  EXPECT_EQ(metadata_store_->get_file_metadata(ids[1])->content_hash, "hash_b");
+}
+
+TEST_F(MetadataStoreTest, FileProcessingStatuses_ReturnsOnlyKnownHashes) {
+  metadata_store_->upsert_file_stub(magic_tests::TestUtilities::create_test_basic_file_metadata(
+      "/test/status_a.txt", "hash_a", FileType::Text, 10, ProcessingStatus::QUEUED));
+  metadata_store_->upsert_file_stub(magic_tests::TestUtilities::create_test_basic_file_metadata(
+      "/test/status_b.txt", "hash_b", FileType::Text, 10, ProcessingStatus::FAILED));
+
+  auto statuses = metadata_store_->file_processing_statuses({"hash_a", "hash_b", "missing"});
+
+  ASSERT_EQ(statuses.size(), 2u);
+  EXPECT_EQ(statuses["hash_a"], ProcessingStatus::QUEUED);
+  EXPECT_EQ(statuses["hash_b"], ProcessingStatus::FAILED);
+}
+
 TEST_F(MetadataStoreTest, CreateFileStub_UpdateResetsAIFields) {
   // Arrange - Create a file stub first
   auto initial_metadata =
@@ -156,6 +190,35 @@ TEST_F(MetadataStoreTest, UpdateFileAIAnalysis_BasicFunctionality) {
   }
 }
 
+TEST_F(MetadataStoreTest, GetBasicFileMetadata_SkipsVectorUntilAskedFor) {
+  auto basic_metadata = magic_tests::TestUtilities::create_test_basic_file_metadata(
+      "/test/basic.txt", "hash_basic", FileType::Text, 2048, ProcessingStatus::QUEUED);
+  int file_id = metadata_store_->upsert_file_stub(basic_metadata);
+  auto test_vector = magic_tests::TestUtilities::create_test_vector("basic", 1024);
+  metadata_store_->update_file_ai_analysis(file_id, test_vector, "", "",
+                                           ProcessingStatus::PROCESSED);
+
+  auto by_path = metadata_store_->get_basic_file_metadata("/test/basic.txt");
+  ASSERT_TRUE(by_path.has_value());
+  EXPECT_EQ(by_path->id, file_id);
+  EXPECT_EQ(by_path->content_hash, "hash_basic");
+  EXPECT_EQ(by_path->file_size, 2048);
+  EXPECT_EQ(by_path->processing_status, ProcessingStatus::PROCESSED);
+  auto by_id = metadata_store_->get_basic_file_metadata(file_id);
+  ASSERT_TRUE(by_id.has_value());
+  EXPECT_EQ(by_id->path, "/test/basic.txt");
+  EXPECT_FALSE(metadata_store_->get_basic_file_metadata("/test/missing.txt").has_value());
+
+  EXPECT_EQ(metadata_store_->get_file_summary_vector(file_id), test_vector);
+}
+
+TEST_F(MetadataStoreTest, GetFileSummaryVector_EmptyWithoutVector) {
+  int file_id = metadata_store_->upsert_file_stub(
+      magic_tests::TestUtilities::create_test_basic_file_metadata("/test/novec.txt", "hash_nv"));
+  EXPECT_TRUE(metadata_store_->get_file_summary_vector(file_id).empty());
+  EXPECT_TRUE(metadata_store_->get_file_summary_vector(file_id + 1000).empty());
+}
+
 TEST_F(MetadataStoreTest, UpdateFileAIAnalysis_EmptyVector) {
   // Arrange
   auto basic_metadata =
@@ -224,6 +287,44 @@ TEST_F(MetadataStoreTest, UpsertChunkMetadata_EmptyChunks) {
   EXPECT_NO_THROW(metadata_store_->upsert_chunk_metadata(file_id, empty_chunks));
 }
 
+TEST_F(MetadataStoreTest, UpsertChunkMetadata_WritesOnlyTheGivenRange) {
+  auto basic_metadata = magic_tests::TestUtilities::create_test_basic_file_metadata(
+      "/test/chunk_range.txt", "range_hash");
+  int file_id = metadata_store_->upsert_file_stub(basic_metadata);
+  auto chunks = chunks_to_processed_chunks(
+      magic_tests::TestUtilities::create_test_chunks(3, "range content"));
+
+  // A reused buffer whose last slot still holds an earlier batch's chunk
+  metadata_store_->upsert_chunk_metadata(file_id, std::span(chunks.data(), 2));
+
+  auto stored = metadata_store_->get_stored_chunks(file_id);
+  ASSERT_EQ(stored.size(), 2u);
+  EXPECT_EQ(stored[0].chunk_index, 0);
+  EXPECT_EQ(stored[1].chunk_index, 1);
+}
+
+TEST_F(MetadataStoreTest, VectorWrites_RefuseAnotherEmbeddingModel) {
+  auto basic_metadata = magic_tests::TestUtilities::create_test_basic_file_metadata(
+      "/test/old_model.txt", "old_model_hash");
+  int file_id = metadata_store_->upsert_file_stub(basic_metadata);
+  auto chunks = chunks_to_processed_chunks(
+      magic_tests::TestUtilities::create_test_chunks(2, "old model content"));
+  const std::string previous = metadata_store_->embedding_model() + "-previous";
+
+  EXPECT_THROW(metadata_store_->upsert_chunk_metadata(file_id, chunks, previous),
+               EmbeddingModelMismatchError);
+  EXPECT_THROW(metadata_store_->update_file_ai_analysis(
+                   file_id, magic_tests::TestUtilities::create_test_vector("summary"), "", "",
+                   ProcessingStatus::PROCESSED, previous),
+               EmbeddingModelMismatchError);
+  EXPECT_TRUE(metadata_store_->get_stored_chunks(file_id).empty());
+  EXPECT_TRUE(metadata_store_->get_file_metadata("/test/old_model.txt")
+                  ->summary_vector_embedding.empty());
+
+  metadata_store_->upsert_chunk_metadata(file_id, chunks, metadata_store_->embedding_model());
+  EXPECT_EQ(metadata_store_->get_stored_chunks(file_id).size(), 2u);
+}
+
 TEST_F(MetadataStoreTest, UpsertChunkMetadata_ReplaceExistingChunks) {
   // Arrange
   auto basic_metadata = magic_tests::TestUtilities::create_test_basic_file_metadata(
@@ -241,6 +342,45 @@ TEST_F(MetadataStoreTest, UpsertChunkMetadata_ReplaceExistingChunks) {
   SUCCEED();
 }
 
+TEST_F(MetadataStoreTest, ReconcileChunks_KeepsRenumbersAndRemoves) {
+  // Arrange
+  auto basic_metadata = magic_tests::TestUtilities::create_test_basic_file_metadata(
+      "/test/reconcile_chunks.txt", "reconcile_hash");
+  int file_id = metadata_store_->upsert_file_stub(basic_metadata);
+
+  auto chunks = chunks_to_processed_chunks(
+      magic_tests::TestUtilities::create_test_chunks(3, "reconcile content"));
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    chunks[i].content_hash = "hash_" + std::to_string(i);
+  }
+  metadata_store_->upsert_chunk_metadata(file_id, chunks);
+
+  auto stored = metadata_store_->get_stored_chunks(file_id);
+  ASSERT_EQ(stored.size(), 3);
+  EXPECT_EQ(stored[1].content_hash, "hash_1");
+  EXPECT_EQ(stored[1].vector_embedding, chunks[1].chunk.vector_embedding);
+
+  // Act - the first chunk was deleted, so the others move up one place
+  metadata_store_->reconcile_chunks(file_id, {{stored[1].id, 0}, {stored[2].id, 1}},
+                                    {stored[0].id});
+
+  // Assert
+  auto reconciled = metadata_store_->get_stored_chunks(file_id);
+  ASSERT_EQ(reconciled.size(), 2);
+  EXPECT_EQ(reconciled[0].id, stored[1].id);
+  EXPECT_EQ(reconciled[0].chunk_index, 0);
+  EXPECT_EQ(reconciled[1].id, stored[2].id);
+  EXPECT_EQ(reconciled[1].chunk_index, 1);
+  EXPECT_EQ(reconciled[1].vector_embedding, chunks[2].chunk.vector_embedding);
+
+  auto results =
+      metadata_store_->search_similar_chunks({file_id}, chunks[0].chunk.vector_embedding, 10);
+  EXPECT_EQ(results.size(), 2);
+  for (const auto& result : results) {
+    EXPECT_NE(result.id, stored[0].id);
+  }
+}
+
 // Tests for get_file_metadata variations
 TEST_F(MetadataStoreTest, GetFileMetadata_ByPath) {
   // Arrange
@@ -360,6 +500,29 @@ TEST_F(MetadataStoreTest, ListAllFiles_EmptyWhenNoFiles) {
   EXPECT_TRUE(result.empty());
 }
 
+TEST_F(MetadataStoreTest, ListFilesPage_PagesInIdOrder) {
+  auto files = magic_tests::TestUtilities::create_test_dataset(5, "/test/page", true);
+  std::vector<int> ids;
+  for (const auto& file : files) {
+    ids.push_back(magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file));
+  }
+
+  auto first = metadata_store_->list_files_page(0, 2);
+  ASSERT_EQ(first.size(), 2);
+  EXPECT_EQ(first[0].id, ids[0]);
+  EXPECT_EQ(first[1].id, ids[1]);
+  EXPECT_EQ(first[0].path, files[0].path);
+  EXPECT_EQ(first[0].file_size, files[0].file_size);
+
+  auto second = metadata_store_->list_files_page(first.back().id, 2);
+  ASSERT_EQ(second.size(), 2);
+  EXPECT_EQ(second[0].id, ids[2]);
+  auto last = metadata_store_->list_files_page(second.back().id, 2);
+  ASSERT_EQ(last.size(), 1);
+  EXPECT_EQ(last[0].id, ids[4]);
+  EXPECT_TRUE(metadata_store_->list_files_page(last.back().id, 2).empty());
+}
+
 // Tests for search_similar_files
 TEST_F(MetadataStoreTest, SearchSimilarFiles_FindsSimilarFiles) {
   // Arrange - Create files with vector embeddings
@@ -396,6 +559,69 @@ TEST_F(MetadataStoreTest, SearchSimilarFiles_FindsSimilarFiles) {
   }
 }
 
+TEST_F(MetadataStoreTest, SearchSimilarFiles_FilterRestrictsCandidatesBeforeSearch) {
+  const auto base = std::chrono::system_clock::time_point(std::chrono::hours(24 * 365 * 50));
+  const struct {
+    const char* path;
+    FileType type;
+    int age_days;
+  } specs[] = {
+      {"/src/a.cpp", FileType::Code, 1},       {"/src/b.cpp", FileType::Code, 30},
+      {"/src/notes.md", FileType::Markdown, 1}, {"/docs/a.md", FileType::Markdown, 2},
+      {"/docs/b.txt", FileType::Text, 60},      {"/srcs/c.cpp", FileType::Code, 1},
+  };
+  for (const auto& spec : specs) {
+    auto file = magic_tests::TestUtilities::create_test_file_metadata(
+        spec.path, std::string("hash_") + spec.path, spec.type, 1024, true);
+    file.last_modified = base - std::chrono::hours(24 * spec.age_days);
+    magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+  }
+  const auto query = magic_tests::TestUtilities::create_test_vector("/docs/b.txt", 1024);
+  auto paths_of = [](const std::vector<FileSearchResult>& results) {
+    std::vector<std::string> paths;
+    for (const auto& result : results) {
+      paths.push_back(result.file.path);
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+  };
+
+  SearchFilter code;
+  code.file_types = {FileType::Code};
+  EXPECT_EQ(paths_of(metadata_store_->search_similar_files(query, 10, {}, code)),
+            (std::vector<std::string>{"/src/a.cpp", "/src/b.cpp", "/srcs/c.cpp"}));
+
+  // A prefix is a plain string prefix of the path, so "/src/" leaves out "/srcs/"
+  SearchFilter under_src;
+  under_src.path_prefix = "/src/";
+  EXPECT_EQ(paths_of(metadata_store_->search_similar_files(query, 10, {}, under_src)),
+            (std::vector<std::string>{"/src/a.cpp", "/src/b.cpp", "/src/notes.md"}));
+
+  SearchFilter recent;
+  recent.modified_after = base - std::chrono::hours(24 * 7);
+  recent.modified_before = base - std::chrono::hours(24 * 2) + std::chrono::milliseconds(1);
+  EXPECT_EQ(paths_of(metadata_store_->search_similar_files(query, 10, {}, recent)),
+            (std::vector<std::string>{"/docs/a.md"}));
+
+  // Fields combine with AND, and k is filled from the matching files alone
+  SearchFilter combined;
+  combined.file_types = {FileType::Code, FileType::Markdown};
+  combined.path_prefix = "/src";
+  combined.modified_after = base - std::chrono::hours(24 * 7);
+  auto results = metadata_store_->search_similar_files(query, 3, {}, combined);
+  EXPECT_EQ(paths_of(results),
+            (std::vector<std::string>{"/src/a.cpp", "/src/notes.md", "/srcs/c.cpp"}));
+  EXPECT_EQ(metadata_store_->resolve_search_filter(combined).size(), 3u);
+
+  SearchFilter nothing;
+  nothing.path_prefix = "/missing/";
+  EXPECT_TRUE(metadata_store_->search_similar_files(query, 10, {}, nothing).empty());
+  auto batch = metadata_store_->search_similar_files_batch({query, query}, 10, {}, code);
+  ASSERT_EQ(batch.size(), 2u);
+  EXPECT_EQ(paths_of(batch[1]),
+            (std::vector<std::string>{"/src/a.cpp", "/src/b.cpp", "/srcs/c.cpp"}));
+}
+
 TEST_F(MetadataStoreTest, SearchSimilarFiles_EmptyIndexReturnsEmpty) {
   // Arrange - no files with vectors
   auto query_vector = magic_tests::TestUtilities::create_test_vector("test", 1024);
@@ -440,6 +666,316 @@ TEST_F(MetadataStoreTest, RebuildFaissIndex_RebuildsSuccessfully) {
   EXPECT_GT(results.size(), 0);
 }
 
+// Tests for incremental index updates
+TEST_F(MetadataStoreTest, UpdateFileAiAnalysis_SearchableWithoutRebuild) {
+  // Arrange
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/incremental.txt", "hash_inc", FileType::Text, 1024, true);
+
+  // Act - no rebuild_faiss_index() call
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+
+  // Assert
+  auto results = metadata_store_->search_similar_files(file.summary_vector_embedding, 1);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].id, file_id);
+  EXPECT_LT(results[0].distance, 0.1f);
+  // Hits carry the row, not the vector
+  EXPECT_EQ(results[0].file.path, "/test/incremental.txt");
+  EXPECT_TRUE(results[0].file.summary_vector_embedding.empty());
+}
+
+TEST_F(MetadataStoreTest, UpsertFileStub_RemovesStaleVectorFromIndex) {
+  // Arrange
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/changed.txt", "hash_v1", FileType::Text, 1024, true);
+  magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+  ASSERT_EQ(metadata_store_->search_similar_files(file.summary_vector_embedding, 5).size(), 1);
+
+  // Act - the file content changed, so the summary vector is reset
+  metadata_store_->upsert_file_stub(
+      magic_tests::TestUtilities::create_test_basic_file_metadata("/test/changed.txt", "hash_v2"));
+
+  // Assert
+  EXPECT_TRUE(metadata_store_->search_similar_files(file.summary_vector_embedding, 5).empty());
+}
+
+TEST_F(MetadataStoreTest, UpdateFileAiAnalysis_ReplacesVectorInPlace) {
+  // Arrange
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/replace.txt", "hash", FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+  auto new_vector = magic_tests::TestUtilities::create_test_vector("replacement", 1024);
+
+  // Act
+  metadata_store_->update_file_ai_analysis(file_id, new_vector);
+
+  // Assert - exactly one hit for the file, matching the new vector
+  auto results = metadata_store_->search_similar_files(new_vector, 5);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].id, file_id);
+  EXPECT_LT(results[0].distance, 0.1f);
+}
+
+// Tests for index snapshots
+TEST_F(MetadataStoreTest, IndexGeneration_BumpsOnlyWhenVectorsChange) {
+  // Arrange
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/generation.txt", "hash", FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+  long long after_insert = metadata_store_->get_index_generation("files");
+
+  // Act & Assert - a status change does not touch the vectors
+  metadata_store_->update_file_processing_status(file_id, ProcessingStatus::FAILED);
+  EXPECT_EQ(metadata_store_->get_index_generation("files"), after_insert);
+
+  metadata_store_->update_file_ai_analysis(
+      file_id, magic_tests::TestUtilities::create_test_vector("other", 1024));
+  EXPECT_GT(metadata_store_->get_index_generation("files"), after_insert);
+}
+
+TEST_F(MetadataStoreTest, SearchGeneration_BumpsOnEveryMutation) {
+  // Arrange
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/search_generation.txt", "hash", FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, file, magic_tests::TestUtilities::create_test_chunks(2, "generation"));
+  uint64_t generation = metadata_store_->search_generation();
+
+  // Act & Assert - unlike the persisted generations, status changes count: they show in results
+  metadata_store_->update_file_processing_status(file_id, ProcessingStatus::FAILED);
+  EXPECT_GT(metadata_store_->search_generation(), generation);
+  generation = metadata_store_->search_generation();
+
+  metadata_store_->rebuild_chunk_index();
+  EXPECT_GT(metadata_store_->search_generation(), generation);
+  generation = metadata_store_->search_generation();
+
+  metadata_store_->delete_file_metadata("/test/search_generation.txt");
+  EXPECT_GT(metadata_store_->search_generation(), generation);
+  generation = metadata_store_->search_generation();
+
+  // Reads leave it alone
+  metadata_store_->search_similar_files(
+      magic_tests::TestUtilities::create_test_vector("query", 1024), 5);
+  EXPECT_EQ(metadata_store_->search_generation(), generation);
+}
+
+TEST_F(MetadataStoreTest, PersistFaissIndex_SnapshotIsReloaded) {
+  // Arrange
+  std::filesystem::path index_path = temp_db_path_;
+  index_path += ".faiss";
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/snapshot.txt", "hash", FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+
+  auto chunks = magic_tests::TestUtilities::create_test_chunks(2, "snapshot");
+  int chunked_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_,
+      magic_tests::TestUtilities::create_test_file_metadata("/test/snapshot_chunks.txt", "hash2",
+                                                            FileType::Text, 1024, true),
+      chunks);
+  std::filesystem::path chunk_index_path = temp_db_path_;
+  chunk_index_path += ".chunks.faiss";
+
+  // Act - the first store with a path has no snapshot yet, so it rebuilds and persists one
+  auto first = std::make_unique<MetadataStore>(*db_manager_, index_path);
+  ASSERT_TRUE(std::filesystem::exists(index_path));
+  ASSERT_TRUE(std::filesystem::exists(chunk_index_path));
+  first.reset();
+  auto second = std::make_unique<MetadataStore>(*db_manager_, index_path);
+
+  // Assert
+  EXPECT_TRUE(second->load_faiss_index());
+  auto results = second->search_similar_files(file.summary_vector_embedding, 1);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].id, file_id);
+  auto chunk_results = second->search_similar_chunks({chunked_id}, chunks[1].vector_embedding, 1);
+  ASSERT_EQ(chunk_results.size(), 1);
+  EXPECT_EQ(chunk_results[0].chunk_index, 1);
+
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(chunk_index_path);
+}
+
+TEST_F(MetadataStoreTest, LoadFaissIndex_IgnoresStaleSnapshot) {
+  // Arrange
+  std::filesystem::path index_path = temp_db_path_;
+  index_path += ".faiss";
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/stale.txt", "hash", FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+  auto store = std::make_unique<MetadataStore>(*db_manager_, index_path);
+  ASSERT_TRUE(store->load_faiss_index());
+
+  // Act - a write through another store leaves the snapshot behind the database
+  auto new_vector = magic_tests::TestUtilities::create_test_vector("newer", 1024);
+  metadata_store_->update_file_ai_analysis(file_id, new_vector);
+
+  // Assert - the snapshot is rejected and a fresh store rebuilds from the database
+  EXPECT_FALSE(store->load_faiss_index());
+  auto rebuilt = std::make_unique<MetadataStore>(*db_manager_, index_path);
+  auto results = rebuilt->search_similar_files(new_vector, 1);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_LT(results[0].distance, 0.1f);
+
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(std::filesystem::path(temp_db_path_.string() + ".chunks.faiss"));
+}
+
+TEST_F(MetadataStoreTest, DeferredIndexLoading_SearchesFindNothingUntilLoadIndexes) {
+  // Arrange
+  std::filesystem::path index_path = temp_db_path_;
+  index_path += ".faiss";
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/deferred.txt", "hash", FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+
+  // Act
+  auto store = std::make_unique<MetadataStore>(*db_manager_, index_path, VectorIndexOptions{},
+                                               MetadataStore::DEFAULT_CHUNK_SLAB_CACHE_BYTES,
+                                               MetadataStore::IndexLoading::Deferred);
+  EXPECT_TRUE(store->search_similar_files(file.summary_vector_embedding, 1).empty());
+  EXPECT_FALSE(std::filesystem::exists(index_path));
+  store->load_indexes();
+
+  // Assert - built from the database, persisted, and the vectors read in
+  auto results = store->search_similar_files(file.summary_vector_embedding, 1);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].id, file_id);
+  EXPECT_TRUE(std::filesystem::exists(index_path));
+  EXPECT_GT(store->prefault_vectors(), 0u);
+
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(std::filesystem::path(temp_db_path_.string() + ".chunks.faiss"));
+}
+
+TEST_F(MetadataStoreTest, WriteSnapshot_RestoredCopyServesWithoutARebuild) {
+  // Arrange
+  std::filesystem::path index_path = temp_db_path_;
+  index_path.replace_extension(".faiss");
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/snapshot.txt", "hash", FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+  auto store = std::make_unique<MetadataStore>(*db_manager_, index_path);
+  const auto dir = temp_db_path_.parent_path() / (temp_db_path_.stem().string() + "_snapshot");
+  size_t last_copied = 0;
+  size_t last_total = 0;
+
+  // Act
+  SnapshotOptions options;
+  options.pages_per_step = 1;
+  SnapshotInfo info = store->write_snapshot(dir, options, [&](size_t copied, size_t total) {
+    EXPECT_GE(copied, last_copied);
+    last_copied = copied;
+    last_total = total;
+  });
+
+  // Assert - a node on the copy loads current snapshots and finds the file
+  EXPECT_EQ(last_copied, info.bytes);
+  EXPECT_EQ(last_total, info.bytes);
+  {
+    auto restored_db = DatabaseManager::create();
+    restored_db->initialize(dir / temp_db_path_.filename(), "magic_folder_test_key", 1);
+    MetadataStore restored(*restored_db, dir / index_path.filename(), VectorIndexOptions{},
+                           MetadataStore::DEFAULT_CHUNK_SLAB_CACHE_BYTES,
+                           MetadataStore::IndexLoading::Deferred);
+    EXPECT_TRUE(restored.load_faiss_index());
+    auto results = restored.search_similar_files(file.summary_vector_embedding, 1);
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0].id, file_id);
+    restored_db->shutdown();
+  }
+  EXPECT_THROW(store->write_snapshot(dir), DatabaseBackupError);
+
+  store.reset();
+  std::filesystem::remove_all(dir);
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(std::filesystem::path(index_path).replace_extension(".chunks.faiss"));
+}
+
+TEST_F(MetadataStoreTest, EndBulkLoad_WaitsForThePins) {
+  MetadataStore::BulkLoadPin pin = metadata_store_->pin_bulk_load();
+  ASSERT_TRUE(metadata_store_->begin_bulk_load());
+
+  EXPECT_FALSE(metadata_store_->end_bulk_load());
+  EXPECT_TRUE(metadata_store_->bulk_loading());
+
+  pin = MetadataStore::BulkLoadPin();
+  EXPECT_TRUE(metadata_store_->end_bulk_load());
+  EXPECT_FALSE(metadata_store_->bulk_loading());
+}
+
+TEST_F(MetadataStoreTest, WriteSnapshot_RefusedDuringABulkLoad) {
+  const auto dir = temp_db_path_.parent_path() / (temp_db_path_.stem().string() + "_bulk");
+  ASSERT_TRUE(metadata_store_->begin_bulk_load());
+
+  EXPECT_THROW(metadata_store_->write_snapshot(dir), MetadataStoreError);
+
+  EXPECT_TRUE(metadata_store_->end_bulk_load());
+  std::filesystem::remove_all(dir);
+}
+
+TEST_F(MetadataStoreTest, LoadFaissIndex_IgnoresTamperedSnapshot) {
+  // Arrange
+  std::filesystem::path index_path = temp_db_path_;
+  index_path += ".faiss";
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/tampered.txt", "hash", FileType::Text, 1024, true);
+  magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+  auto store = std::make_unique<MetadataStore>(*db_manager_, index_path);
+
+  // Act - flip the last byte of the ciphertext
+  {
+    std::fstream snapshot(index_path, std::ios::in | std::ios::out | std::ios::binary);
+    snapshot.seekg(-1, std::ios::end);
+    char last = 0;
+    snapshot.get(last);
+    snapshot.seekp(-1, std::ios::end);
+    snapshot.put(static_cast<char>(last ^ 0x01));
+  }
+
+  // Assert
+  EXPECT_FALSE(store->load_faiss_index());
+
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(std::filesystem::path(temp_db_path_.string() + ".chunks.faiss"));
+}
+
+TEST_F(MetadataStoreTest, Initialize_MovesLegacyVectorBlobsIntoSegment) {
+  // Arrange - a row as written before vectors moved out of SQLite
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/test/legacy.txt", "hash", FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file);
+  {
+    PooledConnection conn(*db_manager_);
+    const auto &vector = file.summary_vector_embedding;
+    std::vector<char> blob(vector.size() * sizeof(float));
+    std::memcpy(blob.data(), vector.data(), blob.size());
+    *conn << "UPDATE files SET summary_vector_blob = ?, summary_vector_offset = NULL WHERE id = ?"
+          << blob << file_id;
+  }
+  metadata_store_.reset();
+  db_manager_->shutdown();
+  std::filesystem::remove(DatabaseManager::vector_store_path(temp_db_path_, "files"));
+
+  // Act
+  db_manager_->initialize(temp_db_path_, "magic_folder_test_key", 1);
+  metadata_store_ = std::make_shared<MetadataStore>(*db_manager_);
+
+  // Assert
+  auto retrieved = metadata_store_->get_file_metadata(file_id);
+  ASSERT_TRUE(retrieved.has_value());
+  EXPECT_EQ(retrieved->summary_vector_embedding, file.summary_vector_embedding);
+  auto results = metadata_store_->search_similar_files(file.summary_vector_embedding, 1);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].id, file_id);
+  int remaining_blobs = -1;
+  PooledConnection conn(*db_manager_);
+  *conn << "SELECT COUNT(*) FROM files WHERE summary_vector_blob IS NOT NULL" >> remaining_blobs;
+  EXPECT_EQ(remaining_blobs, 0);
+}
+
 // Integration tests
 TEST_F(MetadataStoreTest, CompleteWorkflow_FileStubToSearchable) {
   // Arrange
@@ -530,6 +1066,118 @@ TEST_F(MetadataStoreTest, SearchSimilarChunks_ValidFileIds) {
   }
 }
 
+// Test search_similar_chunks only considers the candidate files' chunks
+TEST_F(MetadataStoreTest, SearchSimilarChunks_RestrictedToCandidateFiles) {
+  // Arrange - chunks are indexed as they are stored, no rebuild needed
+  auto alpha_chunks = magic_tests::TestUtilities::create_test_chunks(3, "alpha");
+  int alpha_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_,
+      magic_tests::TestUtilities::create_test_file_metadata("/docs/alpha.txt", "hash_a",
+                                                            FileType::Text, 1024, true),
+      alpha_chunks);
+  auto beta_chunks = magic_tests::TestUtilities::create_test_chunks(3, "beta");
+  int beta_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_,
+      magic_tests::TestUtilities::create_test_file_metadata("/docs/beta.txt", "hash_b",
+                                                            FileType::Text, 1024, true),
+      beta_chunks);
+  const auto& query_vector = beta_chunks[0].vector_embedding;
+
+  // Act
+  auto alpha_results = metadata_store_->search_similar_chunks({alpha_id}, query_vector, 5);
+  auto beta_results = metadata_store_->search_similar_chunks({beta_id}, query_vector, 1);
+
+  // Assert - the best global match lives in beta, but alpha's search must not see it
+  ASSERT_EQ(alpha_results.size(), 3);
+  for (const auto& chunk_result : alpha_results) {
+    EXPECT_EQ(chunk_result.file_id, alpha_id);
+  }
+  ASSERT_EQ(beta_results.size(), 1);
+  EXPECT_EQ(beta_results[0].file_id, beta_id);
+  EXPECT_EQ(beta_results[0].chunk_index, 0);
+  EXPECT_LT(beta_results[0].distance, 0.001f);
+}
+
+TEST_F(MetadataStoreTest, ScanSimilarChunks_AgreesWithTheChunkIndex) {
+  auto alpha_chunks = magic_tests::TestUtilities::create_test_chunks(4, "alpha");
+  int alpha_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_,
+      magic_tests::TestUtilities::create_test_file_metadata("/docs/alpha.txt", "hash_a",
+                                                            FileType::Text, 1024, true),
+      alpha_chunks);
+  auto beta_chunks = magic_tests::TestUtilities::create_test_chunks(4, "beta");
+  int beta_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_,
+      magic_tests::TestUtilities::create_test_file_metadata("/docs/beta.txt", "hash_b",
+                                                            FileType::Text, 1024, true),
+      beta_chunks);
+  auto gamma_chunks = magic_tests::TestUtilities::create_test_chunks(2, "gamma");
+  magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_,
+      magic_tests::TestUtilities::create_test_file_metadata("/docs/gamma.txt", "hash_g",
+                                                            FileType::Text, 1024, true),
+      gamma_chunks);
+  const auto& query_vector = beta_chunks[1].vector_embedding;
+
+  auto indexed = metadata_store_->search_similar_chunks({alpha_id, beta_id}, query_vector, 5);
+  auto scanned = metadata_store_->scan_similar_chunks({alpha_id, beta_id}, query_vector, 5);
+
+  // Both are exact over a candidate set this small, so they must agree hit for hit
+  ASSERT_EQ(scanned.size(), 5);
+  ASSERT_EQ(indexed.size(), scanned.size());
+  for (size_t i = 0; i < scanned.size(); ++i) {
+    EXPECT_EQ(scanned[i].id, indexed[i].id) << "rank " << i;
+    EXPECT_NEAR(scanned[i].distance, indexed[i].distance, 1e-2f);
+    EXPECT_NE(scanned[i].file_id, 0);
+    EXPECT_FALSE(scanned[i].compressed_content.empty());
+  }
+  EXPECT_EQ(scanned[0].file_id, beta_id);
+  EXPECT_EQ(scanned[0].chunk_index, 1);
+
+  auto batch = metadata_store_->scan_similar_chunks_batch({{alpha_id}, {}},
+                                                          {query_vector, query_vector}, 10, false);
+  ASSERT_EQ(batch.size(), 2);
+  ASSERT_EQ(batch[0].size(), 4);
+  for (const auto& chunk : batch[0]) {
+    EXPECT_EQ(chunk.file_id, alpha_id);
+    EXPECT_TRUE(chunk.compressed_content.empty());
+  }
+  EXPECT_TRUE(batch[1].empty());
+}
+
+TEST_F(MetadataStoreTest, ScanSimilarChunks_CachesSlabsUntilTheFileChanges) {
+  auto chunks = magic_tests::TestUtilities::create_test_chunks(3, "alpha");
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_,
+      magic_tests::TestUtilities::create_test_file_metadata("/docs/alpha.txt", "hash_a",
+                                                            FileType::Text, 1024, true),
+      chunks);
+  const auto& query_vector = chunks[2].vector_embedding;
+
+  auto first = metadata_store_->scan_similar_chunks({file_id}, query_vector, 1);
+  auto second = metadata_store_->scan_similar_chunks({file_id}, query_vector, 1);
+  ASSERT_EQ(first.size(), 1);
+  ASSERT_EQ(second.size(), 1);
+  EXPECT_EQ(second[0].id, first[0].id);
+  auto stats = metadata_store_->chunk_slab_cache_stats();
+  EXPECT_EQ(stats.files, 1u);
+  EXPECT_EQ(stats.hits, 1u);
+
+  // Re-chunking the file must drop its slab, or the scan would score the old vectors
+  auto replacement = magic_tests::TestUtilities::create_test_chunks(3, "beta");
+  metadata_store_->upsert_chunk_metadata(file_id, chunks_to_processed_chunks(replacement));
+  EXPECT_EQ(metadata_store_->chunk_slab_cache_stats().files, 0u);
+  auto rescanned =
+      metadata_store_->scan_similar_chunks({file_id}, replacement[0].vector_embedding, 1);
+  ASSERT_EQ(rescanned.size(), 1);
+  EXPECT_EQ(rescanned[0].chunk_index, 0);
+  EXPECT_LT(rescanned[0].distance, 0.001f);
+
+  metadata_store_->delete_file_metadata("/docs/alpha.txt");
+  EXPECT_EQ(metadata_store_->chunk_slab_cache_stats().files, 0u);
+  EXPECT_TRUE(metadata_store_->scan_similar_chunks({file_id}, query_vector, 1).empty());
+}
+
 // Test search_similar_chunks with empty file IDs
 TEST_F(MetadataStoreTest, SearchSimilarChunks_EmptyFileIds) {
   // Arrange
@@ -702,6 +1350,304 @@ TEST_F(MetadataStoreTest, FillChunkMetadata_NonExistentChunkIds) {
   EXPECT_EQ(chunk_results[0].distance, 0.1f);
 }
 
+TEST_F(MetadataStoreTest, SampleChunkContents_BoundedByLimitAndStore) {
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/docs/sampled.txt", "sampled_hash", magic_core::FileType::Text, 1024, true);
+  magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, file, magic_tests::TestUtilities::create_test_chunks(5, "sample"));
+
+  EXPECT_EQ(metadata_store_->count_chunks(), 5);
+  EXPECT_EQ(metadata_store_->sample_chunk_contents(3).size(), 3u);
+  auto all = metadata_store_->sample_chunk_contents(50);
+  EXPECT_EQ(all.size(), 5u);
+  for (const auto& content : all) {
+    EXPECT_FALSE(content.empty());
+  }
+  EXPECT_TRUE(metadata_store_->sample_chunk_contents(0).empty());
+}
+
+TEST_F(MetadataStoreTest, ReadAllVectors_ReturnsStoredSummaryAndChunkVectors) {
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/docs/dumped.txt", "dumped_hash", magic_core::FileType::Text, 1024, true);
+  const int file_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, file, magic_tests::TestUtilities::create_test_chunks(3, "dump"));
+
+  std::vector<faiss::idx_t> ids;
+  std::vector<float> vectors;
+  metadata_store_->read_all_vectors("files", ids, vectors);
+  ASSERT_EQ(ids.size(), 1u);
+  EXPECT_EQ(ids[0], file_id);
+  EXPECT_EQ(vectors, file.summary_vector_embedding);
+
+  metadata_store_->read_all_vectors("chunks", ids, vectors);
+  EXPECT_EQ(ids.size(), 3u);
+  EXPECT_EQ(vectors.size(), 3u * magic_core::MetadataStore::DEFAULT_VECTOR_DIMENSION);
+
+  EXPECT_THROW(metadata_store_->read_all_vectors("task_queue", ids, vectors),
+               magic_core::MetadataStoreError);
+}
+
+TEST_F(MetadataStoreTest, CompressionDictionaries_StoredOldestFirst) {
+  EXPECT_TRUE(metadata_store_->get_compression_dictionaries().empty());
+  const auto now = std::chrono::system_clock::now();
+  metadata_store_->save_compression_dictionary(
+      {42, {'d', 'i', 'c', 't'}, 500, 1000, now - std::chrono::hours(1)});
+  metadata_store_->save_compression_dictionary({7, {'n', 'e', 'w'}, 800, 2500, now});
+
+  auto dictionaries = metadata_store_->get_compression_dictionaries();
+  ASSERT_EQ(dictionaries.size(), 2u);
+  EXPECT_EQ(dictionaries[0].id, 42u);
+  EXPECT_EQ(dictionaries[0].dictionary, (std::vector<char>{'d', 'i', 'c', 't'}));
+  EXPECT_EQ(dictionaries[0].sample_count, 500);
+  EXPECT_EQ(dictionaries[1].id, 7u);
+  EXPECT_EQ(dictionaries[1].chunk_count, 2500);
+}
+
+TEST_F(MetadataStoreTest, SearchChunksLexical_MatchesExactIdentifiers) {
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/src/net.cpp", "lexical_hash", magic_core::FileType::Code, 1024, true);
+  std::vector<Chunk> chunks = {
+      magic_tests::TestUtilities::create_test_chunk_with_embedding(
+          "if (errno == ECONNRESET) return ERR_CONN_RESET;", 0, "net"),
+      magic_tests::TestUtilities::create_test_chunk_with_embedding(
+          "connection reset handling is described elsewhere", 1, "net"),
+      magic_tests::TestUtilities::create_test_chunk_with_embedding("unrelated text", 2, "net")};
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, file,
+                                                                          chunks);
+
+  // Underscores are word characters, so the identifier is one token
+  auto hits = metadata_store_->search_chunks_lexical("ERR_CONN_RESET", 10);
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].file_id, file_id);
+  EXPECT_EQ(hits[0].chunk_index, 0);
+  EXPECT_FALSE(hits[0].compressed_content.empty());
+
+  // Any word matches, best bm25 first
+  hits = metadata_store_->search_chunks_lexical("connection reset", 10);
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].chunk_index, 1);
+  hits = metadata_store_->search_chunks_lexical("ECONNRESET handling", 10, false);
+  ASSERT_EQ(hits.size(), 2u);
+  EXPECT_TRUE(hits[0].compressed_content.empty());
+  EXPECT_LE(hits[0].distance, hits[1].distance);
+
+  EXPECT_TRUE(metadata_store_->search_chunks_lexical("", 10).empty());
+  EXPECT_TRUE(metadata_store_->search_chunks_lexical("\"\" ()*", 10).empty());
+  EXPECT_TRUE(metadata_store_->search_chunks_lexical("ERR_CONN_RESET", 0).empty());
+}
+
+TEST_F(MetadataStoreTest, SearchChunksLexical_ForgetsDeletedFiles) {
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/docs/gone.txt", "gone_hash", magic_core::FileType::Text, 1024, true);
+  magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, file, magic_tests::TestUtilities::create_test_chunks(3, "ephemeral"));
+  ASSERT_EQ(metadata_store_->search_chunks_lexical("ephemeral", 10).size(), 3u);
+
+  metadata_store_->delete_file_metadata("/docs/gone.txt");
+  EXPECT_TRUE(metadata_store_->search_chunks_lexical("ephemeral", 10).empty());
+  EXPECT_TRUE(metadata_store_->chunks_missing_text(10).empty());
+}
+
+TEST_F(MetadataStoreTest, SearchChunksLexical_AppliesTheFilterInTheQuery) {
+  for (const auto& [path, type] : {std::pair{"/src/retry.cpp", FileType::Code},
+                                   std::pair{"/docs/retry.md", FileType::Markdown}}) {
+    auto file = magic_tests::TestUtilities::create_test_file_metadata(
+        path, std::string("hash_") + path, type, 1024, true);
+    magic_tests::TestUtilities::create_complete_file_in_store(
+        metadata_store_, file, magic_tests::TestUtilities::create_test_chunks(2, "retry backoff"));
+  }
+  ASSERT_EQ(metadata_store_->search_chunks_lexical("backoff", 10).size(), 4u);
+
+  const int docs_id = metadata_store_->get_basic_file_metadata("/docs/retry.md")->id;
+  SearchFilter docs;
+  docs.path_prefix = "/docs/";
+  auto hits = metadata_store_->search_chunks_lexical("backoff", 10, true, docs);
+  ASSERT_EQ(hits.size(), 2u);
+  for (const auto& hit : hits) {
+    EXPECT_EQ(hit.file_id, docs_id);
+  }
+  SearchFilter code;
+  code.file_types = {FileType::Code};
+  hits = metadata_store_->search_chunks_lexical("backoff", 10, true, code);
+  ASSERT_EQ(hits.size(), 2u);
+  for (const auto& hit : hits) {
+    EXPECT_NE(hit.file_id, docs_id);
+  }
+}
+
+TEST_F(MetadataStoreTest, IndexChunkText_BackfillsChunksMissingFromTheIndex) {
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/docs/old.txt", "old_hash", magic_core::FileType::Text, 1024, true);
+  magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, file, magic_tests::TestUtilities::create_test_chunks(3, "legacy"));
+  EXPECT_TRUE(metadata_store_->chunks_missing_text(10).empty());
+  {
+    // As stored before the index existed
+    PooledConnection conn(*db_manager_);
+    *conn << "DELETE FROM chunks_fts;";
+  }
+
+  auto missing = metadata_store_->chunks_missing_text(2);
+  ASSERT_EQ(missing.size(), 2u);
+  EXPECT_LT(missing[0].first, missing[1].first);
+  missing = metadata_store_->chunks_missing_text(10);
+  ASSERT_EQ(missing.size(), 3u);
+
+  std::vector<std::pair<int64_t, std::string>> texts;
+  for (const auto& [id, content] : missing) {
+    texts.emplace_back(id, std::string(content.begin(), content.end()));
+  }
+  // Ids that are gone or already indexed are skipped
+  texts.emplace_back(999999, "phantom");
+  texts.push_back(texts.front());
+  const auto generation = metadata_store_->search_generation();
+  metadata_store_->index_chunk_text(texts);
+
+  EXPECT_TRUE(metadata_store_->chunks_missing_text(10).empty());
+  EXPECT_EQ(metadata_store_->search_chunks_lexical("legacy", 10).size(), 3u);
+  EXPECT_TRUE(metadata_store_->search_chunks_lexical("phantom", 10).empty());
+  EXPECT_GT(metadata_store_->search_generation(), generation);
+}
+
+TEST_F(MetadataStoreTest, BulkLoad_DefersTheIndexesUntilItEnds) {
+  ASSERT_TRUE(metadata_store_->begin_bulk_load());
+  EXPECT_FALSE(metadata_store_->begin_bulk_load());
+  EXPECT_TRUE(metadata_store_->bulk_loading());
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/import/bulk.txt", "bulk_hash", magic_core::FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, file, magic_tests::TestUtilities::create_test_chunks(3, "imported"));
+
+  // Stored, but neither the vector indexes nor the full-text index have seen it
+  EXPECT_EQ(metadata_store_->get_stored_chunks(file_id).size(), 3u);
+  EXPECT_EQ(metadata_store_->file_index_stats().size, 0);
+  EXPECT_EQ(metadata_store_->chunk_index_stats().size, 0);
+  EXPECT_TRUE(metadata_store_->search_chunks_lexical("imported", 10).empty());
+  auto missing = metadata_store_->chunks_missing_text(10);
+  ASSERT_EQ(missing.size(), 3u);
+  EXPECT_EQ(metadata_store_->chunks_missing_text(10, missing[0].first).size(), 2u);
+
+  ASSERT_TRUE(metadata_store_->end_bulk_load());
+  EXPECT_FALSE(metadata_store_->end_bulk_load());
+  EXPECT_FALSE(metadata_store_->bulk_loading());
+  EXPECT_EQ(metadata_store_->file_index_stats().size, 1);
+  EXPECT_EQ(metadata_store_->chunk_index_stats().size, 3);
+  auto hits = metadata_store_->search_similar_files(file.summary_vector_embedding, 1);
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].id, file_id);
+
+  // Writes after the load update the indexes as usual
+  auto later = magic_tests::TestUtilities::create_test_file_metadata(
+      "/import/later.txt", "later_hash", magic_core::FileType::Text, 1024, true);
+  magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, later, magic_tests::TestUtilities::create_test_chunks(2, "afterwards"));
+  EXPECT_EQ(metadata_store_->chunk_index_stats().size, 5);
+  EXPECT_EQ(metadata_store_->search_chunks_lexical("afterwards", 10).size(), 2u);
+}
+
+TEST_F(MetadataStoreTest, AddDuplicateFiles_SharesTheStoredContent) {
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/share/report.pdf", "report_hash", magic_core::FileType::PDF, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, file, magic_tests::TestUtilities::create_test_chunks(3, "report"));
+  const int64_t chunks_before = metadata_store_->count_chunks();
+
+  auto added = metadata_store_->add_duplicate_files(
+      {magic_tests::TestUtilities::create_test_basic_file_metadata("/mail/report.pdf",
+                                                                   "report_hash"),
+       magic_tests::TestUtilities::create_test_basic_file_metadata("/share/report.pdf",
+                                                                   "report_hash"),
+       magic_tests::TestUtilities::create_test_basic_file_metadata("/mail/other.pdf",
+                                                                   "unknown_hash")});
+  // The stored path itself and content nobody holds are left alone
+  EXPECT_EQ(added, (std::vector<bool>{true, false, false}));
+  EXPECT_FALSE(metadata_store_->add_duplicate_files(
+      {magic_tests::TestUtilities::create_test_basic_file_metadata("/mail/report.pdf",
+                                                                   "report_hash")})
+                   .front());
+  EXPECT_FALSE(metadata_store_->get_basic_file_metadata("/mail/other.pdf").has_value());
+
+  auto duplicate = metadata_store_->get_basic_file_metadata("/mail/report.pdf");
+  ASSERT_TRUE(duplicate.has_value());
+  EXPECT_EQ(duplicate->content_source_id, file_id);
+  EXPECT_EQ(duplicate->processing_status, ProcessingStatus::PROCESSED);
+  EXPECT_EQ(metadata_store_->count_chunks(), chunks_before);
+  EXPECT_EQ(metadata_store_->file_index_stats().size, 1);
+
+  auto hits = metadata_store_->search_similar_files(file.summary_vector_embedding, 5);
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].id, file_id);
+  EXPECT_EQ(hits[0].duplicate_paths, std::vector<std::string>{"/mail/report.pdf"});
+
+  // A filter matching only the duplicate's path finds the shared content
+  SearchFilter mail;
+  mail.path_prefix = "/mail/";
+  hits = metadata_store_->search_similar_files(file.summary_vector_embedding, 5, {}, mail);
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].id, file_id);
+}
+
+TEST_F(MetadataStoreTest, DeleteFileMetadata_HandsTheContentToADuplicate) {
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/a/doc.txt", "doc_hash", magic_core::FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, file, magic_tests::TestUtilities::create_test_chunks(3, "doc"));
+  metadata_store_->add_duplicate_files(
+      {magic_tests::TestUtilities::create_test_basic_file_metadata("/b/doc.txt", "doc_hash"),
+       magic_tests::TestUtilities::create_test_basic_file_metadata("/c/doc.txt", "doc_hash")});
+  const int heir = metadata_store_->get_basic_file_metadata("/b/doc.txt")->id;
+
+  metadata_store_->delete_file_metadata("/a/doc.txt");
+
+  EXPECT_FALSE(metadata_store_->get_basic_file_metadata(file_id).has_value());
+  EXPECT_EQ(metadata_store_->get_basic_file_metadata(heir)->content_source_id, 0);
+  EXPECT_EQ(metadata_store_->get_basic_file_metadata("/c/doc.txt")->content_source_id, heir);
+  EXPECT_EQ(metadata_store_->get_stored_chunks(heir).size(), 3u);
+  EXPECT_EQ(metadata_store_->get_file_summary_vector(heir), file.summary_vector_embedding);
+  auto hits = metadata_store_->search_similar_files(file.summary_vector_embedding, 5);
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].id, heir);
+  EXPECT_EQ(hits[0].duplicate_paths, std::vector<std::string>{"/c/doc.txt"});
+  EXPECT_EQ(metadata_store_->search_similar_chunks({heir}, file.summary_vector_embedding, 5).size(),
+            3u);
+
+  // Removing the rest of the directory the content lives in leaves it with the last path
+  EXPECT_EQ(metadata_store_->delete_files_under("/b"), 1u);
+  EXPECT_EQ(metadata_store_->get_basic_file_metadata("/c/doc.txt")->content_source_id, 0);
+  EXPECT_EQ(metadata_store_->search_chunks_lexical("doc", 10).size(), 3u);
+}
+
+TEST_F(MetadataStoreTest, UpsertFileStub_ChangedContentLeavesTheDuplicatesTheOldOne) {
+  auto file = magic_tests::TestUtilities::create_test_file_metadata(
+      "/a/notes.txt", "old_hash", magic_core::FileType::Text, 1024, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(
+      metadata_store_, file, magic_tests::TestUtilities::create_test_chunks(2, "notes"));
+  metadata_store_->add_duplicate_files(
+      {magic_tests::TestUtilities::create_test_basic_file_metadata("/b/notes.txt", "old_hash")});
+  const int heir = metadata_store_->get_basic_file_metadata("/b/notes.txt")->id;
+
+  metadata_store_->upsert_file_stub(magic_tests::TestUtilities::create_test_basic_file_metadata(
+      "/a/notes.txt", "new_hash", magic_core::FileType::Text, 1024, ProcessingStatus::QUEUED));
+
+  EXPECT_TRUE(metadata_store_->get_stored_chunks(file_id).empty());
+  EXPECT_EQ(metadata_store_->get_stored_chunks(heir).size(), 2u);
+  EXPECT_EQ(metadata_store_->get_basic_file_metadata(heir)->content_source_id, 0);
+  EXPECT_EQ(metadata_store_->get_basic_file_metadata(heir)->processing_status,
+            ProcessingStatus::PROCESSED);
+  auto hits = metadata_store_->search_similar_files(file.summary_vector_embedding, 5);
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].id, heir);
+}
+
+TEST(MetadataStoreTextMatchTest, TextMatchExpression_QuotesEachWord) {
+  EXPECT_EQ(MetadataStore::text_match_expression("ERR_CONN_RESET"), "\"ERR_CONN_RESET\"");
+  EXPECT_EQ(MetadataStore::text_match_expression("  open(file, \"r\") OR NOT"),
+            "\"open\" OR \"file\" OR \"r\" OR \"OR\" OR \"NOT\"");
+  EXPECT_EQ(MetadataStore::text_match_expression("caf\xC3\xA9 v2.1"),
+            "\"caf\xC3\xA9\" OR \"v2\" OR \"1\"");
+  EXPECT_EQ(MetadataStore::text_match_expression("*:-^"), "");
+}
+
 // Test search_similar_chunks with mixed file types
 TEST_F(MetadataStoreTest, SearchSimilarChunks_MixedFileTypes) {
   // Arrange - Create files of different types with chunks
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <bit>
+#include <stdexcept>
+#include <string>
+
+#include "magic_core/db/near_duplicate_index.hpp"
+
+namespace magic_core {
+
+namespace {
+
+// A ~200 word contract chunk with a date and a name filled in
+std::string contract(const std::string& date, const std::string& name) {
+  return "This agreement is made on " + date + " between the Company and " + name +
+         ", who agrees to the terms set out below. The employee will report to the head of the "
+         "department and will be paid monthly in arrears. Either party may end this agreement "
+         "with four weeks notice in writing. Holidays accrue at the rate of two days for every "
+         "month worked, and unused days lapse at the end of the year. Confidential information "
+         "must not be shared with third parties during or after employment. The employee shall "
+         "comply with all policies of the Company as amended from time to time, including the "
+         "policies on data protection, anti bribery, health and safety and the use of company "
+         "equipment. Any breach may lead to disciplinary action up to and including dismissal. "
+         "Expenses incurred in the course of duties will be reimbursed on presentation of "
+         "receipts within thirty days. Working hours are nine to five thirty, Monday to Friday, "
+         "with an unpaid lunch break of one hour. Overtime is paid at time and a half when "
+         "agreed in advance by a manager. The place of work is the office of the Company, "
+         "although remote work may be agreed.";
+}
+
+const std::string REPORT =
+    "Quarterly revenue grew by eight percent, driven by stronger demand in the northern region "
+    "and lower shipping costs. Operating margin improved as the new warehouse came online, "
+    "although marketing spend rose ahead of the spring campaign. The board approved a dividend "
+    "and a share buyback, and hiring will resume in the autumn once the budget is agreed.";
+
+int distance(const std::string& a, const std::string& b) {
+  return std::popcount(*NearDuplicateIndex::fingerprint(a) ^ *NearDuplicateIndex::fingerprint(b));
+}
+
+}  // namespace
+
+TEST(NearDuplicateIndexTest, Fingerprint_TemplatedTextsLandFewBitsApart) {
+  const std::string alice = contract("1 March 2024", "Alice Smith");
+  const char* months[] = {"January", "April", "June", "July", "October", "December"};
+  const char* names[] = {"Bob Jones", "Carol White", "Dan Brown", "Eve Black", "Frank Green"};
+
+  // SimHash distances scatter around their mean; most fills of the template fall within the
+  // default distance and none anywhere near unrelated text
+  int within = 0;
+  int filled = 0;
+  for (const char* month : months) {
+    for (const char* name : names) {
+      const int bits = distance(alice, contract(std::string("3 ") + month + " 2020", name));
+      within += bits <= NearDuplicateIndex::DEFAULT_DISTANCE ? 1 : 0;
+      EXPECT_LT(bits, 2 * NearDuplicateIndex::MAX_DISTANCE);
+      ++filled;
+    }
+  }
+  EXPECT_GE(within * 10, filled * 7);
+  EXPECT_GT(distance(alice, REPORT), 2 * NearDuplicateIndex::MAX_DISTANCE);
+}
+
+TEST(NearDuplicateIndexTest, Fingerprint_IgnoresCasePunctuationAndNumbers) {
+  const std::string alice = contract("1 March 2024", "Alice Smith");
+  std::string shouted = alice;
+  for (char& c : shouted) {
+    c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+  }
+
+  EXPECT_EQ(distance(alice, shouted), 0);
+  EXPECT_EQ(distance(alice, contract("7 March 1999", "Alice Smith")), 0);
+  EXPECT_EQ(distance(REPORT, "  " + REPORT + " --"), 0);
+}
+
+TEST(NearDuplicateIndexTest, Fingerprint_ShortTextsHaveNone) {
+  EXPECT_FALSE(NearDuplicateIndex::fingerprint("").has_value());
+  EXPECT_FALSE(
+      NearDuplicateIndex::fingerprint("Signed on 1 March 2024 by Alice Smith.").has_value());
+  EXPECT_TRUE(NearDuplicateIndex::fingerprint(REPORT).has_value());
+}
+
+TEST(NearDuplicateIndexTest, Find_ReturnsNearestWithinDistance) {
+  NearDuplicateIndex index(16, 3);
+  index.insert(0b0000, "zero");
+  index.insert(0b0111, "three");
+
+  EXPECT_EQ(index.find(0b0001), "zero");
+  EXPECT_EQ(index.find(0b0110), "three");
+  EXPECT_EQ(index.find(0b1111), "three");
+  EXPECT_FALSE(index.find(~uint64_t{0}).has_value());
+  // Four bits off everything indexed, across bands
+  EXPECT_FALSE(index.find((uint64_t{1} << 20) | (uint64_t{1} << 40) | 0b1101).has_value());
+}
+
+TEST(NearDuplicateIndexTest, Insert_EvictsOldestOnceFull) {
+  NearDuplicateIndex index(2, 0);
+  index.insert(1, "a");
+  index.insert(2, "b");
+  index.insert(3, "c");
+
+  EXPECT_EQ(index.size(), 2u);
+  EXPECT_FALSE(index.find(1).has_value());
+  EXPECT_EQ(index.find(2), "b");
+  EXPECT_EQ(index.find(3), "c");
+
+  index.clear();
+  EXPECT_EQ(index.size(), 0u);
+  EXPECT_FALSE(index.find(3).has_value());
+}
+
+TEST(NearDuplicateIndexTest, RejectsDistancesItCannotBand) {
+  EXPECT_THROW(NearDuplicateIndex(16, -1), std::invalid_argument);
+  EXPECT_THROW(NearDuplicateIndex(16, NearDuplicateIndex::MAX_DISTANCE + 1),
+               std::invalid_argument);
+  NearDuplicateIndex disabled(0);
+  disabled.insert(1, "a");
+  EXPECT_FALSE(disabled.find(1).has_value());
+}
+
+}  // namespace magic_core
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "magic_core/db/schema_migrations.hpp"
+
+namespace magic_core {
+
+class SchemaMigrationsTest : public ::testing::Test {
+ protected:
+  int count_objects(const std::string &type, const std::string &name) {
+    int count = 0;
+    db_ << "SELECT COUNT(*) FROM sqlite_master WHERE type = ? AND name = ?" << type << name >>
+        count;
+    return count;
+  }
+
+  std::string query_plan(const std::string &sql) {
+    std::string plan;
+    db_ << "EXPLAIN QUERY PLAN " + sql >> [&](int, int, int, std::string detail) {
+      plan += detail + "\n";
+    };
+    return plan;
+  }
+
+  sqlite::database db_{":memory:"};
+};
+
+TEST_F(SchemaMigrationsTest, MigrateSchema_NewDatabaseReachesLatestVersion) {
+  EXPECT_EQ(schema_version(db_), 0);
+
+  migrate_schema(db_);
+
+  EXPECT_EQ(schema_version(db_), latest_schema_version());
+  for (const char *table : {"files", "chunks", "task_queue", "task_progress", "embedding_cache",
+                            "index_generations", "vector_segments"}) {
+    EXPECT_EQ(count_objects("table", table), 1) << table;
+  }
+  EXPECT_EQ(count_objects("index", "idx_chunks_file_id_chunk_index"), 1);
+  EXPECT_EQ(count_objects("index", "idx_files_file_hash"), 1);
+  EXPECT_EQ(count_objects("index", "idx_chunks_file_id"), 0);
+  int fk_on = 0;
+  db_ << "PRAGMA foreign_keys;" >> fk_on;
+  EXPECT_EQ(fk_on, 1);
+}
+
+TEST_F(SchemaMigrationsTest, MigrateSchema_HotLookupsUseCoveringIndexes) {
+  migrate_schema(db_);
+
+  EXPECT_NE(query_plan("SELECT processing_status FROM files WHERE file_hash = 'h'")
+                .find("COVERING INDEX idx_files_file_hash"),
+            std::string::npos);
+  EXPECT_NE(query_plan("SELECT id, file_id FROM chunks WHERE file_id IN (1, 2)")
+                .find("COVERING INDEX idx_chunks_file_id_chunk_index"),
+            std::string::npos);
+  const std::string ordered = query_plan(
+      "SELECT id, content FROM chunks WHERE file_id IN (1, 2) ORDER BY file_id, chunk_index");
+  EXPECT_NE(ordered.find("idx_chunks_file_id_chunk_index"), std::string::npos);
+  EXPECT_EQ(ordered.find("TEMP B-TREE"), std::string::npos);
+}
+
+TEST_F(SchemaMigrationsTest, MigrateSchema_RunsOnlyStepsNotYetRecorded) {
+  migrate_schema(db_);
+  db_ << "INSERT INTO task_queue (task_type, created_at, updated_at) VALUES ('PROCESS_FILE', 1, 2)";
+  db_ << "DROP INDEX idx_files_file_hash";
+  db_ << "PRAGMA user_version = " + std::to_string(latest_schema_version() - 1) + ";";
+
+  migrate_schema(db_);
+
+  EXPECT_EQ(schema_version(db_), latest_schema_version());
+  EXPECT_EQ(count_objects("index", "idx_files_file_hash"), 1);
+  int tasks = 0;
+  db_ << "SELECT COUNT(*) FROM task_queue" >> tasks;
+  EXPECT_EQ(tasks, 1);
+
+  // Already current: nothing runs
+  db_ << "DROP INDEX idx_files_file_hash";
+  migrate_schema(db_);
+  EXPECT_EQ(count_objects("index", "idx_files_file_hash"), 0);
+}
+
+TEST_F(SchemaMigrationsTest, MigrateSchema_CoalescesPendingDuplicatesIntoTheNewest) {
+  migrate_schema(db_);
+  db_ << "DROP INDEX idx_task_queue_pending_path";
+  for (int i = 0; i < 3; ++i) {
+    db_ << "INSERT INTO task_queue (task_type, target_path, status, created_at, updated_at) "
+           "VALUES ('PROCESS_FILE', '/a.txt', 'PENDING', 1, 2)";
+  }
+  db_ << "INSERT INTO task_queue (task_type, target_path, status, created_at, updated_at) "
+         "VALUES ('PROCESS_FILE', '/b.txt', 'PENDING', 1, 2)";
+  db_ << "PRAGMA user_version = 12;";
+
+  migrate_schema(db_);
+
+  std::string pending;
+  db_ << "SELECT GROUP_CONCAT(id) FROM (SELECT id FROM task_queue WHERE status = 'PENDING' "
+         "ORDER BY id)" >>
+      pending;
+  EXPECT_EQ(pending, "3,4");
+  EXPECT_EQ(count_objects("index", "idx_task_queue_pending_path"), 1);
+  EXPECT_THROW(db_ << "INSERT INTO task_queue (task_type, target_path, status, created_at, "
+                      "updated_at) VALUES ('PROCESS_FILE', '/b.txt', 'PENDING', 1, 2)",
+               sqlite::sqlite_exception);
+}
+
+TEST_F(SchemaMigrationsTest, MigrateSchema_RejectsNewerDatabase) {
+  db_ << "PRAGMA user_version = " + std::to_string(latest_schema_version() + 1) + ";";
+
+  EXPECT_THROW(migrate_schema(db_), SchemaMigrationError);
+  EXPECT_EQ(count_objects("table", "files"), 0);
+}
+
+}  // namespace magic_core
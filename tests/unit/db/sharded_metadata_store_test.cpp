@@ -0,0 +1,237 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "magic_core/db/sharded_metadata_store.hpp"
+#include "magic_core/db/shard_map.hpp"
+#include "utilities_test.hpp"
+
+namespace magic_core {
+
+TEST(ShardMapTest, PathHash_IsStableAndInRange) {
+  ShardMap map(4);
+  std::vector<bool> used(4, false);
+  for (int i = 0; i < 64; ++i) {
+    const std::string path = "/docs/file" + std::to_string(i) + ".txt";
+    const size_t shard = map.shard_for_path(path);
+    ASSERT_LT(shard, 4u);
+    EXPECT_EQ(shard, ShardMap(4).shard_for_path(path));
+    used[shard] = true;
+  }
+  EXPECT_TRUE(std::all_of(used.begin(), used.end(), [](bool u) { return u; }));
+  EXPECT_EQ(ShardMap().shard_for_path("/anything"), 0u);
+}
+
+TEST(ShardMapTest, FolderRoot_PicksTheLongestRootAndHashesTheRest) {
+  ShardMap map(3, ShardingStrategy::FolderRoot, {"/work", "/work/archive/", "/photos"});
+  EXPECT_EQ(map.shard_for_path("/work/report.md"), 0u);
+  EXPECT_EQ(map.shard_for_path("/work/archive/2019/old.md"), 1u);
+  EXPECT_EQ(map.shard_for_path("/photos/cat.png"), 2u);
+  // A sibling sharing a prefix is not under the root
+  EXPECT_EQ(map.shard_for_path("/workshop/notes.md"),
+            ShardMap(3).shard_for_path("/workshop/notes.md"));
+  EXPECT_EQ(parse_sharding_strategy("folder"), ShardingStrategy::FolderRoot);
+  EXPECT_THROW(parse_sharding_strategy("round_robin"), ShardMapError);
+  EXPECT_THROW(ShardMap(0), ShardMapError);
+  EXPECT_THROW(ShardMap(ShardMap::MAX_SHARDS + 1), ShardMapError);
+}
+
+TEST(ShardMapTest, IdRanges_NameTheirShard) {
+  ShardMap map(3);
+  EXPECT_EQ(ShardMap::first_id(0), 1);
+  EXPECT_EQ(map.shard_for_id(1), 0u);
+  EXPECT_EQ(map.shard_for_id(ShardMap::first_id(1) - 1), 0u);
+  EXPECT_EQ(map.shard_for_id(ShardMap::first_id(1)), 1u);
+  EXPECT_EQ(map.shard_for_id(ShardMap::first_id(2) + 5), 2u);
+  EXPECT_EQ(map.shard_for_id(ShardMap::last_id(0)), 0u);
+  EXPECT_EQ(ShardMap::last_id(0) + 1, ShardMap::first_id(1));
+  // The last of 16 ranges stops at the largest int
+  EXPECT_EQ(ShardMap::last_id(ShardMap::MAX_SHARDS - 1), std::numeric_limits<int32_t>::max());
+  EXPECT_EQ(ShardMap::shard_db_path("/data/metadata.db", 0), "/data/metadata.db");
+  EXPECT_EQ(ShardMap::shard_db_path("/data/metadata.db", 2), "/data/metadata.shard2.db");
+}
+
+TEST(ShardMapTest, Collections_OwnTheirRootsAndDefaultTheRest) {
+  ShardMap map = ShardMap::for_collections({{"work", "/home/me/work/"}, {"photos", "/pics"}});
+  ASSERT_TRUE(map.has_collections());
+  EXPECT_EQ(map.shard_count(), 3u);
+  EXPECT_EQ(map.collection_name(0), ShardMap::DEFAULT_COLLECTION);
+  EXPECT_EQ(map.collection_root(1), "/home/me/work");
+  EXPECT_EQ(map.collection_shard("photos"), 2u);
+  EXPECT_FALSE(map.collection_shard("music").has_value());
+  EXPECT_EQ(map.shard_for_path("/home/me/work/plan.md"), 1u);
+  EXPECT_EQ(map.shard_for_path("/pics/cat.png"), 2u);
+  EXPECT_EQ(map.shard_for_path("/home/me/notes.txt"), 0u);
+  EXPECT_EQ(map.shard_for_path("/picsfolder/a.png"), 0u);
+  EXPECT_FALSE(ShardMap(2).has_collections());
+
+  EXPECT_THROW(ShardMap::for_collections({{"a", "/x"}, {"a", "/y"}}), ShardMapError);
+  EXPECT_THROW(ShardMap::for_collections({{"a", "/x"}, {"b", "/x/"}}), ShardMapError);
+  EXPECT_THROW(ShardMap::for_collections({{ShardMap::DEFAULT_COLLECTION, "/x"}}), ShardMapError);
+  EXPECT_THROW(ShardMap::for_collections({{"a", ""}}), ShardMapError);
+}
+
+class ShardedMetadataStoreTest : public magic_tests::MetadataStoreTestBase {
+ protected:
+  void SetUp() override {
+    MetadataStoreTestBase::SetUp();
+    second_db_path_ = ShardMap::shard_db_path(temp_db_path_, 1);
+    second_db_ = DatabaseManager::create();
+    second_db_->initialize(second_db_path_, "magic_folder_test_key", /*pool_size*/ 1);
+    second_db_->reserve_row_ids(ShardMap::first_id(1), ShardMap::last_id(1));
+    second_store_ = std::make_shared<MetadataStore>(*second_db_);
+    sharded_ = std::make_shared<ShardedMetadataStore>(
+        ShardMap(2, ShardingStrategy::FolderRoot, {"/first", "/second"}),
+        std::vector<std::shared_ptr<MetadataStore>>{metadata_store_, second_store_});
+  }
+
+  void TearDown() override {
+    sharded_.reset();
+    second_store_.reset();
+    second_db_->shutdown();
+    magic_tests::TestUtilities::cleanup_temp_db(second_db_path_);
+    MetadataStoreTestBase::TearDown();
+  }
+
+  int add_file(const std::string &path) {
+    auto file = magic_tests::TestUtilities::create_test_file_metadata(path, "hash:" + path,
+                                                                      FileType::Text, 1024, true);
+    return magic_tests::TestUtilities::create_complete_file_in_store(
+        sharded_->shard_ptr(sharded_->shard_map().shard_for_path(path)), file);
+  }
+
+  std::filesystem::path second_db_path_;
+  std::unique_ptr<DatabaseManager> second_db_;
+  std::shared_ptr<MetadataStore> second_store_;
+  std::shared_ptr<ShardedMetadataStore> sharded_;
+};
+
+TEST_F(ShardedMetadataStoreTest, Writes_RefusedOnceAShardUsedUpItsIds) {
+  // Room for a single file
+  second_db_->reserve_row_ids(ShardMap::first_id(1), ShardMap::first_id(1));
+
+  EXPECT_EQ(add_file("/second/a.txt"), ShardMap::first_id(1));
+  // The next id is the first of shard 2's range
+  EXPECT_ANY_THROW(add_file("/second/b.txt"));
+  EXPECT_FALSE(second_store_->file_exists("/second/b.txt"));
+  // And a restart refuses the shard rather than run on an exhausted range
+  EXPECT_THROW(second_db_->reserve_row_ids(ShardMap::first_id(1), ShardMap::first_id(1)),
+               ShardMapError);
+}
+
+TEST_F(ShardedMetadataStoreTest, Writes_LandInTheirShardWithIdsNamingIt) {
+  const int first = add_file("/first/a.txt");
+  const int second = add_file("/second/b.txt");
+  EXPECT_LT(first, ShardMap::first_id(1));
+  EXPECT_GE(second, ShardMap::first_id(1));
+  EXPECT_TRUE(metadata_store_->file_exists("/first/a.txt"));
+  EXPECT_FALSE(metadata_store_->file_exists("/second/b.txt"));
+  EXPECT_TRUE(second_store_->file_exists("/second/b.txt"));
+  EXPECT_EQ(&sharded_->for_id(second), second_store_.get());
+  ASSERT_TRUE(sharded_->get_file_metadata("/second/b.txt").has_value());
+  EXPECT_EQ(sharded_->get_file_metadata("/second/b.txt")->id, second);
+}
+
+TEST_F(ShardedMetadataStoreTest, Searches_MergeEveryShardsTopK) {
+  std::vector<int> ids;
+  for (int i = 0; i < 4; ++i) {
+    ids.push_back(add_file("/first/doc" + std::to_string(i) + ".txt"));
+    ids.push_back(add_file("/second/doc" + std::to_string(i) + ".txt"));
+  }
+  metadata_store_->rebuild_faiss_index();
+  second_store_->rebuild_faiss_index();
+
+  // The exact match lives in the second shard; the merge ranks it first
+  auto query =
+      magic_tests::TestUtilities::create_test_vector("/second/doc2.txt", sharded_->dimension());
+  auto results = sharded_->search_similar_files(query, 5);
+  ASSERT_EQ(results.size(), 5u);
+  EXPECT_EQ(results[0].file.path, "/second/doc2.txt");
+  EXPECT_NEAR(results[0].distance, 0.0f, 1e-4f);
+  for (size_t i = 1; i < results.size(); ++i) {
+    EXPECT_GE(results[i].distance, results[i - 1].distance);
+  }
+  bool from_first = std::any_of(results.begin(), results.end(), [](const FileSearchResult &r) {
+    return r.file.path.rfind("/first/", 0) == 0;
+  });
+  EXPECT_TRUE(from_first);
+
+  auto batch = sharded_->search_similar_files_batch({query, query}, 3);
+  ASSERT_EQ(batch.size(), 2u);
+  ASSERT_EQ(batch[1].size(), 3u);
+  EXPECT_EQ(batch[1][0].file.path, "/second/doc2.txt");
+
+  // Hits come back in the order asked, whichever shard holds them
+  auto files = sharded_->get_file_search_results({{ids[1], 0.1f}, {ids[0], 0.2f}, {-5, 0.3f}});
+  ASSERT_EQ(files.size(), 2u);
+  EXPECT_EQ(files[0].file.path, "/second/doc0.txt");
+  EXPECT_EQ(files[1].file.path, "/first/doc0.txt");
+  EXPECT_FLOAT_EQ(files[1].distance, 0.2f);
+}
+
+TEST_F(ShardedMetadataStoreTest, ListingAndDeletes_CoverEveryShard) {
+  for (int i = 0; i < 3; ++i) {
+    add_file("/first/f" + std::to_string(i) + ".txt");
+    add_file("/second/s" + std::to_string(i) + ".txt");
+  }
+  // Pages walk the shards in id order, so the cursor crosses into the second shard
+  std::vector<std::string> paths;
+  int64_t cursor = 0;
+  for (auto page = sharded_->list_files_page(cursor, 4); !page.empty();
+       page = sharded_->list_files_page(cursor, 4)) {
+    EXPECT_LE(page.size(), 4u);
+    for (const auto &file : page) {
+      EXPECT_GT(file.id, cursor);
+      cursor = file.id;
+      paths.push_back(file.path);
+    }
+  }
+  EXPECT_EQ(paths.size(), 6u);
+  EXPECT_EQ(sharded_->list_all_files().size(), 6u);
+
+  sharded_->delete_file_metadata("/second/s0.txt");
+  EXPECT_FALSE(second_store_->file_exists("/second/s0.txt"));
+  EXPECT_EQ(sharded_->delete_files_under("/"), 5u);
+  EXPECT_TRUE(sharded_->list_all_files().empty());
+}
+
+TEST_F(ShardedMetadataStoreTest, CollectionFilter_SearchesOnlyTheNamedShards) {
+  sharded_ = std::make_shared<ShardedMetadataStore>(
+      ShardMap::for_collections({{"second", "/second"}}),
+      std::vector<std::shared_ptr<MetadataStore>>{metadata_store_, second_store_});
+  for (int i = 0; i < 3; ++i) {
+    add_file("/first/doc" + std::to_string(i) + ".txt");
+    add_file("/second/doc" + std::to_string(i) + ".txt");
+  }
+  metadata_store_->rebuild_faiss_index();
+  second_store_->rebuild_faiss_index();
+
+  auto query =
+      magic_tests::TestUtilities::create_test_vector("/first/doc1.txt", sharded_->dimension());
+  SearchFilter filter;
+  filter.collections = {"second"};
+  auto results = sharded_->search_similar_files(query, 10, {}, filter);
+  ASSERT_EQ(results.size(), 3u);
+  for (const auto &result : results) {
+    EXPECT_EQ(result.file.path.rfind("/second/", 0), 0u);
+  }
+  filter.collections = {ShardMap::DEFAULT_COLLECTION, "second"};
+  EXPECT_EQ(sharded_->search_similar_files(query, 10, {}, filter).size(), 6u);
+  EXPECT_EQ(sharded_->search_similar_files(query, 10).front().file.path, "/first/doc1.txt");
+  filter.collections = {"music"};
+  EXPECT_THROW(sharded_->search_similar_files(query, 10, {}, filter), std::invalid_argument);
+
+  auto collections = sharded_->collections();
+  ASSERT_EQ(collections.size(), 2u);
+  EXPECT_EQ(collections[1].name, "second");
+  EXPECT_EQ(collections[1].root, "/second");
+  EXPECT_EQ(collections[1].file_index.size, 3u);
+  EXPECT_FALSE(collections[1].bulk_loading);
+}
+
+}  // namespace magic_core
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "magic_core/db/statement_cache.hpp"
+
+namespace magic_core {
+
+class StatementCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    db_ << "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT NOT NULL)";
+  }
+
+  int count_items() {
+    int count = 0;
+    db_ << "SELECT COUNT(*) FROM items" >> count;
+    return count;
+  }
+
+  sqlite::database db_{":memory:"};
+  StatementCache cache_;
+};
+
+TEST_F(StatementCacheTest, Get_PreparesEachSqlTextOnce) {
+  auto &first = cache_.get(db_, "SELECT name FROM items WHERE id = ?");
+  auto &again = cache_.get(db_, "SELECT name FROM items WHERE id = ?");
+  auto &other = cache_.get(db_, "SELECT id FROM items WHERE name = ?");
+
+  EXPECT_EQ(&first, &again);
+  EXPECT_NE(&first, &other);
+  EXPECT_EQ(cache_.size(), 2u);
+}
+
+TEST_F(StatementCacheTest, Statement_RebindsOnEveryUse) {
+  for (int i = 1; i <= 3; ++i) {
+    auto &insert = cache_.get(db_, "INSERT INTO items (id, name) VALUES (?, ?)");
+    insert << i << "item" + std::to_string(i);
+    insert.execute();
+  }
+  EXPECT_EQ(count_items(), 3);
+
+  for (int i = 1; i <= 3; ++i) {
+    std::string name;
+    cache_.get(db_, "SELECT name FROM items WHERE id = ?") << i >> name;
+    EXPECT_EQ(name, "item" + std::to_string(i));
+  }
+}
+
+TEST_F(StatementCacheTest, Statement_IsUsableAfterCallbackThrows) {
+  db_ << "INSERT INTO items (id, name) VALUES (1, 'a'), (2, 'b'), (3, 'c')";
+  const std::string sql = "SELECT id FROM items ORDER BY id";
+
+  EXPECT_THROW(cache_.get(db_, sql) >> [](int) { throw std::runtime_error("stop"); },
+               std::runtime_error);
+
+  int rows = 0;
+  cache_.get(db_, sql) >> [&](int) { ++rows; };
+  EXPECT_EQ(rows, 3);
+  // The abandoned step does not keep the connection from writing
+  db_ << "DELETE FROM items";
+  EXPECT_EQ(count_items(), 0);
+}
+
+TEST_F(StatementCacheTest, JsonIdList_BindsAnyNumberOfIds) {
+  db_ << "INSERT INTO items (id, name) VALUES (1, 'a'), (2, 'b'), (3, 'c'), (4, 'd')";
+  const std::string sql =
+      "SELECT COUNT(*) FROM items WHERE id IN (SELECT value FROM json_each(?))";
+
+  int count = -1;
+  cache_.get(db_, sql) << "[1,3]" >> count;
+  EXPECT_EQ(count, 2);
+  cache_.get(db_, sql) << "[1,2,3,4,99]" >> count;
+  EXPECT_EQ(count, 4);
+  cache_.get(db_, sql) << "[]" >> count;
+  EXPECT_EQ(count, 0);
+  EXPECT_EQ(cache_.size(), 1u);
+}
+
+TEST_F(StatementCacheTest, Get_StartsOverInsteadOfGrowingPastLimit) {
+  for (size_t i = 0; i <= StatementCache::MAX_STATEMENTS; ++i) {
+    cache_.get(db_, "SELECT " + std::to_string(i));
+  }
+  EXPECT_LE(cache_.size(), StatementCache::MAX_STATEMENTS);
+  // Dropping statements that were never run must not execute them
+  EXPECT_EQ(count_items(), 0);
+}
+
+}  // namespace magic_core
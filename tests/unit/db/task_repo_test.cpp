@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
+#include <chrono>
 #include <optional>
+#include <map>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
@@ -47,6 +50,38 @@ TEST_F(TaskQueueRepoTest, CreateTask_DefaultPriority) {
   EXPECT_EQ(pending_tasks[0].priority, 10);
 }
 
+TEST_F(TaskQueueRepoTest, CreateTaggedTask_StoresTheTagWithoutAPath) {
+  long long task_id =
+      task_queue_repo_->create_tagged_task("REEMBED", "all-minilm", TaskPriority::BULK);
+
+  auto task = task_queue_repo_->get_task(task_id);
+  ASSERT_TRUE(task.has_value());
+  EXPECT_EQ(task->task_type, "REEMBED");
+  EXPECT_EQ(task->target_tag, "all-minilm");
+  EXPECT_EQ(task->target_path.value_or(""), "");
+  EXPECT_EQ(task->priority, TaskPriority::BULK);
+}
+
+TEST_F(TaskQueueRepoTest, CreateTasks_InsertsBatchInOrder) {
+  std::vector<std::string> paths = {"/test/batch_a.txt", "/test/batch_b.txt", "/test/batch_c.txt"};
+
+  std::vector<long long> task_ids =
+      task_queue_repo_->create_file_process_tasks("PROCESS_FILE", paths, 5);
+
+  ASSERT_EQ(task_ids.size(), paths.size());
+  auto pending_tasks = task_queue_repo_->get_tasks_by_status(TaskStatus::PENDING);
+  ASSERT_EQ(pending_tasks.size(), paths.size());
+  std::map<long long, std::string> path_by_id;
+  for (const auto& task : pending_tasks) {
+    path_by_id[task.id] = task.target_path.value_or("");
+    EXPECT_EQ(task.priority, 5);
+  }
+  for (size_t i = 0; i < paths.size(); ++i) {
+    EXPECT_EQ(path_by_id[task_ids[i]], paths[i]);
+  }
+  EXPECT_TRUE(task_queue_repo_->create_file_process_tasks("PROCESS_FILE", {}).empty());
+}
+
 TEST_F(TaskQueueRepoTest, FetchAndClaimNextTask_BasicFunctionality) {
   long long task1_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/file1.txt", 5);
   long long task2_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/file2.txt", 1);
@@ -430,4 +465,395 @@ TEST_F(TaskQueueRepoTest, TaskProgress_IntegrationWithTaskLifecycle) {
   EXPECT_EQ(completed_tasks[0].id, task_id);
 }
 
+TEST_F(TaskQueueRepoTest, ReportTaskProgress_ServedFromMemoryAndWrittenOnCompletion) {
+  // An interval the test never reaches, so only the first report is flushed on its own
+  TaskQueueRepo repo(*db_manager_, std::chrono::hours(1));
+  // A second repo has no in-memory progress and shows what task_progress holds
+  TaskQueueRepo stored(*db_manager_);
+  long long task_id = repo.create_file_process_task("PROCESS_FILE", "/test/file.txt");
+  long long other_id = repo.create_file_process_task("PROCESS_FILE", "/test/other.txt");
+
+  for (int i = 1; i <= 50; ++i) {
+    repo.report_task_progress(task_id, static_cast<float>(i), "Chunk " + std::to_string(i));
+  }
+  auto live = repo.get_task_progress(task_id);
+  ASSERT_TRUE(live.has_value());
+  EXPECT_FLOAT_EQ(live->progress_percent, 50.0f);
+  EXPECT_EQ(live->status_message, "Chunk 50");
+
+  // Waits for the background flush by committing a write queued behind it
+  repo.upsert_task_progress(other_id, 0.0f, "barrier");
+  auto flushed = stored.get_task_progress(task_id);
+  ASSERT_TRUE(flushed.has_value());
+  EXPECT_LT(flushed->progress_percent, 50.0f);
+
+  repo.update_task_status(task_id, TaskStatus::COMPLETED);
+  auto final_progress = stored.get_task_progress(task_id);
+  ASSERT_TRUE(final_progress.has_value());
+  EXPECT_FLOAT_EQ(final_progress->progress_percent, 50.0f);
+  EXPECT_EQ(final_progress->status_message, "Chunk 50");
+}
+
+TEST_F(TaskQueueRepoTest, ReportTaskProgress_FlushesAfterInterval) {
+  TaskQueueRepo repo(*db_manager_, std::chrono::milliseconds(0));
+  TaskQueueRepo stored(*db_manager_);
+  long long task_id = repo.create_file_process_task("PROCESS_FILE", "/test/file.txt");
+  long long other_id = repo.create_file_process_task("PROCESS_FILE", "/test/other.txt");
+
+  repo.report_task_progress(task_id, 25.0f, "Quarter");
+  repo.upsert_task_progress(other_id, 0.0f, "barrier");
+  // Failing the task keeps the last flushed progress in place
+  repo.mark_task_as_failed(task_id, "boom");
+
+  auto progress = stored.get_task_progress(task_id);
+  ASSERT_TRUE(progress.has_value());
+  EXPECT_FLOAT_EQ(progress->progress_percent, 25.0f);
+  EXPECT_EQ(progress->status_message, "Quarter");
+}
+
+TEST_F(TaskQueueRepoTest, TaskUpdateListener_SeesEveryReportAndTheOutcome) {
+  TaskQueueRepo repo(*db_manager_, std::chrono::hours(1));
+  std::vector<TaskUpdate> updates;
+  repo.set_task_update_listener([&](const TaskUpdate& update) { updates.push_back(update); });
+  long long done_id = repo.create_file_process_task("PROCESS_FILE", "/test/done.txt");
+  long long failed_id = repo.create_file_process_task("PROCESS_FILE", "/test/failed.txt");
+
+  // Reports coalesced in the database still reach the listener one by one
+  for (int i = 1; i <= 3; ++i) {
+    repo.report_task_progress(done_id, 0.25f * i, "Step " + std::to_string(i));
+  }
+  repo.update_task_status(done_id, TaskStatus::COMPLETED);
+  repo.report_task_progress(failed_id, 0.5f, "Halfway");
+  repo.mark_task_as_failed(failed_id, "boom");
+
+  ASSERT_EQ(updates.size(), 6u);
+  EXPECT_EQ(updates[2].task_id, done_id);
+  EXPECT_EQ(updates[2].status, TaskStatus::PROCESSING);
+  EXPECT_FLOAT_EQ(updates[2].progress_percent, 0.75f);
+  EXPECT_EQ(updates[2].message, "Step 3");
+  EXPECT_EQ(updates[3].status, TaskStatus::COMPLETED);
+  EXPECT_FLOAT_EQ(updates[3].progress_percent, 0.75f);
+  EXPECT_EQ(updates[5].task_id, failed_id);
+  EXPECT_EQ(updates[5].status, TaskStatus::FAILED);
+  EXPECT_FLOAT_EQ(updates[5].progress_percent, 0.5f);
+  EXPECT_EQ(updates[5].message, "boom");
+
+  repo.set_task_update_listener(nullptr);
+  repo.report_task_progress(done_id, 1.0f, "After");
+  EXPECT_EQ(updates.size(), 6u);
+}
+
+TEST_F(TaskQueueRepoTest, FetchAndClaimTasks_ClaimsBatchInPriorityOrder) {
+  long long task_low = task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/low.txt", 10);
+  long long task_high = task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/high.txt", 1);
+  long long task_med = task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/med.txt", 5);
+
+  auto claimed = task_queue_repo_->fetch_and_claim_tasks(2);
+
+  ASSERT_EQ(claimed.size(), 2);
+  EXPECT_EQ(claimed[0].id, task_high);
+  EXPECT_EQ(claimed[1].id, task_med);
+  for (const auto& task : claimed) {
+    EXPECT_EQ(task.status, TaskStatus::PROCESSING);
+  }
+
+  // Only the remaining task is left to claim
+  auto rest = task_queue_repo_->fetch_and_claim_tasks(5);
+  ASSERT_EQ(rest.size(), 1);
+  EXPECT_EQ(rest[0].id, task_low);
+  EXPECT_TRUE(task_queue_repo_->fetch_and_claim_tasks(5).empty());
+}
+
+TEST_F(TaskQueueRepoTest, FetchAndClaimTasks_AgedBulkTaskBeatsNewInteractiveOne) {
+  long long old_bulk = task_queue_repo_->create_file_process_task(
+      "PROCESS_FILE", "/test/old_bulk.txt", TaskPriority::BULK);
+  long long fresh_bulk = task_queue_repo_->create_file_process_task(
+      "PROCESS_FILE", "/test/fresh_bulk.txt", TaskPriority::BULK);
+  long long interactive = task_queue_repo_->create_file_process_task(
+      "PROCESS_FILE", "/test/interactive.txt", TaskPriority::INTERACTIVE);
+  // Twenty priority levels apart, so half an hour of waiting is more than enough to overtake
+  db_manager_->writer().run([&](PooledDatabase& conn) {
+    auto& update = conn.prepare("UPDATE task_queue SET created_at = created_at - ? WHERE id = ?");
+    update << int64_t{30 * 60 * 1000} << old_bulk;
+    update.execute();
+  });
+
+  auto claimed = task_queue_repo_->fetch_and_claim_tasks(3);
+
+  ASSERT_EQ(claimed.size(), 3);
+  EXPECT_EQ(claimed[0].id, old_bulk);
+  EXPECT_EQ(claimed[1].id, interactive);
+  EXPECT_EQ(claimed[2].id, fresh_bulk);
+}
+
+TEST_F(TaskQueueRepoTest, FetchAndClaimTasks_LaneOnlyClaimsItsPriorities) {
+  long long bulk = task_queue_repo_->create_file_process_task(
+      "PROCESS_FILE", "/test/bulk.txt", TaskPriority::BULK);
+  long long interactive = task_queue_repo_->create_file_process_task(
+      "PROCESS_FILE", "/test/interactive.txt", TaskPriority::INTERACTIVE);
+  long long normal = task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/normal.txt");
+
+  auto interactive_lane = task_queue_repo_->fetch_and_claim_tasks(5, TaskLane::Interactive);
+  ASSERT_EQ(interactive_lane.size(), 2);
+  EXPECT_EQ(interactive_lane[0].id, interactive);
+  EXPECT_EQ(interactive_lane[1].id, normal);
+
+  auto bulk_lane = task_queue_repo_->fetch_and_claim_tasks(5, TaskLane::Bulk);
+  ASSERT_EQ(bulk_lane.size(), 1);
+  EXPECT_EQ(bulk_lane[0].id, bulk);
+}
+
+TEST_F(TaskQueueRepoTest, FetchAndClaimTasks_GenerationLaneIsSeparate) {
+  long long summarize = task_queue_repo_->create_tagged_file_task(
+      "SUMMARIZE_FILE", "/test/a.txt", "hash-a", TaskPriority::INTERACTIVE);
+  long long process = task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/b.txt");
+  EXPECT_EQ(task_queue_repo_->count_pending_tasks(TaskLane::Any), 1);
+  EXPECT_EQ(task_queue_repo_->count_pending_tasks(TaskLane::Generation), 1);
+
+  auto any_lane = task_queue_repo_->fetch_and_claim_tasks(5, TaskLane::Any);
+  ASSERT_EQ(any_lane.size(), 1);
+  EXPECT_EQ(any_lane[0].id, process);
+  EXPECT_TRUE(task_queue_repo_->fetch_and_claim_tasks(5, TaskLane::Interactive).empty());
+
+  auto generation_lane = task_queue_repo_->fetch_and_claim_tasks(5, TaskLane::Generation);
+  ASSERT_EQ(generation_lane.size(), 1);
+  EXPECT_EQ(generation_lane[0].id, summarize);
+  EXPECT_EQ(generation_lane[0].target_path, "/test/a.txt");
+  EXPECT_EQ(generation_lane[0].target_tag, "hash-a");
+}
+
+TEST_F(TaskQueueRepoTest, FetchAndClaimTasks_ConcurrentClaimsNeverOverlap) {
+  for (int i = 0; i < 20; ++i) {
+    task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/file" + std::to_string(i) + ".txt");
+  }
+
+  std::vector<TaskDTO> t1;
+  std::vector<TaskDTO> t2;
+  std::thread th1([&]{ t1 = task_queue_repo_->fetch_and_claim_tasks(15); });
+  std::thread th2([&]{ t2 = task_queue_repo_->fetch_and_claim_tasks(15); });
+  th1.join();
+  th2.join();
+
+  std::set<long long> ids;
+  for (const auto& task : t1) ids.insert(task.id);
+  for (const auto& task : t2) ids.insert(task.id);
+  EXPECT_EQ(t1.size() + t2.size(), 20);
+  EXPECT_EQ(ids.size(), 20);
+}
+
+TEST_F(TaskQueueRepoTest, FetchAndClaimTasks_LeasesClaimToOwner) {
+  long long task_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/file.txt");
+
+  auto claimed = task_queue_repo_->fetch_and_claim_tasks(1, TaskLane::Any, "owner-a");
+
+  ASSERT_EQ(claimed.size(), 1);
+  EXPECT_EQ(claimed[0].lease_owner, "owner-a");
+  EXPECT_EQ(claimed[0].attempts, 1);
+  EXPECT_TRUE(task_queue_repo_->renew_lease(task_id, "owner-a"));
+  EXPECT_FALSE(task_queue_repo_->renew_lease(task_id, "owner-b"));
+
+  // Finished tasks hold no lease
+  task_queue_repo_->update_task_status(task_id, TaskStatus::COMPLETED);
+  EXPECT_FALSE(task_queue_repo_->renew_lease(task_id, "owner-a"));
+}
+
+TEST_F(TaskQueueRepoTest, ReclaimExpiredLeases_RequeuesThenFailsAfterMaxAttempts) {
+  TaskQueueRepo short_lease(*db_manager_, TaskQueueRepo::DEFAULT_PROGRESS_FLUSH_INTERVAL,
+                            std::chrono::milliseconds(1));
+  long long task_id = short_lease.create_file_process_task("PROCESS_FILE", "/test/crashy.txt");
+  std::vector<TaskUpdate> updates;
+  short_lease.set_task_update_listener(
+      [&](const TaskUpdate& update) { updates.push_back(update); });
+
+  for (int attempt = 1; attempt < TaskQueueRepo::MAX_TASK_ATTEMPTS; ++attempt) {
+    ASSERT_EQ(short_lease.fetch_and_claim_tasks(1, TaskLane::Any, "dead-worker").size(), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    updates.clear();
+    EXPECT_EQ(short_lease.reclaim_expired_leases(), 1);
+    auto pending = short_lease.get_tasks_by_status(TaskStatus::PENDING);
+    ASSERT_EQ(pending.size(), 1);
+    EXPECT_EQ(pending[0].id, task_id);
+    ASSERT_EQ(updates.size(), 1u);
+    EXPECT_EQ(updates[0].task_id, task_id);
+    EXPECT_EQ(updates[0].status, TaskStatus::PENDING);
+  }
+
+  ASSERT_EQ(short_lease.fetch_and_claim_tasks(1, TaskLane::Any, "dead-worker").size(), 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  updates.clear();
+  EXPECT_EQ(short_lease.reclaim_expired_leases(), 1);
+  auto failed = short_lease.get_tasks_by_status(TaskStatus::FAILED);
+  ASSERT_EQ(failed.size(), 1);
+  EXPECT_EQ(failed[0].id, task_id);
+  ASSERT_EQ(updates.size(), 1u);
+  EXPECT_EQ(updates[0].status, TaskStatus::FAILED);
+  EXPECT_TRUE(short_lease.get_tasks_by_status(TaskStatus::PENDING).empty());
+}
+
+TEST_F(TaskQueueRepoTest, OutcomeWrites_StaleLeaseOwnerIsANoOp) {
+  TaskQueueRepo short_lease(*db_manager_, TaskQueueRepo::DEFAULT_PROGRESS_FLUSH_INTERVAL,
+                            std::chrono::milliseconds(1));
+  long long task_id = short_lease.create_file_process_task("PROCESS_FILE", "/test/slow.txt");
+  ASSERT_EQ(short_lease.fetch_and_claim_tasks(1, TaskLane::Any, "slow-worker").size(), 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_EQ(short_lease.reclaim_expired_leases(), 1);
+  ASSERT_EQ(short_lease.fetch_and_claim_tasks(1, TaskLane::Any, "new-worker").size(), 1);
+
+  // The slow worker finishes after its task was handed to someone else
+  EXPECT_FALSE(short_lease.update_task_status(task_id, TaskStatus::COMPLETED, "slow-worker"));
+  EXPECT_FALSE(short_lease.mark_task_as_failed(task_id, "too late", "slow-worker"));
+
+  auto task = short_lease.get_task(task_id);
+  ASSERT_TRUE(task.has_value());
+  EXPECT_EQ(task->status, TaskStatus::PROCESSING);
+  EXPECT_EQ(task->lease_owner, "new-worker");
+  EXPECT_TRUE(short_lease.update_task_status(task_id, TaskStatus::COMPLETED, "new-worker"));
+  EXPECT_EQ(short_lease.get_task(task_id)->status, TaskStatus::COMPLETED);
+}
+
+TEST_F(TaskQueueRepoTest, ReleaseClaimedTasks_ReturnsThemToQueue) {
+  long long task_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/file.txt");
+  ASSERT_EQ(task_queue_repo_->fetch_and_claim_tasks(1).size(), 1);
+
+  task_queue_repo_->release_claimed_tasks({task_id});
+
+  auto pending = task_queue_repo_->get_tasks_by_status(TaskStatus::PENDING);
+  ASSERT_EQ(pending.size(), 1);
+  EXPECT_EQ(pending[0].id, task_id);
+}
+
+TEST_F(TaskQueueRepoTest, CreateTask_SamePathWhilePending_ReturnsThePendingTask) {
+  long long first = task_queue_repo_->create_file_process_task(
+      "PROCESS_FILE", "/test/saved.txt", TaskPriority::BULK);
+  long long again = task_queue_repo_->create_file_process_task(
+      "PROCESS_FILE", "/test/saved.txt", TaskPriority::INTERACTIVE);
+  long long other_type = task_queue_repo_->create_file_process_task("REMOVE_FILE",
+                                                                    "/test/saved.txt");
+
+  EXPECT_EQ(again, first);
+  EXPECT_NE(other_type, first);
+  auto task = task_queue_repo_->get_task(first);
+  ASSERT_TRUE(task.has_value());
+  EXPECT_EQ(task->priority, TaskPriority::INTERACTIVE);
+  EXPECT_EQ(task_queue_repo_->count_tasks_by_status(TaskStatus::PENDING), 2);
+
+  // The more urgent priority is kept
+  task_queue_repo_->create_file_process_task("PROCESS_FILE", "/test/saved.txt",
+                                             TaskPriority::BULK);
+  EXPECT_EQ(task_queue_repo_->get_task(first)->priority, TaskPriority::INTERACTIVE);
+}
+
+TEST_F(TaskQueueRepoTest, CreateTasks_PathListedTwice_SharesOneTask) {
+  auto ids = task_queue_repo_->create_file_process_tasks(
+      "PROCESS_FILE", {"/test/a.txt", "/test/b.txt", "/test/a.txt"});
+
+  ASSERT_EQ(ids.size(), 3);
+  EXPECT_EQ(ids[2], ids[0]);
+  EXPECT_NE(ids[1], ids[0]);
+  EXPECT_EQ(task_queue_repo_->count_tasks_by_status(TaskStatus::PENDING), 2);
+}
+
+TEST_F(TaskQueueRepoTest, CreateTask_SamePathWhileClaimed_QueuesANewerTask) {
+  long long claimed = task_queue_repo_->create_file_process_task("PROCESS_FILE",
+                                                                 "/test/saved.txt");
+  ASSERT_EQ(task_queue_repo_->fetch_and_claim_tasks(1).size(), 1);
+  EXPECT_FALSE(task_queue_repo_->find_superseding_task(claimed).has_value());
+
+  long long newer = task_queue_repo_->create_file_process_task("PROCESS_FILE",
+                                                               "/test/saved.txt");
+
+  EXPECT_NE(newer, claimed);
+  EXPECT_EQ(task_queue_repo_->find_superseding_task(claimed), newer);
+  EXPECT_FALSE(task_queue_repo_->find_superseding_task(newer).has_value());
+}
+
+TEST_F(TaskQueueRepoTest, FindSupersedingTask_NewerTaskAlreadyDone_StillSupersedes) {
+  long long claimed = task_queue_repo_->create_file_process_task("PROCESS_FILE",
+                                                                 "/test/saved.txt");
+  ASSERT_EQ(task_queue_repo_->fetch_and_claim_tasks(1).size(), 1);
+  long long newer = task_queue_repo_->create_file_process_task("PROCESS_FILE",
+                                                               "/test/saved.txt");
+  task_queue_repo_->update_task_status(newer, TaskStatus::COMPLETED);
+
+  EXPECT_EQ(task_queue_repo_->find_superseding_task(claimed), newer);
+}
+
+TEST_F(TaskQueueRepoTest, CreateTaggedFileTask_NewestTagWins) {
+  long long first =
+      task_queue_repo_->create_tagged_file_task("SUMMARIZE_FILE", "/test/a.txt", "hash-1");
+  long long again =
+      task_queue_repo_->create_tagged_file_task("SUMMARIZE_FILE", "/test/a.txt", "hash-2");
+
+  EXPECT_EQ(again, first);
+  EXPECT_EQ(task_queue_repo_->get_task(first)->target_tag, "hash-2");
+}
+
+TEST_F(TaskQueueRepoTest, ReleaseClaimedTasks_PathQueuedAgain_CompletesTheOldClaim) {
+  std::vector<TaskUpdate> updates;
+  task_queue_repo_->set_task_update_listener(
+      [&](const TaskUpdate& update) { updates.push_back(update); });
+  long long claimed = task_queue_repo_->create_file_process_task("PROCESS_FILE",
+                                                                 "/test/saved.txt");
+  ASSERT_EQ(task_queue_repo_->fetch_and_claim_tasks(1).size(), 1);
+  long long newer = task_queue_repo_->create_file_process_task("PROCESS_FILE",
+                                                               "/test/saved.txt");
+
+  task_queue_repo_->release_claimed_tasks({claimed});
+
+  EXPECT_EQ(task_queue_repo_->get_task(claimed)->status, TaskStatus::COMPLETED);
+  ASSERT_FALSE(updates.empty());
+  EXPECT_EQ(updates.back().task_id, claimed);
+  EXPECT_EQ(updates.back().status, TaskStatus::COMPLETED);
+  auto pending = task_queue_repo_->get_tasks_by_status(TaskStatus::PENDING);
+  ASSERT_EQ(pending.size(), 1);
+  EXPECT_EQ(pending[0].id, newer);
+}
+
+TEST_F(TaskQueueRepoTest, ReclaimExpiredLeases_PathQueuedAgain_CompletesTheOldClaim) {
+  TaskQueueRepo short_lease(*db_manager_, TaskQueueRepo::DEFAULT_PROGRESS_FLUSH_INTERVAL,
+                            std::chrono::milliseconds(1));
+  long long claimed = short_lease.create_file_process_task("PROCESS_FILE", "/test/crashy.txt");
+  ASSERT_EQ(short_lease.fetch_and_claim_tasks(1, TaskLane::Any, "dead-worker").size(), 1);
+  long long newer = short_lease.create_file_process_task("PROCESS_FILE", "/test/crashy.txt");
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  std::vector<TaskUpdate> updates;
+  short_lease.set_task_update_listener(
+      [&](const TaskUpdate& update) { updates.push_back(update); });
+
+  EXPECT_EQ(short_lease.reclaim_expired_leases(), 1);
+
+  EXPECT_EQ(short_lease.get_task(claimed)->status, TaskStatus::COMPLETED);
+  ASSERT_EQ(updates.size(), 1u);
+  EXPECT_EQ(updates[0].task_id, claimed);
+  EXPECT_EQ(updates[0].status, TaskStatus::COMPLETED);
+  auto pending = short_lease.get_tasks_by_status(TaskStatus::PENDING);
+  ASSERT_EQ(pending.size(), 1);
+  EXPECT_EQ(pending[0].id, newer);
+}
+
+TEST_F(TaskQueueRepoTest, ListTasksPage_PagesByIdAndFiltersStatus) {
+  std::vector<long long> ids;
+  for (int i = 0; i < 5; ++i) {
+    ids.push_back(task_queue_repo_->create_file_process_task(
+        "PROCESS_FILE", "/test/page" + std::to_string(i) + ".txt"));
+  }
+  task_queue_repo_->update_task_status(ids[1], TaskStatus::COMPLETED);
+  task_queue_repo_->update_task_status(ids[3], TaskStatus::COMPLETED);
+
+  auto first = task_queue_repo_->list_tasks_page(std::nullopt, 0, 3);
+  ASSERT_EQ(first.size(), 3);
+  EXPECT_EQ(first[0].id, ids[0]);
+  EXPECT_EQ(first[2].id, ids[2]);
+  auto rest = task_queue_repo_->list_tasks_page(std::nullopt, first.back().id, 3);
+  ASSERT_EQ(rest.size(), 2);
+  EXPECT_EQ(rest[0].id, ids[3]);
+
+  auto completed = task_queue_repo_->list_tasks_page(TaskStatus::COMPLETED, 0, 10);
+  ASSERT_EQ(completed.size(), 2);
+  EXPECT_EQ(completed[0].id, ids[1]);
+  EXPECT_EQ(completed[1].id, ids[3]);
+  EXPECT_TRUE(task_queue_repo_->list_tasks_page(std::nullopt, 0, 0).empty());
+}
+
 }  // namespace magic_core
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "magic_core/db/vector_encoding.hpp"
+
+namespace magic_core {
+
+namespace {
+
+std::vector<float> round_trip(VectorEncoding encoding, const std::vector<float> &in) {
+  const int dimension = static_cast<int>(in.size());
+  std::vector<unsigned char> encoded(encoded_vector_size(encoding, dimension));
+  encode_vector(encoding, in.data(), dimension, encoded.data());
+  std::vector<float> out(in.size());
+  decode_vector(encoding, encoded.data(), dimension, out.data());
+  return out;
+}
+
+std::vector<float> random_unit_vectors(size_t count, int dimension, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> normal;
+  std::vector<float> vectors(count * dimension);
+  for (size_t i = 0; i < count; ++i) {
+    float *v = vectors.data() + i * dimension;
+    float norm = 0.0f;
+    for (int d = 0; d < dimension; ++d) {
+      v[d] = normal(rng);
+      norm += v[d] * v[d];
+    }
+    norm = std::sqrt(norm);
+    for (int d = 0; d < dimension; ++d) {
+      v[d] /= norm;
+    }
+  }
+  return vectors;
+}
+
+std::vector<size_t> top_k(const std::vector<float> &vectors,
+                          int dimension,
+                          const float *query,
+                          size_t k) {
+  const size_t count = vectors.size() / dimension;
+  std::vector<float> scores(count);
+  for (size_t i = 0; i < count; ++i) {
+    scores[i] = std::inner_product(query, query + dimension, vectors.data() + i * dimension, 0.0f);
+  }
+  std::vector<size_t> ids(count);
+  std::iota(ids.begin(), ids.end(), 0);
+  std::partial_sort(ids.begin(), ids.begin() + k, ids.end(),
+                    [&](size_t a, size_t b) { return scores[a] > scores[b]; });
+  ids.resize(k);
+  return ids;
+}
+
+}  // namespace
+
+TEST(VectorEncodingTest, Parse_KnowsEveryEncoding) {
+  for (auto encoding : {VectorEncoding::Float32, VectorEncoding::Float16, VectorEncoding::Int8}) {
+    EXPECT_EQ(parse_vector_encoding(to_string(encoding)), encoding);
+  }
+  EXPECT_THROW(parse_vector_encoding("int4"), std::invalid_argument);
+}
+
+TEST(VectorEncodingTest, Sizes_MatchTheLayout) {
+  EXPECT_EQ(encoded_vector_size(VectorEncoding::Float32, 1024), 4096u);
+  EXPECT_EQ(encoded_vector_size(VectorEncoding::Float16, 1024), 2048u);
+  EXPECT_EQ(encoded_vector_size(VectorEncoding::Int8, 1024), 1028u);
+}
+
+TEST(VectorEncodingTest, Float16_RoundsToNearestEvenAndKeepsSpecialValues) {
+  // Long enough to go through the vector path as well as the scalar tail
+  std::vector<float> in = {0.0f,     -0.0f,   1.0f,     -2.5f,     65504.0f, 1e6f,
+                           -1e6f,    6e-8f,   1e-10f,   1.0009765625f,
+                           // Halfway between 1 and the next half: stays on the even 1
+                           1.00048828125f,
+                           std::numeric_limits<float>::infinity(), 0.333333f, 3.14159f, 100.0f,
+                           -0.007f, 42.0f};
+  auto out = round_trip(VectorEncoding::Float16, in);
+  EXPECT_EQ(out[0], 0.0f);
+  EXPECT_TRUE(std::signbit(out[1]));
+  EXPECT_EQ(out[2], 1.0f);
+  EXPECT_EQ(out[3], -2.5f);
+  EXPECT_EQ(out[4], 65504.0f);
+  EXPECT_TRUE(std::isinf(out[5]));
+  EXPECT_TRUE(std::isinf(out[6]) && out[6] < 0.0f);
+  EXPECT_NEAR(out[7], 6e-8f, 3e-8f);  // Subnormal
+  EXPECT_EQ(out[8], 0.0f);
+  EXPECT_EQ(out[9], 1.0009765625f);
+  EXPECT_EQ(out[10], 1.0f);
+  EXPECT_TRUE(std::isinf(out[11]));
+  for (size_t i = 12; i < in.size(); ++i) {
+    EXPECT_NEAR(out[i], in[i], std::fabs(in[i]) / 1024.0f);
+  }
+}
+
+TEST(VectorEncodingTest, Int8_ErrorIsHalfAStep) {
+  std::vector<float> in = {0.5f, -1.27f, 0.001f, 0.0f, 1.0f, -0.3f, 0.77f};
+  auto out = round_trip(VectorEncoding::Int8, in);
+  const float step = 1.27f / 127.0f;
+  for (size_t i = 0; i < in.size(); ++i) {
+    EXPECT_NEAR(out[i], in[i], step / 2 + 1e-6f);
+  }
+  EXPECT_EQ(out[1], -1.27f);
+
+  // An all-zero vector has no scale to divide by
+  auto zeros = round_trip(VectorEncoding::Int8, std::vector<float>(16, 0.0f));
+  EXPECT_EQ(zeros, std::vector<float>(16, 0.0f));
+}
+
+TEST(VectorEncodingTest, Quantized_KeepTopTenRecall) {
+  constexpr int dimension = 1024;
+  constexpr size_t count = 2000;
+  constexpr size_t queries = 20;
+  constexpr size_t k = 10;
+  auto vectors = random_unit_vectors(count, dimension, 7);
+  auto query_vectors = random_unit_vectors(queries, dimension, 11);
+
+  for (auto [encoding, min_recall] :
+       {std::pair{VectorEncoding::Float16, 0.99}, std::pair{VectorEncoding::Int8, 0.95}}) {
+    std::vector<float> decoded(vectors.size());
+    std::vector<unsigned char> encoded(encoded_vector_size(encoding, dimension));
+    for (size_t i = 0; i < count; ++i) {
+      encode_vector(encoding, vectors.data() + i * dimension, dimension, encoded.data());
+      decode_vector(encoding, encoded.data(), dimension, decoded.data() + i * dimension);
+    }
+
+    size_t hits = 0;
+    for (size_t q = 0; q < queries; ++q) {
+      const float *query = query_vectors.data() + q * dimension;
+      auto exact = top_k(vectors, dimension, query, k);
+      auto approx = top_k(decoded, dimension, query, k);
+      for (size_t id : approx) {
+        hits += std::count(exact.begin(), exact.end(), id);
+      }
+    }
+    EXPECT_GE(static_cast<double>(hits) / (queries * k), min_recall) << to_string(encoding);
+  }
+}
+
+}  // namespace magic_core
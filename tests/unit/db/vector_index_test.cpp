@@ -0,0 +1,622 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "magic_core/db/faiss_gpu.hpp"
+#include "magic_core/db/vector_index.hpp"
+#include "../../common/utilities_test.hpp"
+
+namespace magic_core {
+
+class VectorIndexTest : public ::testing::Test {
+ protected:
+  static constexpr int DIMENSION = 1024;
+
+  VectorIndex index_{DIMENSION, 32, 100};
+
+  std::vector<float> vec(const std::string& seed) {
+    return magic_tests::TestUtilities::create_test_vector(seed, DIMENSION);
+  }
+
+  // count random vectors with ids 0..count-1, flattened for rebuild()
+  static std::vector<float> random_vectors(size_t count, int dimension, uint32_t seed = 7) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> vectors(count * dimension);
+    for (float& x : vectors) {
+      x = dist(rng);
+    }
+    return vectors;
+  }
+
+  static void rebuild_from(VectorIndex& index, const std::vector<float>& vectors, int dimension) {
+    index.rebuild([&](std::vector<faiss::idx_t>& ids, std::vector<float>& out) {
+      for (size_t i = 0; i < vectors.size() / dimension; ++i) {
+        ids.push_back(static_cast<faiss::idx_t>(i));
+      }
+      out = vectors;
+    });
+  }
+};
+
+TEST_F(VectorIndexTest, Upsert_MakesVectorSearchable) {
+  index_.upsert(7, vec("a"));
+  index_.upsert(8, vec("b"));
+
+  auto hits = index_.search(vec("a"), 1);
+
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].id, 7);
+  EXPECT_LT(hits[0].distance, 0.001f);
+  EXPECT_EQ(index_.size(), 2);
+}
+
+TEST_F(VectorIndexTest, Upsert_ReplacesExistingId) {
+  index_.upsert(1, vec("old"));
+  index_.upsert(2, vec("other"));
+  index_.upsert(1, vec("new"));
+
+  auto hits = index_.search(vec("old"), 5);
+
+  // The stale vector must never be returned, and the id appears only once
+  ASSERT_EQ(hits.size(), 2);
+  int seen = 0;
+  for (const auto& hit : hits) {
+    if (hit.id == 1) {
+      ++seen;
+      EXPECT_GT(hit.distance, 0.001f);
+    }
+  }
+  EXPECT_EQ(seen, 1);
+  EXPECT_EQ(index_.size(), 2);
+  EXPECT_EQ(index_.tombstone_count(), 1);
+}
+
+TEST_F(VectorIndexTest, Remove_ExcludesIdFromSearch) {
+  index_.upsert(1, vec("a"));
+  index_.upsert(2, vec("b"));
+
+  EXPECT_TRUE(index_.remove(1));
+  EXPECT_FALSE(index_.remove(1));
+
+  auto hits = index_.search(vec("a"), 5);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].id, 2);
+  EXPECT_FALSE(index_.contains(1));
+}
+
+TEST_F(VectorIndexTest, RemoveIds_TombstonesEveryIndexedId) {
+  index_.upsert(1, vec("a"));
+  index_.upsert(2, vec("b"));
+  index_.upsert(3, vec("c"));
+
+  EXPECT_EQ(index_.remove_ids({1, 3, 42}), 2);
+
+  auto hits = index_.search(vec("a"), 5);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].id, 2);
+  EXPECT_EQ(index_.size(), 1);
+  EXPECT_EQ(index_.tombstone_count(), 2);
+}
+
+TEST_F(VectorIndexTest, Rebuild_DropsTombstones) {
+  index_.upsert(1, vec("a"));
+  index_.upsert(1, vec("b"));
+  ASSERT_EQ(index_.tombstone_count(), 1);
+
+  index_.rebuild([&](std::vector<faiss::idx_t>& ids, std::vector<float>& vectors) {
+    for (int id : {3, 4}) {
+      auto v = vec(std::to_string(id));
+      ids.push_back(id);
+      vectors.insert(vectors.end(), v.begin(), v.end());
+    }
+  });
+
+  EXPECT_EQ(index_.size(), 2);
+  EXPECT_EQ(index_.tombstone_count(), 0);
+  EXPECT_FALSE(index_.contains(1));
+  EXPECT_TRUE(index_.contains(3));
+}
+
+TEST_F(VectorIndexTest, Search_DuringRebuildsSeesOneWholeSnapshot) {
+  // Alternate between two disjoint id sets; every search must see exactly one of them
+  auto load_set = [&](int first_id) {
+    return [&, first_id](std::vector<faiss::idx_t>& ids, std::vector<float>& vectors) {
+      for (int id = first_id; id < first_id + 8; ++id) {
+        auto v = vec(std::to_string(id));
+        ids.push_back(id);
+        vectors.insert(vectors.end(), v.begin(), v.end());
+      }
+    };
+  };
+  index_.rebuild(load_set(0));
+
+  std::atomic<bool> done{false};
+  std::atomic<int> inconsistent{0};
+  std::atomic<int> searches{0};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&] {
+      const auto query = vec("query");
+      while (!done) {
+        auto hits = index_.search(query, 8);
+        if (hits.size() != 8) {
+          ++inconsistent;
+          continue;
+        }
+        const bool low = hits[0].id < 100;
+        for (const auto& hit : hits) {
+          if ((hit.id < 100) != low) {
+            ++inconsistent;
+            break;
+          }
+        }
+        ++searches;
+      }
+    });
+  }
+  for (int round = 0; round < 20 || searches < 100; ++round) {
+    index_.rebuild(load_set(round % 2 == 0 ? 100 : 0));
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(inconsistent, 0);
+  EXPECT_GT(searches, 0);
+}
+
+TEST_F(VectorIndexTest, Search_WithFilterOnlyReturnsAllowedIds) {
+  for (int id = 1; id <= 5; ++id) {
+    index_.upsert(id, vec(std::to_string(id)));
+  }
+  index_.upsert(2, vec("moved"));
+  VectorIndex::IdFilter allowed = {2, 4};
+
+  auto hits = index_.search(vec("1"), 5, &allowed);
+
+  ASSERT_EQ(hits.size(), 2);
+  for (const auto& hit : hits) {
+    EXPECT_TRUE(allowed.count(hit.id));
+  }
+  EXPECT_LE(hits[0].distance, hits[1].distance);
+
+  // The replaced vector of id 2 is a tombstone and must not match
+  auto moved = index_.search(vec("2"), 2, &allowed);
+  for (const auto& hit : moved) {
+    EXPECT_GT(hit.distance, 0.001f);
+  }
+}
+
+TEST_F(VectorIndexTest, Search_LargeFilterIsAppliedInsideTheGraphWalk) {
+  constexpr int dimension = 16;
+  VectorIndex index(dimension);
+  const auto vectors = random_vectors(10000, dimension);
+  rebuild_from(index, vectors, dimension);
+  // Too many candidates to score exactly, so the filter goes to faiss as a slot bitmap
+  VectorIndex::IdFilter even;
+  for (faiss::idx_t id = 0; id < 10000; id += 2) {
+    even.insert(id);
+  }
+  index.remove(40);
+  auto query_of = [&](size_t id) {
+    return std::vector<float>(vectors.begin() + id * dimension,
+                              vectors.begin() + (id + 1) * dimension);
+  };
+
+  auto hits = index.search(query_of(42), 10, &even);
+  ASSERT_EQ(hits.size(), 10u);
+  EXPECT_EQ(hits[0].id, 42);
+  for (const auto& hit : hits) {
+    EXPECT_EQ(hit.id % 2, 0);
+    EXPECT_NE(hit.id, 40);
+  }
+  // A filtered-out id is never returned, even when it is the query itself
+  for (const auto& hit : index.search(query_of(43), 10, &even)) {
+    EXPECT_EQ(hit.id % 2, 0);
+  }
+
+  std::vector<float> queries = query_of(42);
+  const auto second = query_of(1000);
+  queries.insert(queries.end(), second.begin(), second.end());
+  auto batch = index.search_batch(queries, 10, {}, &even);
+  ASSERT_EQ(batch.size(), 2u);
+  EXPECT_EQ(batch[0][0].id, 42);
+  EXPECT_EQ(batch[1][0].id, 1000);
+  for (const auto& query_hits : batch) {
+    for (const auto& hit : query_hits) {
+      EXPECT_EQ(hit.id % 2, 0);
+    }
+  }
+
+  // Small filters take the exact path in batches too
+  VectorIndex::IdFilter few{7, 42, 1000};
+  batch = index.search_batch(queries, 2, {}, &few);
+  ASSERT_EQ(batch[0].size(), 2u);
+  EXPECT_EQ(batch[0][0].id, 42);
+  EXPECT_EQ(batch[1][0].id, 1000);
+}
+
+TEST_F(VectorIndexTest, SearchBatch_MatchesSingleSearches) {
+  for (int id = 0; id < 20; ++id) {
+    index_.upsert(id, vec(std::to_string(id)));
+  }
+  index_.remove(3);
+
+  std::vector<float> queries;
+  for (const char* seed : {"3", "7", "19"}) {
+    auto q = vec(seed);
+    queries.insert(queries.end(), q.begin(), q.end());
+  }
+  auto batch = index_.search_batch(queries, 4);
+
+  ASSERT_EQ(batch.size(), 3u);
+  const char* seeds[] = {"3", "7", "19"};
+  for (size_t q = 0; q < batch.size(); ++q) {
+    auto single = index_.search(vec(seeds[q]), 4);
+    ASSERT_EQ(batch[q].size(), single.size());
+    for (size_t i = 0; i < single.size(); ++i) {
+      EXPECT_EQ(batch[q][i].id, single[i].id);
+      EXPECT_NE(batch[q][i].id, 3);
+    }
+  }
+  EXPECT_THROW(index_.search_batch(std::vector<float>(DIMENSION + 1, 0.1f), 1),
+               VectorIndexError);
+}
+
+TEST_F(VectorIndexTest, WrongDimensionThrows) {
+  std::vector<float> wrong(DIMENSION / 2, 0.5f);
+  EXPECT_THROW(index_.upsert(1, wrong), VectorIndexError);
+  index_.upsert(1, vec("a"));
+  EXPECT_THROW(index_.search(wrong, 1), VectorIndexError);
+}
+
+TEST_F(VectorIndexTest, Search_EmptyIndexReturnsEmpty) {
+  EXPECT_TRUE(index_.search(vec("a"), 3).empty());
+}
+
+TEST_F(VectorIndexTest, SerializeLoad_RoundTripsTombstones) {
+  index_.upsert(1, vec("a"));
+  index_.upsert(2, vec("b"));
+  index_.upsert(1, vec("c"));
+
+  VectorIndex restored(DIMENSION, 32, 100);
+  restored.load(index_.serialize());
+
+  EXPECT_EQ(restored.size(), 2);
+  EXPECT_EQ(restored.tombstone_count(), 1);
+  auto hits = restored.search(vec("c"), 1);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].id, 1);
+  EXPECT_LT(hits[0].distance, 0.001f);
+}
+
+TEST_F(VectorIndexTest, Load_RejectsMismatchedDimension) {
+  VectorIndex other(DIMENSION / 2, 32, 100);
+  other.upsert(1, std::vector<float>(DIMENSION / 2, 0.5f));
+
+  EXPECT_THROW(index_.load(other.serialize()), VectorIndexError);
+  EXPECT_THROW(index_.load({1, 2, 3}), VectorIndexError);
+}
+
+TEST_F(VectorIndexTest, ParseVectorIndexType_RoundTripsNames) {
+  for (auto type : {VectorIndexType::Flat, VectorIndexType::Hnsw, VectorIndexType::HnswSq8,
+                    VectorIndexType::IvfPq}) {
+    EXPECT_EQ(parse_vector_index_type(to_string(type)), type);
+  }
+  EXPECT_THROW(parse_vector_index_type("lsh"), VectorIndexError);
+}
+
+TEST_F(VectorIndexTest, IvfPq_RejectsSubquantizersThatDoNotDivideDimension) {
+  VectorIndexOptions options;
+  options.type = VectorIndexType::IvfPq;
+  options.pq_subquantizers = 3;
+  EXPECT_THROW(VectorIndex(16, options), VectorIndexError);
+}
+
+TEST_F(VectorIndexTest, HnswSq8_StaysFlatUntilEnoughTrainingVectors) {
+  VectorIndexOptions options;
+  options.type = VectorIndexType::HnswSq8;
+  VectorIndex index(DIMENSION, options);
+  index.upsert(1, vec("a"));
+  index.upsert(2, vec("b"));
+
+  // Too little data to train on: exact search over a flat stand-in
+  EXPECT_FALSE(index.uses_configured_type());
+  auto hits = index.search(vec("a"), 1);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].id, 1);
+  EXPECT_LT(hits[0].distance, 0.001f);
+
+  const auto vectors = random_vectors(index.min_training_vectors(), DIMENSION);
+  rebuild_from(index, vectors, DIMENSION);
+
+  EXPECT_TRUE(index.uses_configured_type());
+  const std::vector<float> query(vectors.begin() + 10 * DIMENSION,
+                                 vectors.begin() + 11 * DIMENSION);
+  hits = index.search(query, 1);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].id, 10);
+}
+
+TEST_F(VectorIndexTest, IvfPq_TrainsOnRebuildAndSearchesWithFilters) {
+  constexpr int dimension = 16;
+  VectorIndexOptions options;
+  options.type = VectorIndexType::IvfPq;
+  options.ivf_lists = 16;
+  options.pq_subquantizers = 8;
+  options.nprobe = 16;
+  VectorIndex index(dimension, options);
+
+  const auto vectors = random_vectors(index.min_training_vectors(), dimension);
+  rebuild_from(index, vectors, dimension);
+  ASSERT_TRUE(index.uses_configured_type());
+
+  const std::vector<float> query(vectors.begin() + 42 * dimension,
+                                 vectors.begin() + 43 * dimension);
+  auto hits = index.search(query, 10);
+  ASSERT_EQ(hits.size(), 10);
+  EXPECT_TRUE(std::any_of(hits.begin(), hits.end(), [](const auto& h) { return h.id == 42; }));
+
+  // Small candidate sets are scored against the decoded vectors directly
+  VectorIndex::IdFilter allowed{42, 7, 99};
+  hits = index.search(query, 2, &allowed);
+  ASSERT_EQ(hits.size(), 2);
+  EXPECT_EQ(hits[0].id, 42);
+  EXPECT_TRUE(allowed.count(hits[1].id));
+
+  // Upserts after training are encoded with the trained quantizers
+  index.upsert(5000000, query);
+  EXPECT_TRUE(index.contains(5000000));
+  EXPECT_TRUE(index.uses_configured_type());
+}
+
+TEST_F(VectorIndexTest, Load_RejectsSnapshotOfAnotherType) {
+  index_.upsert(1, vec("a"));
+
+  VectorIndexOptions options;
+  options.type = VectorIndexType::HnswSq8;
+  VectorIndex quantized(DIMENSION, options);
+  EXPECT_THROW(quantized.load(index_.serialize()), VectorIndexError);
+
+  // An untrained flat stand-in is still valid for the quantized type
+  VectorIndex small(DIMENSION, options);
+  small.upsert(1, vec("a"));
+  quantized.load(small.serialize());
+  EXPECT_EQ(quantized.size(), 1);
+}
+
+TEST_F(VectorIndexTest, Cosine_NormalizesOnInsertAndQuery) {
+  constexpr int dimension = 4;
+  VectorIndexOptions options;
+  options.metric = VectorMetric::Cosine;
+  VectorIndex index(dimension, options);
+  // Under L2 the short vector would be nearest to the query; under cosine only direction counts
+  index.upsert(1, {10.0f, 0.0f, 0.0f, 0.0f});
+  index.upsert(2, {0.1f, 0.1f, 0.0f, 0.0f});
+  index.upsert(3, {0.0f, -3.0f, 0.0f, 0.0f});
+
+  auto hits = index.search({0.2f, 0.0f, 0.0f, 0.0f}, 3);
+  ASSERT_EQ(hits.size(), 3);
+  EXPECT_EQ(hits[0].id, 1);
+  EXPECT_NEAR(hits[0].distance, 0.0f, 1e-5f);
+  EXPECT_EQ(hits[1].id, 2);
+  EXPECT_NEAR(hits[1].distance, 1.0f - std::sqrt(0.5f), 1e-5f);
+  EXPECT_EQ(hits[2].id, 3);
+  EXPECT_NEAR(hits[2].distance, 1.0f, 1e-5f);
+
+  // Exact filtered scoring and batches report the same distances
+  VectorIndex::IdFilter allowed{2, 3};
+  auto filtered = index.search({0.2f, 0.0f, 0.0f, 0.0f}, 2, &allowed);
+  ASSERT_EQ(filtered.size(), 2);
+  EXPECT_EQ(filtered[0].id, 2);
+  EXPECT_NEAR(filtered[0].distance, hits[1].distance, 1e-5f);
+  auto batch = index.search_batch({5.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f}, 1);
+  ASSERT_EQ(batch.size(), 2);
+  EXPECT_EQ(batch[0][0].id, 1);
+  EXPECT_EQ(batch[1][0].id, 3);
+  EXPECT_NEAR(batch[1][0].distance, 0.0f, 1e-5f);
+}
+
+TEST_F(VectorIndexTest, Cosine_RebuildMatchesUpserts) {
+  constexpr int dimension = 16;
+  VectorIndexOptions options;
+  options.metric = VectorMetric::Cosine;
+  VectorIndex upserted(dimension, options);
+  VectorIndex rebuilt(dimension, options);
+  auto vectors = random_vectors(50, dimension);
+  for (size_t i = 0; i < 50; ++i) {
+    upserted.upsert(static_cast<faiss::idx_t>(i),
+                    std::vector<float>(vectors.begin() + i * dimension,
+                                       vectors.begin() + (i + 1) * dimension));
+  }
+  rebuild_from(rebuilt, vectors, dimension);
+
+  const std::vector<float> query(vectors.begin(), vectors.begin() + dimension);
+  auto a = upserted.search(query, 5);
+  auto b = rebuilt.search(query, 5);
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    EXPECT_EQ(a[i].id, b[i].id);
+    EXPECT_NEAR(a[i].distance, b[i].distance, 1e-5f);
+  }
+  EXPECT_EQ(a[0].id, 0);
+}
+
+TEST_F(VectorIndexTest, StreamedRebuild_MatchesLoaderAcrossBatches) {
+  constexpr int dimension = 8;
+  const size_t count = VectorIndex::REBUILD_BATCH * 2 + 100;
+  VectorIndexOptions options;
+  options.type = VectorIndexType::Flat;
+  VectorIndex loaded(dimension, options);
+  VectorIndex streamed(dimension, options);
+  auto vectors = random_vectors(count, dimension);
+  rebuild_from(loaded, vectors, dimension);
+
+  // Row 5 has no vector, and the last row repeats id 7: the later row wins, as upserts would
+  std::atomic<size_t> reads{0};
+  streamed.rebuild([&] { return count; },
+                   [&](const std::vector<size_t>& rows, std::vector<faiss::idx_t>& ids,
+                       std::vector<float>& out) {
+                     ++reads;
+                     for (size_t row : rows) {
+                       if (row == 5) {
+                         continue;
+                       }
+                       ids.push_back(row == count - 1 ? 7 : static_cast<faiss::idx_t>(row));
+                       out.insert(out.end(), vectors.begin() + row * dimension,
+                                  vectors.begin() + (row + 1) * dimension);
+                     }
+                   });
+  EXPECT_EQ(reads.load(), 3u);
+  EXPECT_EQ(streamed.size(), count - 2);
+
+  const std::vector<float> middle(vectors.begin() + 20000 * dimension,
+                                  vectors.begin() + 20001 * dimension);
+  EXPECT_EQ(streamed.search(middle, 1)[0].id, 20000);
+  const std::vector<float> last(vectors.begin() + (count - 1) * dimension, vectors.end());
+  EXPECT_EQ(streamed.search(last, 1)[0].id, 7);
+  const std::vector<float> skipped(vectors.begin() + 5 * dimension,
+                                   vectors.begin() + 6 * dimension);
+  EXPECT_NE(streamed.search(skipped, 1)[0].id, 5);
+  EXPECT_EQ(loaded.search(skipped, 1)[0].id, 5);
+}
+
+TEST_F(VectorIndexTest, Load_RejectsSnapshotOfAnotherMetric) {
+  index_.upsert(1, vec("a"));
+
+  VectorIndexOptions options;
+  options.metric = VectorMetric::Cosine;
+  VectorIndex cosine(DIMENSION, options);
+  EXPECT_THROW(cosine.load(index_.serialize()), VectorIndexError);
+
+  EXPECT_EQ(parse_vector_metric(to_string(VectorMetric::Cosine)), VectorMetric::Cosine);
+  EXPECT_EQ(parse_vector_metric("l2"), VectorMetric::L2);
+  EXPECT_THROW(parse_vector_metric("dot"), VectorIndexError);
+}
+
+// Runs on the GPU copy when the build and machine have one and on the CPU otherwise; the
+// answers are the same either way
+TEST_F(VectorIndexTest, GpuDevice_BatchesMatchTheCpuIndex) {
+  constexpr int dimension = 32;
+  VectorIndexOptions options;
+  options.type = VectorIndexType::Flat;
+  options.gpu_device = 0;
+  options.gpu_min_batch = 1;
+  VectorIndex gpu(dimension, options);
+  VectorIndex cpu(dimension, VectorIndexOptions{VectorIndexType::Flat});
+  auto vectors = random_vectors(200, dimension);
+  rebuild_from(gpu, vectors, dimension);
+  rebuild_from(cpu, vectors, dimension);
+  EXPECT_EQ(gpu.stats().gpu, faiss_gpu::compiled_in() && faiss_gpu::device_count() > 0);
+  // Upserts reach the GPU copy, and tombstones are filtered out of its answers
+  const std::vector<float> extra(vectors.begin() + 5 * dimension,
+                                 vectors.begin() + 6 * dimension);
+  for (VectorIndex* index : {&gpu, &cpu}) {
+    index->upsert(500, extra);
+    index->remove(3);
+  }
+
+  const std::vector<float> queries(vectors.begin(), vectors.begin() + 4 * dimension);
+  auto a = gpu.search_batch(queries, 10);
+  auto b = cpu.search_batch(queries, 10);
+  ASSERT_EQ(a.size(), 4u);
+  for (size_t q = 0; q < a.size(); ++q) {
+    ASSERT_EQ(a[q].size(), b[q].size());
+    for (size_t i = 0; i < a[q].size(); ++i) {
+      EXPECT_EQ(a[q][i].id, b[q][i].id);
+      EXPECT_NEAR(a[q][i].distance, b[q][i].distance, 1e-3f);
+      EXPECT_NE(a[q][i].id, 3);
+    }
+  }
+
+  // Snapshots are CPU indexes whichever side built them
+  VectorIndex reloaded(dimension, options);
+  reloaded.load(gpu.serialize());
+  EXPECT_EQ(reloaded.size(), gpu.size());
+}
+
+// Recall@10 and latency of each type against exact search. Run with
+// --gtest_also_run_disabled_tests --gtest_filter=VectorIndexBenchmark.*
+TEST(VectorIndexBenchmark, DISABLED_TypesVersusFlat) {
+  constexpr int dimension = 128;
+  constexpr size_t count = 50000;
+  constexpr int queries = 200;
+  constexpr int k = 10;
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  std::vector<float> vectors(count * dimension);
+  for (float& x : vectors) {
+    x = dist(rng);
+  }
+  auto loader = [&](std::vector<faiss::idx_t>& ids, std::vector<float>& out) {
+    for (size_t i = 0; i < count; ++i) {
+      ids.push_back(static_cast<faiss::idx_t>(i));
+    }
+    out = vectors;
+  };
+  auto query = [&](int q) {
+    auto begin = vectors.begin() + static_cast<size_t>(q) * 97 * dimension;
+    std::vector<float> v(begin, begin + dimension);
+    for (float& x : v) {
+      x += 0.05f * dist(rng);
+    }
+    return v;
+  };
+  std::vector<std::vector<float>> query_vectors;
+  for (int q = 0; q < queries; ++q) {
+    query_vectors.push_back(query(q));
+  }
+
+  VectorIndexOptions flat_options;
+  flat_options.type = VectorIndexType::Flat;
+  VectorIndex exact(dimension, flat_options);
+  exact.rebuild(loader);
+  std::vector<std::unordered_set<faiss::idx_t>> truth;
+  for (const auto& v : query_vectors) {
+    std::unordered_set<faiss::idx_t> ids;
+    for (const auto& hit : exact.search(v, k)) {
+      ids.insert(hit.id);
+    }
+    truth.push_back(std::move(ids));
+  }
+
+  for (auto type : {VectorIndexType::Flat, VectorIndexType::Hnsw, VectorIndexType::HnswSq8,
+                    VectorIndexType::IvfPq}) {
+    VectorIndexOptions options;
+    options.type = type;
+    options.hnsw_m = 32;
+    options.ivf_lists = 256;
+    options.pq_subquantizers = 32;
+    VectorIndex index(dimension, options);
+    const auto build_start = std::chrono::steady_clock::now();
+    index.rebuild(loader);
+    const auto build_time = std::chrono::steady_clock::now() - build_start;
+
+    size_t found = 0;
+    const auto search_start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q) {
+      for (const auto& hit : index.search(query_vectors[q], k)) {
+        found += truth[q].count(hit.id);
+      }
+    }
+    const auto search_time = std::chrono::steady_clock::now() - search_start;
+    std::cout << to_string(type) << ": recall@10 "
+              << static_cast<double>(found) / (queries * k) << ", build "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(build_time).count()
+              << " ms, "
+              << std::chrono::duration_cast<std::chrono::microseconds>(search_time).count() /
+                     queries
+              << " us/query" << std::endl;
+  }
+}
+
+}  // namespace magic_core
@@ -0,0 +1,276 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "magic_core/db/vector_store.hpp"
+
+namespace magic_core {
+
+class VectorStoreTest : public ::testing::Test {
+ protected:
+  static constexpr int DIMENSION = 8;
+
+  void SetUp() override {
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    dir_ = std::filesystem::temp_directory_path() /
+           ("magic_vector_store_test_" + std::to_string(stamp));
+    std::filesystem::create_directories(dir_);
+    path_ = dir_ / "test.vec";
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(dir_);
+  }
+
+  static std::vector<float> vec(float seed) {
+    std::vector<float> v(DIMENSION);
+    for (int i = 0; i < DIMENSION; ++i) {
+      v[i] = seed + 0.01f * i;
+    }
+    return v;
+  }
+
+  std::filesystem::path dir_;
+  std::filesystem::path path_;
+  const std::string key_ = "vector_store_test_key";
+};
+
+TEST_F(VectorStoreTest, Append_ReadsBackUnderItsKey) {
+  VectorStore store(path_, key_, DIMENSION);
+  auto first = store.append(7, vec(1.0f));
+  auto second = store.append(9, vec(2.0f));
+
+  std::vector<float> out(DIMENSION);
+  ASSERT_TRUE(store.read(second, 9, out.data()));
+  EXPECT_EQ(out, vec(2.0f));
+  ASSERT_TRUE(store.read(first, 7, out.data()));
+  EXPECT_EQ(out, vec(1.0f));
+  // A record is only handed out for the row it was written for
+  EXPECT_FALSE(store.read(first, 9, out.data()));
+  EXPECT_FALSE(store.read(5, 7, out.data()));
+  EXPECT_EQ(store.record_count(), 2u);
+}
+
+TEST_F(VectorStoreTest, Append_GrowsPastInitialCapacityAndPersists) {
+  constexpr int count = 3000;
+  std::vector<int64_t> keys;
+  std::vector<float> vectors;
+  for (int i = 0; i < count; ++i) {
+    keys.push_back(i);
+    auto v = vec(static_cast<float>(i));
+    vectors.insert(vectors.end(), v.begin(), v.end());
+  }
+  std::vector<VectorStore::Offset> offsets;
+  {
+    VectorStore store(path_, key_, DIMENSION);
+    offsets = store.append(keys, vectors.data());
+  }
+
+  VectorStore reopened(path_, key_, DIMENSION);
+  std::vector<float> out(count * DIMENSION);
+  auto found = reopened.read_many(offsets, keys, out.data());
+  EXPECT_EQ(std::count(found.begin(), found.end(), true), count);
+  EXPECT_EQ(out, vectors);
+}
+
+TEST_F(VectorStoreTest, Records_AreNotStoredInPlaintext) {
+  {
+    VectorStore store(path_, key_, DIMENSION);
+    store.append(1, std::vector<float>(DIMENSION, 1234.5f));
+  }
+  std::ifstream in(path_, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  const float needle = 1234.5f;
+  EXPECT_EQ(bytes.find(std::string(reinterpret_cast<const char*>(&needle), sizeof(needle))),
+            std::string::npos);
+
+  // The wrong key decrypts garbage, which fails the key check
+  VectorStore wrong(path_, "other_key", DIMENSION);
+  std::vector<float> out(DIMENSION);
+  EXPECT_FALSE(wrong.read(0, 1, out.data()));
+}
+
+TEST_F(VectorStoreTest, Open_RejectsOtherDimensionOrEpoch) {
+  { VectorStore store(path_, key_, DIMENSION); }
+  EXPECT_EQ(VectorStore::stored_dimension(path_), DIMENSION);
+  EXPECT_THROW(VectorStore(path_, key_, DIMENSION * 2), VectorStoreError);
+  EXPECT_THROW(VectorStore(path_, key_, DIMENSION, 3), VectorStoreError);
+}
+
+TEST_F(VectorStoreTest, Compaction_KeepsListedRecordsAtNewOffsets) {
+  VectorStore store(path_, key_, DIMENSION);
+  auto dead = store.append(1, vec(1.0f));
+  auto live_a = store.append(2, vec(2.0f));
+  store.append(1, vec(3.0f));
+  auto live_b = store.append(3, vec(4.0f));
+  (void)dead;
+
+  store.write_compacted({live_b, live_a}, {3, 2});
+  // Nothing changes until the compaction is installed
+  EXPECT_EQ(store.record_count(), 4u);
+  store.install_compacted();
+
+  EXPECT_EQ(store.epoch(), 1);
+  EXPECT_EQ(store.record_count(), 2u);
+  std::vector<float> out(DIMENSION);
+  ASSERT_TRUE(store.read(0, 3, out.data()));
+  EXPECT_EQ(out, vec(4.0f));
+  ASSERT_TRUE(store.read(1, 2, out.data()));
+  EXPECT_EQ(out, vec(2.0f));
+}
+
+TEST_F(VectorStoreTest, Open_InstallsCommittedCompaction) {
+  {
+    VectorStore store(path_, key_, DIMENSION);
+    auto offset = store.append(2, vec(2.0f));
+    store.append(5, vec(5.0f));
+    store.write_compacted({offset}, {2});
+    // Stopped before install_compacted()
+  }
+
+  // The database committed epoch 1, so the compacted file is the one to use
+  VectorStore reopened(path_, key_, DIMENSION, 1);
+  EXPECT_EQ(reopened.record_count(), 1u);
+  std::vector<float> out(DIMENSION);
+  EXPECT_TRUE(reopened.read(0, 2, out.data()));
+  EXPECT_FALSE(std::filesystem::exists(reopened.compacted_path()));
+}
+
+TEST_F(VectorStoreTest, Open_DiscardsUncommittedCompaction) {
+  {
+    VectorStore store(path_, key_, DIMENSION);
+    auto offset = store.append(2, vec(2.0f));
+    store.append(5, vec(5.0f));
+    store.write_compacted({offset}, {2});
+  }
+
+  VectorStore reopened(path_, key_, DIMENSION, 0);
+  EXPECT_EQ(reopened.record_count(), 2u);
+  EXPECT_FALSE(std::filesystem::exists(reopened.compacted_path()));
+}
+
+TEST_F(VectorStoreTest, Encodings_ReadBackWithinTheirPrecision) {
+  for (auto encoding : {VectorEncoding::Float16, VectorEncoding::Int8}) {
+    const auto path = dir_ / (to_string(encoding) + ".vec");
+    {
+      VectorStore store(path, key_, DIMENSION, 0, encoding);
+      store.append(1, vec(0.25f));
+      store.append(2, vec(-3.0f));
+    }
+    VectorStore reopened(path, key_, DIMENSION);
+    EXPECT_EQ(reopened.encoding(), encoding);
+    std::vector<float> out(DIMENSION * 2);
+    auto found = reopened.read_many({0, 1}, {1, 2}, out.data());
+    EXPECT_EQ(std::count(found.begin(), found.end(), true), 2);
+    for (int i = 0; i < DIMENSION; ++i) {
+      EXPECT_NEAR(out[i], vec(0.25f)[i], 0.0025f) << to_string(encoding);
+      EXPECT_NEAR(out[DIMENSION + i], vec(-3.0f)[i], 0.015f) << to_string(encoding);
+    }
+  }
+}
+
+TEST_F(VectorStoreTest, Encodings_ShrinkTheFile) {
+  auto file_size = [&](VectorEncoding encoding) {
+    const auto path = dir_ / (to_string(encoding) + ".vec");
+    std::vector<int64_t> keys(3000);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::vector<float> vectors(keys.size() * DIMENSION, 0.5f);
+    {
+      VectorStore store(path, key_, DIMENSION, 0, encoding);
+      store.append(keys, vectors.data());
+    }
+    return std::filesystem::file_size(path);
+  };
+  const auto float32 = file_size(VectorEncoding::Float32);
+  EXPECT_LT(file_size(VectorEncoding::Float16), float32);
+  EXPECT_LT(file_size(VectorEncoding::Int8), file_size(VectorEncoding::Float16));
+}
+
+TEST_F(VectorStoreTest, Compaction_ConvertsToTheConfiguredEncoding) {
+  VectorStore::Offset offset = 0;
+  {
+    VectorStore store(path_, key_, DIMENSION);
+    offset = store.append(4, vec(4.0f));
+  }
+
+  // An existing file keeps its encoding until it is rewritten
+  VectorStore store(path_, key_, DIMENSION, 0, VectorEncoding::Float16);
+  EXPECT_EQ(store.encoding(), VectorEncoding::Float32);
+  EXPECT_EQ(store.configured_encoding(), VectorEncoding::Float16);
+  store.write_compacted({offset}, {4});
+  store.install_compacted();
+  EXPECT_EQ(store.encoding(), VectorEncoding::Float16);
+
+  std::vector<float> out(DIMENSION);
+  ASSERT_TRUE(store.read(0, 4, out.data()));
+  for (int i = 0; i < DIMENSION; ++i) {
+    EXPECT_NEAR(out[i], vec(4.0f)[i], 0.005f);
+  }
+  EXPECT_EQ(store.append(5, vec(5.0f)), 1u);
+}
+
+TEST_F(VectorStoreTest, Prefault_TouchesTheRecordsOnly) {
+  VectorStore store(path_, key_, DIMENSION);
+  const size_t empty = store.prefault();
+  store.append(std::vector<int64_t>{1, 2, 3}, std::vector<float>(3 * DIMENSION, 0.5f).data());
+
+  // The file is grown ahead of the records; only the ones written are read in
+  EXPECT_GT(std::filesystem::file_size(path_), store.prefault());
+  EXPECT_EQ(store.prefault() - empty, 3 * (sizeof(int64_t) + DIMENSION * sizeof(float)));
+  std::vector<float> out(DIMENSION);
+  EXPECT_TRUE(store.read(2, 3, out.data()));
+}
+
+TEST_F(VectorStoreTest, CopyTo_OpensWithTheRecordsCopiedOnly) {
+  VectorStore store(path_, key_, DIMENSION);
+  const auto first = store.append(1, vec(1.0f));
+  const auto second = store.append(2, vec(2.0f));
+  const auto copy = dir_ / "copy.vec";
+  size_t stepped = 0;
+
+  const size_t written = store.copy_to(copy, 2, [&](size_t bytes) { stepped += bytes; });
+  store.append(3, vec(3.0f));
+
+  EXPECT_EQ(std::filesystem::file_size(copy), written);
+  EXPECT_EQ(store.copy_size(2), written);
+  VectorStore restored(copy, key_, DIMENSION);
+  EXPECT_EQ(restored.record_count(), 2u);
+  std::vector<float> out(DIMENSION);
+  ASSERT_TRUE(restored.read(second, 2, out.data()));
+  EXPECT_EQ(out, vec(2.0f));
+  EXPECT_TRUE(restored.read(first, 1, out.data()));
+  EXPECT_EQ(stepped + store.prefault() - 3 * (sizeof(int64_t) + DIMENSION * sizeof(float)),
+            written);
+  EXPECT_THROW(store.copy_to(dir_ / "too_many.vec", 4), VectorStoreError);
+}
+
+TEST_F(VectorStoreTest, Read_ConcurrentWithAppends) {
+  VectorStore store(path_, key_, DIMENSION);
+  auto offset = store.append(0, vec(0.5f));
+  std::atomic<bool> done{false};
+  std::atomic<int> failures{0};
+  std::thread reader([&] {
+    std::vector<float> out(DIMENSION);
+    while (!done) {
+      if (!store.read(offset, 0, out.data()) || out != vec(0.5f)) {
+        ++failures;
+      }
+    }
+  });
+  // Enough appends to remap several times while the reader runs
+  for (int i = 1; i < 5000; ++i) {
+    store.append(i, vec(static_cast<float>(i)));
+  }
+  done = true;
+  reader.join();
+  EXPECT_EQ(failures, 0);
+}
+
+}  // namespace magic_core
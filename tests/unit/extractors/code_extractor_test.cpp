@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "magic_core/extractors/code_extractor.hpp"
+
+namespace magic_core {
+
+class CodeExtractorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    extractor_ = std::make_unique<CodeExtractor>();
+    test_dir_ = std::filesystem::temp_directory_path() / "code_extractor_tests";
+    std::filesystem::create_directories(test_dir_);
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  std::filesystem::path create_test_file(const std::string& filename, const std::string& content) {
+    auto file_path = test_dir_ / filename;
+    std::ofstream file(file_path, std::ios::binary);
+    file << content;
+    return file_path;
+  }
+
+  // A C++ function with enough body to be a chunk of its own
+  static std::string cpp_function(const std::string& name, const std::string& statement) {
+    std::string body;
+    for (int i = 0; i < 6; ++i) {
+      body += "  total += " + statement + " * " + std::to_string(i) + ";\n";
+    }
+    return "int " + name + "(int value) {\n  int total = 0;\n" + body + "  return total;\n}\n\n";
+  }
+
+  static std::vector<std::string> contents(const std::vector<Chunk>& chunks) {
+    std::vector<std::string> result;
+    for (const auto& chunk : chunks) {
+      result.push_back(chunk.content);
+    }
+    return result;
+  }
+
+  std::unique_ptr<CodeExtractor> extractor_;
+  std::filesystem::path test_dir_;
+};
+
+TEST_F(CodeExtractorTest, CanHandle_SourceExtensions) {
+  for (const char* name : {"main.cpp", "util.h", "App.java", "lib.rs", "server.go", "view.tsx",
+                           "index.js", "tool.py", "stubs.pyi", "Model.swift", "Program.cs"}) {
+    EXPECT_TRUE(extractor_->can_handle(name)) << name;
+  }
+  for (const char* name : {"notes.txt", "README.md", "manual.pdf", "Makefile", "main.CPP"}) {
+    EXPECT_FALSE(extractor_->can_handle(name)) << name;
+  }
+  EXPECT_EQ(extractor_->get_file_type(), FileType::Code);
+}
+
+TEST_F(CodeExtractorTest, Chunks_KeepFunctionsWhole) {
+  std::string first = cpp_function("first", "value");
+  std::string second = cpp_function("second", "value + 1");
+  std::string third = cpp_function("third", "value - 1");
+  auto file = create_test_file("math.cpp", first + second + third);
+
+  ExtractionResult result = extractor_->extract_with_hash(file);
+
+  ASSERT_EQ(result.chunks.size(), 3u);
+  EXPECT_EQ(contents(result.chunks), (std::vector<std::string>{first, second, third}));
+  for (size_t i = 0; i < result.chunks.size(); ++i) {
+    EXPECT_EQ(result.chunks[i].chunk_index, static_cast<int>(i));
+  }
+  EXPECT_EQ(result.content_hash, extractor_->get_content_hash(file));
+}
+
+TEST_F(CodeExtractorTest, EditingOneFunctionLeavesTheOtherChunksUnchanged) {
+  std::string first = cpp_function("first", "value");
+  std::string second = cpp_function("second", "value + 1");
+  std::string third = cpp_function("third", "value - 1");
+  auto before = extractor_->get_chunks(create_test_file("before.cpp", first + second + third));
+
+  std::string edited = cpp_function("second", "(value + 1) * (value + 2) / 3");
+  auto after = extractor_->get_chunks(create_test_file("after.cpp", first + edited + third));
+
+  ASSERT_EQ(before.size(), 3u);
+  ASSERT_EQ(after.size(), 3u);
+  EXPECT_EQ(after[0].content, before[0].content);
+  EXPECT_NE(after[1].content, before[1].content);
+  EXPECT_EQ(after[2].content, before[2].content);
+}
+
+TEST_F(CodeExtractorTest, Chunks_SmallDeclarationsMerge) {
+  std::string source = "int a() { return 1; }\nint b() { return 2; }\nint c() { return 3; }\n";
+  auto chunks = extractor_->get_chunks(create_test_file("small.c", source));
+
+  ASSERT_EQ(chunks.size(), 1u);
+  EXPECT_EQ(chunks[0].content, source);
+}
+
+TEST_F(CodeExtractorTest, Chunks_PythonMethodsAreSections) {
+  std::string method_body;
+  for (int i = 0; i < 6; ++i) {
+    method_body += "        self.total += value * " + std::to_string(i) + "\n";
+  }
+  std::string header = "class Counter:\n";
+  std::string add = "    def add(self, value):\n" + method_body + "\n";
+  std::string sub = "    def sub(self, value):\n" + method_body;
+  auto chunks = extractor_->get_chunks(create_test_file("counter.py", header + add + sub));
+
+  // The class line is too short on its own and merges into the first method
+  ASSERT_EQ(chunks.size(), 2u);
+  EXPECT_EQ(chunks[0].content, header + add);
+  EXPECT_EQ(chunks[1].content, sub);
+}
+
+TEST_F(CodeExtractorTest, Chunks_LongFunctionFallsBackToFixedSize) {
+  std::string body;
+  while (body.size() < 6000) {
+    body += "  call_something(value, " + std::to_string(body.size()) + ");\n";
+  }
+  auto chunks =
+      extractor_->get_chunks(create_test_file("long.cpp", "void f(int value) {\n" + body + "}\n"));
+
+  EXPECT_GT(chunks.size(), 1u);
+}
+
+TEST_F(CodeExtractorTest, EmptyFile_HasNoChunks) {
+  ExtractionResult result = extractor_->extract_with_hash(create_test_file("empty.rs", ""));
+  EXPECT_TRUE(result.chunks.empty());
+  EXPECT_TRUE(result.content_hash.empty());
+}
+
+TEST_F(CodeExtractorTest, UnsupportedExtension_Throws) {
+  auto file = create_test_file("notes.txt", "int f() {}\n");
+  EXPECT_THROW(extractor_->extract_with_hash(file), ContentExtractorError);
+}
+
+}  // namespace magic_core
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "magic_core/extractors/code_scanner.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core;
+
+// Offsets of the lines of text that begin with each marker
+std::vector<size_t> line_offsets(const std::string& text, const std::vector<std::string>& markers) {
+  std::vector<size_t> offsets;
+  for (const auto& marker : markers) {
+    size_t at = text.find("\n" + marker);
+    offsets.push_back(at == std::string::npos ? std::string::npos : at + 1);
+  }
+  return offsets;
+}
+
+TEST(CodeScannerTest, Brace_StartsAtEachTopLevelFunction) {
+  std::string text =
+      "#include <vector>\n"
+      "\n"
+      "// Adds one\n"
+      "int add_one(int x) {\n"
+      "  if (x > 0) {\n"
+      "    return x + 1;\n"
+      "  }\n"
+      "\n"
+      "  return x;\n"
+      "}\n"
+      "int twice(int x) { return 2 * x; }\n"
+      "\n"
+      "static const int LIMIT = 3;\n";
+  EXPECT_EQ(find_brace_declaration_starts(text, {.preprocessor = true}),
+            line_offsets(text, {"// Adds one", "int twice", "static const"}));
+}
+
+TEST(CodeScannerTest, Brace_DescendsIntoClassesAndNamespaces) {
+  std::string text =
+      "namespace app {\n"
+      "class Widget {\n"
+      " public:\n"
+      "  void draw() {\n"
+      "    paint();\n"
+      "  }\n"
+      "  int size() const;\n"
+      "};\n"
+      "}  // namespace app\n";
+  // An access label stays with the member below it
+  EXPECT_EQ(find_brace_declaration_starts(text, {.preprocessor = true}),
+            line_offsets(text, {"class Widget", " public:", "  int size"}));
+}
+
+TEST(CodeScannerTest, Brace_MultiLineSignatureIsOneDeclaration) {
+  std::string text =
+      "func Handle(w http.ResponseWriter,\n"
+      "    r *http.Request) {\n"
+      "\tserve(w, r)\n"
+      "}\n"
+      "\n"
+      "func Other() {}\n";
+  EXPECT_EQ(find_brace_declaration_starts(text, {.backtick_strings = true}),
+            line_offsets(text, {"func Other"}));
+}
+
+TEST(CodeScannerTest, Brace_IgnoresBracesInCommentsAndLiterals) {
+  std::string text =
+      "fn first() {\n"
+      "    let s = \"}\";\n"
+      "    let c = '}';\n"
+      "    /* } { */\n"
+      "    // }\n"
+      "}\n"
+      "fn second<'a>(x: &'a str) {}\n";
+  EXPECT_EQ(find_brace_declaration_starts(text, {}), line_offsets(text, {"fn second"}));
+}
+
+TEST(CodeScannerTest, Brace_BacktickAndRawStringsSpanLines) {
+  std::string js =
+      "const template = `\n"
+      "}\n"
+      "function fake() {\n"
+      "`;\n"
+      "function real() {}\n";
+  EXPECT_EQ(find_brace_declaration_starts(js, {.backtick_strings = true}),
+            line_offsets(js, {"function real"}));
+
+  std::string cpp =
+      "const char* text = R\"x(\n"
+      "}\n"
+      "void fake() {\n"
+      ")x\";\n"
+      "void real() {}\n";
+  EXPECT_EQ(find_brace_declaration_starts(cpp, {.preprocessor = true}),
+            line_offsets(cpp, {"void real"}));
+}
+
+TEST(CodeScannerTest, Brace_PreprocessorContinuationsAreOneLine) {
+  std::string text =
+      "#define BLOCK { \\\n"
+      "  }\n"
+      "void after() {}\n";
+  EXPECT_EQ(find_brace_declaration_starts(text, {.preprocessor = true}),
+            line_offsets(text, {"void after"}));
+}
+
+TEST(CodeScannerTest, Brace_EmptyAndUnbalancedInput) {
+  EXPECT_TRUE(find_brace_declaration_starts("", {}).empty());
+  // A stray closing brace must not underflow
+  std::string text = "}\n}\nint f() {}\n";
+  EXPECT_EQ(find_brace_declaration_starts(text, {}), line_offsets(text, {"int f"}));
+}
+
+TEST(CodeScannerTest, Python_StartsAtFunctionsClassesAndMethods) {
+  std::string text =
+      "import os\n"
+      "\n"
+      "def load(path):\n"
+      "    if path:\n"
+      "\n"
+      "        return open(path)\n"
+      "\n"
+      "class Store:\n"
+      "    \"\"\"Keeps things.\n"
+      "\n"
+      "def not_a_function():\n"
+      "    \"\"\"\n"
+      "    # A comment\n"
+      "    @property\n"
+      "    def size(self):\n"
+      "        return 0\n"
+      "\n"
+      "    async def fetch(self):\n"
+      "        pass\n";
+  EXPECT_EQ(find_python_declaration_starts(text),
+            line_offsets(text, {"def load", "class Store", "    # A comment", "    async def"}));
+}
+
+TEST(CodeScannerTest, Python_NestedFunctionsStayWithTheirParent) {
+  std::string text =
+      "def outer():\n"
+      "    def inner():\n"
+      "        return 1\n"
+      "    return inner\n"
+      "value = outer()\n"
+      "other = (\n"
+      "def_like_name)\n";
+  EXPECT_EQ(find_python_declaration_starts(text), line_offsets(text, {"value"}));
+}
+
+TEST(CodeScannerTest, Python_ContinuationsDoNotStartLines) {
+  std::string text =
+      "def call(a,\n"
+      "def_b):\n"
+      "    return a + \\\n"
+      "b\n"
+      "def next_one():\n"
+      "    pass\n";
+  EXPECT_EQ(find_python_declaration_starts(text), line_offsets(text, {"def next_one"}));
+}
+
+}  // namespace magic_tests
@@ -5,8 +5,10 @@
 #include <memory>
 #include <string>
 
+#include "magic_core/extractors/code_extractor.hpp"
 #include "magic_core/extractors/content_extractor_factory.hpp"
 #include "magic_core/extractors/markdown_extractor.hpp"
+#include "magic_core/extractors/pdf_extractor.hpp"
 #include "magic_core/extractors/plaintext_extractor.hpp"
 #include "../../common/utilities_test.hpp"
 
@@ -98,6 +100,25 @@ TEST_F(ContentExtractorFactoryTest, GetExtractor_TextFiles) {
   }
 }
 
+TEST_F(ContentExtractorFactoryTest, GetExtractor_PdfFiles) {
+  auto file_path = test_dir_ / "manual.pdf";
+
+  const ContentExtractor& extractor = factory_->get_extractor_for(file_path);
+
+  EXPECT_NE(dynamic_cast<const PdfExtractor*>(&extractor), nullptr);
+  EXPECT_EQ(extractor.get_file_type(), FileType::PDF);
+  EXPECT_TRUE(extractor.streams_chunks());
+}
+
+TEST_F(ContentExtractorFactoryTest, GetExtractor_CodeFiles) {
+  for (const char* filename : {"main.cpp", "handler.go", "component.tsx", "script.py"}) {
+    const ContentExtractor& extractor = factory_->get_extractor_for(test_dir_ / filename);
+
+    EXPECT_NE(dynamic_cast<const CodeExtractor*>(&extractor), nullptr) << filename;
+    EXPECT_EQ(extractor.get_file_type(), FileType::Code) << filename;
+  }
+}
+
 // Test factory for unsupported files
 TEST_F(ContentExtractorFactoryTest, GetExtractor_UnsupportedFiles) {
   // Test various unsupported file extensions - should throw exceptions
@@ -25,10 +25,13 @@ class MockContentExtractor : public ContentExtractor {
   static constexpr size_t TEST_MAX_CHUNK_SIZE = MAX_CHUNK_SIZE;
   static constexpr size_t TEST_FIXED_CHUNK_SIZE = FIXED_CHUNK_SIZE;
   static constexpr size_t TEST_OVERLAP_SIZE = OVERLAP_SIZE;
+  static constexpr size_t TEST_PARALLEL_REGION_SIZE = PARALLEL_REGION_SIZE;
   
   // Expose protected method for testing
   using ContentExtractor::split_into_fixed_chunks;
   using ContentExtractor::compute_hash_from_content;
+  using ContentExtractor::build_chunks;
+  using ContentExtractor::stream_built_chunks;
 };
 
 class ContentExtractorTest : public magic_tests::MetadataStoreTestBase {
@@ -168,6 +171,18 @@ TEST_F(ContentExtractorTest, GetContentHash_SameContentSameHash) {
   EXPECT_EQ(hash1, hash2);
 }
 
+TEST_F(ContentExtractorTest, GetContentHash_MultiBlockFileMatchesWholeContentHash) {
+  // Arrange - spans several read blocks and ends mid-block
+  std::string content = create_content_of_size(3 * (1 << 20) + 12345, "streaming hash ");
+  auto big_file = create_test_file("multi_block.txt", content);
+
+  // Act
+  std::string streamed = mock_extractor_->get_content_hash(big_file);
+
+  // Assert
+  EXPECT_EQ(streamed, mock_extractor_->compute_hash_from_content(content));
+}
+
 TEST_F(ContentExtractorTest, GetContentHash_NonExistentFile) {
   // Arrange
   auto non_existent = test_dir_ / "does_not_exist.txt";
@@ -508,4 +523,112 @@ TEST_F(ContentExtractorTest, SplitIntoFixedChunks_UTF8Boundary_ChunkSizeVerifica
   }
 }
 
+TEST_F(ContentExtractorTest, BuildChunks_MergesSectionsUntilMinSize) {
+  // Arrange - Three sections that only reach MIN_CHUNK_SIZE together, then a short tail
+  const size_t section = MockContentExtractor::TEST_MIN_CHUNK_SIZE / 3 + 1;
+  std::string content = std::string(section, 'a') + std::string(section, 'b') +
+                        std::string(section, 'c') + "tail";
+
+  // Act
+  auto chunks = mock_extractor_->build_chunks(content, {section, 2 * section, 3 * section});
+
+  // Assert
+  ASSERT_EQ(chunks.size(), 2);
+  EXPECT_EQ(chunks[0].content, content.substr(0, 3 * section));
+  EXPECT_EQ(chunks[1].content, "tail");
+  EXPECT_EQ(chunks[0].chunk_index, 0);
+  EXPECT_EQ(chunks[1].chunk_index, 1);
+}
+
+TEST_F(ContentExtractorTest, BuildChunks_SplitsOversizedSections) {
+  // Arrange
+  std::string content(MockContentExtractor::TEST_MAX_CHUNK_SIZE * 2, 'x');
+
+  // Act
+  auto chunks = mock_extractor_->build_chunks(content, {});
+
+  // Assert - Same pieces as the fixed-size fallback, indexed in order
+  auto expected = mock_extractor_->split_into_fixed_chunks(content);
+  ASSERT_EQ(chunks.size(), expected.size());
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    EXPECT_EQ(chunks[i].content, expected[i]);
+    EXPECT_EQ(chunks[i].chunk_index, static_cast<int>(i));
+  }
+}
+
+TEST_F(ContentExtractorTest, BuildChunks_KeepsEveryByte) {
+  // Arrange - Repeated and trailing boundaries must not drop or duplicate content
+  std::string content = "# one\n\n" + std::string(MockContentExtractor::TEST_MIN_CHUNK_SIZE, 'a') +
+                        "\n\n# two\n\n";
+
+  // Act
+  auto chunks = mock_extractor_->build_chunks(content, {0, 0, 7, content.size() - 9,
+                                                        content.size(), content.size()});
+
+  // Assert
+  std::string joined;
+  for (const auto& chunk : chunks) {
+    joined += chunk.content;
+  }
+  EXPECT_EQ(joined, content);
+  EXPECT_TRUE(mock_extractor_->build_chunks("", {}).empty());
+}
+
+TEST_F(ContentExtractorTest, BuildChunks_LargeDocument_ChunksRegionsInParallel) {
+  // Arrange - Enough paragraphs for several regions
+  const std::string paragraph = std::string(MockContentExtractor::TEST_MIN_CHUNK_SIZE * 3, 'p') +
+                                "\n\n";
+  const size_t paragraphs = MockContentExtractor::TEST_PARALLEL_REGION_SIZE * 3 / paragraph.size();
+  std::string content;
+  content.reserve(paragraphs * paragraph.size());
+  std::vector<size_t> starts;
+  for (size_t i = 0; i < paragraphs; ++i) {
+    if (i > 0) {
+      starts.push_back(content.size());
+    }
+    content += paragraph;
+  }
+
+  // Act
+  auto chunks = mock_extractor_->build_chunks(content, starts);
+
+  // Assert - Every paragraph is already a full chunk, so regions change nothing
+  ASSERT_EQ(chunks.size(), paragraphs);
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    EXPECT_EQ(chunks[i].chunk_index, static_cast<int>(i));
+    EXPECT_EQ(chunks[i].content, paragraph);
+  }
+}
+
+TEST_F(ContentExtractorTest, StreamBuiltChunks_LargeDocument_SameChunksARegionAtATime) {
+  // Arrange - Short paragraphs that merge, over several regions
+  std::string content;
+  std::vector<size_t> starts;
+  for (size_t i = 0; content.size() < MockContentExtractor::TEST_PARALLEL_REGION_SIZE * 3; ++i) {
+    if (i > 0) {
+      starts.push_back(content.size());
+    }
+    content += std::string(MockContentExtractor::TEST_MIN_CHUNK_SIZE / 3 + i % 7, 'q') + "\n\n";
+  }
+
+  // Act
+  std::vector<Chunk> streamed;
+  std::vector<float> progress;
+  mock_extractor_->stream_built_chunks(content, starts, [&](std::vector<Chunk>& chunks,
+                                                            float extracted) {
+    streamed.insert(streamed.end(), chunks.begin(), chunks.end());
+    progress.push_back(extracted);
+  });
+
+  // Assert
+  auto whole = mock_extractor_->build_chunks(content, starts);
+  ASSERT_EQ(streamed.size(), whole.size());
+  for (size_t i = 0; i < whole.size(); ++i) {
+    EXPECT_EQ(streamed[i].chunk_index, whole[i].chunk_index);
+    EXPECT_EQ(streamed[i].content, whole[i].content);
+  }
+  EXPECT_EQ(progress.size(), 3u);
+  EXPECT_FLOAT_EQ(progress.back(), 1.0f);
+}
+
 } // namespace magic_core
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "magic_core/extractors/content_extractor.hpp"
+#include "magic_core/extractors/mapped_file.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core;
+
+class MappedFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    test_dir_ = std::filesystem::temp_directory_path() / "mapped_file_tests";
+    std::filesystem::create_directories(test_dir_);
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  std::filesystem::path write_file(const std::string& name, const std::string& content) {
+    auto path = test_dir_ / name;
+    std::ofstream out(path, std::ios::binary);
+    out << content;
+    return path;
+  }
+
+  std::filesystem::path test_dir_;
+};
+
+TEST_F(MappedFileTest, ViewMatchesFileContent) {
+  std::string content = "line one\n\nline two with bytes \x01\x02\xff\n";
+  MappedFile file(write_file("content.txt", content));
+
+  EXPECT_EQ(file.size(), content.size());
+  EXPECT_EQ(file.view(), content);
+}
+
+TEST_F(MappedFileTest, EmptyFileHasEmptyView) {
+  MappedFile file(write_file("empty.txt", ""));
+
+  EXPECT_EQ(file.size(), 0u);
+  EXPECT_TRUE(file.view().empty());
+  EXPECT_FALSE(file.is_mapped());
+}
+
+TEST_F(MappedFileTest, NonExistentFileThrows) {
+  EXPECT_THROW(MappedFile(test_dir_ / "missing.txt"), ContentExtractorError);
+}
+
+TEST_F(MappedFileTest, MoveTransfersTheView) {
+  std::string content(100000, 'm');
+  MappedFile original(write_file("large.txt", content));
+
+  MappedFile moved(std::move(original));
+
+  EXPECT_EQ(moved.view(), content);
+  EXPECT_TRUE(original.view().empty());
+}
+
+}  // namespace magic_tests
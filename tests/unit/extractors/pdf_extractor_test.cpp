@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "magic_core/extractors/pdf_extractor.hpp"
+
+namespace magic_core {
+
+class PdfExtractorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    extractor_ = std::make_unique<PdfExtractor>();
+    test_dir_ = std::filesystem::temp_directory_path() / "pdf_extractor_tests";
+    std::filesystem::create_directories(test_dir_);
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  // Writes a minimal uncompressed PDF with one page per entry of pages, each line of a page
+  // drawn below the previous one in Helvetica
+  std::filesystem::path write_pdf(const std::string& filename,
+                                  const std::vector<std::vector<std::string>>& pages) {
+    std::vector<std::string> objects;
+    const size_t page_count = pages.size();
+    std::string kids;
+    for (size_t p = 0; p < page_count; ++p) {
+      kids += std::to_string(4 + 2 * p) + " 0 R ";
+    }
+    objects.push_back("<< /Type /Catalog /Pages 2 0 R >>");
+    objects.push_back("<< /Type /Pages /Kids [" + kids + "] /Count " +
+                      std::to_string(page_count) + " >>");
+    objects.push_back("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>");
+    for (size_t p = 0; p < page_count; ++p) {
+      std::string stream = "BT /F1 10 Tf 12 TL 40 800 Td\n";
+      for (const std::string& line : pages[p]) {
+        stream += "(" + line + ") Tj T*\n";
+      }
+      stream += "ET";
+      objects.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 842] /Resources << "
+                        "/Font << /F1 3 0 R >> >> /Contents " +
+                        std::to_string(5 + 2 * p) + " 0 R >>");
+      objects.push_back("<< /Length " + std::to_string(stream.size()) + " >>\nstream\n" +
+                        stream + "\nendstream");
+    }
+
+    std::string pdf = "%PDF-1.4\n";
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < objects.size(); ++i) {
+      offsets.push_back(pdf.size());
+      pdf += std::to_string(i + 1) + " 0 obj\n" + objects[i] + "\nendobj\n";
+    }
+    const size_t xref = pdf.size();
+    pdf += "xref\n0 " + std::to_string(objects.size() + 1) + "\n0000000000 65535 f \n";
+    for (size_t offset : offsets) {
+      char entry[32];
+      std::snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+      pdf += entry;
+    }
+    pdf += "trailer\n<< /Size " + std::to_string(objects.size() + 1) +
+           " /Root 1 0 R >>\nstartxref\n" + std::to_string(xref) + "\n%%EOF\n";
+
+    auto path = test_dir_ / filename;
+    std::ofstream(path, std::ios::binary) << pdf;
+    return path;
+  }
+
+  // Lines of about 80 characters, tagged with their page so its text can be found again
+  static std::vector<std::string> page_lines(int page, int lines) {
+    std::vector<std::string> out;
+    for (int l = 0; l < lines; ++l) {
+      out.push_back("page" + std::to_string(page) + " line " + std::to_string(l) +
+                    " the quick brown fox jumps over the lazy dog again and again");
+    }
+    return out;
+  }
+
+  struct Streamed {
+    std::vector<Chunk> chunks;
+    std::vector<float> extracted;
+  };
+
+  Streamed stream(const std::filesystem::path& path) {
+    Streamed streamed;
+    extractor_->stream_chunks(path, [&](std::vector<Chunk>& chunks, float extracted) {
+      for (Chunk& chunk : chunks) {
+        streamed.chunks.push_back(std::move(chunk));
+      }
+      streamed.extracted.push_back(extracted);
+    });
+    return streamed;
+  }
+
+  static std::string joined(const std::vector<Chunk>& chunks) {
+    std::string text;
+    for (const Chunk& chunk : chunks) {
+      text += chunk.content;
+    }
+    return text;
+  }
+
+  std::unique_ptr<PdfExtractor> extractor_;
+  std::filesystem::path test_dir_;
+};
+
+TEST_F(PdfExtractorTest, CanHandle_PdfFiles) {
+  EXPECT_TRUE(extractor_->can_handle("/path/to/manual.pdf"));
+  EXPECT_FALSE(extractor_->can_handle("/path/to/manual.txt"));
+  EXPECT_FALSE(extractor_->can_handle("/path/to/manual.pdf.md"));
+  EXPECT_TRUE(extractor_->streams_chunks());
+  EXPECT_EQ(extractor_->get_file_type(), FileType::PDF);
+}
+
+TEST_F(PdfExtractorTest, StreamChunks_HandsOutPagesInOrder) {
+  auto path = write_pdf("ordered.pdf", {page_lines(0, 40), page_lines(1, 40), page_lines(2, 40)});
+
+  Streamed streamed = stream(path);
+
+  ASSERT_FALSE(streamed.chunks.empty());
+  for (size_t i = 0; i < streamed.chunks.size(); ++i) {
+    EXPECT_EQ(streamed.chunks[i].chunk_index, static_cast<int>(i));
+  }
+  // One call per page, each page further into the document
+  ASSERT_EQ(streamed.extracted.size(), 3u);
+  EXPECT_LT(streamed.extracted[0], streamed.extracted[1]);
+  EXPECT_FLOAT_EQ(streamed.extracted.back(), 1.0f);
+  const std::string text = joined(streamed.chunks);
+  const size_t first = text.find("page0 line 0");
+  const size_t second = text.find("page1 line 0");
+  const size_t third = text.find("page2 line 39");
+  ASSERT_NE(first, std::string::npos);
+  ASSERT_NE(second, std::string::npos);
+  ASSERT_NE(third, std::string::npos);
+  EXPECT_LT(first, second);
+  EXPECT_LT(second, third);
+}
+
+TEST_F(PdfExtractorTest, StreamChunks_ShortPagesAreChunkedTogether) {
+  auto path = write_pdf("short.pdf", {{"alpha"}, {"beta"}, {"gamma"}});
+
+  Streamed streamed = stream(path);
+
+  // Each page alone is far below the minimum chunk size
+  ASSERT_EQ(streamed.chunks.size(), 1u);
+  const std::string& content = streamed.chunks[0].content;
+  EXPECT_NE(content.find("alpha"), std::string::npos);
+  EXPECT_NE(content.find("gamma"), std::string::npos);
+  EXPECT_LT(content.find("alpha"), content.find("beta"));
+  EXPECT_FLOAT_EQ(streamed.extracted.back(), 1.0f);
+}
+
+TEST_F(PdfExtractorTest, StreamChunks_ManyPages_KeepsEveryPageInOrder) {
+  // More pages than extraction threads and read-ahead combined
+  std::vector<std::vector<std::string>> pages;
+  for (int p = 0; p < 120; ++p) {
+    pages.push_back(page_lines(p, 20));
+  }
+  auto path = write_pdf("many.pdf", pages);
+
+  Streamed streamed = stream(path);
+
+  EXPECT_EQ(streamed.extracted.size(), pages.size());
+  const std::string text = joined(streamed.chunks);
+  size_t previous = 0;
+  for (int p = 0; p < 120; ++p) {
+    size_t at = text.find("page" + std::to_string(p) + " line 19 ");
+    ASSERT_NE(at, std::string::npos) << "page " << p;
+    EXPECT_GE(at, previous);
+    previous = at;
+  }
+}
+
+TEST_F(PdfExtractorTest, ExtractWithHash_MatchesStreamedChunksAndHashesTheFile) {
+  auto path = write_pdf("hashed.pdf", {page_lines(0, 30), page_lines(1, 30)});
+
+  ExtractionResult result = extractor_->extract_with_hash(path);
+  Streamed streamed = stream(path);
+
+  EXPECT_EQ(result.content_hash, extractor_->get_content_hash(path));
+  ASSERT_EQ(result.chunks.size(), streamed.chunks.size());
+  for (size_t i = 0; i < result.chunks.size(); ++i) {
+    EXPECT_EQ(result.chunks[i].content, streamed.chunks[i].content);
+  }
+  EXPECT_EQ(extractor_->get_chunks(path).size(), result.chunks.size());
+}
+
+TEST_F(PdfExtractorTest, EmptyFile_HasNoChunks) {
+  auto path = test_dir_ / "empty.pdf";
+  std::ofstream(path).close();
+
+  ExtractionResult result = extractor_->extract_with_hash(path);
+  EXPECT_TRUE(result.chunks.empty());
+  Streamed streamed = stream(path);
+  EXPECT_TRUE(streamed.chunks.empty());
+  EXPECT_EQ(streamed.extracted, std::vector<float>{1.0f});
+}
+
+TEST_F(PdfExtractorTest, NotAPdf_Throws) {
+  auto path = test_dir_ / "broken.pdf";
+  std::ofstream(path) << "this is not a pdf";
+
+  EXPECT_THROW(stream(path), ContentExtractorError);
+  EXPECT_THROW(extractor_->extract_with_hash(test_dir_ / "missing.pdf"), ContentExtractorError);
+}
+
+}  // namespace magic_core
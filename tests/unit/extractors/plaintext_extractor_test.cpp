@@ -207,6 +207,21 @@ TEST_F(PlainTextExtractorTest, GetChunks_LastParagraphBehavior) {
 }
 
 // Test different blank line patterns
+TEST_F(PlainTextExtractorTest, GetChunks_TrailingBlankLines_KeepsLastParagraph) {
+  // Arrange - A short final paragraph followed by blank lines
+  std::string large_paragraph = create_paragraph(TestableExtractor::MIN_SIZE + 50, 'X');
+  std::string content = large_paragraph + "\n\nShort ending.\n\n";
+  auto file = create_test_file("trailing_blank_lines.txt", content);
+
+  // Act
+  auto chunks = extractor_->get_chunks(file);
+
+  // Assert - The last paragraph is kept rather than dropped with its separator
+  ASSERT_EQ(chunks.size(), 2);
+  EXPECT_EQ(chunks[0].content + chunks[1].content, content);
+  EXPECT_EQ(chunks[1].content, "Short ending.\n\n");
+}
+
 TEST_F(PlainTextExtractorTest, GetChunks_VariousBlankLinePatterns) {
   // Arrange - Test different ways of separating paragraphs
   size_t para_size = TestableExtractor::MIN_SIZE / 3;
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "magic_core/extractors/text_scanner.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core;
+
+// The expressions the scanners replaced; boundaries must stay identical to them
+std::vector<size_t> regex_heading_starts(const std::string& text) {
+  const std::regex heading_regex(
+      R"(^#+\s.*)", std::regex_constants::ECMAScript | std::regex_constants::multiline);
+  std::vector<size_t> starts;
+  for (std::sregex_iterator i(text.begin(), text.end(), heading_regex), end; i != end; ++i) {
+    starts.push_back(i->position());
+  }
+  return starts;
+}
+
+std::vector<size_t> regex_paragraph_breaks(const std::string& text) {
+  const std::regex paragraph_regex(
+      R"(\n\s*\n)", std::regex_constants::ECMAScript | std::regex_constants::multiline);
+  std::vector<size_t> breaks;
+  for (std::sregex_iterator i(text.begin(), text.end(), paragraph_regex), end; i != end; ++i) {
+    breaks.push_back(i->position() + i->length());
+  }
+  return breaks;
+}
+
+// Documents shaped like the ones in the Markdown and plain text extractor tests
+std::vector<std::string> sample_documents() {
+  std::string sections;
+  for (int i = 0; i < 20; ++i) {
+    sections += "# Section " + std::to_string(i) + "\n\n" + std::string(50 + i * 40, 'a') + "\n";
+  }
+  return {
+      "",
+      "Just text without any headings at all.",
+      "# Title\n\nShort intro.\n\n## Subsection\n\nMore text.\n\n### Deep\n\nEnd.",
+      sections,
+      "# Code\n\n```cpp\n# not a heading inside code? still a line start\nint x;\n```\n",
+      "# Windows\r\n\r\nLine one\r\n\r\n## Second\r\nLine two\r\n",
+      "#NoSpace\n #Indented\n#\tTabbed\n#\n# After bare hash\n",
+      "Para one.\n\nPara two.\n   \n\t\nPara three.\n\n\n\nPara four.\n",
+      std::string(5000, 'x') + "\n\n" + std::string(5000, 'y'),
+  };
+}
+
+TEST(TextScannerTest, HeadingStarts_FindsAtxHeadingsAtLineStart) {
+  std::string text = "intro\n# One\ntext\n## Two\nnot # three\n#four\n### Five";
+  EXPECT_EQ(find_heading_starts(text), (std::vector<size_t>{6, 17, 42}));
+}
+
+TEST(TextScannerTest, HeadingStarts_TreatsCarriageReturnAsLineEnd) {
+  EXPECT_EQ(find_heading_starts("a\r# b\r\n# c"), (std::vector<size_t>{2, 7}));
+}
+
+TEST(TextScannerTest, ParagraphBreaks_SplitAfterBlankLineRuns) {
+  std::string text = "one\n\ntwo\n \t\n\nthree\nsame paragraph";
+  EXPECT_EQ(find_paragraph_breaks(text), (std::vector<size_t>{5, 13}));
+}
+
+TEST(TextScannerTest, ParagraphBreaks_NoBlankLines) {
+  EXPECT_TRUE(find_paragraph_breaks("one\ntwo\nthree").empty());
+  EXPECT_TRUE(find_paragraph_breaks("").empty());
+}
+
+TEST(TextScannerTest, MatchesRegexBoundaries) {
+  for (const auto& document : sample_documents()) {
+    EXPECT_EQ(find_heading_starts(document), regex_heading_starts(document)) << document;
+    EXPECT_EQ(find_paragraph_breaks(document), regex_paragraph_breaks(document)) << document;
+  }
+}
+
+// Compares the scanners with the regex path they replaced. Disabled by default; run with
+//   magic_folder_tests --gtest_also_run_disabled_tests --gtest_filter="TextScannerBenchmark.*"
+TEST(TextScannerBenchmark, DISABLED_ScannersVersusRegex) {
+  constexpr int ITERATIONS = 20;
+  std::string document;
+  for (const auto& sample : sample_documents()) {
+    document += sample + "\n\n";
+  }
+  while (document.size() < (1 << 20)) {
+    document += document;
+  }
+
+  auto time_ms = [&](auto&& scan) {
+    auto start = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (int i = 0; i < ITERATIONS; ++i) {
+      found += scan(document).size();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_GT(found, 0u);
+    return elapsed.count() / ITERATIONS;
+  };
+
+  double regex_headings = time_ms(regex_heading_starts);
+  double scan_headings = time_ms([](const std::string& s) { return find_heading_starts(s); });
+  double regex_paragraphs = time_ms(regex_paragraph_breaks);
+  double scan_paragraphs = time_ms([](const std::string& s) { return find_paragraph_breaks(s); });
+
+  std::cout << "Document: " << document.size() << " bytes, mean of " << ITERATIONS << " runs\n"
+            << "  headings:   regex " << regex_headings << " ms, scanner " << scan_headings
+            << " ms\n"
+            << "  paragraphs: regex " << regex_paragraphs << " ms, scanner " << scan_paragraphs
+            << " ms" << std::endl;
+  EXPECT_LT(scan_headings, regex_headings);
+  EXPECT_LT(scan_paragraphs, regex_paragraphs);
+}
+
+}  // namespace magic_tests
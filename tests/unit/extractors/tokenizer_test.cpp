@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <utf8.h>
+
+#include "magic_core/extractors/plaintext_extractor.hpp"
+#include "magic_core/extractors/tokenizer.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core;
+
+class TokenizerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    test_dir_ = std::filesystem::temp_directory_path() / "tokenizer_tests";
+    std::filesystem::create_directories(test_dir_);
+    vocab_path_ = write_file("vocab.txt",
+                             "[PAD]\n[UNK]\n[CLS]\n[SEP]\nun\n##aff\n##able\nhello\nworld\n,\n!\n"
+                             "word\n##s\n中\n");
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  std::filesystem::path write_file(const std::string& name, const std::string& content) {
+    auto path = test_dir_ / name;
+    std::ofstream out(path, std::ios::binary);
+    out << content;
+    return path;
+  }
+
+  std::filesystem::path test_dir_;
+  std::filesystem::path vocab_path_;
+};
+
+TEST_F(TokenizerTest, Approximate_CountsRoundUp) {
+  ApproximateTokenizer tokenizer(3.5f);
+
+  EXPECT_EQ(tokenizer.count_tokens(""), 0);
+  EXPECT_EQ(tokenizer.count_tokens(std::string(7, 'a')), 2);
+  EXPECT_EQ(tokenizer.count_tokens(std::string(8, 'a')), 3);
+}
+
+TEST_F(TokenizerTest, Approximate_PrefixStopsOnCodePointBoundary) {
+  ApproximateTokenizer tokenizer(3.5f);
+  // 7 bytes fit in 2 tokens; the cut moves past the 3-byte character it would split
+  std::string text = "abcdef世界";
+
+  size_t length = tokenizer.prefix_length(text, 2);
+
+  EXPECT_EQ(length, 9);
+  EXPECT_TRUE(utf8::is_valid(text.begin(), text.begin() + length));
+  EXPECT_EQ(tokenizer.prefix_length("abc", 2), 3);
+}
+
+TEST_F(TokenizerTest, WordPiece_SplitsIntoLongestPieces) {
+  auto tokenizer = WordPieceTokenizer::load(vocab_path_);
+
+  // un ##aff ##able
+  EXPECT_EQ(tokenizer->count_tokens("unaffable"), 3);
+  // hello , world !
+  EXPECT_EQ(tokenizer->count_tokens("Hello, WORLD!"), 4);
+  // word ##s word
+  EXPECT_EQ(tokenizer->count_tokens("  words\n\tword  "), 3);
+  EXPECT_EQ(tokenizer->count_tokens(""), 0);
+}
+
+TEST_F(TokenizerTest, WordPiece_UncoverableWordIsOneToken) {
+  auto tokenizer = WordPieceTokenizer::load(vocab_path_);
+
+  EXPECT_EQ(tokenizer->count_tokens("zzz"), 1);
+  EXPECT_EQ(tokenizer->count_tokens("unzzz hello"), 2);
+  EXPECT_EQ(tokenizer->count_tokens(std::string(WordPieceTokenizer::MAX_WORD_CHARS + 1, 'w')), 1);
+}
+
+TEST_F(TokenizerTest, WordPiece_CjkCharactersAreSeparateWords) {
+  auto tokenizer = WordPieceTokenizer::load(vocab_path_);
+
+  EXPECT_EQ(tokenizer->count_tokens("中中中"), 3);
+}
+
+TEST_F(TokenizerTest, WordPiece_LowercaseCanBeDisabled) {
+  auto tokenizer = WordPieceTokenizer::load(vocab_path_, /*lowercase*/ false);
+
+  EXPECT_EQ(tokenizer->count_tokens("hello Hello"), 2);
+  EXPECT_NE(tokenizer, WordPieceTokenizer::load(vocab_path_));
+}
+
+TEST_F(TokenizerTest, WordPiece_PrefixEndsWhereNextTokenStarts) {
+  auto tokenizer = WordPieceTokenizer::load(vocab_path_);
+  std::string text = "hello world, unaffable";
+
+  EXPECT_EQ(text.substr(0, tokenizer->prefix_length(text, 2)), "hello world");
+  EXPECT_EQ(text.substr(0, tokenizer->prefix_length(text, 4)), "hello world, un");
+  EXPECT_EQ(tokenizer->prefix_length(text, 100), text.size());
+  // Always at least one token
+  EXPECT_EQ(text.substr(0, tokenizer->prefix_length(text, 0)), "hello ");
+}
+
+TEST_F(TokenizerTest, WordPiece_LoadSharesOneInstance) {
+  auto first = WordPieceTokenizer::load(vocab_path_);
+  auto second = WordPieceTokenizer::load(vocab_path_);
+
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(first->vocab_size(), 14);
+}
+
+TEST_F(TokenizerTest, WordPiece_MissingVocabThrows) {
+  EXPECT_THROW(WordPieceTokenizer::load(test_dir_ / "missing.txt"), TokenizerError);
+  EXPECT_THROW(WordPieceTokenizer::load(write_file("empty.txt", "")), TokenizerError);
+}
+
+TEST_F(TokenizerTest, Extractor_ChunksFitTheTokenBudget) {
+  auto tokenizer = WordPieceTokenizer::load(vocab_path_);
+  PlainTextExtractor extractor(tokenizer);
+  std::string content;
+  for (int paragraph = 0; paragraph < 6; ++paragraph) {
+    for (int i = 0; i < 300; ++i) {
+      content += "words, ";
+    }
+    content += "\n\n";
+  }
+
+  auto chunks = extractor.get_chunks(write_file("words.txt", content));
+
+  // Each paragraph is 900 tokens, so every one goes through the fixed-size fallback
+  ASSERT_GT(chunks.size(), 6);
+  std::string joined;
+  for (const auto& chunk : chunks) {
+    EXPECT_LE(tokenizer->count_tokens(chunk.content), 512) << chunk.content.size();
+    joined += chunk.content;
+  }
+  EXPECT_EQ(joined, content);
+}
+
+}  // namespace magic_tests
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <stdexcept>
+
+#include "magic_core/llm/adaptive_batch_controller.hpp"
+
+namespace magic_tests {
+
+using magic_core::AdaptiveBatchController;
+using magic_core::AdaptiveBatchOptions;
+using namespace std::chrono_literals;
+
+namespace {
+
+// A full batch of 100-character texts
+constexpr size_t TEXTS = 64;
+constexpr size_t CHARS = TEXTS * 100;
+
+}  // namespace
+
+TEST(AdaptiveBatchControllerTest, StartsAtTheInitialValues) {
+  AdaptiveBatchController controller;
+
+  EXPECT_EQ(controller.batch_size(), AdaptiveBatchOptions{}.initial_batch);
+  EXPECT_EQ(controller.in_flight_limit(), AdaptiveBatchOptions{}.initial_in_flight);
+}
+
+TEST(AdaptiveBatchControllerTest, FullBatchesInTimeGrowTheBatchUpToTheMaximum) {
+  AdaptiveBatchOptions options;
+  options.initial_batch = 64;
+  options.max_batch = 80;
+  AdaptiveBatchController controller(options);
+
+  controller.record_success(64, 64 * 100, 100ms);
+  EXPECT_EQ(controller.batch_size(), 72u);
+  controller.record_success(72, 72 * 100, 110ms);
+  controller.record_success(80, 80 * 100, 120ms);
+  EXPECT_EQ(controller.batch_size(), 80u);
+}
+
+TEST(AdaptiveBatchControllerTest, PartialBatchesLeaveTheBatchSize) {
+  AdaptiveBatchController controller;
+
+  controller.record_success(10, 10 * 100, 20ms);
+
+  EXPECT_EQ(controller.batch_size(), AdaptiveBatchOptions{}.initial_batch);
+}
+
+TEST(AdaptiveBatchControllerTest, InFlightLimitGrowsByOnePerLimitOfRepliesInTime) {
+  AdaptiveBatchController controller;
+  ASSERT_EQ(controller.in_flight_limit(), 4u);
+
+  for (int i = 0; i < 3; ++i) {
+    controller.record_success(1, 100, 100us);
+  }
+  EXPECT_EQ(controller.in_flight_limit(), 4u);
+  controller.record_success(1, 100, 100us);
+  EXPECT_EQ(controller.in_flight_limit(), 5u);
+}
+
+TEST(AdaptiveBatchControllerTest, SlowRepliesShrinkBothByAQuarter) {
+  AdaptiveBatchController controller;
+  controller.record_success(TEXTS / 2, CHARS / 2, 50ms);
+
+  // Twice the time per character of the fastest reply: past the knee
+  controller.record_success(TEXTS, CHARS, 200ms);
+
+  EXPECT_EQ(controller.batch_size(), 48u);
+  EXPECT_EQ(controller.in_flight_limit(), 3u);
+}
+
+TEST(AdaptiveBatchControllerTest, LongerTextsAreNotMistakenForSlowReplies) {
+  AdaptiveBatchController controller;
+  controller.record_success(TEXTS, CHARS, 100ms);
+
+  // Same texts, four times the characters and the time: the endpoint keeps up
+  controller.record_success(TEXTS + 8, 4 * CHARS, 400ms);
+
+  EXPECT_EQ(controller.batch_size(), 80u);
+}
+
+TEST(AdaptiveBatchControllerTest, InterleavedSingleTextRepliesLeaveTheTunedValues) {
+  AdaptiveBatchController with_queries;
+  AdaptiveBatchController batches_only;
+
+  for (int i = 0; i < 20; ++i) {
+    const size_t batch = batches_only.batch_size();
+    with_queries.record_success(batch, batch * 100, batch * 100us);
+    batches_only.record_success(batch, batch * 100, batch * 100us);
+    // A 20-character query whose request overhead makes it 50 times slower per character
+    with_queries.record_success(1, 20, 100ms);
+  }
+
+  EXPECT_EQ(with_queries.batch_size(), batches_only.batch_size());
+  EXPECT_EQ(with_queries.in_flight_limit(), batches_only.in_flight_limit());
+}
+
+TEST(AdaptiveBatchControllerTest, FailuresHalveBothDownToTheMinimum) {
+  AdaptiveBatchController controller;
+
+  controller.record_failure();
+  EXPECT_EQ(controller.batch_size(), 32u);
+  EXPECT_EQ(controller.in_flight_limit(), 2u);
+
+  for (int i = 0; i < 10; ++i) {
+    controller.record_failure();
+  }
+  EXPECT_EQ(controller.batch_size(), AdaptiveBatchOptions{}.min_batch);
+  EXPECT_EQ(controller.in_flight_limit(), 1u);
+}
+
+TEST(AdaptiveBatchControllerTest, BaselineFollowsAnEndpointThatGotSlowerForGood) {
+  AdaptiveBatchController controller;
+  // 1us per character
+  controller.record_success(TEXTS, CHARS, 6400us);
+
+  // Twice as slow from now on: shrinks at first, then counts as the new normal
+  for (int i = 0; i < 40; ++i) {
+    controller.record_success(controller.batch_size(), controller.batch_size() * 100,
+                              controller.batch_size() * 200us);
+  }
+  const size_t settled = controller.batch_size();
+  controller.record_success(settled, settled * 100, settled * 200us);
+
+  EXPECT_EQ(controller.batch_size(), settled + AdaptiveBatchOptions{}.batch_step);
+}
+
+TEST(AdaptiveBatchControllerTest, RejectsInconsistentOptions) {
+  AdaptiveBatchOptions zero_batch;
+  zero_batch.min_batch = 0;
+  EXPECT_THROW(AdaptiveBatchController{zero_batch}, std::invalid_argument);
+
+  AdaptiveBatchOptions above_max;
+  above_max.initial_in_flight = above_max.max_in_flight + 1;
+  EXPECT_THROW(AdaptiveBatchController{above_max}, std::invalid_argument);
+
+  AdaptiveBatchOptions impatient;
+  impatient.tolerance = 0.5;
+  EXPECT_THROW(AdaptiveBatchController{impatient}, std::invalid_argument);
+}
+
+}  // namespace magic_tests
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "magic_core/llm/fake_embedding_client.hpp"
+#include "magic_core/types/vector_math.hpp"
+
+namespace magic_tests {
+
+using magic_core::FakeEmbeddingClient;
+using magic_core::FakeEmbeddingOptions;
+
+namespace {
+
+float cosine(const std::vector<float>& a, const std::vector<float>& b) {
+  return magic_core::vector_math::dot(a.data(), b.data(), a.size());
+}
+
+}  // namespace
+
+TEST(FakeEmbeddingClientTest, Embed_IsDeterministicAndNormalized) {
+  FakeEmbeddingClient client;
+  FakeEmbeddingClient other;
+  const auto a = client.get_embedding("Vector search over the folder");
+  ASSERT_EQ(a.size(), 1024u);
+  EXPECT_EQ(a, other.get_embedding("Vector search over the folder"));
+  // Case and punctuation do not change the words
+  EXPECT_EQ(a, client.get_embedding("vector SEARCH, over the folder!"));
+  EXPECT_NEAR(cosine(a, a), 1.0f, 1e-4f);
+  EXPECT_NEAR(cosine(client.get_embedding("..."), client.get_embedding("...")), 1.0f, 1e-4f);
+}
+
+TEST(FakeEmbeddingClientTest, Embed_SharedWordsAreCloserThanUnrelatedText) {
+  FakeEmbeddingClient client;
+  const auto query = client.embed("quarterly budget report");
+  const auto related = client.embed("the quarterly budget report for the team");
+  const auto unrelated = client.embed("hiking trails near the lake");
+  EXPECT_GT(cosine(query, related), 0.5f);
+  EXPECT_GT(cosine(query, related), cosine(query, unrelated) + 0.3f);
+}
+
+TEST(FakeEmbeddingClientTest, GetEmbeddings_KeepsOrderAndCountsRequests) {
+  FakeEmbeddingOptions options;
+  options.dimension = 16;
+  FakeEmbeddingClient client(options);
+  const auto batch = client.get_embeddings_async({"one", "two", "three"}).get();
+  ASSERT_EQ(batch.size(), 3u);
+  EXPECT_EQ(batch[1], client.embed("two"));
+  EXPECT_EQ(batch[0].size(), 16u);
+  EXPECT_EQ(client.requests(), 1u);
+  EXPECT_EQ(client.texts(), 3u);
+
+  const auto status = client.endpoint_status();
+  ASSERT_EQ(status.size(), 1u);
+  EXPECT_TRUE(status[0].healthy);
+  EXPECT_EQ(status[0].outstanding, 0);
+  EXPECT_TRUE(client.is_server_available());
+}
+
+TEST(FakeEmbeddingClientTest, GetEmbeddings_SleepsTheConfiguredLatency) {
+  FakeEmbeddingOptions options;
+  options.dimension = 8;
+  options.request_latency = std::chrono::milliseconds(20);
+  options.per_text_latency = std::chrono::milliseconds(5);
+  FakeEmbeddingClient client(options);
+  const auto started = std::chrono::steady_clock::now();
+  client.get_embeddings({"a", "b", "c", "d"});
+  EXPECT_GE(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(40));
+}
+
+TEST(FakeEmbeddingClientTest, Constructor_RejectsNonPositiveDimension) {
+  FakeEmbeddingOptions options;
+  options.dimension = 0;
+  EXPECT_THROW(FakeEmbeddingClient{options}, magic_core::OllamaError);
+}
+
+}  // namespace magic_tests
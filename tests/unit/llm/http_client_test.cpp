@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "magic_core/llm/http_client.hpp"
+#include "http_server_test.hpp"
+
+namespace magic_tests {
+
+using magic_core::HttpClient;
+using magic_core::HttpClientOptions;
+using magic_core::HttpError;
+using magic_core::HttpResponse;
+
+namespace {
+
+LoopbackHttpServer::Response echo(const std::string& method,
+                                  const std::string& path,
+                                  const std::string& body) {
+  return {200, method + " " + path + " " + body};
+}
+
+}  // namespace
+
+TEST(HttpClientTest, ReturnsStatusAndBody) {
+  LoopbackHttpServer server([](const std::string&, const std::string& path, const std::string&) {
+    return LoopbackHttpServer::Response{path == "/missing" ? 404 : 200, "{}"};
+  });
+  HttpClient client(server.url() + "/");
+
+  HttpResponse ok = client.request("GET", "/api/version");
+  HttpResponse missing = client.request("GET", "/missing");
+
+  EXPECT_EQ(ok.status, 200);
+  EXPECT_EQ(ok.body, "{}");
+  EXPECT_EQ(missing.status, 404);
+}
+
+TEST(HttpClientTest, PostSendsBody) {
+  LoopbackHttpServer server(echo);
+  HttpClient client(server.url());
+
+  HttpResponse response = client.request("POST", "/api/embed", R"({"input":["a"]})");
+
+  EXPECT_EQ(response.body, R"(POST /api/embed {"input":["a"]})");
+}
+
+TEST(HttpClientTest, SequentialRequestsReuseOneConnection) {
+  LoopbackHttpServer server(echo);
+  HttpClient client(server.url());
+
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(client.request("POST", "/", std::to_string(i)).body, "POST / " + std::to_string(i));
+  }
+
+  EXPECT_EQ(server.requests_served(), 10);
+  EXPECT_EQ(server.connections_accepted(), 1);
+}
+
+TEST(HttpClientTest, AsyncRequestsRunConcurrently) {
+  const auto delay = std::chrono::milliseconds(100);
+  LoopbackHttpServer server(
+      [delay](const std::string& method, const std::string& path, const std::string& body) {
+        std::this_thread::sleep_for(delay);
+        return echo(method, path, body);
+      });
+  HttpClientOptions options;
+  options.max_connections = 4;
+  HttpClient client(server.url(), options);
+
+  const auto started = std::chrono::steady_clock::now();
+  std::vector<std::future<HttpResponse>> responses;
+  for (int i = 0; i < 8; ++i) {
+    responses.push_back(client.request_async("POST", "/", std::to_string(i)));
+  }
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(responses[i].get().body, "POST / " + std::to_string(i));
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - started;
+
+  // Two rounds of four parallel requests, far below eight back-to-back ones
+  EXPECT_LT(elapsed, delay * 6);
+  EXPECT_LE(server.connections_accepted(), 4);
+}
+
+TEST(HttpClientTest, TransferFailureSurfacesFromFuture) {
+  int unused_port = 0;
+  {
+    LoopbackHttpServer closed(echo);
+    unused_port = std::stoi(closed.url().substr(closed.url().rfind(':') + 1));
+  }
+  HttpClient client("http://127.0.0.1:" + std::to_string(unused_port));
+
+  auto response = client.request_async("GET", "/");
+
+  EXPECT_THROW(response.get(), HttpError);
+}
+
+}  // namespace magic_tests
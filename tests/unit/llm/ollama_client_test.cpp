@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "magic_core/llm/ollama_client.hpp"
+#include "http_server_test.hpp"
+
+namespace magic_tests {
+
+using magic_core::OllamaClient;
+using magic_core::OllamaError;
+
+namespace {
+
+// Answers like Ollama: one 3-float embedding per input, whose first value is the input length
+LoopbackHttpServer::Response fake_ollama(const std::string& method,
+                                         const std::string& path,
+                                         const std::string& body) {
+  if (method == "GET" && path == "/api/version") {
+    return {200, R"({"version":"0.0.0"})"};
+  }
+  if (method != "POST" || path != "/api/embed") {
+    return {404, "not found"};
+  }
+  auto request = nlohmann::json::parse(body);
+  if (request.value("model", "") != "test-model") {
+    return {404, R"({"error":"model not found"})"};
+  }
+  nlohmann::json embeddings = nlohmann::json::array();
+  for (const auto& input : request["input"]) {
+    embeddings.push_back({static_cast<float>(input.get<std::string>().size()), 0.5f, 1.0f});
+  }
+  return {200, nlohmann::json{{"embeddings", embeddings}}.dump()};
+}
+
+}  // namespace
+
+TEST(OllamaClientTest, ConstructorRequiresRunningServer) {
+  int unused_port = 0;
+  {
+    LoopbackHttpServer closed(fake_ollama);
+    unused_port = std::stoi(closed.url().substr(closed.url().rfind(':') + 1));
+  }
+
+  EXPECT_THROW(OllamaClient("http://127.0.0.1:" + std::to_string(unused_port), "test-model"),
+               OllamaError);
+}
+
+TEST(OllamaClientTest, GetEmbeddingsKeepsInputOrder) {
+  LoopbackHttpServer server(fake_ollama);
+  OllamaClient client(server.url(), "test-model");
+
+  auto embeddings = client.get_embeddings({"a", "abc", "ab"});
+
+  ASSERT_EQ(embeddings.size(), 3u);
+  EXPECT_EQ(embeddings[0][0], 1.0f);
+  EXPECT_EQ(embeddings[1][0], 3.0f);
+  EXPECT_EQ(embeddings[2][0], 2.0f);
+  EXPECT_EQ(client.get_embedding("abcd"), (std::vector<float>{4.0f, 0.5f, 1.0f}));
+}
+
+TEST(OllamaClientTest, AsyncBatchesShareConnections) {
+  LoopbackHttpServer server(fake_ollama);
+  OllamaClient client(server.url(), "test-model");
+
+  std::vector<std::future<std::vector<std::vector<float>>>> batches;
+  for (int i = 0; i < 4; ++i) {
+    batches.push_back(client.get_embeddings_async({std::string(i + 1, 'x')}));
+  }
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(batches[i].get()[0][0], static_cast<float>(i + 1));
+  }
+
+  // The availability check's connection is reused, new ones only open for overlapping requests
+  EXPECT_LE(server.connections_accepted(), 4);
+}
+
+TEST(OllamaClientTest, HttpErrorBecomesOllamaError) {
+  LoopbackHttpServer server(fake_ollama);
+  OllamaClient client(server.url(), "unknown-model");
+
+  EXPECT_THROW(client.get_embeddings({"text"}), OllamaError);
+  EXPECT_TRUE(client.get_embeddings_async({}).get().empty());
+}
+
+TEST(OllamaClientTest, FullBatchesAnsweredInTimeGrowTheTunedBatchSize) {
+  LoopbackHttpServer server(fake_ollama);
+  OllamaClient client(server.url(), "test-model");
+  const size_t initial = client.embedding_batch_size();
+
+  client.get_embeddings(std::vector<std::string>(initial, "text"));
+
+  // The first reply is the fastest seen, so it was in time by definition
+  EXPECT_GT(client.embedding_batch_size(), initial);
+  EXPECT_EQ(client.endpoint_status()[0].batch_size, client.embedding_batch_size());
+  EXPECT_GE(client.endpoint_status()[0].in_flight_limit, 1u);
+}
+
+TEST(OllamaClientTest, SendsToLeastLoadedEndpoint) {
+  // Slots are held until the reply arrives, so "a" is kept in flight until c is routed
+  auto slow_ollama = [](const std::string& method, const std::string& path,
+                        const std::string& body) {
+    if (path == "/api/embed") {
+      const bool slow = body.find("\"a\"") != std::string::npos;
+      std::this_thread::sleep_for(std::chrono::milliseconds(slow ? 500 : 50));
+    }
+    return fake_ollama(method, path, body);
+  };
+  LoopbackHttpServer first(slow_ollama);
+  LoopbackHttpServer second(slow_ollama);
+  OllamaClient client(std::vector<std::string>{first.url(), second.url()}, "test-model");
+
+  auto a = client.get_embeddings_async({"a"});
+  auto b = client.get_embeddings_async({"b"});
+  EXPECT_EQ(client.endpoint_status()[0].outstanding, 1);
+  EXPECT_EQ(client.endpoint_status()[1].outstanding, 1);
+
+  b.get();
+  auto c = client.get_embeddings_async({"c"});
+
+  // The second endpoint had nothing in flight, so it gets the new request
+  EXPECT_EQ(client.endpoint_status()[0].outstanding, 1);
+  EXPECT_EQ(client.endpoint_status()[1].outstanding, 1);
+  a.get();
+  c.get();
+  EXPECT_EQ(first.requests_served() + second.requests_served(), 2 + 3);
+}
+
+TEST(OllamaClientTest, DroppedFutureStillReleasesItsSlot) {
+  LoopbackHttpServer server(fake_ollama);
+  OllamaClient client(server.url(), "test-model");
+
+  { auto dropped = client.get_embeddings_async({"never read"}); }
+
+  // The transfer finishes on its own; the slot comes back without anyone calling get()
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (client.endpoint_status()[0].outstanding != 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(client.endpoint_status()[0].outstanding, 0);
+}
+
+TEST(OllamaClientTest, FailsOverWhenAnEndpointGoesDown) {
+  auto failing = std::make_unique<LoopbackHttpServer>(fake_ollama);
+  LoopbackHttpServer healthy(fake_ollama);
+  OllamaClient client(std::vector<std::string>{failing->url(), healthy.url()}, "test-model");
+  failing.reset();
+
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(client.get_embeddings({"abc"})[0][0], 3.0f);
+  }
+
+  auto status = client.endpoint_status();
+  EXPECT_FALSE(status[0].healthy);
+  EXPECT_TRUE(status[1].healthy);
+  EXPECT_EQ(status[0].outstanding, 0);
+  EXPECT_EQ(status[1].outstanding, 0);
+}
+
+TEST(OllamaClientTest, StartsWithUnreachableEndpointsMarkedDown) {
+  int unused_port = 0;
+  {
+    LoopbackHttpServer closed(fake_ollama);
+    unused_port = std::stoi(closed.url().substr(closed.url().rfind(':') + 1));
+  }
+  LoopbackHttpServer healthy(fake_ollama);
+
+  OllamaClient client(
+      std::vector<std::string>{"http://127.0.0.1:" + std::to_string(unused_port), healthy.url()},
+      "test-model");
+
+  EXPECT_FALSE(client.endpoint_status()[0].healthy);
+  EXPECT_EQ(client.get_embedding("ab")[0], 2.0f);
+}
+
+TEST(OllamaClientTest, WarmUpEmbedsOnEveryHealthyEndpoint) {
+  int unused_port = 0;
+  {
+    LoopbackHttpServer closed(fake_ollama);
+    unused_port = std::stoi(closed.url().substr(closed.url().rfind(':') + 1));
+  }
+  LoopbackHttpServer first(fake_ollama);
+  LoopbackHttpServer second(fake_ollama);
+  OllamaClient client(std::vector<std::string>{first.url(),
+                                               "http://127.0.0.1:" + std::to_string(unused_port),
+                                               second.url()},
+                      "test-model");
+
+  EXPECT_EQ(client.warm_up(), 2u);
+
+  // The availability check, then the warm-up embedding
+  EXPECT_EQ(first.requests_served(), 2);
+  EXPECT_EQ(second.requests_served(), 2);
+  EXPECT_EQ(client.endpoint_status()[0].outstanding, 0);
+}
+
+TEST(OllamaClientTest, ThrowsWhenEveryEndpointIsDown) {
+  auto first = std::make_unique<LoopbackHttpServer>(fake_ollama);
+  auto second = std::make_unique<LoopbackHttpServer>(fake_ollama);
+  OllamaClient client(std::vector<std::string>{first->url(), second->url()}, "test-model");
+  first.reset();
+  second.reset();
+
+  EXPECT_THROW(client.get_embeddings({"text"}), OllamaError);
+  EXPECT_FALSE(client.is_server_available());
+}
+
+}  // namespace magic_tests
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "magic_core/llm/rerank_client.hpp"
+#include "http_server_test.hpp"
+
+namespace magic_tests {
+
+using magic_core::RerankClient;
+using magic_core::RerankError;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Answers like a /v1/rerank server, best first: a document scores the number of times it holds
+// the query
+LoopbackHttpServer::Response fake_reranker(const std::string& method,
+                                           const std::string& path,
+                                           const std::string& body) {
+  if (method != "POST" || path != RerankClient::RERANK_PATH) {
+    return {404, "not found"};
+  }
+  auto request = nlohmann::json::parse(body);
+  const std::string query = request["query"].get<std::string>();
+  nlohmann::json results = nlohmann::json::array();
+  const auto& documents = request["documents"];
+  for (size_t i = documents.size(); i-- > 0;) {
+    const std::string document = documents[i].get<std::string>();
+    float score = 0.0f;
+    for (size_t at = document.find(query); at != std::string::npos;
+         at = document.find(query, at + 1)) {
+      score += 1.0f;
+    }
+    results.push_back({{"index", i}, {"relevance_score", score}});
+  }
+  return {200, nlohmann::json{{"model", request["model"]}, {"results", results}}.dump()};
+}
+
+}  // namespace
+
+TEST(RerankClientTest, ScoresComeBackInDocumentOrder) {
+  LoopbackHttpServer server(fake_reranker);
+  RerankClient client(server.url(), "test-reranker");
+
+  auto scores = client.score("cat", {"a cat", "dog", "cat and cat"});
+
+  EXPECT_EQ(scores, (std::vector<float>{1.0f, 0.0f, 2.0f}));
+}
+
+TEST(RerankClientTest, PendingBatchReturnsNothingPastItsDeadline) {
+  LoopbackHttpServer server([](const std::string& method, const std::string& path,
+                               const std::string& body) {
+    std::this_thread::sleep_for(300ms);
+    return fake_reranker(method, path, body);
+  });
+  RerankClient client(server.url(), "test-reranker");
+
+  auto pending = client.score_async("cat", {"cat"});
+
+  EXPECT_FALSE(pending.get(std::chrono::steady_clock::now() + 20ms).has_value());
+}
+
+TEST(RerankClientTest, ServerErrorsAndIncompleteRepliesThrow) {
+  LoopbackHttpServer failing([](const std::string&, const std::string&, const std::string&) {
+    return LoopbackHttpServer::Response{500, R"({"error":"model not loaded"})"};
+  });
+  LoopbackHttpServer partial([](const std::string&, const std::string&, const std::string&) {
+    return LoopbackHttpServer::Response{200,
+                                        R"({"results":[{"index":0,"relevance_score":0.5}]})"};
+  });
+
+  EXPECT_THROW(RerankClient(failing.url(), "test-reranker").score("cat", {"cat"}), RerankError);
+  EXPECT_THROW(RerankClient(partial.url(), "test-reranker").score("cat", {"cat", "dog"}),
+               RerankError);
+}
+
+}  // namespace magic_tests
@@ -20,7 +20,28 @@ class CompressionServiceTest : public ::testing::Test {
   }
 
   void TearDown() override {
-    // No cleanup needed for compression service tests
+    // Dictionaries are process-wide; later tests expect plain frames
+    CompressionService::clear_dictionaries();
+  }
+
+  // Chunk-sized texts sharing vocabulary and structure, like chunks of one corpus
+  std::vector<std::string> generate_chunk_samples(size_t count) {
+    const std::vector<std::string> words = {
+        "the",     "index",  "search", "vector",   "document", "folder", "summary", "chunk",
+        "process", "file",   "query",  "embedding", "result",  "server", "worker",  "task"};
+    std::uniform_int_distribution<size_t> pick(0, words.size() - 1);
+    std::vector<std::string> samples;
+    for (size_t i = 0; i < count; ++i) {
+      std::string sample = "## Section " + std::to_string(i) + "\nThis chunk describes how the ";
+      while (sample.size() < 1800) {
+        sample += words[pick(rng_)] + " ";
+        if (pick(rng_) == 0) {
+          sample += "\nSee also: the magic folder documentation. ";
+        }
+      }
+      samples.push_back(std::move(sample));
+    }
+    return samples;
   }
 
   // Helper to generate random test data
@@ -346,4 +367,93 @@ More content here with some repetitive patterns that should compress well.
   EXPECT_LT(compression_ratio, 0.6) << "Text document should compress reasonably well";
 }
 
+// Buffer reuse tests
+TEST_F(CompressionServiceTest, CompressInto_ReusesCallerBuffer) {
+  std::vector<char> buffer;
+  CompressionService::compress_into(generate_repetitive_data(8000), buffer);
+  const char* storage = buffer.data();
+  const size_t capacity = buffer.capacity();
+
+  const std::string smaller = generate_repetitive_data(4000);
+  CompressionService::compress_into(smaller, buffer);
+  EXPECT_EQ(buffer.data(), storage);
+  EXPECT_EQ(buffer.capacity(), capacity);
+  EXPECT_EQ(buffer, CompressionService::compress(smaller));
+  EXPECT_EQ(CompressionService::decompress(buffer), smaller);
+
+  CompressionService::compress_into("", buffer);
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST_F(CompressionServiceTest, DecompressInto_ReusesArena) {
+  std::string arena;
+  const std::string large = generate_random_data(6000);
+  std::string_view view =
+      CompressionService::decompress_into(CompressionService::compress(large), arena);
+  EXPECT_EQ(view, large);
+  const char* storage = arena.data();
+
+  const std::string small = generate_random_data(1000);
+  view = CompressionService::decompress_into(CompressionService::compress(small), arena);
+  EXPECT_EQ(view, small);
+  EXPECT_EQ(arena.data(), storage);
+
+  EXPECT_TRUE(CompressionService::decompress_into({}, arena).empty());
+  std::vector<char> invalid = {'n', 'o', 'p', 'e'};
+  EXPECT_THROW(CompressionService::decompress_into(invalid, arena), std::runtime_error);
+}
+
+// Dictionary tests
+TEST_F(CompressionServiceTest, Dictionary_ShrinksSmallChunksAndRoundTrips) {
+  auto samples = generate_chunk_samples(500);
+  std::vector<char> dictionary = CompressionService::train_dictionary(samples, 16 * 1024);
+  ASSERT_FALSE(dictionary.empty());
+  EXPECT_LE(dictionary.size(), 16u * 1024u);
+
+  const std::string chunk = generate_chunk_samples(1).front();
+  std::vector<char> plain = CompressionService::compress(chunk);
+  EXPECT_EQ(CompressionService::dictionary_id(plain), 0u);
+
+  uint32_t id = CompressionService::register_dictionary(dictionary);
+  EXPECT_NE(id, 0u);
+  EXPECT_EQ(CompressionService::active_dictionary_id(), id);
+  std::vector<char> with_dictionary = CompressionService::compress(chunk);
+  EXPECT_EQ(CompressionService::dictionary_id(with_dictionary), id);
+  EXPECT_LT(with_dictionary.size(), plain.size());
+
+  // Frames written before the dictionary still decode next to the new ones
+  EXPECT_EQ(CompressionService::decompress(with_dictionary), chunk);
+  EXPECT_EQ(CompressionService::decompress(plain), chunk);
+}
+
+TEST_F(CompressionServiceTest, Dictionary_OlderDictionariesKeepDecoding) {
+  auto first_dictionary = CompressionService::train_dictionary(generate_chunk_samples(500), 8192);
+  uint32_t first = CompressionService::register_dictionary(first_dictionary);
+  const std::string chunk = "Written under the first dictionary: the index search vector.";
+  std::vector<char> old_frame = CompressionService::compress(chunk);
+
+  auto second_dictionary = CompressionService::train_dictionary(generate_chunk_samples(500), 8192);
+  uint32_t second = CompressionService::register_dictionary(second_dictionary);
+  ASSERT_NE(first, second);
+  EXPECT_EQ(CompressionService::active_dictionary_id(), second);
+  EXPECT_EQ(CompressionService::dictionary_id(old_frame), first);
+  EXPECT_EQ(CompressionService::decompress(old_frame), chunk);
+}
+
+TEST_F(CompressionServiceTest, Dictionary_UnregisteredDictionaryThrows) {
+  auto dictionary = CompressionService::train_dictionary(generate_chunk_samples(500), 8192);
+  CompressionService::register_dictionary(dictionary);
+  std::vector<char> frame = CompressionService::compress("needs the dictionary to decode");
+
+  CompressionService::clear_dictionaries();
+  EXPECT_EQ(CompressionService::active_dictionary_id(), 0u);
+  EXPECT_THROW(CompressionService::decompress(frame), std::runtime_error);
+}
+
+TEST_F(CompressionServiceTest, Dictionary_RejectsBadInput) {
+  EXPECT_THROW(CompressionService::train_dictionary({"too", "few"}), std::runtime_error);
+  std::vector<char> not_a_dictionary(1024, 'x');
+  EXPECT_THROW(CompressionService::register_dictionary(not_a_dictionary), std::invalid_argument);
+}
+
 }  // namespace magic_core 
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include <string>
+
+#include "magic_core/services/content_encoding.hpp"
+
+namespace magic_core {
+
+namespace {
+
+std::string gunzip(const std::string &data) {
+  z_stream stream{};
+  EXPECT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+  std::string out(1 << 20, '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef *>(out.data());
+  stream.avail_out = static_cast<uInt>(out.size());
+  EXPECT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+  out.resize(stream.total_out);
+  inflateEnd(&stream);
+  return out;
+}
+
+std::string unzstd(const std::string &data) {
+  const unsigned long long size = ZSTD_getFrameContentSize(data.data(), data.size());
+  EXPECT_NE(size, ZSTD_CONTENTSIZE_UNKNOWN);
+  std::string out(size, '\0');
+  EXPECT_EQ(ZSTD_decompress(out.data(), out.size(), data.data(), data.size()), size);
+  return out;
+}
+
+std::string sample_body() {
+  std::string body = "[";
+  for (int i = 0; i < 200; ++i) {
+    body += "{\"id\":" + std::to_string(i) + ",\"path\":\"/notes/file" + std::to_string(i) +
+            ".md\",\"score\":0.5},";
+  }
+  body.back() = ']';
+  return body;
+}
+
+}  // namespace
+
+TEST(ContentEncoderTest, Negotiate_PrefersZstdAndHonorsZeroQuality) {
+  EXPECT_EQ(ContentEncoder::negotiate(""), ContentEncoding::Identity);
+  EXPECT_EQ(ContentEncoder::negotiate("identity"), ContentEncoding::Identity);
+  EXPECT_EQ(ContentEncoder::negotiate("gzip, deflate, br"), ContentEncoding::Gzip);
+  EXPECT_EQ(ContentEncoder::negotiate("gzip;q=0.8, zstd"), ContentEncoding::Zstd);
+  EXPECT_EQ(ContentEncoder::negotiate("ZSTD;q=0, GZip"), ContentEncoding::Gzip);
+  EXPECT_EQ(ContentEncoder::negotiate("gzip; q=0"), ContentEncoding::Identity);
+  EXPECT_EQ(ContentEncoder::negotiate("*"), ContentEncoding::Gzip);
+  EXPECT_STREQ(ContentEncoder::token(ContentEncoding::Zstd), "zstd");
+  EXPECT_STREQ(ContentEncoder::token(ContentEncoding::Identity), "");
+}
+
+TEST(ContentEncoderTest, Encode_RoundTripsAndShrinksRepetitiveBodies) {
+  const std::string body = sample_body();
+  const std::string zstd = ContentEncoder::encode(body, ContentEncoding::Zstd);
+  const std::string gzip = ContentEncoder::encode(body, ContentEncoding::Gzip);
+
+  EXPECT_EQ(unzstd(zstd), body);
+  EXPECT_EQ(gunzip(gzip), body);
+  EXPECT_LT(zstd.size(), body.size() / 4);
+  EXPECT_LT(gzip.size(), body.size() / 4);
+  EXPECT_EQ(ContentEncoder::encode(body, ContentEncoding::Identity), body);
+  EXPECT_EQ(gunzip(ContentEncoder::encode("", ContentEncoding::Gzip)), "");
+}
+
+}  // namespace magic_core
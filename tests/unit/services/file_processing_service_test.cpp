@@ -17,6 +17,14 @@ using ::testing::Return;
 using ::testing::ReturnRef;
 using ::testing::Throw;
 
+namespace {
+void write_file(const std::filesystem::path& path, const std::string& content) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream out(path);
+  out << content;
+}
+}  // namespace
+
 class FileProcessingServiceTest : public MetadataStoreTestBase {
  protected:
   void SetUp() override {
@@ -132,4 +140,137 @@ TEST_F(FileProcessingServiceTest, RequestProcessing_ExtractionError_ThrowsExcept
   EXPECT_TRUE(maybe_id.has_value());
 }
 
-} // namespace magic_tests
+class FileProcessingServiceDirectoryTest : public FileProcessingServiceTest {
+ protected:
+  void SetUp() override {
+    FileProcessingServiceTest::SetUp();
+    test_dir_ = std::filesystem::temp_directory_path() / "magic_directory_ingest_test";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directories(test_dir_);
+
+    ON_CALL(*mock_content_extractor_factory_, get_extractor_for(_))
+        .WillByDefault([this](const std::filesystem::path& path)
+                           -> const magic_core::ContentExtractor& {
+          if (path.extension() == ".bin") {
+            throw std::runtime_error("No suitable content extractor found for " + path.string());
+          }
+          return *mock_content_extractor_;
+        });
+    ON_CALL(*mock_content_extractor_, get_file_type()).WillByDefault(Return(FileType::Text));
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+    FileProcessingServiceTest::TearDown();
+  }
+
+  std::filesystem::path test_dir_;
+};
+
+TEST_F(FileProcessingServiceDirectoryTest, RequestDirectoryProcessing_QueuesNestedFiles) {
+  write_file(test_dir_ / "a.txt", "first file");
+  write_file(test_dir_ / "nested" / "b.txt", "second file");
+  write_file(test_dir_ / "nested" / "deeper" / "c.md", "third file");
+
+  auto result = file_processing_service_->request_directory_processing(test_dir_);
+
+  EXPECT_EQ(result.files_found, 3u);
+  EXPECT_EQ(result.task_ids.size(), 3u);
+  EXPECT_EQ(result.skipped, 0u);
+  EXPECT_TRUE(result.errors.empty());
+  EXPECT_EQ(task_queue_repo_->get_tasks_by_status(TaskStatus::PENDING).size(), 3u);
+  auto stub = metadata_store_->get_file_metadata((test_dir_ / "nested" / "deeper" / "c.md").string());
+  ASSERT_TRUE(stub.has_value());
+  EXPECT_EQ(stub->processing_status, ProcessingStatus::QUEUED);
+}
+
+TEST_F(FileProcessingServiceDirectoryTest, RequestDirectoryProcessing_SkipsDuplicatesAndKnownFiles) {
+  write_file(test_dir_ / "a.txt", "same content");
+  write_file(test_dir_ / "copy" / "a.txt", "same content");
+  write_file(test_dir_ / "b.txt", "other content");
+
+  auto first = file_processing_service_->request_directory_processing(test_dir_);
+  EXPECT_EQ(first.task_ids.size(), 2u);
+  EXPECT_EQ(first.skipped, 0u);
+  // The copy gets a row of its own, sharing the content of the one that was queued
+  EXPECT_EQ(first.duplicates, 1u);
+  auto original = metadata_store_->get_basic_file_metadata((test_dir_ / "a.txt").string());
+  auto copy = metadata_store_->get_basic_file_metadata((test_dir_ / "copy" / "a.txt").string());
+  ASSERT_TRUE(original.has_value());
+  ASSERT_TRUE(copy.has_value());
+  EXPECT_NE(original->content_source_id == 0, copy->content_source_id == 0);
+
+  // Everything is queued now, so a second walk adds nothing
+  auto second = file_processing_service_->request_directory_processing(test_dir_);
+  EXPECT_EQ(second.files_found, 3u);
+  EXPECT_TRUE(second.task_ids.empty());
+  EXPECT_EQ(second.skipped, 3u);
+  EXPECT_EQ(second.duplicates, 0u);
+}
+
+TEST_F(FileProcessingServiceDirectoryTest,
+       RequestProcessing_CopyAtANewPath_IsRecordedWithoutATask) {
+  write_file(test_dir_ / "report.txt", "quarterly numbers");
+  write_file(test_dir_ / "attachments" / "report.txt", "quarterly numbers");
+
+  auto task_id = file_processing_service_->request_processing(test_dir_ / "report.txt");
+  ASSERT_TRUE(task_id.has_value());
+  EXPECT_FALSE(file_processing_service_->request_processing(test_dir_ / "attachments" /
+                                                            "report.txt"));
+
+  auto original = metadata_store_->get_basic_file_metadata((test_dir_ / "report.txt").string());
+  auto copy = metadata_store_->get_basic_file_metadata(
+      (test_dir_ / "attachments" / "report.txt").string());
+  ASSERT_TRUE(copy.has_value());
+  EXPECT_EQ(copy->content_source_id, original->id);
+  EXPECT_EQ(copy->processing_status, ProcessingStatus::QUEUED);
+  EXPECT_EQ(task_queue_repo_->get_tasks_by_status(TaskStatus::PENDING).size(), 1u);
+}
+
+TEST_F(FileProcessingServiceDirectoryTest, RequestDirectoryProcessing_CountsUnsupportedFiles) {
+  write_file(test_dir_ / "a.txt", "text");
+  write_file(test_dir_ / "image.bin", "binary");
+
+  auto result = file_processing_service_->request_directory_processing(test_dir_);
+
+  EXPECT_EQ(result.files_found, 2u);
+  EXPECT_EQ(result.unsupported, 1u);
+  EXPECT_EQ(result.task_ids.size(), 1u);
+}
+
+TEST_F(FileProcessingServiceDirectoryTest, RequestDirectoryProcessing_SpansSeveralBatches) {
+  const size_t file_count = FileProcessingService::DIRECTORY_BATCH_SIZE * 2 + 5;
+  for (size_t i = 0; i < file_count; ++i) {
+    write_file(test_dir_ / ("dir" + std::to_string(i % 7)) / ("f" + std::to_string(i) + ".txt"),
+               "content " + std::to_string(i));
+  }
+
+  auto result = file_processing_service_->request_directory_processing(test_dir_);
+
+  EXPECT_EQ(result.files_found, file_count);
+  EXPECT_EQ(result.task_ids.size(), file_count);
+  EXPECT_EQ(task_queue_repo_->get_tasks_by_status(TaskStatus::PENDING).size(), file_count);
+}
+
+TEST_F(FileProcessingServiceDirectoryTest, RequestDirectoryProcessing_BulkLoad_OpensALoad) {
+  write_file(test_dir_ / "a.txt", "first file");
+
+  auto plain = file_processing_service_->request_directory_processing(test_dir_);
+  EXPECT_FALSE(plain.bulk_load);
+  EXPECT_FALSE(metadata_store_->bulk_loading());
+
+  write_file(test_dir_ / "b.txt", "second file");
+  auto bulk = file_processing_service_->request_directory_processing(
+      test_dir_, TaskPriority::BULK, /*bulk_load*/ true);
+  EXPECT_TRUE(bulk.bulk_load);
+  EXPECT_EQ(bulk.task_ids.size(), 1u);
+  EXPECT_TRUE(metadata_store_->bulk_loading());
+  metadata_store_->end_bulk_load();
+}
+
+TEST_F(FileProcessingServiceDirectoryTest, RequestDirectoryProcessing_NotADirectory_Throws) {
+  EXPECT_THROW(file_processing_service_->request_directory_processing(test_file_path_),
+               std::invalid_argument);
+}
+
+}  // namespace magic_tests
@@ -0,0 +1,345 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "magic_core/services/file_delete_service.hpp"
+#include "magic_core/services/file_processing_service.hpp"
+#include "magic_core/services/file_watch_backend.hpp"
+#include "magic_core/services/file_watcher_service.hpp"
+#include "mocks_test.hpp"
+#include "utilities_test.hpp"
+
+namespace magic_tests {
+
+using namespace magic_core;
+using ::testing::_;
+using ::testing::Return;
+using ::testing::ReturnRef;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Event = std::pair<std::filesystem::path, FileChangeKind>;
+
+// Replays a fixed list of events, then idles until stopped
+class ScriptedWatchBackend : public FileWatchBackend {
+ public:
+  explicit ScriptedWatchBackend(std::vector<Event> events) : events_(std::move(events)) {}
+
+  void run(const ChangeCallback& on_change) override {
+    for (const auto& [path, kind] : events_) {
+      on_change(path, kind);
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return stopped_; });
+  }
+
+  void stop() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    cv_.notify_all();
+  }
+
+  std::string name() const override {
+    return "scripted";
+  }
+
+ private:
+  std::vector<Event> events_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopped_ = false;
+};
+
+// Collects events from a backend running on its own thread
+class EventRecorder {
+ public:
+  FileWatchBackend::ChangeCallback callback() {
+    return [this](const std::filesystem::path& path, FileChangeKind kind) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      events_.emplace_back(path, kind);
+      cv_.notify_all();
+    };
+  }
+
+  bool wait_for(const std::filesystem::path& path, FileChangeKind kind) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, std::chrono::seconds(5), [&] {
+      for (const auto& event : events_) {
+        if (event.first == path && event.second == kind) {
+          return true;
+        }
+      }
+      return false;
+    });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Event> events_;
+};
+
+void write_file(const std::filesystem::path& path, const std::string& content) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream out(path);
+  out << content;
+}
+
+}  // namespace
+
+class FileWatcherServiceTest : public MetadataStoreTestBase {
+ protected:
+  void SetUp() override {
+    MetadataStoreTestBase::SetUp();
+    watch_dir_ = std::filesystem::temp_directory_path() / "magic_file_watcher_test";
+    std::filesystem::remove_all(watch_dir_);
+    std::filesystem::create_directories(watch_dir_);
+
+    mock_content_extractor_factory_ = std::make_shared<MockContentExtractorFactory>();
+    mock_content_extractor_ = std::make_unique<MockContentExtractor>();
+    ON_CALL(*mock_content_extractor_factory_, get_extractor_for(_))
+        .WillByDefault(ReturnRef(*mock_content_extractor_));
+    ON_CALL(*mock_content_extractor_, get_file_type()).WillByDefault(Return(FileType::Text));
+
+    file_processing_service_ = std::make_shared<FileProcessingService>(
+        metadata_store_, task_queue_repo_, mock_content_extractor_factory_,
+        std::make_shared<MockOllamaClient>());
+    file_delete_service_ = std::make_shared<FileDeleteService>(metadata_store_);
+  }
+
+  void TearDown() override {
+    watcher_.reset();
+    std::filesystem::remove_all(watch_dir_);
+    MetadataStoreTestBase::TearDown();
+  }
+
+  FileWatcherService& make_watcher(std::unique_ptr<FileWatchBackend> backend = nullptr,
+                                   std::chrono::milliseconds settle = std::chrono::milliseconds(500),
+                                   bool recursive = true) {
+    FileWatcherOptions options;
+    options.settle = settle;
+    options.recursive = recursive;
+    options.initial_scan = false;
+    watcher_ = std::make_unique<FileWatcherService>(file_processing_service_,
+                                                    file_delete_service_,
+                                                    std::vector<std::filesystem::path>{watch_dir_},
+                                                    options, std::move(backend));
+    return *watcher_;
+  }
+
+  size_t pending_task_count() {
+    return task_queue_repo_->get_tasks_by_status(TaskStatus::PENDING).size();
+  }
+
+  std::filesystem::path watch_dir_;
+  std::shared_ptr<MockContentExtractorFactory> mock_content_extractor_factory_;
+  std::unique_ptr<MockContentExtractor> mock_content_extractor_;
+  std::shared_ptr<FileProcessingService> file_processing_service_;
+  std::shared_ptr<FileDeleteService> file_delete_service_;
+  std::unique_ptr<FileWatcherService> watcher_;
+};
+
+TEST_F(FileWatcherServiceTest, RecordChange_BurstCollapsesIntoOneTask) {
+  auto& watcher = make_watcher();
+  auto file = watch_dir_ / "notes.txt";
+  write_file(file, "hello");
+  auto t0 = Clock::now();
+
+  for (int i = 0; i < 5; ++i) {
+    watcher.record_change(file, FileChangeKind::Modified, t0 + std::chrono::milliseconds(10 * i));
+  }
+  EXPECT_EQ(watcher.pending_count(), 1u);
+
+  // Still inside the settle window of the last event
+  EXPECT_EQ(watcher.dispatch_settled(t0 + std::chrono::milliseconds(300)), 0u);
+  EXPECT_EQ(watcher.dispatch_settled(t0 + std::chrono::milliseconds(540)), 1u);
+  EXPECT_EQ(pending_task_count(), 1u);
+  EXPECT_EQ(watcher.pending_count(), 0u);
+}
+
+TEST_F(FileWatcherServiceTest, RecordChange_NeverQuietPathStillDispatches) {
+  auto& watcher = make_watcher(nullptr, std::chrono::milliseconds(100));
+  auto file = watch_dir_ / "log.txt";
+  write_file(file, "busy");
+  auto t0 = Clock::now();
+
+  auto now = t0;
+  for (int i = 0; i < 30; ++i) {
+    now = t0 + std::chrono::milliseconds(50 * i);
+    watcher.record_change(file, FileChangeKind::Modified, now);
+  }
+  ASSERT_GE(now - t0, std::chrono::milliseconds(100) * FileWatcherService::MAX_SETTLE_WINDOWS);
+
+  EXPECT_EQ(watcher.dispatch_settled(now), 1u);
+  EXPECT_EQ(pending_task_count(), 1u);
+}
+
+TEST_F(FileWatcherServiceTest, Dispatch_RemovedFileIsDeletedFromIndex) {
+  auto& watcher = make_watcher();
+  auto file = watch_dir_ / "gone.txt";
+  write_file(file, "soon deleted");
+  ASSERT_TRUE(file_processing_service_->request_processing(file).has_value());
+  ASSERT_TRUE(metadata_store_->file_exists(file.string()));
+
+  std::filesystem::remove(file);
+  auto t0 = Clock::now();
+  watcher.record_change(file, FileChangeKind::Removed, t0);
+  watcher.dispatch_settled(t0 + std::chrono::seconds(1));
+
+  EXPECT_FALSE(metadata_store_->file_exists(file.string()));
+}
+
+TEST_F(FileWatcherServiceTest, Dispatch_RemovedThenRecreatedFileIsProcessed) {
+  auto& watcher = make_watcher();
+  auto file = watch_dir_ / "replaced.txt";
+  write_file(file, "new content");
+  auto t0 = Clock::now();
+
+  // An editor's atomic save: the old file disappears and a new one takes its place
+  watcher.record_change(file, FileChangeKind::Removed, t0);
+  watcher.record_change(file, FileChangeKind::Modified, t0 + std::chrono::milliseconds(5));
+  watcher.dispatch_settled(t0 + std::chrono::seconds(1));
+
+  EXPECT_EQ(pending_task_count(), 1u);
+  EXPECT_TRUE(metadata_store_->file_exists(file.string()));
+}
+
+TEST_F(FileWatcherServiceTest, Dispatch_RemovedTreeDeletesEveryFileBelowIt) {
+  auto& watcher = make_watcher();
+  auto keep = watch_dir_ / "keep.txt";
+  auto nested_a = watch_dir_ / "project" / "a.txt";
+  auto nested_b = watch_dir_ / "project" / "src" / "b.txt";
+  write_file(keep, "keep");
+  write_file(nested_a, "a");
+  write_file(nested_b, "b");
+  for (const auto& file : {keep, nested_a, nested_b}) {
+    ASSERT_TRUE(file_processing_service_->request_processing(file).has_value());
+  }
+
+  std::filesystem::remove_all(watch_dir_ / "project");
+  auto t0 = Clock::now();
+  watcher.record_change(watch_dir_ / "project", FileChangeKind::RemovedTree, t0);
+  watcher.dispatch_settled(t0 + std::chrono::seconds(1));
+
+  EXPECT_FALSE(metadata_store_->file_exists(nested_a.string()));
+  EXPECT_FALSE(metadata_store_->file_exists(nested_b.string()));
+  EXPECT_TRUE(metadata_store_->file_exists(keep.string()));
+}
+
+TEST_F(FileWatcherServiceTest, RecordChange_IgnoresMatchingPatterns) {
+  auto& watcher = make_watcher();
+  auto t0 = Clock::now();
+
+  watcher.record_change(watch_dir_ / "download.crdownload", FileChangeKind::Modified, t0);
+  watcher.record_change(watch_dir_ / ".DS_Store", FileChangeKind::Modified, t0);
+  watcher.record_change(watch_dir_ / "~lock.docx", FileChangeKind::Modified, t0);
+  watcher.record_change(watch_dir_ / "draft.txt~", FileChangeKind::Modified, t0);
+  watcher.record_change(watch_dir_ / "real.txt", FileChangeKind::Modified, t0);
+
+  EXPECT_EQ(watcher.pending_count(), 1u);
+}
+
+TEST_F(FileWatcherServiceTest, RecordChange_NonRecursiveIgnoresNestedFiles) {
+  auto& watcher = make_watcher(nullptr, std::chrono::milliseconds(500), /*recursive*/ false);
+  auto t0 = Clock::now();
+
+  watcher.record_change(watch_dir_ / "top.txt", FileChangeKind::Modified, t0);
+  watcher.record_change(watch_dir_ / "nested" / "deep.txt", FileChangeKind::Modified, t0);
+
+  EXPECT_EQ(watcher.pending_count(), 1u);
+}
+
+TEST_F(FileWatcherServiceTest, Start_QueuesBackendEventsAndFlushesOnStop) {
+  auto file = watch_dir_ / "from_backend.txt";
+  write_file(file, "watched");
+  auto& watcher = make_watcher(
+      std::make_unique<ScriptedWatchBackend>(std::vector<Event>{{file, FileChangeKind::Modified}}),
+      std::chrono::hours(1));
+
+  watcher.start();
+  EXPECT_TRUE(watcher.is_running());
+  // The settle window is far away, so only stop() can dispatch the change
+  for (int i = 0; i < 100 && watcher.pending_count() == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(watcher.pending_count(), 1u);
+  EXPECT_EQ(pending_task_count(), 0u);
+
+  watcher.stop();
+
+  EXPECT_FALSE(watcher.is_running());
+  EXPECT_EQ(pending_task_count(), 1u);
+}
+
+TEST_F(FileWatcherServiceTest, InitialScan_QueuesExistingFiles) {
+  write_file(watch_dir_ / "existing.txt", "already here");
+  write_file(watch_dir_ / "sub" / "nested.txt", "also here");
+  FileWatcherOptions options;
+  watcher_ = std::make_unique<FileWatcherService>(
+      file_processing_service_, file_delete_service_,
+      std::vector<std::filesystem::path>{watch_dir_}, options,
+      std::make_unique<ScriptedWatchBackend>(std::vector<Event>{}));
+
+  watcher_->start();
+  for (int i = 0; i < 200 && pending_task_count() < 2; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  watcher_->stop();
+
+  EXPECT_EQ(pending_task_count(), 2u);
+}
+
+TEST(FileWatchBackendTest, Polling_ReportsCreatedAndRemovedFiles) {
+  auto dir = std::filesystem::temp_directory_path() / "magic_polling_backend_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  PollingWatchBackend backend({dir}, std::chrono::milliseconds(20));
+  EventRecorder recorder;
+  std::thread runner([&] { backend.run(recorder.callback()); });
+
+  auto file = dir / "nested" / "new.txt";
+  write_file(file, "polled");
+  EXPECT_TRUE(recorder.wait_for(file, FileChangeKind::Modified));
+  std::filesystem::remove(file);
+  EXPECT_TRUE(recorder.wait_for(file, FileChangeKind::Removed));
+
+  backend.stop();
+  runner.join();
+  std::filesystem::remove_all(dir);
+}
+
+#if defined(__linux__)
+TEST(FileWatchBackendTest, Native_ReportsFilesInNewDirectories) {
+  auto dir = std::filesystem::temp_directory_path() / "magic_native_backend_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto backend = create_file_watch_backend({dir});
+  EXPECT_EQ(backend->name(), "inotify");
+  EventRecorder recorder;
+  std::thread runner([&] { backend->run(recorder.callback()); });
+
+  auto file = dir / "created.txt";
+  write_file(file, "native");
+  EXPECT_TRUE(recorder.wait_for(file, FileChangeKind::Modified));
+  // Files in a directory created after the watch started are still seen
+  auto nested = dir / "later" / "inner.txt";
+  write_file(nested, "nested");
+  EXPECT_TRUE(recorder.wait_for(nested, FileChangeKind::Modified));
+  std::filesystem::remove_all(dir / "later");
+  EXPECT_TRUE(recorder.wait_for(dir / "later", FileChangeKind::RemovedTree));
+
+  backend->stop();
+  runner.join();
+  std::filesystem::remove_all(dir);
+}
+#endif
+
+}  // namespace magic_tests
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "magic_core/db/pooled_connection.hpp"
+#include "magic_core/services/index_maintenance_service.hpp"
+#include "../../common/utilities_test.hpp"
+
+namespace magic_core {
+
+using background::IndexMaintenanceOptions;
+using background::IndexMaintenanceService;
+
+class IndexMaintenanceServiceTest : public magic_tests::MetadataStoreTestBase {
+ protected:
+  std::unique_ptr<IndexMaintenanceService> create_service(IndexMaintenanceOptions options = {}) {
+    return std::make_unique<IndexMaintenanceService>(metadata_store_, task_queue_repo_,
+                                                     *db_manager_, options);
+  }
+};
+
+TEST_F(IndexMaintenanceServiceTest, NeedsRebuild_OnTombstonesAndDrift) {
+  IndexMaintenanceOptions options;
+  options.min_tombstones = 10;
+  options.max_tombstone_ratio = 0.5;
+  options.max_growth_ratio = 0.5;
+
+  VectorIndexStats healthy{100, 5, 100, true, 0};
+  EXPECT_FALSE(IndexMaintenanceService::needs_rebuild(healthy, options));
+  VectorIndexStats tombstoned{100, 60, 160, true, 0};
+  EXPECT_TRUE(IndexMaintenanceService::needs_rebuild(tombstoned, options));
+  // Too few tombstones to be worth a rebuild, whatever the ratio
+  VectorIndexStats small{4, 8, 12, true, 0};
+  EXPECT_FALSE(IndexMaintenanceService::needs_rebuild(small, options));
+
+  // Exact indexes never drift; quantized ones do once they outgrow their training
+  VectorIndexStats grown_flat{1000, 0, 100, true, 0};
+  EXPECT_FALSE(IndexMaintenanceService::needs_rebuild(grown_flat, options));
+  VectorIndexStats grown_quantized{1000, 0, 600, true, 500};
+  EXPECT_TRUE(IndexMaintenanceService::needs_rebuild(grown_quantized, options));
+  VectorIndexStats untrained{499, 0, 0, false, 500};
+  EXPECT_FALSE(IndexMaintenanceService::needs_rebuild(untrained, options));
+  untrained.size = 500;
+  EXPECT_TRUE(IndexMaintenanceService::needs_rebuild(untrained, options));
+}
+
+TEST_F(IndexMaintenanceServiceTest, NeedsDictionary_OnceEnoughChunksAndAfterGrowth) {
+  IndexMaintenanceOptions options;
+  options.min_dictionary_chunks = 100;
+  options.dictionary_growth_ratio = 1.0;
+
+  EXPECT_FALSE(IndexMaintenanceService::needs_dictionary(99, 0, options));
+  EXPECT_TRUE(IndexMaintenanceService::needs_dictionary(100, 0, options));
+  // Trained at 150: retrained only once the store has more than doubled
+  EXPECT_FALSE(IndexMaintenanceService::needs_dictionary(300, 150, options));
+  EXPECT_TRUE(IndexMaintenanceService::needs_dictionary(301, 150, options));
+}
+
+TEST_F(IndexMaintenanceServiceTest, RunDueJobs_RateLimitsEachJob) {
+  IndexMaintenanceOptions options;
+  options.checkpoint_interval = std::chrono::seconds(30);
+  options.index_check_interval = std::chrono::minutes(10);
+  options.optimize_interval = std::chrono::hours(1);
+  options.task_cleanup_interval = std::chrono::hours(24);
+  options.dictionary_interval = std::chrono::hours(24);
+  options.text_index_interval = std::chrono::hours(24);
+  auto service = create_service(options);
+
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(service->run_due_jobs(start), 6);
+  EXPECT_EQ(service->run_due_jobs(start + std::chrono::seconds(10)), 0);
+  // Only the checkpoint is due again
+  EXPECT_EQ(service->run_due_jobs(start + std::chrono::seconds(31)), 1);
+  EXPECT_EQ(service->run_due_jobs(start + std::chrono::hours(2)), 3);
+}
+
+TEST_F(IndexMaintenanceServiceTest, IndexCheck_RebuildDropsTombstones) {
+  for (int i = 0; i < 4; ++i) {
+    auto metadata = magic_tests::TestUtilities::create_test_file_metadata(
+        "/maintenance/file" + std::to_string(i) + ".txt", "maintenance_hash" + std::to_string(i),
+        FileType::Text, 100, true);
+    magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_, metadata);
+  }
+  metadata_store_->delete_file_metadata("/maintenance/file0.txt");
+  metadata_store_->delete_file_metadata("/maintenance/file1.txt");
+  ASSERT_EQ(metadata_store_->file_index_stats().tombstones, 2);
+
+  IndexMaintenanceOptions options;
+  options.min_tombstones = 2;
+  create_service(options)->run_due_jobs(std::chrono::steady_clock::now());
+
+  auto stats = metadata_store_->file_index_stats();
+  EXPECT_EQ(stats.tombstones, 0);
+  EXPECT_EQ(stats.size, 2);
+}
+
+TEST_F(IndexMaintenanceServiceTest, FullTextBackfill_IndexesChunksStoredBeforeTheIndex) {
+  auto metadata = magic_tests::TestUtilities::create_test_file_metadata(
+      "/maintenance/old.txt", "old_hash", FileType::Text, 100, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_,
+                                                                          metadata);
+  std::vector<ProcessedChunk> chunks;
+  for (int i = 0; i < 5; ++i) {
+    ProcessedChunk chunk;
+    chunk.chunk = magic_tests::TestUtilities::create_test_chunk_with_embedding(
+        "backfilled chunk " + std::to_string(i), i, "backfill");
+    chunk.compressed_content = CompressionService::compress(chunk.chunk.content);
+    chunks.push_back(std::move(chunk));
+  }
+  metadata_store_->upsert_chunk_metadata(file_id, chunks);
+  {
+    PooledConnection conn(*db_manager_);
+    *conn << "DELETE FROM chunks_fts;";
+  }
+  ASSERT_TRUE(metadata_store_->search_chunks_lexical("backfilled", 10).empty());
+
+  IndexMaintenanceOptions options;
+  options.text_index_batch = 2;
+  options.text_index_batches_per_run = 2;
+  auto service = create_service(options);
+  const auto start = std::chrono::steady_clock::now();
+  service->run_due_jobs(start);
+  // Bounded to two batches of two per run
+  EXPECT_EQ(metadata_store_->chunks_missing_text(10).size(), 1u);
+  service->run_due_jobs(start + options.text_index_interval);
+  EXPECT_TRUE(metadata_store_->chunks_missing_text(10).empty());
+  EXPECT_EQ(metadata_store_->search_chunks_lexical("backfilled", 10).size(), 5u);
+}
+
+TEST_F(IndexMaintenanceServiceTest, FinishBulkLoad_WaitsForTheQueueThenIndexesTheImport) {
+  auto service = create_service();
+  EXPECT_FALSE(service->finish_bulk_load());
+
+  ASSERT_TRUE(metadata_store_->begin_bulk_load());
+  auto metadata = magic_tests::TestUtilities::create_test_file_metadata(
+      "/maintenance/import.txt", "import_hash", FileType::Text, 100, true);
+  int file_id = magic_tests::TestUtilities::create_complete_file_in_store(metadata_store_,
+                                                                          metadata);
+  std::vector<ProcessedChunk> chunks;
+  for (int i = 0; i < 3; ++i) {
+    ProcessedChunk chunk;
+    chunk.chunk = magic_tests::TestUtilities::create_test_chunk_with_embedding(
+        "imported chunk " + std::to_string(i), i, "import");
+    chunk.compressed_content = CompressionService::compress(chunk.chunk.content);
+    chunks.push_back(std::move(chunk));
+  }
+  metadata_store_->upsert_chunk_metadata(file_id, chunks);
+  long long task_id =
+      task_queue_repo_->create_file_process_task("PROCESS_FILE", "/maintenance/next.txt");
+
+  // Still importing
+  EXPECT_FALSE(service->finish_bulk_load());
+  EXPECT_TRUE(metadata_store_->bulk_loading());
+  task_queue_repo_->update_task_status(task_id, TaskStatus::PROCESSING);
+  service->run_due_jobs(std::chrono::steady_clock::now());
+  EXPECT_TRUE(metadata_store_->bulk_loading());
+  EXPECT_TRUE(metadata_store_->search_chunks_lexical("imported", 10).empty());
+
+  // A summary still being generated writes no vectors
+  long long summary_id =
+      task_queue_repo_->create_tagged_file_task("SUMMARIZE_FILE", "/maintenance/import.txt",
+                                                "import_hash");
+  task_queue_repo_->update_task_status(summary_id, TaskStatus::PROCESSING);
+  task_queue_repo_->update_task_status(task_id, TaskStatus::COMPLETED);
+  EXPECT_TRUE(service->finish_bulk_load());
+  EXPECT_FALSE(metadata_store_->bulk_loading());
+  EXPECT_EQ(metadata_store_->chunk_index_stats().size, 3);
+  EXPECT_TRUE(metadata_store_->chunks_missing_text(10).empty());
+  EXPECT_EQ(metadata_store_->search_chunks_lexical("imported", 10).size(), 3u);
+}
+
+TEST_F(IndexMaintenanceServiceTest, StartStop_Idempotent) {
+  auto service = create_service();
+  EXPECT_FALSE(service->is_running());
+  service->start();
+  service->start();
+  EXPECT_TRUE(service->is_running());
+  service->stop();
+  service->stop();
+  EXPECT_FALSE(service->is_running());
+}
+
+}  // namespace magic_core
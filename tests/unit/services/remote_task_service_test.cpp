@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "magic_core/db/embedding_cache.hpp"
+#include "magic_core/services/remote_task_service.hpp"
+#include "../../common/utilities_test.hpp"
+
+namespace magic_core {
+
+class RemoteTaskServiceTest : public magic_tests::MetadataStoreTestBase {
+ protected:
+  void SetUp() override {
+    MetadataStoreTestBase::SetUp();
+    service_ = std::make_unique<RemoteTaskService>(metadata_store_, task_queue_repo_);
+    metadata_store_->upsert_file_stub(magic_tests::TestUtilities::create_test_basic_file_metadata(
+        path_, "remote_hash", FileType::Text, 100, ProcessingStatus::QUEUED));
+  }
+
+  RemoteChunk chunk(int index, const std::string& content, bool with_embedding = true) {
+    RemoteChunk remote;
+    remote.chunk_index = index;
+    remote.content = content;
+    if (with_embedding) {
+      remote.vector_embedding = magic_tests::TestUtilities::create_test_vector(content);
+    }
+    return remote;
+  }
+
+  // Queues, claims and completes one run over path_ with the given contents
+  void complete_run(const std::vector<std::string>& contents) {
+    task_queue_repo_->create_file_process_task("PROCESS_FILE", path_);
+    auto claimed = service_->claim_tasks("w1", 1, TaskLane::Any);
+    ASSERT_EQ(claimed.size(), 1);
+    std::vector<RemoteChunk> chunks;
+    for (size_t i = 0; i < contents.size(); ++i) {
+      chunks.push_back(chunk(static_cast<int>(i), contents[i]));
+    }
+    service_->complete_file_task(claimed[0].task.id, "w1", chunks, model());
+  }
+
+  std::string model() const {
+    return metadata_store_->embedding_model();
+  }
+
+  const std::string path_ = "/remote/file.txt";
+  std::unique_ptr<RemoteTaskService> service_;
+};
+
+TEST_F(RemoteTaskServiceTest, ClaimTasks_LeasesToRemoteOwner) {
+  long long task_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", path_);
+
+  auto claimed = service_->claim_tasks("w1", 4, TaskLane::Any);
+
+  ASSERT_EQ(claimed.size(), 1);
+  EXPECT_EQ(claimed[0].task.id, task_id);
+  EXPECT_TRUE(claimed[0].stored_chunk_hashes.empty());
+  auto task = task_queue_repo_->get_task(task_id);
+  ASSERT_TRUE(task.has_value());
+  EXPECT_EQ(task->status, TaskStatus::PROCESSING);
+  EXPECT_EQ(task->lease_owner, RemoteTaskService::lease_owner("w1"));
+  EXPECT_EQ(metadata_store_->get_file_metadata(path_)->processing_status,
+            ProcessingStatus::PROCESSING);
+}
+
+TEST_F(RemoteTaskServiceTest, ClaimTasks_LeavesServerSideTasksQueued) {
+  long long reembed_id = task_queue_repo_->create_tagged_task("REEMBED", "all-minilm");
+  long long file_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", path_);
+
+  auto claimed = service_->claim_tasks("w1", 4, TaskLane::Any);
+
+  ASSERT_EQ(claimed.size(), 1);
+  EXPECT_EQ(claimed[0].task.id, file_id);
+  auto reembed = task_queue_repo_->get_task(reembed_id);
+  ASSERT_TRUE(reembed.has_value());
+  EXPECT_EQ(reembed->status, TaskStatus::PENDING);
+  EXPECT_EQ(reembed->attempts, 0);
+}
+
+TEST_F(RemoteTaskServiceTest, CompleteFileTask_StoresChunksAndCompletes) {
+  complete_run({"first chunk", "second chunk"});
+
+  auto metadata = metadata_store_->get_file_metadata(path_);
+  ASSERT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata->processing_status, ProcessingStatus::PROCESSED);
+  EXPECT_EQ(metadata->summary_vector_embedding.size(), MetadataStore::DEFAULT_VECTOR_DIMENSION);
+  auto stored = metadata_store_->get_stored_chunks(metadata->id);
+  ASSERT_EQ(stored.size(), 2);
+  EXPECT_EQ(stored[0].content_hash, EmbeddingCache::content_key("first chunk"));
+  EXPECT_EQ(task_queue_repo_->count_tasks_by_status(TaskStatus::COMPLETED), 1);
+}
+
+TEST_F(RemoteTaskServiceTest, ClaimTasks_OffersStoredHashesForReuse) {
+  complete_run({"kept chunk", "old chunk"});
+  task_queue_repo_->create_file_process_task("PROCESS_FILE", path_);
+
+  auto claimed = service_->claim_tasks("w2", 1, TaskLane::Any);
+  ASSERT_EQ(claimed.size(), 1);
+  EXPECT_EQ(claimed[0].stored_chunk_hashes.size(), 2);
+
+  // The unchanged chunk comes without a vector and keeps its stored one
+  service_->complete_file_task(claimed[0].task.id, "w2",
+                               {chunk(0, "kept chunk", false), chunk(1, "new chunk")},
+                               model());
+  auto stored = metadata_store_->get_stored_chunks(metadata_store_->get_file_metadata(path_)->id);
+  ASSERT_EQ(stored.size(), 2);
+  EXPECT_EQ(stored[0].content_hash, EmbeddingCache::content_key("kept chunk"));
+  EXPECT_EQ(stored[0].vector_embedding.size(), MetadataStore::DEFAULT_VECTOR_DIMENSION);
+  EXPECT_EQ(stored[1].content_hash, EmbeddingCache::content_key("new chunk"));
+}
+
+TEST_F(RemoteTaskServiceTest, OtherWorker_LosesLease) {
+  task_queue_repo_->create_file_process_task("PROCESS_FILE", path_);
+  auto claimed = service_->claim_tasks("w1", 1, TaskLane::Any);
+  ASSERT_EQ(claimed.size(), 1);
+  long long task_id = claimed[0].task.id;
+
+  EXPECT_THROW(service_->report_progress(task_id, "w2", 50.0f, "halfway"), TaskLeaseLostError);
+  EXPECT_THROW(service_->complete_file_task(task_id, "w2", {chunk(0, "content")}, model()),
+               TaskLeaseLostError);
+  EXPECT_THROW(service_->fail_task(task_id, "w2", "error"), TaskLeaseLostError);
+  EXPECT_NO_THROW(service_->report_progress(task_id, "w1", 50.0f, "halfway"));
+  EXPECT_EQ(task_queue_repo_->get_task(task_id)->status, TaskStatus::PROCESSING);
+}
+
+TEST_F(RemoteTaskServiceTest, CompleteFileTask_ThrowsWhenFreshChunkHasNoEmbedding) {
+  task_queue_repo_->create_file_process_task("PROCESS_FILE", path_);
+  auto claimed = service_->claim_tasks("w1", 1, TaskLane::Any);
+  ASSERT_EQ(claimed.size(), 1);
+
+  EXPECT_THROW(service_->complete_file_task(claimed[0].task.id, "w1",
+                                            {chunk(0, "never embedded", false)}, model()),
+               std::invalid_argument);
+  EXPECT_TRUE(
+      metadata_store_->get_stored_chunks(metadata_store_->get_file_metadata(path_)->id).empty());
+}
+
+TEST_F(RemoteTaskServiceTest, CompleteFileTask_FailsVectorsOfAnotherModel) {
+  long long task_id = task_queue_repo_->create_file_process_task("PROCESS_FILE", path_);
+  auto claimed = service_->claim_tasks("w1", 1, TaskLane::Any);
+  ASSERT_EQ(claimed.size(), 1);
+
+  EXPECT_THROW(service_->complete_file_task(task_id, "w1", {chunk(0, "content")},
+                                            model() + "-previous"),
+               EmbeddingModelMismatchError);
+  EXPECT_TRUE(
+      metadata_store_->get_stored_chunks(metadata_store_->get_file_metadata(path_)->id).empty());
+  EXPECT_EQ(task_queue_repo_->get_task(task_id)->status, TaskStatus::FAILED);
+}
+
+TEST_F(RemoteTaskServiceTest, ClaimTasks_RequiresWorkerName) {
+  EXPECT_THROW(service_->claim_tasks("", 1, TaskLane::Any), std::invalid_argument);
+}
+
+}  // namespace magic_core
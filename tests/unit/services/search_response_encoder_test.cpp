@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "magic_core/services/search_response_encoder.hpp"
+
+namespace magic_core {
+
+class SearchResponseEncoderTest : public ::testing::Test {
+ protected:
+  static SearchService::MagicSearchResult sample_result() {
+    SearchService::MagicSearchResult result;
+    FileSearchResult file;
+    file.file.id = 7;
+    file.file.path = "/notes/\"quoted\"\tpath.md";
+    file.distance = 0.25f;
+    file.duplicate_paths = {"/copies/path.md"};
+    result.file_results.push_back(file);
+    result.chunk_results.push_back({11, 0.5f, 7, 2, "line one\nline two \xe2\x9c\x93", 0});
+    result.chunk_results.push_back({12, 0.75f, 7, 3, "second", 0});
+    return result;
+  }
+
+  // What the nlohmann::json tree of the same result serializes to
+  static nlohmann::json expected_json(ChunkContentMode mode) {
+    nlohmann::json file = {{"id", 7},
+                           {"path", "/notes/\"quoted\"\tpath.md"},
+                           {"score", 0.25},
+                           {"duplicate_paths", {"/copies/path.md"}}};
+    nlohmann::json first = {{"id", 11}, {"file_id", 7}, {"chunk_index", 2}, {"score", 0.5}};
+    nlohmann::json second = {{"id", 12}, {"file_id", 7}, {"chunk_index", 3}, {"score", 0.75}};
+    if (mode == ChunkContentMode::Full) {
+      first["content"] = "line one\nline two \xe2\x9c\x93";
+      second["content"] = "second";
+    } else if (mode == ChunkContentMode::Snippet) {
+      first["snippet"] = "line one\nline two \xe2\x9c\x93";
+      first["snippet_offset"] = 0;
+      second["snippet"] = "second";
+      second["snippet_offset"] = 0;
+    }
+    return {{"files", {file}}, {"chunks", {first, second}}};
+  }
+};
+
+TEST_F(SearchResponseEncoderTest, Json_MatchesTheTreeItReplaces) {
+  for (ChunkContentMode mode :
+       {ChunkContentMode::Full, ChunkContentMode::Snippet, ChunkContentMode::None}) {
+    const std::string body =
+        SearchResponseEncoder::encode(sample_result(), mode, ResponseFormat::Json);
+    EXPECT_EQ(nlohmann::json::parse(body), expected_json(mode));
+    // Same key order, no whitespace
+    EXPECT_EQ(body, expected_json(mode).dump());
+  }
+}
+
+TEST_F(SearchResponseEncoderTest, MessagePack_DecodesToTheSameResult) {
+  const std::string body = SearchResponseEncoder::encode(sample_result(), ChunkContentMode::Full,
+                                                         ResponseFormat::MessagePack);
+  nlohmann::json decoded = nlohmann::json::from_msgpack(body);
+  EXPECT_EQ(decoded, expected_json(ChunkContentMode::Full));
+  // Scores are float32 and ids integers
+  EXPECT_TRUE(decoded["chunks"][0]["score"].is_number_float());
+  EXPECT_TRUE(decoded["chunks"][0]["id"].is_number_integer());
+  EXPECT_LT(body.size(), expected_json(ChunkContentMode::Full).dump().size());
+}
+
+TEST_F(SearchResponseEncoderTest, EncodeBatchAndFiles_WrapTheResults) {
+  const std::vector<SearchService::MagicSearchResult> batch = {sample_result(), {}};
+  for (ResponseFormat format : {ResponseFormat::Json, ResponseFormat::MessagePack}) {
+    const std::string body = SearchResponseEncoder::encode_batch(
+        batch, {"first query", "second query"}, ChunkContentMode::None, format);
+    nlohmann::json decoded = format == ResponseFormat::Json ? nlohmann::json::parse(body)
+                                                            : nlohmann::json::from_msgpack(body);
+    ASSERT_EQ(decoded["results"].size(), 2u);
+    nlohmann::json first = expected_json(ChunkContentMode::None);
+    first["query"] = "first query";
+    EXPECT_EQ(decoded["results"][0], first);
+    EXPECT_EQ(decoded["results"][1]["query"], "second query");
+    EXPECT_TRUE(decoded["results"][1]["files"].empty());
+  }
+
+  const std::string files =
+      SearchResponseEncoder::encode_files(sample_result().file_results, ResponseFormat::Json);
+  EXPECT_EQ(nlohmann::json::parse(files), expected_json(ChunkContentMode::None)["files"]);
+}
+
+TEST_F(SearchResponseEncoderTest, InvalidUtf8AndNonFiniteScores_StayDecodable) {
+  SearchService::MagicSearchResult result;
+  result.chunk_results.push_back(
+      {1, std::numeric_limits<float>::quiet_NaN(), 1, 0, "ok \xff\xc3 then \x01", 0});
+  for (ResponseFormat format : {ResponseFormat::Json, ResponseFormat::MessagePack}) {
+    const std::string body = SearchResponseEncoder::encode(result, ChunkContentMode::Full, format);
+    nlohmann::json decoded = format == ResponseFormat::Json ? nlohmann::json::parse(body)
+                                                            : nlohmann::json::from_msgpack(body);
+    EXPECT_EQ(decoded["chunks"][0]["content"], "ok \xef\xbf\xbd\xef\xbf\xbd then \x01");
+    EXPECT_TRUE(decoded["chunks"][0]["score"].is_null());
+  }
+}
+
+TEST_F(SearchResponseEncoderTest, CompressedContent_IsBase64InJsonAndBinInMessagePack) {
+  SearchService::MagicSearchResult result;
+  const std::string frame("\x28\xb5\x2f\xfd\x00\xff", 6);
+  SearchService::ChunkResultDTO chunk{3, 0.5f, 1, 0, frame, 0};
+  chunk.dictionary_id = 42;
+  result.chunk_results.push_back(chunk);
+
+  nlohmann::json json = nlohmann::json::parse(
+      SearchResponseEncoder::encode(result, ChunkContentMode::Compressed, ResponseFormat::Json));
+  EXPECT_EQ(json["chunks"][0]["content_zstd"], "KLUv/QD/");
+  EXPECT_EQ(json["chunks"][0]["dictionary_id"], 42);
+  EXPECT_FALSE(json["chunks"][0].contains("content"));
+
+  nlohmann::json packed = nlohmann::json::from_msgpack(SearchResponseEncoder::encode(
+      result, ChunkContentMode::Compressed, ResponseFormat::MessagePack));
+  ASSERT_TRUE(packed["chunks"][0]["content_zstd"].is_binary());
+  const auto& bytes = packed["chunks"][0]["content_zstd"].get_binary();
+  EXPECT_EQ(std::string(bytes.begin(), bytes.end()), frame);
+  EXPECT_EQ(packed["chunks"][0]["dictionary_id"], 42);
+}
+
+TEST_F(SearchResponseEncoderTest, RerankScore_OnlyOnScoredChunks) {
+  SearchService::MagicSearchResult result = sample_result();
+  result.chunk_results[0].rerank_score = -2.5f;
+  for (ResponseFormat format : {ResponseFormat::Json, ResponseFormat::MessagePack}) {
+    const std::string body = SearchResponseEncoder::encode(result, ChunkContentMode::None, format);
+    nlohmann::json decoded = format == ResponseFormat::Json ? nlohmann::json::parse(body)
+                                                            : nlohmann::json::from_msgpack(body);
+    nlohmann::json expected = expected_json(ChunkContentMode::None);
+    expected["chunks"][0]["rerank_score"] = -2.5;
+    EXPECT_EQ(decoded, expected);
+    if (format == ResponseFormat::Json) {
+      EXPECT_EQ(body, expected.dump());
+    }
+  }
+}
+
+TEST_F(SearchResponseEncoderTest, StreamEvents_CarryTheSameFilesAndChunks) {
+  const SearchService::MagicSearchResult result = sample_result();
+  nlohmann::json files = nlohmann::json::parse(
+      SearchResponseEncoder::encode_stream_files(result.file_results, ResponseFormat::Json));
+  EXPECT_EQ(files["event"], "files");
+  EXPECT_EQ(files["files"], expected_json(ChunkContentMode::Snippet)["files"]);
+
+  const std::string chunk = SearchResponseEncoder::encode_stream_chunk(
+      result.chunk_results[0], ChunkContentMode::Snippet, ResponseFormat::Json);
+  nlohmann::json expected = {{"chunk", expected_json(ChunkContentMode::Snippet)["chunks"][0]},
+                             {"event", "chunk"}};
+  EXPECT_EQ(chunk, expected.dump());
+}
+
+TEST_F(SearchResponseEncoderTest, Negotiate_PicksMessagePackOnlyWhenAccepted) {
+  EXPECT_EQ(SearchResponseEncoder::negotiate(""), ResponseFormat::Json);
+  EXPECT_EQ(SearchResponseEncoder::negotiate("application/json"), ResponseFormat::Json);
+  EXPECT_EQ(SearchResponseEncoder::negotiate("application/msgpack"), ResponseFormat::MessagePack);
+  EXPECT_EQ(SearchResponseEncoder::negotiate("application/json;q=0.5, Application/X-MsgPack"),
+            ResponseFormat::MessagePack);
+  EXPECT_EQ(SearchResponseEncoder::negotiate("application/msgpack; q=0, application/json"),
+            ResponseFormat::Json);
+  EXPECT_STREQ(SearchResponseEncoder::content_type(ResponseFormat::MessagePack),
+               "application/msgpack");
+}
+
+}  // namespace magic_core
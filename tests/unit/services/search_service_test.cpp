@@ -1,11 +1,16 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <chrono>
 #include <memory>
+#include <thread>
 #include <vector>
 
+#include <nlohmann/json.hpp>
+
 #include "magic_core/db/metadata_store.hpp"
 #include "magic_core/llm/ollama_client.hpp"
 #include "magic_core/services/search_service.hpp"
+#include "../../common/http_server_test.hpp"
 #include "../../common/mocks_test.hpp"
 #include "../../common/utilities_test.hpp"
 
@@ -625,4 +630,553 @@ TEST_F(SearchServiceTest, Search_ConsistentQueryEmbedding) {
   EXPECT_LE(results.chunk_results.size(), 3);
 }
 
+// Repeating a query reuses its cached embedding instead of calling the model again
+TEST_F(SearchServiceTest, Search_RepeatedQuery_EmbedsOnce) {
+  std::string query = "machine learning";
+  auto query_embedding = create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f});
+  setupQueryEmbeddingExpectation(query, query_embedding);
+
+  auto first = search_service_->search_files(query, 3);
+  auto second = search_service_->search_files(query, 3);
+
+  ASSERT_EQ(first.size(), second.size());
+  for (size_t i = 0; i < first.size(); ++i) {
+    EXPECT_EQ(first[i].id, second[i].id);
+  }
+  auto stats = search_service_->query_cache_stats();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.size, 1u);
+}
+
+// A zero capacity turns the cache off, so every search embeds its query
+TEST_F(SearchServiceTest, Search_QueryCacheDisabled_EmbedsEveryTime) {
+  auto uncached = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_,
+      [](const std::vector<char>& data) { return std::string(data.begin(), data.end()); }, 0);
+  std::string query = "machine learning";
+  EXPECT_CALL(*mock_ollama_client_, get_embedding(query))
+      .Times(2)
+      .WillRepeatedly(testing::Return(create_test_embedding()));
+
+  uncached->search_files(query, 3);
+  uncached->search_files(query, 3);
+
+  EXPECT_EQ(uncached->query_cache_stats().size, 0u);
+}
+
+// Repeated searches are served from the result cache until the index changes
+TEST_F(SearchServiceTest, Search_ResultCache_InvalidatedByIndexChange) {
+  auto cached = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_,
+      [](const std::vector<char>& data) { return std::string(data.begin(), data.end()); },
+      SearchService::DEFAULT_QUERY_CACHE_CAPACITY, 8);
+  std::string query = "machine learning";
+  setupQueryEmbeddingExpectation(query, create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f}));
+
+  auto first = cached->search_files(query, 4);
+  auto second = cached->search_files(query, 4);
+  ASSERT_EQ(first.size(), second.size());
+  EXPECT_EQ(cached->result_cache_stats().hits, 1u);
+
+  // A different k is a different entry
+  cached->search_files(query, 2);
+  EXPECT_EQ(cached->result_cache_stats().misses, 2u);
+
+  metadata_store_->delete_file_metadata("/docs/ml_algorithms.txt");
+  auto after_delete = cached->search_files(query, 4);
+
+  EXPECT_EQ(cached->result_cache_stats().misses, 3u);
+  EXPECT_EQ(after_delete.size(), first.size() - 1);
+  for (const auto& result : after_delete) {
+    EXPECT_NE(result.file.path, "/docs/ml_algorithms.txt");
+  }
+}
+
+TEST_F(SearchServiceTest, SearchBatch_EmbedsOnceAndMatchesSingleSearches) {
+  std::vector<std::string> queries = {"machine learning", "C++ programming", "machine learning"};
+  auto ml = create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f});
+  auto cpp = create_test_embedding_with_values({0.1f, 0.2f, 0.3f, 0.4f});
+  // The repeated query is embedded once, together with the other in a single call
+  EXPECT_CALL(*mock_ollama_client_,
+              get_embeddings(std::vector<std::string>{"machine learning", "C++ programming"}))
+      .WillOnce(testing::Return(std::vector<std::vector<float>>{ml, cpp}));
+  EXPECT_CALL(*mock_ollama_client_, get_embedding(testing::_)).Times(0);
+
+  auto batch = search_service_->search_batch(queries, 3);
+
+  ASSERT_EQ(batch.size(), 3u);
+  // Singles answered from the query cache filled by the batch
+  auto single_ml = search_service_->search("machine learning", 3);
+  auto single_cpp = search_service_->search("C++ programming", 3);
+  for (const auto& [batched, single] :
+       {std::pair{&batch[0], &single_ml}, {&batch[1], &single_cpp}, {&batch[2], &single_ml}}) {
+    ASSERT_EQ(batched->file_results.size(), single->file_results.size());
+    for (size_t i = 0; i < single->file_results.size(); ++i) {
+      EXPECT_EQ(batched->file_results[i].id, single->file_results[i].id);
+    }
+    ASSERT_EQ(batched->chunk_results.size(), single->chunk_results.size());
+    for (size_t i = 0; i < single->chunk_results.size(); ++i) {
+      EXPECT_EQ(batched->chunk_results[i].id, single->chunk_results[i].id);
+      EXPECT_EQ(batched->chunk_results[i].content, single->chunk_results[i].content);
+    }
+  }
+}
+
+TEST_F(SearchServiceTest, Search_TuningOverridesAreCachedSeparately) {
+  auto cached = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_,
+      [](const std::vector<char>& data) { return std::string(data.begin(), data.end()); },
+      SearchService::DEFAULT_QUERY_CACHE_CAPACITY, 8);
+  std::string query = "machine learning";
+  setupQueryEmbeddingExpectation(query, create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f}));
+
+  auto defaults = cached->search(query, 3);
+  VectorSearchOptions wide;
+  wide.ef_search = 512;
+  wide.nprobe = 64;
+  auto tuned = cached->search(query, 3, wide);
+
+  // A wider beam over this small index finds the same neighbours, but is its own cache entry
+  EXPECT_EQ(cached->result_cache_stats().misses, 2u);
+  ASSERT_EQ(tuned.file_results.size(), defaults.file_results.size());
+  for (size_t i = 0; i < tuned.file_results.size(); ++i) {
+    EXPECT_EQ(tuned.file_results[i].id, defaults.file_results[i].id);
+  }
+  cached->search(query, 3, wide);
+  EXPECT_EQ(cached->result_cache_stats().hits, 1u);
+}
+
+TEST_F(SearchServiceTest, Search_ContentNone_DecompressesNothingUntilFetched) {
+  setupTestDataWithChunks();
+  size_t decompressed = 0;
+  auto counting = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_, [&](const std::vector<char>& data) {
+        ++decompressed;
+        return std::string(data.begin(), data.end());
+      });
+  std::string query = "machine learning algorithms";
+  setupQueryEmbeddingExpectation(query, create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f}));
+
+  ChunkContentOptions ids_only;
+  ids_only.mode = ChunkContentMode::None;
+  auto results = counting->search(query, 3, {}, ids_only);
+
+  ASSERT_FALSE(results.chunk_results.empty());
+  EXPECT_EQ(decompressed, 0u);
+  for (const auto& chunk : results.chunk_results) {
+    EXPECT_TRUE(chunk.content.empty());
+    EXPECT_GT(chunk.file_id, 0);
+  }
+
+  // Fetching one hit decompresses just that chunk
+  const auto& hit = results.chunk_results.front();
+  auto fetched = counting->get_chunk(hit.id);
+  ASSERT_TRUE(fetched.has_value());
+  EXPECT_EQ(decompressed, 1u);
+  EXPECT_EQ(fetched->file_id, hit.file_id);
+  EXPECT_EQ(fetched->chunk_index, hit.chunk_index);
+  EXPECT_FALSE(fetched->content.empty());
+  EXPECT_FALSE(counting->get_chunk(999999).has_value());
+}
+
+TEST_F(SearchServiceTest, Search_ContentSnippet_ReturnsWindowOfChunk) {
+  setupTestDataWithChunks();
+  std::string query = "machine learning algorithms";
+  setupQueryEmbeddingExpectation(query, create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f}));
+
+  auto full = search_service_->search(query, 3);
+  ChunkContentOptions snippets;
+  snippets.mode = ChunkContentMode::Snippet;
+  snippets.snippet_chars = 12;
+  auto results = search_service_->search(query, 3, {}, snippets);
+
+  ASSERT_EQ(results.chunk_results.size(), full.chunk_results.size());
+  for (size_t i = 0; i < results.chunk_results.size(); ++i) {
+    const auto& snippet = results.chunk_results[i];
+    const std::string& content = full.chunk_results[i].content;
+    EXPECT_LE(snippet.content.size(), 12u);
+    EXPECT_EQ(content.substr(snippet.content_offset, snippet.content.size()), snippet.content);
+  }
+}
+
+TEST_F(SearchServiceTest, Search_ContentCompressed_PassesTheStoredFramesThrough) {
+  setupTestDataWithChunks();
+  size_t decompressed = 0;
+  auto counting = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_, [&](const std::vector<char>& data) {
+        ++decompressed;
+        return std::string(data.begin(), data.end());
+      });
+  std::string query = "machine learning algorithms";
+  setupQueryEmbeddingExpectation(query, create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f}));
+
+  // The fixture stores chunks as they are, so the "frames" are the plain content
+  auto full = counting->search(query, 3);
+  const size_t decompressed_for_full = decompressed;
+  ChunkContentOptions frames;
+  frames.mode = ChunkContentMode::Compressed;
+  auto results = counting->search(query, 3, {}, frames);
+
+  EXPECT_EQ(decompressed, decompressed_for_full);
+  ASSERT_EQ(results.chunk_results.size(), full.chunk_results.size());
+  ASSERT_FALSE(results.chunk_results.empty());
+  for (size_t i = 0; i < results.chunk_results.size(); ++i) {
+    EXPECT_EQ(results.chunk_results[i].content, full.chunk_results[i].content);
+    EXPECT_EQ(results.chunk_results[i].dictionary_id, 0u);
+  }
+}
+
+TEST_F(SearchServiceTest, SearchStreaming_HandsOverFilesBeforeAnyChunkIsRead) {
+  setupTestDataWithChunks();
+  size_t decompressed = 0;
+  auto counting = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_, [&](const std::vector<char>& data) {
+        ++decompressed;
+        return std::string(data.begin(), data.end());
+      });
+  std::string query = "machine learning algorithms";
+  setupQueryEmbeddingExpectation(query, create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f}));
+
+  std::vector<FileSearchResult> streamed_files;
+  size_t files_calls = 0;
+  size_t decompressed_at_files = 0;
+  std::vector<SearchService::ChunkResultDTO> streamed_chunks;
+  SearchService::SearchObserver observer;
+  observer.on_files = [&](const std::vector<FileSearchResult>& files) {
+    ++files_calls;
+    decompressed_at_files = decompressed;
+    streamed_files = files;
+  };
+  observer.on_chunk = [&](const SearchService::ChunkResultDTO& chunk) {
+    EXPECT_EQ(files_calls, 1u);
+    streamed_chunks.push_back(chunk);
+  };
+  auto result = counting->search_streaming(query, 3, {}, {}, SearchMode::Vector, {}, observer);
+
+  EXPECT_EQ(files_calls, 1u);
+  EXPECT_EQ(decompressed_at_files, 0u);
+  ASSERT_FALSE(result.chunk_results.empty());
+  ASSERT_EQ(streamed_files.size(), result.file_results.size());
+  for (size_t i = 0; i < streamed_files.size(); ++i) {
+    EXPECT_EQ(streamed_files[i].id, result.file_results[i].id);
+  }
+  ASSERT_EQ(streamed_chunks.size(), result.chunk_results.size());
+  for (size_t i = 0; i < streamed_chunks.size(); ++i) {
+    EXPECT_EQ(streamed_chunks[i].id, result.chunk_results[i].id);
+    EXPECT_EQ(streamed_chunks[i].content, result.chunk_results[i].content);
+  }
+
+  // Lexical files are only known after the full-text search, but still come first and once
+  files_calls = 0;
+  streamed_chunks.clear();
+  auto lexical = counting->search_streaming("tutorial", 10, {}, {}, SearchMode::Lexical, {},
+                                            observer);
+  EXPECT_EQ(files_calls, 1u);
+  EXPECT_EQ(streamed_files.size(), lexical.file_results.size());
+  EXPECT_EQ(streamed_chunks.size(), lexical.chunk_results.size());
+}
+
+TEST_F(SearchServiceTest, Search_LexicalMode_NeverEmbeds) {
+  setupTestDataWithChunks();
+  EXPECT_CALL(*mock_ollama_client_, get_embedding(testing::_)).Times(0);
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(testing::_)).Times(0);
+
+  auto results = search_service_->search("tutorial", 10, {}, {}, SearchMode::Lexical);
+
+  ASSERT_EQ(results.file_results.size(), 1u);
+  EXPECT_EQ(results.file_results[0].file.path, "/docs/README.md");
+  ASSERT_EQ(results.chunk_results.size(), 4u);
+  for (size_t i = 0; i < results.chunk_results.size(); ++i) {
+    EXPECT_EQ(results.chunk_results[i].file_id, results.file_results[0].id);
+    EXPECT_NE(results.chunk_results[i].content.find("tutorial"), std::string::npos);
+    if (i > 0) {
+      EXPECT_LE(results.chunk_results[i - 1].distance, results.chunk_results[i].distance);
+    }
+  }
+
+  auto batch = search_service_->search_batch({"tutorial", "nothing matches this"}, 10, {}, {},
+                                             SearchMode::Lexical);
+  ASSERT_EQ(batch.size(), 2u);
+  EXPECT_EQ(batch[0].chunk_results.size(), 4u);
+  EXPECT_TRUE(batch[1].file_results.empty());
+  EXPECT_TRUE(batch[1].chunk_results.empty());
+}
+
+TEST_F(SearchServiceTest, Search_HybridMode_FusesVectorAndLexicalHits) {
+  setupTestDataWithChunks();
+  // The embedding points at the ML file, the words at the C++ one
+  std::string query = "programming";
+  setupQueryEmbeddingExpectation(query, create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f}));
+
+  // Two files by vector distance leaves the C++ file out; its words bring it back
+  auto vector_only = search_service_->search(query, 2);
+  auto hybrid = search_service_->search(query, 2, {}, {}, SearchMode::Hybrid);
+
+  for (const auto& file : vector_only.file_results) {
+    EXPECT_NE(file.file.path, "/src/main.cpp");
+  }
+  ASSERT_EQ(hybrid.file_results.size(), 2u);
+  EXPECT_EQ(hybrid.file_results[0].file.path, "/docs/ml_algorithms.txt");
+  EXPECT_EQ(hybrid.file_results[1].file.path, "/src/main.cpp");
+  EXPECT_LT(hybrid.file_results[0].distance, 0.0f);
+  EXPECT_FLOAT_EQ(hybrid.file_results[0].distance, hybrid.file_results[1].distance);
+
+  ASSERT_EQ(hybrid.chunk_results.size(), 2u);
+  EXPECT_EQ(hybrid.chunk_results[0].id, vector_only.chunk_results[0].id);
+  EXPECT_NE(hybrid.chunk_results[1].content.find("programming"), std::string::npos);
+  EXPECT_FALSE(hybrid.chunk_results[0].content.empty());
+}
+
+TEST_F(SearchServiceTest, Search_FilterKeepsOnlyMatchingFilesAndChunks) {
+  setupTestDataWithChunks();
+  auto cached = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_,
+      [](const std::vector<char>& data) { return std::string(data.begin(), data.end()); },
+      SearchService::DEFAULT_QUERY_CACHE_CAPACITY, 16);
+  std::string query = "machine learning algorithms";
+  setupQueryEmbeddingExpectation(query, create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f}));
+
+  SearchFilter docs;
+  docs.path_prefix = "/docs/";
+  docs.file_types = {FileType::Markdown};
+  auto results = cached->search(query, 3, {}, {}, SearchMode::Vector, docs);
+
+  ASSERT_EQ(results.file_results.size(), 1u);
+  EXPECT_EQ(results.file_results[0].file.path, "/docs/README.md");
+  ASSERT_FALSE(results.chunk_results.empty());
+  for (const auto& chunk : results.chunk_results) {
+    EXPECT_EQ(chunk.file_id, results.file_results[0].id);
+  }
+
+  // Filtered and unfiltered results are cached apart
+  auto unfiltered = cached->search(query, 3);
+  EXPECT_EQ(unfiltered.file_results.size(), 3u);
+  EXPECT_EQ(cached->result_cache_stats().hits, 0u);
+  cached->search(query, 3, {}, {}, SearchMode::Vector, docs);
+  EXPECT_EQ(cached->result_cache_stats().hits, 1u);
+
+  auto files = cached->search_files(query, 10, {}, docs);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].file.path, "/docs/README.md");
+}
+
+TEST_F(SearchServiceTest, Search_FileShortlistWidensChunkCandidatesOnly) {
+  setupTestDataWithChunks();
+  auto noop_decompress = [](const std::vector<char>& data) {
+    return std::string(data.begin(), data.end());
+  };
+  SearchPlan exact;
+  exact.file_shortlist = 3;
+  SearchPlan indexed = exact;
+  indexed.exact_chunk_scan = false;
+  auto exact_service = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_, noop_decompress,
+      SearchService::DEFAULT_QUERY_CACHE_CAPACITY, 0, exact);
+  auto indexed_service = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_, noop_decompress,
+      SearchService::DEFAULT_QUERY_CACHE_CAPACITY, 0, indexed);
+  std::string query = "machine learning algorithms";
+  auto embedding = create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f});
+  EXPECT_CALL(*mock_ollama_client_, get_embedding(query))
+      .WillRepeatedly(testing::Return(embedding));
+
+  auto result = exact_service->search(query, 1);
+
+  // Only the best file is returned, but chunks compete across all three shortlisted files
+  ASSERT_EQ(result.file_results.size(), 1u);
+  EXPECT_EQ(result.file_results[0].file.path, "/docs/ml_algorithms.txt");
+  std::vector<int> all_files;
+  for (const auto& file : metadata_store_->list_all_files()) {
+    all_files.push_back(file.id);
+  }
+  auto best = metadata_store_->scan_similar_chunks(all_files, embedding, 1);
+  ASSERT_EQ(result.chunk_results.size(), 1u);
+  ASSERT_EQ(best.size(), 1u);
+  EXPECT_EQ(result.chunk_results[0].id, best[0].id);
+
+  // The chunk index finds the same chunk in a shortlist this small
+  auto via_index = indexed_service->search(query, 1);
+  ASSERT_EQ(via_index.chunk_results.size(), 1u);
+  EXPECT_EQ(via_index.chunk_results[0].id, result.chunk_results[0].id);
+  EXPECT_EQ(exact_service->search_batch({query}, 1)[0].chunk_results[0].id,
+            result.chunk_results[0].id);
+}
+
+namespace {
+
+// A /v1/rerank server that only finds chunks about programming relevant, after delay
+magic_tests::LoopbackHttpServer::Handler programming_reranker(std::chrono::milliseconds delay) {
+  return [delay](const std::string&, const std::string&, const std::string& body) {
+    std::this_thread::sleep_for(delay);
+    auto request = nlohmann::json::parse(body);
+    nlohmann::json results = nlohmann::json::array();
+    for (size_t i = 0; i < request["documents"].size(); ++i) {
+      const bool relevant =
+          request["documents"][i].get<std::string>().find("programming") != std::string::npos;
+      results.push_back({{"index", i}, {"relevance_score", relevant ? 1.0f : 0.0f}});
+    }
+    return magic_tests::LoopbackHttpServer::Response{200,
+                                                     nlohmann::json{{"results", results}}.dump()};
+  };
+}
+
+}  // namespace
+
+TEST_F(SearchServiceTest, Search_RerankerReordersTheChunkCandidates) {
+  setupTestDataWithChunks();
+  magic_tests::LoopbackHttpServer server(programming_reranker(std::chrono::milliseconds(0)));
+  auto noop_decompress = [](const std::vector<char>& data) {
+    return std::string(data.begin(), data.end());
+  };
+  SearchPlan plan;
+  plan.file_shortlist = 3;
+  RerankOptions rerank;
+  rerank.candidates = 9;
+  rerank.batch_size = 4;
+  rerank.budget = std::chrono::milliseconds(5000);
+  auto reranking = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_, noop_decompress,
+      SearchService::DEFAULT_QUERY_CACHE_CAPACITY, 0, plan,
+      std::make_shared<magic_core::RerankClient>(server.url(), "test-reranker"), rerank);
+  std::string query = "machine learning algorithms";
+  EXPECT_CALL(*mock_ollama_client_, get_embedding(query))
+      .WillRepeatedly(testing::Return(create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f})));
+
+  auto result = reranking->search(query, 2);
+
+  // Both programming chunks rank last by vector distance but first by relevance
+  EXPECT_TRUE(result.reranked);
+  ASSERT_EQ(result.chunk_results.size(), 2u);
+  for (const auto& chunk : result.chunk_results) {
+    EXPECT_NE(chunk.content.find("programming"), std::string::npos);
+    ASSERT_TRUE(chunk.rerank_score.has_value());
+    EXPECT_FLOAT_EQ(*chunk.rerank_score, 1.0f);
+  }
+  EXPECT_EQ(result.file_results.size(), 2u);
+}
+
+TEST_F(SearchServiceTest, SearchBatch_RerankerScoresEveryQueryWithinOneBudget) {
+  setupTestDataWithChunks();
+  magic_tests::LoopbackHttpServer server(programming_reranker(std::chrono::milliseconds(200)));
+  auto noop_decompress = [](const std::vector<char>& data) {
+    return std::string(data.begin(), data.end());
+  };
+  SearchPlan plan;
+  plan.file_shortlist = 3;
+  RerankOptions rerank;
+  rerank.candidates = 9;
+  rerank.budget = std::chrono::milliseconds(2000);
+  auto reranking = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_, noop_decompress,
+      SearchService::DEFAULT_QUERY_CACHE_CAPACITY, 0, plan,
+      std::make_shared<magic_core::RerankClient>(server.url(), "test-reranker"), rerank);
+  std::vector<std::string> queries;
+  std::vector<std::vector<float>> embeddings;
+  for (int i = 0; i < 6; ++i) {
+    queries.push_back("query " + std::to_string(i));
+    embeddings.push_back(create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f}));
+  }
+  EXPECT_CALL(*mock_ollama_client_, get_embeddings(queries))
+      .WillOnce(testing::Return(embeddings));
+
+  auto started = std::chrono::steady_clock::now();
+  auto batch = reranking->search_batch(queries, 2);
+
+  // Scored one after the other, the six queries would take 1.2s
+  EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(1000));
+  ASSERT_EQ(batch.size(), queries.size());
+  for (const auto& result : batch) {
+    EXPECT_TRUE(result.reranked);
+    ASSERT_EQ(result.chunk_results.size(), 2u);
+    for (const auto& chunk : result.chunk_results) {
+      EXPECT_NE(chunk.content.find("programming"), std::string::npos);
+      EXPECT_TRUE(chunk.rerank_score.has_value());
+    }
+  }
+}
+
+TEST_F(SearchServiceTest, Search_RerankerPastItsBudgetKeepsTheVectorOrder) {
+  setupTestDataWithChunks();
+  magic_tests::LoopbackHttpServer server(programming_reranker(std::chrono::milliseconds(300)));
+  auto noop_decompress = [](const std::vector<char>& data) {
+    return std::string(data.begin(), data.end());
+  };
+  SearchPlan plan;
+  plan.file_shortlist = 3;
+  RerankOptions rerank;
+  rerank.candidates = 9;
+  rerank.budget = std::chrono::milliseconds(20);
+  auto reranking = std::make_unique<SearchService>(
+      metadata_store_, mock_ollama_client_, noop_decompress,
+      SearchService::DEFAULT_QUERY_CACHE_CAPACITY, 16, plan,
+      std::make_shared<magic_core::RerankClient>(server.url(), "test-reranker"), rerank);
+  auto plain = std::make_unique<SearchService>(metadata_store_, mock_ollama_client_,
+                                               noop_decompress,
+                                               SearchService::DEFAULT_QUERY_CACHE_CAPACITY, 0,
+                                               plan);
+  std::string query = "machine learning algorithms";
+  EXPECT_CALL(*mock_ollama_client_, get_embedding(query))
+      .WillRepeatedly(testing::Return(create_test_embedding_with_values({0.9f, 0.8f, 0.7f, 0.6f})));
+
+  auto result = reranking->search(query, 2);
+  auto expected = plain->search(query, 2);
+
+  EXPECT_FALSE(result.reranked);
+  ASSERT_EQ(result.chunk_results.size(), expected.chunk_results.size());
+  for (size_t i = 0; i < result.chunk_results.size(); ++i) {
+    EXPECT_EQ(result.chunk_results[i].id, expected.chunk_results[i].id);
+    EXPECT_FLOAT_EQ(result.chunk_results[i].distance, expected.chunk_results[i].distance);
+    EXPECT_FALSE(result.chunk_results[i].rerank_score.has_value());
+  }
+  // A fallback is not cached, so the next search gets another chance at re-ranking
+  reranking->search(query, 2);
+  EXPECT_EQ(reranking->result_cache_stats().hits, 0u);
+}
+
+TEST(SearchServiceFusionTest, FuseRankings_SumsReciprocalRanks) {
+  // 7 is second in both lists and beats 1 and 9, each first in only one
+  auto fused = SearchService::fuse_rankings({{1, 7, 3}, {9, 7}}, 10);
+  ASSERT_EQ(fused.size(), 4u);
+  EXPECT_EQ(fused[0].first, 7);
+  EXPECT_FLOAT_EQ(fused[0].second, 2.0f / (SearchService::RRF_K + 2));
+  // Equal scores keep the order the ids were first seen in
+  EXPECT_EQ(fused[1].first, 1);
+  EXPECT_EQ(fused[2].first, 9);
+  EXPECT_FLOAT_EQ(fused[1].second, fused[2].second);
+  EXPECT_EQ(fused[3].first, 3);
+
+  auto top = SearchService::fuse_rankings({{1, 7, 3}, {9, 7}}, 2);
+  ASSERT_EQ(top.size(), 2u);
+  EXPECT_EQ(top[1].first, 1);
+  EXPECT_TRUE(SearchService::fuse_rankings({{}, {}}, 5).empty());
+}
+
+TEST(SearchServiceSnippetTest, BestSnippetOffset_CentresOnDensestMatches) {
+  const std::string content = "Neural nets come up first. " + std::string(60, '.') +
+                              " Then neural training is covered in depth.";
+  const size_t at = content.find("neural training");
+
+  // The lone early "Neural" loses to the two words together
+  size_t offset = SearchService::best_snippet_offset(content, "neural training", 30);
+  EXPECT_LE(offset, at);
+  EXPECT_GE(offset + 30, at + std::string("neural training").size());
+
+  // No query word occurs, or the chunk already fits: start at the beginning
+  EXPECT_EQ(SearchService::best_snippet_offset(content, "quantum", 40), 0u);
+  EXPECT_EQ(SearchService::best_snippet_offset("short", "short", 40), 0u);
+}
+
+TEST(SearchServiceSnippetTest, BestSnippetOffset_NeverStartsInsideUtf8Sequence) {
+  // Each "\xC3\xA9" is one two-byte character
+  std::string content;
+  for (int i = 0; i < 40; ++i) {
+    content += "\xC3\xA9";
+  }
+  content += " target";
+  size_t offset = SearchService::best_snippet_offset(content, "target", 10);
+  ASSERT_LT(offset, content.size());
+  EXPECT_NE(static_cast<unsigned char>(content[offset]) & 0xC0, 0x80);
+}
+
 }  // namespace magic_core
\ No newline at end of file